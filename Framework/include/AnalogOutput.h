@@ -44,6 +44,14 @@ class AnalogOutput : public Interface {
                 Q = q; 
             }
         }
+
+        /**
+         * @brief Get the maximum value accepted by setQ() without clamping.
+         * @return uint16_t 2^resolution - 1.
+         */
+        uint16_t getMaxQ() const {
+            return (1UL << resolution) - 1;
+        }
         uint8_t channel;
     private:
         bool valid = false;
@@ -11,6 +11,11 @@
 #include "UARTInterface.h"
 #include "I2CCore.h"
 #include "I2CInterface.h"
+#include "CANInterface.h"
+#include "CANUARTGateway.h"
+#include "ModbusRTUMaster.h"
+#include "ModbusRTUSlave.h"
+#include "TelemetryPublisher.h"
 
 class BusModuleV1_0 : public CANTramModule {
     public:
@@ -47,6 +52,22 @@ class BusModuleV1_0 : public CANTramModule {
     
     bool addUARTInterface();
     bool addI2CInterface(); //Implement later
+
+    bool enableGateway(CANInterface* canInterface, uint32_t baudrate = CANUARTGateway::DEFAULT_BAUDRATE);
+    void disableGateway();
+    CANUARTGateway& getGateway() { return _gateway; }
+
+    bool enableModbusMaster(uint32_t baudrate = 19200, UARTCore::Parity parity = UARTCore::UART_PARITY_EVEN);
+    void disableModbusMaster() { _modbusMasterEnabled = false; }
+    ModbusRTUMaster<UARTInterface>& getModbusMaster() { return _modbusMaster; }
+
+    bool enableModbusSlave(uint8_t slaveId, uint32_t baudrate = 19200, UARTCore::Parity parity = UARTCore::UART_PARITY_EVEN);
+    void disableModbusSlave() { _modbusSlave.end(); }
+    ModbusRTUSlave& getModbusSlave() { return _modbusSlave; }
+
+    bool enableTelemetry(uint32_t periodUs = TelemetryPublisher::DEFAULT_PERIOD_US, uint32_t baudrate = TelemetryPublisher::DEFAULT_BAUDRATE);
+    void disableTelemetry() { _telemetry.end(); }
+    TelemetryPublisher& getTelemetry() { return _telemetry; }
     
     private:
         OutputDefinition* UART_RX_PIN;
@@ -54,10 +75,20 @@ class BusModuleV1_0 : public CANTramModule {
         OutputDefinition* SPI_CS_PIN;
         SPIChip* _SPIBus = nullptr;
         static constexpr size_t INTERFACE_COUNT = 3; // Number of interfaces in the array
+        static constexpr uint8_t MODBUS_RX_FULL_THRESHOLD = 8;     // A request of 8 bytes is readable with its last byte
+        static constexpr uint8_t MODBUS_RX_TIMEOUT_SYMBOLS = 1;    // Longer frames are readable one character after their end
         Interface* _interfaces[INTERFACE_COUNT]; // representation of the physical interfaces clamps
         UARTInterface _uartInterface;
         I2CInterface _i2cInterface; 
+        CANUARTGateway _gateway;
+        ModbusRTUMaster<UARTInterface> _modbusMaster{_uartInterface};
+        bool _modbusMasterEnabled = false;
+        ModbusRTUSlave _modbusSlave;
+        TelemetryPublisher _telemetry;
         std::function<void(uint8_t* response)> _loopFunction = nullptr;
+
+        bool claimUART(const String& user);
+        void configureModbusUART(uint32_t baudrate, UARTCore::Parity parity);
         //I2nterface* _i2cUnterface = nullptr;  //Implement later
         //SPIInterface* _spi = nullptr;
 };
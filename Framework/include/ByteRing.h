@@ -0,0 +1,112 @@
+#ifndef BYTE_RING_H
+#define BYTE_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+
+/**
+ * @file ByteRing.h
+ * @brief Declaration of the ByteRing class.
+ * @details Defines a lock-free single-producer/single-consumer ring buffer of bytes, e.g. between a UART receive task and the
+ *          application. Exactly one task may call write(), exactly one other task may call read()/peek()/consume()/clear().
+ *          Bytes are copied with at most two memcpy() calls per access. peek() exposes the oldest bytes in place, so parsers
+ *          can work on the buffer without copying them first.
+ */
+
+#ifndef BYTE_RING_ALIGNMENT
+#define BYTE_RING_ALIGNMENT 64
+#endif
+
+template<size_t Capacity>
+class ByteRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+public:
+    ByteRing() = default;
+    ByteRing(const ByteRing&) = delete;
+    ByteRing& operator=(const ByteRing&) = delete;
+
+    /**
+     * @brief Append bytes (producer side).
+     * @return size_t Number of bytes stored, less than length if the ring is full.
+     */
+    size_t write(const uint8_t* data, size_t length) {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        size_t space = Capacity - (head - _tail.load(std::memory_order_acquire));
+        if(length > space) length = space;
+        size_t offset = head & MASK;
+        size_t first = length < Capacity - offset ? length : Capacity - offset;
+        memcpy(&_data[offset], data, first);
+        memcpy(&_data[0], data + first, length - first);
+        _head.store(head + length, std::memory_order_release);
+        return length;
+    }
+
+    /**
+     * @brief Get the free space (producer side).
+     */
+    size_t free() const { return Capacity - size(); }
+
+    /**
+     * @brief Remove the oldest bytes (consumer side).
+     * @param buffer Destination with room for size bytes.
+     * @param size Maximum number of bytes to read.
+     * @return size_t Number of bytes copied into buffer.
+     */
+    size_t read(uint8_t* buffer, size_t size) {
+        size_t length = 0;
+        while(length < size) {
+            const uint8_t* data;
+            size_t chunk = peek(data);
+            if(chunk == 0) break;
+            if(chunk > size - length) chunk = size - length;
+            memcpy(&buffer[length], data, chunk);
+            consume(chunk);
+            length += chunk;
+        }
+        return length;
+    }
+
+    /**
+     * @brief Get the oldest bytes without removing them (consumer side).
+     * @param data Set to the oldest byte. Valid until consume(), read() or clear() is called.
+     * @return size_t Number of contiguous bytes at data. Less than size() if the stored bytes wrap around the end of the ring,
+     *         the remaining bytes follow after consume().
+     */
+    size_t peek(const uint8_t*& data) {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        size_t length = _head.load(std::memory_order_acquire) - tail;
+        size_t offset = tail & MASK;
+        data = &_data[offset];
+        return length < Capacity - offset ? length : Capacity - offset;
+    }
+
+    /**
+     * @brief Remove bytes after peek() (consumer side).
+     * @param length Number of bytes to remove, at most the number returned by peek().
+     */
+    void consume(size_t length) {
+        _tail.store(_tail.load(std::memory_order_relaxed) + length, std::memory_order_release);
+    }
+
+    /**
+     * @brief Remove all bytes (consumer side).
+     */
+    void clear() {
+        _tail.store(_head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    size_t size() const { return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire); }
+    bool empty() const { return size() == 0; }
+    static constexpr size_t capacity() { return Capacity; }
+
+private:
+    static constexpr uint32_t MASK = Capacity - 1;
+
+    alignas(BYTE_RING_ALIGNMENT) std::atomic<uint32_t> _head{0};     // Written by the producer
+    alignas(BYTE_RING_ALIGNMENT) std::atomic<uint32_t> _tail{0};     // Written by the consumer
+    alignas(BYTE_RING_ALIGNMENT) uint8_t _data[Capacity];
+};
+
+#endif // BYTE_RING_H
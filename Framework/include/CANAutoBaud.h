@@ -0,0 +1,76 @@
+#ifndef CANAUTOBAUD_H
+#define CANAUTOBAUD_H
+
+#include <Arduino.h>
+#include "CANCore.h"
+#include "Debug.h"
+
+/**
+ * @file CANAutoBaud.h
+ * @brief Declaration of the CANAutoBaud class.
+ * @details Detects the baudrate of a running bus without disturbing it. The CAN core is started in listen-only mode and cycles
+ *          through the candidate baudrates. A candidate is accepted after the required number of valid frames. Bus errors without
+ *          a valid frame switch to the next candidate early. Once locked, the core is restarted in normal mode at the detected baudrate.
+ *
+ *          The detection ends after the timeout at the latest:
+ *          - LOCKED: the core runs at getBaudrate().
+ *          - NO_TRAFFIC: no frame and no error was seen, the bus is silent or not connected.
+ *          - FAILED: there was traffic, but at none of the candidates. The core should not be started.
+ *          In both cases the core is stopped and its previous baudrate is restored.
+ */
+class CANAutoBaud {
+public:
+    static constexpr uint8_t MAX_CANDIDATES = 4;
+    static constexpr uint32_t DEFAULT_TIMEOUT_MS = 3000;
+    static constexpr uint32_t DEFAULT_DWELL_MS = 100;   // Listening time per candidate
+    static constexpr uint8_t ERROR_SWITCH_THRESHOLD = 3; // Bus errors without a valid frame which switch to the next candidate
+
+    enum State {
+        IDLE,
+        LISTENING,
+        LOCKED,
+        NO_TRAFFIC,
+        FAILED
+    };
+
+    CANAutoBaud();
+
+    bool begin(CANCore* core, uint32_t timeoutMs = DEFAULT_TIMEOUT_MS);
+    State poll();
+    State detect(CANCore* core, uint32_t timeoutMs = DEFAULT_TIMEOUT_MS);
+    void end();
+
+    bool setCandidates(const CANCore::Baudrate* candidates, uint8_t count);
+    void setDwellTime(uint32_t ms) { _dwellMs = ms; }
+    void setRequiredFrames(uint8_t frames) { _requiredFrames = frames > 0 ? frames : 1; }
+
+    State getState() const { return _state; }
+    CANCore::Baudrate getBaudrate() const { return _state == LOCKED ? _candidates[_candidate] : CANCore::BR_NOT_SET; }
+    uint32_t getDetectionTimeMs() const { return _detectionTimeMs; }
+    uint8_t getSwitchCount() const { return _switches; }
+    uint32_t getErrorCount() const { return _errors; }
+
+private:
+    CANCore* _core = nullptr;
+    CANCore::Baudrate _previousBaudrate = CANCore::BR_NOT_SET;
+    CANCore::Baudrate _candidates[MAX_CANDIDATES];
+    uint8_t _candidateCount = 0;
+    uint8_t _candidate = 0;
+    uint32_t _dwellMs = DEFAULT_DWELL_MS;
+    uint8_t _requiredFrames = 1;
+    uint32_t _timeoutMs = DEFAULT_TIMEOUT_MS;
+
+    State _state = IDLE;
+    uint32_t _start = 0;
+    uint32_t _candidateStart = 0;
+    uint32_t _detectionTimeMs = 0;
+    uint8_t _validFrames = 0;
+    uint32_t _candidateErrors = 0;
+    uint32_t _errors = 0;
+    uint8_t _switches = 0;
+
+    bool listen(uint8_t candidate);
+    void finish(State state);
+};
+
+#endif // CANAUTOBAUD_H
@@ -3,6 +3,8 @@
 
 #include <Arduino.h>
 #include "HardwareResource.h"
+#include "CANFrame.h"
+#include "CANResponder.h"
 
 #include "Debug.h"
 /**
@@ -40,10 +42,28 @@ enum Baudrate {
 };
 
 enum Status{
-    STATUS_OK,
-    STATUS_ERROR_ACTIVE,
-    STATUS_BUS_OFF,
-    STATUS_ERROR_PASSIVE
+    STATUS_OK,              // Error active, error counters below the warning limit (96)
+    STATUS_ERROR_ACTIVE,    // Error active, an error counter reached the warning limit
+    STATUS_BUS_OFF,         // Bus-off or recovering from bus-off
+    STATUS_ERROR_PASSIVE    // An error counter reached 128
+};
+
+/**
+ * @brief Bus statistics maintained by the CAN core implementation.
+ * @details Counters are cumulative since begin(). Implementations which cannot provide a value leave it at 0.
+ */
+struct Statistics {
+    uint32_t    rxFrames;           // Frames received from the bus
+    uint32_t    txFrames;           // Frames accepted for transmission
+    uint32_t    txFailed;           // Frames the controller failed to transmit
+    uint32_t    rxOverruns;         // Frames lost because a receive queue or FIFO was full
+    uint32_t    busErrors;
+    uint32_t    arbitrationLost;
+    uint32_t    busOffCount;
+    uint32_t    lastRecoveryMs;     // Downtime of the last bus-off until the controller was running again
+    uint8_t     txErrorCounter;
+    uint8_t     rxErrorCounter;
+    uint16_t    busLoad;            // Estimated bus load in permille
 };
 
 enum FilterType {
@@ -62,9 +82,120 @@ enum FilterType {
     virtual uint8_t available()=0;
     virtual bool setupFilter(uint32_t id, uint32_t mask)=0;
 
+    /**
+     * @brief Read a received frame including its receive timestamp.
+     * @details The default implementation stamps the frame when it is read. Implementations which buffer frames
+     *          override this function to return the time the frame was received from the bus.
+     * @param frame Destination of the frame, the timestamp is based on micros().
+     * @return true if a frame was read, false otherwise.
+     */
+    virtual bool readFrame(CANFrame& frame) {
+        CANMessage message;
+        if(!readMessage(message)) return false;
+        frame = toFrame(message, micros());
+        return true;
+    }
+
+    /**
+     * @brief Enable or disable the listen-only mode. Must be called before begin().
+     * @details In listen-only mode the controller neither acknowledges frames nor sends error frames or messages,
+     *          so the node cannot disturb the bus, e.g. while the baudrate is unknown.
+     * @param enabled True to only listen.
+     * @return false if the core is already initialized.
+     */
+    virtual bool setListenOnly(bool enabled) {
+        if(_isInitialized) {
+            ERROR_PRINTLN("[CANCore] Cannot change listen-only mode while initialized. Call setListenOnly(...) before begin().");
+            return false;
+        }
+        _listenOnly = enabled;
+        return true;
+    }
+
+    /**
+     * @brief Attach a table of automatic responses and periodic frames which the core sends on its own.
+     * @details Received remote frames answered by the responder are not passed to readMessage(). Periodic frames are sent on the
+     *          schedule of the core, independent of the application loop. Not supported by every core.
+     * @param responder Responder, nullptr to detach it. Must stay valid while attached.
+     * @return false if the core does not support a responder.
+     */
+    virtual bool setResponder(CANResponder* responder) {
+        DEV_ERROR_PRINTLN("[CANCore] Responder not supported by this CAN core.");
+        return false;
+    }
+
+    CANResponder* getResponder() const { return _responder; }
+
+    /**
+     * @brief Timestamp the end of the transmission of frames with the given identifier, see readTxTimestamp().
+     * @details Used by two-step protocols which send the transmit time of a frame in a follow-up frame, e.g. CANTimeSync.
+     *          Only one identifier is timestamped at a time. Not supported by every core.
+     * @param id Standard identifier.
+     * @return false if the core does not support transmit timestamps.
+     */
+    virtual bool enableTxTimestamp(uint32_t id) { return false; }
+
+    virtual void disableTxTimestamp() {}
+
+    /**
+     * @brief Read the last frame with the identifier set by enableTxTimestamp() which was transmitted successfully.
+     * @param frame Destination of the frame, the timestamp is the micros() time the transmission was completed.
+     * @return true if such a frame was transmitted since the last call.
+     */
+    virtual bool readTxTimestamp(CANFrame& frame) { return false; }
+
+    /**
+     * @brief Get the number of bits a frame occupies on the bus, see CANFrame::getBusBits().
+     */
+    static uint16_t getFrameBits(uint8_t length, bool isExtended) {
+        return CANFrame::getBusBits(length, isExtended);
+    }
+
+    /**
+     * @brief Get the duration of a frame on the bus.
+     * @param length Number of data bytes (0-8).
+     * @param isExtended True for 29-bit identifiers.
+     * @param baudrate Bus baudrate.
+     * @return uint32_t Duration in microseconds, 0 if the baudrate is not set.
+     */
+    static uint32_t getFrameDurationUs(uint8_t length, bool isExtended, Baudrate baudrate) {
+        if(baudrate == BR_NOT_SET) return 0;
+        return (uint32_t(getFrameBits(length, isExtended)) * 1000000UL + baudrate - 1) / baudrate;
+    }
+
+    /**
+     * @brief Convert a message into a compact, timestamped frame.
+     */
+    static CANFrame toFrame(const CANMessage& message, uint32_t timestamp) {
+        CANFrame frame;
+        frame.set(message.id, message.isExtended, message.isRemote, message.data, message.length, timestamp);
+        if(message.error) frame.idFlags |= CANFrame::FLAG_ERROR;
+        return frame;
+    }
+
+    /**
+     * @brief Convert a compact frame into a message.
+     */
+    static void fromFrame(const CANFrame& frame, CANMessage& message) {
+        message.id = frame.getId();
+        message.isExtended = frame.isExtended();
+        message.isRemote = frame.isRemote();
+        message.error = frame.isError();
+        message.length = frame.getLength();
+        memcpy(message.data, frame.data, 8);
+    }
+
     Baudrate getBaudrate() const { return _baudrate; }
     uint8_t getTxPin() const { return _txPin; }
     uint8_t getRxPin() const { return _rxPin; }
+    bool isInitialized() const { return _isInitialized; }
+    bool isListenOnly() const { return _listenOnly; }
+    /**
+     * @brief Get the bus status and a copy of the bus statistics.
+     * @details Implementations which update them from another task override both functions to return a consistent snapshot.
+     */
+    virtual Status getStatus() const { return _status; }
+    virtual Statistics getStatistics() const { return _statistics; }
 
     virtual bool reset() override {
         INFO_PRINTLN("[CANCore] Resetting CAN core.");
@@ -77,7 +208,9 @@ enum FilterType {
         _filterMask = 0;
         _baudrate = BR_NOT_SET;
         _filterType = FILTER_ACCEPT_ALL;
+        _listenOnly = false;
         _status = STATUS_OK;
+        _statistics = {};
         success &= HardwareResource::reset();
         return success;
     }
@@ -92,7 +225,10 @@ enum FilterType {
     int8_t  _txPin = -1;
     int8_t  _rxPin = -1;
     Status   _status = STATUS_OK;
+    Statistics _statistics = {};
     bool    _isInitialized = false;
+    bool    _listenOnly = false;
+    CANResponder* volatile _responder = nullptr;
     uint32_t _filterId = 0;
     uint32_t _filterMask = 0;
 
@@ -0,0 +1,492 @@
+#ifndef CANDBC_H
+#define CANDBC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @file CANDBC.h
+ * @brief Signal codec for CAN frames described in DBC format.
+ * @details Reads the message (BO_) and signal (SG_) definitions of a DBC file, all other lines are ignored. Multiplexed signals
+ *          are not supported. The payload of a frame is handled as one 64 bit word with data[0] in the lowest byte, see load().
+ *          Intel (little endian) signals are shifted and masked out of this word, Motorola (big endian) signals out of the
+ *          byte-swapped word, so every signal costs one shift and one mask.
+ *
+ *          Two ways to use a description:
+ *          - Generated code: generate() writes a header with one struct per message and constexpr decode/encode functions whose
+ *            shifts, masks and scaling are constants, see tools/candbc_generate.cpp:
+ *
+ *                VehicleBus::EEC1 eec1 = VehicleBus::EEC1::decode(CANDBC::load(message.data, message.length));
+ *
+ *          - Interpreter: Database::parse() reads a description at runtime, e.g. a configuration loaded from flash, and
+ *            getValue()/setValue() decode and encode with the parsed signal definitions.
+ *
+ *          Physical values are scaled with factor and offset. Encoding rounds to the nearest raw value and saturates at the
+ *          range of the signal.
+ */
+namespace CANDBC {
+
+static constexpr size_t MAX_MESSAGES = 32;
+static constexpr size_t MAX_SIGNALS = 128;
+static constexpr size_t MAX_NAME = 24;          // Including terminating zero
+static constexpr size_t MAX_UNIT = 12;          // Including terminating zero
+static constexpr uint32_t EXTENDED_ID_FLAG = 0x80000000;    // Marks extended identifiers in DBC files
+
+constexpr uint64_t byteSwap(uint64_t value) {
+    return (value >> 56) | ((value >> 40) & 0xFF00ULL) | ((value >> 24) & 0xFF0000ULL) | ((value >> 8) & 0xFF000000ULL)
+           | ((value & 0xFF000000ULL) << 8) | ((value & 0xFF0000ULL) << 24) | ((value & 0xFF00ULL) << 40) | (value << 56);
+}
+
+constexpr uint64_t mask(uint8_t length) {
+    return length >= 64 ? ~0ULL : (1ULL << length) - 1;
+}
+
+/**
+ * @brief Interpret the lowest length bits of a raw value as two's complement number.
+ */
+constexpr int64_t signExtend(uint64_t raw, uint8_t length) {
+    return length >= 64 ? int64_t(raw) : int64_t((raw ^ (1ULL << (length - 1))) - (1ULL << (length - 1)));
+}
+
+/**
+ * @brief Round a scaled value to the nearest raw value within [0, max].
+ */
+template<typename T>
+constexpr uint64_t saturateUnsigned(T value, uint64_t max) {
+    return !(value > T(0)) ? 0 : value >= T(max) ? max : uint64_t(value + T(0.5)) > max ? max : uint64_t(value + T(0.5));
+}
+
+/**
+ * @brief Round a scaled value to the nearest raw value within [min, max].
+ */
+template<typename T>
+constexpr int64_t saturateSigned(T value, int64_t min, int64_t max) {
+    return value <= T(min) ? min : value >= T(max) ? max : value >= T(0) ? int64_t(value + T(0.5)) : -int64_t(T(0.5) - value);
+}
+
+/**
+ * @brief Get the payload of a frame as 64 bit word, data[0] in the lowest byte.
+ */
+inline uint64_t load(const uint8_t* data, uint8_t length) {
+    uint64_t payload = 0;
+    for(uint8_t i=0; i<length && i<8; i++) payload |= uint64_t(data[i]) << (8 * i);
+    return payload;
+}
+
+/**
+ * @brief Write a payload word into the data bytes of a frame.
+ */
+inline void store(uint64_t payload, uint8_t* data, uint8_t length) {
+    for(uint8_t i=0; i<length && i<8; i++) data[i] = (payload >> (8 * i)) & 0xFF;
+}
+
+struct Signal {
+    char        name[MAX_NAME];
+    char        unit[MAX_UNIT];
+    uint8_t     startBit;       // As in the DBC file: LSB for Intel, MSB in sawtooth numbering for Motorola signals
+    uint8_t     length;         // 1-64 bits
+    uint8_t     shift;          // Position of the LSB in the payload word (Intel) or the byte-swapped payload word (Motorola)
+    bool        littleEndian;   // Intel byte order
+    bool        isSigned;
+    double      factor;
+    double      offset;
+    double      minimum;
+    double      maximum;
+};
+
+struct Message {
+    char        name[MAX_NAME];
+    uint32_t    id;
+    bool        extended;
+    uint8_t     dlc;
+    uint16_t    firstSignal;    // Index into the signal table of the database
+    uint8_t     signalCount;
+};
+
+/**
+ * @brief Get the raw value of a signal.
+ * @param payload Payload word, see load().
+ */
+inline uint64_t getRaw(const Signal& signal, uint64_t payload) {
+    uint64_t word = signal.littleEndian ? payload : byteSwap(payload);
+    return (word >> signal.shift) & mask(signal.length);
+}
+
+/**
+ * @brief Replace the raw value of a signal.
+ * @return uint64_t The new payload word.
+ */
+inline uint64_t setRaw(const Signal& signal, uint64_t payload, uint64_t raw) {
+    uint64_t bits = mask(signal.length) << signal.shift;
+    if(signal.littleEndian) return (payload & ~bits) | ((raw << signal.shift) & bits);
+    uint64_t word = byteSwap(payload);
+    return byteSwap((word & ~bits) | ((raw << signal.shift) & bits));
+}
+
+/**
+ * @brief Get the physical value of a signal.
+ */
+inline double getValue(const Signal& signal, uint64_t payload) {
+    uint64_t raw = getRaw(signal, payload);
+    double value = signal.isSigned ? double(signExtend(raw, signal.length)) : double(raw);
+    return value * signal.factor + signal.offset;
+}
+
+/**
+ * @brief Get the raw value of a physical value, rounded and saturated at the range of the signal.
+ */
+inline uint64_t toRaw(const Signal& signal, double value) {
+    double scaled = (value - signal.offset) / signal.factor;
+    if(!signal.isSigned) return saturateUnsigned(scaled, mask(signal.length));
+    int64_t max = int64_t(mask(signal.length) >> 1);
+    return uint64_t(saturateSigned(scaled, -max - 1, max)) & mask(signal.length);
+}
+
+/**
+ * @brief Replace the physical value of a signal.
+ * @return uint64_t The new payload word.
+ */
+inline uint64_t setValue(const Signal& signal, uint64_t payload, double value) {
+    return setRaw(signal, payload, toRaw(signal, value));
+}
+
+/**
+ * @class Database
+ * @brief Messages and signals of a parsed description.
+ */
+class Database {
+public:
+    /**
+     * @brief Parse a description. Previously parsed messages are discarded.
+     * @param text DBC text, terminated by a zero byte.
+     * @return true if the description was read completely, see getErrorLine() otherwise.
+     */
+    bool parse(const char* text) {
+        _messageCount = 0;
+        _signalCount = 0;
+        _errorLine = 0;
+        size_t lineNumber = 0;
+        char line[256];
+        while(*text) {
+            size_t length = strcspn(text, "\r\n");
+            lineNumber++;
+            bool truncated = length >= sizeof(line);      // Only allowed for ignored lines, e.g. long comments
+            size_t copied = truncated ? sizeof(line) - 1 : length;
+            memcpy(line, text, copied);
+            line[copied] = '\0';
+            text += length;
+            if(*text == '\r') text++;
+            if(*text == '\n') text++;
+            const char* position = skipSpace(line);
+            bool ok = true;
+            if(startsWith(position, "BO_ ")) ok = !truncated && parseMessage(position + 4);
+            else if(startsWith(position, "SG_ ")) ok = !truncated && parseSignal(position + 4);
+            if(!ok) return fail(lineNumber);
+        }
+        return true;
+    }
+
+    size_t getMessageCount() const { return _messageCount; }
+    const Message& getMessage(size_t index) const { return _messages[index]; }
+    const Signal* getSignals(const Message& message) const { return &_signals[message.firstSignal]; }
+
+    /**
+     * @brief Get the line number of the first line which could not be read, 0 if parsing succeeded.
+     */
+    size_t getErrorLine() const { return _errorLine; }
+
+    const Message* findMessage(uint32_t id, bool extended) const {
+        for(size_t i=0; i<_messageCount; i++) {
+            if(_messages[i].id == id && _messages[i].extended == extended) return &_messages[i];
+        }
+        return nullptr;
+    }
+
+    const Message* findMessage(const char* name) const {
+        for(size_t i=0; i<_messageCount; i++) {
+            if(strcmp(_messages[i].name, name) == 0) return &_messages[i];
+        }
+        return nullptr;
+    }
+
+    const Signal* findSignal(const Message& message, const char* name) const {
+        for(uint8_t i=0; i<message.signalCount; i++) {
+            if(strcmp(_signals[message.firstSignal + i].name, name) == 0) return &_signals[message.firstSignal + i];
+        }
+        return nullptr;
+    }
+
+private:
+    Message _messages[MAX_MESSAGES];
+    Signal _signals[MAX_SIGNALS];
+    size_t _messageCount = 0;
+    size_t _signalCount = 0;
+    size_t _errorLine = 0;
+
+    bool fail(size_t lineNumber) {
+        _errorLine = lineNumber;
+        return false;
+    }
+
+    static bool startsWith(const char* text, const char* prefix) { return strncmp(text, prefix, strlen(prefix)) == 0; }
+
+    static const char* skipSpace(const char* text) {
+        while(*text == ' ' || *text == '\t') text++;
+        return text;
+    }
+
+    /**
+     * @brief Read a C identifier.
+     * @return const char* Position after the identifier, nullptr if there is none or it is too long.
+     */
+    static const char* readName(const char* text, char* name) {
+        text = skipSpace(text);
+        size_t length = 0;
+        while((text[length] >= 'A' && text[length] <= 'Z') || (text[length] >= 'a' && text[length] <= 'z') || text[length] == '_'
+              || (length > 0 && text[length] >= '0' && text[length] <= '9')) length++;
+        if(length == 0 || length >= MAX_NAME) return nullptr;
+        memcpy(name, text, length);
+        name[length] = '\0';
+        return text + length;
+    }
+
+    static const char* expect(const char* text, char character) {
+        text = skipSpace(text);
+        return *text == character ? text + 1 : nullptr;
+    }
+
+    static const char* readNumber(const char* text, double& value) {
+        char* end;
+        value = strtod(skipSpace(text), &end);
+        return end == skipSpace(text) ? nullptr : end;
+    }
+
+    /**
+     * @brief BO_ <id> <name>: <dlc> <transmitter>
+     */
+    bool parseMessage(const char* text) {
+        if(_messageCount >= MAX_MESSAGES) return false;
+        Message& message = _messages[_messageCount];
+        char* end;
+        unsigned long id = strtoul(skipSpace(text), &end, 10);
+        if(end == skipSpace(text)) return false;
+        text = readName(end, message.name);
+        if(text == nullptr || (text = expect(text, ':')) == nullptr) return false;
+        unsigned long dlc = strtoul(skipSpace(text), &end, 10);
+        if(end == skipSpace(text) || dlc > 8) return false;
+        message.extended = id & EXTENDED_ID_FLAG;
+        message.id = id & ~EXTENDED_ID_FLAG;
+        if(message.id > (message.extended ? 0x1FFFFFFFUL : 0x7FFUL)) return false;
+        message.dlc = dlc;
+        message.firstSignal = _signalCount;
+        message.signalCount = 0;
+        _messageCount++;
+        return true;
+    }
+
+    /**
+     * @brief SG_ <name> : <start>|<length>@<order><sign> (<factor>,<offset>) [<min>|<max>] "<unit>" <receivers>
+     */
+    bool parseSignal(const char* text) {
+        if(_messageCount == 0 || _signalCount >= MAX_SIGNALS) return false;
+        Message& message = _messages[_messageCount - 1];
+        if(message.signalCount == 0xFF) return false;
+        Signal& signal = _signals[_signalCount];
+        text = readName(text, signal.name);
+        if(text == nullptr || (text = expect(text, ':')) == nullptr) return false;      // Multiplexer indicators end up here
+        double start, length, factor, offset, minimum, maximum;
+        if((text = readNumber(text, start)) == nullptr || (text = expect(text, '|')) == nullptr
+           || (text = readNumber(text, length)) == nullptr || (text = expect(text, '@')) == nullptr) return false;
+        if((*text != '0' && *text != '1') || (text[1] != '+' && text[1] != '-')) return false;
+        signal.littleEndian = *text == '1';
+        signal.isSigned = text[1] == '-';
+        text += 2;
+        if((text = expect(text, '(')) == nullptr || (text = readNumber(text, factor)) == nullptr || (text = expect(text, ',')) == nullptr
+           || (text = readNumber(text, offset)) == nullptr || (text = expect(text, ')')) == nullptr
+           || (text = expect(text, '[')) == nullptr || (text = readNumber(text, minimum)) == nullptr || (text = expect(text, '|')) == nullptr
+           || (text = readNumber(text, maximum)) == nullptr || (text = expect(text, ']')) == nullptr
+           || (text = expect(text, '"')) == nullptr) return false;
+        const char* unitEnd = strchr(text, '"');
+        if(unitEnd == nullptr || size_t(unitEnd - text) >= MAX_UNIT) return false;
+        memcpy(signal.unit, text, unitEnd - text);
+        signal.unit[unitEnd - text] = '\0';
+
+        if(length < 1 || length > 64 || start < 0 || start > 63 || factor == 0) return false;
+        signal.startBit = uint8_t(start);
+        signal.length = uint8_t(length);
+        signal.factor = factor;
+        signal.offset = offset;
+        signal.minimum = minimum;
+        signal.maximum = maximum;
+        if(signal.littleEndian) {
+            if(signal.startBit + signal.length > message.dlc * 8) return false;
+            signal.shift = signal.startBit;
+        } else {
+            int msb = (7 - signal.startBit / 8) * 8 + signal.startBit % 8;
+            int lsb = msb - signal.length + 1;
+            if(lsb < 64 - message.dlc * 8) return false;
+            signal.shift = uint8_t(lsb);
+        }
+        for(uint8_t i=0; i<message.signalCount; i++) {
+            if(strcmp(_signals[message.firstSignal + i].name, signal.name) == 0) return false;
+        }
+        message.signalCount++;
+        _signalCount++;
+        return true;
+    }
+};
+
+/**
+ * @brief Get the C++ type of the physical value of a signal in generated code.
+ * @details Signals without scaling keep the smallest integer type of their raw value, scaled signals use float,
+ *          or double for more than 24 bits.
+ */
+inline const char* valueType(const Signal& signal) {
+    if(signal.factor != 1 || signal.offset != 0) return signal.length > 24 ? "double" : "float";
+    if(signal.isSigned) return signal.length <= 8 ? "int8_t" : signal.length <= 16 ? "int16_t" : signal.length <= 32 ? "int32_t" : "int64_t";
+    return signal.length <= 8 ? "uint8_t" : signal.length <= 16 ? "uint16_t" : signal.length <= 32 ? "uint32_t" : "uint64_t";
+}
+
+/**
+ * @brief Write a floating point literal, e.g. "0.125f".
+ */
+inline void formatLiteral(double value, bool isFloat, char* out, size_t size) {
+    int length = snprintf(out, size, isFloat ? "%.9g" : "%.17g", value);
+    if(length < 0 || size_t(length) + 3 > size) return;
+    if(strpbrk(out, ".eEn") == nullptr) strcat(out, ".0");
+    if(isFloat) strcat(out, "f");
+}
+
+/**
+ * @brief Generate a C++ header with constexpr decode and encode functions for all messages of a database.
+ * @details Every message becomes a struct named after the message with the identifier, the physical values of its signals
+ *          and the following functions:
+ *          - static constexpr <Message> decode(uint64_t payload): decode all signals of a payload word, see load().
+ *          - constexpr uint64_t encode() const: encode all signals into a payload word, see store().
+ *          - static constexpr <type> decode<Signal>(uint64_t payload) and static constexpr uint64_t encode<Signal>(<type> value)
+ *            for single signals. encode<Signal>() returns the signal bits only, combine several signals with '|'.
+ *          The generated functions are single expressions of shifts, masks and constant scaling, so they also work as C++11 constexpr.
+ *
+ *              CANDBC::generate(database, "VehicleBus", "vehicle.dbc", [](const char* text) { fputs(text, stdout); });
+ *
+ * @param database Parsed description.
+ * @param name Namespace of the generated code, also used for the include guard.
+ * @param source Name of the description file, written into the header comment.
+ * @param write Called with consecutive pieces of the generated text.
+ * @return true if the code was generated, false if a signal name collides with a generated member.
+ */
+template<typename Writer>
+bool generate(const Database& database, const char* name, const char* source, Writer&& write) {
+    static const char* const RESERVED[] = {"ID", "EXTENDED", "DLC", "decode", "encode"};
+    for(size_t m=0; m<database.getMessageCount(); m++) {
+        const Message& message = database.getMessage(m);
+        for(uint8_t s=0; s<message.signalCount; s++) {
+            for(const char* reserved : RESERVED) {
+                if(strcmp(database.getSignals(message)[s].name, reserved) == 0) return false;
+            }
+        }
+    }
+
+    char text[512];
+    char guard[MAX_NAME + 8];
+    size_t i = 0;
+    for(; name[i] && i < MAX_NAME; i++) guard[i] = (name[i] >= 'a' && name[i] <= 'z') ? name[i] - 'a' + 'A' : name[i];
+    strcpy(&guard[i], "_H");
+    snprintf(text, sizeof(text), "// Generated by candbc_generate from %s. Do not edit.\n#ifndef %s\n#define %s\n\n#include <stdint.h>\n#include \"CANDBC.h\"\n\nnamespace %s {\n",
+             source, guard, guard, name);
+    write(text);
+
+    for(size_t m=0; m<database.getMessageCount(); m++) {
+        const Message& message = database.getMessage(m);
+        const Signal* signals = database.getSignals(message);
+        snprintf(text, sizeof(text), "\n/**\n * @brief %s, ID 0x%0*lX%s, DLC %u.\n */\nstruct %s {\n"
+                 "    static constexpr uint32_t ID = 0x%0*lX;\n    static constexpr bool EXTENDED = %s;\n    static constexpr uint8_t DLC = %u;\n\n",
+                 message.name, message.extended ? 8 : 3, (unsigned long)message.id, message.extended ? " (extended)" : "", message.dlc, message.name,
+                 message.extended ? 8 : 3, (unsigned long)message.id, message.extended ? "true" : "false", message.dlc);
+        write(text);
+
+        //Members
+        for(uint8_t s=0; s<message.signalCount; s++) {
+            const Signal& signal = signals[s];
+            char minimum[32], maximum[32];
+            snprintf(minimum, sizeof(minimum), "%.9g", signal.minimum);
+            snprintf(maximum, sizeof(maximum), "%.9g", signal.maximum);
+            int padding = int(MAX_NAME + 9 - strlen(valueType(signal)) - strlen(signal.name));
+            snprintf(text, sizeof(text), "    %s %s;%*s// %s%s[%s, %s]\n", valueType(signal), signal.name,
+                     padding > 1 ? padding : 1, "", signal.unit, signal.unit[0] ? " " : "", minimum, maximum);
+            write(text);
+        }
+
+        //Message decode and encode
+        snprintf(text, sizeof(text), "\n    static constexpr %s decode(uint64_t payload) {\n        return %s{", message.name, message.name);
+        write(text);
+        for(uint8_t s=0; s<message.signalCount; s++) {
+            snprintf(text, sizeof(text), "%sdecode%s(payload)", s > 0 ? ", " : "", signals[s].name);
+            write(text);
+        }
+        write("};\n    }\n\n    constexpr uint64_t encode() const {\n        return ");
+        if(message.signalCount == 0) write("0");
+        for(uint8_t s=0; s<message.signalCount; s++) {
+            snprintf(text, sizeof(text), "%sencode%s(%s)", s > 0 ? " | " : "", signals[s].name, signals[s].name);
+            write(text);
+        }
+        write(";\n    }\n");
+
+        //Signal functions
+        for(uint8_t s=0; s<message.signalCount; s++) {
+            const Signal& signal = signals[s];
+            const char* type = valueType(signal);
+            bool scaled = signal.factor != 1 || signal.offset != 0;
+            bool isFloat = strcmp(type, "float") == 0;
+            uint64_t rawMax = mask(signal.length);
+            char factor[32], inverse[32], offset[32];
+            formatLiteral(signal.factor, isFloat, factor, sizeof(factor));
+            formatLiteral(1.0 / signal.factor, isFloat, inverse, sizeof(inverse));
+            formatLiteral(signal.offset < 0 ? -signal.offset : signal.offset, isFloat, offset, sizeof(offset));
+
+            //Decode: shift and mask the raw value, sign extension, scaling
+            char bits[64], raw[96], value[192];
+            const char* word = signal.littleEndian ? "payload" : "CANDBC::byteSwap(payload)";
+            if(signal.shift > 0) snprintf(bits, sizeof(bits), "(%s >> %u) & 0x%llXULL", word, signal.shift, (unsigned long long)rawMax);
+            else snprintf(bits, sizeof(bits), "%s & 0x%llXULL", word, (unsigned long long)rawMax);
+            if(signal.isSigned) snprintf(raw, sizeof(raw), "CANDBC::signExtend(%s, %u)", bits, signal.length);
+            else snprintf(raw, sizeof(raw), "%s", bits);
+            snprintf(value, sizeof(value), "%s(%s)%s%s%s%s", type, raw, signal.factor != 1 ? " * " : "", signal.factor != 1 ? factor : "",
+                     signal.offset == 0 ? "" : signal.offset < 0 ? " - " : " + ", signal.offset != 0 ? offset : "");
+            snprintf(text, sizeof(text), "\n    static constexpr %s decode%s(uint64_t payload) {\n        return %s;\n    }\n", type, signal.name, value);
+            write(text);
+
+            //Encode: scaling, rounding and saturation, mask and shift
+            char scaledValue[96], rawValue[192], packed[256];
+            if(signal.offset != 0) snprintf(scaledValue, sizeof(scaledValue), "(value %s %s)", signal.offset < 0 ? "+" : "-", offset);
+            else snprintf(scaledValue, sizeof(scaledValue), "value");
+            if(signal.factor != 1) snprintf(&scaledValue[strlen(scaledValue)], sizeof(scaledValue) - strlen(scaledValue), " * %s", inverse);
+            if(!scaled && (signal.length == 64 || (!signal.isSigned && (signal.length == 8 || signal.length == 16 || signal.length == 32)))) {
+                snprintf(rawValue, sizeof(rawValue), "uint64_t(value)");       // Range of the type equals the range of the signal
+            } else if(signal.isSigned) {
+                snprintf(rawValue, sizeof(rawValue), "uint64_t(CANDBC::saturateSigned<%s>(%s, %lldLL, %lldLL))", scaled ? type : "int64_t", scaledValue,
+                         -(long long)(rawMax >> 1) - 1, (long long)(rawMax >> 1));
+            } else {
+                snprintf(rawValue, sizeof(rawValue), "CANDBC::saturateUnsigned<%s>(%s, 0x%llXULL)", scaled ? type : "uint64_t", scaledValue,
+                         (unsigned long long)rawMax);
+            }
+            if(signal.length == 64) snprintf(packed, sizeof(packed), "%s", rawValue);
+            else if(signal.shift > 0) snprintf(packed, sizeof(packed), "(%s & 0x%llXULL) << %u", rawValue, (unsigned long long)rawMax, signal.shift);
+            else snprintf(packed, sizeof(packed), "%s & 0x%llXULL", rawValue, (unsigned long long)rawMax);
+            snprintf(text, sizeof(text), "\n    static constexpr uint64_t encode%s(%s value) {\n        return %s%s%s;\n    }\n", signal.name, type,
+                     signal.littleEndian ? "" : "CANDBC::byteSwap(", packed, signal.littleEndian ? "" : ")");
+            write(text);
+        }
+        write("};\n");
+    }
+    snprintf(text, sizeof(text), "\n}   // namespace %s\n\n#endif // %s\n", name, guard);
+    write(text);
+    return true;
+}
+
+}   // namespace CANDBC
+
+#endif // CANDBC_H
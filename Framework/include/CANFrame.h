@@ -0,0 +1,84 @@
+#ifndef CANFRAME_H
+#define CANFRAME_H
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @file CANFrame.h
+ * @brief Declaration of the CANFrame struct.
+ * @details Defines a compact, timestamped CAN frame used for buffering and recording. Identifier and flags share one word,
+ *          DLC and timestamp share the second word, so a frame occupies 16 bytes and four frames fill a 64 byte cache line.
+ */
+struct CANFrame {
+    static constexpr uint32_t ID_MASK       = 0x1FFFFFFF;
+    static constexpr uint32_t FLAG_EXTENDED = 1UL << 29;
+    static constexpr uint32_t FLAG_REMOTE   = 1UL << 30;
+    static constexpr uint32_t FLAG_ERROR    = 1UL << 31;
+    static constexpr uint32_t TIMESTAMP_MASK = 0x0FFFFFFF; // 28 bit microsecond timestamp, wraps after ~268 s
+
+    uint32_t idFlags;       // Bit 0-28 identifier, bit 29 extended, bit 30 remote, bit 31 error
+    uint32_t dlcTimestamp;  // Bit 28-31 DLC, bit 0-27 timestamp in microseconds
+    uint8_t  data[8];
+
+    uint32_t getId() const { return idFlags & ID_MASK; }
+    bool isExtended() const { return idFlags & FLAG_EXTENDED; }
+    bool isRemote() const { return idFlags & FLAG_REMOTE; }
+    bool isError() const { return idFlags & FLAG_ERROR; }
+    uint8_t getLength() const { return dlcTimestamp >> 28; }
+    uint32_t getTimestamp() const { return dlcTimestamp & TIMESTAMP_MASK; }
+
+    /**
+     * @brief Fill the frame.
+     * @param id 11-bit or 29-bit identifier.
+     * @param extended True for 29-bit identifiers.
+     * @param remote True for remote frames.
+     * @param payload Data bytes, may be nullptr for remote frames.
+     * @param length Number of data bytes (0-8), larger values are limited to 8.
+     * @param timestamp Timestamp in microseconds, only the lower 28 bits are stored.
+     */
+    void set(uint32_t id, bool extended, bool remote, const uint8_t* payload, uint8_t length, uint32_t timestamp) {
+        if(length > 8) length = 8;
+        idFlags = (id & ID_MASK) | (extended ? FLAG_EXTENDED : 0) | (remote ? FLAG_REMOTE : 0);
+        dlcTimestamp = (uint32_t(length) << 28) | (timestamp & TIMESTAMP_MASK);
+        memset(data, 0, sizeof(data));
+        if(payload && !remote) memcpy(data, payload, length);
+    }
+
+    /**
+     * @brief Get the number of bits a frame occupies on the bus.
+     * @details Includes SOF, arbitration, control, data, CRC, ACK, EOF and intermission. Stuff bits are counted for the worst case.
+     * @param length Number of data bytes (0-8).
+     * @param isExtended True for 29-bit identifiers.
+     * @return uint16_t Number of bits on the bus.
+     */
+    static uint16_t getBusBits(uint8_t length, bool isExtended) {
+        uint16_t stuffed = (isExtended ? 54 : 34) + 8 * length;     // Bits subject to bit stuffing
+        return stuffed + (stuffed - 1) / 4 + 13;                    // Worst case stuffing + CRC delimiter, ACK, EOF, IFS
+    }
+
+    /**
+     * @brief Get the arbitration field as sent on the bus, a lower value wins the arbitration.
+     * @details Base ID, RTR/SRR, IDE, extended ID bits and RTR of extended frames, dominant bits are 0.
+     */
+    uint32_t getArbitrationKey() const {
+        uint32_t id = getId();
+        if(!isExtended()) {
+            return ((id & 0x7FF) << 20) | (isRemote() ? 1UL << 19 : 0);
+        }
+        return ((id >> 18) << 20) | (1UL << 19) | (1UL << 18) | ((id & 0x3FFFF) << 1) | (isRemote() ? 1 : 0);
+    }
+
+    void setTimestamp(uint32_t timestamp) { dlcTimestamp = (dlcTimestamp & ~TIMESTAMP_MASK) | (timestamp & TIMESTAMP_MASK); }
+
+    /**
+     * @brief Reconstruct the full 32-bit timestamp.
+     * @param now Current time in microseconds, must be less than ~268 s after the frame was stamped.
+     * @return uint32_t Timestamp in the time base of now.
+     */
+    uint32_t expandTimestamp(uint32_t now) const { return now - ((now - getTimestamp()) & TIMESTAMP_MASK); }
+};
+
+static_assert(sizeof(CANFrame) == 16, "CANFrame must stay 16 bytes");
+
+#endif // CANFRAME_H
@@ -0,0 +1,107 @@
+#ifndef CANFRAME_RING_H
+#define CANFRAME_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "CANFrame.h"
+
+/**
+ * @file CANFrameRing.h
+ * @brief Declaration of the CANFrameRing class.
+ * @details Defines a lock-free single-producer/single-consumer ring buffer of CANFrame objects.
+ *          Exactly one task (or ISR) may call push(), exactly one other task may call pop()/peek()/drop().
+ *          Head and tail live in separate cache lines so producer and consumer do not invalidate each other's line
+ *          on every access, and each side caches the other side's index to reduce shared reads.
+ */
+
+#ifndef CANFRAME_RING_ALIGNMENT
+#define CANFRAME_RING_ALIGNMENT 64
+#endif
+
+template<size_t Capacity>
+class CANFrameRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+public:
+    CANFrameRing() = default;
+    CANFrameRing(const CANFrameRing&) = delete;
+    CANFrameRing& operator=(const CANFrameRing&) = delete;
+
+    /**
+     * @brief Append a frame (producer side).
+     * @return true if the frame was stored, false if the ring is full. Rejected frames are counted, see getDropped().
+     */
+    bool push(const CANFrame& frame) {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        if(head - _tailCache >= Capacity) {
+            _tailCache = _tail.load(std::memory_order_acquire);
+            if(head - _tailCache >= Capacity) {
+                _dropped.store(_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        _frames[head & MASK] = frame;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Get the oldest frame without removing it (consumer side).
+     * @return Pointer to the frame, nullptr if the ring is empty. Valid until drop() or pop() is called.
+     */
+    const CANFrame* peek() {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if(tail == _headCache) {
+            _headCache = _head.load(std::memory_order_acquire);
+            if(tail == _headCache) return nullptr;
+        }
+        return &_frames[tail & MASK];
+    }
+
+    /**
+     * @brief Remove the oldest frame after peek() (consumer side).
+     */
+    void drop() {
+        _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Remove the oldest frame (consumer side).
+     * @return true if a frame was copied into frame, false if the ring is empty.
+     */
+    bool pop(CANFrame& frame) {
+        const CANFrame* next = peek();
+        if(next == nullptr) return false;
+        frame = *next;
+        drop();
+        return true;
+    }
+
+    /**
+     * @brief Remove all frames (consumer side).
+     */
+    void clear() {
+        _tail.store(_head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    size_t size() const { return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire); }
+    bool empty() const { return size() == 0; }
+    static constexpr size_t capacity() { return Capacity; }
+    uint32_t getDropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr uint32_t MASK = Capacity - 1;
+
+    //Producer line
+    alignas(CANFRAME_RING_ALIGNMENT) std::atomic<uint32_t> _head{0};
+    uint32_t _tailCache = 0;
+    std::atomic<uint32_t> _dropped{0};
+
+    //Consumer line
+    alignas(CANFRAME_RING_ALIGNMENT) std::atomic<uint32_t> _tail{0};
+    uint32_t _headCache = 0;
+
+    alignas(CANFRAME_RING_ALIGNMENT) CANFrame _frames[Capacity];
+};
+
+#endif // CANFRAME_RING_H
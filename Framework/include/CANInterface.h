@@ -11,6 +11,39 @@
  * @details Defines the CANInterface class which represents a CAN bus interface in the CANTram system.
  */
 
+/**
+ * @class CANListener
+ * @brief Receiver for CAN frames dispatched by CANInterface::process().
+ * @details Protocol layers (e.g. SDO server) derive from this class and register themselves at a CANInterface.
+ *          Every received frame is offered to the registered listeners in registration order until one consumes it.
+ */
+class CANListener {
+public:
+    /**
+     * @brief Handle a received CAN frame.
+     * @param message The received frame.
+     * @return true if the frame was consumed and should not be offered to further listeners, false otherwise.
+     */
+    virtual bool onMessage(const CANCore::CANMessage& message) = 0;
+
+    /**
+     * @brief Notification about a frame sent through CANInterface::sendMessage().
+     * @details Called for every registered listener after the frame was accepted by the CAN core.
+     * @param message The sent frame.
+     */
+    virtual void onTransmit(const CANCore::CANMessage& message) {}
+
+    /**
+     * @brief Periodic callback.
+     * @details Called once per CANInterface::process() after all pending frames were dispatched. Use it for timeouts.
+     */
+    virtual void cycle() {}
+
+protected:
+    CANListener() = default;
+    ~CANListener() = default;
+};
+
 class CANInterface : public Interface {
 public:
 
@@ -52,6 +85,17 @@ public:
         return true;
     }
 
+    /**
+     * @brief Attach a responder answering remote frames and sending periodic frames without the application loop, see CANCore::setResponder().
+     */
+    bool setResponder(CANResponder* responder){
+        if(!_canCore){
+            DEV_ERROR_PRINTLN("[CANInterface] ERROR: No CANCore assigned. Call setCANCore() before setResponder().");
+            return false;
+        }
+        return _canCore->setResponder(responder);
+    }
+
     bool sendMessage(const CANCore::CANMessage& message){
         if(!_canCore){
             DEV_ERROR_PRINTLN("[CANInterface] ERROR: No CANCore assigned. Call setCANCore() before sendMessage().");
@@ -61,6 +105,9 @@ public:
             ERROR_PRINTLN("[CANInterface] ERROR: Failed to send CAN message.");
             return false;
         }
+        for(uint8_t i=0; i<MAX_LISTENERS; i++){
+            if(_listeners[i]) _listeners[i]->onTransmit(message);
+        }
         return true;
     }
 
@@ -80,9 +127,78 @@ public:
     }
 
     void setCANCore(CANCore* canCore) { _canCore = canCore; }
+    CANCore* getCANCore() { return _canCore; }
+
+    /**
+     * @brief Get the receive timestamp of the frame currently dispatched by process().
+     * @return uint32_t Time the frame was received in microseconds (micros() time base).
+     */
+    uint32_t getRxTimestamp() const { return _rxTimestamp; }
+
+    /**
+     * @brief Register a listener for received frames.
+     * @param listener Listener to add.
+     * @return true if the listener was added, false if the listener table is full.
+     */
+    bool addListener(CANListener* listener){
+        for(uint8_t i=0; i<MAX_LISTENERS; i++){
+            if(_listeners[i] == listener) return true;
+        }
+        for(uint8_t i=0; i<MAX_LISTENERS; i++){
+            if(_listeners[i] == nullptr){
+                _listeners[i] = listener;
+                return true;
+            }
+        }
+        ERROR_PRINTLN("[CANInterface] ERROR: Maximum number of " + String(MAX_LISTENERS) + " listeners reached.");
+        return false;
+    }
+
+    void removeListener(CANListener* listener){
+        for(uint8_t i=0; i<MAX_LISTENERS; i++){
+            if(_listeners[i] == listener) _listeners[i] = nullptr;
+        }
+    }
+
+    void clearListeners(){
+        for(uint8_t i=0; i<MAX_LISTENERS; i++){
+            _listeners[i] = nullptr;
+        }
+    }
+
+    /**
+     * @brief Read pending frames and dispatch them to the registered listeners.
+     * @details Reads at most MAX_MESSAGES_PER_PROCESS frames so a busy bus cannot stall the scan, then calls cycle() of every listener.
+     *          Call this function cyclically, e.g. from the cycle() of the module owning the interface.
+     * @return uint8_t Number of frames read.
+     */
+    uint8_t process(){
+        if(!_canCore || !_canCore->isInitialized()) return 0;
+        uint8_t count = 0;
+        CANCore::CANMessage message;
+        CANFrame frame;
+        while(count < MAX_MESSAGES_PER_PROCESS && _canCore->available() > 0){
+            if(!_canCore->readFrame(frame)) break;
+            CANCore::fromFrame(frame, message);
+            _rxTimestamp = frame.expandTimestamp(micros());
+            count++;
+            for(uint8_t i=0; i<MAX_LISTENERS; i++){
+                if(_listeners[i] && _listeners[i]->onMessage(message)) break;
+            }
+        }
+        for(uint8_t i=0; i<MAX_LISTENERS; i++){
+            if(_listeners[i]) _listeners[i]->cycle();
+        }
+        return count;
+    }
+
+    static constexpr uint8_t MAX_LISTENERS = 8;
+    static constexpr uint8_t MAX_MESSAGES_PER_PROCESS = 16;
 
 private:
-    CANCore* _canCore;
+    CANCore* _canCore = nullptr;
+    CANListener* _listeners[MAX_LISTENERS] = {nullptr};
+    uint32_t _rxTimestamp = 0;
 
 };
 
@@ -0,0 +1,246 @@
+#ifndef CANLOG_H
+#define CANLOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "CANFrame.h"
+
+/**
+ * @file CANLog.h
+ * @brief Binary CAN log format and text converters.
+ * @details Defines the compact binary log written by CANRecorder and read by CANReplayCore, plus converters into
+ *          candump log lines and Vector ASC lines.
+ *
+ *          Log layout (all values little endian):
+ *          - Header (12 bytes): magic "CTLG", version, flags, 2 reserved bytes, baudrate in bit/s.
+ *          - Records (9-17 bytes): timestamp in microseconds (32 bit, wraps after ~71 min), identifier and flags as in CANFrame::idFlags,
+ *            one byte with the DLC in bit 0-3 and the direction in bit 4, followed by DLC data bytes (none for remote frames).
+ */
+namespace CANLog {
+
+static constexpr uint32_t MAGIC = 0x474C5443;     // "CTLG"
+static constexpr uint8_t VERSION = 1;
+static constexpr size_t HEADER_SIZE = 12;
+static constexpr size_t MIN_RECORD_SIZE = 9;
+static constexpr size_t MAX_RECORD_SIZE = 17;
+
+enum Direction : uint8_t {
+    RX = 0,
+    TX = 1
+};
+
+struct Record {
+    uint32_t    timestamp;  // Microseconds
+    uint32_t    idFlags;    // Identifier and flags, see CANFrame
+    uint8_t     length;
+    Direction   direction;
+    uint8_t     data[8];
+
+    uint32_t getId() const { return idFlags & CANFrame::ID_MASK; }
+    bool isExtended() const { return idFlags & CANFrame::FLAG_EXTENDED; }
+    bool isRemote() const { return idFlags & CANFrame::FLAG_REMOTE; }
+    bool isError() const { return idFlags & CANFrame::FLAG_ERROR; }
+};
+
+inline void writeU32(uint8_t* out, uint32_t value) {
+    for(uint8_t i=0; i<4; i++) out[i] = (value >> (8 * i)) & 0xFF;
+}
+
+inline uint32_t readU32(const uint8_t* in) {
+    return in[0] | (uint32_t(in[1]) << 8) | (uint32_t(in[2]) << 16) | (uint32_t(in[3]) << 24);
+}
+
+/**
+ * @brief Write the log header.
+ * @param baudrate Bus baudrate in bit/s, 0 if unknown.
+ * @param out Destination, at least HEADER_SIZE bytes.
+ * @return size_t Number of bytes written.
+ */
+inline size_t encodeHeader(uint32_t baudrate, uint8_t* out) {
+    writeU32(out, MAGIC);
+    out[4] = VERSION;
+    out[5] = 0;
+    out[6] = 0;
+    out[7] = 0;
+    writeU32(&out[8], baudrate);
+    return HEADER_SIZE;
+}
+
+/**
+ * @brief Check and read the log header.
+ * @return true if the header is valid and the version is supported.
+ */
+inline bool decodeHeader(const uint8_t* in, size_t length, uint32_t& baudrate) {
+    if(length < HEADER_SIZE || readU32(in) != MAGIC || in[4] != VERSION) return false;
+    baudrate = readU32(&in[8]);
+    return true;
+}
+
+/**
+ * @brief Encode a record.
+ * @param record Record to encode.
+ * @param out Destination, at least MAX_RECORD_SIZE bytes.
+ * @return size_t Number of bytes written.
+ */
+inline size_t encodeRecord(const Record& record, uint8_t* out) {
+    uint8_t length = record.length > 8 ? 8 : record.length;
+    writeU32(out, record.timestamp);
+    writeU32(&out[4], record.idFlags);
+    out[8] = length | (record.direction == TX ? 0x10 : 0x00);
+    if(record.isRemote()) return MIN_RECORD_SIZE;
+    memcpy(&out[9], record.data, length);
+    return MIN_RECORD_SIZE + length;
+}
+
+/**
+ * @brief Decode a record.
+ * @param in Source data.
+ * @param length Number of bytes available.
+ * @param record Decoded record.
+ * @return size_t Number of bytes consumed, 0 if the data is incomplete or invalid.
+ */
+inline size_t decodeRecord(const uint8_t* in, size_t length, Record& record) {
+    if(length < MIN_RECORD_SIZE) return 0;
+    record.timestamp = readU32(in);
+    record.idFlags = readU32(&in[4]);
+    record.length = in[8] & 0x0F;
+    record.direction = (in[8] & 0x10) ? TX : RX;
+    if(record.length > 8 || (in[8] & 0xE0)) return 0;
+    memset(record.data, 0, sizeof(record.data));
+    if(record.isRemote()) return MIN_RECORD_SIZE;
+    if(length < MIN_RECORD_SIZE + record.length) return 0;
+    memcpy(record.data, &in[9], record.length);
+    return MIN_RECORD_SIZE + record.length;
+}
+
+/**
+ * @brief Extends the 32-bit record timestamps into a continuous 64-bit time since the first record.
+ */
+class Timeline {
+public:
+    uint64_t update(uint32_t timestamp) {
+        if(!_started) {
+            _started = true;
+            _last = timestamp;
+        }
+        _elapsed += uint32_t(timestamp - _last);
+        _last = timestamp;
+        return _elapsed;
+    }
+private:
+    bool _started = false;
+    uint32_t _last = 0;
+    uint64_t _elapsed = 0;
+};
+
+/**
+ * @brief Format a record as candump log line (candump -l), e.g. "(12.345678) can0 123#DEADBEEF".
+ * @param record Record to format.
+ * @param timeUs Time of the record in microseconds.
+ * @param interfaceName Interface name written into the line.
+ * @param out Destination buffer, 64 bytes are sufficient.
+ * @param size Size of the destination buffer.
+ * @return int Number of characters written (without terminator), negative on error.
+ */
+inline int formatCandump(const Record& record, uint64_t timeUs, const char* interfaceName, char* out, size_t size) {
+    uint32_t id = record.getId();
+    if(record.isError()) id |= 0x20000000;  // CAN_ERR_FLAG
+    int pos = snprintf(out, size, "(%llu.%06lu) %s ", (unsigned long long)(timeUs / 1000000), (unsigned long)(timeUs % 1000000), interfaceName);
+    if(pos < 0 || size_t(pos) >= size) return -1;
+    pos += snprintf(&out[pos], size - pos, (record.isExtended() || record.isError()) ? "%08lX#" : "%03lX#", (unsigned long)id);
+    if(record.isRemote()) {
+        pos += snprintf(&out[pos], size - pos, "R");
+    } else {
+        for(uint8_t i=0; i<record.length && size_t(pos) < size; i++) {
+            pos += snprintf(&out[pos], size - pos, "%02X", record.data[i]);
+        }
+    }
+    return size_t(pos) < size ? pos : -1;
+}
+
+// Header and footer of a Vector ASC file
+static constexpr const char* ASC_HEADER =
+    "date Thu Jan 1 12:00:00.000 am 1970\n"
+    "base hex  timestamps absolute\n"
+    "no internal events logged\n"
+    "Begin Triggerblock Thu Jan 1 12:00:00.000 am 1970\n"
+    "   0.000000 Start of measurement\n";
+static constexpr const char* ASC_FOOTER = "End TriggerBlock\n";
+
+/**
+ * @brief Format a record as Vector ASC line, e.g. "   1.234567 1  123             Rx   d 2 01 02".
+ * @param record Record to format.
+ * @param timeUs Time of the record in microseconds.
+ * @param channel CAN channel number written into the line (1 based).
+ * @param out Destination buffer, 96 bytes are sufficient.
+ * @param size Size of the destination buffer.
+ * @return int Number of characters written (without terminator), negative on error.
+ */
+inline int formatAsc(const Record& record, uint64_t timeUs, uint8_t channel, char* out, size_t size) {
+    char id[16];
+    if(record.isError()) {
+        int pos = snprintf(out, size, "%4llu.%06lu %u  ErrorFrame", (unsigned long long)(timeUs / 1000000), (unsigned long)(timeUs % 1000000), channel);
+        return (pos >= 0 && size_t(pos) < size) ? pos : -1;
+    }
+    snprintf(id, sizeof(id), record.isExtended() ? "%lXx" : "%lX", (unsigned long)record.getId());
+    int pos = snprintf(out, size, "%4llu.%06lu %u  %-15s %s   %c %u", (unsigned long long)(timeUs / 1000000), (unsigned long)(timeUs % 1000000),
+                       channel, id, record.direction == TX ? "Tx" : "Rx", record.isRemote() ? 'r' : 'd', record.length);
+    if(pos < 0 || size_t(pos) >= size) return -1;
+    if(!record.isRemote()) {
+        for(uint8_t i=0; i<record.length && size_t(pos) < size; i++) {
+            pos += snprintf(&out[pos], size - pos, " %02X", record.data[i]);
+        }
+    }
+    return size_t(pos) < size ? pos : -1;
+}
+
+enum TextFormat {
+    CANDUMP,
+    ASC
+};
+
+/**
+ * @brief Convert a binary log into text lines.
+ * @details Times are written relative to the first record. Conversion stops at the first truncated or invalid record.
+ *
+ *              CANLog::convert(log, length, CANLog::ASC, [](const char* line) { fputs(line, stdout); });
+ *
+ * @param log Log data starting with the header.
+ * @param length Length of the log in bytes.
+ * @param format Output format.
+ * @param write Called with every line, each line ends with '\n'.
+ * @return size_t Number of converted records.
+ */
+template<typename LineWriter>
+size_t convert(const uint8_t* log, size_t length, TextFormat format, LineWriter&& write) {
+    uint32_t baudrate;
+    if(!decodeHeader(log, length, baudrate)) return 0;
+    char line[128];
+    if(format == ASC) write(ASC_HEADER);
+
+    Timeline timeline;
+    Record record;
+    size_t count = 0;
+    size_t position = HEADER_SIZE;
+    while(position < length) {
+        size_t size = decodeRecord(&log[position], length - position, record);
+        if(size == 0) break;
+        position += size;
+        uint64_t timeUs = timeline.update(record.timestamp);
+        int pos = format == ASC ? formatAsc(record, timeUs, 1, line, sizeof(line) - 1)
+                                : formatCandump(record, timeUs, "can0", line, sizeof(line) - 1);
+        if(pos < 0) continue;
+        line[pos] = '\n';
+        line[pos + 1] = '\0';
+        write(line);
+        count++;
+    }
+    if(format == ASC) write(ASC_FOOTER);
+    return count;
+}
+
+} // namespace CANLog
+
+#endif // CANLOG_H
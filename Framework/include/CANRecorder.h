@@ -0,0 +1,68 @@
+#ifndef CANRECORDER_H
+#define CANRECORDER_H
+
+#include <Arduino.h>
+#include <functional>
+#include "CANCore.h"
+#include "CANInterface.h"
+#include "CANLog.h"
+#include "Debug.h"
+
+/**
+ * @file CANRecorder.h
+ * @brief Declaration of the CANRecorder class.
+ * @details Defines a recorder which writes the CAN traffic of a CANInterface into the binary log format of CANLog.h.
+ *          Received frames are recorded with the timestamp taken by the CAN core, frames sent through the interface are recorded as TX.
+ *          Records are collected in a fixed buffer and handed to a sink in blocks, e.g. a file on flash or a UART:
+ *
+ *              recorder.begin(&canInterface, [](const uint8_t* data, size_t length) { return file.write(data, length); });
+ *
+ *          The recorder never consumes frames. Call begin() before other protocol layers are registered at the interface,
+ *          otherwise frames consumed by a listener registered earlier are not recorded.
+ */
+class CANRecorder : public CANListener {
+public:
+    static constexpr size_t BUFFER_SIZE = 512;
+    static constexpr uint32_t FLUSH_INTERVAL_MS = 100;     // Maximum time records stay in the buffer
+
+    /**
+     * @brief Destination of the log data.
+     * @param data Data to write.
+     * @param length Number of bytes to write.
+     * @return size_t Number of bytes written. Bytes not written are offered again with the next flush.
+     */
+    using Sink = std::function<size_t(const uint8_t* data, size_t length)>;
+
+    CANRecorder() = default;
+
+    bool begin(CANInterface* canInterface, Sink sink);
+    void end();
+
+    bool record(const CANCore::CANMessage& message, CANLog::Direction direction, uint32_t timestamp);
+    bool flush();
+
+    void setRecordTransmitted(bool enabled) { _recordTransmitted = enabled; }
+    bool isRecording() const { return _canInterface != nullptr; }
+    uint32_t getRecordCount() const { return _recordCount; }
+    uint32_t getDroppedCount() const { return _droppedCount; }
+    uint32_t getBytesWritten() const { return _bytesWritten; }
+
+    bool onMessage(const CANCore::CANMessage& message) override;
+    void onTransmit(const CANCore::CANMessage& message) override;
+    void cycle() override;
+
+private:
+    CANInterface* _canInterface = nullptr;
+    Sink _sink;
+    bool _recordTransmitted = true;
+
+    uint8_t _buffer[BUFFER_SIZE];
+    size_t _fill = 0;
+    uint32_t _lastFlush = 0;
+
+    uint32_t _recordCount = 0;
+    uint32_t _droppedCount = 0;
+    uint32_t _bytesWritten = 0;
+};
+
+#endif // CANRECORDER_H
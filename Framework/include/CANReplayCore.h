@@ -0,0 +1,91 @@
+#ifndef CANREPLAYCORE_H
+#define CANREPLAYCORE_H
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <functional>
+#include "CANCore.h"
+#include "CANLog.h"
+#include "Debug.h"
+
+/**
+ * @file CANReplayCore.h
+ * @brief Declaration of the CANReplayCore class.
+ * @details Defines a CANCore implementation which plays back a log recorded with CANRecorder instead of accessing a CAN controller.
+ *          Frames become available when their recorded time is reached, optionally accelerated by a speed factor, so protocol
+ *          layers and modules can be tested offline with real bus traffic. The log is read in place from memory (setLog()) or
+ *          through a window of WINDOW_SIZE bytes from a file or another reader (setLogFile(), setSource()), so logs larger than
+ *          the RAM can be replayed. On a Linux host the core builds with include/host on the include path.
+ *          Frames recorded as TX are skipped by default because they were produced by the recording node itself.
+ *          Sent frames are counted in the statistics and otherwise discarded.
+ */
+class CANReplayCore : public CANCore {
+public:
+    static constexpr uint8_t AVAILABLE_SCAN_LIMIT = 64;    // Maximum number of due frames reported by available()
+    static constexpr size_t WINDOW_SIZE = 2048;            // Read window of reader sources, holds AVAILABLE_SCAN_LIMIT records
+
+    /**
+     * @brief Reads length bytes of the log at offset into buffer and returns the number of bytes read.
+     */
+    using Reader = std::function<size_t(size_t offset, uint8_t* buffer, size_t length)>;
+
+    CANReplayCore() = default;
+    ~CANReplayCore() = default;
+
+    HardwareResource::Type getType() override { return HardwareResource::CAN; }
+    bool begin() override;
+    bool setBaudrate(Baudrate baudrate) override;
+    bool setPins(int8_t txPin, int8_t rxPin) override;
+    bool end() override;
+    bool sendMessage(const CANMessage& message) override;
+    bool readMessage(CANMessage& message) override;
+    bool readFrame(CANFrame& frame) override;
+    uint8_t available() override;
+    bool setupFilter(uint32_t id, uint32_t mask) override;
+
+    bool setLog(const uint8_t* log, size_t length);
+    bool setSource(Reader reader, size_t length);
+    bool setLogFile(FILE* file);
+    void setSpeed(float speed) { _speed = speed; }
+    void setLoop(bool enabled) { _loop = enabled; }
+    void setReplayTransmitted(bool enabled) { _replayTransmitted = enabled; }
+
+    bool isFinished() const { return _cursor.position >= _length && !_loop; }
+    uint32_t getReplayedCount() const { return _replayedCount; }
+
+private:
+    struct Cursor {
+        size_t      position;       // Offset of the next record in the log
+        bool        started;
+        uint32_t    lastTimestamp;  // Recorded timestamp of the last record passed
+        uint64_t    logTimeUs;      // Time of the last record passed since the first record
+    };
+
+    bool next(Cursor& cursor, CANLog::Record& record);
+    const uint8_t* fetch(size_t position, size_t& available);
+    bool accept(const CANLog::Record& record) const;
+    uint64_t getDueTime(const Cursor& cursor) const;
+    void rewind();
+    void updateClock();
+
+    const uint8_t* _log = nullptr;      // Log in memory, nullptr for a reader source
+    Reader _reader = nullptr;
+    size_t _length = 0;
+    uint8_t _window[WINDOW_SIZE];       // Bytes of a reader source from _windowStart
+    size_t _windowStart = 0;
+    size_t _windowLength = 0;
+    float _speed = 1.0f;               // 1.0 original speed, 2.0 twice as fast, 0 as fast as possible
+    bool _loop = false;
+    bool _replayTransmitted = false;
+
+    Cursor _cursor = {};
+
+    //Playback clock
+    uint32_t _startMicros = 0;
+    uint32_t _lastMicros = 0;
+    uint64_t _playbackUs = 0;
+
+    uint32_t _replayedCount = 0;
+};
+
+#endif // CANREPLAYCORE_H
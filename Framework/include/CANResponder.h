@@ -0,0 +1,212 @@
+#ifndef CANRESPONDER_H
+#define CANRESPONDER_H
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include "CANFrame.h"
+
+/**
+ * @file CANResponder.h
+ * @brief Declaration of the CANResponder class.
+ * @details Defines a table of frames with cached payloads which are sent by the CAN core on its own, without the application loop:
+ *          - Remote responses: a received remote frame with the identifier of an entry is answered with the cached payload.
+ *            With TOGGLE_BIT, bit 7 of the first byte alternates with every response (CANopen node guarding).
+ *          - Periodic frames: an entry with a period is sent every period (e.g. CANopen heartbeat 0x700 + node ID).
+ *          The application only updates the payloads with setPayload(). The CAN core calls handleRemote() for received remote frames and
+ *          nextPeriodic() regularly from its driver task, see CANCore::setResponder().
+ *
+ *          Entries are configured with addEntry() before the responder is attached to a core. Afterwards one task (the application) may
+ *          call setPayload() while another task (the driver) builds responses. Every payload is double buffered: setPayload() writes the
+ *          inactive buffer and then switches, so a response does not mix an old and a new payload and the driver never waits for the
+ *          application. Only two updates within the copy of 8 bytes by the driver on the other core could still mix them.
+ */
+class CANResponder {
+public:
+    static constexpr uint8_t MAX_ENTRIES = 16;
+
+    enum Flags : uint8_t {
+        ANSWER_REMOTE   = 0x01,     // Answer remote frames with this identifier
+        TOGGLE_BIT      = 0x02      // Alternate bit 7 of byte 0 with every remote response
+    };
+
+    struct Statistics {
+        uint32_t    remoteAnswered;
+        uint32_t    periodicSent;
+    };
+
+    CANResponder() = default;
+    CANResponder(const CANResponder&) = delete;
+    CANResponder& operator=(const CANResponder&) = delete;
+
+    /**
+     * @brief Add an entry.
+     * @param id 11-bit or 29-bit identifier.
+     * @param extended True for 29-bit identifiers.
+     * @param data Initial payload, may be nullptr for zeros.
+     * @param length Payload length (0-8).
+     * @param flags Combination of Flags.
+     * @param periodMs Send period, 0 for no periodic transmission.
+     * @return true if the entry was added, false if all MAX_ENTRIES entries are in use or the identifier is already in the table.
+     */
+    bool addEntry(uint32_t id, bool extended, const uint8_t* data, uint8_t length, uint8_t flags, uint32_t periodMs = 0) {
+        if(_count >= MAX_ENTRIES || find(id, extended) != nullptr || length > 8) return false;
+        Entry& entry = _entries[_count];
+        entry.id = id;
+        entry.extended = extended;
+        entry.flags = flags;
+        entry.periodMs = periodMs;
+        entry.toggle = false;
+        entry.scheduled = false;
+        entry.active.store(0, std::memory_order_relaxed);
+        entry.length[0] = length;
+        memset(entry.data[0], 0, sizeof(entry.data[0]));
+        if(data) memcpy(entry.data[0], data, length);
+        _count++;
+        return true;
+    }
+
+    /**
+     * @brief Add an entry answering remote frames.
+     */
+    bool addRemoteResponse(uint32_t id, const uint8_t* data, uint8_t length, bool toggle = false, bool extended = false) {
+        return addEntry(id, extended, data, length, ANSWER_REMOTE | (toggle ? TOGGLE_BIT : 0));
+    }
+
+    /**
+     * @brief Add a periodic frame, e.g. a heartbeat.
+     */
+    bool addPeriodic(uint32_t id, const uint8_t* data, uint8_t length, uint32_t periodMs, bool extended = false) {
+        return addEntry(id, extended, data, length, 0, periodMs);
+    }
+
+    /**
+     * @brief Update the payload of an entry (application side).
+     * @return false if there is no entry with this identifier or the length is invalid.
+     */
+    bool setPayload(uint32_t id, const uint8_t* data, uint8_t length, bool extended = false) {
+        Entry* entry = find(id, extended);
+        if(entry == nullptr || length > 8) return false;
+        uint8_t inactive = entry->active.load(std::memory_order_relaxed) ^ 1;
+        entry->length[inactive] = length;
+        memset(entry->data[inactive], 0, sizeof(entry->data[inactive]));
+        if(data) memcpy(entry->data[inactive], data, length);
+        entry->active.store(inactive, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Build the response to a received remote frame (driver side).
+     * @param request Received frame.
+     * @param response Destination of the response.
+     * @return true if the frame is answered by this responder.
+     */
+    bool handleRemote(const CANFrame& request, CANFrame& response) {
+        if(!request.isRemote()) return false;
+        Entry* entry = find(request.getId(), request.isExtended());
+        if(entry == nullptr || !(entry->flags & ANSWER_REMOTE)) return false;
+        build(*entry, response);
+        if(entry->flags & TOGGLE_BIT) {
+            response.data[0] = (response.data[0] & 0x7F) | (entry->toggle ? 0x80 : 0);
+            entry->toggle = !entry->toggle;
+        }
+        _statistics.remoteAnswered++;
+        return true;
+    }
+
+    /**
+     * @brief Get the next due periodic frame (driver side). Call it until it returns false.
+     * @details The first transmission of an entry is due at the first call. Periods are kept without drift, a period missed
+     *          completely is skipped.
+     * @param nowMs Current time in milliseconds.
+     * @param frame Destination of the frame.
+     * @return true if a frame is due.
+     */
+    bool nextPeriodic(uint32_t nowMs, CANFrame& frame) {
+        for(uint8_t i=0; i<_count; i++) {
+            Entry& entry = _entries[i];
+            if(entry.periodMs == 0) continue;
+            if(!entry.scheduled) {
+                entry.scheduled = true;
+                entry.dueMs = nowMs;
+            }
+            if(int32_t(nowMs - entry.dueMs) < 0) continue;
+            entry.dueMs += entry.periodMs;
+            if(int32_t(nowMs - entry.dueMs) >= 0) entry.dueMs = nowMs + entry.periodMs;
+            build(entry, frame);
+            _statistics.periodicSent++;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Get the time until the next periodic frame is due (driver side).
+     * @param nowMs Current time in milliseconds.
+     * @param limitMs Value returned if no periodic frame is configured.
+     * @return uint32_t Milliseconds, 0 if a frame is due.
+     */
+    uint32_t getTimeToNext(uint32_t nowMs, uint32_t limitMs) const {
+        uint32_t next = limitMs;
+        for(uint8_t i=0; i<_count; i++) {
+            const Entry& entry = _entries[i];
+            if(entry.periodMs == 0) continue;
+            if(!entry.scheduled) return 0;
+            int32_t remaining = int32_t(entry.dueMs - nowMs);
+            if(remaining <= 0) return 0;
+            if(uint32_t(remaining) < next) next = remaining;
+        }
+        return next;
+    }
+
+    /**
+     * @brief Restart all periodic frames with the next call of nextPeriodic(), e.g. after the core was restarted.
+     */
+    void restart() {
+        for(uint8_t i=0; i<_count; i++) _entries[i].scheduled = false;
+    }
+
+    /**
+     * @brief Remove all entries. Only allowed while the responder is not attached to a core.
+     */
+    void clear() { _count = 0; }
+
+    uint8_t getEntryCount() const { return _count; }
+    const Statistics& getStatistics() const { return _statistics; }
+    void resetStatistics() { _statistics = {}; }
+
+private:
+    struct Entry {
+        uint32_t    id;
+        bool        extended;
+        uint8_t     flags;
+        uint32_t    periodMs;
+        uint32_t    dueMs;          // Driver side
+        bool        scheduled;      // Driver side
+        bool        toggle;         // Driver side
+        std::atomic<uint8_t> active{0};     // Payload buffer read by the driver
+        uint8_t     length[2];
+        uint8_t     data[2][8];
+    };
+
+    Entry _entries[MAX_ENTRIES];
+    uint8_t _count = 0;
+    Statistics _statistics = {};
+
+    Entry* find(uint32_t id, bool extended) {
+        for(uint8_t i=0; i<_count; i++) {
+            if(_entries[i].id == id && _entries[i].extended == extended) return &_entries[i];
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Copy the active payload into a frame.
+     */
+    static void build(const Entry& entry, CANFrame& frame) {
+        uint8_t active = entry.active.load(std::memory_order_acquire);
+        frame.set(entry.id, entry.extended, false, entry.data[active], entry.length[active], 0);
+    }
+};
+
+#endif // CANRESPONDER_H
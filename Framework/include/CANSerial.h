@@ -0,0 +1,170 @@
+#ifndef CANSERIAL_H
+#define CANSERIAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "CANFrame.h"
+#include "COBS.h"
+
+/**
+ * @file CANSerial.h
+ * @brief Binary framing of CAN frames on a serial link.
+ * @details Defines the record format used by CANUARTGateway. Every record is COBS encoded and terminated by a zero byte,
+ *          see COBS.h, so a receiver resynchronizes after lost bytes at the next delimiter.
+ *
+ *          Record layout (all values little endian):
+ *          - Frame record (3-15 bytes): one header byte with the DLC in bit 0-3, FLAG_EXTENDED, FLAG_REMOTE and FLAG_TIMESTAMP,
+ *            the identifier (2 bytes for standard, 4 bytes for extended frames), the lower 16 bits of the receive time in microseconds
+ *            if FLAG_TIMESTAMP is set, followed by DLC data bytes (none for remote frames).
+ *          - Time record (5 bytes): header byte RECORD_TIME and the receive time in microseconds (32 bit). The sender writes a
+ *            time record before a frame record whenever the upper 16 bits of the time changed, the receiver combines both.
+ *
+ *          A standard frame with 8 data bytes and timestamp takes 15 bytes on the wire including COBS overhead and delimiter.
+ */
+namespace CANSerial {
+
+static constexpr uint8_t LENGTH_MASK = 0x0F;
+static constexpr uint8_t FLAG_EXTENDED = 0x10;
+static constexpr uint8_t FLAG_REMOTE = 0x20;
+static constexpr uint8_t FLAG_TIMESTAMP = 0x40;
+static constexpr uint8_t FLAG_CONTROL = 0x80;       // Record carries no frame
+static constexpr uint8_t RECORD_TIME = FLAG_CONTROL | 0x00;
+
+static constexpr size_t MAX_RECORD_SIZE = 15;
+static constexpr size_t TIME_RECORD_SIZE = 5;
+static constexpr size_t MAX_PACKET_SIZE = COBS::maxEncodedSize(MAX_RECORD_SIZE) + 1;    // Encoded record with delimiter
+
+/**
+ * @brief Encode a frame record.
+ * @param frame Frame to encode.
+ * @param timestamp Receive time in microseconds.
+ * @param withTimestamp Append the lower 16 bits of the receive time.
+ * @param out Destination, at least MAX_RECORD_SIZE bytes.
+ * @return size_t Record length.
+ */
+inline size_t encodeFrame(const CANFrame& frame, uint32_t timestamp, bool withTimestamp, uint8_t* out) {
+    uint8_t length = frame.getLength() > 8 ? 8 : frame.getLength();
+    out[0] = length | (frame.isExtended() ? FLAG_EXTENDED : 0) | (frame.isRemote() ? FLAG_REMOTE : 0) | (withTimestamp ? FLAG_TIMESTAMP : 0);
+    size_t position = 1;
+    uint8_t idBytes = frame.isExtended() ? 4 : 2;
+    for(uint8_t i=0; i<idBytes; i++) out[position++] = (frame.getId() >> (8 * i)) & 0xFF;
+    if(withTimestamp) {
+        out[position++] = timestamp & 0xFF;
+        out[position++] = (timestamp >> 8) & 0xFF;
+    }
+    if(!frame.isRemote()) {
+        memcpy(&out[position], frame.data, length);
+        position += length;
+    }
+    return position;
+}
+
+/**
+ * @brief Encode a time record.
+ * @param out Destination, at least TIME_RECORD_SIZE bytes.
+ * @return size_t Record length.
+ */
+inline size_t encodeTime(uint32_t timestamp, uint8_t* out) {
+    out[0] = RECORD_TIME;
+    for(uint8_t i=0; i<4; i++) out[1 + i] = (timestamp >> (8 * i)) & 0xFF;
+    return TIME_RECORD_SIZE;
+}
+
+/**
+ * @brief COBS encode a record and append the delimiter.
+ * @param out Destination, at least MAX_PACKET_SIZE bytes.
+ * @return size_t Packet length.
+ */
+inline size_t encodePacket(const uint8_t* record, size_t length, uint8_t* out) {
+    size_t size = COBS::encode(record, length, out);
+    out[size++] = COBS::DELIMITER;
+    return size;
+}
+
+/**
+ * @brief Decoded record.
+ */
+struct Record {
+    CANFrame    frame;          // Frame of a frame record, the frame timestamp is not used
+    bool        hasTimestamp;
+    uint32_t    timestamp;      // Receive time in microseconds, combined with the last time record
+};
+
+/**
+ * @class Decoder
+ * @brief Splits a byte stream into packets and decodes the records.
+ */
+class Decoder {
+public:
+    enum Result {
+        NONE,           // Packet not complete yet
+        FRAME,          // Frame record decoded
+        TIME,           // Time record decoded, the timestamp holds the time
+        INVALID         // Invalid or oversized packet, discarded
+    };
+
+    /**
+     * @brief Process one received byte.
+     * @param byte Received byte.
+     * @param record Destination, valid if FRAME or TIME is returned.
+     * @return Result Decoding result.
+     */
+    Result push(uint8_t byte, Record& record) {
+        if(byte != COBS::DELIMITER) {
+            if(_fill < sizeof(_packet)) _packet[_fill] = byte;
+            if(_fill < sizeof(_packet) + 1) _fill++;
+            return NONE;
+        }
+        size_t fill = _fill;
+        _fill = 0;
+        if(fill == 0) return NONE;          // Empty packet, e.g. a delimiter sent to resynchronize
+        if(fill > sizeof(_packet)) return INVALID;
+        size_t length = COBS::decode(_packet, fill, _packet);
+        return decodeRecord(_packet, length, record);
+    }
+
+    /**
+     * @brief Discard a partially received packet.
+     */
+    void reset() { _fill = 0; }
+
+private:
+    uint8_t _packet[COBS::maxEncodedSize(MAX_RECORD_SIZE)];
+    size_t _fill = 0;
+    uint32_t _timeHigh = 0;
+
+    Result decodeRecord(const uint8_t* in, size_t length, Record& record) {
+        if(length == 0) return INVALID;
+        uint8_t header = in[0];
+        if(header & FLAG_CONTROL) {
+            if(header != RECORD_TIME || length != TIME_RECORD_SIZE) return INVALID;
+            record.timestamp = in[1] | (uint32_t(in[2]) << 8) | (uint32_t(in[3]) << 16) | (uint32_t(in[4]) << 24);
+            record.hasTimestamp = true;
+            _timeHigh = record.timestamp & 0xFFFF0000;
+            return TIME;
+        }
+        uint8_t dlc = header & LENGTH_MASK;
+        bool extended = header & FLAG_EXTENDED;
+        bool remote = header & FLAG_REMOTE;
+        record.hasTimestamp = header & FLAG_TIMESTAMP;
+        size_t idBytes = extended ? 4 : 2;
+        size_t expected = 1 + idBytes + (record.hasTimestamp ? 2 : 0) + (remote ? 0 : dlc);
+        if(dlc > 8 || length != expected) return INVALID;
+        uint32_t id = 0;
+        for(size_t i=0; i<idBytes; i++) id |= uint32_t(in[1 + i]) << (8 * i);
+        if(id > (extended ? CANFrame::ID_MASK : 0x7FFUL)) return INVALID;
+        size_t position = 1 + idBytes;
+        record.timestamp = 0;
+        if(record.hasTimestamp) {
+            record.timestamp = _timeHigh | in[position] | (uint32_t(in[position + 1]) << 8);
+            position += 2;
+        }
+        record.frame.set(id, extended, remote, remote ? nullptr : &in[position], dlc, 0);
+        return FRAME;
+    }
+};
+
+}   // namespace CANSerial
+
+#endif // CANSERIAL_H
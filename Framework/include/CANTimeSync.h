@@ -0,0 +1,136 @@
+#ifndef CANTIMESYNC_H
+#define CANTIMESYNC_H
+
+#include <Arduino.h>
+#include <functional>
+#include "CANCore.h"
+#include "CANInterface.h"
+#include "CANTramModule.h"
+#include "Interface.h"
+#include "Debug.h"
+
+/**
+ * @file CANTimeSync.h
+ * @brief Declaration of the CANTimeSync class.
+ * @details Defines a network time protocol on top of CANInterface. One node is the time master, all other nodes discipline their
+ *          local clock to it, and output changes can be scheduled for a network timestamp so several nodes switch at the same time.
+ *
+ *          Protocol (two-step, like IEEE 1588):
+ *          - The master sends a SYNC frame (COB_ID_SYNC, 1 byte sequence counter) every sync interval.
+ *          - Once its CAN core reports the end of the SYNC transmission (CANCore::readTxTimestamp()), it follows up with a TIME frame
+ *            (COB_ID_TIME, byte 0 sequence counter, bytes 1-7 master time at the end of the SYNC in microseconds).
+ *          - A slave takes the receive timestamp of the SYNC (CANInterface::getRxTimestamp()), which also marks the end of the frame.
+ *            When the matching TIME frame arrives, the difference between the master time and the local network time estimate is the offset.
+ *            Offsets above STEP_THRESHOLD_US step the clock, smaller offsets are corrected by a PI servo (phase and frequency).
+ *          Queuing and arbitration delays of the SYNC at the master therefore do not affect the offset. If the CAN core of the master
+ *          has no transmit timestamps, the master time is taken before sending plus the nominal SYNC duration instead, and the queuing
+ *          delay adds to the offset of all slaves alike. Give the SYNC frame the highest priority on the bus in that case.
+ */
+class CANTimeSync : public CANListener {
+public:
+    static constexpr uint16_t COB_ID_SYNC = 0x080;
+    static constexpr uint16_t COB_ID_TIME = 0x100;
+    static constexpr int32_t STEP_THRESHOLD_US = 1000;
+    static constexpr uint8_t JITTER_SAMPLES = 16;
+    static constexpr uint8_t MAX_SCHEDULED_OUTPUTS = 16;
+
+    enum Role {
+        MASTER,
+        SLAVE
+    };
+
+    struct Statistics {
+        uint32_t    syncsSent;
+        uint32_t    samples;            // Complete SYNC/TIME pairs received
+        uint32_t    steps;              // Clock steps (first sample and offsets above STEP_THRESHOLD_US)
+        uint32_t    lostSyncs;          // TIME frames without matching SYNC
+        int32_t     offsetUs;           // Offset of the last sample (master minus local estimate)
+        uint32_t    maxOffsetUs;        // Largest absolute offset after the clock was locked
+        uint32_t    jitterUs;           // Standard deviation of the last JITTER_SAMPLES offsets
+        int32_t     ratePpb;            // Frequency correction of the local clock
+        uint32_t    outputsApplied;
+        uint32_t    maxOutputLatenessUs;
+    };
+
+    /**
+     * @brief Source of the local time in microseconds, micros() by default.
+     */
+    using Clock = std::function<uint32_t()>;
+
+    CANTimeSync() = default;
+
+    bool begin(CANInterface* canInterface, Role role);
+    void end();
+
+    bool onMessage(const CANCore::CANMessage& message) override;
+    void cycle() override;
+
+    void setSyncInterval(uint32_t ms) { _syncIntervalMs = ms; }
+    void setClock(Clock clock) { _clock = clock; }
+
+    uint64_t getNetworkTime();
+    bool isSynchronized();
+    Role getRole() const { return _role; }
+    const Statistics& getStatistics() const { return _statistics; }
+    void resetStatistics();
+
+    bool scheduleOutput(Interface* interface, uint16_t q, uint64_t networkTimeUs, CANTramModule* module = nullptr);
+    void cancelOutputs(Interface* interface = nullptr);
+    uint8_t getScheduledCount() const;
+    void poll();
+
+private:
+    struct ScheduledOutput {
+        Interface*      interface;
+        CANTramModule*  module;
+        uint64_t        time;
+        uint16_t        q;
+        bool            active;
+    };
+
+    CANInterface* _canInterface = nullptr;
+    Role _role = SLAVE;
+    Clock _clock;
+    uint32_t _syncIntervalMs = 100;
+    uint32_t _lastSync = 0;
+    uint8_t _sequence = 0;
+
+    //SYNC of the master waiting for its transmit timestamp
+    bool _txTimestamps = false;
+    bool _syncSent = false;
+    uint8_t _syncSentSequence = 0;
+
+    //Local clock extended to 64 bit
+    uint64_t _localRef = 0;
+
+    //Clock model of a slave: network = anchorNetwork + (local - anchorLocal) * (1 + ratePpb / 1e9)
+    bool _locked = false;
+    bool _rateValid = false;
+    uint64_t _anchorLocal = 0;
+    uint64_t _anchorNetwork = 0;
+    int64_t _ratePpb = 0;
+    uint64_t _lastSampleLocal = 0;
+
+    //Pending SYNC
+    bool _syncPending = false;
+    uint8_t _syncSequence = 0;
+    uint64_t _syncRxLocal = 0;
+
+    int32_t _offsets[JITTER_SAMPLES] = {};
+    uint8_t _offsetCount = 0;
+    uint8_t _offsetIndex = 0;
+
+    ScheduledOutput _outputs[MAX_SCHEDULED_OUTPUTS] = {};
+    Statistics _statistics = {};
+
+    uint64_t localTime();
+    uint64_t extend(uint32_t local) const { return _localRef + int32_t(local - uint32_t(_localRef)); }
+    uint64_t toNetwork(uint64_t local) const;
+    void sendSync();
+    void completeSync();
+    void sendTime(uint8_t sequence, uint64_t time);
+    void handleTime(const uint8_t* data, uint8_t length);
+    void addSample(uint64_t rxLocal, uint64_t masterTime);
+};
+
+#endif // CANTIMESYNC_H
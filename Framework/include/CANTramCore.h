@@ -49,6 +49,7 @@ public:
     }
     return modules[index];
   }
+  static uint8_t getMaxModules() { return MAX_MODULES; }
   // static void setOutputDefinitionTable(OutputDefinition* table, uint8_t size);
   static CANTramCoreError addOutputDefinitionPointers(OutputDefinition *def[], uint8_t size);
   static CANTramCoreError addOutputDefinitions(OutputDefinition def[], uint8_t size);
@@ -81,6 +82,8 @@ public:
 
  
   static CANCore::Baudrate DEFAULT_CAN_BAUDRATE;
+  static bool CAN_AUTO_BAUD;                  // Detect the baudrate in listen-only mode if none is set, see CANAutoBaud
+  static uint32_t CAN_AUTO_BAUD_TIMEOUT_MS;
 
   static uint8_t loop();
 
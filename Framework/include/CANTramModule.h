@@ -5,6 +5,8 @@
 #include "Interface.h"
 #include "Debug.h"
 
+class ObjectDictionary; // Forward declaration
+
 /**
  * @file CANTramModule.h
  * @brief Base class for CANTram hardware modules.
@@ -90,6 +92,14 @@ class CANTramModule {
             DEBUG_PRINTLN("[CANTramModule] cycle() called on module " + getHWType() + " in slot " + String(SLOT));
         }
         
+        /**
+         * @brief Write the output interface values to the hardware immediately.
+         * @details Used for time critical changes (e.g. CANTimeSync::scheduleOutput()) which should not wait for the next cycle().
+         *          Modules without outputs or without immediate write support keep the default implementation.
+         * @return true if the outputs were written, false if they are written with the next cycle().
+         */
+        virtual bool writeOutputs() { return false; }
+
         /**
          * @brief Attach this module to a slot and assign GPIO range.
          * @details Initializes the module's internal SLOT and GPIO_START and triggers GPIO/resource provisioning
@@ -162,6 +172,16 @@ class CANTramModule {
          */
         virtual size_t getInterfaceCount() = 0;
 
+        /**
+         * @brief Add module specific configuration objects to an object dictionary.
+         * @details Called by ObjectDictionary::populate() for every attached module. Override to expose configuration
+         *          items (e.g. masks, frequencies) for SDO access. The interfaces are added by the dictionary itself.
+         * @param od Object dictionary to add the entries to.
+         * @param index Object index reserved for the configuration items of this module.
+         * @return true if all entries were added, false otherwise.
+         */
+        virtual bool addObjects(ObjectDictionary& od, uint16_t index) { return true; }
+
     protected:
         uint8_t SLOT = 0;
         uint8_t GPIO_START = 0;
@@ -0,0 +1,264 @@
+#ifndef CANTX_SCHEDULER_H
+#define CANTX_SCHEDULER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "CANFrame.h"
+
+/**
+ * @file CANTxScheduler.h
+ * @brief Declaration of the CANTxScheduler class.
+ * @details Defines a software transmit queue which hands out frames in bus priority order instead of FIFO order.
+ *          A hardware transmit queue is FIFO, so a high-priority frame queued behind a burst of low-priority frames waits for
+ *          the whole burst (priority inversion). The scheduler keeps the frames sorted by their arbitration field, equal
+ *          identifiers stay in FIFO order, and is meant to feed the hardware one frame at a time.
+ *
+ *          Optional traffic shaping:
+ *          - Streams: frames matching (id & mask) are limited to one frame per interval with a burst allowance. A frame of a
+ *            stream which is over its rate waits, frames of other streams with lower priority may pass it.
+ *          - Load limit: the bits handed out are limited to a share of the bitrate, so this node never exceeds its bus load budget.
+ *
+ *          The caller passes the time in microseconds, the frame timestamp is taken as the queuing time for the delay statistics.
+ *          The class is not thread-safe.
+ */
+
+template<size_t Capacity>
+class CANTxScheduler {
+    static_assert(Capacity >= 2 && Capacity < 255, "Capacity must be between 2 and 254");
+public:
+    static constexpr uint8_t MAX_STREAMS = 8;
+    static constexpr uint32_t DEFAULT_BURST_BITS = 4 * 160;    // Four extended frames with 8 data bytes
+
+    struct Statistics {
+        uint32_t    queued;
+        uint32_t    sent;
+        uint32_t    dropped;        // Rejected because the queue was full with frames of higher or equal priority
+        uint32_t    evicted;        // Lowest-priority frames removed to make room for a higher-priority frame
+        uint32_t    maxDelayUs;     // Longest time a frame spent in the queue
+        uint64_t    totalDelayUs;
+        uint8_t     maxDepth;
+    };
+
+    CANTxScheduler() { clear(); }
+    CANTxScheduler(const CANTxScheduler&) = delete;
+    CANTxScheduler& operator=(const CANTxScheduler&) = delete;
+
+    /**
+     * @brief Queue a frame.
+     * @details If the queue is full and the frame has a higher priority than the last queued frame, the last frame is evicted.
+     * @param frame Frame to queue, the timestamp is the queuing time in microseconds.
+     * @return true if the frame was queued.
+     */
+    bool push(const CANFrame& frame) {
+        uint32_t key = frame.getArbitrationKey();
+        if(_count >= Capacity) {
+            uint8_t last = _order[_count - 1];
+            if(_keys[last] <= key) {
+                _statistics.dropped++;
+                return false;
+            }
+            removeAt(_count - 1);
+            _statistics.evicted++;
+        }
+        uint8_t slot = _free[--_freeCount];
+        _frames[slot] = frame;
+        _keys[slot] = key;
+        _streamOf[slot] = findStream(frame);
+
+        //Behind all frames with the same or a higher priority
+        size_t position = _count;
+        while(position > 0 && _keys[_order[position - 1]] > key) position--;
+        memmove(&_order[position + 1], &_order[position], _count - position);
+        _order[position] = slot;
+        _count++;
+        _statistics.queued++;
+        if(_count > _statistics.maxDepth) _statistics.maxDepth = _count;
+        return true;
+    }
+
+    /**
+     * @brief Get the frame with the highest priority which may be sent now.
+     * @details Frames of streams over their rate are skipped. If the load limit is reached, nothing may be sent.
+     * @param now Current time in microseconds.
+     * @return Pointer to the frame, nullptr if no frame may be sent. Valid until drop(), clear() or the next push() of a full queue.
+     */
+    const CANFrame* peek(uint32_t now) {
+        refill(now);
+        _peeked = NONE;
+        for(size_t i=0; i<_count; i++) {
+            uint8_t slot = _order[i];
+            uint8_t stream = _streamOf[slot];
+            if(stream != NONE && _streams[stream].credit < int32_t(_streams[stream].intervalUs)) continue;
+            const CANFrame& frame = _frames[slot];
+            if(_loadLimited && _loadCredit < getLoadCost(frame)) return nullptr;
+            _peeked = slot;
+            return &frame;
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Remove the frame returned by the last peek() after it was handed to the hardware.
+     * @param now Current time in microseconds.
+     */
+    void drop(uint32_t now) {
+        if(_peeked == NONE) return;
+        size_t position = 0;
+        while(position < _count && _order[position] != _peeked) position++;
+        _peeked = NONE;
+        if(position == _count) return;
+
+        uint8_t slot = _order[position];
+        const CANFrame& frame = _frames[slot];
+        if(_streamOf[slot] != NONE) _streams[_streamOf[slot]].credit -= int32_t(_streams[_streamOf[slot]].intervalUs);
+        if(_loadLimited) _loadCredit -= getLoadCost(frame);
+        uint32_t delay = (now - frame.getTimestamp()) & CANFrame::TIMESTAMP_MASK;
+        if(delay > _statistics.maxDelayUs) _statistics.maxDelayUs = delay;
+        _statistics.totalDelayUs += delay;
+        _statistics.sent++;
+        removeAt(position);
+    }
+
+    /**
+     * @brief Remove all queued frames. Streams, load limit and statistics are kept.
+     */
+    void clear() {
+        _count = 0;
+        _freeCount = Capacity;
+        for(size_t i=0; i<Capacity; i++) _free[i] = Capacity - 1 - i;
+        _peeked = NONE;
+    }
+
+    /**
+     * @brief Limit the rate of the frames matching (frame ID & mask) == (id & mask).
+     * @details The first matching stream applies. Frames already queued keep their previous stream assignment.
+     * @param id Identifier of the stream.
+     * @param mask Relevant identifier bits.
+     * @param intervalUs Minimum average time between two frames of the stream.
+     * @param burst Number of frames which may be sent back to back after the stream was idle.
+     * @return true if the stream was added, false if all MAX_STREAMS streams are in use or the parameters are invalid.
+     */
+    bool addStream(uint32_t id, uint32_t mask, uint32_t intervalUs, uint8_t burst = 1) {
+        if(_streamCount >= MAX_STREAMS || intervalUs == 0 || intervalUs > 0x7FFFFFFF || burst == 0) return false;
+        Stream& stream = _streams[_streamCount++];
+        stream.id = id & mask;
+        stream.mask = mask;
+        stream.intervalUs = intervalUs;
+        stream.capacity = uint64_t(intervalUs) * burst > 0x7FFFFFFF ? 0x7FFFFFFF : intervalUs * burst;
+        stream.credit = stream.capacity;
+        return true;
+    }
+
+    void clearStreams() {
+        _streamCount = 0;
+        for(size_t i=0; i<_count; i++) _streamOf[_order[i]] = NONE;
+    }
+
+    uint8_t getStreamCount() const { return _streamCount; }
+
+    /**
+     * @brief Limit the bus load caused by this queue.
+     * @param permille Share of the bitrate, 0 or 1000 and above disable the limit.
+     * @param bitrate Bitrate of the bus in bit/s.
+     * @param burstBits Bits which may be sent back to back after the queue was idle, at least one extended frame with 8 data bytes.
+     */
+    void setLoadLimit(uint16_t permille, uint32_t bitrate, uint32_t burstBits = DEFAULT_BURST_BITS) {
+        _loadLimited = permille > 0 && permille < 1000 && bitrate > 0;
+        _loadPermille = permille;
+        _bitrate = bitrate;
+        if(!_loadLimited) return;
+        uint16_t largestFrame = CANFrame::getBusBits(8, true);
+        if(burstBits < largestFrame) burstBits = largestFrame;
+        _loadCapacity = getBitCost(burstBits);
+        _loadCredit = _loadCapacity;
+    }
+
+    uint16_t getLoadLimit() const { return _loadLimited ? _loadPermille : 1000; }
+
+    size_t size() const { return _count; }
+    bool empty() const { return _count == 0; }
+    static constexpr size_t capacity() { return Capacity; }
+
+    const Statistics& getStatistics() const { return _statistics; }
+    uint32_t getAverageDelay() const { return _statistics.sent ? _statistics.totalDelayUs / _statistics.sent : 0; }
+    void resetStatistics() { _statistics = {}; _statistics.maxDepth = _count; }
+
+private:
+    static constexpr uint8_t NONE = 0xFF;
+
+    //Token buckets, the credit is counted in microseconds
+    struct Stream {
+        uint32_t    id;
+        uint32_t    mask;
+        uint32_t    intervalUs;
+        int32_t     capacity;
+        int32_t     credit;
+    };
+
+    CANFrame _frames[Capacity];
+    uint32_t _keys[Capacity];
+    uint8_t _streamOf[Capacity];
+    uint8_t _order[Capacity];       // Slots sorted by priority
+    uint8_t _free[Capacity];        // Stack of unused slots
+    size_t _count = 0;
+    size_t _freeCount = 0;
+    uint8_t _peeked = NONE;
+
+    Stream _streams[MAX_STREAMS];
+    uint8_t _streamCount = 0;
+
+    bool _loadLimited = false;
+    uint16_t _loadPermille = 1000;
+    uint32_t _bitrate = 0;
+    int32_t _loadCapacity = 0;
+    int32_t _loadCredit = 0;
+
+    bool _refilled = false;
+    uint32_t _lastRefill = 0;
+    Statistics _statistics = {};
+
+    uint8_t findStream(const CANFrame& frame) const {
+        for(uint8_t i=0; i<_streamCount; i++) {
+            if((frame.getId() & _streams[i].mask) == _streams[i].id) return i;
+        }
+        return NONE;
+    }
+
+    void removeAt(size_t position) {
+        uint8_t slot = _order[position];
+        memmove(&_order[position], &_order[position + 1], _count - position - 1);
+        _count--;
+        _free[_freeCount++] = slot;
+        if(slot == _peeked) _peeked = NONE;
+    }
+
+    /**
+     * @brief Time in microseconds the given number of bits uses of the load budget, rounded up.
+     */
+    int32_t getBitCost(uint32_t bits) const {
+        uint64_t divisor = uint64_t(_bitrate) * _loadPermille;
+        uint64_t cost = (uint64_t(bits) * 1000000000ULL + divisor - 1) / divisor;
+        return cost > 0x7FFFFFFF ? 0x7FFFFFFF : cost;
+    }
+
+    int32_t getLoadCost(const CANFrame& frame) const {
+        return getBitCost(CANFrame::getBusBits(frame.isRemote() ? 0 : frame.getLength(), frame.isExtended()));
+    }
+
+    static void addCredit(int32_t& credit, int32_t capacity, uint32_t elapsed) {
+        int64_t refilled = int64_t(credit) + elapsed;
+        credit = refilled > capacity ? capacity : refilled;
+    }
+
+    void refill(uint32_t now) {
+        uint32_t elapsed = _refilled ? now - _lastRefill : 0;
+        _refilled = true;
+        _lastRefill = now;
+        if(elapsed == 0) return;
+        for(uint8_t i=0; i<_streamCount; i++) addCredit(_streams[i].credit, _streams[i].capacity, elapsed);
+        if(_loadLimited) addCredit(_loadCredit, _loadCapacity, elapsed);
+    }
+};
+
+#endif // CANTX_SCHEDULER_H
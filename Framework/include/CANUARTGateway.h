@@ -0,0 +1,126 @@
+#ifndef CANUART_GATEWAY_H
+#define CANUART_GATEWAY_H
+
+#include <Arduino.h>
+#include "CANCore.h"
+#include "CANInterface.h"
+#include "CANSerial.h"
+#include "UARTInterface.h"
+#include "Debug.h"
+
+/**
+ * @file CANUARTGateway.h
+ * @brief Declaration of the CANUARTGateway class.
+ * @details Tunnels CAN traffic through a UART in both directions, e.g. to a diagnostics PC or a legacy device on the BusModule.
+ *          Frames are framed as described in CANSerial.h. Received CAN frames are collected in a buffer and written to the UART
+ *          with one call per cycle(), so a busy bus produces few large writes instead of one write per frame. Frames received on the
+ *          UART are decoded in place in the receive buffer of the UART core (UARTCore::peek()) and sent on the CAN bus; when the CAN
+ *          core does not accept a frame, reading pauses until the next cycle and the UART driver buffers the following bytes.
+ *
+ *          The UART has no flow control: the sender on the UART must not exceed the capacity of the CAN bus for longer than the
+ *          receive buffers absorb, otherwise the UART driver drops bytes and the affected frames are lost.
+ *
+ *          Each direction has an optional acceptance filter list and a rate limit. Frames beyond the rate limit are dropped and counted.
+ *          The gateway never consumes received frames, so other listeners still see them. cycle() is called by CANInterface::process().
+ *
+ *          At 921600 baud every frame record takes at most 81 % of the time the frame occupies a 500 kbit/s bus (standard frame
+ *          without data), so the UART keeps up with a fully loaded bus. process() of the CAN interface reads at most
+ *          CANInterface::MAX_MESSAGES_PER_PROCESS frames per call; at full load call it often enough that the receive buffer of the
+ *          CAN core does not overflow, e.g. every 2 ms for up to 10000 frames/s.
+ */
+class CANUARTGateway : public CANListener {
+public:
+    static constexpr uint32_t DEFAULT_BAUDRATE = 921600;
+    static constexpr uint8_t MAX_FILTERS = 8;
+    static constexpr size_t TX_BUFFER_SIZE = 512;
+    static constexpr size_t RX_CHUNK_SIZE = 64;             // Bytes copied per read from UART cores without in-place access
+    static constexpr uint8_t MAX_FRAMES_PER_CYCLE = 32;     // Frames sent on the CAN bus per cycle()
+
+    enum Direction {
+        CAN_TO_UART = 0,
+        UART_TO_CAN = 1
+    };
+
+    struct Statistics {
+        uint32_t    forwarded;
+        uint32_t    filtered;           // Rejected by the acceptance filters
+        uint32_t    rateLimited;        // Dropped by the rate limit
+        uint32_t    dropped;            // Dropped because the destination did not accept the data
+    };
+
+    CANUARTGateway() = default;
+
+    bool begin(CANInterface* canInterface, UARTInterface* uartInterface);
+    void end();
+    bool isRunning() const { return _canInterface != nullptr; }
+
+    bool addFilter(Direction direction, uint32_t id, uint32_t mask, bool extended = false);
+    void clearFilters(Direction direction);
+    void setRateLimit(Direction direction, uint32_t framesPerSecond, uint16_t burst = 16);
+    void setTimestamps(bool enabled) { _timestamps = enabled; }
+
+    bool flush();
+
+    const Statistics& getStatistics(Direction direction) const { return _statistics[direction]; }
+    uint32_t getUartWrites() const { return _uartWrites; }
+    uint32_t getUartBytes() const { return _uartBytes; }
+    uint32_t getFramingErrors() const { return _framingErrors; }
+    void resetStatistics();
+
+    bool onMessage(const CANCore::CANMessage& message) override;
+    void cycle() override;
+
+private:
+    struct Filter {
+        uint32_t    id;
+        uint32_t    mask;
+        bool        extended;
+    };
+
+    /**
+     * @brief Token bucket, one token per frame.
+     */
+    struct RateLimit {
+        uint32_t    framesPerSecond = 0;    // 0: unlimited
+        uint64_t    capacity = 0;           // Burst in frame microseconds
+        uint64_t    tokens = 0;             // Frame microseconds
+        uint32_t    lastUpdate = 0;
+    };
+
+    CANInterface* _canInterface = nullptr;
+    UARTInterface* _uartInterface = nullptr;
+    bool _timestamps = true;
+
+    Filter _filters[2][MAX_FILTERS];
+    uint8_t _filterCount[2] = {0, 0};
+    RateLimit _rateLimits[2];
+
+    //CAN to UART
+    uint8_t _txBuffer[TX_BUFFER_SIZE];
+    size_t _txFill = 0;
+    bool _timeSent = false;
+    uint16_t _timeHigh = 0;         // Upper 16 bits of the last time record
+
+    //UART to CAN
+    uint8_t _rxBuffer[RX_CHUNK_SIZE];   // Copy of received bytes if the UART core has no in-place access
+    const uint8_t* _rxData = nullptr;   // Bytes being decoded: in the UART core or in _rxBuffer
+    bool _rxInPlace = false;
+    size_t _rxLength = 0;
+    size_t _rxPosition = 0;
+    CANSerial::Decoder _decoder;
+    bool _pending = false;          // _pendingMessage not accepted by the CAN core yet
+    CANCore::CANMessage _pendingMessage = {};
+
+    Statistics _statistics[2] = {};
+    uint32_t _uartWrites = 0;
+    uint32_t _uartBytes = 0;
+    uint32_t _framingErrors = 0;
+
+    bool accept(Direction direction, const CANFrame& frame);
+    bool appendRecord(const uint8_t* record, size_t length);
+    void receiveUART();
+    bool fetchUART();
+    void releaseUART();
+};
+
+#endif // CANUART_GATEWAY_H
@@ -0,0 +1,98 @@
+#ifndef CANUPDATE_H
+#define CANUPDATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @file CANUpdate.h
+ * @brief Declaration of the CANUpdate protocol definitions shared by CANUpdateServer and CANUpdateClient.
+ * @details An image (firmware or configuration) is streamed in blocks of up to MAX_BLOCK_SEGMENTS segments with 7 data bytes each.
+ *          Requests are sent on COB-ID 0x680 + node ID, responses on COB-ID 0x6C0 + node ID, so node IDs are limited to 1..63.
+ *
+ *          Request frames (client -> server), byte 0 selects the frame type:
+ *          - 0x00-0x7F Segment: byte 0 = segment index within the block, bytes 1-7 = data. The last segment of the image may be shorter.
+ *          - START:        [0x80, image type, size (4 bytes)]
+ *          - BLOCK_END:    [0x81, block (2 bytes), CRC-32 of the block (4 bytes)]
+ *          - END:          [0x82, CRC-32 of the image (4 bytes)]
+ *          - ACTIVATE:     [0x83]
+ *          - ABORT:        [0x84]
+ *          Response frames (server -> client): [command, status, block (2 bytes), ...]. The START response carries the number of
+ *          segments per block in byte 4 and the window, i.e. the number of blocks the client may send without acknowledgement, in byte 5.
+ *
+ *          Blocks are acknowledged after they were written. A block with a wrong CRC or missing segments is rejected and the client
+ *          sends again from this block on (go-back-N). Lost acknowledgements are repaired by the client timeout.
+ *          All multi-byte values are little endian.
+ */
+class CANUpdate {
+public:
+    static constexpr uint16_t COB_ID_REQUEST = 0x680;
+    static constexpr uint16_t COB_ID_RESPONSE = 0x6C0;
+    static constexpr uint8_t MAX_NODE_ID = 63;
+    static constexpr uint8_t SEGMENT_DATA = 7;          // Data bytes per segment
+    static constexpr uint8_t MAX_BLOCK_SEGMENTS = 64;
+    static constexpr uint8_t MAX_WINDOW = 4;
+
+    enum Command : uint8_t {
+        CMD_START       = 0x80,
+        CMD_BLOCK_END   = 0x81,
+        CMD_END         = 0x82,
+        CMD_ACTIVATE    = 0x83,
+        CMD_ABORT       = 0x84
+    };
+
+    enum Status : uint8_t {
+        STATUS_OK           = 0,
+        STATUS_BLOCK_ERROR  = 1,    // Block CRC wrong or segments missing, send again from this block
+        STATUS_NO_TARGET    = 2,    // No target for this image type
+        STATUS_TOO_LARGE    = 3,    // Image does not fit into the target
+        STATUS_WRITE_ERROR  = 4,    // Target could not be written
+        STATUS_IMAGE_ERROR  = 5,    // Image CRC wrong or image rejected by the target
+        STATUS_STATE_ERROR  = 6,    // Command not allowed in the current state
+        STATUS_TIMEOUT      = 7     // Transfer aborted by the server after a timeout
+    };
+
+    enum ImageType : uint8_t {
+        IMAGE_FIRMWARE      = 0,
+        IMAGE_CONFIGURATION = 1
+    };
+
+    /**
+     * @brief Update a CRC-32 (IEEE 802.3, reflected, polynomial 0xEDB88320).
+     * @param data Data to add.
+     * @param length Number of bytes.
+     * @param crc CRC of the preceding data, 0 to start.
+     * @return uint32_t CRC including data.
+     */
+    static uint32_t crc32(const uint8_t* data, size_t length, uint32_t crc = 0) {
+        static const uint32_t table[16] = {
+            0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+            0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+        };
+        crc = ~crc;
+        for(size_t i=0; i<length; i++) {
+            crc = (crc >> 4) ^ table[(crc ^ data[i]) & 0x0F];
+            crc = (crc >> 4) ^ table[(crc ^ (data[i] >> 4)) & 0x0F];
+        }
+        return ~crc;
+    }
+
+    static void writeU16(uint8_t* data, uint16_t value) {
+        data[0] = value;
+        data[1] = value >> 8;
+    }
+
+    static void writeU32(uint8_t* data, uint32_t value) {
+        for(uint8_t i=0; i<4; i++) data[i] = value >> (8 * i);
+    }
+
+    static uint16_t readU16(const uint8_t* data) {
+        return data[0] | (uint16_t(data[1]) << 8);
+    }
+
+    static uint32_t readU32(const uint8_t* data) {
+        return data[0] | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24);
+    }
+};
+
+#endif // CANUPDATE_H
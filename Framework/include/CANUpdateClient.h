@@ -0,0 +1,102 @@
+#ifndef CANUPDATE_CLIENT_H
+#define CANUPDATE_CLIENT_H
+
+#include <Arduino.h>
+#include <functional>
+#include "CANCore.h"
+#include "CANInterface.h"
+#include "CANUpdate.h"
+#include "Debug.h"
+
+/**
+ * @file CANUpdateClient.h
+ * @brief Declaration of the CANUpdateClient class.
+ * @details Sends a firmware or configuration image to a CANUpdateServer, see CANUpdate for the protocol. The image is read
+ *          directly from the application buffer. Segments are sent in cycle(), at most MAX_FRAMES_PER_CYCLE per call, as long as
+ *          the window of unacknowledged blocks is not full. A rejected block is sent again together with all following blocks.
+ *          Without a response for RESPONSE_TIMEOUT_MS the last request is repeated, after MAX_RETRIES repetitions the transfer fails.
+ */
+class CANUpdateClient : public CANListener {
+public:
+    static constexpr uint8_t MAX_FRAMES_PER_CYCLE = 32;
+    static constexpr uint32_t RESPONSE_TIMEOUT_MS = 500;
+    static constexpr uint8_t MAX_RETRIES = 3;
+
+    enum Result {
+        RESULT_OK,
+        RESULT_BUSY,            // Transfer running
+        RESULT_REJECTED,        // Server answered with an error status, see getServerStatus()
+        RESULT_TIMEOUT,         // No response after MAX_RETRIES repetitions
+        RESULT_ABORTED          // Transfer cancelled by abort()
+    };
+
+    /**
+     * @brief Called when a transfer has finished.
+     * @param result RESULT_OK if the image was transferred, verified and, if requested, activated.
+     */
+    using FinishedCallback = std::function<void(Result result)>;
+
+    CANUpdateClient() = default;
+
+    bool begin(CANInterface* canInterface);
+    void end();
+
+    bool start(uint8_t nodeId, uint8_t type, const uint8_t* image, uint32_t size, bool activate = true);
+    void abort();
+
+    bool isBusy() const { return _state != IDLE; }
+    Result getResult() const { return _result; }
+    uint8_t getServerStatus() const { return _serverStatus; }
+    uint32_t getAcknowledgedBytes() const;
+    uint32_t getDurationMs() const { return _durationMs; }
+    uint32_t getRepeatedBlocks() const { return _repeatedBlocks; }
+    void setFinishedCallback(FinishedCallback callback) { _finishedCallback = callback; }
+
+    bool onMessage(const CANCore::CANMessage& message) override;
+    void cycle() override;
+
+private:
+    enum State {
+        IDLE,
+        STARTING,       // START sent
+        SENDING,        // Sending blocks
+        ENDING,         // END sent after the last acknowledgement
+        ACTIVATING      // ACTIVATE sent
+    };
+
+    CANInterface* _canInterface = nullptr;
+    FinishedCallback _finishedCallback = nullptr;
+
+    State _state = IDLE;
+    Result _result = RESULT_OK;
+    uint8_t _serverStatus = CANUpdate::STATUS_OK;
+    uint8_t _nodeId = 0;
+    uint8_t _type = 0;
+    const uint8_t* _image = nullptr;    // Application buffer, must stay valid until the transfer is finished
+    uint32_t _size = 0;
+    bool _activate = true;
+
+    uint8_t _blockSegments = 0;
+    uint8_t _window = 0;
+    uint16_t _blockCount = 0;
+    uint16_t _nextBlock = 0;            // Block currently sent
+    uint8_t _segment = 0;               // Next segment of _nextBlock, the segment count stands for BLOCK_END
+    uint16_t _ackedBlock = 0;           // All blocks before were acknowledged
+    bool _abortPending = false;         // ABORT not accepted by the CAN core yet
+    uint8_t _retries = 0;
+    uint32_t _lastProgress = 0;
+    uint32_t _startTime = 0;
+    uint32_t _durationMs = 0;
+    uint32_t _repeatedBlocks = 0;
+
+    void sendBlocks();
+    bool sendCommand(uint8_t command);
+    bool sendFrame(const uint8_t* data, uint8_t length);
+    void retry();
+    void finish(Result result, uint8_t serverStatus = CANUpdate::STATUS_OK);
+
+    size_t getBlockSize() const { return size_t(_blockSegments) * CANUpdate::SEGMENT_DATA; }
+    size_t getBlockLength(uint16_t block) const;
+};
+
+#endif // CANUPDATE_CLIENT_H
@@ -0,0 +1,96 @@
+#ifndef CANUPDATE_SERVER_H
+#define CANUPDATE_SERVER_H
+
+#include <Arduino.h>
+#include <functional>
+#include "CANCore.h"
+#include "CANInterface.h"
+#include "CANUpdate.h"
+#include "UpdateTarget.h"
+#include "Debug.h"
+
+/**
+ * @file CANUpdateServer.h
+ * @brief Declaration of the CANUpdateServer class.
+ * @details Receives firmware and configuration images over a CANInterface, see CANUpdate for the protocol. Each image type is written
+ *          to its own UpdateTarget, which stages the image next to the active one. Received blocks are checked against their
+ *          CRC and buffered; cycle() writes at most one block per call and acknowledges it, so the control loop keeps running
+ *          during the transfer. The window of buffered blocks keeps the bus busy while a block is written.
+ *          After the image CRC was verified, ACTIVATE switches the target over to the new image and calls the activate callback,
+ *          e.g. to restart into new firmware at a safe point.
+ *
+ *          Segments arriving faster than process() is called are buffered by the CAN core. With slow loops, choose a block size
+ *          and window whose frames fit into the receive buffer of the core, otherwise blocks are lost and sent again.
+ */
+class CANUpdateServer : public CANListener {
+public:
+    static constexpr uint8_t MAX_TARGETS = 2;
+    static constexpr uint32_t TIMEOUT_MS = 1000;     // Transfers are aborted after this time without a request
+
+    /**
+     * @brief Called after the image was activated.
+     * @param type Image type.
+     */
+    using ActivateCallback = std::function<void(uint8_t type)>;
+
+    explicit CANUpdateServer(uint8_t nodeId = 1) : _nodeId(nodeId) {}
+
+    bool begin(CANInterface* canInterface);
+    void end();
+
+    bool setTarget(uint8_t type, UpdateTarget* target);
+    bool setNodeId(uint8_t nodeId);
+    uint8_t getNodeId() const { return _nodeId; }
+    bool setBlockSegments(uint8_t segments);
+    bool setWindow(uint8_t blocks);
+    void setActivateCallback(ActivateCallback callback) { _activateCallback = callback; }
+
+    bool isBusy() const { return _state != IDLE; }
+    uint32_t getReceivedBytes() const { return _written; }
+
+    bool onMessage(const CANCore::CANMessage& message) override;
+    void cycle() override;
+
+private:
+    enum State {
+        IDLE,
+        RECEIVING,      // Receiving and writing blocks
+        VERIFIED        // Image complete and verified, waiting for ACTIVATE
+    };
+
+    static constexpr size_t MAX_BLOCK_SIZE = CANUpdate::MAX_BLOCK_SEGMENTS * CANUpdate::SEGMENT_DATA;
+
+    CANInterface* _canInterface = nullptr;
+    uint8_t _nodeId;
+    UpdateTarget* _targets[MAX_TARGETS] = {};
+    ActivateCallback _activateCallback = nullptr;
+    uint8_t _blockSegments = CANUpdate::MAX_BLOCK_SEGMENTS;
+    uint8_t _window = CANUpdate::MAX_WINDOW;
+
+    //Transfer state
+    State _state = IDLE;
+    uint8_t _type = 0;
+    UpdateTarget* _target = nullptr;
+    uint32_t _size = 0;
+    uint16_t _blockCount = 0;
+    uint16_t _rxBlock = 0;          // Block currently received
+    uint16_t _writeBlock = 0;       // Next block to write, blocks _writeBlock.._rxBlock-1 are buffered
+    uint64_t _segments = 0;         // Received segments of the current block
+    uint32_t _written = 0;
+    uint32_t _crc = 0;              // CRC of the written image
+    uint32_t _lastActivity = 0;
+    uint8_t _buffers[CANUpdate::MAX_WINDOW][MAX_BLOCK_SIZE];
+
+    void start(const uint8_t* data);
+    void receiveSegment(const uint8_t* data, uint8_t length);
+    void blockEnd(const uint8_t* data);
+    void finish(const uint8_t* data);
+    void activate();
+    void abort(uint8_t status, bool notify);
+
+    size_t getBlockSize() const { return size_t(_blockSegments) * CANUpdate::SEGMENT_DATA; }
+    size_t getBlockLength(uint16_t block) const;
+    void sendResponse(uint8_t command, uint8_t status, uint16_t block = 0, uint8_t extra0 = 0, uint8_t extra1 = 0);
+};
+
+#endif // CANUPDATE_SERVER_H
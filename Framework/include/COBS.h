@@ -0,0 +1,74 @@
+#ifndef COBS_H
+#define COBS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @file COBS.h
+ * @brief Consistent Overhead Byte Stuffing.
+ * @details Encodes packets without zero bytes, so a single zero byte can delimit packets on a byte stream like a UART.
+ *          A receiver that lost bytes resynchronizes at the next delimiter. The overhead is one byte per started 254 data bytes.
+ */
+namespace COBS {
+
+static constexpr uint8_t DELIMITER = 0x00;
+
+/**
+ * @brief Get the worst case size of an encoded packet without the delimiter.
+ */
+constexpr size_t maxEncodedSize(size_t length) {
+    return length + length / 254 + 1;
+}
+
+/**
+ * @brief Encode a packet.
+ * @param in Packet data.
+ * @param length Packet length.
+ * @param out Destination, at least maxEncodedSize(length) bytes. Must not overlap the input.
+ * @return size_t Number of bytes written, without delimiter.
+ */
+inline size_t encode(const uint8_t* in, size_t length, uint8_t* out) {
+    size_t codePosition = 0;
+    size_t position = 1;
+    uint8_t code = 1;
+    for(size_t i=0; i<length; i++) {
+        if(in[i] != 0) {
+            out[position++] = in[i];
+            code++;
+        }
+        if(in[i] == 0 || code == 0xFF) {
+            out[codePosition] = code;
+            codePosition = position++;
+            code = 1;
+        }
+    }
+    out[codePosition] = code;
+    return position;
+}
+
+/**
+ * @brief Decode a packet.
+ * @param in Encoded packet without delimiter.
+ * @param length Encoded length.
+ * @param out Destination, at least length bytes. May be the input buffer.
+ * @return size_t Number of decoded bytes, 0 if the packet is empty or invalid.
+ */
+inline size_t decode(const uint8_t* in, size_t length, uint8_t* out) {
+    size_t position = 0;
+    size_t written = 0;
+    while(position < length) {
+        uint8_t code = in[position++];
+        if(code == 0 || position + code - 1 > length) return 0;
+        for(uint8_t i=1; i<code; i++) {
+            if(in[position] == 0) return 0;
+            out[written++] = in[position++];
+        }
+        if(code != 0xFF && position < length) out[written++] = 0;
+    }
+    return written;
+}
+
+}   // namespace COBS
+
+#endif // COBS_H
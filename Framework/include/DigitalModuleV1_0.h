@@ -125,6 +125,13 @@ class DigitalModuleV1_0 : public CANTramModule {
      */
     void cycle(uint8_t* response) override;
 
+    /**
+     * @brief Write the output interfaces to the output IC immediately.
+     * @details Reads the output interfaces, applies the output mask and writes the states to the output IC. Also called by cycle().
+     * @return bool true.
+     */
+    bool writeOutputs() override;
+
     /**
      * @brief Configure wire-break detection mask.
      * @details Apply the provided mask to enable/disable wire-break detection per channel on the input IC.
@@ -133,6 +140,22 @@ class DigitalModuleV1_0 : public CANTramModule {
      */
     void setWireBreakMask(uint8_t mask=0);
 
+    /**
+     * @brief Get the wire-break detection mask.
+     * @details Returns the mask last applied with setWireBreakMask().
+     * @return uint8_t Bitmask of channels with wire-break detection enabled.
+     */
+    uint8_t getWireBreakMask() const { return _wireBreakMask; }
+
+    /**
+     * @brief Add the module configuration to an object dictionary.
+     * @details Sub-index 1: wire-break mask (UNSIGNED8, rw), sub-index 2: output mask (UNSIGNED8, ro).
+     * @param od Object dictionary to add the entries to.
+     * @param index Object index reserved for this module.
+     * @return bool true if all entries were added.
+     */
+    bool addObjects(ObjectDictionary& od, uint16_t index) override;
+
     //Interfaces
     /**
      * @brief Get pointer to the module's interface array.
@@ -194,6 +217,7 @@ class DigitalModuleV1_0 : public CANTramModule {
         const uint8_t OUTPUT_MASK; // Mask for valid outputs
         uint8_t _outputStates = 0; // Current states of outputs
         uint8_t _wireBreaks = 0;
+        uint8_t _wireBreakMask = 0; // Last applied wire-break detection mask
         uint8_t _inputStates = 0; // Current states of inputs
         DigitalInput _digitalInputInterfaces[8]; // Array to hold 8 DigitalInput objects
         DigitalOutput _digitalOutputInterfaces[8]; // Array to hold 8 DigitalOutput objects
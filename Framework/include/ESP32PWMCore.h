@@ -11,8 +11,9 @@ class ESP32PWMCore : public PWMCore {
         void begin() override;
         bool addChannel(OutputDefinition* def) override;
 
-        void setFrequency(uint32_t freqHz) {
-            _PWMTimerConfig.freq_hz = freqHz;
+        bool setFrequency(uint32_t freqHz);
+        uint32_t getFrequency() const {
+            return _PWMTimerConfig.freq_hz;
         }
         void setResolution(ledc_timer_bit_t resolution) {
             _PWMTimerConfig.duty_resolution = resolution;
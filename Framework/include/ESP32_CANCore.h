@@ -2,10 +2,28 @@
 #define ESP32_CANCORE_H
 
 #include "CANCore.h"
+#include "CANFrameRing.h"
+#include "CANTxScheduler.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
 /**
  * @file ESP32_CANCore.h
  * @brief Declaration of the ESP32_CANCore class.
  * @details Defines the ESP32_CANCore class which implements CANCore functionalities for the ESP32 platform using the TWAI driver.
+ *          While the driver is running, a driver task moves received frames from the TWAI driver into a lock-free RX ring
+ *          and queued frames from the TX scheduler into the TWAI driver, so sendMessage(), readMessage() and available()
+ *          never block the control loop. The task also reads the TWAI alerts, keeps the statistics and the status up to date
+ *          and recovers the controller automatically from bus-off.
+ *          The TWAI TX queue is FIFO. To avoid priority inversion, queued frames are kept in a CANTxScheduler ordered by
+ *          identifier and handed to the controller one at a time, so a high-priority frame waits for at most one frame of this
+ *          node. The scheduler can additionally limit the rate of frame streams and the bus load of this node.
+ *          An attached CANResponder is served by the driver task: remote frames are answered as soon as they are received and
+ *          periodic frames are queued when due, independent of how often the application calls readMessage().
+ *          Transmit timestamps (see enableTxTimestamp()) are taken by the driver task when it reads the TX_SUCCESS alert,
+ *          with the same wake-up latency as the receive timestamps. While they are enabled, a frame is handed to the controller
+ *          only after the driver task saw the end of the previous one, so each alert belongs to a known frame.
+ *          getStatus() and getStatistics() return a snapshot taken under a spinlock, so they can be called from any task.
  */
 class ESP32_CANCore : public CANCore {
 public:
@@ -19,12 +37,83 @@ public:
     bool end() override;
     bool sendMessage(const CANMessage& message) override;
     bool readMessage(CANMessage& message) override;
+    bool readFrame(CANFrame& frame) override;
     uint8_t available() override;
     bool setupFilter(uint32_t id, uint32_t mask) override;
     bool reset() override;
+    bool setResponder(CANResponder* responder) override;
+    bool enableTxTimestamp(uint32_t id) override;
+    void disableTxTimestamp() override;
+    bool readTxTimestamp(CANFrame& frame) override;
+    Status getStatus() const override;
+    Statistics getStatistics() const override;
+
+    bool recover();
+    void setAutoRecovery(bool enabled) { _autoRecovery = enabled; }
+    bool getAutoRecovery() const { return _autoRecovery; }
+
+    using TxScheduler = CANTxScheduler<32>;
+    bool addTxStream(uint32_t id, uint32_t mask, uint32_t intervalUs, uint8_t burst = 1);
+    void clearTxStreams();
+    void setTxLoadLimit(uint16_t permille);
+    TxScheduler::Statistics getTxStatistics();
+    void resetTxStatistics();
+
+    static constexpr uint32_t DRIVER_WAIT_MS = 5;           // Maximum blocking time of the driver task per iteration
+    static constexpr size_t RX_RING_SIZE = 64;
+    static constexpr uint8_t TX_HARDWARE_DEPTH = 1;         // Frames handed to the TWAI driver at the same time
+    static constexpr uint32_t BUS_LOAD_WINDOW_MS = 1000;    // Averaging window of the bus load estimate
+    static constexpr uint32_t RECOVERY_RETRY_MS = 250;      // Recovery is initiated again if the bus-off state persists this long
+    static constexpr uint32_t DRIVER_TASK_STACK_SIZE = 3072;
+    static constexpr UBaseType_t DRIVER_TASK_PRIORITY = 5;
 
 private:
-    
+    TaskHandle_t _driverTask = nullptr;
+    volatile bool _driverTaskRunning = false;
+    bool _autoRecovery = true;
+
+    CANFrameRing<RX_RING_SIZE> _rxRing;     // Producer: driver task, consumer: readMessage()
+    TxScheduler _txScheduler;               // Filled by sendMessage(), drained by sendMessage() and the driver task, guarded by _txMutex
+    SemaphoreHandle_t _txMutex = nullptr;
+    uint16_t _txLoadPermille = 1000;
+
+    //Bus load estimation, bits are counted when frames are received or accepted for transmission
+    volatile uint32_t _rxBits = 0;
+    volatile uint32_t _txBits = 0;                      // Guarded by _txMutex
+    uint32_t _loadBits = 0;
+    uint32_t _loadWindowStart = 0;
+
+    //Transmit timestamps, all guarded by _txMutex
+    static constexpr uint32_t TX_TIMESTAMP_DISABLED = 0xFFFFFFFF;
+    uint32_t _txTimestampId = TX_TIMESTAMP_DISABLED;
+    CANFrame _txInFlight;                   // Frame in the controller whose end is not handled yet
+    bool _txInFlightValid = false;
+    CANFrame _txTimestampFrame;
+    bool _txTimestampReady = false;
+
+    //Status and statistics are written by the driver task and countTx(), guarded by _statisticsMux
+    mutable portMUX_TYPE _statisticsMux = portMUX_INITIALIZER_UNLOCKED;
+
+    //Bus-off recovery
+    uint32_t _busOffSince = 0;          // millis() when the controller went bus-off, 0 if not bus-off
+    uint32_t _lastRecoveryAttempt = 0;
+
+    bool startDriverTask();
+    void stopDriverTask();
+    static void driverTask(void* parameter);
+    bool transmitFrame(const CANFrame& frame, TickType_t wait);
+    void transmitPending();
+    void lockTx();
+    void unlockTx();
+    void receivePending(TickType_t wait);
+    void queueResponse(const CANFrame& frame);
+    void countTx(const CANFrame& frame);
+    void sendPeriodic();
+    void handleAlerts(uint32_t alerts);
+    void completeTx(bool success, uint32_t timestamp);
+    void updateStatus();
+    void setStatus(Status status);
+    void updateBusLoad();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef ESP32_OTATARGET_H
+#define ESP32_OTATARGET_H
+
+#include <Arduino.h>
+#include <esp_ota_ops.h>
+#include "UpdateTarget.h"
+#include "Debug.h"
+
+/**
+ * @file ESP32_OTATarget.h
+ * @brief Declaration of the ESP32_OTATarget class.
+ * @details Update target writing a firmware image into the inactive OTA partition of the ESP32. The running firmware is not
+ *          touched. activate() marks the new partition as boot partition, which the bootloader uses from the next restart on.
+ *          Flash sectors are erased while the image is written, so a write crossing a 4 KB sector boundary takes longer.
+ */
+class ESP32_OTATarget : public UpdateTarget {
+public:
+    ESP32_OTATarget() = default;
+    ~ESP32_OTATarget() override { abort(); }
+
+    bool begin(uint32_t size) override;
+    bool write(uint32_t offset, const uint8_t* data, size_t length) override;
+    bool finish() override;
+    bool activate() override;
+    void abort() override;
+    uint32_t getCapacity() const override;
+
+private:
+    const esp_partition_t* _partition = nullptr;
+    esp_ota_handle_t _handle = 0;
+    bool _open = false;
+    bool _finished = false;
+    uint32_t _size = 0;
+    uint32_t _written = 0;
+};
+
+#endif // ESP32_OTATARGET_H
@@ -2,11 +2,33 @@
 #define ESP32_UART_H
 
 #include <driver/uart.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include "UARTInterface.h"
 #include "UARTCore.h"
+#include "ByteRing.h"
+#include "UARTPattern.h"
+#include <atomic>
+
+#ifndef ESP32_UART_TX_RING_SIZE
+#define ESP32_UART_TX_RING_SIZE 4096       // Transmit ring of the non-blocking mode, a power of two
+#endif
 
 /*
     @brief Class to manage UART Objects on ESP32
+    @details Once the UART is started, a receive task consumes the event queue of the UART driver and moves received bytes
+             into a lock-free RX ring, so read() and available() never block and never poll the driver. The task counts FIFO
+             overflows, full driver buffers and line errors, see getRxStatistics(), and calls the receive callback whenever
+             new bytes are in the ring. While the ring is full, bytes stay in the driver buffer; only if that buffer is full
+             as well, the driver drops bytes and a buffer-full event is counted.
+             In RS-485 mode, see setRS485(), the driver switches the transceiver direction with the RTS output.
+             In non-blocking mode, see setNonBlockingSend(), send() and write() only queue the bytes in a TX ring and the same task
+             hands them to the driver as its transmit buffer gets room, so the control loop never waits for the line. The task also
+             reports the end of each transmission, see setTxDoneCallback().
+             With pattern detection, see setPatternDetection(), the UART hardware detects the delimiter and the task takes the frame
+             ends from the pattern queue of the driver, so nextFrameLength() reports complete frames without scanning the RX ring.
+             The FIFO thresholds decide how soon received bytes reach the task, see setFifoConfig(); the latency measurement,
+             see setLatencyMeasurement(), shows their effect on request/response protocols.
 */
 class ESP32_UART : public UARTCore {
     public:
@@ -17,8 +39,45 @@ class ESP32_UART : public UARTCore {
         CONFIGURED,
         STARTED
         };
+        /**
+         * @brief Receive path counters, updated by the receive task.
+         */
+        struct RxStatistics {
+            uint32_t    rxBytes;            // Bytes moved into the RX ring
+            uint32_t    fifoOverflows;      // Hardware FIFO overflowed, bytes were lost
+            uint32_t    bufferFull;         // Driver buffer was full, bytes were lost
+            uint32_t    frameErrors;
+            uint32_t    parityErrors;
+            uint32_t    breaks;
+            uint32_t    patterns;           // Detected pattern events
+        };
+        /**
+         * @brief Transmit path counters of the non-blocking mode.
+         */
+        struct TxStatistics {
+            uint32_t    txBytes;            // Bytes handed from the TX ring to the driver
+            uint32_t    rejected;           // Bytes of send() calls rejected because the TX ring was full
+            uint32_t    txDone;             // Completed transmissions, i.e. TX-done events
+            uint32_t    maxRingFill;        // Highest fill level of the TX ring in bytes
+        };
+
+        static constexpr size_t RX_RING_SIZE = 2048;
+        static constexpr size_t TX_RING_SIZE = ESP32_UART_TX_RING_SIZE;
+        static constexpr int EVENT_QUEUE_SIZE = 20;
+        static constexpr uint32_t RX_WAIT_MS = 10;              // Maximum blocking time of the receive task per iteration
+        static constexpr TickType_t TX_WAIT_TICKS = 1;          // Blocking time while transmitting, keeps the driver buffer filled
+        static constexpr uint32_t RX_TASK_STACK_SIZE = 3072;
+        static constexpr UBaseType_t RX_TASK_PRIORITY = 6;      // Above the CAN driver task: the FIFO overflows after 128 bytes
+        static constexpr uint16_t MAX_TX_IDLE_BITS = 1023;     // Limit of the transmitter idle counter
+        static constexpr int PATTERN_QUEUE_SIZE = 32;           // Pattern positions buffered by the driver until the task takes them
+        static constexpr size_t FRAME_QUEUE_SIZE = 64;          // Frame ends in the RX ring, a power of two
+        static constexpr uint8_t MAX_RX_TIMEOUT_SYMBOLS = 126;  // Limit of the RX timeout counter
+
         ESP32_UART() = default;
+        ESP32_UART(const ESP32_UART&) = delete;                 // Holds the RX and TX rings, see restoreDefaults()
+        ESP32_UART& operator=(const ESP32_UART&) = delete;
         virtual bool reset() override;
+        void restoreDefaults();
         
         bool install(
             int uart_num,
@@ -31,16 +90,85 @@ class ESP32_UART : public UARTCore {
          bool applyPins(int tx_pin, int rx_pin); //Set the TX and RX pins
         bool applyPins(); 
         void setUARTPort(uart_port_t uartPort) { _uartPort = uartPort; }
+        bool setPins(uint8_t tx_pin, uint8_t rx_pin) override;
 
-        bool send(char buffer[], size_t size) override;
+        bool send(const char buffer[], size_t size) override;
         size_t read(char buffer[]) override;
+        size_t write(const uint8_t* data, size_t length) override;
+        size_t read(uint8_t* buffer, size_t capacity) override;
+        size_t peek(const uint8_t*& data) override;
+        void consume(size_t length) override;
         size_t available() override;
         void flush() override;
+        bool setReceiveCallback(ReceiveCallback callback) override;
+        bool setRS485(bool enabled, const RS485Config& config) override;
+        uint32_t getCollisionCount() const override { return _collisions; }
+        bool setNonBlockingSend(bool enabled) override;
+        bool setTxDoneCallback(TxDoneCallback callback) override;
+        bool isTxDone() override;
+        bool setPatternDetection(bool enabled, const PatternConfig& config) override;
+        size_t nextFrameLength() override;
+        bool setFifoConfig(const FifoConfig& config) override;
+        bool setLatencyMeasurement(bool enabled) override;
+        LatencyStatistics getLatencyStatistics() const override;
+        void resetLatencyStatistics() override;
+
+        RxStatistics getRxStatistics() const { return _rxStatistics; }
+        void resetRxStatistics() { _rxStatistics = {}; }
+        TxStatistics getTxStatistics() const { return _txStatistics; }
+        void resetTxStatistics() { _txStatistics = {}; }
     private:
         uartState _state = NONE;
         QueueHandle_t uart_queue = nullptr;
         uart_port_t _uartPort=DEFAULT_REF;
 
+        TaskHandle_t _rxTask = nullptr;
+        volatile bool _rxTaskRunning = false;
+        ByteRing<RX_RING_SIZE> _rxRing;         // Producer: receive task, consumer: read()
+        ReceiveCallback _receiveCallback;
+        RxStatistics _rxStatistics = {};
+        volatile uint32_t _lastRxUs = 0;        // micros() when the receive task last moved bytes, for the RS-485 turnaround
+        std::atomic<bool> _txPending{false};    // RS-485 transmission whose collision flag was not checked yet
+        volatile uint32_t _collisions = 0;
+
+        bool _nonBlocking = false;
+        ByteRing<TX_RING_SIZE> _txRing;         // Producer: send()/write() in non-blocking mode, consumer: receive task
+        TxDoneCallback _txDoneCallback;
+        bool _txActive = false;                 // Transmission whose end was not reported yet, receive task only
+        std::atomic<bool> _txStarted{false};    // Bytes written to the driver outside the receive task
+        std::atomic<bool> _txWakeup{false};     // Wakeup event for the receive task queued
+        TxStatistics _txStatistics = {};
+        size_t _txBufferSize = 0;               // Transmit buffer size of the driver
+        std::atomic<size_t> _txBufferUsed{0};   // Bytes in the driver's transmit buffer, before ESP-IDF 5.1 only, see txBufferSpace()
+
+        UARTPatternQueue<FRAME_QUEUE_SIZE> _frames;     // Producer: receive task, consumer: read()/consume()
+
+        bool _latencyMeasurement = false;
+        volatile bool _awaitingResponse = false;        // Transmission without readable byte after its end yet
+        volatile uint32_t _requestEndUs = 0;            // Calculated end of the last transmission
+        LatencyStatistics _latency = {};
+        mutable portMUX_TYPE _latencyMux = portMUX_INITIALIZER_UNLOCKED;    // Guards the latency state above, written by the loop and the receive task
+
+        bool startRxTask();
+        void stopRxTask();
+        static void rxTask(void* parameter);
+        void handleEvent(const uart_event_t& event);
+        size_t receivePending();
+        size_t queueTx(const uint8_t* data, size_t length);
+        void transmitPending();
+        void wakeTask();
+        size_t txBufferSpace();
+        int writeDriver(const void* data, size_t length);
+        bool isQueuing() const { return _nonBlocking && _rxTask != nullptr; }
+        bool applyMode();
+        bool applyPatternDetection();
+        void takePatternPositions();
+        bool applyFifoConfig();
+        void markRequest(size_t length);
+        void markResponse(uint32_t nowUs);
+        uint32_t turnaroundRemaining() const;
+        void checkCollision();
+
         uart_word_length_t toEsp32DataBits(UARTCore::DataBits bits) {
             switch (bits) {
             case UARTCore::DataBits::UART_DATA_5_BITS: return uart_word_length_t(UART_DATA_5_BITS);
@@ -53,10 +181,10 @@ class ESP32_UART : public UARTCore {
 
         uart_parity_t toEsp32Parity(UARTCore::Parity parity) {
             switch (parity) {
-            case UARTCore::Parity::UART_PARITY_NONE: return uart_parity_t(UART_PARITY_DISABLE);
-            case UARTCore::Parity::UART_PARITY_EVEN: return uart_parity_t(UART_PARITY_EVEN);
-            case UARTCore::Parity::UART_PARITY_ODD:  return uart_parity_t(UART_PARITY_ODD);
-            default: return uart_parity_t(UART_PARITY_DISABLE); // fallback or handle error
+            case UARTCore::Parity::UART_PARITY_NONE: return uart_parity_t(::UART_PARITY_DISABLE);
+            case UARTCore::Parity::UART_PARITY_EVEN: return uart_parity_t(::UART_PARITY_EVEN);   // Qualified: UARTCore::UART_PARITY_EVEN has a different value
+            case UARTCore::Parity::UART_PARITY_ODD:  return uart_parity_t(::UART_PARITY_ODD);
+            default: return uart_parity_t(::UART_PARITY_DISABLE); // fallback or handle error
             }
         }
 
@@ -0,0 +1,88 @@
+#ifndef FILEUPDATETARGET_H
+#define FILEUPDATETARGET_H
+
+#include <stdio.h>
+#include <string.h>
+#include "UpdateTarget.h"
+
+/**
+ * @file FileUpdateTarget.h
+ * @brief Declaration of the FileUpdateTarget class.
+ * @details Update target backed by a file, e.g. a configuration file or a flash stand-in on the host. The image is staged in
+ *          "<path>.new" and renamed to path in activate(). On POSIX file systems the rename replaces the active file atomically.
+ *          File systems without atomic replacement (e.g. SPIFFS) need the active file removed first, which activate() does
+ *          if the first rename fails.
+ */
+class FileUpdateTarget : public UpdateTarget {
+public:
+    static constexpr size_t MAX_PATH = 64;
+
+    /**
+     * @param path Path of the active file, at most MAX_PATH - 5 characters.
+     * @param capacity Maximum image size in bytes.
+     */
+    FileUpdateTarget(const char* path, uint32_t capacity) : _capacity(capacity) {
+        snprintf(_path, sizeof(_path), "%s", path);
+        snprintf(_stagingPath, sizeof(_stagingPath), "%s.new", path);
+    }
+    ~FileUpdateTarget() override { abort(); }
+    FileUpdateTarget(const FileUpdateTarget&) = delete;
+    FileUpdateTarget& operator=(const FileUpdateTarget&) = delete;
+
+    bool begin(uint32_t size) override {
+        abort();
+        if(size > _capacity) return false;
+        _file = fopen(_stagingPath, "wb");
+        _size = size;
+        _written = 0;
+        _finished = false;
+        return _file != nullptr;
+    }
+
+    bool write(uint32_t offset, const uint8_t* data, size_t length) override {
+        if(_file == nullptr || offset != _written || _written + length > _size) return false;
+        if(fwrite(data, 1, length, _file) != length) return false;
+        _written += length;
+        return true;
+    }
+
+    bool finish() override {
+        if(_file == nullptr || _written != _size) return false;
+        bool ok = fflush(_file) == 0;
+        ok = fclose(_file) == 0 && ok;
+        _file = nullptr;
+        _finished = ok;
+        return ok;
+    }
+
+    bool activate() override {
+        if(!_finished) return false;
+        if(rename(_stagingPath, _path) != 0) {
+            remove(_path);
+            if(rename(_stagingPath, _path) != 0) return false;
+        }
+        _finished = false;
+        return true;
+    }
+
+    void abort() override {
+        if(_file) fclose(_file);
+        if(_file || _finished) remove(_stagingPath);
+        _file = nullptr;
+        _finished = false;
+    }
+
+    uint32_t getCapacity() const override { return _capacity; }
+    const char* getPath() const { return _path; }
+
+private:
+    char _path[MAX_PATH];
+    char _stagingPath[MAX_PATH];
+    uint32_t _capacity;
+    FILE* _file = nullptr;
+    uint32_t _size = 0;
+    uint32_t _written = 0;
+    bool _finished = false;
+};
+
+#endif // FILEUPDATETARGET_H
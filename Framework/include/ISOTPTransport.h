@@ -0,0 +1,152 @@
+#ifndef ISOTP_TRANSPORT_H
+#define ISOTP_TRANSPORT_H
+
+#include <Arduino.h>
+#include <functional>
+#include "CANCore.h"
+#include "CANInterface.h"
+#include "Debug.h"
+
+/**
+ * @file ISOTPTransport.h
+ * @brief Declaration of the ISOTPTransport class.
+ * @details Defines an ISO-TP (ISO 15765-2) transport layer on top of a CANInterface for payloads larger than 8 bytes.
+ *          Each session is a pair of CAN IDs (one for transmission, one for reception) and can send and receive at the same time.
+ *          Received data is reassembled directly into a buffer provided by the application and sent data is read directly
+ *          from the application buffer, so no data is copied inside the transport.
+ *
+ *          Supported frame types: single frame (SF), first frame (FF), consecutive frame (CF) and flow control (FC)
+ *          with block size (BS) and minimum separation time (STmin). Payloads up to MAX_PAYLOAD_SIZE bytes are supported.
+ */
+class ISOTPTransport : public CANListener {
+public:
+    static constexpr uint8_t MAX_SESSIONS = 4;
+    static constexpr size_t MAX_PAYLOAD_SIZE = 4095;        // 12-bit FF_DL of classic CAN
+    static constexpr uint32_t TIMEOUT_MS = 1000;            // N_Bs and N_Cr timeout
+    static constexpr uint8_t MAX_FRAMES_PER_CYCLE = 32;     // Consecutive frames sent per session and cycle() if STmin is 0
+    static constexpr uint8_t MAX_WAIT_FRAMES = 10;          // Number of FC.WAIT frames accepted before the transfer is aborted
+    static constexpr uint8_t PADDING_BYTE = 0xCC;
+
+    enum Result {
+        RESULT_OK,
+        RESULT_TIMEOUT,             // N_Bs or N_Cr timeout
+        RESULT_WRONG_SEQUENCE,      // Unexpected sequence number
+        RESULT_OVERFLOW,            // Receive buffer too small or FC.OVFLW received
+        RESULT_UNEXPECTED_FRAME,    // Frame does not fit the current state
+        RESULT_WAIT_LIMIT,          // Too many FC.WAIT frames received
+        RESULT_ABORTED              // Transfer cancelled by closeSession()
+    };
+
+    /**
+     * @brief Called when a transmission has finished.
+     * @param session Session handle.
+     * @param result RESULT_OK if the whole payload was sent.
+     */
+    using TransmitCallback = std::function<void(uint8_t session, Result result)>;
+
+    /**
+     * @brief Called when a reception has finished.
+     * @details On RESULT_OK the payload is stored in the receive buffer of the session. The buffer is not written again
+     *          until the callback returns, so the application can process the data in place or assign a new buffer with
+     *          setReceiveBuffer() (double buffering).
+     * @param session Session handle.
+     * @param result RESULT_OK if a complete payload was received.
+     * @param data Receive buffer of the session.
+     * @param length Number of received bytes.
+     */
+    using ReceiveCallback = std::function<void(uint8_t session, Result result, const uint8_t* data, size_t length)>;
+
+    ISOTPTransport() = default;
+
+    bool begin(CANInterface* canInterface);
+    void end();
+
+    int8_t openSession(uint32_t txId, uint32_t rxId, bool isExtended = false);
+    void closeSession(uint8_t session);
+    bool setReceiveBuffer(uint8_t session, uint8_t* buffer, size_t capacity);
+
+    bool send(uint8_t session, const uint8_t* data, size_t length);
+    bool isSending(uint8_t session) const;
+    bool isReceiving(uint8_t session) const;
+
+    void setFlowControl(uint8_t blockSize, uint8_t stMin);
+    void setPadding(bool enabled) { _padding = enabled; }
+    void setTransmitCallback(TransmitCallback callback) { _transmitCallback = callback; }
+    void setReceiveCallback(ReceiveCallback callback) { _receiveCallback = callback; }
+
+    bool onMessage(const CANCore::CANMessage& message) override;
+    void cycle() override;
+
+    static uint32_t stMinToUs(uint8_t stMin);
+
+private:
+    enum FrameType : uint8_t {
+        SINGLE_FRAME        = 0x0,
+        FIRST_FRAME         = 0x1,
+        CONSECUTIVE_FRAME   = 0x2,
+        FLOW_CONTROL        = 0x3
+    };
+
+    enum FlowStatus : uint8_t {
+        FC_CONTINUE = 0x0,
+        FC_WAIT     = 0x1,
+        FC_OVERFLOW = 0x2
+    };
+
+    enum TxState : uint8_t {
+        TX_IDLE,
+        TX_WAIT_FC,         // Waiting for flow control after FF or after a complete block
+        TX_SENDING          // Sending consecutive frames
+    };
+
+    struct Session {
+        bool        used;
+        bool        isExtended;
+        uint32_t    txId;
+        uint32_t    rxId;
+
+        //Transmission
+        TxState         txState;
+        const uint8_t*  txData;         // Application buffer, must stay valid until the transfer is finished
+        size_t          txLength;
+        size_t          txOffset;
+        uint8_t         txSequence;
+        uint8_t         txBlockSize;    // Block size requested by the receiver, 0 = no further FC
+        uint8_t         txBlockCount;   // Consecutive frames sent in the current block
+        uint8_t         txWaitCount;
+        uint32_t        txSeparationUs; // STmin requested by the receiver
+        uint32_t        txLastFrame;    // micros() of the last CF
+        uint32_t        txLastActivity; // millis() of the last FC
+
+        //Reception
+        uint8_t*    rxBuffer;       // Application buffer
+        size_t      rxCapacity;
+        size_t      rxLength;       // Length announced in the FF
+        size_t      rxOffset;
+        uint8_t     rxSequence;
+        uint8_t     rxBlockCount;
+        bool        rxActive;
+        uint32_t    rxLastActivity; // millis() of the last FF/CF
+    };
+
+    CANInterface* _canInterface = nullptr;
+    Session _sessions[MAX_SESSIONS] = {};
+    uint8_t _blockSize = 0;         // Block size sent in our FC frames
+    uint8_t _stMin = 0;             // STmin sent in our FC frames
+    bool _padding = true;
+    TransmitCallback _transmitCallback = nullptr;
+    ReceiveCallback _receiveCallback = nullptr;
+
+    void handleSingleFrame(uint8_t index, const CANCore::CANMessage& message);
+    void handleFirstFrame(uint8_t index, const CANCore::CANMessage& message);
+    void handleConsecutiveFrame(uint8_t index, const CANCore::CANMessage& message);
+    void handleFlowControl(uint8_t index, const CANCore::CANMessage& message);
+
+    void sendConsecutiveFrames(uint8_t index);
+    bool sendFrame(const Session& session, const uint8_t* data, uint8_t length);
+    bool sendFlowControl(const Session& session, FlowStatus status);
+    void finishTransmit(uint8_t index, Result result);
+    void finishReceive(uint8_t index, Result result);
+};
+
+#endif // ISOTP_TRANSPORT_H
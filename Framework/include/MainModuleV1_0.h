@@ -20,6 +20,7 @@
 #include "Debug.h"
 #include "ESP32_UART.h"
 #include "UARTInterface.h"
+#include "UARTMultiplexer.h"
 #include "HardwareResource.h"
 #include "driver/adc.h"
 #include "soc/adc_channel.h"
@@ -162,6 +163,9 @@ static const uint8_t LED_ERROR = SR_PIN_1;
 
         uint16_t getTemperatureCelsius();
 
+        bool setSharedUARTSegments(uint8_t segments);
+        UARTMultiplexer& getUARTMultiplexer() { return _uartMux; }
+
        
         void cycle(uint8_t* response) override;
 
@@ -169,17 +173,23 @@ static const uint8_t LED_ERROR = SR_PIN_1;
         size_t getInterfaceCount() override { return INTERFACE_COUNT; }
 
         
+        bool addObjects(ObjectDictionary& od, uint16_t index) override;
+
         bool setPWM(OutputDefinition* def, uint16_t value) override;
         bool registerPWMChannel(OutputDefinition* def) override;
     private:
         static constexpr size_t INTERFACE_COUNT = 1; // Number of interfaces in the array
         Interface* _interfaces[INTERFACE_COUNT]; // representation of the physical interfaces clamps
         ESP32PWMCore _pwmCore;
-        ESP32_UART uart;
+        static constexpr uint8_t UART_COUNT = UART_NUM_MAX - 1;    // UART_NUM_0 is used by the serial console
+        static constexpr uint8_t UART_NUM = UART_NUM_1;             // First port, the others follow
+        static constexpr uint16_t UART_BUFFER_SIZE = 1024;
+        ESP32_UART uart[UART_COUNT];
+        UARTMultiplexer _uartMux;                                   // Shares the last port if segments are set
         ESP32_I2CCore i2cCore;
 
-        static constexpr uint8_t UART_NUM = UART_NUM_1;
-        static constexpr uint16_t UART_BUFFER_SIZE = 1024;
+        uint8_t getDedicatedUARTCount() const { return _uartMux.getSegmentCount() > 0 ? UART_COUNT - 1 : UART_COUNT; }
+        bool initUART(ESP32_UART& core, uint8_t port);
 
         
 
@@ -197,7 +207,7 @@ static const uint8_t LED_ERROR = SR_PIN_1;
         ShiftRegistertStatus _shiftregisterStatus = NOT_STARTED;
 
     protected:
-        virtual UARTCore* getUartCore() override { return &uart; }
+        virtual UARTCore* getUartCore() override { return &uart[0]; }
         
 };  
 
@@ -0,0 +1,194 @@
+#ifndef MODBUS_H
+#define MODBUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @file Modbus.h
+ * @brief Modbus RTU framing shared by master and slave.
+ * @details An RTU frame (ADU) consists of the slave address, the function code, the data and a CRC16 (low byte first).
+ *          Register values and addresses are big endian. Frames are separated by at least 3.5 character times of silence (T3.5),
+ *          a silence of more than 1.5 character times (T1.5) inside a frame makes the frame invalid. Above 19200 baud both times
+ *          are fixed to 750 us and 1750 us.
+ */
+namespace Modbus {
+
+static constexpr size_t MAX_ADU_SIZE = 256;
+static constexpr uint8_t BROADCAST = 0;
+static constexpr uint8_t MAX_SLAVE = 247;
+static constexpr uint16_t MAX_READ_BITS = 2000;
+static constexpr uint16_t MAX_READ_REGISTERS = 125;
+static constexpr uint16_t MAX_WRITE_BITS = 1968;
+static constexpr uint16_t MAX_WRITE_REGISTERS = 123;
+static constexpr uint8_t EXCEPTION_FLAG = 0x80;
+
+enum Function : uint8_t {
+    READ_COILS = 1,
+    READ_DISCRETE_INPUTS = 2,
+    READ_HOLDING_REGISTERS = 3,
+    READ_INPUT_REGISTERS = 4,
+    WRITE_SINGLE_COIL = 5,
+    WRITE_SINGLE_REGISTER = 6,
+    WRITE_MULTIPLE_COILS = 15,
+    WRITE_MULTIPLE_REGISTERS = 16
+};
+
+enum Exception : uint8_t {
+    NO_EXCEPTION = 0,
+    ILLEGAL_FUNCTION = 1,
+    ILLEGAL_DATA_ADDRESS = 2,
+    ILLEGAL_DATA_VALUE = 3,
+    SERVER_DEVICE_FAILURE = 4,
+    ACKNOWLEDGE = 5,
+    SERVER_DEVICE_BUSY = 6
+};
+
+/**
+ * @brief Lookup table of the CRC16 with the reflected polynomial 0xA001.
+ */
+inline const uint16_t* crcTable() {
+    static const uint16_t table[256] = {
+        0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+        0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+        0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+        0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+        0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+        0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+        0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+        0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+        0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+        0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+        0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+        0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+        0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+        0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+        0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+        0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+        0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+        0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+        0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+        0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+        0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+        0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+        0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+        0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+        0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+        0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+        0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+        0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+        0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+        0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+        0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+        0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040
+    };
+    return table;
+}
+
+/**
+ * @brief Calculate the CRC16 of a frame, one table lookup per byte.
+ */
+inline uint16_t crc16(const uint8_t* data, size_t length, uint16_t crc = 0xFFFF) {
+    const uint16_t* table = crcTable();
+    for(size_t i=0; i<length; i++) crc = (crc >> 8) ^ table[(crc ^ data[i]) & 0xFF];
+    return crc;
+}
+
+/**
+ * @brief Append the CRC to a frame.
+ * @return size_t Length of the frame including the CRC.
+ */
+inline size_t appendCrc(uint8_t* frame, size_t length) {
+    uint16_t crc = crc16(frame, length);
+    frame[length] = crc & 0xFF;
+    frame[length + 1] = crc >> 8;
+    return length + 2;
+}
+
+/**
+ * @brief Check the CRC at the end of a frame.
+ */
+inline bool checkCrc(const uint8_t* frame, size_t length) {
+    if(length < 4) return false;
+    uint16_t crc = crc16(frame, length - 2);
+    return frame[length - 2] == (crc & 0xFF) && frame[length - 1] == (crc >> 8);
+}
+
+inline uint16_t get16(const uint8_t* data) { return uint16_t(data[0]) << 8 | data[1]; }
+inline void put16(uint8_t* data, uint16_t value) { data[0] = value >> 8; data[1] = value & 0xFF; }
+
+/**
+ * @brief Duration of one character on the line.
+ * @param bitsPerChar 11 for RTU: start bit, 8 data bits, parity or second stop bit, stop bit.
+ */
+inline uint32_t charTimeUs(uint32_t baudrate, uint8_t bitsPerChar = 11) {
+    return baudrate > 0 ? (uint32_t(bitsPerChar) * 1000000 + baudrate - 1) / baudrate : 0;
+}
+
+/**
+ * @brief Maximum silence between two characters of a frame (T1.5).
+ */
+inline uint32_t t15Us(uint32_t baudrate, uint8_t bitsPerChar = 11) {
+    return baudrate > 19200 ? 750 : charTimeUs(baudrate, bitsPerChar) * 3 / 2;
+}
+
+/**
+ * @brief Minimum silence between two frames (T3.5).
+ */
+inline uint32_t t35Us(uint32_t baudrate, uint8_t bitsPerChar = 11) {
+    return baudrate > 19200 ? 1750 : charTimeUs(baudrate, bitsPerChar) * 7 / 2;
+}
+
+/**
+ * @brief Check if a function code is one of the Function codes supported by master and slave.
+ */
+inline bool isSupported(uint8_t function) {
+    switch(function) {
+        case READ_COILS:
+        case READ_DISCRETE_INPUTS:
+        case READ_HOLDING_REGISTERS:
+        case READ_INPUT_REGISTERS:
+        case WRITE_SINGLE_COIL:
+        case WRITE_SINGLE_REGISTER:
+        case WRITE_MULTIPLE_COILS:
+        case WRITE_MULTIPLE_REGISTERS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Get the length of a frame from its first bytes.
+ * @param frame Received bytes.
+ * @param length Number of received bytes.
+ * @param request true for a request received by a slave, false for a response received by a master.
+ * @return size_t Length of the complete frame including the CRC, 0 if more bytes are needed to know it.
+ *         Frames with unknown function codes are reported as 0, they end with the next T3.5 silence or a valid CRC.
+ */
+inline size_t frameLength(const uint8_t* frame, size_t length, bool request) {
+    if(length < 2) return 0;
+    uint8_t function = frame[1];
+    if(!request && (function & EXCEPTION_FLAG)) return 5;
+    switch(function) {
+        case READ_COILS:
+        case READ_DISCRETE_INPUTS:
+        case READ_HOLDING_REGISTERS:
+        case READ_INPUT_REGISTERS:
+            if(request) return 8;
+            return length >= 3 ? 5 + frame[2] : 0;
+        case WRITE_SINGLE_COIL:
+        case WRITE_SINGLE_REGISTER:
+            return 8;
+        case WRITE_MULTIPLE_COILS:
+        case WRITE_MULTIPLE_REGISTERS:
+            if(!request) return 8;
+            return length >= 7 ? 9 + frame[6] : 0;
+        default:
+            return 0;
+    }
+}
+
+}   // namespace Modbus
+
+#endif // MODBUS_H
@@ -0,0 +1,479 @@
+#ifndef MODBUS_RTU_MASTER_H
+#define MODBUS_RTU_MASTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <functional>
+#include "Modbus.h"
+
+/**
+ * @file ModbusRTUMaster.h
+ * @brief Declaration of the ModbusRTUMaster class.
+ * @details Non-blocking Modbus RTU master. Read requests are configured once as polls with an interval; the responses are copied
+ *          into a register image which the control loop reads at any time without waiting for the bus. Writes are queued and sent
+ *          before the next poll. cycle() advances the state machine and never blocks, call it as often as possible, at least
+ *          once per character time for the best bus utilization, e.g. from the module cycle or a dedicated task.
+ *
+ *          Timing: a request is sent only after T3.5 of silence on the line, both after the own request and after the last received
+ *          byte. A response is complete as soon as its expected length is received, so the next request leaves T3.5 after the
+ *          response instead of waiting for the silence to be detected first, and the request frame is prepared while the previous
+ *          response is still being received. With setStrictTiming(true), a response with a silence of more than T1.5 between two
+ *          characters is rejected. This needs a port delivering bytes when they arrive, e.g. an ESP32 UART with an RX timeout
+ *          threshold of one character; drivers collecting bytes in a FIFO would otherwise cause false errors.
+ *
+ *          The port is any class with size_t write(const uint8_t*, size_t) and size_t read(uint8_t*, size_t), e.g. UARTInterface.
+ */
+template<typename Port>
+class ModbusRTUMaster {
+public:
+    static constexpr uint8_t MAX_POLLS = 32;
+    static constexpr uint16_t IMAGE_SIZE = 512;             // Registers, bits are packed 16 per register
+    static constexpr uint8_t WRITE_QUEUE_SIZE = 8;
+    static constexpr uint8_t MAX_WRITE_VALUES = 32;         // Registers per queued write
+    static constexpr uint32_t DEFAULT_TIMEOUT_US = 100000;
+    static constexpr uint32_t DEFAULT_TURNAROUND_US = 100000;   // Time given to the slaves to process a broadcast
+
+    enum Result {
+        OK,
+        TIMEOUT,
+        CRC_ERROR,
+        FRAME_ERROR,        // Unexpected address, function or length, or a gap of more than T1.5 inside the frame
+        EXCEPTION           // The slave answered with an exception code
+    };
+
+    struct PollStatus {
+        uint32_t            lastUpdateUs;       // cycle() time of the last valid response
+        uint32_t            responses;
+        uint32_t            timeouts;
+        uint32_t            errors;             // CRC and frame errors
+        uint32_t            exceptions;
+        Modbus::Exception   lastException;
+        Result              lastResult;
+        bool                valid;              // The image holds at least one response
+    };
+
+    struct Statistics {
+        uint32_t    requests;
+        uint32_t    responses;
+        uint32_t    timeouts;
+        uint32_t    crcErrors;
+        uint32_t    frameErrors;
+        uint32_t    exceptions;
+        uint32_t    unexpectedBytes;            // Received while no response was expected
+        uint32_t    lateRequests;               // Polls sent more than one interval after they were due
+    };
+
+    using WriteCallback = std::function<void(uint8_t slave, uint16_t address, Result result, Modbus::Exception exception)>;
+
+    explicit ModbusRTUMaster(Port& port) : _port(port) {}
+
+    /**
+     * @brief Set the line timing and reset the state machine. Polls and the image are kept.
+     * @param baudrate Baudrate of the port.
+     * @param bitsPerChar Bits per character, 11 for RTU.
+     */
+    void begin(uint32_t baudrate, uint8_t bitsPerChar = 11) {
+        _charTimeUs = Modbus::charTimeUs(baudrate, bitsPerChar);
+        _t15Us = Modbus::t15Us(baudrate, bitsPerChar);
+        _t35Us = Modbus::t35Us(baudrate, bitsPerChar);
+        _state = IDLE;
+        _prepared = false;
+        _writeHead = 0;
+        _writeCount = 0;
+        _started = false;
+    }
+
+    void setTimeout(uint32_t timeoutUs) { _timeoutUs = timeoutUs; }
+    void setTurnaround(uint32_t turnaroundUs) { _turnaroundUs = turnaroundUs; }
+    void setStrictTiming(bool strict) { _strictTiming = strict; }
+    void setWriteCallback(WriteCallback callback) { _writeCallback = callback; }
+    uint32_t getT15() const { return _t15Us; }
+    uint32_t getT35() const { return _t35Us; }
+
+    /**
+     * @brief Read registers or bits of a slave periodically into the image.
+     * @param slave Slave address 1-247.
+     * @param function READ_COILS, READ_DISCRETE_INPUTS, READ_HOLDING_REGISTERS or READ_INPUT_REGISTERS.
+     * @param address First register or bit.
+     * @param count Number of registers or bits.
+     * @param intervalUs Poll interval, 0 to poll as often as possible.
+     * @return int8_t Handle of the poll, -1 if the poll is invalid, MAX_POLLS polls exist or the image is full.
+     */
+    int8_t addPoll(uint8_t slave, Modbus::Function function, uint16_t address, uint16_t count, uint32_t intervalUs) {
+        bool bits = function == Modbus::READ_COILS || function == Modbus::READ_DISCRETE_INPUTS;
+        bool registers = function == Modbus::READ_HOLDING_REGISTERS || function == Modbus::READ_INPUT_REGISTERS;
+        if(_pollCount >= MAX_POLLS || slave == Modbus::BROADCAST || slave > Modbus::MAX_SLAVE || count == 0) return -1;
+        if(!(bits && count <= Modbus::MAX_READ_BITS) && !(registers && count <= Modbus::MAX_READ_REGISTERS)) return -1;
+        uint16_t words = bits ? (count + 15) / 16 : count;
+        if(_imageUsed + words > IMAGE_SIZE) return -1;
+        Poll& poll = _polls[_pollCount];
+        poll = {};
+        poll.slave = slave;
+        poll.function = function;
+        poll.address = address;
+        poll.count = count;
+        poll.intervalUs = intervalUs;
+        poll.offset = _imageUsed;
+        poll.nextDueUs = _nowUs;
+        _imageUsed += words;
+        memset(&_image[poll.offset], 0, words * sizeof(uint16_t));
+        return _pollCount++;
+    }
+
+    void clearPolls() {
+        _pollCount = 0;
+        _imageUsed = 0;
+        if(_state != IDLE && _current.poll >= 0) _current.poll = -1;
+        if(_prepared && _next.poll >= 0) _prepared = false;
+    }
+
+    /**
+     * @brief Queue a write of one holding register.
+     * @param slave Slave address, 0 for a broadcast to all slaves.
+     * @return true if the write was queued.
+     */
+    bool writeRegister(uint8_t slave, uint16_t address, uint16_t value) {
+        uint8_t data[4];
+        Modbus::put16(&data[0], address);
+        Modbus::put16(&data[2], value);
+        return queueWrite(slave, Modbus::WRITE_SINGLE_REGISTER, address, data, sizeof(data));
+    }
+
+    /**
+     * @brief Queue a write of up to MAX_WRITE_VALUES holding registers.
+     */
+    bool writeRegisters(uint8_t slave, uint16_t address, const uint16_t* values, uint8_t count) {
+        if(count == 0 || count > MAX_WRITE_VALUES) return false;
+        uint8_t data[5 + 2 * MAX_WRITE_VALUES];
+        Modbus::put16(&data[0], address);
+        Modbus::put16(&data[2], count);
+        data[4] = 2 * count;
+        for(uint8_t i=0; i<count; i++) Modbus::put16(&data[5 + 2 * i], values[i]);
+        return queueWrite(slave, Modbus::WRITE_MULTIPLE_REGISTERS, address, data, 5 + 2 * count);
+    }
+
+    /**
+     * @brief Queue a write of one coil.
+     */
+    bool writeCoil(uint8_t slave, uint16_t address, bool value) {
+        uint8_t data[4];
+        Modbus::put16(&data[0], address);
+        Modbus::put16(&data[2], value ? 0xFF00 : 0x0000);
+        return queueWrite(slave, Modbus::WRITE_SINGLE_COIL, address, data, sizeof(data));
+    }
+
+    /**
+     * @brief Get the registers of a poll, in the order of the slave's addresses.
+     * @return const uint16_t* Image of the poll, nullptr for an invalid handle.
+     */
+    const uint16_t* getRegisters(int8_t poll) const {
+        return poll >= 0 && poll < _pollCount ? &_image[_polls[poll].offset] : nullptr;
+    }
+
+    /**
+     * @brief Get a bit of a coil or discrete input poll.
+     * @param index Bit relative to the first address of the poll.
+     */
+    bool getBit(int8_t poll, uint16_t index) const {
+        if(poll < 0 || poll >= _pollCount || index >= _polls[poll].count) return false;
+        return (_image[_polls[poll].offset + index / 16] >> (index % 16)) & 1;
+    }
+
+    const PollStatus& getStatus(int8_t poll) const { return _polls[poll >= 0 && poll < _pollCount ? poll : 0].status; }
+    uint8_t getPollCount() const { return _pollCount; }
+    const Statistics& getStatistics() const { return _statistics; }
+    void resetStatistics() { _statistics = {}; }
+    bool isIdle() const { return _state == IDLE && !_prepared && _writeCount == 0; }
+
+    /**
+     * @brief Advance the state machine: receive, check the response, send the next request.
+     * @param nowUs Current time in microseconds, e.g. micros().
+     */
+    void cycle(uint32_t nowUs) {
+        _nowUs = nowUs;
+        if(!_started) {
+            //The line state before the first call is unknown: wait for T3.5 of silence
+            _started = true;
+            _lastRxUs = nowUs;
+            _txEndUs = nowUs;
+            for(uint8_t i=0; i<_pollCount; i++) _polls[i].nextDueUs = nowUs;
+        }
+        receive();
+        switch(_state) {
+            case WAITING:
+                checkResponse();
+                break;
+            case TURNAROUND:
+                if(int32_t(_nowUs - _txEndUs) >= int32_t(_turnaroundUs)) finish(OK, Modbus::NO_EXCEPTION);
+                break;
+            default:
+                break;
+        }
+        if(_state == IDLE) {
+            if(!_prepared) prepare();
+            if(_prepared && elapsed(_txEndUs) >= _t35Us && elapsed(_lastRxUs) >= _t35Us) transmit();
+        }
+    }
+
+private:
+    enum State {
+        IDLE,
+        WAITING,            // Waiting for the response
+        TURNAROUND          // Broadcast sent, waiting for the turnaround delay
+    };
+
+    struct Poll {
+        uint8_t             slave;
+        Modbus::Function    function;
+        uint16_t            address;
+        uint16_t            count;
+        uint16_t            offset;             // Index into the image
+        uint32_t            intervalUs;
+        uint32_t            nextDueUs;
+        PollStatus          status;
+    };
+
+    struct Request {
+        uint8_t     frame[9 + 2 * MAX_WRITE_VALUES];
+        uint8_t     length;
+        int8_t      poll;                       // -1 for writes
+        uint16_t    address;
+        size_t      expectedLength;             // Length of a regular response
+    };
+
+    Port& _port;
+    uint32_t _charTimeUs = 0;
+    uint32_t _t15Us = 750;
+    uint32_t _t35Us = 1750;
+    uint32_t _timeoutUs = DEFAULT_TIMEOUT_US;
+    uint32_t _turnaroundUs = DEFAULT_TURNAROUND_US;
+    bool _strictTiming = false;
+    WriteCallback _writeCallback;
+
+    Poll _polls[MAX_POLLS];
+    uint8_t _pollCount = 0;
+    uint16_t _image[IMAGE_SIZE] = {};
+    uint16_t _imageUsed = 0;
+
+    Request _writes[WRITE_QUEUE_SIZE];
+    uint8_t _writeHead = 0;
+    uint8_t _writeCount = 0;
+
+    State _state = IDLE;
+    Request _current = {};
+    Request _next = {};
+    bool _prepared = false;
+    bool _started = false;
+    uint32_t _nowUs = 0;
+    uint32_t _txEndUs = 0;                      // Estimated end of the last request on the line
+    uint32_t _lastRxUs = 0;                     // cycle() time bytes were last received
+    bool _gap = false;                          // Silence of more than T1.5 after the last received byte
+    bool _gapInFrame = false;
+
+    uint8_t _rx[Modbus::MAX_ADU_SIZE];
+    size_t _rxLength = 0;
+
+    Statistics _statistics = {};
+
+    uint32_t elapsed(uint32_t since) const { return int32_t(_nowUs - since) > 0 ? _nowUs - since : 0; }
+
+    bool queueWrite(uint8_t slave, Modbus::Function function, uint16_t address, const uint8_t* data, size_t length) {
+        if(_writeCount >= WRITE_QUEUE_SIZE || slave > Modbus::MAX_SLAVE) return false;
+        Request& request = _writes[(_writeHead + _writeCount) % WRITE_QUEUE_SIZE];
+        request.frame[0] = slave;
+        request.frame[1] = function;
+        memcpy(&request.frame[2], data, length);
+        request.length = Modbus::appendCrc(request.frame, 2 + length);
+        request.poll = -1;
+        request.address = address;
+        request.expectedLength = slave == Modbus::BROADCAST ? 0 : 8;
+        _writeCount++;
+        return true;
+    }
+
+    /**
+     * @brief Select the next request: queued writes first, then the poll which is overdue the longest.
+     */
+    void prepare() {
+        if(_writeCount > 0) {
+            _next = _writes[_writeHead];
+            _writeHead = (_writeHead + 1) % WRITE_QUEUE_SIZE;
+            _writeCount--;
+            _prepared = true;
+            return;
+        }
+        int8_t selected = -1;
+        int32_t mostOverdue = 0;
+        for(uint8_t i=0; i<_pollCount; i++) {
+            int32_t overdue = int32_t(_nowUs - _polls[i].nextDueUs);
+            if(overdue >= mostOverdue) {
+                mostOverdue = overdue;
+                selected = i;
+            }
+        }
+        if(selected < 0) return;
+        Poll& poll = _polls[selected];
+        _next.frame[0] = poll.slave;
+        _next.frame[1] = poll.function;
+        Modbus::put16(&_next.frame[2], poll.address);
+        Modbus::put16(&_next.frame[4], poll.count);
+        _next.length = Modbus::appendCrc(_next.frame, 6);
+        _next.poll = selected;
+        _next.address = poll.address;
+        bool bits = poll.function == Modbus::READ_COILS || poll.function == Modbus::READ_DISCRETE_INPUTS;
+        _next.expectedLength = 5 + (bits ? (poll.count + 7) / 8 : 2 * poll.count);
+        _prepared = true;
+    }
+
+    void transmit() {
+        //A poll which became invalid while prepared (clearPolls()) is dropped
+        if(_next.poll >= _pollCount) {
+            _prepared = false;
+            return;
+        }
+        size_t written = _port.write(_next.frame, _next.length);
+        if(written == 0) return;                // Transmit buffer full, try again in the next cycle
+        _current = _next;
+        _prepared = false;
+        if(written < _current.length) {
+            //A partially written frame cannot be continued after a gap, let it time out at the slave
+            _statistics.frameErrors++;
+        }
+        _statistics.requests++;
+        _txEndUs = _nowUs + _current.length * _charTimeUs;
+        _rxLength = 0;
+        _gap = false;
+        _gapInFrame = false;
+        if(_current.poll >= 0) {
+            Poll& poll = _polls[_current.poll];
+            if(poll.intervalUs > 0 && int32_t(_nowUs - poll.nextDueUs) > int32_t(poll.intervalUs)) _statistics.lateRequests++;
+            poll.nextDueUs += poll.intervalUs;
+            if(int32_t(_nowUs - poll.nextDueUs) > 0) poll.nextDueUs = _nowUs;     // Do not catch up with a burst
+        }
+        _state = _current.expectedLength == 0 ? TURNAROUND : WAITING;
+        prepare();
+    }
+
+    /**
+     * @brief Read the received bytes and keep track of the silence between them.
+     */
+    void receive() {
+        size_t length;
+        if(_state == WAITING) {
+            length = _port.read(&_rx[_rxLength], sizeof(_rx) - _rxLength);
+            if(length == 0) {
+                if(_rxLength > 0 && elapsed(_lastRxUs) > _t15Us) _gap = true;
+                return;
+            }
+            if(_gap) _gapInFrame = true;
+            _rxLength += length;
+        } else {
+            uint8_t discard[32];
+            length = _port.read(discard, sizeof(discard));
+            if(length == 0) return;
+            _statistics.unexpectedBytes += length;
+            while((length = _port.read(discard, sizeof(discard))) > 0) _statistics.unexpectedBytes += length;
+        }
+        _lastRxUs = _nowUs;
+    }
+
+    void checkResponse() {
+        //The length follows from the first bytes, the expected length of the request is used until they arrived
+        size_t expected = Modbus::frameLength(_rx, _rxLength, false);
+        if(expected == 0 || expected > sizeof(_rx)) expected = _current.expectedLength;
+        if(_rxLength >= expected) {
+            evaluate(expected);
+        } else if(_rxLength == 0) {
+            if(elapsed(_txEndUs) > _timeoutUs) {
+                _statistics.timeouts++;
+                finish(TIMEOUT, Modbus::NO_EXCEPTION);
+            }
+        } else if(elapsed(_lastRxUs) > (_strictTiming ? _t35Us : _timeoutUs)) {
+            //Incomplete response
+            _statistics.frameErrors++;
+            finish(FRAME_ERROR, Modbus::NO_EXCEPTION);
+        }
+    }
+
+    /**
+     * @brief Check a complete response and copy the data into the image.
+     */
+    void evaluate(size_t length) {
+        if(!Modbus::checkCrc(_rx, length)) {
+            _statistics.crcErrors++;
+            finish(CRC_ERROR, Modbus::NO_EXCEPTION);
+            return;
+        }
+        bool valid = _rx[0] == _current.frame[0] && (_rx[1] & ~Modbus::EXCEPTION_FLAG) == _current.frame[1] && length == _rxLength
+                     && !(_strictTiming && _gapInFrame);
+        if(!valid) {
+            _statistics.frameErrors++;
+            finish(FRAME_ERROR, Modbus::NO_EXCEPTION);
+            return;
+        }
+        if(_rx[1] & Modbus::EXCEPTION_FLAG) {
+            _statistics.exceptions++;
+            finish(EXCEPTION, Modbus::Exception(_rx[2]));
+            return;
+        }
+        if(_current.poll < 0) {
+            //Writes echo address and value or count
+            valid = memcmp(&_rx[2], &_current.frame[2], 4) == 0;
+        } else if(_current.poll < _pollCount) {
+            Poll& poll = _polls[_current.poll];
+            valid = _rx[2] == length - 5;
+            if(valid) store(poll, &_rx[3]);
+        }
+        if(!valid) {
+            _statistics.frameErrors++;
+            finish(FRAME_ERROR, Modbus::NO_EXCEPTION);
+            return;
+        }
+        _statistics.responses++;
+        finish(OK, Modbus::NO_EXCEPTION);
+    }
+
+    void store(const Poll& poll, const uint8_t* data) {
+        uint16_t* image = &_image[poll.offset];
+        if(poll.function == Modbus::READ_COILS || poll.function == Modbus::READ_DISCRETE_INPUTS) {
+            for(uint16_t i=0; i<(poll.count + 15) / 16; i++) {
+                uint8_t high = 2 * i + 1 < (poll.count + 7) / 8 ? data[2 * i + 1] : 0;
+                image[i] = uint16_t(high) << 8 | data[2 * i];
+            }
+            if(poll.count % 16) image[poll.count / 16] &= (1 << (poll.count % 16)) - 1;
+        } else {
+            for(uint16_t i=0; i<poll.count; i++) image[i] = Modbus::get16(&data[2 * i]);
+        }
+    }
+
+    void finish(Result result, Modbus::Exception exception) {
+        if(_current.poll >= 0 && _current.poll < _pollCount) {
+            PollStatus& status = _polls[_current.poll].status;
+            status.lastResult = result;
+            switch(result) {
+                case OK:
+                    status.responses++;
+                    status.lastUpdateUs = _nowUs;
+                    status.valid = true;
+                    break;
+                case TIMEOUT:
+                    status.timeouts++;
+                    break;
+                case EXCEPTION:
+                    status.exceptions++;
+                    status.lastException = exception;
+                    break;
+                default:
+                    status.errors++;
+                    break;
+            }
+        } else if(_current.poll < 0 && _writeCallback) {
+            _writeCallback(_current.frame[0], _current.address, result, exception);
+        }
+        _state = IDLE;
+        _rxLength = 0;
+    }
+};
+
+#endif // MODBUS_RTU_MASTER_H
@@ -0,0 +1,104 @@
+#ifndef MODBUS_RTU_SLAVE_H
+#define MODBUS_RTU_SLAVE_H
+
+#include <Arduino.h>
+#include "Interface.h"
+#include "AnalogOutput.h"
+#include "UARTInterface.h"
+#include "Modbus.h"
+#include "Debug.h"
+
+/**
+ * @file ModbusRTUSlave.h
+ * @brief Declaration of the ModbusRTUSlave class.
+ * @details Defines a Modbus RTU slave which exposes the interfaces of the attached modules as process image:
+ *          - Coils (read/write): digital outputs and relais.
+ *          - Discrete inputs (read): digital inputs.
+ *          - Input registers (read): analog inputs.
+ *          - Holding registers (read/write): analog outputs.
+ *          Addresses start at 0 in each table, in the order the interfaces were added. The tables hold the interfaces by address,
+ *          so a request is served by indexing them without searching.
+ *
+ *          The end of a request is detected from its length, or from a valid CRC for unknown function codes, the response is
+ *          written as soon as the last byte was received. If the UART core supports a receive callback (ESP32_UART), requests are
+ *          served in its receive task independent of the module cycle. Otherwise process() must be called cyclically. A silence of
+ *          more than T3.5 before received bytes discards an incomplete frame. The UART hands over the last bytes after its RX
+ *          timeout, so it should be configured to a short timeout, see UARTCore::setFifoConfig().
+ *          Values written to holding registers above the resolution of the analog output are rejected with ILLEGAL_DATA_VALUE.
+ */
+class ModbusRTUSlave {
+public:
+    enum Table : uint8_t {
+        COILS = 0,
+        DISCRETE_INPUTS = 1,
+        INPUT_REGISTERS = 2,
+        HOLDING_REGISTERS = 3,
+        TABLE_COUNT = 4
+    };
+
+    static constexpr uint16_t MAX_POINTS = 64;          // Per table
+
+    struct Statistics {
+        uint32_t requests;              // Valid requests addressed to this slave, including broadcasts
+        uint32_t responses;
+        uint32_t broadcasts;
+        uint32_t exceptions;
+        uint32_t crcErrors;
+        uint32_t otherSlaves;           // Valid requests addressed to other slaves
+        uint32_t maxResponseUs;         // Longest time from reading the last byte of a request to writing the response, without the UART FIFO delay
+    };
+
+    /**
+     * @brief Construct a new ModbusRTUSlave.
+     * @param slaveId Slave address (1..247).
+     */
+    explicit ModbusRTUSlave(uint8_t slaveId = 1) : _slaveId(slaveId) {}
+
+    bool addInterface(Interface* interface);
+    bool populate();
+    void clear();
+
+    bool begin(UARTInterface* uart, uint32_t baudrate);
+    void end();
+    void process();
+    void process(uint32_t nowUs);
+
+    bool isRunning() const { return _uart != nullptr; }
+    bool isEventDriven() const { return _eventDriven; }
+    void setSlaveId(uint8_t slaveId) { _slaveId = slaveId; }
+    uint8_t getSlaveId() const { return _slaveId; }
+    uint16_t getPointCount(Table table) const { return table < TABLE_COUNT ? _counts[table] : 0; }
+    Interface* getPoint(Table table, uint16_t address) const { return table < TABLE_COUNT && address < _counts[table] ? _points[table][address] : nullptr; }
+    const Statistics& getStatistics() const { return _statistics; }
+    void resetStatistics() { _statistics = {}; }
+
+private:
+    UARTInterface* _uart = nullptr;
+    UARTCore* _callbackCore = nullptr;     // Core the receive callback is registered at
+    uint8_t _slaveId;
+    bool _eventDriven = false;
+    uint32_t _t35Us = 1750;
+
+    Interface* _points[TABLE_COUNT][MAX_POINTS] = {};
+    uint16_t _counts[TABLE_COUNT] = {};
+
+    uint8_t _rx[Modbus::MAX_ADU_SIZE];
+    size_t _rxLength = 0;
+    bool _skip = false;                 // Discard bytes until the next silence
+    bool _silent = true;                // Silence of more than T3.5 observed
+    uint32_t _lastRxUs = 0;
+    uint8_t _otherSlave = Modbus::BROADCAST;       // Slave addressed by the last request, its response follows
+    uint8_t _responseFrom = Modbus::BROADCAST;     // Slave whose response may be received in the current frame
+    Statistics _statistics = {};
+
+    void receive(uint32_t nowUs);
+    void handleFrame(size_t length, uint32_t receivedUs);
+    size_t execute(const uint8_t* request, uint8_t* response);
+    size_t readBits(Table table, uint16_t address, uint16_t count, uint8_t* response);
+    size_t readRegisters(Table table, uint16_t address, uint16_t count, uint8_t* response);
+    size_t exception(uint8_t* response, Modbus::Exception code);
+    size_t crcEnd(size_t from) const;
+    uint16_t maxRegister(uint16_t address) const;
+};
+
+#endif // MODBUS_RTU_SLAVE_H
@@ -0,0 +1,117 @@
+#ifndef OBJECT_DICTIONARY_H
+#define OBJECT_DICTIONARY_H
+
+#include <Arduino.h>
+#include <functional>
+#include "Interface.h"
+#include "Debug.h"
+
+/**
+ * @file ObjectDictionary.h
+ * @brief Declaration of the ObjectDictionary class.
+ * @details Defines a CANopen-style object dictionary addressed by a 16-bit index and an 8-bit sub-index.
+ *          The dictionary is filled once during startup (e.g. from the interfaces of all attached modules),
+ *          then sealed into a sorted table which is searched with a binary search.
+ *
+ *          Default index layout used by populate():
+ *          - 0x2000 + slot: interfaces of the module in the slot. Sub-index 0 holds the interface count, sub-index n the Q value of interface n-1.
+ *          - 0x2100 + slot: module configuration items, added by CANTramModule::addObjects().
+ *          - 0x2200 + slot: module identification (1 = HW type, 2 = HW version, 3 = FW version).
+ */
+class ObjectDictionary {
+public:
+
+    enum DataType : uint8_t {
+        UNSIGNED8,
+        UNSIGNED16,
+        UNSIGNED32,
+        VISIBLE_STRING,
+        OCTET_STRING
+    };
+
+    enum Access : uint8_t {
+        ACCESS_RO,
+        ACCESS_WO,
+        ACCESS_RW
+    };
+
+    /**
+     * @brief SDO abort codes as defined by CiA 301.
+     */
+    enum AbortCode : uint32_t {
+        ABORT_OK                = 0x00000000,
+        ABORT_TOGGLE_BIT        = 0x05030000,
+        ABORT_TIMEOUT           = 0x05040000,
+        ABORT_INVALID_COMMAND   = 0x05040001,
+        ABORT_OUT_OF_MEMORY     = 0x05040005,
+        ABORT_WRITE_ONLY        = 0x06010001,
+        ABORT_READ_ONLY         = 0x06010002,
+        ABORT_NO_OBJECT         = 0x06020000,
+        ABORT_LENGTH_MISMATCH   = 0x06070010,
+        ABORT_NO_SUBINDEX       = 0x06090011,
+        ABORT_VALUE_RANGE       = 0x06090030,
+        ABORT_GENERAL_ERROR     = 0x08000000
+    };
+
+    using ReadCallback = std::function<size_t(uint8_t* buffer, size_t capacity)>;
+    using WriteCallback = std::function<bool(const uint8_t* data, size_t length)>;
+
+    /**
+     * @brief Single object of the dictionary.
+     * @details Either references an Interface (Q value is read/written) or a pair of callbacks.
+     */
+    struct Entry {
+        uint32_t        key;        // (index << 8) | subIndex, used as sort key
+        DataType        type;
+        Access          access;
+        Interface*      interface;  // nullptr for callback entries
+        ReadCallback    read;
+        WriteCallback   write;
+
+        uint16_t getIndex() const { return key >> 8; }
+        uint8_t getSubIndex() const { return key & 0xFF; }
+    };
+
+    static constexpr uint16_t INDEX_MODULE_INTERFACES = 0x2000;
+    static constexpr uint16_t INDEX_MODULE_CONFIG = 0x2100;
+    static constexpr uint16_t INDEX_MODULE_IDENTITY = 0x2200;
+
+    /**
+     * @brief Construct an object dictionary on caller-provided storage.
+     * @param storage Array used to store the entries. Must outlive the dictionary.
+     * @param capacity Number of entries in storage.
+     */
+    ObjectDictionary(Entry* storage, size_t capacity) : _entries(storage), _capacity(capacity) {}
+
+    bool addInterface(uint16_t index, uint8_t subIndex, Interface* interface);
+    bool addEntry(uint16_t index, uint8_t subIndex, DataType type, Access access, ReadCallback read, WriteCallback write = nullptr);
+    bool addU8(uint16_t index, uint8_t subIndex, Access access, std::function<uint8_t()> get, std::function<bool(uint8_t)> set = nullptr);
+    bool addU32(uint16_t index, uint8_t subIndex, Access access, std::function<uint32_t()> get, std::function<bool(uint32_t)> set = nullptr);
+
+    bool populate();
+    bool seal();
+    void clear();
+
+    const Entry* find(uint16_t index, uint8_t subIndex) const;
+    bool hasIndex(uint16_t index) const;
+
+    AbortCode read(const Entry* entry, uint8_t* buffer, size_t capacity, size_t& length) const;
+    AbortCode write(const Entry* entry, const uint8_t* data, size_t length) const;
+
+    static size_t getTypeSize(DataType type);
+
+    size_t size() const { return _count; }
+    size_t getCapacity() const { return _capacity; }
+    bool isSealed() const { return _sealed; }
+
+private:
+    Entry*  _entries;
+    size_t  _capacity;
+    size_t  _count = 0;
+    bool    _sealed = false;
+
+    Entry* reserve(uint16_t index, uint8_t subIndex);
+    size_t lowerBound(uint32_t key) const;
+};
+
+#endif // OBJECT_DICTIONARY_H
@@ -34,6 +34,7 @@ class RelaisModuleV1_0 : public CANTramModule{
     bool initialize() override;
 
     void cycle(uint8_t* response) override;
+    bool writeOutputs() override;
 
     Interface** getInterfaces() override;
     size_t getInterfaceCount() override { return INTERFACE_COUNT; }
@@ -0,0 +1,113 @@
+#ifndef REMOTEIO_H
+#define REMOTEIO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * @file RemoteIO.h
+ * @brief Process data protocol between RemoteIOServer and RemoteModule.
+ * @details A node running a RemoteIOServer publishes the values of its local interfaces, a RemoteModule on another node mirrors them
+ *          as local interfaces. The points of a node are split into four groups (digital/analog inputs/outputs) which are
+ *          transferred in blocks, one block per CAN frame.
+ *
+ *          Frames (standard identifiers, node ID of the server):
+ *          - COB_ID_INPUTS + node, server to proxy: input blocks, layout response and output acknowledges.
+ *          - COB_ID_OUTPUTS + node, proxy to server: output blocks and layout request.
+ *
+ *          Frame layout:
+ *          - Block: byte 0 = group << 6 | block number, byte 1 = sequence counter of the sender, followed by the values of the block.
+ *            Digital blocks carry up to 48 points as bits (point n in bit n % 8 of byte n / 8), analog blocks 3 values with 16 bit each.
+ *          - Layout: byte 0 = CMD_LAYOUT, byte 1 = 0, bytes 2-5 = number of points per group. The request carries byte 0 only.
+ *          - Acknowledge: byte 0 = CMD_ACK, byte 1 = sequence counter of the acknowledged output block.
+ */
+namespace RemoteIO {
+
+static constexpr uint16_t COB_ID_INPUTS = 0x180;
+static constexpr uint16_t COB_ID_OUTPUTS = 0x200;
+static constexpr uint8_t CMD_LAYOUT = 0xFE;
+static constexpr uint8_t CMD_ACK = 0xFF;
+
+enum Group : uint8_t {
+    DIGITAL_INPUTS = 0,
+    ANALOG_INPUTS = 1,
+    DIGITAL_OUTPUTS = 2,
+    ANALOG_OUTPUTS = 3,
+    GROUP_COUNT = 4
+};
+
+static constexpr uint8_t DIGITAL_POINTS_PER_BLOCK = 48;
+static constexpr uint8_t ANALOG_POINTS_PER_BLOCK = 3;
+static constexpr uint8_t MAX_DIGITAL_POINTS = 48;
+static constexpr uint8_t MAX_ANALOG_POINTS = 12;
+static constexpr uint8_t MAX_POINTS = MAX_DIGITAL_POINTS;   // Maximum of both
+
+inline bool isDigital(uint8_t group) { return group == DIGITAL_INPUTS || group == DIGITAL_OUTPUTS; }
+inline bool isInput(uint8_t group) { return group == DIGITAL_INPUTS || group == ANALOG_INPUTS; }
+inline uint8_t getPointsPerBlock(uint8_t group) { return isDigital(group) ? DIGITAL_POINTS_PER_BLOCK : ANALOG_POINTS_PER_BLOCK; }
+inline uint8_t getMaxPoints(uint8_t group) { return isDigital(group) ? MAX_DIGITAL_POINTS : MAX_ANALOG_POINTS; }
+inline uint8_t getBlockCount(uint8_t group, uint8_t count) { return (count + getPointsPerBlock(group) - 1) / getPointsPerBlock(group); }
+
+/**
+ * @brief Check if a frame is a value block (and not a command).
+ */
+inline bool isBlock(const uint8_t* data, uint8_t length) {
+    return length >= 2 && data[0] != CMD_LAYOUT && data[0] != CMD_ACK;
+}
+
+/**
+ * @brief Encode one block of a group.
+ * @param data Destination of 8 bytes.
+ * @param group Group of the values.
+ * @param block Block number.
+ * @param sequence Sequence counter of the sender.
+ * @param values All values of the group, digital points are true if not 0.
+ * @param count Number of points in the group.
+ * @return uint8_t Frame length, 0 if the block does not exist.
+ */
+inline uint8_t encodeBlock(uint8_t* data, uint8_t group, uint8_t block, uint8_t sequence, const uint16_t* values, uint8_t count) {
+    uint8_t first = block * getPointsPerBlock(group);
+    if(first >= count) return 0;
+    uint8_t points = count - first < getPointsPerBlock(group) ? count - first : getPointsPerBlock(group);
+    data[0] = (group << 6) | block;
+    data[1] = sequence;
+    if(isDigital(group)) {
+        memset(&data[2], 0, 6);
+        for(uint8_t i=0; i<points; i++) {
+            if(values[first + i]) data[2 + i / 8] |= 1 << (i % 8);
+        }
+        return 2 + (points + 7) / 8;
+    }
+    for(uint8_t i=0; i<points; i++) {
+        data[2 + 2 * i] = values[first + i] & 0xFF;
+        data[3 + 2 * i] = values[first + i] >> 8;
+    }
+    return 2 + 2 * points;
+}
+
+/**
+ * @brief Decode a block into the value array of its group.
+ * @param data Received frame data, a block as checked by isBlock().
+ * @param length Frame length.
+ * @param values All values of the group, updated for the points of the block.
+ * @param count Number of points in the group.
+ * @return int Number of decoded points, -1 if the block does not match count.
+ */
+inline int decodeBlock(const uint8_t* data, uint8_t length, uint16_t* values, uint8_t count) {
+    uint8_t group = data[0] >> 6;
+    uint8_t first = (data[0] & 0x3F) * getPointsPerBlock(group);
+    if(first >= count) return -1;
+    uint8_t points = count - first < getPointsPerBlock(group) ? count - first : getPointsPerBlock(group);
+    uint8_t expected = isDigital(group) ? 2 + (points + 7) / 8 : 2 + 2 * points;
+    if(length != expected) return -1;
+    for(uint8_t i=0; i<points; i++) {
+        if(isDigital(group)) values[first + i] = (data[2 + i / 8] >> (i % 8)) & 0x01;
+        else values[first + i] = data[2 + 2 * i] | (data[3 + 2 * i] << 8);
+    }
+    return points;
+}
+
+} // namespace RemoteIO
+
+#endif // REMOTEIO_H
@@ -0,0 +1,76 @@
+#ifndef REMOTEIOSERVER_H
+#define REMOTEIOSERVER_H
+
+#include <Arduino.h>
+#include "CANCore.h"
+#include "CANInterface.h"
+#include "Interface.h"
+#include "RemoteIO.h"
+#include "Debug.h"
+
+/**
+ * @file RemoteIOServer.h
+ * @brief Declaration of the RemoteIOServer class.
+ * @details Defines the node side of the remote I/O protocol (see RemoteIO.h). The server publishes the values of its input
+ *          interfaces and applies output values received from a RemoteModule on another node.
+ *          Input blocks are sent when a value changed (at most once per inhibit time) and all blocks are repeated every refresh interval,
+ *          so the proxy can detect stale values. If no output block arrives within the output timeout, all outputs are set to 0.
+ */
+class RemoteIOServer : public CANListener {
+public:
+    struct Statistics {
+        uint32_t framesSent;
+        uint32_t framesReceived;
+        uint32_t outputTimeouts;
+    };
+
+    /**
+     * @brief Construct a new RemoteIOServer.
+     * @param nodeId Node ID (1..127) which selects the COB-IDs, must match the RemoteModule of the peer.
+     */
+    explicit RemoteIOServer(uint8_t nodeId = 1) : _nodeId(nodeId) {}
+
+    bool addInterface(Interface* interface);
+    bool populate();
+    void clear();
+
+    bool begin(CANInterface* canInterface);
+    void end();
+
+    bool onMessage(const CANCore::CANMessage& message) override;
+    void cycle() override;
+
+    void setRefreshInterval(uint32_t ms) { _refreshIntervalMs = ms; }
+    void setInhibitTime(uint32_t ms) { _inhibitTimeMs = ms; }
+    void setOutputTimeout(uint32_t ms) { _outputTimeoutMs = ms; }
+
+    uint8_t getNodeId() const { return _nodeId; }
+    uint8_t getPointCount(RemoteIO::Group group) const { return group < RemoteIO::GROUP_COUNT ? _counts[group] : 0; }
+    const Statistics& getStatistics() const { return _statistics; }
+
+private:
+    CANInterface* _canInterface = nullptr;
+    uint8_t _nodeId;
+    uint32_t _refreshIntervalMs = 100;
+    uint32_t _inhibitTimeMs = 0;
+    uint32_t _outputTimeoutMs = 500;
+
+    Interface* _points[RemoteIO::GROUP_COUNT][RemoteIO::MAX_POINTS] = {};
+    uint8_t _counts[RemoteIO::GROUP_COUNT] = {};
+    uint16_t _sentInputs[2][RemoteIO::MAX_POINTS] = {};     // Last published values of both input groups
+
+    uint8_t _sequence = 0;
+    uint32_t _lastRefresh = 0;
+    uint32_t _lastPublish = 0;
+    uint32_t _lastOutputs = 0;
+    bool _outputsActive = false;
+    Statistics _statistics = {};
+
+    void publishInputs(bool all);
+    void applyOutputs(const uint8_t* data, uint8_t length);
+    void resetOutputs();
+    void sendLayout();
+    void send(const uint8_t* data, uint8_t length);
+};
+
+#endif // REMOTEIOSERVER_H
@@ -0,0 +1,150 @@
+#ifndef REMOTEMODULE_H
+#define REMOTEMODULE_H
+
+#include <Arduino.h>
+#include "CANTramModule.h"
+#include "CANCore.h"
+#include "CANInterface.h"
+#include "Interface.h"
+#include "DigitalInput.h"
+#include "DigitalOutput.h"
+#include "AnalogInput.h"
+#include "AnalogOutput.h"
+#include "RemoteIO.h"
+#include "Debug.h"
+
+/**
+ * @file RemoteModule.h
+ * @brief Declaration of the RemoteModule class.
+ * @details Defines a CANTramModule which mirrors the interfaces of another node running a RemoteIOServer (see RemoteIO.h).
+ *          The module is attached to CANTramCore like a hardware module, so the remote inputs and outputs appear in the local interface list:
+ *          - Inputs are updated from the blocks published by the server. If no block arrives within the stale timeout,
+ *            all inputs are invalidated until the next update.
+ *          - Outputs are compared with the last sent values in cycle(). Blocks with a change are sent together (at most once per inhibit time)
+ *            and all blocks are repeated every refresh interval. Every block is acknowledged by the server, the time until the
+ *            acknowledge is tracked as output latency.
+ *          The point counts given to the constructor must match the server, they are checked against the layout reported by the server
+ *          before the first output is sent.
+ */
+class RemoteModule : public CANTramModule, public CANListener {
+public:
+    //Module information
+    static const String HW_TYPE;
+    String getHWType() const override { return HW_TYPE; }
+    static const String HW_VERSION;
+    String getHWVersion() const override { return HW_VERSION; }
+    static const String FW_VERSION;
+    String getFWVersion() const override { return FW_VERSION; }
+    static constexpr uint8_t GPIO_DEMAND = 0;
+    uint8_t getGPIODemand() const override { return GPIO_DEMAND; }
+    static constexpr uint8_t GPIO_SUPPLY = 0;
+    uint8_t getGPIOSupply() const override { return GPIO_SUPPLY; }
+
+    struct Statistics {
+        uint32_t    framesSent;
+        uint32_t    framesReceived;
+        uint32_t    lostFrames;             // Gaps in the sequence counter of the server
+        uint32_t    acknowledged;           // Acknowledged output blocks
+        uint32_t    minOutputLatencyUs;     // Output block sent until acknowledge received
+        uint32_t    maxOutputLatencyUs;
+        uint64_t    totalOutputLatencyUs;
+        uint32_t    maxInputIntervalMs;     // Longest time between two input blocks
+        uint32_t    staleCount;             // Number of times the inputs went stale
+    };
+
+    /**
+     * @brief Construct a RemoteModule.
+     * @param nodeId Node ID of the RemoteIOServer (1..127).
+     * @param digitalInputs Number of digital inputs of the server.
+     * @param analogInputs Number of analog inputs of the server.
+     * @param digitalOutputs Number of digital outputs (including relais) of the server.
+     * @param analogOutputs Number of analog outputs of the server.
+     */
+    RemoteModule(uint8_t nodeId, uint8_t digitalInputs, uint8_t analogInputs, uint8_t digitalOutputs, uint8_t analogOutputs);
+
+    bool provideGPIOs() override { return true; }
+    bool requestGPIOs() override { return true; }
+    bool provideHardwareResources() override { return true; }
+    bool requestHardwareResources() override { return true; }
+    bool addInterfaces() override;
+    bool initialize() override { return true; }
+
+    bool begin(CANInterface* canInterface);
+    void end();
+
+    /**
+     * @brief Send changed outputs, called by CANTramCore::loop().
+     */
+    void cycle(uint8_t* response) override;
+
+    bool onMessage(const CANCore::CANMessage& message) override;
+
+    /**
+     * @brief Supervise the input timeout, called by CANInterface::process().
+     */
+    void cycle() override;
+
+    void setRefreshInterval(uint32_t ms) { _refreshIntervalMs = ms; }
+    void setInhibitTime(uint32_t ms) { _inhibitTimeMs = ms; }
+    void setStaleTimeout(uint32_t ms) { _staleTimeoutMs = ms; }
+
+    uint8_t getNodeId() const { return _nodeId; }
+    bool isLayoutValid() const { return _layoutValid; }
+    bool isOnline() const { return _online; }
+
+    /**
+     * @brief Get the age of the newest input block.
+     * @return uint32_t Time since the last input block in milliseconds, UINT32_MAX if no block was received.
+     */
+    uint32_t getInputAge() const { return _inputReceived ? millis() - _lastInput : UINT32_MAX; }
+    uint32_t getAverageOutputLatency() const { return _statistics.acknowledged ? _statistics.totalOutputLatencyUs / _statistics.acknowledged : 0; }
+    const Statistics& getStatistics() const { return _statistics; }
+    void resetStatistics();
+
+    Interface** getInterfaces() override { return _interfaces; }
+    size_t getInterfaceCount() override { return _interfaceCount; }
+
+private:
+    static constexpr uint8_t ACK_SLOTS = 16;    // Outstanding output blocks with latency tracking
+    static constexpr size_t MAX_INTERFACES = 2 * RemoteIO::MAX_DIGITAL_POINTS + 2 * RemoteIO::MAX_ANALOG_POINTS;
+
+    CANInterface* _canInterface = nullptr;
+    const uint8_t _nodeId;
+    uint8_t _counts[RemoteIO::GROUP_COUNT];
+    uint32_t _refreshIntervalMs = 100;
+    uint32_t _inhibitTimeMs = 0;
+    uint32_t _staleTimeoutMs = 300;
+
+    DigitalInput _digitalInputs[RemoteIO::MAX_DIGITAL_POINTS];
+    AnalogInput _analogInputs[RemoteIO::MAX_ANALOG_POINTS];
+    DigitalOutput _digitalOutputs[RemoteIO::MAX_DIGITAL_POINTS];
+    AnalogOutput _analogOutputs[RemoteIO::MAX_ANALOG_POINTS];
+    Interface* _points[RemoteIO::GROUP_COUNT][RemoteIO::MAX_POINTS] = {};
+    Interface* _interfaces[MAX_INTERFACES] = {};
+    size_t _interfaceCount = 0;
+    uint16_t _values[RemoteIO::GROUP_COUNT][RemoteIO::MAX_POINTS] = {};     // Received inputs and last sent outputs
+
+    bool _layoutValid = false;
+    bool _layoutError = false;
+    bool _online = false;
+    bool _inputReceived = false;
+    bool _sequenceValid = false;
+    uint8_t _rxSequence = 0;
+    uint8_t _txSequence = 0;
+    uint32_t _lastInput = 0;
+    uint32_t _lastRefresh = 0;
+    uint32_t _lastSend = 0;
+    uint32_t _lastLayoutRequest = 0;
+    uint32_t _ackSentUs[ACK_SLOTS] = {};
+    bool _ackPending[ACK_SLOTS] = {};
+    Statistics _statistics = {};
+
+    void sendOutputs(bool all);
+    void handleInputs(const uint8_t* data, uint8_t length);
+    void handleLayout(const uint8_t* data);
+    void handleAck(uint8_t sequence);
+    void setOnline(bool online);
+    bool send(const uint8_t* data, uint8_t length);
+};
+
+#endif // REMOTEMODULE_H
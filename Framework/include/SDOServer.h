@@ -0,0 +1,72 @@
+#ifndef SDO_SERVER_H
+#define SDO_SERVER_H
+
+#include <Arduino.h>
+#include "CANCore.h"
+#include "CANInterface.h"
+#include "ObjectDictionary.h"
+#include "Debug.h"
+
+/**
+ * @file SDOServer.h
+ * @brief Declaration of the SDOServer class.
+ * @details Defines a CANopen SDO server (CiA 301) which gives access to an ObjectDictionary over a CANInterface.
+ *          Supports expedited transfers (up to 4 bytes) and segmented transfers (up to BUFFER_SIZE bytes) in both directions.
+ *          Requests are expected on COB-ID 0x600 + node ID, responses are sent on COB-ID 0x580 + node ID.
+ */
+class SDOServer : public CANListener {
+public:
+    static constexpr uint16_t COB_ID_REQUEST = 0x600;
+    static constexpr uint16_t COB_ID_RESPONSE = 0x580;
+    static constexpr size_t BUFFER_SIZE = 64;       // Maximum size of a segmented transfer
+    static constexpr uint32_t TIMEOUT_MS = 1000;    // Segmented transfers are aborted after this time without a request
+
+    /**
+     * @brief Construct a new SDOServer.
+     * @param od Object dictionary served by this server. Must be sealed before begin().
+     * @param nodeId CANopen node ID (1..127).
+     */
+    SDOServer(ObjectDictionary* od, uint8_t nodeId = 1) : _od(od), _nodeId(nodeId) {}
+
+    bool begin(CANInterface* canInterface);
+    void end();
+
+    bool onMessage(const CANCore::CANMessage& message) override;
+    void cycle() override;
+
+    bool setNodeId(uint8_t nodeId);
+    uint8_t getNodeId() const { return _nodeId; }
+
+private:
+    enum State {
+        IDLE,
+        UPLOAD_SEGMENTED,
+        DOWNLOAD_SEGMENTED
+    };
+
+    ObjectDictionary* _od;
+    CANInterface* _canInterface = nullptr;
+    uint8_t _nodeId;
+
+    //Segmented transfer state
+    State _state = IDLE;
+    const ObjectDictionary::Entry* _entry = nullptr;
+    uint16_t _index = 0;
+    uint8_t _subIndex = 0;
+    uint8_t _toggle = 0;
+    size_t _size = 0;           // Total size of the transfer, 0 if not indicated by the client
+    size_t _offset = 0;
+    uint32_t _lastActivity = 0;
+    uint8_t _buffer[BUFFER_SIZE];
+
+    void initiateDownload(const uint8_t* data);
+    void downloadSegment(const uint8_t* data);
+    void initiateUpload(const uint8_t* data);
+    void uploadSegment(const uint8_t* data);
+
+    const ObjectDictionary::Entry* lookup(uint16_t index, uint8_t subIndex);
+    void sendResponse(uint8_t command, const uint8_t* payload, uint8_t length);
+    void sendAbort(uint16_t index, uint8_t subIndex, uint32_t code);
+};
+
+#endif // SDO_SERVER_H
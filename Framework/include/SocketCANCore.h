@@ -0,0 +1,64 @@
+#ifndef SOCKETCANCORE_H
+#define SOCKETCANCORE_H
+
+#ifdef __linux__
+
+#include <Arduino.h>
+#include "CANCore.h"
+#include "SocketCANPort.h"
+#include "Debug.h"
+
+/**
+ * @file SocketCANCore.h
+ * @brief Declaration of the SocketCANCore class.
+ * @details Defines a CANCore implementation for Linux based on SocketCAN, so CANTram protocol code can run on a Linux host
+ *          with a real CAN adapter (can0) or a virtual bus (vcan0).
+ *          Received frames are fetched in batches of SocketCANPort::BATCH_SIZE and carry the kernel receive timestamp.
+ *          Sent frames are collected and handed to the kernel in one sendmmsg() call when available() is called
+ *          (i.e. once per CANInterface::process()), when the batch is full or when flush() is called.
+ *          Error frames of the kernel driver update status and statistics and are not delivered to the application.
+ *          The bitrate of a real adapter is configured by the system (ip link set can0 type can bitrate 500000),
+ *          setBaudrate() only stores the value.
+ *          On the host, add include/host to the include path for the Arduino API (String, Serial, micros(), millis()).
+ */
+class SocketCANCore : public CANCore {
+public:
+    explicit SocketCANCore(const char* interfaceName = "vcan0");
+    ~SocketCANCore() = default;
+
+    HardwareResource::Type getType() override { return HardwareResource::CAN; }
+    bool begin() override;
+    bool setBaudrate(Baudrate baudrate) override;
+    bool setPins(int8_t txPin, int8_t rxPin) override;
+    bool end() override;
+    bool sendMessage(const CANMessage& message) override;
+    bool readMessage(CANMessage& message) override;
+    bool readFrame(CANFrame& frame) override;
+    uint8_t available() override;
+    bool setupFilter(uint32_t id, uint32_t mask) override;
+
+    void setInterfaceName(const char* interfaceName);
+    const char* getInterfaceName() const { return _interfaceName; }
+    bool flush();
+
+private:
+    void fill();
+    void handleErrorFrame(const CANFrame& frame);
+
+    char _interfaceName[IFNAMSIZ] = {0};
+    SocketCANPort _port;
+
+    CANFrame _rxFrames[SocketCANPort::BATCH_SIZE];
+    size_t _rxCount = 0;
+    size_t _rxIndex = 0;
+
+    CANFrame _txFrames[SocketCANPort::BATCH_SIZE];
+    size_t _txCount = 0;
+
+    uint32_t _controllerOverruns = 0;   // Overflows reported by the controller via error frames
+    uint32_t _busOffSince = 0;          // millis() when the controller went bus-off, 0 if not bus-off
+};
+
+#endif // __linux__
+
+#endif // SOCKETCANCORE_H
@@ -0,0 +1,206 @@
+#ifndef SOCKETCAN_PORT_H
+#define SOCKETCAN_PORT_H
+
+#ifdef __linux__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <linux/can/error.h>
+#include "CANFrame.h"
+
+/**
+ * @file SocketCANPort.h
+ * @brief Declaration of the SocketCANPort class.
+ * @details Defines a thin wrapper around a Linux SocketCAN raw socket (e.g. can0 or vcan0). The socket is non-blocking,
+ *          frames are received and sent in batches with recvmmsg()/sendmmsg(), and received frames carry the kernel receive
+ *          timestamp converted to CLOCK_MONOTONIC microseconds. Frames the kernel dropped because the socket receive
+ *          queue was full are counted via SO_RXQ_OVFL.
+ *          The header is only available on Linux.
+ */
+class SocketCANPort {
+public:
+    static constexpr size_t BATCH_SIZE = 32;
+
+    SocketCANPort() = default;
+    ~SocketCANPort() { close(); }
+    SocketCANPort(const SocketCANPort&) = delete;
+    SocketCANPort& operator=(const SocketCANPort&) = delete;
+
+    /**
+     * @brief Open and bind a raw CAN socket.
+     * @param interfaceName Network interface, e.g. "vcan0".
+     * @param errorFrames True to receive error frames (bus-off, controller problems, restarts).
+     * @return true if the socket is ready.
+     */
+    bool open(const char* interfaceName, bool errorFrames = false) {
+        close();
+        _fd = ::socket(PF_CAN, SOCK_RAW, CAN_RAW);
+        if(_fd < 0) return false;
+
+        struct ifreq ifr = {};
+        strncpy(ifr.ifr_name, interfaceName, IFNAMSIZ - 1);
+        struct sockaddr_can address = {};
+        address.can_family = AF_CAN;
+        int enable = 1;
+        can_err_mask_t errorMask = CAN_ERR_BUSOFF | CAN_ERR_CRTL | CAN_ERR_RESTARTED | CAN_ERR_LOSTARB | CAN_ERR_BUSERROR;
+        if(::ioctl(_fd, SIOCGIFINDEX, &ifr) < 0
+           || (address.can_ifindex = ifr.ifr_ifindex, ::bind(_fd, (struct sockaddr*)&address, sizeof(address)) < 0)
+           || ::fcntl(_fd, F_SETFL, ::fcntl(_fd, F_GETFL) | O_NONBLOCK) < 0
+           || ::setsockopt(_fd, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) < 0
+           || ::setsockopt(_fd, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable)) < 0
+           || (errorFrames && ::setsockopt(_fd, SOL_CAN_RAW, CAN_RAW_ERR_FILTER, &errorMask, sizeof(errorMask)) < 0)) {
+            close();
+            return false;
+        }
+        for(size_t i=0; i<BATCH_SIZE; i++) {
+            _rxIov[i] = {&_rxFrames[i], sizeof(struct can_frame)};
+            _rxMsgs[i].msg_hdr = {};
+            _rxMsgs[i].msg_hdr.msg_iov = &_rxIov[i];
+            _rxMsgs[i].msg_hdr.msg_iovlen = 1;
+            _txIov[i] = {&_txFrames[i], sizeof(struct can_frame)};
+            _txMsgs[i].msg_hdr = {};
+            _txMsgs[i].msg_hdr.msg_iov = &_txIov[i];
+            _txMsgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        _dropped = 0;
+        return true;
+    }
+
+    void close() {
+        if(_fd >= 0) ::close(_fd);
+        _fd = -1;
+    }
+
+    bool isOpen() const { return _fd >= 0; }
+    int getFd() const { return _fd; }
+
+    /**
+     * @brief Set a single acceptance filter in the kernel (CAN_RAW_FILTER).
+     * @details A frame passes if (frameId & mask) == (id & mask). A mask of 0 accepts all frames.
+     * @param id Identifier to match.
+     * @param mask Identifier bits to compare.
+     * @param extended True to only accept 29-bit identifiers, false to only accept 11-bit identifiers. Ignored for a mask of 0.
+     * @return true if the filter was applied.
+     */
+    bool setFilter(uint32_t id, uint32_t mask, bool extended) {
+        if(_fd < 0) return false;
+        struct can_filter filter;
+        filter.can_id = (id & CAN_EFF_MASK) | (extended ? CAN_EFF_FLAG : 0);
+        filter.can_mask = mask == 0 ? 0 : ((mask & CAN_EFF_MASK) | CAN_EFF_FLAG);
+        return ::setsockopt(_fd, SOL_CAN_RAW, CAN_RAW_FILTER, &filter, sizeof(filter)) == 0;
+    }
+
+    /**
+     * @brief Receive up to max frames without blocking.
+     * @param frames Destination of the frames, timestamps are CLOCK_MONOTONIC microseconds.
+     * @param max Maximum number of frames, at most BATCH_SIZE are read per call.
+     * @return size_t Number of frames received.
+     */
+    size_t receive(CANFrame* frames, size_t max) {
+        if(_fd < 0 || max == 0) return 0;
+        if(max > BATCH_SIZE) max = BATCH_SIZE;
+        for(size_t i=0; i<max; i++) {
+            _rxMsgs[i].msg_hdr.msg_control = _rxControl[i];
+            _rxMsgs[i].msg_hdr.msg_controllen = sizeof(_rxControl[i]);
+            _rxMsgs[i].msg_hdr.msg_flags = 0;
+        }
+        int count = ::recvmmsg(_fd, _rxMsgs, max, MSG_DONTWAIT, nullptr);
+        if(count <= 0) return 0;
+
+        int64_t offsetUs = realtimeToMonotonicOffsetUs();
+        for(int i=0; i<count; i++) {
+            const struct can_frame& raw = _rxFrames[i];
+            uint32_t timestamp = monotonicUs();
+            for(struct cmsghdr* cmsg = CMSG_FIRSTHDR(&_rxMsgs[i].msg_hdr); cmsg; cmsg = CMSG_NXTHDR(&_rxMsgs[i].msg_hdr, cmsg)) {
+                if(cmsg->cmsg_level != SOL_SOCKET) continue;
+                if(cmsg->cmsg_type == SO_TIMESTAMPNS) {
+                    struct timespec ts;
+                    memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                    timestamp = uint32_t(int64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000 + offsetUs);
+                } else if(cmsg->cmsg_type == SO_RXQ_OVFL) {
+                    memcpy(&_dropped, CMSG_DATA(cmsg), sizeof(_dropped));
+                }
+            }
+            if(raw.can_id & CAN_ERR_FLAG) {
+                // Error class in the identifier, details in the data bytes, see linux/can/error.h
+                frames[i].set(raw.can_id & CAN_ERR_MASK, false, false, raw.data, raw.can_dlc, timestamp);
+                frames[i].idFlags |= CANFrame::FLAG_ERROR;
+                continue;
+            }
+            bool extended = raw.can_id & CAN_EFF_FLAG;
+            frames[i].set(raw.can_id & (extended ? CAN_EFF_MASK : CAN_SFF_MASK), extended, raw.can_id & CAN_RTR_FLAG,
+                          raw.data, raw.can_dlc, timestamp);
+        }
+        return count;
+    }
+
+    /**
+     * @brief Send up to count frames without blocking.
+     * @return size_t Number of frames accepted by the kernel. Fewer than count if the socket send queue is full.
+     */
+    size_t send(const CANFrame* frames, size_t count) {
+        if(_fd < 0) return 0;
+        size_t sent = 0;
+        while(sent < count) {
+            size_t batch = count - sent > BATCH_SIZE ? BATCH_SIZE : count - sent;
+            for(size_t i=0; i<batch; i++) {
+                const CANFrame& frame = frames[sent + i];
+                struct can_frame& raw = _txFrames[i];
+                raw = {};
+                raw.can_id = frame.getId() | (frame.isExtended() ? CAN_EFF_FLAG : 0) | (frame.isRemote() ? CAN_RTR_FLAG : 0);
+                raw.can_dlc = frame.getLength();
+                memcpy(raw.data, frame.data, 8);
+            }
+            int result = ::sendmmsg(_fd, _txMsgs, batch, MSG_DONTWAIT);
+            if(result <= 0) break;
+            sent += result;
+            if(size_t(result) < batch) break;
+        }
+        return sent;
+    }
+
+    /**
+     * @brief Number of frames the kernel dropped for this socket since open().
+     */
+    uint32_t getDropped() const { return _dropped; }
+
+    static uint32_t monotonicUs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return uint32_t(int64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000);
+    }
+
+private:
+    static int64_t realtimeToMonotonicOffsetUs() {
+        struct timespec realtime, monotonic;
+        clock_gettime(CLOCK_REALTIME, &realtime);
+        clock_gettime(CLOCK_MONOTONIC, &monotonic);
+        return (int64_t(monotonic.tv_sec) - realtime.tv_sec) * 1000000 + (monotonic.tv_nsec - realtime.tv_nsec) / 1000;
+    }
+
+    int _fd = -1;
+    uint32_t _dropped = 0;
+
+    struct can_frame _rxFrames[BATCH_SIZE];
+    struct iovec _rxIov[BATCH_SIZE];
+    struct mmsghdr _rxMsgs[BATCH_SIZE];
+    char _rxControl[BATCH_SIZE][CMSG_SPACE(sizeof(struct timespec)) + CMSG_SPACE(sizeof(uint32_t))];
+
+    struct can_frame _txFrames[BATCH_SIZE];
+    struct iovec _txIov[BATCH_SIZE];
+    struct mmsghdr _txMsgs[BATCH_SIZE];
+};
+
+#endif // __linux__
+
+#endif // SOCKETCAN_PORT_H
@@ -0,0 +1,247 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "COBS.h"
+#include "Modbus.h"
+
+/**
+ * @file Telemetry.h
+ * @brief Binary telemetry records on a serial link.
+ * @details Defines the record format used by TelemetryPublisher. Every record is followed by a CRC16 (Modbus polynomial, low byte
+ *          first, see Modbus::crc16()), COBS encoded and terminated by a zero byte, see COBS.h. A receiver resynchronizes at the
+ *          next delimiter and discards records with a wrong CRC.
+ *
+ *          Record layout (all values little endian), every record starts with a header of HEADER_SIZE bytes:
+ *          version (VERSION), record type, sequence number (16 bit, counts all records) and schema ID.
+ *          - Schema record: number of signals, index of the first signal in this record and number of signals in this record,
+ *            followed by one entry per signal: type, decimation (16 bit), name length and name without terminator.
+ *            The schema is split into records of up to SCHEMA_SIGNALS_PER_RECORD signals and repeated periodically, so a receiver
+ *            started later learns it. The schema ID changes whenever the signals change.
+ *          - Sample record: time in microseconds (32 bit), mask of the signals in this record (32 bit, bit i for signal i),
+ *            followed by the values of these signals in index order, 2 bytes for U16 and 4 bytes for the other types.
+ */
+namespace Telemetry {
+
+static constexpr uint8_t VERSION = 1;
+static constexpr uint8_t RECORD_SCHEMA = 1;
+static constexpr uint8_t RECORD_SAMPLE = 2;
+
+static constexpr uint8_t MAX_SIGNALS = 32;
+static constexpr size_t MAX_NAME_LENGTH = 15;
+static constexpr uint8_t SCHEMA_SIGNALS_PER_RECORD = 6;
+static constexpr size_t HEADER_SIZE = 5;
+static constexpr size_t SCHEMA_HEADER_SIZE = HEADER_SIZE + 3;
+static constexpr size_t SAMPLE_HEADER_SIZE = HEADER_SIZE + 8;
+static constexpr size_t MAX_RECORD_SIZE = SAMPLE_HEADER_SIZE + 4 * MAX_SIGNALS;
+static constexpr size_t CRC_SIZE = 2;
+static constexpr size_t MAX_PACKET_SIZE = COBS::maxEncodedSize(MAX_RECORD_SIZE + CRC_SIZE) + 1;   // Encoded record with delimiter
+
+enum Type : uint8_t {
+    U16 = 0,            // Interface values
+    U32 = 1,
+    I32 = 2,
+    F32 = 3
+};
+
+inline uint8_t typeSize(Type type) { return type == U16 ? 2 : 4; }
+
+struct Signal {
+    Type        type;
+    uint16_t    decimation;                 // Signal is sampled every decimation-th sample period
+    char        name[MAX_NAME_LENGTH + 1];
+};
+
+inline void put16(uint8_t* out, uint16_t value) {
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+inline void put32(uint8_t* out, uint32_t value) {
+    for(uint8_t i=0; i<4; i++) out[i] = (value >> (8 * i)) & 0xFF;
+}
+
+inline uint16_t get16(const uint8_t* in) { return in[0] | (uint16_t(in[1]) << 8); }
+inline uint32_t get32(const uint8_t* in) { return in[0] | (uint32_t(in[1]) << 8) | (uint32_t(in[2]) << 16) | (uint32_t(in[3]) << 24); }
+
+inline size_t encodeHeader(uint8_t type, uint16_t sequence, uint8_t schemaId, uint8_t* out) {
+    out[0] = VERSION;
+    out[1] = type;
+    put16(&out[2], sequence);
+    out[4] = schemaId;
+    return HEADER_SIZE;
+}
+
+/**
+ * @brief Encode a schema record with the signals first..first+count-1.
+ * @param out Destination, at least MAX_RECORD_SIZE bytes.
+ * @return size_t Record length.
+ */
+inline size_t encodeSchema(const Signal* signals, uint8_t signalCount, uint8_t first, uint8_t count, uint16_t sequence, uint8_t schemaId, uint8_t* out) {
+    size_t position = encodeHeader(RECORD_SCHEMA, sequence, schemaId, out);
+    out[position++] = signalCount;
+    out[position++] = first;
+    out[position++] = count;
+    for(uint8_t i=first; i<first + count; i++) {
+        size_t length = strlen(signals[i].name);
+        out[position++] = signals[i].type;
+        put16(&out[position], signals[i].decimation);
+        position += 2;
+        out[position++] = length;
+        memcpy(&out[position], signals[i].name, length);
+        position += length;
+    }
+    return position;
+}
+
+/**
+ * @brief Append the CRC to a record, COBS encode it and append the delimiter.
+ * @param record Record with room for CRC_SIZE more bytes.
+ * @param out Destination, at least MAX_PACKET_SIZE bytes.
+ * @return size_t Packet length.
+ */
+inline size_t encodePacket(uint8_t* record, size_t length, uint8_t* out) {
+    length = Modbus::appendCrc(record, length);
+    size_t size = COBS::encode(record, length, out);
+    out[size++] = COBS::DELIMITER;
+    return size;
+}
+
+/**
+ * @brief Decoded sample record.
+ */
+struct Sample {
+    uint16_t    sequence;
+    uint32_t    timeUs;
+    uint32_t    mask;                   // Signals present in the record
+    uint32_t    raw[MAX_SIGNALS];       // Raw value of each present signal, F32 as IEEE 754 bit pattern
+};
+
+/**
+ * @class Decoder
+ * @brief Splits a byte stream into packets, checks them and decodes schema and sample records.
+ */
+class Decoder {
+public:
+    enum Result {
+        NONE,               // Packet not complete yet
+        SCHEMA,             // Schema record decoded, see isSchemaComplete()
+        SAMPLE,             // Sample record decoded
+        UNKNOWN_SCHEMA,     // Sample of a schema not (completely) received yet, discarded
+        CRC_ERROR,
+        INVALID             // Oversized packet, unsupported version or malformed record
+    };
+
+    /**
+     * @brief Process one received byte.
+     * @param byte Received byte.
+     * @param sample Destination, valid if SAMPLE is returned.
+     * @return Result Decoding result.
+     */
+    Result push(uint8_t byte, Sample& sample) {
+        if(byte != COBS::DELIMITER) {
+            if(_fill < sizeof(_packet)) _packet[_fill] = byte;
+            if(_fill < sizeof(_packet) + 1) _fill++;
+            return NONE;
+        }
+        size_t fill = _fill;
+        _fill = 0;
+        if(fill == 0) return NONE;
+        if(fill > sizeof(_packet)) return INVALID;
+        size_t length = COBS::decode(_packet, fill, _packet);
+        if(length < HEADER_SIZE + CRC_SIZE) return INVALID;
+        if(!Modbus::checkCrc(_packet, length)) return CRC_ERROR;
+        length -= CRC_SIZE;
+        if(_packet[0] != VERSION) return INVALID;
+        uint16_t sequence = get16(&_packet[2]);
+        if(_records > 0) _lost += uint16_t(sequence - _sequence - 1);
+        _sequence = sequence;
+        _records++;
+        if(_packet[1] == RECORD_SCHEMA) return decodeSchema(_packet, length);
+        if(_packet[1] == RECORD_SAMPLE) return decodeSample(_packet, length, sample);
+        return INVALID;
+    }
+
+    bool isSchemaComplete() const { return _signalCount > 0 && _received == maskOf(_signalCount); }
+    uint8_t getSchemaId() const { return _schemaId; }
+    uint8_t getSignalCount() const { return _signalCount; }
+    const Signal& getSignal(uint8_t index) const { return _signals[index < MAX_SIGNALS ? index : 0]; }
+    uint32_t getLostRecords() const { return _lost; }       // Gaps in the sequence numbers
+
+    /**
+     * @brief Get a value of a sample as floating point number, according to the type of the signal.
+     */
+    double value(const Sample& sample, uint8_t index) const {
+        uint32_t raw = sample.raw[index];
+        switch(_signals[index].type) {
+            case I32: return int32_t(raw);
+            case F32: { float f; memcpy(&f, &raw, sizeof(f)); return f; }
+            default: return raw;
+        }
+    }
+
+private:
+    uint8_t _packet[MAX_PACKET_SIZE];
+    size_t _fill = 0;
+    Signal _signals[MAX_SIGNALS] = {};
+    uint8_t _signalCount = 0;
+    uint8_t _schemaId = 0;
+    uint32_t _received = 0;             // Signals of the current schema received
+    uint16_t _sequence = 0;
+    uint32_t _records = 0;
+    uint32_t _lost = 0;
+
+    static uint32_t maskOf(uint8_t count) { return count >= 32 ? 0xFFFFFFFFUL : (1UL << count) - 1; }
+
+    Result decodeSchema(const uint8_t* in, size_t length) {
+        if(length < SCHEMA_HEADER_SIZE) return INVALID;
+        uint8_t total = in[HEADER_SIZE];
+        uint8_t first = in[HEADER_SIZE + 1];
+        uint8_t count = in[HEADER_SIZE + 2];
+        if(total == 0 || total > MAX_SIGNALS || first + count > total) return INVALID;
+        if(in[4] != _schemaId || total != _signalCount) {
+            _schemaId = in[4];
+            _signalCount = total;
+            _received = 0;
+        }
+        size_t position = SCHEMA_HEADER_SIZE;
+        for(uint8_t i=first; i<first + count; i++) {
+            if(position + 4 > length) return INVALID;
+            Signal& signal = _signals[i];
+            signal.type = Type(in[position]);
+            signal.decimation = get16(&in[position + 1]);
+            size_t nameLength = in[position + 3];
+            position += 4;
+            if(signal.type > F32 || nameLength > MAX_NAME_LENGTH || position + nameLength > length) return INVALID;
+            memcpy(signal.name, &in[position], nameLength);
+            signal.name[nameLength] = '\0';
+            position += nameLength;
+            _received |= 1UL << i;
+        }
+        return position == length ? SCHEMA : INVALID;
+    }
+
+    Result decodeSample(const uint8_t* in, size_t length, Sample& sample) {
+        if(length < SAMPLE_HEADER_SIZE) return INVALID;
+        if(in[4] != _schemaId || !isSchemaComplete()) return UNKNOWN_SCHEMA;
+        sample.sequence = _sequence;
+        sample.timeUs = get32(&in[HEADER_SIZE]);
+        sample.mask = get32(&in[HEADER_SIZE + 4]);
+        if(sample.mask & ~maskOf(_signalCount)) return INVALID;
+        size_t position = SAMPLE_HEADER_SIZE;
+        for(uint8_t i=0; i<_signalCount; i++) {
+            if(!(sample.mask & (1UL << i))) continue;
+            uint8_t size = typeSize(_signals[i].type);
+            if(position + size > length) return INVALID;
+            sample.raw[i] = size == 2 ? get16(&in[position]) : get32(&in[position]);
+            position += size;
+        }
+        return position == length ? SAMPLE : INVALID;
+    }
+};
+
+}   // namespace Telemetry
+
+#endif // TELEMETRY_H
@@ -4,6 +4,7 @@
 //#include "UARTInterface.h"
 #include "CANTramCore.h"
 #include "HardwareResource.h"
+#include <functional>
 
 /**
  * @file UARTCore.h
@@ -50,6 +51,52 @@ class UARTCore : public HardwareResource {
         UART_STOP_BITS_2   = 3
     };
 
+    /**
+     * @brief Settings of the RS-485 half-duplex mode, see setRS485().
+     */
+    struct RS485Config {
+        int8_t      dePin = DEFAULT_REF;            // Driver enable of the transceiver, driven by the RTS output of the UART
+        uint32_t    turnaroundUs = 0;               // Minimum silence after the last received byte before transmitting
+        uint16_t    txIdleBits = 0;                 // Idle bit times the transmitter inserts between consecutive transmissions
+        bool        collisionDetection = true;      // Count transmissions which collided with another sender
+    };
+
+    /**
+     * @brief Settings of the pattern detection, see setPatternDetection().
+     * @details A pattern is a run of count equal characters, e.g. a single '\n' for line-based protocols. The timing conditions
+     *          are checked by the hardware only, the software detection of host cores ignores them.
+     */
+    struct PatternConfig {
+        char        character = '\n';
+        uint8_t     count = 1;                      // Number of consecutive pattern characters
+        uint16_t    gapBits = 9;                    // Maximum bit times between two pattern characters
+        uint16_t    postIdleBits = 0;               // Minimum idle bit times after the last pattern character
+        uint16_t    preIdleBits = 0;                // Minimum idle bit times before the first pattern character
+    };
+
+    /**
+     * @brief Thresholds of the hardware FIFOs, see setFifoConfig(). The defaults are those of the ESP-IDF driver.
+     */
+    struct FifoConfig {
+        uint8_t     rxFullThreshold = 120;          // Received bytes in the RX FIFO which make them readable
+        uint8_t     rxTimeoutSymbols = 10;          // Idle character times after which fewer bytes become readable, 0 to disable
+        uint8_t     txEmptyThreshold = 10;          // Bytes left in the TX FIFO when it is refilled
+    };
+
+    /**
+     * @brief Request-to-first-byte latency, see setLatencyMeasurement().
+     */
+    struct LatencyStatistics {
+        uint32_t    responses;          // Requests followed by a readable byte
+        uint32_t    unanswered;         // Requests without readable byte before the next request
+        uint32_t    minUs;
+        uint32_t    maxUs;
+        uint32_t    lastUs;
+        uint64_t    totalUs;            // Sum of all latencies, for the average
+
+        uint32_t averageUs() const { return responses > 0 ? totalUs / responses : 0; }
+    };
+
     /**
      * @brief Install and initialize the UART driver and resources.
      * @details Prepare the underlying hardware driver and allocate required memory/buffers for UART operation.
@@ -114,17 +161,53 @@ class UARTCore : public HardwareResource {
      * @param size Number of bytes to send from the buffer.
      * @return true if the data was successfully queued/sent, false otherwise.
      */
-    virtual bool send(char buffer[], size_t size){DEBUG_PRINTLN("[UARTCore] Send"); return false;};
+    virtual bool send(const char buffer[], size_t size){DEBUG_PRINTLN("[UARTCore] Send"); return false;};
 
     /**
-     * @brief Read available bytes from the UART into the provided buffer.
-     * @details Attempt to read up to the size of the provided buffer. The concrete implementation should return
-     *          the actual number of bytes read.
+     * @brief Read all available bytes from the UART into the provided buffer.
+     * @details The buffer must hold available() bytes, i.e. the complete receive buffer of the driver.
+     *          Prefer read(buffer, capacity) or peek()/consume(), which never write beyond the given capacity.
      * @param buffer Destination buffer to receive bytes.
      * @return size_t Number of bytes read into the buffer (0 if none available).
      */
     virtual size_t read(char buffer[]){DEBUG_PRINTLN("[UARTCore] Read"); return 0;};
 
+    /**
+     * @brief Queue bytes for transmission without blocking.
+     * @details Unlike send(), the data may be accepted partially, e.g. by a protocol streaming more data than the transmit buffer
+     *          holds. Default implementation: all or nothing with send().
+     * @param data Bytes to send.
+     * @param length Number of bytes to send.
+     * @return size_t Number of bytes accepted, the caller passes the remaining bytes again later.
+     */
+    virtual size_t write(const uint8_t* data, size_t length){
+        return send(reinterpret_cast<const char*>(data), length) ? length : 0;
+    };
+
+    /**
+     * @brief Read received bytes without blocking.
+     * @param buffer Destination buffer.
+     * @param capacity Size of the destination buffer.
+     * @return size_t Number of bytes read, at most capacity.
+     */
+    virtual size_t read(uint8_t* buffer, size_t capacity){DEBUG_PRINTLN("[UARTCore] Read"); return 0;};
+
+    /**
+     * @brief Get the oldest received bytes in place, without copying them.
+     * @details Lets parsers work directly on the receive buffer of the core. The bytes stay available until they are removed
+     *          with consume(). A receive buffer which wraps around is returned in two parts: the second part follows after consume().
+     *          Default implementation: not supported, use read(buffer, capacity).
+     * @param data Set to the oldest received byte.
+     * @return size_t Number of contiguous bytes at data, 0 if none are available or in-place access is not supported.
+     */
+    virtual size_t peek(const uint8_t*& data){ data = nullptr; return 0; };
+
+    /**
+     * @brief Remove received bytes after peek().
+     * @param length Number of bytes to remove, at most the number returned by peek().
+     */
+    virtual void consume(size_t length){};
+
     /**
      * @brief Get the number of bytes currently available for reading.
      * @details Query the UART driver's RX buffer to determine how many bytes can be read without blocking.
@@ -139,6 +222,125 @@ class UARTCore : public HardwareResource {
      */
     virtual void flush()=0;
 
+    /**
+     * @brief Callback for received data, called with the number of bytes available for reading.
+     */
+    using ReceiveCallback = std::function<void(size_t available)>;
+
+    /**
+     * @brief Register a callback for received data, so the application does not need to poll available().
+     * @details Implementations call the callback from their receive task, not from the control loop. Keep it short and
+     *          only signal the application, e.g. with a task notification. Default implementation: not supported.
+     * @param callback Callback, nullptr to remove it.
+     * @return true if the core supports receive callbacks.
+     */
+    virtual bool setReceiveCallback(ReceiveCallback callback){ return false; }
+
+    /**
+     * @brief Callback for the end of a transmission, called when all queued bytes have left the transmitter and the line is idle.
+     */
+    using TxDoneCallback = std::function<void()>;
+
+    /**
+     * @brief Let send() and write() return immediately instead of waiting for room in the transmit buffer of the driver.
+     * @details In non-blocking mode the bytes are queued in a transmit ring of the core, which its task hands to the driver.
+     *          send() queues a buffer only as a whole and returns false if the ring cannot take it, write() accepts as many bytes
+     *          as the ring has room for. Default implementation: not supported, send() may block.
+     * @param enabled true for non-blocking mode.
+     * @return true if the mode was set.
+     */
+    virtual bool setNonBlockingSend(bool enabled){ return !enabled; }
+
+    /**
+     * @brief Register a callback for the end of a transmission, e.g. for protocols which must wait until the line is idle.
+     * @details Implementations call the callback from their task, not from the control loop. Keep it short. Default implementation:
+     *          not supported, poll isTxDone().
+     * @param callback Callback, nullptr to remove it.
+     * @return true if the core supports the callback.
+     */
+    virtual bool setTxDoneCallback(TxDoneCallback callback){ return false; }
+
+    /**
+     * @brief Check whether all queued bytes have been transmitted. Default implementation: always true.
+     */
+    virtual bool isTxDone(){ return true; }
+
+    /**
+     * @brief Switch between standard UART mode and RS-485 half-duplex mode.
+     * @details In RS-485 mode the core drives the driver enable of the transceiver itself, so the application writes as in standard
+     *          mode and needs no software direction switching. Default implementation: not supported.
+     * @param enabled true for RS-485 half-duplex, false for standard UART mode.
+     * @param config DE pin, turnaround timing and collision detection.
+     * @return true if the mode was set.
+     */
+    virtual bool setRS485(bool enabled, const RS485Config& config){ return false; }
+    bool isRS485() const { return _rs485; }
+    const RS485Config& getRS485Config() const { return _rs485Config; }
+
+    /**
+     * @brief Get the number of transmissions which collided with another sender in RS-485 mode.
+     */
+    virtual uint32_t getCollisionCount() const { return 0; }
+
+    /**
+     * @brief Report delimiter-terminated frames, so the application does not need to scan the received bytes for the delimiter.
+     * @details The core detects the pattern while receiving and keeps the position of each frame end, see nextFrameLength().
+     *          Received bytes stay readable as before. Default implementation: not supported.
+     * @param enabled true to detect patterns.
+     * @param config Pattern character, count and timing.
+     * @return true if the detection was set.
+     */
+    virtual bool setPatternDetection(bool enabled, const PatternConfig& config){ return false; }
+    bool isPatternDetection() const { return _patternDetection; }
+    const PatternConfig& getPatternConfig() const { return _patternConfig; }
+
+    /**
+     * @brief Get the length of the oldest complete frame in the receive buffer.
+     * @details The frame starts at the oldest received byte, i.e. at peek(), and ends with the pattern. Bytes read before the
+     *          first pattern belong to the first frame.
+     * @return size_t Frame length including the pattern, 0 if no complete frame was received or pattern detection is off.
+     */
+    virtual size_t nextFrameLength(){ return 0; }
+
+    /**
+     * @brief Read the oldest complete frame.
+     * @details A frame longer than capacity is truncated to capacity bytes and its remaining bytes are discarded, compare
+     *          nextFrameLength() with the buffer size first if frames may be longer.
+     * @param buffer Destination buffer.
+     * @param capacity Size of the destination buffer.
+     * @return size_t Number of bytes read including the pattern, 0 if no complete frame was received.
+     */
+    size_t readFrame(uint8_t* buffer, size_t capacity){
+        size_t length = nextFrameLength();
+        if(length == 0) return 0;
+        size_t received = read(buffer, length < capacity ? length : capacity);
+        if(received < length) consume(length - received);
+        return received;
+    }
+
+    /**
+     * @brief Set the thresholds of the hardware FIFOs.
+     * @details Received bytes become readable when rxFullThreshold bytes are in the RX FIFO or the line was idle for
+     *          rxTimeoutSymbols character times. Short request/response protocols respond faster with a low timeout, long
+     *          streams need fewer interrupts with a high full threshold. Default implementation: not supported.
+     * @param config RX full threshold, RX timeout and TX empty threshold.
+     * @return true if the thresholds were set.
+     */
+    virtual bool setFifoConfig(const FifoConfig& config){ return false; }
+    const FifoConfig& getFifoConfig() const { return _fifoConfig; }
+
+    /**
+     * @brief Measure the time from the end of each transmission to the first received byte which becomes readable.
+     * @details The end of a transmission is calculated from the number of bytes and the character time. Bytes received before
+     *          it, e.g. the echo of a half-duplex line, are not counted; the latency therefore includes the response time of the
+     *          peer and the delay of the FIFO thresholds, see setFifoConfig(). Default implementation: not supported.
+     * @param enabled true to measure, the statistics are reset.
+     * @return true if the measurement was set.
+     */
+    virtual bool setLatencyMeasurement(bool enabled){ return !enabled; }
+    virtual LatencyStatistics getLatencyStatistics() const { return {}; }
+    virtual void resetLatencyStatistics(){}
+
     /**
      * @brief Get the HardwareResource type for this core.
      * @details Overrides HardwareResource::getType() to return HardwareResource::Type::UART.
@@ -153,8 +355,41 @@ class UARTCore : public HardwareResource {
         return true;
     }
 
+    uint32_t getBaudrate() const { return _baudrate; }
+    DataBits getDataBits() const { return _dataBits; }
+    Parity getParity() const { return _parity; }
+    StopBits getStopBits() const { return _stopBits; }
+    int8_t getTxPin() const { return _txPin; }
+    int8_t getRxPin() const { return _rxPin; }
+    bool hasPins() const { return pinsConfigured; }
+
+    /**
+     * @brief Get the number of bits per character on the line, including start, parity and stop bits.
+     */
+    uint8_t getBitsPerChar() const {
+        return 1 + 5 + uint8_t(_dataBits) + (_parity != UART_PARITY_NONE ? 1 : 0) + (_stopBits == UART_STOP_BITS_1 ? 1 : 2);
+    }
+
     protected:
 
+    /**
+     * @brief Restore the settings of a new instance: no pins, baudrate 0, 8N1, no RS-485, pattern detection or FIFO thresholds.
+     */
+    void restoreSettings(){
+        _rxPin = DEFAULT_REF;
+        _txPin = DEFAULT_REF;
+        pinsConfigured = false;
+        _baudrate = 0;
+        _stopBits = UART_STOP_BITS_1;
+        _parity = UART_PARITY_NONE;
+        _dataBits = UART_DATA_8_BITS;
+        _rs485 = false;
+        _rs485Config = RS485Config();
+        _patternDetection = false;
+        _patternConfig = PatternConfig();
+        _fifoConfig = FifoConfig();
+    }
+
     //Hardware
     int8_t _rxPin= DEFAULT_REF;
     int8_t _txPin= DEFAULT_REF;
@@ -164,6 +399,11 @@ class UARTCore : public HardwareResource {
     StopBits _stopBits = UART_STOP_BITS_1;
     Parity _parity = UART_PARITY_NONE;
     DataBits _dataBits = UART_DATA_8_BITS;
+    bool _rs485 = false;
+    RS485Config _rs485Config;
+    bool _patternDetection = false;
+    PatternConfig _patternConfig;
+    FifoConfig _fifoConfig;
     
 };
 
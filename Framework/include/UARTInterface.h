@@ -22,7 +22,41 @@ public:
     void setStopBits(UARTCore::StopBits stopBits)
         {if(uartCore) uartCore->setStopBits(stopBits);}
 
-    bool send(char data[], size_t length){
+    //RS-485 half-duplex, see UARTCore::setRS485()
+    bool setRS485(bool enabled, const UARTCore::RS485Config& config = UARTCore::RS485Config())
+        {return uartCore && uartCore->setRS485(enabled, config);}
+    bool isRS485()
+        {return uartCore && uartCore->isRS485();}
+    uint32_t getCollisionCount()
+        {return uartCore ? uartCore->getCollisionCount() : 0;}
+
+    //Non-blocking transmission, see UARTCore
+    bool setNonBlockingSend(bool enabled)
+        {return uartCore && uartCore->setNonBlockingSend(enabled);}
+    bool setTxDoneCallback(UARTCore::TxDoneCallback callback)
+        {return uartCore && uartCore->setTxDoneCallback(callback);}
+    bool isTxDone()
+        {return !uartCore || uartCore->isTxDone();}
+
+    //Delimiter-terminated frames, see UARTCore::setPatternDetection()
+    bool setPatternDetection(bool enabled, const UARTCore::PatternConfig& config = UARTCore::PatternConfig())
+        {return uartCore && uartCore->setPatternDetection(enabled, config);}
+    size_t nextFrameLength()
+        {return uartCore ? uartCore->nextFrameLength() : 0;}
+    size_t readFrame(uint8_t* buffer, size_t capacity)
+        {return uartCore ? uartCore->readFrame(buffer, capacity) : 0;}
+
+    //FIFO thresholds and response latency, see UARTCore::setFifoConfig()
+    bool setFifoConfig(const UARTCore::FifoConfig& config)
+        {return uartCore && uartCore->setFifoConfig(config);}
+    bool setLatencyMeasurement(bool enabled)
+        {return uartCore && uartCore->setLatencyMeasurement(enabled);}
+    UARTCore::LatencyStatistics getLatencyStatistics()
+        {return uartCore ? uartCore->getLatencyStatistics() : UARTCore::LatencyStatistics{};}
+    void resetLatencyStatistics()
+        {if(uartCore) uartCore->resetLatencyStatistics();}
+
+    bool send(const char data[], size_t length){
         // Implement sending data over UART
         return uartCore->send(data,length);
     }
@@ -32,6 +66,16 @@ public:
         return uartCore->read(buffer);
     }
 
+    //Bounded and in-place access, see UARTCore
+    size_t write(const uint8_t* data, size_t length)
+        {return uartCore->write(data, length);}
+    size_t read(uint8_t* buffer, size_t capacity)
+        {return uartCore->read(buffer, capacity);}
+    size_t peek(const uint8_t*& data)
+        {return uartCore->peek(data);}
+    void consume(size_t length)
+        {uartCore->consume(length);}
+
     size_t available(){
         // Implement checking available data over UART
         return uartCore->available();
@@ -0,0 +1,118 @@
+#ifndef UART_MULTIPLEXER_H
+#define UART_MULTIPLEXER_H
+
+#include <Arduino.h>
+#include "UARTCore.h"
+#include "ByteRing.h"
+#include "Debug.h"
+
+/**
+ * @file UARTMultiplexer.h
+ * @brief Declaration of the UARTSegment and UARTMultiplexer classes.
+ * @details Defines a time-multiplexed mode in which several low-rate serial segments, e.g. RS-485 lines of different BusModules,
+ *          share one UART port. Each segment is a UARTCore of its own and can be handed out as HardwareResource. The multiplexer
+ *          routes the port to one segment at a time through setPins() and setRS485() of the port.
+ */
+
+class UARTMultiplexer;
+
+/**
+ * @class UARTSegment
+ * @brief UARTCore of one segment on a port shared by a UARTMultiplexer.
+ * @details Written bytes are buffered until the multiplexer grants the port to the segment. Received bytes are stored while the
+ *          port is routed to the segment. Pins and RS-485 settings are applied when the segment is granted; baudrate and
+ *          character format of the port are shared by all segments.
+ */
+class UARTSegment : public UARTCore {
+public:
+    static constexpr size_t TX_BUFFER_SIZE = 256;
+    static constexpr size_t RX_BUFFER_SIZE = 256;
+
+    struct Statistics {
+        uint32_t    grants;             // Slots granted to the segment
+        uint32_t    maxWaitUs;          // Longest time from pending bytes seen by the multiplexer to the grant
+        uint32_t    txBytes;            // Bytes forwarded to the port
+        uint32_t    rxBytes;            // Bytes received while the port was routed to the segment
+        uint32_t    rxDropped;          // Received bytes dropped because the receive buffer was full
+    };
+
+    UARTSegment() = default;
+
+    bool install(int uart_num, uint8_t tx_pin, uint8_t rx_pin, uint16_t bufferSize) override;
+    bool send(const char buffer[], size_t size) override;
+    size_t read(char buffer[]) override;
+    size_t write(const uint8_t* data, size_t length) override;
+    size_t read(uint8_t* buffer, size_t capacity) override;
+    size_t peek(const uint8_t*& data) override { return _rx.peek(data); }
+    void consume(size_t length) override { _rx.consume(length); }
+    size_t available() override { return _rx.size(); }
+    void flush() override { _rx.clear(); }
+    bool setRS485(bool enabled, const RS485Config& config) override;
+
+    bool hasPendingData() const { return !_tx.empty(); }
+    const Statistics& getStatistics() const { return _statistics; }
+    void resetStatistics() { _statistics = {}; }
+
+private:
+    friend class UARTMultiplexer;
+
+    ByteRing<TX_BUFFER_SIZE> _tx;
+    ByteRing<RX_BUFFER_SIZE> _rx;
+    bool _waiting = false;              // Pending bytes seen by the multiplexer, waiting for a grant
+    uint32_t _waitingSinceUs = 0;
+    Statistics _statistics = {};
+};
+
+/**
+ * @class UARTMultiplexer
+ * @brief Time-multiplexed sharing of one UART port among several segments with bounded latency.
+ * @details The port is granted round robin to the segments with pending bytes. A granted segment keeps the port while it transmits
+ *          and for the hold time after its last activity, so the response of a device on the segment is received. When another
+ *          segment is waiting, the slot of the active segment ends after the slot time: bytes are only forwarded if their
+ *          transmission ends within the slot, and the port is switched once the transmission is complete. Every segment with
+ *          pending bytes is therefore granted within getLatencyBoundUs(), as long as each write fits into a slot.
+ *          cycle() must be called cyclically, its period adds to the latency and the receive delay of the segments.
+ */
+class UARTMultiplexer {
+public:
+    static constexpr uint8_t MAX_SEGMENTS = 4;
+    static constexpr uint32_t DEFAULT_SLOT_US = 50000;
+    static constexpr uint32_t DEFAULT_HOLD_US = 5000;
+
+    UARTMultiplexer() = default;
+
+    bool setSegmentCount(uint8_t count);
+    uint8_t getSegmentCount() const { return _segmentCount; }
+    UARTSegment* getSegment(uint8_t index) { return index < _segmentCount ? &_segments[index] : nullptr; }
+    bool isUsed();
+
+    void setTiming(uint32_t slotUs, uint32_t holdUs);
+    uint32_t getLatencyBoundUs() const;
+
+    bool begin(UARTCore* port);
+    void end();
+    bool isRunning() const { return _port != nullptr; }
+    void cycle(uint32_t nowUs);
+    int8_t getActiveSegment() const { return _active; }
+
+private:
+    UARTSegment _segments[MAX_SEGMENTS];
+    uint8_t _segmentCount = 0;
+    UARTCore* _port = nullptr;
+    uint32_t _slotUs = DEFAULT_SLOT_US;
+    uint32_t _holdUs = DEFAULT_HOLD_US;
+    uint32_t _charTimeNs = 0;
+
+    int8_t _active = -1;                // Segment the port is granted to
+    int8_t _routed = -1;                // Segment the port is routed to, keeps receiving after the slot until the next grant
+    uint32_t _grantUs = 0;
+    uint32_t _busyUntilUs = 0;          // End of the transmission of the forwarded bytes
+    uint32_t _lastActivityUs = 0;
+
+    void receive(uint32_t nowUs);
+    void transmit(UARTSegment& segment, uint32_t nowUs, bool limited);
+    int8_t nextWaiting() const;
+    bool route(uint8_t index);
+};
+
+#endif // UART_MULTIPLEXER_H
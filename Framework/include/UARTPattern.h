@@ -0,0 +1,147 @@
+#ifndef UART_PATTERN_H
+#define UART_PATTERN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+/**
+ * @file UARTPattern.h
+ * @brief Declaration of the UARTPatternDetector and UARTPatternQueue classes.
+ * @details Frame detection for delimiter-terminated protocols, see UARTCore::setPatternDetection(). A pattern is a run of
+ *          count equal characters, e.g. a single '\n'. Frame ends are kept as positions in the received byte stream, so the
+ *          application gets the length of each complete frame without scanning the receive buffer again every cycle.
+ *          - UARTPatternDetector finds patterns in software, e.g. in cores on the host without pattern detection hardware.
+ *          - UARTPatternQueue passes the frame ends from a receive task to the application, lock-free like ByteRing.
+ */
+
+/**
+ * @class UARTPatternDetector
+ * @brief Software detection of a run of equal characters, byte by byte.
+ * @details Like the pattern detection of the ESP32 UART, the run starts over after each detected pattern, so six
+ *          consecutive '+' are two patterns of "+++". Timing conditions between the characters are not checked.
+ */
+struct UARTPatternDetector {
+    uint8_t     character = '\n';
+    uint8_t     count = 1;
+    uint8_t     run = 0;            // Pattern characters received in a row
+
+    void configure(uint8_t patternCharacter, uint8_t patternCount) {
+        character = patternCharacter;
+        count = patternCount > 0 ? patternCount : 1;
+        run = 0;
+    }
+
+    /**
+     * @brief Check the next received byte.
+     * @return true if the byte completes a pattern.
+     */
+    bool detect(uint8_t byte) {
+        if(byte != character) {
+            run = 0;
+            return false;
+        }
+        if(++run < count) return false;
+        run = 0;
+        return true;
+    }
+};
+
+/**
+ * @class UARTPatternQueue
+ * @brief Lock-free single-producer/single-consumer queue of frame ends in the received byte stream.
+ * @details The producer, e.g. the receive task, counts the bytes it appends to the receive buffer with advance() and queues the
+ *          stream position after each pattern with push(). The consumer counts the bytes it removes from the receive buffer with
+ *          consume(), so nextFrameLength() is the distance to the next frame end. Frame ends which the consumer passed, e.g.
+ *          by reading without frames, are dropped. Stream positions are 32-bit and wrap around.
+ *          If the queue is full, the frame end is dropped and counted, the frame then continues to the next frame end.
+ * @tparam Capacity Number of frame ends, a power of two.
+ */
+template<size_t Capacity>
+class UARTPatternQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+public:
+    UARTPatternQueue() = default;
+    UARTPatternQueue(const UARTPatternQueue&) = delete;
+    UARTPatternQueue& operator=(const UARTPatternQueue&) = delete;
+
+    /**
+     * @brief Remove all frame ends and restart both stream positions at 0. Call only while neither side is running.
+     */
+    void reset() {
+        _head.store(0, std::memory_order_relaxed);
+        _tail.store(0, std::memory_order_relaxed);
+        _dropped.store(0, std::memory_order_relaxed);
+        _produced = 0;
+        _consumed = 0;
+    }
+
+    /**
+     * @brief Queue a frame end (producer side).
+     * @param end Stream position after the last pattern character, see produced().
+     * @return true if the frame end was queued, false if the queue is full.
+     */
+    bool push(uint32_t end) {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        if(head - _tail.load(std::memory_order_acquire) >= Capacity) {
+            _dropped.store(_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+        _ends[head & MASK] = end;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Count bytes appended to the receive buffer (producer side).
+     */
+    void advance(size_t length) { _produced += length; }
+
+    /**
+     * @brief Get the stream position of the next byte appended to the receive buffer (producer side).
+     */
+    uint32_t produced() const { return _produced; }
+
+    /**
+     * @brief Get the length of the oldest complete frame (consumer side).
+     * @return size_t Bytes up to and including the pattern of the next frame end, 0 if no frame end is queued.
+     */
+    size_t nextFrameLength() {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        uint32_t head = _head.load(std::memory_order_acquire);
+        size_t length = 0;
+        for(; tail != head; tail++) {
+            int32_t distance = int32_t(_ends[tail & MASK] - _consumed);
+            if(distance > 0) {
+                length = distance;
+                break;
+            }
+        }
+        _tail.store(tail, std::memory_order_release);
+        return length;
+    }
+
+    /**
+     * @brief Count bytes removed from the receive buffer (consumer side).
+     */
+    void consume(size_t length) { _consumed += length; }
+
+    /**
+     * @brief Get the number of frame ends dropped because the queue was full.
+     */
+    uint32_t getDropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+    static constexpr size_t capacity() { return Capacity; }
+
+private:
+    static constexpr uint32_t MASK = Capacity - 1;
+
+    std::atomic<uint32_t> _head{0};         // Written by the producer
+    std::atomic<uint32_t> _tail{0};         // Written by the consumer
+    std::atomic<uint32_t> _dropped{0};
+    uint32_t _produced = 0;                 // Producer only
+    uint32_t _consumed = 0;                 // Consumer only
+    uint32_t _ends[Capacity];
+};
+
+#endif // UART_PATTERN_H
@@ -0,0 +1,57 @@
+#ifndef UPDATETARGET_H
+#define UPDATETARGET_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @file UpdateTarget.h
+ * @brief Declaration of the UpdateTarget interface.
+ * @details Storage written by CANUpdateServer. A target stages a new image next to the active one (e.g. the inactive OTA
+ *          partition) and switches over in activate(), so the active image stays valid until the new one is complete and verified.
+ *          Data is written in ascending offsets without gaps.
+ */
+class UpdateTarget {
+public:
+    virtual ~UpdateTarget() = default;
+
+    /**
+     * @brief Prepare the staging area for a new image.
+     * @param size Size of the image in bytes.
+     * @return false if the image does not fit or the staging area cannot be prepared.
+     */
+    virtual bool begin(uint32_t size) = 0;
+
+    /**
+     * @brief Write image data to the staging area.
+     * @param offset Offset in the image, equal to the number of bytes written before.
+     * @param data Data to write.
+     * @param length Number of bytes.
+     * @return false on a write error.
+     */
+    virtual bool write(uint32_t offset, const uint8_t* data, size_t length) = 0;
+
+    /**
+     * @brief Complete the staging area after the last write.
+     * @return false if the image is incomplete or rejected by the target.
+     */
+    virtual bool finish() = 0;
+
+    /**
+     * @brief Switch over to the staged image. Only allowed after finish().
+     * @return false if the switch failed. The active image is not changed in this case.
+     */
+    virtual bool activate() = 0;
+
+    /**
+     * @brief Discard the staging area. The active image is not changed.
+     */
+    virtual void abort() = 0;
+
+    /**
+     * @brief Get the maximum image size.
+     */
+    virtual uint32_t getCapacity() const = 0;
+};
+
+#endif // UPDATETARGET_H
@@ -0,0 +1,384 @@
+#ifndef VIRTUALCANBUS_H
+#define VIRTUALCANBUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include "CANFrame.h"
+
+/**
+ * @file VirtualCANBus.h
+ * @brief Declaration of the VirtualCANBus class.
+ * @details Defines an in-process simulation of a CAN bus with up to MAX_NODES nodes, e.g. to test decentralized setups on the host.
+ *          The bus runs on a simulated clock which is advanced with run(), so results are deterministic and independent of the host speed.
+ *
+ *          Simulated behaviour:
+ *          - Bitwise arbitration: when the bus becomes idle, the head frames of all transmit queues compete and the lowest identifier
+ *            wins (standard before extended frames with the same base identifier, data before remote frames).
+ *            Frames queued while the bus is busy wait for the end of the current frame.
+ *          - Bit timing: a frame occupies CANFrame::getBusBits() bit times (worst case stuffing) at the configured bitrate.
+ *          - Error handling: corrupted transmissions (see setTxErrorRate()) are followed by an error frame and retransmitted.
+ *            Transmit and receive error counters follow ISO 11898-1 (+8/-1 and +1/-1). A node exceeding a transmit error count of 255
+ *            goes bus-off, loses its transmit queue and recovers after 128 x 11 recessive bits.
+ *          - Lost frames: a node can drop received frames with a given probability (see setRxLossRate()) and drops frames
+ *            if its receive queue is full.
+ *          Identical identifiers sent by two nodes at the same time are not detected as collision, the node with the lower index wins.
+ */
+class VirtualCANBus {
+public:
+    static constexpr uint8_t MAX_NODES = 16;
+    static constexpr size_t QUEUE_SIZE = 32;            // Transmit and receive queue size per node
+    static constexpr uint16_t ERROR_FRAME_BITS = 17;    // Error flag, error delimiter and intermission
+    static constexpr uint16_t BUS_OFF_RECOVERY_BITS = 128 * 11;
+
+    struct NodeStatistics {
+        uint32_t    txFrames;           // Frames transmitted successfully
+        uint32_t    rxFrames;           // Frames delivered to the receive queue
+        uint32_t    txErrors;           // Corrupted transmissions
+        uint32_t    arbitrationLost;
+        uint32_t    txDiscarded;        // Queued frames discarded when the node went bus-off
+        uint32_t    lostFrames;         // Received frames dropped by setRxLossRate()
+        uint32_t    rxOverruns;         // Received frames dropped because the receive queue was full
+        uint32_t    busOffCount;
+        uint64_t    totalLatencyUs;     // Sum of queue-to-end-of-frame times of transmitted frames
+        uint32_t    maxLatencyUs;
+    };
+
+    /**
+     * @brief Called after a frame was transmitted successfully.
+     * @param node Transmitting node.
+     * @param frame The frame.
+     * @param queuedUs Simulated time the frame was queued.
+     * @param doneUs Simulated time the frame was completed on the bus.
+     */
+    using TransmitCallback = std::function<void(uint8_t node, const CANFrame& frame, uint64_t queuedUs, uint64_t doneUs)>;
+
+    /**
+     * @brief Called when a node receives a frame, before it is queued, like a driver handling frames in its receive path.
+     * @details The hook may transmit frames, e.g. an immediate response.
+     * @return true if the frame was consumed and is not queued.
+     */
+    using ReceiveHook = std::function<bool(const CANFrame& frame, uint64_t timeUs)>;
+
+    /**
+     * @brief Called when a frame of a node was transmitted successfully, like a driver handling the end of a transmission.
+     */
+    using TransmitHook = std::function<void(const CANFrame& frame, uint64_t timeUs)>;
+
+    explicit VirtualCANBus(uint32_t bitrate = 500000) : _bitrate(bitrate) {}
+    VirtualCANBus(const VirtualCANBus&) = delete;
+    VirtualCANBus& operator=(const VirtualCANBus&) = delete;
+
+    void setBitrate(uint32_t bitrate) { _bitrate = bitrate; }
+    uint32_t getBitrate() const { return _bitrate; }
+    void setSeed(uint32_t seed) { _random = seed ? seed : 1; }
+    void setTransmitCallback(TransmitCallback callback) { _transmitCallback = callback; }
+
+    /**
+     * @brief Attach a node to the bus.
+     * @return int8_t Node index, -1 if all MAX_NODES nodes are in use.
+     */
+    int8_t attach() {
+        for(uint8_t i=0; i<MAX_NODES; i++) {
+            if(_nodes[i].attached) continue;
+            _nodes[i] = Node();
+            _nodes[i].attached = true;
+            return i;
+        }
+        return -1;
+    }
+
+    void detach(uint8_t node) {
+        if(node >= MAX_NODES) return;
+        if(_busy && _txNode == node) _txAborted = true;
+        _nodes[node].attached = false;
+        _nodes[node].receiveHook = nullptr;
+        _nodes[node].transmitHook = nullptr;
+    }
+
+    void setReceiveHook(uint8_t node, ReceiveHook hook) { if(isAttached(node)) _nodes[node].receiveHook = hook; }
+    void setTransmitHook(uint8_t node, TransmitHook hook) { if(isAttached(node)) _nodes[node].transmitHook = hook; }
+
+    /**
+     * @brief Queue a frame for transmission.
+     * @return false if the node is not attached, bus-off or its transmit queue is full.
+     */
+    bool transmit(uint8_t node, const CANFrame& frame) {
+        if(!isAttached(node)) return false;
+        Node& n = _nodes[node];
+        if(n.busOff || n.txCount >= QUEUE_SIZE) return false;
+        TxEntry& entry = n.txQueue[(n.txHead + n.txCount) % QUEUE_SIZE];
+        entry.frame = frame;
+        entry.queuedNs = _nowNs;
+        n.txCount++;
+        return true;
+    }
+
+    /**
+     * @brief Take the oldest received frame of a node.
+     * @param node Node index.
+     * @param frame Destination, the timestamp holds the lower 28 bits of the simulated receive time in microseconds.
+     * @param timeUs Optional destination of the full simulated receive time.
+     * @return true if a frame was available.
+     */
+    bool receive(uint8_t node, CANFrame& frame, uint64_t* timeUs = nullptr) {
+        if(!isAttached(node)) return false;
+        Node& n = _nodes[node];
+        if(n.rxCount == 0) return false;
+        const RxEntry& entry = n.rxQueue[n.rxHead];
+        frame = entry.frame;
+        if(timeUs) *timeUs = entry.doneNs / 1000;
+        n.rxHead = (n.rxHead + 1) % QUEUE_SIZE;
+        n.rxCount--;
+        return true;
+    }
+
+    size_t available(uint8_t node) const { return isAttached(node) ? _nodes[node].rxCount : 0; }
+    size_t pending(uint8_t node) const { return isAttached(node) ? _nodes[node].txCount : 0; }
+
+    /**
+     * @brief Set the acceptance filter of a node. A frame passes if (frameId & mask) == (id & mask).
+     */
+    void setFilter(uint8_t node, uint32_t id, uint32_t mask) {
+        if(!isAttached(node)) return;
+        _nodes[node].filterId = id;
+        _nodes[node].filterMask = mask;
+    }
+
+    /**
+     * @brief Let transmissions of a node fail with the given probability (e.g. faulty transceiver or cable).
+     */
+    void setTxErrorRate(uint8_t node, uint16_t permille) { if(isAttached(node)) _nodes[node].txErrorPermille = permille; }
+
+    /**
+     * @brief Let a node lose received frames with the given probability.
+     */
+    void setRxLossRate(uint8_t node, uint16_t permille) { if(isAttached(node)) _nodes[node].rxLossPermille = permille; }
+
+    /**
+     * @brief Put a node into bus-off immediately.
+     */
+    void forceBusOff(uint8_t node) {
+        if(isAttached(node)) enterBusOff(_nodes[node]);
+    }
+
+    /**
+     * @brief Advance the simulated time.
+     * @param durationUs Time to simulate in microseconds.
+     */
+    void run(uint64_t durationUs) {
+        uint64_t endNs = _nowNs + durationUs * 1000;
+        while(true) {
+            if(_busy) {
+                if(_txEndNs > endNs) break;
+                _nowNs = _txEndNs;
+                finishTransmission();
+                continue;
+            }
+            recoverNodes();
+            if(!startTransmission()) {
+                uint64_t nextNs = nextRecoveryNs();
+                if(nextNs > endNs) break;
+                _nowNs = nextNs;
+            }
+        }
+        _nowNs = endNs;
+    }
+
+    uint64_t now() const { return _nowNs / 1000; }
+
+    /**
+     * @brief Get the bus load since the last resetStatistics().
+     * @return uint16_t Bus load in permille, including error frames.
+     */
+    uint16_t getBusLoad() const {
+        uint64_t elapsed = _nowNs - _statisticsStartNs;
+        if(elapsed == 0) return 0;
+        uint64_t busy = _busyNs + (_busy ? _nowNs - (_txStartNs > _statisticsStartNs ? _txStartNs : _statisticsStartNs) : 0);
+        return busy * 1000 / elapsed;
+    }
+
+    void resetStatistics() {
+        _busyNs = 0;
+        _statisticsStartNs = _nowNs;
+        for(uint8_t i=0; i<MAX_NODES; i++) _nodes[i].statistics = {};
+    }
+
+    bool isAttached(uint8_t node) const { return node < MAX_NODES && _nodes[node].attached; }
+    bool isBusOff(uint8_t node) const { return isAttached(node) && _nodes[node].busOff; }
+    uint16_t getTxErrorCounter(uint8_t node) const { return isAttached(node) ? _nodes[node].txErrorCounter : 0; }
+    uint16_t getRxErrorCounter(uint8_t node) const { return isAttached(node) ? _nodes[node].rxErrorCounter : 0; }
+    const NodeStatistics& getStatistics(uint8_t node) const { return _nodes[node < MAX_NODES ? node : 0].statistics; }
+
+    uint64_t bitsToNs(uint32_t bits) const { return uint64_t(bits) * 1000000000ULL / _bitrate; }
+
+private:
+    struct TxEntry {
+        CANFrame    frame;
+        uint64_t    queuedNs;
+    };
+
+    struct RxEntry {
+        CANFrame    frame;
+        uint64_t    doneNs;
+    };
+
+    struct Node {
+        bool        attached = false;
+        bool        busOff = false;
+        uint64_t    busOffUntilNs = 0;
+        uint16_t    txErrorCounter = 0;
+        uint16_t    rxErrorCounter = 0;
+        uint16_t    txErrorPermille = 0;
+        uint16_t    rxLossPermille = 0;
+        uint32_t    filterId = 0;
+        uint32_t    filterMask = 0;
+        TxEntry     txQueue[QUEUE_SIZE];
+        size_t      txHead = 0;
+        size_t      txCount = 0;
+        RxEntry     rxQueue[QUEUE_SIZE];
+        size_t      rxHead = 0;
+        size_t      rxCount = 0;
+        ReceiveHook receiveHook;
+        TransmitHook transmitHook;
+        NodeStatistics statistics = {};
+    };
+
+    bool chance(uint16_t permille) {
+        if(permille == 0) return false;
+        _random ^= _random << 13;
+        _random ^= _random >> 17;
+        _random ^= _random << 5;
+        return _random % 1000 < permille;
+    }
+
+    bool startTransmission() {
+        int8_t winner = -1;
+        uint32_t winnerKey = 0;
+        for(uint8_t i=0; i<MAX_NODES; i++) {
+            const Node& n = _nodes[i];
+            if(!n.attached || n.busOff || n.txCount == 0) continue;
+            uint32_t key = n.txQueue[n.txHead].frame.getArbitrationKey();
+            if(winner < 0 || key < winnerKey) {
+                winner = i;
+                winnerKey = key;
+            }
+        }
+        if(winner < 0) return false;
+        for(uint8_t i=0; i<MAX_NODES; i++) {
+            if(i != winner && _nodes[i].attached && !_nodes[i].busOff && _nodes[i].txCount > 0) _nodes[i].statistics.arbitrationLost++;
+        }
+        Node& n = _nodes[winner];
+        const CANFrame& frame = n.txQueue[n.txHead].frame;
+        uint32_t bits = CANFrame::getBusBits(frame.isRemote() ? 0 : frame.getLength(), frame.isExtended());
+        _txCorrupted = chance(n.txErrorPermille);
+        if(_txCorrupted) bits += ERROR_FRAME_BITS;
+        _busy = true;
+        _txAborted = false;
+        _txNode = winner;
+        _txStartNs = _nowNs;
+        _txEndNs = _nowNs + bitsToNs(bits);
+        return true;
+    }
+
+    void finishTransmission() {
+        _busy = false;
+        _busyNs += _txEndNs - (_txStartNs > _statisticsStartNs ? _txStartNs : _statisticsStartNs);
+        if(_txAborted) return;
+        Node& tx = _nodes[_txNode];
+
+        if(_txCorrupted) {
+            tx.statistics.txErrors++;
+            tx.txErrorCounter += 8;
+            for(uint8_t i=0; i<MAX_NODES; i++) {
+                Node& n = _nodes[i];
+                if(i != _txNode && n.attached && !n.busOff && n.rxErrorCounter < 255) n.rxErrorCounter++;
+            }
+            if(tx.txErrorCounter > 255) enterBusOff(tx);
+            return;     // Frame stays queued and is retransmitted
+        }
+
+        TxEntry entry = tx.txQueue[tx.txHead];     // Copy, receive hooks may queue new frames
+        tx.txHead = (tx.txHead + 1) % QUEUE_SIZE;
+        tx.txCount--;
+        if(tx.txErrorCounter > 0) tx.txErrorCounter--;
+        uint32_t latencyUs = (_nowNs - entry.queuedNs) / 1000;
+        tx.statistics.txFrames++;
+        tx.statistics.totalLatencyUs += latencyUs;
+        if(latencyUs > tx.statistics.maxLatencyUs) tx.statistics.maxLatencyUs = latencyUs;
+
+        CANFrame frame = entry.frame;
+        frame.setTimestamp(uint32_t(_nowNs / 1000));
+        if(tx.transmitHook) tx.transmitHook(frame, _nowNs / 1000);
+        for(uint8_t i=0; i<MAX_NODES; i++) {
+            Node& n = _nodes[i];
+            if(i == _txNode || !n.attached || n.busOff) continue;
+            if(n.rxErrorCounter > 0) n.rxErrorCounter--;
+            if((frame.getId() & n.filterMask) != (n.filterId & n.filterMask)) continue;
+            if(chance(n.rxLossPermille)) {
+                n.statistics.lostFrames++;
+                continue;
+            }
+            if(n.receiveHook && n.receiveHook(frame, _nowNs / 1000)) {
+                n.statistics.rxFrames++;
+                continue;
+            }
+            if(n.rxCount >= QUEUE_SIZE) {
+                n.statistics.rxOverruns++;
+                continue;
+            }
+            n.rxQueue[(n.rxHead + n.rxCount) % QUEUE_SIZE] = {frame, _nowNs};
+            n.rxCount++;
+            n.statistics.rxFrames++;
+        }
+        if(_transmitCallback) _transmitCallback(_txNode, entry.frame, entry.queuedNs / 1000, _nowNs / 1000);
+    }
+
+    void enterBusOff(Node& node) {
+        if(node.busOff) return;
+        node.busOff = true;
+        node.busOffUntilNs = _nowNs + bitsToNs(BUS_OFF_RECOVERY_BITS);
+        node.statistics.busOffCount++;
+        node.statistics.txDiscarded += node.txCount;
+        node.txCount = 0;
+        if(_busy && &_nodes[_txNode] == &node) _txAborted = true;
+    }
+
+    void recoverNodes() {
+        for(uint8_t i=0; i<MAX_NODES; i++) {
+            Node& n = _nodes[i];
+            if(n.attached && n.busOff && n.busOffUntilNs <= _nowNs) {
+                n.busOff = false;
+                n.txErrorCounter = 0;
+                n.rxErrorCounter = 0;
+            }
+        }
+    }
+
+    uint64_t nextRecoveryNs() const {
+        uint64_t next = UINT64_MAX;
+        for(uint8_t i=0; i<MAX_NODES; i++) {
+            if(_nodes[i].attached && _nodes[i].busOff && _nodes[i].busOffUntilNs < next) next = _nodes[i].busOffUntilNs;
+        }
+        return next;
+    }
+
+    uint32_t _bitrate;
+    uint32_t _random = 0x12345678;
+    TransmitCallback _transmitCallback;
+    Node _nodes[MAX_NODES];
+
+    uint64_t _nowNs = 0;
+    uint64_t _statisticsStartNs = 0;
+    uint64_t _busyNs = 0;
+
+    //Current transmission
+    bool _busy = false;
+    bool _txCorrupted = false;
+    bool _txAborted = false;
+    uint8_t _txNode = 0;
+    uint64_t _txStartNs = 0;
+    uint64_t _txEndNs = 0;
+};
+
+#endif // VIRTUALCANBUS_H
@@ -0,0 +1,61 @@
+#ifndef VIRTUALCANCORE_H
+#define VIRTUALCANCORE_H
+
+#include <Arduino.h>
+#include "CANCore.h"
+#include "VirtualCANBus.h"
+#include "Debug.h"
+
+/**
+ * @file VirtualCANCore.h
+ * @brief Declaration of the VirtualCANCore class.
+ * @details Defines a CANCore implementation which connects a node to a VirtualCANBus, so several CANInterface based nodes
+ *          can be tested inside one process. The simulated time of the bus is advanced by the test with VirtualCANBus::run().
+ *          Bus status, error counters and statistics of the node are mapped onto CANCore::getStatus() and CANCore::getStatistics().
+ *          In listen-only mode the node may use a baudrate different from the bus bitrate, like a controller searching the bitrate:
+ *          it then receives no frames and every frame on the bus is counted as bus error.
+ *          An attached CANResponder answers remote frames at the simulated receive time, like the receive path of a driver task.
+ *          Periodic frames are sent by serviceResponder(), which the test calls in place of the driver task.
+ *          Transmit timestamps are taken at the simulated end of the frame.
+ */
+class VirtualCANCore : public CANCore {
+public:
+    explicit VirtualCANCore(VirtualCANBus& bus) : _bus(bus) {}
+    ~VirtualCANCore() = default;
+
+    HardwareResource::Type getType() override { return HardwareResource::CAN; }
+    bool begin() override;
+    bool setBaudrate(Baudrate baudrate) override;
+    bool setPins(int8_t txPin, int8_t rxPin) override;
+    bool end() override;
+    bool sendMessage(const CANMessage& message) override;
+    bool readMessage(CANMessage& message) override;
+    bool readFrame(CANFrame& frame) override;
+    uint8_t available() override;
+    bool setupFilter(uint32_t id, uint32_t mask) override;
+    bool setResponder(CANResponder* responder) override;
+    bool enableTxTimestamp(uint32_t id) override;
+    void disableTxTimestamp() override;
+    bool readTxTimestamp(CANFrame& frame) override;
+    void serviceResponder();
+
+    int8_t getNode() const { return _node; }
+
+private:
+    void updateStatus();
+    void installResponder();
+    void installTxTimestamp();
+
+    VirtualCANBus& _bus;
+    int8_t _node = -1;
+    bool _bitrateMismatch = false;
+    uint32_t _mismatchErrors = 0;
+
+    bool _txTimestampEnabled = false;
+    uint32_t _txTimestampId = 0;
+    bool _txTimestampReady = false;
+    CANFrame _txTimestampFrame;
+    uint64_t _txTimestampUs = 0;        // Simulated end of the frame
+};
+
+#endif // VIRTUALCANCORE_H
@@ -0,0 +1,51 @@
+#ifndef VIRTUALUARTCORE_H
+#define VIRTUALUARTCORE_H
+
+#include <Arduino.h>
+#include "UARTCore.h"
+#include "VirtualUARTLink.h"
+#include "Debug.h"
+
+/**
+ * @file VirtualUARTCore.h
+ * @brief Declaration of the VirtualUARTCore class.
+ * @details Defines a UARTCore implementation which connects to one endpoint of a VirtualUARTLink, so UART protocols can be tested
+ *          inside one process. The simulated time of the line is advanced by the test with VirtualUARTLink::run().
+ *          The baudrate and character format are applied to the line. send() accepts a buffer only as a whole: where the ESP32 driver
+ *          blocks until the transmit buffer has room, the simulation cannot advance its time and returns false instead.
+ *          Pattern detection uses the software detection of the line, the timing conditions of the pattern are not simulated.
+ */
+class VirtualUARTCore : public UARTCore {
+public:
+    VirtualUARTCore(VirtualUARTLink& link, uint8_t endpoint) : _link(link), _endpoint(endpoint) {}
+
+    bool install(int uart_num, uint8_t tx_pin, uint8_t rx_pin, uint16_t bufferSize) override;
+    bool config(uint32_t baudrate, DataBits dataBits, Parity parity, StopBits stopBits) override;
+    bool setBaudrate(uint32_t baudrate) override;
+    bool setDataBits(DataBits dataBits) override;
+    bool setParity(Parity parity) override;
+    bool setStopBits(StopBits stopBits) override;
+    bool send(const char buffer[], size_t size) override;
+    size_t read(char buffer[]) override;
+    size_t write(const uint8_t* data, size_t length) override;
+    size_t read(uint8_t* buffer, size_t capacity) override;
+    size_t peek(const uint8_t*& data) override;
+    void consume(size_t length) override;
+    size_t available() override;
+    void flush() override;
+    bool setNonBlockingSend(bool enabled) override { return true; }    // send() never waits for the line
+    bool isTxDone() override { return _link.txPending(_endpoint) == 0; }
+    bool setPatternDetection(bool enabled, const PatternConfig& config) override;
+    size_t nextFrameLength() override { return _installed ? _link.nextFrameLength(_endpoint) : 0; }
+
+    uint8_t getEndpoint() const { return _endpoint; }
+
+private:
+    void applyConfig();
+
+    VirtualUARTLink& _link;
+    uint8_t _endpoint;
+    bool _installed = false;
+};
+
+#endif // VIRTUALUARTCORE_H
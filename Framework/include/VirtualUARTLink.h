@@ -0,0 +1,253 @@
+#ifndef VIRTUALUARTLINK_H
+#define VIRTUALUARTLINK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "UARTPattern.h"
+
+/**
+ * @file VirtualUARTLink.h
+ * @brief Declaration of the VirtualUARTLink class.
+ * @details Defines an in-process simulation of a full-duplex serial line between two endpoints, e.g. to test UART protocols on the host.
+ *          Like VirtualCANBus, the line runs on a simulated clock which is advanced with run().
+ *
+ *          Simulated behaviour:
+ *          - Each endpoint has a transmit and a receive buffer of up to BUFFER_SIZE bytes, like the ring buffers of a UART driver.
+ *          - Character timing: one byte occupies getBitsPerChar() bit times (start, data, parity and stop bits) at the configured baudrate.
+ *            Bytes written to an idle transmitter start immediately, further bytes follow back to back.
+ *          - Receive overruns: a byte arriving at a full receive buffer is dropped and counted.
+ *          - Pattern detection: like the UART hardware, each byte stored in the receive buffer is checked for the pattern and the
+ *            frame ends are queued, see setPatternDetection(). This is the software fallback for cores without the hardware.
+ */
+class VirtualUARTLink {
+public:
+    static constexpr uint8_t ENDPOINTS = 2;
+    static constexpr size_t BUFFER_SIZE = 1024;         // Maximum transmit and receive buffer size per endpoint
+    static constexpr size_t FRAME_QUEUE_SIZE = 64;      // Frame ends queued per endpoint
+
+    struct EndpointStatistics {
+        uint32_t    txBytes;            // Bytes completed on the line
+        uint32_t    rxBytes;            // Bytes stored in the receive buffer
+        uint32_t    rxOverruns;         // Bytes dropped because the receive buffer was full
+        uint32_t    writes;             // Calls of write() which accepted data
+        uint32_t    patterns;           // Detected patterns
+        uint32_t    patternsDropped;    // Frame ends dropped because the frame queue was full
+    };
+
+    explicit VirtualUARTLink(uint32_t baudrate = 115200, uint8_t bitsPerChar = 10) : _baudrate(baudrate), _bitsPerChar(bitsPerChar) {}
+
+    /**
+     * @brief Change the line settings. Bytes on the line are completed with the new timing.
+     * @param baudrate Baudrate in bit/s.
+     * @param bitsPerChar Bits per character including start, parity and stop bits, e.g. 10 for 8N1.
+     */
+    void configure(uint32_t baudrate, uint8_t bitsPerChar = 10) {
+        if(baudrate > 0) _baudrate = baudrate;
+        if(bitsPerChar > 0) _bitsPerChar = bitsPerChar;
+    }
+
+    uint32_t getBaudrate() const { return _baudrate; }
+    uint8_t getBitsPerChar() const { return _bitsPerChar; }
+    uint64_t charTimeNs() const { return uint64_t(_bitsPerChar) * 1000000000ULL / _baudrate; }
+
+    /**
+     * @brief Limit the buffer sizes of an endpoint. Buffered bytes beyond the new size are kept.
+     */
+    void setBufferSizes(uint8_t endpoint, size_t txSize, size_t rxSize) {
+        if(endpoint >= ENDPOINTS) return;
+        _endpoints[endpoint].txSize = txSize < BUFFER_SIZE ? txSize : BUFFER_SIZE;
+        _endpoints[endpoint].rxSize = rxSize < BUFFER_SIZE ? rxSize : BUFFER_SIZE;
+    }
+
+    /**
+     * @brief Queue bytes for transmission.
+     * @return size_t Number of bytes accepted, limited by the free transmit buffer.
+     */
+    size_t write(uint8_t endpoint, const uint8_t* data, size_t length) {
+        if(endpoint >= ENDPOINTS) return 0;
+        Endpoint& e = _endpoints[endpoint];
+        size_t count = 0;
+        while(count < length && e.tx.count < e.txSize) {
+            if(e.tx.count == 0) e.nextByteNs = _nowNs + charTimeNs();
+            e.tx.push(data[count++]);
+        }
+        if(count > 0) e.statistics.writes++;
+        return count;
+    }
+
+    /**
+     * @brief Read received bytes.
+     * @return size_t Number of bytes copied to the buffer, at most size.
+     */
+    size_t read(uint8_t endpoint, uint8_t* buffer, size_t size) {
+        if(endpoint >= ENDPOINTS) return 0;
+        Fifo& rx = _endpoints[endpoint].rx;
+        size_t count = 0;
+        while(count < size && rx.count > 0) buffer[count++] = rx.pop();
+        _endpoints[endpoint].readPosition += count;
+        return count;
+    }
+
+    /**
+     * @brief Get the oldest received bytes in place.
+     * @return size_t Number of contiguous bytes at data, the remaining bytes follow after consume().
+     */
+    size_t peek(uint8_t endpoint, const uint8_t*& data) const {
+        data = nullptr;
+        if(endpoint >= ENDPOINTS) return 0;
+        const Fifo& rx = _endpoints[endpoint].rx;
+        data = &rx.data[rx.head];
+        return rx.count < BUFFER_SIZE - rx.head ? rx.count : BUFFER_SIZE - rx.head;
+    }
+
+    /**
+     * @brief Remove received bytes after peek().
+     */
+    void consume(uint8_t endpoint, size_t length) {
+        if(endpoint >= ENDPOINTS) return;
+        Fifo& rx = _endpoints[endpoint].rx;
+        if(length > rx.count) length = rx.count;
+        rx.head = (rx.head + length) % BUFFER_SIZE;
+        rx.count -= length;
+        _endpoints[endpoint].readPosition += length;
+    }
+
+    size_t available(uint8_t endpoint) const { return endpoint < ENDPOINTS ? _endpoints[endpoint].rx.count : 0; }
+    size_t txPending(uint8_t endpoint) const { return endpoint < ENDPOINTS ? _endpoints[endpoint].tx.count : 0; }
+    size_t txFree(uint8_t endpoint) const {
+        if(endpoint >= ENDPOINTS || _endpoints[endpoint].tx.count >= _endpoints[endpoint].txSize) return 0;
+        return _endpoints[endpoint].txSize - _endpoints[endpoint].tx.count;
+    }
+
+    /**
+     * @brief Discard the received bytes of an endpoint.
+     */
+    void flushInput(uint8_t endpoint) {
+        if(endpoint >= ENDPOINTS) return;
+        _endpoints[endpoint].readPosition += _endpoints[endpoint].rx.count;
+        _endpoints[endpoint].rx.count = 0;
+    }
+
+    /**
+     * @brief Switch the pattern detection of an endpoint on or off.
+     * @details Bytes already in the receive buffer are checked as well, so frames received before are reported too.
+     * @param character Pattern character.
+     * @param count Number of consecutive pattern characters.
+     */
+    void setPatternDetection(uint8_t endpoint, bool enabled, uint8_t character = '\n', uint8_t count = 1) {
+        if(endpoint >= ENDPOINTS) return;
+        Endpoint& e = _endpoints[endpoint];
+        e.patternDetection = enabled;
+        e.detector.configure(character, count);
+        e.frameCount = 0;
+        e.readPosition = 0;
+        e.rxPosition = 0;
+        if(!enabled) return;
+        for(size_t i=0; i<e.rx.count; i++) detectPattern(e, e.rx.data[(e.rx.head + i) % BUFFER_SIZE]);
+    }
+
+    /**
+     * @brief Get the length of the oldest complete frame in the receive buffer of an endpoint.
+     * @return size_t Bytes up to and including the next pattern, 0 if there is none.
+     */
+    size_t nextFrameLength(uint8_t endpoint) {
+        if(endpoint >= ENDPOINTS) return 0;
+        Endpoint& e = _endpoints[endpoint];
+        while(e.frameCount > 0) {
+            int32_t distance = int32_t(e.frameEnds[e.frameHead] - e.readPosition);
+            if(distance > 0) return distance;
+            e.frameHead = (e.frameHead + 1) % FRAME_QUEUE_SIZE;
+            e.frameCount--;
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Advance the simulated time.
+     * @param durationUs Time to simulate in microseconds.
+     */
+    void run(uint64_t durationUs) {
+        uint64_t endNs = _nowNs + durationUs * 1000;
+        for(uint8_t i=0; i<ENDPOINTS; i++) {
+            Endpoint& tx = _endpoints[i];
+            Endpoint& rx = _endpoints[i ^ 1];
+            while(tx.tx.count > 0 && tx.nextByteNs <= endNs) {
+                uint8_t byte = tx.tx.pop();
+                tx.statistics.txBytes++;
+                if(rx.rx.count < rx.rxSize) {
+                    rx.rx.push(byte);
+                    rx.statistics.rxBytes++;
+                    if(rx.patternDetection) detectPattern(rx, byte);
+                } else {
+                    rx.statistics.rxOverruns++;
+                }
+                tx.nextByteNs += charTimeNs();
+            }
+        }
+        _nowNs = endNs;
+    }
+
+    uint64_t now() const { return _nowNs / 1000; }
+
+    const EndpointStatistics& getStatistics(uint8_t endpoint) const { return _endpoints[endpoint < ENDPOINTS ? endpoint : 0].statistics; }
+
+    void resetStatistics() {
+        for(uint8_t i=0; i<ENDPOINTS; i++) _endpoints[i].statistics = {};
+    }
+
+private:
+    struct Fifo {
+        uint8_t     data[BUFFER_SIZE];
+        size_t      head = 0;
+        size_t      count = 0;
+
+        void push(uint8_t byte) {
+            data[(head + count) % BUFFER_SIZE] = byte;
+            count++;
+        }
+        uint8_t pop() {
+            uint8_t byte = data[head];
+            head = (head + 1) % BUFFER_SIZE;
+            count--;
+            return byte;
+        }
+    };
+
+    struct Endpoint {
+        Fifo        tx;
+        Fifo        rx;
+        size_t      txSize = BUFFER_SIZE;
+        size_t      rxSize = BUFFER_SIZE;
+        uint64_t    nextByteNs = 0;     // Time the byte on the line is completed
+        EndpointStatistics statistics = {};
+        bool        patternDetection = false;
+        UARTPatternDetector detector;
+        uint32_t    frameEnds[FRAME_QUEUE_SIZE];    // Stream positions after each detected pattern
+        size_t      frameHead = 0;
+        size_t      frameCount = 0;
+        uint32_t    rxPosition = 0;     // Stream position of the next byte stored in the receive buffer
+        uint32_t    readPosition = 0;   // Stream position of the next byte read from the receive buffer
+    };
+
+    /**
+     * @brief Check a byte stored in the receive buffer for the pattern and queue the frame end.
+     */
+    static void detectPattern(Endpoint& e, uint8_t byte) {
+        e.rxPosition++;
+        if(!e.detector.detect(byte)) return;
+        e.statistics.patterns++;
+        if(e.frameCount >= FRAME_QUEUE_SIZE) {
+            e.statistics.patternsDropped++;
+            return;
+        }
+        e.frameEnds[(e.frameHead + e.frameCount) % FRAME_QUEUE_SIZE] = e.rxPosition;
+        e.frameCount++;
+    }
+
+    uint32_t _baudrate;
+    uint8_t _bitsPerChar;
+    uint64_t _nowNs = 0;
+    Endpoint _endpoints[ENDPOINTS];
+};
+
+#endif // VIRTUALUARTLINK_H
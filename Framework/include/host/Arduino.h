@@ -0,0 +1,130 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#ifdef ARDUINO
+#error "include/host is for host builds only, remove it from the include path of Arduino builds"
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <chrono>
+#include <string>
+#include <thread>
+
+/**
+ * @file Arduino.h
+ * @brief Minimal Arduino API for host builds on Linux.
+ * @details Provides the parts of the Arduino framework used by the framework classes which are not tied to ESP32 hardware,
+ *          e.g. CANCore, CANInterface, SocketCANCore and the logging macros of Debug.h: String, Serial (printing to stdout),
+ *          micros(), millis(), delay() and delayMicroseconds(). Host builds add include/host to the include path, so
+ *          #include <Arduino.h> resolves to this file. Like on the ESP32, micros() and millis() are 32-bit and wrap around.
+ */
+
+#define HEX 16
+#define DEC 10
+#define BIN 2
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+/**
+ * @class String
+ * @brief Arduino String on top of std::string, with the constructors and concatenations used by the logging macros.
+ */
+class String {
+public:
+    String() = default;
+    String(const char* text) : _text(text ? text : "") {}
+    String(const std::string& text) : _text(text) {}
+    String(char c) : _text(1, c) {}
+    String(int value, int base = DEC) : _text(format(static_cast<long long>(value), base)) {}
+    String(unsigned int value, int base = DEC) : _text(format(static_cast<unsigned long long>(value), base)) {}
+    String(long value, int base = DEC) : _text(format(static_cast<long long>(value), base)) {}
+    String(unsigned long value, int base = DEC) : _text(format(static_cast<unsigned long long>(value), base)) {}
+    String(long long value, int base = DEC) : _text(format(value, base)) {}
+    String(unsigned long long value, int base = DEC) : _text(format(value, base)) {}
+    String(double value, unsigned int decimals = 2) {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+        _text = buffer;
+    }
+
+    const char* c_str() const { return _text.c_str(); }
+    size_t length() const { return _text.length(); }
+    bool isEmpty() const { return _text.empty(); }
+    long toInt() const { return strtol(_text.c_str(), nullptr, 10); }
+    int indexOf(const String& text) const {
+        size_t position = _text.find(text._text);
+        return position == std::string::npos ? -1 : int(position);
+    }
+    bool startsWith(const String& text) const { return _text.compare(0, text._text.length(), text._text) == 0; }
+    char operator[](size_t index) const { return index < _text.length() ? _text[index] : 0; }
+
+    String& operator+=(const String& other) { _text += other._text; return *this; }
+    friend String operator+(const String& left, const String& right) { return String(left._text + right._text); }
+    friend bool operator==(const String& left, const String& right) { return left._text == right._text; }
+    friend bool operator!=(const String& left, const String& right) { return left._text != right._text; }
+
+private:
+    static std::string format(unsigned long long value, int base) {
+        if(base != HEX && base != BIN) return std::to_string(value);
+        std::string digits;
+        do {
+            digits.insert(digits.begin(), "0123456789ABCDEF"[value % base]);
+            value /= base;
+        } while(value > 0);
+        return digits;
+    }
+    static std::string format(long long value, int base) {
+        //Like Arduino, negative values are printed in two's complement for HEX and BIN
+        if(base == HEX || base == BIN) return format(static_cast<unsigned long long>(static_cast<unsigned long>(value)), base);
+        return std::to_string(value);
+    }
+
+    std::string _text;
+};
+
+/**
+ * @class HostSerial
+ * @brief Serial port printing to stdout.
+ */
+class HostSerial {
+public:
+    void begin(unsigned long) {}
+    void end() {}
+    explicit operator bool() const { return true; }
+    size_t print(const String& text) { return fwrite(text.c_str(), 1, text.length(), stdout); }
+    size_t println(const String& text) { return print(text) + println(); }
+    size_t println() { return fwrite("\n", 1, 1, stdout); }
+    size_t write(const uint8_t* data, size_t length) { return fwrite(data, 1, length, stdout); }
+    template<typename... Args>
+    int printf(const char* format, Args... args) { return ::printf(format, args...); }
+    void flush() { fflush(stdout); }
+};
+
+static HostSerial Serial;
+
+/**
+ * @brief Microseconds since the start of the program on the monotonic clock, wrapping after 71 minutes.
+ */
+inline uint32_t micros() {
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline uint32_t millis() {
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline void delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+inline void delayMicroseconds(uint32_t us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+inline void yield() { std::this_thread::yield(); }
+
+#endif // HOST_ARDUINO_H
@@ -186,6 +186,15 @@ bool BusModuleV1_0::requestHardwareResources()
  */
 void BusModuleV1_0::cycle(uint8_t *response)
 {
+    if(_modbusMasterEnabled){
+        _modbusMaster.cycle(micros());
+    }
+    if(_modbusSlave.isRunning() && !_modbusSlave.isEventDriven()){
+        _modbusSlave.process();
+    }
+    if(_telemetry.isRunning()){
+        _telemetry.cycle(micros());
+    }
     if(_loopFunction){
         _loopFunction(response);
         DEBUG_PRINTLN("[BusModuleV1_0] Executed callback loop function of BusModuleV1_0.");
@@ -240,6 +249,154 @@ bool BusModuleV1_0::addI2CInterface()
     return true;
 }
 
+/**
+ * @brief Forward CAN traffic through the UART interface, see CANUARTGateway.
+ * @details Call after the module was attached and before CANTramCore::initialize(), the baudrate is applied when the UART is started.
+ *          The gateway runs in CANInterface::process() of the given interface, e.g. in the cycle of the MainModule.
+ * @param canInterface CAN interface to bridge.
+ * @param baudrate UART baudrate.
+ * @return true if the gateway was started.
+ */
+bool BusModuleV1_0::enableGateway(CANInterface* canInterface, uint32_t baudrate)
+{
+    if(!claimUART("gateway"))
+    {
+        return false;
+    }
+    _uartInterface.setBaudrate(baudrate);
+    if(!_gateway.begin(canInterface, &_uartInterface))
+    {
+        ERROR_PRINTLN("[BusModuleV1_0] ERROR: Failed to start the CAN gateway.");
+        return false;
+    }
+    INFO_PRINTLN("[BusModuleV1_0] INFO: CAN gateway enabled at " + String(baudrate) + " baud.");
+    return true;
+}
+
+/**
+ * @brief Stop forwarding CAN traffic through the UART interface.
+ */
+void BusModuleV1_0::disableGateway()
+{
+    _gateway.end();
+}
+
+/**
+ * @brief Run a Modbus RTU master on the UART interface, see ModbusRTUMaster.
+ * @details Configure the polls with getModbusMaster().addPoll() and read the results from its register image. The master runs in
+ *          the cycle of the module, before the loop function, and never waits for the bus. Cannot be used together with the gateway.
+ * @param baudrate UART baudrate.
+ * @param parity UART parity, the Modbus default is even parity.
+ * @return true if the master was started.
+ */
+bool BusModuleV1_0::enableModbusMaster(uint32_t baudrate, UARTCore::Parity parity)
+{
+    if(!claimUART("Modbus master"))
+    {
+        return false;
+    }
+    configureModbusUART(baudrate, parity);
+    _modbusMaster.begin(baudrate);
+    _modbusMasterEnabled = true;
+    INFO_PRINTLN("[BusModuleV1_0] INFO: Modbus RTU master enabled at " + String(baudrate) + " baud.");
+    return true;
+}
+
+/**
+ * @brief Expose the interfaces of all attached modules as Modbus RTU slave on the UART interface, see ModbusRTUSlave.
+ * @details Call after all modules were attached and before CANTramCore::initialize(), so the slave answers in the receive task
+ *          of the UART independent of the module cycle. Cannot be used together with the gateway or the Modbus master.
+ * @param slaveId Slave address (1..247).
+ * @param baudrate UART baudrate.
+ * @param parity UART parity, the Modbus default is even parity.
+ * @return true if the slave was started.
+ */
+bool BusModuleV1_0::enableModbusSlave(uint8_t slaveId, uint32_t baudrate, UARTCore::Parity parity)
+{
+    if(!claimUART("Modbus slave"))
+    {
+        return false;
+    }
+    configureModbusUART(baudrate, parity);
+    _modbusSlave.end();
+    _modbusSlave.clear();
+    _modbusSlave.setSlaveId(slaveId);
+    if(!_modbusSlave.populate())
+    {
+        WARNING_PRINTLN("[BusModuleV1_0] WARNING: Not all interfaces fit into the Modbus tables.");
+    }
+    if(!_modbusSlave.begin(&_uartInterface, baudrate))
+    {
+        ERROR_PRINTLN("[BusModuleV1_0] ERROR: Failed to start the Modbus slave.");
+        return false;
+    }
+    INFO_PRINTLN("[BusModuleV1_0] INFO: Modbus RTU slave " + String(slaveId) + " enabled at " + String(baudrate) + " baud.");
+    return true;
+}
+
+/**
+ * @brief Stream interface values and metrics as binary telemetry over the UART interface, see TelemetryPublisher.
+ * @details Add the signals with getTelemetry().addInterface() and getTelemetry().addMetric(). The publisher runs in the cycle of
+ *          the module, call it at least once per sample period. Cannot be used together with the gateway or a Modbus role.
+ * @param periodUs Sample period of signals with decimation 1.
+ * @param baudrate UART baudrate.
+ * @return true if the publisher was started.
+ */
+bool BusModuleV1_0::enableTelemetry(uint32_t periodUs, uint32_t baudrate)
+{
+    if(!claimUART("telemetry"))
+    {
+        return false;
+    }
+    _uartInterface.setBaudrate(baudrate);
+    if(!_telemetry.begin(&_uartInterface, periodUs))
+    {
+        ERROR_PRINTLN("[BusModuleV1_0] ERROR: Failed to start the telemetry publisher.");
+        return false;
+    }
+    INFO_PRINTLN("[BusModuleV1_0] INFO: Telemetry enabled at " + String(baudrate) + " baud, sample period " + String(periodUs) + " us.");
+    return true;
+}
+
+/**
+ * @brief Check that the UART interface is valid and not used by the gateway, a Modbus role or the telemetry publisher.
+ * @param user Function requesting the UART, for the error message.
+ * @return true if the UART can be used.
+ */
+bool BusModuleV1_0::claimUART(const String& user)
+{
+    if(_uartInterface.isInvalid() || _uartInterface.getUartCore() == nullptr)
+    {
+        ERROR_PRINTLN("[BusModuleV1_0] ERROR: UART interface is invalid, " + user + " cannot be used.");
+        return false;
+    }
+    if(_gateway.isRunning() || _modbusMasterEnabled || _modbusSlave.isRunning() || _telemetry.isRunning())
+    {
+        ERROR_PRINTLN("[BusModuleV1_0] ERROR: UART is already in use, " + user + " cannot be used.");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Set the character format for Modbus RTU: 8 data bits with parity and one stop bit, or without parity and two stop bits.
+ * @details Also lowers the FIFO thresholds of the UART. With the default RX timeout of 10 characters the last bytes of a frame
+ *          become readable more than T3.5 after its end, which delays every response of the slave and every poll of the master.
+ */
+void BusModuleV1_0::configureModbusUART(uint32_t baudrate, UARTCore::Parity parity)
+{
+    _uartInterface.setBaudrate(baudrate);
+    _uartInterface.setParity(parity);
+    _uartInterface.setStopBits(parity == UARTCore::UART_PARITY_NONE ? UARTCore::UART_STOP_BITS_2 : UARTCore::UART_STOP_BITS_1);
+    UARTCore::FifoConfig fifo;
+    fifo.rxFullThreshold = MODBUS_RX_FULL_THRESHOLD;
+    fifo.rxTimeoutSymbols = MODBUS_RX_TIMEOUT_SYMBOLS;
+    if(!_uartInterface.setFifoConfig(fifo))
+    {
+        WARNING_PRINTLN("[BusModuleV1_0] WARNING: UART core does not support FIFO thresholds, Modbus frames are delayed by the default RX timeout.");
+    }
+}
+
 bool BusModuleV1_0::addSPIDevice(SPIChip* spiDevice, bool allowOverride)
 {
     if(spiDevice == nullptr)
@@ -275,7 +432,7 @@ bool BusModuleV1_0::preInitialize()
     if(!_uartInterface.isInvalid())
     {
         DEBUG_PRINTLN("[BusModuleV1_0] Pre-Initializing UART interface...");
-        result &= _uartInterface.getUartCore()->setPins(UART_RX_PIN->pinOrBit, UART_TX_PIN->pinOrBit);
+        result &= _uartInterface.getUartCore()->setPins(UART_TX_PIN->pinOrBit, UART_RX_PIN->pinOrBit);
         if(result)
             _uartInterface.validate();
         else
@@ -312,6 +469,10 @@ bool BusModuleV1_0::reset()
     bool result = true;
 
     _loopFunction = nullptr;
+    _gateway.end();
+    _modbusMasterEnabled = false;
+    _modbusSlave.end();
+    _telemetry.end();
     UART_RX_PIN = nullptr;
     UART_TX_PIN = nullptr;
     SPI_CS_PIN = nullptr;
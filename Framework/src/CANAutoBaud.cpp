@@ -0,0 +1,162 @@
+#include "CANAutoBaud.h"
+#include "Debug.h"
+
+CANAutoBaud::CANAutoBaud() {
+    const CANCore::Baudrate candidates[] = {CANCore::BR_125K, CANCore::BR_250K, CANCore::BR_500K, CANCore::BR_1M};
+    setCandidates(candidates, 4);
+}
+
+/**
+ * @brief Set the baudrates to try, in the order given.
+ *
+ * @param candidates Baudrates, BR_NOT_SET is not allowed.
+ * @param count Number of candidates, 1 to MAX_CANDIDATES.
+ * @return false if the list is invalid or a detection is running.
+ */
+bool CANAutoBaud::setCandidates(const CANCore::Baudrate* candidates, uint8_t count) {
+    if(_state == LISTENING || candidates == nullptr || count == 0 || count > MAX_CANDIDATES) {
+        ERROR_PRINTLN("[CANAutoBaud] Invalid candidate list or detection running.");
+        return false;
+    }
+    for(uint8_t i=0; i<count; i++) {
+        if(candidates[i] == CANCore::BR_NOT_SET) return false;
+        _candidates[i] = candidates[i];
+    }
+    _candidateCount = count;
+    return true;
+}
+
+/**
+ * @brief Start the detection.
+ * @details Stops the core and restarts it in listen-only mode. If the baudrate configured in the core is a candidate, it is tried first.
+ *          The detection continues with poll().
+ *
+ * @param core CAN core connected to the bus.
+ * @param timeoutMs Maximum detection time.
+ * @return true if the core was started in listen-only mode.
+ */
+bool CANAutoBaud::begin(CANCore* core, uint32_t timeoutMs) {
+    if(core == nullptr) {
+        ERROR_PRINTLN("[CANAutoBaud] No CAN core assigned.");
+        return false;
+    }
+    _core = core;
+    _previousBaudrate = core->getBaudrate();
+    _timeoutMs = timeoutMs;
+    _errors = 0;
+    _switches = 0;
+    _detectionTimeMs = 0;
+    uint8_t first = 0;
+    for(uint8_t i=0; i<_candidateCount; i++) {
+        if(_candidates[i] == core->getBaudrate()) first = i;
+    }
+    _start = millis();
+    if(!listen(first)) {
+        finish(FAILED);
+        return false;
+    }
+    _state = LISTENING;
+    INFO_PRINTLN("[CANAutoBaud] Detecting baudrate, starting with " + String(uint32_t(_candidates[first])) + " bps.");
+    return true;
+}
+
+/**
+ * @brief Continue the detection. Call it regularly until the state is no longer LISTENING.
+ *
+ * @return State Current state.
+ */
+CANAutoBaud::State CANAutoBaud::poll() {
+    if(_state != LISTENING) return _state;
+
+    _core->available();     // Updates the statistics of cores which do it on access
+    CANFrame frame;
+    while(_core->readFrame(frame)) {
+        if(!frame.isError()) _validFrames++;
+    }
+    _candidateErrors = _core->getStatistics().busErrors;
+
+    uint32_t now = millis();
+    if(_validFrames >= _requiredFrames) {
+        _detectionTimeMs = now - _start;
+        CANCore::Baudrate baudrate = _candidates[_candidate];
+        _core->end();
+        _core->setListenOnly(false);
+        _core->setBaudrate(baudrate);
+        if(!_core->begin()) {
+            ERROR_PRINTLN("[CANAutoBaud] Failed to start the CAN core at the detected baudrate.");
+            _state = FAILED;
+            return _state;
+        }
+        _state = LOCKED;
+        INFO_PRINTLN("[CANAutoBaud] Baudrate " + String(uint32_t(baudrate)) + " bps detected after " + String(_detectionTimeMs) + " ms.");
+        return _state;
+    }
+    if(now - _start >= _timeoutMs) {
+        _errors += _candidateErrors;
+        finish(_errors > 0 ? FAILED : NO_TRAFFIC);
+        return _state;
+    }
+    if(now - _candidateStart >= _dwellMs || (_validFrames == 0 && _candidateErrors >= ERROR_SWITCH_THRESHOLD)) {
+        _errors += _candidateErrors;
+        _switches++;
+        if(!listen((_candidate + 1) % _candidateCount)) finish(FAILED);
+    }
+    return _state;
+}
+
+/**
+ * @brief Run the detection until it is finished. Blocks for at most the timeout.
+ *
+ * @param core CAN core connected to the bus.
+ * @param timeoutMs Maximum detection time.
+ * @return State LOCKED, NO_TRAFFIC or FAILED.
+ */
+CANAutoBaud::State CANAutoBaud::detect(CANCore* core, uint32_t timeoutMs) {
+    if(!begin(core, timeoutMs)) return _state;
+    while(poll() == LISTENING) {
+        delay(1);
+    }
+    return _state;
+}
+
+/**
+ * @brief Abort a running detection and stop the core.
+ */
+void CANAutoBaud::end() {
+    if(_state != LISTENING) return;
+    finish(IDLE);
+}
+
+/**
+ * @brief Restart the core in listen-only mode at a candidate baudrate.
+ */
+bool CANAutoBaud::listen(uint8_t candidate) {
+    _candidate = candidate;
+    _validFrames = 0;
+    _candidateErrors = 0;
+    _candidateStart = millis();
+    if(_core->isInitialized()) _core->end();
+    _core->setListenOnly(true);
+    _core->setBaudrate(_candidates[candidate]);
+    if(!_core->begin()) {
+        ERROR_PRINTLN("[CANAutoBaud] Failed to start the CAN core in listen-only mode.");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Stop the core after an unsuccessful detection and restore its previous baudrate.
+ */
+void CANAutoBaud::finish(State state) {
+    _detectionTimeMs = millis() - _start;
+    if(_core->isInitialized()) _core->end();
+    _core->setListenOnly(false);
+    _core->setBaudrate(_previousBaudrate);
+    _state = state;
+    if(state == NO_TRAFFIC) {
+        WARNING_PRINTLN("[CANAutoBaud] No traffic within " + String(_detectionTimeMs) + " ms. Baudrate unknown.");
+    } else if(state == FAILED) {
+        ERROR_PRINTLN("[CANAutoBaud] " + String(_errors) + " bus errors, but no valid frame at any baudrate within " + String(_detectionTimeMs) + " ms.");
+    }
+}
@@ -0,0 +1,109 @@
+#include "CANRecorder.h"
+#include "Debug.h"
+
+/**
+ * @brief Start recording the traffic of a CAN interface.
+ * @details Writes the log header to the sink and registers the recorder as listener at the interface.
+ *
+ * @param canInterface Interface to record.
+ * @param sink Destination of the log data.
+ * @return true if recording was started.
+ */
+bool CANRecorder::begin(CANInterface* canInterface, Sink sink) {
+    if(canInterface == nullptr || canInterface->getCANCore() == nullptr) {
+        ERROR_PRINTLN("[CANRecorder] No CAN interface or CAN core assigned.");
+        return false;
+    }
+    if(!sink) {
+        ERROR_PRINTLN("[CANRecorder] No sink assigned.");
+        return false;
+    }
+    uint8_t header[CANLog::HEADER_SIZE];
+    CANLog::encodeHeader(canInterface->getCANCore()->getBaudrate(), header);
+    if(sink(header, sizeof(header)) != sizeof(header)) {
+        ERROR_PRINTLN("[CANRecorder] Failed to write the log header.");
+        return false;
+    }
+    if(!canInterface->addListener(this)) {
+        return false;
+    }
+    _canInterface = canInterface;
+    _sink = sink;
+    _fill = 0;
+    _lastFlush = millis();
+    _recordCount = 0;
+    _droppedCount = 0;
+    _bytesWritten = sizeof(header);
+    return true;
+}
+
+/**
+ * @brief Stop recording and write the buffered records to the sink.
+ */
+void CANRecorder::end() {
+    if(_canInterface == nullptr) return;
+    _canInterface->removeListener(this);
+    _canInterface = nullptr;
+    if(!flush()) {
+        WARNING_PRINTLN("[CANRecorder] " + String(_fill) + " bytes could not be written.");
+    }
+    _fill = 0;
+}
+
+/**
+ * @brief Append a frame to the log.
+ * @details If the buffer is full, it is flushed first. If the sink does not accept the data, the record is dropped.
+ *
+ * @param message Frame to record.
+ * @param direction RX for received frames, TX for sent frames.
+ * @param timestamp Time of the frame in microseconds.
+ * @return true if the record was buffered.
+ */
+bool CANRecorder::record(const CANCore::CANMessage& message, CANLog::Direction direction, uint32_t timestamp) {
+    if(_canInterface == nullptr) return false;
+    if(BUFFER_SIZE - _fill < CANLog::MAX_RECORD_SIZE) {
+        flush();
+        if(BUFFER_SIZE - _fill < CANLog::MAX_RECORD_SIZE) {
+            _droppedCount++;
+            return false;
+        }
+    }
+    CANFrame frame = CANCore::toFrame(message, 0);
+    CANLog::Record entry;
+    entry.timestamp = timestamp;
+    entry.idFlags = frame.idFlags;
+    entry.length = frame.getLength();
+    entry.direction = direction;
+    memcpy(entry.data, frame.data, sizeof(entry.data));
+    _fill += CANLog::encodeRecord(entry, &_buffer[_fill]);
+    _recordCount++;
+    return true;
+}
+
+/**
+ * @brief Hand the buffered records to the sink.
+ * @return true if the buffer is empty afterwards.
+ */
+bool CANRecorder::flush() {
+    _lastFlush = millis();
+    if(_fill == 0) return true;
+    size_t written = _sink(_buffer, _fill);
+    if(written > _fill) written = _fill;
+    _bytesWritten += written;
+    _fill -= written;
+    if(_fill > 0) memmove(_buffer, &_buffer[written], _fill);
+    return _fill == 0;
+}
+
+bool CANRecorder::onMessage(const CANCore::CANMessage& message) {
+    record(message, CANLog::RX, _canInterface->getRxTimestamp());
+    return false;
+}
+
+void CANRecorder::onTransmit(const CANCore::CANMessage& message) {
+    if(_recordTransmitted) record(message, CANLog::TX, micros());
+}
+
+void CANRecorder::cycle() {
+    if(_fill > 0 && millis() - _lastFlush >= FLUSH_INTERVAL_MS) flush();
+}
@@ -0,0 +1,280 @@
+#include "CANReplayCore.h"
+#include "Debug.h"
+
+/**
+ * @brief Assign the log to play back.
+ * @details The log is read in place and must stay valid while the core is in use. The baudrate is taken from the log header.
+ *
+ * @param log Log data as written by CANRecorder, starting with the header.
+ * @param length Length of the log in bytes.
+ * @return true if the header is valid.
+ */
+bool CANReplayCore::setLog(const uint8_t* log, size_t length) {
+    uint32_t baudrate = 0;
+    if(log == nullptr || !CANLog::decodeHeader(log, length, baudrate)) {
+        ERROR_PRINTLN("[CANReplayCore] Invalid log header.");
+        return false;
+    }
+    _log = log;
+    _reader = nullptr;
+    _length = length;
+    _baudrate = Baudrate(baudrate);
+    rewind();
+    return true;
+}
+
+/**
+ * @brief Assign a reader for the log to play back, e.g. for a log file larger than the RAM.
+ * @details The log is read in windows of WINDOW_SIZE bytes, available() and readFrame() call the reader when the playback
+ *          leaves the window. The baudrate is taken from the log header.
+ *
+ * @param reader Function reading the log data as written by CANRecorder, starting with the header at offset 0.
+ * @param length Length of the log in bytes.
+ * @return true if the header is valid.
+ */
+bool CANReplayCore::setSource(Reader reader, size_t length) {
+    uint8_t header[CANLog::HEADER_SIZE];
+    uint32_t baudrate = 0;
+    if(!reader || reader(0, header, sizeof(header)) != sizeof(header) || !CANLog::decodeHeader(header, length, baudrate)) {
+        ERROR_PRINTLN("[CANReplayCore] Invalid log header.");
+        return false;
+    }
+    _log = nullptr;
+    _reader = reader;
+    _length = length;
+    _windowStart = 0;
+    _windowLength = 0;
+    _baudrate = Baudrate(baudrate);
+    rewind();
+    return true;
+}
+
+/**
+ * @brief Play back a log file, see setSource().
+ * @details The file must stay open while the core is in use. It is read with fseek()/fread(), so it works with files on the host
+ *          as well as with files of a mounted file system on the ESP32.
+ *
+ * @param file Log file opened for binary reading.
+ * @return true if the header is valid.
+ */
+bool CANReplayCore::setLogFile(FILE* file) {
+    if(file == nullptr || fseek(file, 0, SEEK_END) != 0) {
+        ERROR_PRINTLN("[CANReplayCore] Log file cannot be read.");
+        return false;
+    }
+    long length = ftell(file);
+    if(length < 0) {
+        ERROR_PRINTLN("[CANReplayCore] Log file cannot be read.");
+        return false;
+    }
+    return setSource([file](size_t offset, uint8_t* buffer, size_t count) -> size_t {
+        if(fseek(file, long(offset), SEEK_SET) != 0) return 0;
+        return fread(buffer, 1, count, file);
+    }, size_t(length));
+}
+
+/**
+ * @brief Start the playback from the beginning of the log.
+ *
+ * @return true if a log is assigned.
+ */
+bool CANReplayCore::begin() {
+    if(_log == nullptr && !_reader) {
+        ERROR_PRINTLN("[CANReplayCore] No log assigned. Call setLog(), setLogFile() or setSource() before begin().");
+        return false;
+    }
+    rewind();
+    _statistics = {};
+    _replayedCount = 0;
+    _isInitialized = true;
+    return true;
+}
+
+bool CANReplayCore::setBaudrate(Baudrate baudrate) {
+    _baudrate = baudrate;
+    return true;
+}
+
+bool CANReplayCore::setPins(int8_t txPin, int8_t rxPin) {
+    _txPin = txPin;
+    _rxPin = rxPin;
+    return true;
+}
+
+bool CANReplayCore::end() {
+    _isInitialized = false;
+    return true;
+}
+
+/**
+ * @brief Accept a frame for transmission. The frame is counted and discarded.
+ */
+bool CANReplayCore::sendMessage(const CANMessage&) {
+    if(!_isInitialized) {
+        ERROR_PRINTLN("[CANReplayCore] Replay not started. Cannot send message.");
+        return false;
+    }
+    _statistics.txFrames++;
+    return true;
+}
+
+bool CANReplayCore::readMessage(CANMessage& message) {
+    CANFrame frame;
+    if(!readFrame(frame)) {
+        message.error = true;
+        return false;
+    }
+    fromFrame(frame, message);
+    return true;
+}
+
+/**
+ * @brief Read the next frame whose playback time is reached.
+ * @details The timestamp of the frame is the playback time mapped to micros(), so receive timestamps keep the recorded
+ *          spacing (divided by the speed factor).
+ *
+ * @param frame Destination of the frame.
+ * @return true if a frame was read.
+ */
+bool CANReplayCore::readFrame(CANFrame& frame) {
+    if(!_isInitialized) return false;
+    updateClock();
+    if(_loop && _cursor.position >= _length) rewind();
+
+    Cursor cursor = _cursor;
+    CANLog::Record record;
+    if(!next(cursor, record)) {
+        _cursor = cursor;   // Skip trailing filtered records
+        return false;
+    }
+    uint64_t dueUs = getDueTime(cursor);
+    if(dueUs > _playbackUs) return false;
+
+    _cursor = cursor;
+    frame.idFlags = record.idFlags;
+    frame.dlcTimestamp = uint32_t(record.length) << 28;
+    frame.setTimestamp(_startMicros + uint32_t(dueUs));
+    memcpy(frame.data, record.data, sizeof(frame.data));
+    _statistics.rxFrames++;
+    _replayedCount++;
+    return true;
+}
+
+/**
+ * @brief Get the number of frames whose playback time is reached.
+ * @return uint8_t Number of due frames, at most AVAILABLE_SCAN_LIMIT.
+ */
+uint8_t CANReplayCore::available() {
+    if(!_isInitialized) return 0;
+    updateClock();
+    if(_loop && _cursor.position >= _length) rewind();
+
+    Cursor cursor = _cursor;
+    CANLog::Record record;
+    uint8_t count = 0;
+    bool found = true;
+    while(count < AVAILABLE_SCAN_LIMIT && (found = next(cursor, record)) && getDueTime(cursor) <= _playbackUs) {
+        count++;
+    }
+    if(count == 0 && !found) _cursor = cursor;     // Skip trailing filtered records, so isFinished() becomes true
+    return count;
+}
+
+/**
+ * @brief Only play back frames matching the filter.
+ * @details A frame passes if (frameId & mask) == (id & mask).
+ */
+bool CANReplayCore::setupFilter(uint32_t id, uint32_t mask) {
+    _filterId = id;
+    _filterMask = mask;
+    _filterType = FILTER_MASKED;
+    return true;
+}
+
+/**
+ * @brief Advance the cursor to the next record which passes the filter.
+ *
+ * @param cursor Cursor to advance. Points behind the returned record afterwards.
+ * @param record The record found.
+ * @return true if a record was found, false at the end of the log or at a truncated record.
+ */
+bool CANReplayCore::next(Cursor& cursor, CANLog::Record& record) {
+    while(cursor.position < _length) {
+        size_t available = 0;
+        const uint8_t* data = fetch(cursor.position, available);
+        size_t size = data ? CANLog::decodeRecord(data, available, record) : 0;
+        if(size == 0) {
+            cursor.position = _length;
+            return false;
+        }
+        cursor.position += size;
+        if(cursor.started) {
+            cursor.logTimeUs += uint32_t(record.timestamp - cursor.lastTimestamp);
+        }
+        cursor.started = true;
+        cursor.lastTimestamp = record.timestamp;
+        if(accept(record)) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Get the log data at a position.
+ * @details A reader source is read into the window again if the position is outside of it or a record at the position may
+ *          exceed its end. The window starts at the current cursor if possible, so the records scanned by available() and
+ *          read by readFrame() afterwards are served from the same window.
+ *
+ * @param position Offset in the log.
+ * @param available Number of bytes available at the returned pointer.
+ * @return const uint8_t* Log data at the position, nullptr if it cannot be read.
+ */
+const uint8_t* CANReplayCore::fetch(size_t position, size_t& available) {
+    if(_log != nullptr) {
+        available = _length - position;
+        return &_log[position];
+    }
+    size_t windowEnd = _windowStart + _windowLength;
+    bool outside = position < _windowStart || position >= windowEnd;
+    if(outside || (position + CANLog::MAX_RECORD_SIZE > windowEnd && windowEnd < _length)) {
+        size_t start = position;
+        if(_cursor.position <= position && position - _cursor.position <= WINDOW_SIZE - CANLog::MAX_RECORD_SIZE) start = _cursor.position;
+        size_t length = _length - start < WINDOW_SIZE ? _length - start : WINDOW_SIZE;
+        _windowStart = start;
+        _windowLength = _reader(start, _window, length);
+        windowEnd = _windowStart + _windowLength;
+        if(position >= windowEnd) {
+            available = 0;
+            return nullptr;
+        }
+    }
+    available = windowEnd - position;
+    return &_window[position - _windowStart];
+}
+
+bool CANReplayCore::accept(const CANLog::Record& record) const {
+    if(record.direction == CANLog::TX && !_replayTransmitted) return false;
+    if(_filterType == FILTER_MASKED && (record.getId() & _filterMask) != (_filterId & _filterMask)) return false;
+    return true;
+}
+
+/**
+ * @brief Get the playback time of the record the cursor was advanced to.
+ */
+uint64_t CANReplayCore::getDueTime(const Cursor& cursor) const {
+    if(_speed <= 0.0f) return 0;
+    return uint64_t(double(cursor.logTimeUs) / _speed);
+}
+
+void CANReplayCore::rewind() {
+    _cursor = {};
+    _cursor.position = CANLog::HEADER_SIZE;
+    _startMicros = micros();
+    _lastMicros = _startMicros;
+    _playbackUs = 0;
+}
+
+void CANReplayCore::updateClock() {
+    uint32_t now = micros();
+    _playbackUs += uint32_t(now - _lastMicros);
+    _lastMicros = now;
+}
@@ -0,0 +1,292 @@
+#include "CANTimeSync.h"
+#include <math.h>
+#include "Debug.h"
+
+/**
+ * @brief Start the time synchronization on a CAN interface.
+ * @details The master sends the first SYNC immediately. A slave waits for the master and is synchronized after the first SYNC/TIME pair.
+ *
+ * @param canInterface Interface connected to the bus of the master.
+ * @param role MASTER or SLAVE.
+ * @return true if the listener was registered.
+ */
+bool CANTimeSync::begin(CANInterface* canInterface, Role role) {
+    if(canInterface == nullptr) {
+        ERROR_PRINTLN("[CANTimeSync] No CAN interface assigned.");
+        return false;
+    }
+    if(!canInterface->addListener(this)) {
+        return false;
+    }
+    if(!_clock) _clock = []() { return uint32_t(micros()); };
+    _canInterface = canInterface;
+    _role = role;
+    _localRef = _clock();
+    _locked = false;
+    _syncPending = false;
+    _syncSent = false;
+    _ratePpb = 0;
+    _offsetCount = 0;
+    _statistics = {};
+    if(_role == MASTER) {
+        CANCore* core = canInterface->getCANCore();
+        _txTimestamps = core && core->enableTxTimestamp(COB_ID_SYNC);
+        if(!_txTimestamps) WARNING_PRINTLN("[CANTimeSync] CAN core has no transmit timestamps. The SYNC time is estimated from the send time.");
+        sendSync();
+    }
+    INFO_PRINTLN("[CANTimeSync] Time synchronization started as " + String(_role == MASTER ? "master" : "slave") + ".");
+    return true;
+}
+
+void CANTimeSync::end() {
+    if(_canInterface && _txTimestamps && _canInterface->getCANCore()) _canInterface->getCANCore()->disableTxTimestamp();
+    _txTimestamps = false;
+    _syncSent = false;
+    if(_canInterface) _canInterface->removeListener(this);
+    _canInterface = nullptr;
+    _locked = false;
+}
+
+/**
+ * @brief Handle a received frame.
+ * @details A slave consumes SYNC and TIME frames. The master ignores them, a second master on the bus is reported.
+ */
+bool CANTimeSync::onMessage(const CANCore::CANMessage& message) {
+    if(message.isExtended || message.isRemote) return false;
+    if(message.id != COB_ID_SYNC && message.id != COB_ID_TIME) return false;
+    if(_role == MASTER) {
+        WARNING_PRINTLN("[CANTimeSync] Time frame of another master received.");
+        return true;
+    }
+    if(message.id == COB_ID_SYNC && message.length >= 1) {
+        //Receive time of the SYNC on the local clock. The frame age is taken from the micros() based receive timestamp.
+        uint32_t age = uint32_t(micros()) - _canInterface->getRxTimestamp();
+        _syncRxLocal = localTime() - age;
+        _syncSequence = message.data[0];
+        _syncPending = true;
+    } else if(message.id == COB_ID_TIME) {
+        handleTime(message.data, message.length);
+    }
+    return true;
+}
+
+/**
+ * @brief Send SYNC and TIME frames as master and apply due scheduled outputs.
+ */
+void CANTimeSync::cycle() {
+    if(_role == MASTER && _syncSent) completeSync();
+    if(_role == MASTER && millis() - _lastSync >= _syncIntervalMs) sendSync();
+    poll();
+}
+
+/**
+ * @brief Get the current network time.
+ * @return uint64_t Network time in microseconds. The local time of the master, extrapolated on a slave.
+ */
+uint64_t CANTimeSync::getNetworkTime() {
+    return toNetwork(localTime());
+}
+
+/**
+ * @brief Check if the network time is valid.
+ * @return true for the master, or for a slave which received a SYNC/TIME pair within the last three sync intervals.
+ */
+bool CANTimeSync::isSynchronized() {
+    if(_role == MASTER) return _canInterface != nullptr;
+    return _locked && localTime() - _lastSampleLocal < 3000ULL * _syncIntervalMs;
+}
+
+void CANTimeSync::resetStatistics() {
+    _statistics = {};
+    _offsetCount = 0;
+}
+
+/**
+ * @brief Schedule an output change for a network timestamp.
+ * @details The value is written to the interface by poll() once the network time is reached. If a module is given,
+ *          CANTramModule::writeOutputs() is called right after, so the hardware does not wait for the next module cycle.
+ *          The accuracy depends on how often poll() runs (e.g. every CANInterface::process()).
+ *
+ * @param interface Output interface.
+ * @param q New value.
+ * @param networkTimeUs Network time at which the value becomes active.
+ * @param module Optional module owning the interface.
+ * @return true if the change was scheduled, false if all MAX_SCHEDULED_OUTPUTS entries are in use.
+ */
+bool CANTimeSync::scheduleOutput(Interface* interface, uint16_t q, uint64_t networkTimeUs, CANTramModule* module) {
+    if(interface == nullptr) return false;
+    for(ScheduledOutput& output : _outputs) {
+        if(output.active) continue;
+        output = {interface, module, networkTimeUs, q, true};
+        return true;
+    }
+    ERROR_PRINTLN("[CANTimeSync] Maximum number of " + String(MAX_SCHEDULED_OUTPUTS) + " scheduled outputs reached.");
+    return false;
+}
+
+/**
+ * @brief Cancel scheduled output changes.
+ * @param interface Interface whose changes are cancelled, nullptr for all.
+ */
+void CANTimeSync::cancelOutputs(Interface* interface) {
+    for(ScheduledOutput& output : _outputs) {
+        if(interface == nullptr || output.interface == interface) output.active = false;
+    }
+}
+
+uint8_t CANTimeSync::getScheduledCount() const {
+    uint8_t count = 0;
+    for(const ScheduledOutput& output : _outputs) count += output.active ? 1 : 0;
+    return count;
+}
+
+/**
+ * @brief Apply all scheduled outputs which are due.
+ * @details Nothing is applied before a slave was synchronized once. Every affected module writes its outputs once.
+ */
+void CANTimeSync::poll() {
+    if(_role == SLAVE && !_locked) return;
+    uint64_t now = getNetworkTime();
+    CANTramModule* modules[MAX_SCHEDULED_OUTPUTS];
+    uint8_t moduleCount = 0;
+    for(ScheduledOutput& output : _outputs) {
+        if(!output.active || output.time > now) continue;
+        output.active = false;
+        output.interface->setQ(output.q);
+        _statistics.outputsApplied++;
+        if(now - output.time > _statistics.maxOutputLatenessUs) _statistics.maxOutputLatenessUs = now - output.time;
+        if(output.module == nullptr) continue;
+        bool known = false;
+        for(uint8_t i=0; i<moduleCount; i++) known |= modules[i] == output.module;
+        if(!known) modules[moduleCount++] = output.module;
+    }
+    for(uint8_t i=0; i<moduleCount; i++) modules[i]->writeOutputs();
+}
+
+/**
+ * @brief Read the local clock extended to 64 bit.
+ */
+uint64_t CANTimeSync::localTime() {
+    _localRef = extend(_clock());
+    return _localRef;
+}
+
+uint64_t CANTimeSync::toNetwork(uint64_t local) const {
+    if(_role == MASTER) return local;
+    int64_t elapsed = int64_t(local - _anchorLocal);
+    return _anchorNetwork + elapsed + elapsed * _ratePpb / 1000000000LL;
+}
+
+/**
+ * @brief Send a SYNC frame.
+ * @details With transmit timestamps, the TIME frame follows in completeSync() once the SYNC is on the bus. A SYNC still waiting for
+ *          its timestamp is given up, its late timestamp is recognized by the sequence counter. Without transmit timestamps, the TIME
+ *          frame is sent right away with the master time before sending plus the nominal SYNC duration without stuff bits.
+ */
+void CANTimeSync::sendSync() {
+    _lastSync = millis();
+    CANCore::CANMessage message = {};
+    message.id = COB_ID_SYNC;
+    message.length = 1;
+    message.data[0] = _sequence;
+    uint64_t time = localTime();
+    if(!_canInterface->sendMessage(message)) return;
+    _syncSentSequence = _sequence++;
+    if(_txTimestamps) {
+        _syncSent = true;
+        return;
+    }
+    uint32_t baudrate = _canInterface->getCANCore() ? uint32_t(_canInterface->getCANCore()->getBaudrate()) : 0;
+    if(baudrate > 0) time += (47 + 8) * 1000000UL / baudrate;
+    sendTime(_syncSentSequence, time);
+}
+
+/**
+ * @brief Send the TIME frame once the CAN core reports the end of the SYNC transmission.
+ */
+void CANTimeSync::completeSync() {
+    CANFrame frame;
+    if(!_canInterface->getCANCore() || !_canInterface->getCANCore()->readTxTimestamp(frame)) return;
+    if(frame.getLength() < 1 || frame.data[0] != _syncSentSequence) return;
+    _syncSent = false;
+    //End of the SYNC on the local clock, the frame age is taken from the micros() based transmit timestamp
+    uint32_t now = micros();
+    uint32_t age = now - frame.expandTimestamp(now);
+    sendTime(_syncSentSequence, localTime() - age);
+}
+
+/**
+ * @brief Send the TIME frame with the master time at the end of a SYNC.
+ */
+void CANTimeSync::sendTime(uint8_t sequence, uint64_t time) {
+    CANCore::CANMessage message = {};
+    message.id = COB_ID_TIME;
+    message.length = 8;
+    message.data[0] = sequence;
+    for(uint8_t i=0; i<7; i++) message.data[1 + i] = (time >> (8 * i)) & 0xFF;
+    if(_canInterface->sendMessage(message)) _statistics.syncsSent++;
+}
+
+/**
+ * @brief Complete a SYNC/TIME pair.
+ */
+void CANTimeSync::handleTime(const uint8_t* data, uint8_t length) {
+    if(length != 8) return;
+    if(!_syncPending || data[0] != _syncSequence) {
+        _statistics.lostSyncs++;
+        _syncPending = false;
+        return;
+    }
+    _syncPending = false;
+    //Master time and receive timestamp both refer to the end of the SYNC
+    uint64_t masterTime = 0;
+    for(uint8_t i=0; i<7; i++) masterTime |= uint64_t(data[1 + i]) << (8 * i);
+    addSample(_syncRxLocal, masterTime);
+}
+
+/**
+ * @brief Update the clock model of a slave with a new sample.
+ * @param rxLocal Local time the SYNC was received.
+ * @param masterTime Master time at the same moment.
+ */
+void CANTimeSync::addSample(uint64_t rxLocal, uint64_t masterTime) {
+    _statistics.samples++;
+    uint64_t predicted = toNetwork(rxLocal);
+    int64_t offset = _locked ? int64_t(masterTime - predicted) : 0;
+    _statistics.offsetUs = offset;
+
+    if(!_locked || offset > STEP_THRESHOLD_US || offset < -STEP_THRESHOLD_US) {
+        if(_locked) WARNING_PRINTLN("[CANTimeSync] Offset of " + String(int32_t(offset)) + " us to the master. Clock stepped.");
+        _anchorLocal = rxLocal;
+        _anchorNetwork = masterTime;
+        _lastSampleLocal = rxLocal;
+        _locked = true;
+        _rateValid = false;
+        _statistics.steps++;
+        return;
+    }
+
+    //PI servo: the frequency is corrected by a quarter of the measured rate error (fully after a step), the phase by half of the offset
+    int64_t interval = int64_t(rxLocal - _lastSampleLocal);
+    if(interval > 0) {
+        int64_t rateError = offset * 1000000000LL / interval;
+        _ratePpb += _rateValid ? rateError / 4 : rateError;
+        _rateValid = true;
+    }
+    _anchorNetwork = predicted + offset / 2;
+    _anchorLocal = rxLocal;
+    _lastSampleLocal = rxLocal;
+    _statistics.ratePpb = _ratePpb;
+
+    uint32_t absOffset = offset < 0 ? -offset : offset;
+    if(absOffset > _statistics.maxOffsetUs) _statistics.maxOffsetUs = absOffset;
+    _offsets[_offsetIndex] = offset;
+    _offsetIndex = (_offsetIndex + 1) % JITTER_SAMPLES;
+    if(_offsetCount < JITTER_SAMPLES) _offsetCount++;
+    float mean = 0;
+    for(uint8_t i=0; i<_offsetCount; i++) mean += _offsets[i];
+    mean /= _offsetCount;
+    float variance = 0;
+    for(uint8_t i=0; i<_offsetCount; i++) variance += (_offsets[i] - mean) * (_offsets[i] - mean);
+    _statistics.jitterUs = sqrtf(variance / _offsetCount);
+}
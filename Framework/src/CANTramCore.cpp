@@ -10,6 +10,8 @@ uint8_t CANTramCore::moduleCount = 0;
 uint8_t CANTramCore::providedGPIOs = 0;
 uint8_t CANTramCore::usedGPIOs = 0;
 CANCore::Baudrate CANTramCore::DEFAULT_CAN_BAUDRATE = CANCore::BR_500K;
+bool CANTramCore::CAN_AUTO_BAUD = false;
+uint32_t CANTramCore::CAN_AUTO_BAUD_TIMEOUT_MS = 3000;
 
 bool CANTramCore::outputDefinitionTableInitialized = false;
  
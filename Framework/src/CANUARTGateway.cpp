@@ -0,0 +1,245 @@
+#include "CANUARTGateway.h"
+#include "Debug.h"
+
+/**
+ * @brief Start forwarding between a CAN interface and a UART interface.
+ * @details The UART must be configured and started by its owner, e.g. with the baudrate DEFAULT_BAUDRATE.
+ *
+ * @param canInterface CAN side of the gateway.
+ * @param uartInterface UART side of the gateway.
+ * @return true if the gateway was registered at the CAN interface.
+ */
+bool CANUARTGateway::begin(CANInterface* canInterface, UARTInterface* uartInterface) {
+    if(canInterface == nullptr || uartInterface == nullptr || uartInterface->getUartCore() == nullptr) {
+        ERROR_PRINTLN("[CANUARTGateway] No CAN interface or UART core assigned.");
+        return false;
+    }
+    if(!canInterface->addListener(this)) {
+        return false;
+    }
+    _canInterface = canInterface;
+    _uartInterface = uartInterface;
+    _txFill = 0;
+    _timeSent = false;
+    _rxData = nullptr;
+    _rxInPlace = false;
+    _rxLength = 0;
+    _rxPosition = 0;
+    _pending = false;
+    _decoder.reset();
+    for(uint8_t i=0; i<2; i++) {
+        _rateLimits[i].tokens = _rateLimits[i].capacity;
+        _rateLimits[i].lastUpdate = micros();
+    }
+    resetStatistics();
+    return true;
+}
+
+/**
+ * @brief Stop forwarding. Buffered frames are written to the UART, a frame waiting for the CAN core is discarded.
+ */
+void CANUARTGateway::end() {
+    if(_canInterface == nullptr) return;
+    _canInterface->removeListener(this);
+    releaseUART();
+    if(!flush()) {
+        WARNING_PRINTLN("[CANUARTGateway] " + String(_txFill) + " bytes could not be written to the UART.");
+    }
+    _canInterface = nullptr;
+    _uartInterface = nullptr;
+    _txFill = 0;
+    _pending = false;
+}
+
+/**
+ * @brief Add an acceptance filter. Without filters all frames are forwarded, otherwise frames matching at least one filter.
+ *
+ * @param direction Direction the filter applies to.
+ * @param id Identifier to compare.
+ * @param mask Bits of the identifier to compare.
+ * @param extended Filter for extended instead of standard frames.
+ * @return true if the filter was added, false if MAX_FILTERS filters are set.
+ */
+bool CANUARTGateway::addFilter(Direction direction, uint32_t id, uint32_t mask, bool extended) {
+    if(_filterCount[direction] >= MAX_FILTERS) {
+        ERROR_PRINTLN("[CANUARTGateway] Maximum number of " + String(MAX_FILTERS) + " filters reached.");
+        return false;
+    }
+    _filters[direction][_filterCount[direction]++] = {id & mask, mask, extended};
+    return true;
+}
+
+void CANUARTGateway::clearFilters(Direction direction) {
+    _filterCount[direction] = 0;
+}
+
+/**
+ * @brief Limit the frame rate of a direction.
+ *
+ * @param direction Direction to limit.
+ * @param framesPerSecond Average frame rate, 0 disables the limit.
+ * @param burst Frames passed at once after a pause.
+ */
+void CANUARTGateway::setRateLimit(Direction direction, uint32_t framesPerSecond, uint16_t burst) {
+    RateLimit& limit = _rateLimits[direction];
+    limit.framesPerSecond = framesPerSecond;
+    limit.capacity = uint64_t(burst > 0 ? burst : 1) * 1000000;
+    limit.tokens = limit.capacity;
+    limit.lastUpdate = micros();
+}
+
+/**
+ * @brief Write the buffered frames to the UART with one call.
+ * @return true if the buffer is empty afterwards.
+ */
+bool CANUARTGateway::flush() {
+    if(_txFill == 0) return true;
+    if(_uartInterface == nullptr || !_uartInterface->send(reinterpret_cast<const char*>(_txBuffer), _txFill)) return false;
+    _uartWrites++;
+    _uartBytes += _txFill;
+    _txFill = 0;
+    return true;
+}
+
+void CANUARTGateway::resetStatistics() {
+    _statistics[CAN_TO_UART] = {};
+    _statistics[UART_TO_CAN] = {};
+    _uartWrites = 0;
+    _uartBytes = 0;
+    _framingErrors = 0;
+}
+
+/**
+ * @brief Buffer a received CAN frame for the UART.
+ * @details A time record is added whenever the upper 16 bits of the receive time changed. If the buffer cannot take the
+ *          records, it is written to the UART first; if the UART does not accept it either, the frame is dropped.
+ *
+ * @return false, the frame is offered to further listeners.
+ */
+bool CANUARTGateway::onMessage(const CANCore::CANMessage& message) {
+    if(_canInterface == nullptr || message.error) return false;
+    CANFrame frame = CANCore::toFrame(message, 0);
+    if(!accept(CAN_TO_UART, frame)) return false;
+
+    if(TX_BUFFER_SIZE - _txFill < 2 * CANSerial::MAX_PACKET_SIZE && !flush()) {
+        _statistics[CAN_TO_UART].dropped++;
+        return false;
+    }
+    uint8_t record[CANSerial::MAX_RECORD_SIZE];
+    uint32_t timestamp = _canInterface->getRxTimestamp();
+    if(_timestamps && (!_timeSent || (timestamp >> 16) != _timeHigh)) {
+        appendRecord(record, CANSerial::encodeTime(timestamp, record));
+        _timeSent = true;
+        _timeHigh = timestamp >> 16;
+    }
+    appendRecord(record, CANSerial::encodeFrame(frame, timestamp, _timestamps, record));
+    _statistics[CAN_TO_UART].forwarded++;
+    return false;
+}
+
+/**
+ * @brief Write the buffered frames to the UART and send frames received on the UART.
+ */
+void CANUARTGateway::cycle() {
+    if(_canInterface == nullptr) return;
+    flush();
+    receiveUART();
+}
+
+/**
+ * @brief Check a frame against the filters and the rate limit of a direction and update the statistics.
+ * @return true if the frame is forwarded.
+ */
+bool CANUARTGateway::accept(Direction direction, const CANFrame& frame) {
+    if(_filterCount[direction] > 0) {
+        bool match = false;
+        for(uint8_t i=0; i<_filterCount[direction] && !match; i++) {
+            const Filter& filter = _filters[direction][i];
+            match = filter.extended == frame.isExtended() && (frame.getId() & filter.mask) == filter.id;
+        }
+        if(!match) {
+            _statistics[direction].filtered++;
+            return false;
+        }
+    }
+
+    RateLimit& limit = _rateLimits[direction];
+    if(limit.framesPerSecond == 0) return true;
+    uint32_t now = micros();
+    limit.tokens += uint64_t(now - limit.lastUpdate) * limit.framesPerSecond;
+    limit.lastUpdate = now;
+    if(limit.tokens > limit.capacity) limit.tokens = limit.capacity;
+    if(limit.tokens < 1000000) {
+        _statistics[direction].rateLimited++;
+        return false;
+    }
+    limit.tokens -= 1000000;
+    return true;
+}
+
+bool CANUARTGateway::appendRecord(const uint8_t* record, size_t length) {
+    if(TX_BUFFER_SIZE - _txFill < CANSerial::MAX_PACKET_SIZE) return false;
+    _txFill += CANSerial::encodePacket(record, length, &_txBuffer[_txFill]);
+    return true;
+}
+
+/**
+ * @brief Decode the bytes received on the UART and send the frames, at most MAX_FRAMES_PER_CYCLE per call.
+ * @details A frame the CAN core does not accept is kept and sent again in the next cycle before further bytes are decoded.
+ *          Decoded bytes are removed from the UART core when the call returns.
+ */
+void CANUARTGateway::receiveUART() {
+    Statistics& statistics = _statistics[UART_TO_CAN];
+    for(uint8_t count=0; count<MAX_FRAMES_PER_CYCLE; ) {
+        if(_pending) {
+            if(!_canInterface->sendMessage(_pendingMessage)) break;
+            _pending = false;
+            statistics.forwarded++;
+            count++;
+            continue;
+        }
+        if(_rxPosition >= _rxLength) {
+            releaseUART();
+            if(!fetchUART()) break;
+        }
+        CANSerial::Record record;
+        CANSerial::Decoder::Result result = _decoder.push(_rxData[_rxPosition++], record);
+        if(result == CANSerial::Decoder::INVALID) {
+            _framingErrors++;
+        } else if(result == CANSerial::Decoder::FRAME && accept(UART_TO_CAN, record.frame)) {
+            CANCore::fromFrame(record.frame, _pendingMessage);
+            _pending = true;
+        }
+    }
+    releaseUART();
+}
+
+/**
+ * @brief Get the next received bytes, in place if the UART core supports it, otherwise copied into _rxBuffer.
+ * @return true if bytes are available.
+ */
+bool CANUARTGateway::fetchUART() {
+    _rxLength = _uartInterface->peek(_rxData);
+    _rxInPlace = _rxLength > 0;
+    if(!_rxInPlace) {
+        _rxLength = _uartInterface->read(_rxBuffer, RX_CHUNK_SIZE);
+        _rxData = _rxBuffer;
+    }
+    return _rxLength > 0;
+}
+
+/**
+ * @brief Remove the decoded bytes from the UART core. Copied bytes are kept in _rxBuffer until they are decoded.
+ */
+void CANUARTGateway::releaseUART() {
+    if(_rxInPlace) {
+        _uartInterface->consume(_rxPosition);
+        _rxInPlace = false;
+        _rxData = nullptr;
+        _rxLength = 0;
+        _rxPosition = 0;
+    } else if(_rxPosition >= _rxLength) {
+        _rxLength = 0;
+        _rxPosition = 0;
+    }
+}
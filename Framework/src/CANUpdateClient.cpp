@@ -0,0 +1,305 @@
+#include "CANUpdateClient.h"
+#include "Debug.h"
+
+/**
+ * @brief Register the client at a CAN interface.
+ *
+ * @param canInterface Interface connected to the servers.
+ * @return true if the client was registered.
+ */
+bool CANUpdateClient::begin(CANInterface* canInterface) {
+    if(canInterface == nullptr) {
+        ERROR_PRINTLN("[CANUpdateClient] No CAN interface assigned.");
+        return false;
+    }
+    if(!canInterface->addListener(this)) {
+        return false;
+    }
+    _canInterface = canInterface;
+    _state = IDLE;
+    return true;
+}
+
+/**
+ * @brief Unregister the client. A running transfer is aborted.
+ */
+void CANUpdateClient::end() {
+    abort();
+    _abortPending = false;
+    if(_canInterface) _canInterface->removeListener(this);
+    _canInterface = nullptr;
+}
+
+/**
+ * @brief Start the transfer of an image.
+ *
+ * @param nodeId Node ID of the server (1..63).
+ * @param type Image type, see CANUpdate::ImageType.
+ * @param image Image data. Must stay valid until the transfer is finished.
+ * @param size Size of the image in bytes.
+ * @param activate Activate the image after it was verified.
+ * @return true if the transfer was started.
+ */
+bool CANUpdateClient::start(uint8_t nodeId, uint8_t type, const uint8_t* image, uint32_t size, bool activate) {
+    if(_canInterface == nullptr || _state != IDLE) {
+        ERROR_PRINTLN("[CANUpdateClient] Client not started or transfer running.");
+        return false;
+    }
+    if(nodeId == 0 || nodeId > CANUpdate::MAX_NODE_ID || image == nullptr || size == 0) {
+        ERROR_PRINTLN("[CANUpdateClient] Invalid node ID or empty image.");
+        return false;
+    }
+    if(_abortPending) {
+        ERROR_PRINTLN("[CANUpdateClient] ABORT of the previous transfer not sent yet.");
+        return false;
+    }
+    _nodeId = nodeId;
+    _type = type;
+    _image = image;
+    _size = size;
+    _activate = activate;
+    _blockSegments = 0;
+    _nextBlock = 0;
+    _segment = 0;
+    _ackedBlock = 0;
+    _retries = 0;
+    _repeatedBlocks = 0;
+    _durationMs = 0;
+    _serverStatus = CANUpdate::STATUS_OK;
+    _startTime = millis();
+    _lastProgress = _startTime;
+    _result = RESULT_BUSY;
+    _state = STARTING;
+    sendCommand(CANUpdate::CMD_START);
+    INFO_PRINTLN("[CANUpdateClient] Sending image type " + String(type) + " with " + String(size) + " bytes to node " + String(nodeId) + ".");
+    return true;
+}
+
+/**
+ * @brief Cancel a running transfer. The server discards the image.
+ */
+void CANUpdateClient::abort() {
+    if(_state == IDLE) return;
+    _abortPending = !sendCommand(CANUpdate::CMD_ABORT);
+    finish(RESULT_ABORTED);
+}
+
+/**
+ * @brief Get the number of image bytes acknowledged by the server.
+ */
+uint32_t CANUpdateClient::getAcknowledgedBytes() const {
+    if(_blockSegments == 0) return 0;
+    uint32_t bytes = uint32_t(_ackedBlock) * getBlockSize();
+    return bytes < _size ? bytes : _size;
+}
+
+/**
+ * @brief Handle a response of the server.
+ *
+ * @param message Received frame.
+ * @return true if the frame was a response of the server of the running transfer.
+ */
+bool CANUpdateClient::onMessage(const CANCore::CANMessage& message) {
+    if(_state == IDLE || message.isExtended || message.isRemote || message.id != uint32_t(CANUpdate::COB_ID_RESPONSE + _nodeId)) {
+        return false;
+    }
+    if(message.length < 4) return true;
+    const uint8_t* data = message.data;
+    uint8_t status = data[1];
+    uint16_t block = CANUpdate::readU16(&data[2]);
+    if(data[0] == CANUpdate::CMD_ABORT) {
+        WARNING_PRINTLN("[CANUpdateClient] Transfer aborted by node " + String(_nodeId) + ", status " + String(status) + ".");
+        finish(RESULT_REJECTED, status);
+        return true;
+    }
+
+    switch(_state) {
+        case STARTING:
+            if(data[0] != CANUpdate::CMD_START) break;
+            if(status != CANUpdate::STATUS_OK || message.length < 6 || data[4] == 0 || data[4] > CANUpdate::MAX_BLOCK_SEGMENTS
+               || data[5] == 0 || data[5] > CANUpdate::MAX_WINDOW) {
+                finish(RESULT_REJECTED, status);
+                break;
+            }
+            _blockSegments = data[4];
+            _window = data[5];
+            _blockCount = (_size + getBlockSize() - 1) / getBlockSize();
+            _lastProgress = millis();
+            _retries = 0;
+            _state = SENDING;
+            sendBlocks();
+            break;
+
+        case SENDING:
+            if(data[0] != CANUpdate::CMD_BLOCK_END || block < _ackedBlock || block >= _blockCount) break;
+            _lastProgress = millis();
+            _retries = 0;
+            if(status == CANUpdate::STATUS_BLOCK_ERROR) {
+                //Go back to the rejected block, blocks sent after it were discarded by the server
+                if(block <= _nextBlock) {
+                    _repeatedBlocks += _nextBlock - block + (_segment > 0 ? 1 : 0);
+                    _nextBlock = block;
+                    _segment = 0;
+                }
+                break;
+            }
+            if(status != CANUpdate::STATUS_OK) {
+                finish(RESULT_REJECTED, status);
+                break;
+            }
+            _ackedBlock = block + 1;
+            if(_ackedBlock > _nextBlock) {
+                _nextBlock = _ackedBlock;
+                _segment = 0;
+            }
+            if(_ackedBlock == _blockCount) {
+                _state = ENDING;
+                sendCommand(CANUpdate::CMD_END);
+            } else {
+                sendBlocks();
+            }
+            break;
+
+        case ENDING:
+            if(data[0] != CANUpdate::CMD_END) break;
+            if(status != CANUpdate::STATUS_OK) {
+                finish(RESULT_REJECTED, status);
+            } else if(_activate) {
+                _lastProgress = millis();
+                _retries = 0;
+                _state = ACTIVATING;
+                sendCommand(CANUpdate::CMD_ACTIVATE);
+            } else {
+                finish(RESULT_OK);
+            }
+            break;
+
+        case ACTIVATING:
+            if(data[0] != CANUpdate::CMD_ACTIVATE) break;
+            finish(status == CANUpdate::STATUS_OK ? RESULT_OK : RESULT_REJECTED, status);
+            break;
+
+        default:
+            break;
+    }
+    return true;
+}
+
+/**
+ * @brief Send pending segments and repeat requests without response.
+ * @details An ABORT the CAN core did not accept is sent again, also after the transfer has finished.
+ */
+void CANUpdateClient::cycle() {
+    if(_abortPending) _abortPending = !sendCommand(CANUpdate::CMD_ABORT);
+    if(_state == IDLE) return;
+    if(_state == SENDING) sendBlocks();
+    if(millis() - _lastProgress > RESPONSE_TIMEOUT_MS) retry();
+}
+
+/**
+ * @brief Send segments and BLOCK_END frames while the window is not full, at most MAX_FRAMES_PER_CYCLE frames.
+ * @details A frame the CAN core does not accept is sent again in the next cycle.
+ */
+void CANUpdateClient::sendBlocks() {
+    uint8_t frame[8];
+    for(uint8_t count=0; count<MAX_FRAMES_PER_CYCLE; count++) {
+        if(_nextBlock >= _blockCount || _nextBlock >= _ackedBlock + _window) return;
+        size_t offset = size_t(_nextBlock) * getBlockSize();
+        size_t length = getBlockLength(_nextBlock);
+        uint8_t segments = (length + CANUpdate::SEGMENT_DATA - 1) / CANUpdate::SEGMENT_DATA;
+        if(_segment < segments) {
+            size_t segmentOffset = size_t(_segment) * CANUpdate::SEGMENT_DATA;
+            size_t segmentLength = length - segmentOffset;
+            if(segmentLength > CANUpdate::SEGMENT_DATA) segmentLength = CANUpdate::SEGMENT_DATA;
+            frame[0] = _segment;
+            memcpy(&frame[1], &_image[offset + segmentOffset], segmentLength);
+            if(!sendFrame(frame, segmentLength + 1)) return;
+            _segment++;
+        } else {
+            frame[0] = CANUpdate::CMD_BLOCK_END;
+            CANUpdate::writeU16(&frame[1], _nextBlock);
+            CANUpdate::writeU32(&frame[3], CANUpdate::crc32(&_image[offset], length));
+            if(!sendFrame(frame, 7)) return;
+            _nextBlock++;
+            _segment = 0;
+        }
+        _lastProgress = millis();
+    }
+}
+
+/**
+ * @brief Send a command frame.
+ */
+bool CANUpdateClient::sendCommand(uint8_t command) {
+    uint8_t frame[8] = {command};
+    uint8_t length = 1;
+    if(command == CANUpdate::CMD_START) {
+        frame[1] = _type;
+        CANUpdate::writeU32(&frame[2], _size);
+        length = 6;
+    } else if(command == CANUpdate::CMD_END) {
+        CANUpdate::writeU32(&frame[1], CANUpdate::crc32(_image, _size));
+        length = 5;
+    }
+    return sendFrame(frame, length);
+}
+
+bool CANUpdateClient::sendFrame(const uint8_t* data, uint8_t length) {
+    CANCore::CANMessage message = {};
+    message.id = CANUpdate::COB_ID_REQUEST + _nodeId;
+    message.length = length;
+    memcpy(message.data, data, length);
+    return _canInterface->sendMessage(message);
+}
+
+/**
+ * @brief Repeat the last request after a timeout. Blocks are sent again from the first unacknowledged block.
+ */
+void CANUpdateClient::retry() {
+    if(++_retries > MAX_RETRIES) {
+        ERROR_PRINTLN("[CANUpdateClient] No response from node " + String(_nodeId) + ".");
+        _abortPending = !sendCommand(CANUpdate::CMD_ABORT);
+        finish(RESULT_TIMEOUT);
+        return;
+    }
+    _lastProgress = millis();
+    switch(_state) {
+        case STARTING:
+            sendCommand(CANUpdate::CMD_START);
+            break;
+        case SENDING:
+            _repeatedBlocks += _nextBlock - _ackedBlock + (_segment > 0 ? 1 : 0);
+            _nextBlock = _ackedBlock;
+            _segment = 0;
+            sendBlocks();
+            break;
+        case ENDING:
+            sendCommand(CANUpdate::CMD_END);
+            break;
+        case ACTIVATING:
+            sendCommand(CANUpdate::CMD_ACTIVATE);
+            break;
+        default:
+            break;
+    }
+}
+
+void CANUpdateClient::finish(Result result, uint8_t serverStatus) {
+    _state = IDLE;
+    _result = result;
+    _serverStatus = serverStatus;
+    _durationMs = millis() - _startTime;
+    if(result == RESULT_OK) {
+        INFO_PRINTLN("[CANUpdateClient] " + String(_size) + " bytes sent to node " + String(_nodeId) + " in " + String(_durationMs) + " ms.");
+    }
+    if(_finishedCallback) _finishedCallback(result);
+}
+
+/**
+ * @brief Get the number of image bytes in a block. Only the last block may be shorter than the block size.
+ */
+size_t CANUpdateClient::getBlockLength(uint16_t block) const {
+    size_t offset = size_t(block) * getBlockSize();
+    size_t remaining = _size - offset;
+    return remaining < getBlockSize() ? remaining : getBlockSize();
+}
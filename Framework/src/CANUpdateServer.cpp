@@ -0,0 +1,320 @@
+#include "CANUpdateServer.h"
+#include "Debug.h"
+
+/**
+ * @brief Start serving update requests on a CAN interface.
+ * @details Registers the server as listener at the interface. Frames are handled and blocks are written when CANInterface::process() is called.
+ *
+ * @param canInterface Interface to serve.
+ * @return true if the server was registered.
+ */
+bool CANUpdateServer::begin(CANInterface* canInterface) {
+    if(canInterface == nullptr) {
+        ERROR_PRINTLN("[CANUpdateServer] No CAN interface assigned.");
+        return false;
+    }
+    if(_nodeId == 0 || _nodeId > CANUpdate::MAX_NODE_ID) {
+        ERROR_PRINTLN("[CANUpdateServer] Invalid node ID " + String(_nodeId) + ". Valid range is 1.." + String(CANUpdate::MAX_NODE_ID) + ".");
+        return false;
+    }
+    if(!canInterface->addListener(this)) {
+        return false;
+    }
+    _canInterface = canInterface;
+    _state = IDLE;
+    INFO_PRINTLN("[CANUpdateServer] Update server started for node " + String(_nodeId) + ".");
+    return true;
+}
+
+/**
+ * @brief Stop serving update requests. A running transfer is discarded.
+ */
+void CANUpdateServer::end() {
+    if(_state != IDLE) abort(CANUpdate::STATUS_OK, false);
+    if(_canInterface) _canInterface->removeListener(this);
+    _canInterface = nullptr;
+}
+
+/**
+ * @brief Set the target of an image type.
+ *
+ * @param type Image type, see CANUpdate::ImageType.
+ * @param target Target, nullptr to reject images of this type.
+ * @return false if the type is invalid or a transfer is running.
+ */
+bool CANUpdateServer::setTarget(uint8_t type, UpdateTarget* target) {
+    if(type >= MAX_TARGETS || _state != IDLE) {
+        ERROR_PRINTLN("[CANUpdateServer] Invalid image type " + String(type) + " or transfer running.");
+        return false;
+    }
+    _targets[type] = target;
+    return true;
+}
+
+/**
+ * @brief Set the node ID.
+ *
+ * @param nodeId Node ID in the range 1..63.
+ * @return true if the node ID is valid.
+ */
+bool CANUpdateServer::setNodeId(uint8_t nodeId) {
+    if(nodeId == 0 || nodeId > CANUpdate::MAX_NODE_ID || _state != IDLE) {
+        ERROR_PRINTLN("[CANUpdateServer] Invalid node ID " + String(nodeId) + " or transfer running.");
+        return false;
+    }
+    _nodeId = nodeId;
+    return true;
+}
+
+/**
+ * @brief Set the number of segments per block announced to the client.
+ *
+ * @param segments 1..CANUpdate::MAX_BLOCK_SEGMENTS.
+ * @return false if the value is invalid or a transfer is running.
+ */
+bool CANUpdateServer::setBlockSegments(uint8_t segments) {
+    if(segments == 0 || segments > CANUpdate::MAX_BLOCK_SEGMENTS || _state != IDLE) return false;
+    _blockSegments = segments;
+    return true;
+}
+
+/**
+ * @brief Set the number of blocks the client may send without acknowledgement.
+ *
+ * @param blocks 1..CANUpdate::MAX_WINDOW.
+ * @return false if the value is invalid or a transfer is running.
+ */
+bool CANUpdateServer::setWindow(uint8_t blocks) {
+    if(blocks == 0 || blocks > CANUpdate::MAX_WINDOW || _state != IDLE) return false;
+    _window = blocks;
+    return true;
+}
+
+/**
+ * @brief Handle a received frame.
+ *
+ * @param message Received frame.
+ * @return true if the frame was an update request for this node.
+ */
+bool CANUpdateServer::onMessage(const CANCore::CANMessage& message) {
+    if(message.isExtended || message.isRemote || message.id != uint32_t(CANUpdate::COB_ID_REQUEST + _nodeId)) {
+        return false;
+    }
+    if(message.length == 0) return true;
+    const uint8_t* data = message.data;
+    _lastActivity = millis();
+    if(data[0] < CANUpdate::CMD_START) {
+        receiveSegment(data, message.length);
+        return true;
+    }
+    switch(data[0]) {
+        case CANUpdate::CMD_START:
+            if(message.length >= 6) start(data);
+            break;
+        case CANUpdate::CMD_BLOCK_END:
+            if(message.length >= 7 && _state == RECEIVING) blockEnd(data);
+            break;
+        case CANUpdate::CMD_END:
+            if(message.length >= 5) finish(data);
+            break;
+        case CANUpdate::CMD_ACTIVATE:
+            activate();
+            break;
+        case CANUpdate::CMD_ABORT:
+            //Abort by client, no response
+            if(_state != IDLE) {
+                DEBUG_PRINTLN("[CANUpdateServer] Transfer aborted by client.");
+                abort(CANUpdate::STATUS_OK, false);
+            }
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+/**
+ * @brief Write the oldest buffered block and acknowledge it, abort transfers that timed out.
+ * @details At most one block is written per call to bound the time spent in CANInterface::process().
+ */
+void CANUpdateServer::cycle() {
+    if(_state != RECEIVING) return;
+    if(_writeBlock != _rxBlock) {
+        const uint8_t* block = _buffers[_writeBlock % _window];
+        size_t length = getBlockLength(_writeBlock);
+        if(!_target->write(_written, block, length)) {
+            ERROR_PRINTLN("[CANUpdateServer] Writing block " + String(_writeBlock) + " failed.");
+            abort(CANUpdate::STATUS_WRITE_ERROR, true);
+            return;
+        }
+        _crc = CANUpdate::crc32(block, length, _crc);
+        _written += length;
+        sendResponse(CANUpdate::CMD_BLOCK_END, CANUpdate::STATUS_OK, _writeBlock);
+        _writeBlock++;
+        _lastActivity = millis();
+        return;
+    }
+    if(millis() - _lastActivity > TIMEOUT_MS) {
+        WARNING_PRINTLN("[CANUpdateServer] Transfer timed out after " + String(_written) + " of " + String(_size) + " bytes.");
+        abort(CANUpdate::STATUS_TIMEOUT, true);
+    }
+}
+
+/**
+ * @brief Handle START: prepare the target of the image type. A running transfer is discarded.
+ */
+void CANUpdateServer::start(const uint8_t* data) {
+    if(_state != IDLE) abort(CANUpdate::STATUS_OK, false);
+    uint8_t type = data[1];
+    uint32_t size = CANUpdate::readU32(&data[2]);
+    UpdateTarget* target = type < MAX_TARGETS ? _targets[type] : nullptr;
+    if(target == nullptr) {
+        sendResponse(CANUpdate::CMD_START, CANUpdate::STATUS_NO_TARGET);
+        return;
+    }
+    uint32_t blockCount = (size + getBlockSize() - 1) / getBlockSize();
+    if(size == 0 || size > target->getCapacity() || blockCount > 0xFFFF) {
+        WARNING_PRINTLN("[CANUpdateServer] Image of " + String(size) + " bytes does not fit into the target.");
+        sendResponse(CANUpdate::CMD_START, CANUpdate::STATUS_TOO_LARGE);
+        return;
+    }
+    if(!target->begin(size)) {
+        sendResponse(CANUpdate::CMD_START, CANUpdate::STATUS_WRITE_ERROR);
+        return;
+    }
+    _type = type;
+    _target = target;
+    _size = size;
+    _blockCount = blockCount;
+    _rxBlock = 0;
+    _writeBlock = 0;
+    _segments = 0;
+    _written = 0;
+    _crc = 0;
+    _state = RECEIVING;
+    INFO_PRINTLN("[CANUpdateServer] Receiving image type " + String(type) + " with " + String(size) + " bytes.");
+    sendResponse(CANUpdate::CMD_START, CANUpdate::STATUS_OK, 0, _blockSegments, _window);
+}
+
+/**
+ * @brief Store a segment of the current block. Segments which do not fit the current block are ignored.
+ */
+void CANUpdateServer::receiveSegment(const uint8_t* data, uint8_t length) {
+    if(_state != RECEIVING || _rxBlock >= _blockCount || _rxBlock - _writeBlock >= _window) return;
+    uint8_t index = data[0];
+    size_t blockLength = getBlockLength(_rxBlock);
+    size_t offset = size_t(index) * CANUpdate::SEGMENT_DATA;
+    if(offset >= blockLength) return;
+    size_t expected = blockLength - offset;
+    if(expected > CANUpdate::SEGMENT_DATA) expected = CANUpdate::SEGMENT_DATA;
+    if(size_t(length - 1) != expected) return;
+    memcpy(&_buffers[_rxBlock % _window][offset], &data[1], expected);
+    _segments |= uint64_t(1) << index;
+}
+
+/**
+ * @brief Handle BLOCK_END: accept the current block if all segments were received and the CRC matches.
+ * @details Accepted blocks are acknowledged after they were written in cycle(). Blocks already written are acknowledged again,
+ *          because the client repeats blocks whose acknowledgement was lost.
+ */
+void CANUpdateServer::blockEnd(const uint8_t* data) {
+    uint16_t block = CANUpdate::readU16(&data[1]);
+    uint32_t crc = CANUpdate::readU32(&data[3]);
+    if(block < _writeBlock) {
+        sendResponse(CANUpdate::CMD_BLOCK_END, CANUpdate::STATUS_OK, block);
+        return;
+    }
+    if(block < _rxBlock) return;        // Buffered, acknowledged when written
+    uint64_t segments = _segments;
+    _segments = 0;
+    if(block > _rxBlock) return;        // Sent after a rejected block, the client repeats it
+    size_t length = getBlockLength(block);
+    uint8_t count = (length + CANUpdate::SEGMENT_DATA - 1) / CANUpdate::SEGMENT_DATA;
+    uint64_t expected = count >= 64 ? ~uint64_t(0) : (uint64_t(1) << count) - 1;
+    if(segments != expected || CANUpdate::crc32(_buffers[block % _window], length) != crc) {
+        DEBUG_PRINTLN("[CANUpdateServer] Block " + String(block) + " incomplete or CRC wrong.");
+        sendResponse(CANUpdate::CMD_BLOCK_END, CANUpdate::STATUS_BLOCK_ERROR, block);
+        return;
+    }
+    _rxBlock++;
+}
+
+/**
+ * @brief Handle END: verify the image CRC and complete the target.
+ * @details Only allowed after all blocks were written, i.e. after the client received the last acknowledgement.
+ */
+void CANUpdateServer::finish(const uint8_t* data) {
+    if(_state == VERIFIED) {
+        sendResponse(CANUpdate::CMD_END, CANUpdate::STATUS_OK);     // Repeated by the client after a lost response
+        return;
+    }
+    if(_state != RECEIVING || _writeBlock != _blockCount) {
+        sendResponse(CANUpdate::CMD_END, CANUpdate::STATUS_STATE_ERROR);
+        return;
+    }
+    uint32_t crc = CANUpdate::readU32(&data[1]);
+    if(crc != _crc || !_target->finish()) {
+        ERROR_PRINTLN("[CANUpdateServer] Image rejected, CRC 0x" + String(_crc, HEX) + " expected 0x" + String(crc, HEX) + ".");
+        sendResponse(CANUpdate::CMD_END, CANUpdate::STATUS_IMAGE_ERROR);
+        abort(CANUpdate::STATUS_IMAGE_ERROR, false);
+        return;
+    }
+    _state = VERIFIED;
+    sendResponse(CANUpdate::CMD_END, CANUpdate::STATUS_OK);
+}
+
+/**
+ * @brief Handle ACTIVATE: switch the target over to the verified image.
+ */
+void CANUpdateServer::activate() {
+    if(_state != VERIFIED) {
+        sendResponse(CANUpdate::CMD_ACTIVATE, CANUpdate::STATUS_STATE_ERROR);
+        return;
+    }
+    if(!_target->activate()) {
+        ERROR_PRINTLN("[CANUpdateServer] Activating image type " + String(_type) + " failed.");
+        sendResponse(CANUpdate::CMD_ACTIVATE, CANUpdate::STATUS_WRITE_ERROR);
+        abort(CANUpdate::STATUS_WRITE_ERROR, false);
+        return;
+    }
+    _state = IDLE;
+    _target = nullptr;
+    INFO_PRINTLN("[CANUpdateServer] Image type " + String(_type) + " with " + String(_size) + " bytes activated.");
+    sendResponse(CANUpdate::CMD_ACTIVATE, CANUpdate::STATUS_OK);
+    if(_activateCallback) _activateCallback(_type);
+}
+
+/**
+ * @brief Discard the staged image and reset the transfer state.
+ *
+ * @param status Status sent to the client.
+ * @param notify Send an ABORT response.
+ */
+void CANUpdateServer::abort(uint8_t status, bool notify) {
+    if(_target) _target->abort();
+    _target = nullptr;
+    _state = IDLE;
+    if(notify) sendResponse(CANUpdate::CMD_ABORT, status);
+}
+
+/**
+ * @brief Get the number of image bytes in a block. Only the last block may be shorter than the block size.
+ */
+size_t CANUpdateServer::getBlockLength(uint16_t block) const {
+    size_t offset = size_t(block) * getBlockSize();
+    size_t remaining = _size - offset;
+    return remaining < getBlockSize() ? remaining : getBlockSize();
+}
+
+void CANUpdateServer::sendResponse(uint8_t command, uint8_t status, uint16_t block, uint8_t extra0, uint8_t extra1) {
+    if(_canInterface == nullptr) return;
+    CANCore::CANMessage message = {};
+    message.id = CANUpdate::COB_ID_RESPONSE + _nodeId;
+    message.length = 6;
+    message.data[0] = command;
+    message.data[1] = status;
+    CANUpdate::writeU16(&message.data[2], block);
+    message.data[4] = extra0;
+    message.data[5] = extra1;
+    _canInterface->sendMessage(message);
+}
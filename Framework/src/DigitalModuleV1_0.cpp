@@ -2,6 +2,7 @@
 #include "CANTramCore.h"
 #include "OutputDefinition.h"
 #include "Debug.h"
+#include "ObjectDictionary.h"
 
 const String DigitalModuleV1_0::HW_TYPE = "DigitalModuleV1.0";
 const String DigitalModuleV1_0::HW_VERSION = "1.0";
@@ -167,9 +168,10 @@ bool DigitalModuleV1_0::addInterfaces()
  */
 void DigitalModuleV1_0::setWireBreakMask(uint8_t mask)
 {
+    _wireBreakMask = mask;
     for (int i = 0; i < 8; i++)
     {
-        bool activateMask = ((mask && OUTPUT_MASK) >> i) & 0x01;
+        bool activateMask = (mask >> i) & 0x01;
         uint8_t success = _Inputs.setWireBreakMask(i, activateMask);
         if (success != ISO1I813T::STATUS_OK)
         {
@@ -178,6 +180,24 @@ void DigitalModuleV1_0::setWireBreakMask(uint8_t mask)
     }
 }
 
+/**
+ * @brief Add the module configuration to an object dictionary.
+ * @details Exposes the wire-break mask (read/write) and the output mask (read-only) of the module.
+ * @param od Object dictionary to add the entries to.
+ * @param index Object index reserved for this module.
+ * @return true if all entries were added, false otherwise.
+ */
+bool DigitalModuleV1_0::addObjects(ObjectDictionary& od, uint16_t index)
+{
+    bool result = true;
+    result &= od.addU8(index, 1, ObjectDictionary::ACCESS_RW,
+                       [this]() { return getWireBreakMask(); },
+                       [this](uint8_t mask) { setWireBreakMask(mask); return true; });
+    result &= od.addU8(index, 2, ObjectDictionary::ACCESS_RO,
+                       [this]() { return OUTPUT_MASK; });
+    return result;
+}
+
 /**
  * @brief Initialize the digital module hardware and ICs.
  * @details Initializes output and input ICs, configures external chip-select handling using the configured
@@ -216,18 +236,7 @@ void DigitalModuleV1_0::cycle(uint8_t *response)
 {
     DEBUG_PRINTLN("[DigitalModuleV1_0] Cycling module...");
 
-    // read output interfaces
-    _outputStates = 0;
-    for (int i = 0; i < 8; i++)
-    {
-        _outputStates |= (_digitalOutputInterfaces[i].getQ() << i);
-    }
-
-    // applay output mask
-    _outputStates &= OUTPUT_MASK;
-
-    // apply outputs
-    _Outputs.setOutputs(_outputStates);
+    writeOutputs();
 
     // read inputs
     ISO1I813T::Data data = _Inputs.fetchData();
@@ -243,6 +252,28 @@ void DigitalModuleV1_0::cycle(uint8_t *response)
     }
 }
 
+/**
+ * @brief Write the output interface values to the output IC.
+ * @details Collects the states of the output interfaces, applies the output mask and writes them to the output IC.
+ * @return true.
+ */
+bool DigitalModuleV1_0::writeOutputs()
+{
+    // read output interfaces
+    _outputStates = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        _outputStates |= (_digitalOutputInterfaces[i].getQ() << i);
+    }
+
+    // applay output mask
+    _outputStates &= OUTPUT_MASK;
+
+    // apply outputs
+    _Outputs.setOutputs(_outputStates);
+    return true;
+}
+
 /**
  * @brief Set all digital outputs at once.
  * @details Updates the module's cached output state respecting the output mask and writes the values into the output interfaces.
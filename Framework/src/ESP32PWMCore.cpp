@@ -19,6 +19,23 @@ void ESP32PWMCore::begin() {
     
 }
 
+/**
+ * @brief Set the PWM frequency of the timer.
+ * @details Before begin() the frequency is only stored. After begin() the running timer is updated as well.
+ * @param freqHz Frequency in Hz.
+ * @return true if the frequency was applied, false if the timer rejected it.
+ */
+bool ESP32PWMCore::setFrequency(uint32_t freqHz) {
+    if(PWMCore::_initialized) {
+        if(ledc_set_freq(_PWMTimerConfig.speed_mode, _PWMTimerConfig.timer_num, freqHz) != ESP_OK) {
+            ERROR_PRINTLN("[ESP32PWMCore] ERROR: Failed to set frequency " + String(freqHz) + " Hz");
+            return false;
+        }
+    }
+    _PWMTimerConfig.freq_hz = freqHz;
+    return true;
+}
+
 bool ESP32PWMCore::addChannel(OutputDefinition* def) {
     uint8_t channelIndex = _ledcChannelCount++;
     if(!PWMCore::_initialized) {
@@ -58,7 +58,8 @@ bool ESP32_CANCore::begin() {
     }
     
     //Prepare CAN general configuration
-    twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(gpio_num_t(_txPin), gpio_num_t(_rxPin), TWAI_MODE_NORMAL);
+    twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(gpio_num_t(_txPin), gpio_num_t(_rxPin), _listenOnly ? TWAI_MODE_LISTEN_ONLY : TWAI_MODE_NORMAL);
+    g_config.tx_queue_len = TX_HARDWARE_DEPTH;      // Frames are queued in priority order by the TX scheduler
     
     //Prepare CAN timing configuration based on selected baudrate
     twai_timing_config_t t_config;
@@ -111,12 +112,22 @@ bool ESP32_CANCore::begin() {
   }
 
   // CAN Status Meldungen konfigurieren
+  // The driver task waits for alerts, so it wakes up for received frames and for the end of a transmission
   uint32_t alerts_to_enable=0;
-  alerts_to_enable |= TWAI_ALERT_RX_DATA;           //set alert for received data
+  alerts_to_enable |= TWAI_ALERT_RX_DATA;          //set alert for received frames
+  alerts_to_enable |= TWAI_ALERT_TX_IDLE;          //set alert for finished transmissions
+  alerts_to_enable |= TWAI_ALERT_TX_SUCCESS;       //set alert for successful transmissions (transmit timestamps)
   alerts_to_enable |= TWAI_ALERT_ERR_PASS;          //set alert for error passive
   alerts_to_enable |= TWAI_ALERT_BUS_ERROR;        //set alert for bus error
   alerts_to_enable |= TWAI_ALERT_RX_QUEUE_FULL;    //set alert for RX queue full
   alerts_to_enable |= TWAI_ALERT_TX_FAILED;        //set alert for TX failed
+  alerts_to_enable |= TWAI_ALERT_ABOVE_ERR_WARN;   //set alert for error warning limit
+  alerts_to_enable |= TWAI_ALERT_ERR_ACTIVE;       //set alert for return to error active
+  alerts_to_enable |= TWAI_ALERT_BUS_OFF;          //set alert for bus-off
+  alerts_to_enable |= TWAI_ALERT_BUS_RECOVERED;    //set alert for finished bus-off recovery
+#ifdef TWAI_ALERT_RX_FIFO_OVERRUN
+  alerts_to_enable |= TWAI_ALERT_RX_FIFO_OVERRUN;  //set alert for hardware RX FIFO overrun
+#endif
   if (twai_reconfigure_alerts(alerts_to_enable, NULL) == ESP_OK) {
     INFO_PRINTLN("[ESP32_CANCore] CAN Alerts reconfigured");
   } else {
@@ -130,6 +141,26 @@ bool ESP32_CANCore::begin() {
     return false;
   }
   _isInitialized = true;
+  _status = STATUS_OK;
+  _statistics = {};
+  _rxBits = 0;
+  _txBits = 0;
+  _loadBits = 0;
+  _loadWindowStart = millis();
+  _busOffSince = 0;
+  _txInFlightValid = false;
+  _txTimestampReady = false;
+  if(_txMutex == nullptr) _txMutex = xSemaphoreCreateMutex();
+  if(_txMutex == nullptr) {
+    ERROR_PRINTLN("[ESP32_CANCore] Failed to create TX mutex.");
+    end();
+    return false;
+  }
+  _txScheduler.setLoadLimit(_txLoadPermille, _baudrate);
+  if(!startDriverTask()) {
+    end();
+    return false;
+  }
   INFO_PRINTLN("[ESP32_CANCore] CAN interface initialized.");
   return true;
 }
@@ -139,7 +170,16 @@ bool ESP32_CANCore::end() {
         ERROR_PRINTLN("[ESP32_CANCore] CAN interface not initialized.");
         return false;
     }
-    if(twai_stop() != ESP_OK) {
+    stopDriverTask();
+    _rxRing.clear();
+    lockTx();
+    _txScheduler.clear();
+    _txInFlightValid = false;
+    unlockTx();
+    //The driver is already stopped after bus-off, so a failing stop is only fatal in the running state
+    twai_status_info_t status_info;
+    bool running = twai_get_status_info(&status_info) == ESP_OK && status_info.state == TWAI_STATE_RUNNING;
+    if(twai_stop() != ESP_OK && running) {
         ERROR_PRINTLN("[ESP32_CANCore] Failed to stop TWAI driver.");
         return false;
     }
@@ -157,25 +197,27 @@ bool ESP32_CANCore::sendMessage(const CANMessage& message) {
         ERROR_PRINTLN("[ESP32_CANCore] CAN interface not initialized. Cannot send message.");
         return false;
     }
-
-    //Convert CANCore::CANMessage to twai_message_t
-    twai_message_t twai_msg;
-    twai_msg.identifier = message.id;
-    twai_msg.data_length_code = message.length;
-    memcpy(twai_msg.data, message.data, message.length);    //Copy message to twai_msg data array
-    twai_msg.flags = 0;
-    if(message.isExtended) {
-        twai_msg.flags |= TWAI_MSG_FLAG_EXTD;
+    if(_status == STATUS_BUS_OFF) {
+        DEBUG_PRINTLN("[ESP32_CANCore] Controller is bus-off. Message not sent.");
+        return false;
     }
-    if(message.isRemote) {
-        twai_msg.flags |= TWAI_MSG_FLAG_RTR;
+    if(_listenOnly) {
+        ERROR_PRINTLN("[ESP32_CANCore] Controller is in listen-only mode. Cannot send message.");
+        return false;
     }
 
-    if(twai_transmit(&twai_msg, pdMS_TO_TICKS(1000)) != ESP_OK) {
-        ERROR_PRINTLN("[ESP32_CANCore] Failed to transmit CAN message.");
+    //Queue the frame in priority order and hand it to the controller right away if it is idle
+    CANFrame frame = toFrame(message, micros());
+    lockTx();
+    bool queued = _txScheduler.push(frame);
+    if(queued) countTx(frame);
+    unlockTx();
+    if(!queued) {
+        ERROR_PRINTLN("[ESP32_CANCore] TX queue full of frames with higher priority. Cannot send message.");
         return false;
     }
-    DEBUG_PRINTLN("[ESP32_CANCore] CAN message transmitted. ID: " + String(message.id) + ", Length: " + String(message.length));
+    transmitPending();
+    DEBUG_PRINTLN("[ESP32_CANCore] CAN message queued. ID: " + String(message.id) + ", Length: " + String(message.length));
     return true;
 }
 
@@ -193,34 +235,35 @@ bool ESP32_CANCore::readMessage(CANMessage& message) {
         return false;
     }
 
-    //read ESP32 specific twai_message_t
-    if(available() == 0) {
+    CANFrame frame;
+    if(!_rxRing.pop(frame)) {
         ERROR_PRINTLN("[ESP32_CANCore] No CAN message available to read.");
         canMsg->error = true;
         return false;
     }
-
-    twai_message_t twai_msg;
-    if(twai_receive(&twai_msg, pdMS_TO_TICKS(1000)) != ESP_OK) {
-        ERROR_PRINTLN("[ESP32_CANCore] No CAN message available to read.");
-        canMsg->error = true;
-        return false;
-    }
-
-    //Convert twai_message_t to CANCore::CANMessage
-    canMsg->id = twai_msg.identifier;
-    canMsg->length = twai_msg.data_length_code;
-    memcpy(canMsg->data, twai_msg.data, twai_msg.data_length_code); //Copy data from twai_msg to canMsg
-    canMsg->isExtended = (twai_msg.flags & TWAI_MSG_FLAG_EXTD) != 0;
-    canMsg->isRemote = (twai_msg.flags & TWAI_MSG_FLAG_RTR) != 0;
+    fromFrame(frame, *canMsg);
 
     DEBUG_PRINTLN("[ESP32_CANCore] CAN message received. ID: " + String(canMsg->id) + ", Length: " + String(canMsg->length));
     return true;
 }
 
+/**
+ * @brief Read a received frame with the timestamp taken by the driver task.
+ *
+ * @param frame Destination of the frame.
+ * @return True if a frame was read, false otherwise.
+ */
+bool ESP32_CANCore::readFrame(CANFrame& frame) {
+    if(!_isInitialized) {
+        ERROR_PRINTLN("[ESP32_CANCore] CAN interface not initialized. Cannot read frame.");
+        return false;
+    }
+    return _rxRing.pop(frame);
+}
+
 /** 
  * @brief Check how many CAN messages are available to read.
- * @details Queries the TWAI status information to determine how many messages are currently in the RX queue.
+ * @details Returns the number of frames the driver task has moved into the RX ring.
  *
  * @return uint8_t Number of available messages to read.
  */
@@ -230,9 +273,8 @@ uint8_t ESP32_CANCore::available() {
         return 0;
     }
 
-    twai_status_info_t status_info;
-    twai_get_status_info(&status_info);
-    return status_info.msgs_to_rx;
+    size_t count = _rxRing.size();
+    return count > 255 ? 255 : count;
 }
 
 bool ESP32_CANCore::setupFilter(uint32_t id, uint32_t mask) {
@@ -245,3 +287,467 @@ bool ESP32_CANCore::reset() {
     return CANCore::reset();
 }
 
+/**
+ * @brief Attach a responder which is served by the driver task, see CANResponder.
+ * @details The periodic frames of the responder start immediately. The entries of the responder must not be changed while it is attached.
+ *
+ * @param responder Responder, nullptr to detach it.
+ * @return true
+ */
+bool ESP32_CANCore::setResponder(CANResponder* responder) {
+    if(responder) responder->restart();
+    _responder = responder;
+    return true;
+}
+
+/**
+ * @brief Timestamp the end of the transmission of frames with the given identifier, see readTxTimestamp().
+ * @details The timestamp is taken by the driver task when it reads the TX_SUCCESS alert of the frame.
+ *
+ * @param id Standard identifier.
+ * @return true
+ */
+bool ESP32_CANCore::enableTxTimestamp(uint32_t id) {
+    lockTx();
+    _txTimestampId = id;
+    _txTimestampReady = false;
+    unlockTx();
+    return true;
+}
+
+void ESP32_CANCore::disableTxTimestamp() {
+    lockTx();
+    _txTimestampId = TX_TIMESTAMP_DISABLED;
+    _txTimestampReady = false;
+    unlockTx();
+}
+
+/**
+ * @brief Read the last frame with the timestamped identifier which was transmitted successfully.
+ *
+ * @param frame Destination of the frame, the timestamp is the micros() time the driver task saw the end of the transmission.
+ * @return true if such a frame was transmitted since the last call.
+ */
+bool ESP32_CANCore::readTxTimestamp(CANFrame& frame) {
+    lockTx();
+    bool ready = _txTimestampReady;
+    if(ready) frame = _txTimestampFrame;
+    _txTimestampReady = false;
+    unlockTx();
+    return ready;
+}
+
+/**
+ * @brief Limit the rate of the frames matching (frame ID & mask) == (id & mask).
+ * @details Frames of a stream over its rate wait in the TX queue, frames with lower priority may pass them. See CANTxScheduler::addStream().
+ *
+ * @param id Identifier of the stream.
+ * @param mask Relevant identifier bits.
+ * @param intervalUs Minimum average time between two frames of the stream.
+ * @param burst Number of frames which may be sent back to back after the stream was idle.
+ * @return true if the stream was added.
+ */
+bool ESP32_CANCore::addTxStream(uint32_t id, uint32_t mask, uint32_t intervalUs, uint8_t burst) {
+    lockTx();
+    bool added = _txScheduler.addStream(id, mask, intervalUs, burst);
+    unlockTx();
+    if(!added) {
+        ERROR_PRINTLN("[ESP32_CANCore] Cannot add TX stream. Maximum of " + String(TxScheduler::MAX_STREAMS) + " streams reached or invalid interval.");
+    }
+    return added;
+}
+
+void ESP32_CANCore::clearTxStreams() {
+    lockTx();
+    _txScheduler.clearStreams();
+    unlockTx();
+}
+
+/**
+ * @brief Limit the bus load caused by the frames sent by this node.
+ * @details Frames exceeding the limit wait in the TX queue. The limit is based on the worst case frame length including stuff bits.
+ *
+ * @param permille Share of the bitrate, 1000 disables the limit.
+ */
+void ESP32_CANCore::setTxLoadLimit(uint16_t permille) {
+    _txLoadPermille = permille;
+    if(_baudrate == BR_NOT_SET) return;
+    lockTx();
+    _txScheduler.setLoadLimit(permille, _baudrate);
+    unlockTx();
+}
+
+/**
+ * @brief Get the statistics of the TX queue, including the longest time a frame waited for the controller.
+ */
+ESP32_CANCore::TxScheduler::Statistics ESP32_CANCore::getTxStatistics() {
+    lockTx();
+    TxScheduler::Statistics statistics = _txScheduler.getStatistics();
+    unlockTx();
+    return statistics;
+}
+
+void ESP32_CANCore::resetTxStatistics() {
+    lockTx();
+    _txScheduler.resetStatistics();
+    unlockTx();
+}
+
+/**
+ * @brief Initiate the bus-off recovery manually.
+ * @details Only needed if automatic recovery is disabled with setAutoRecovery(false). The controller is restarted by the driver task once the recovery is finished.
+ *
+ * @return true if the recovery was initiated.
+ * @return false if the controller is not bus-off.
+ */
+bool ESP32_CANCore::recover() {
+    if(!_isInitialized || _status != STATUS_BUS_OFF) {
+        ERROR_PRINTLN("[ESP32_CANCore] Controller is not bus-off. Nothing to recover.");
+        return false;
+    }
+    _lastRecoveryAttempt = millis();
+    if(twai_initiate_recovery() != ESP_OK) {
+        ERROR_PRINTLN("[ESP32_CANCore] Failed to initiate bus-off recovery.");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Start the driver task.
+ * @details The task is not pinned to a core and is stopped by end().
+ *
+ * @return true if the task was created.
+ */
+bool ESP32_CANCore::startDriverTask() {
+    _driverTaskRunning = true;
+    if(xTaskCreatePinnedToCore(driverTask, "can_driver", DRIVER_TASK_STACK_SIZE, this, DRIVER_TASK_PRIORITY, &_driverTask, tskNO_AFFINITY) != pdPASS) {
+        ERROR_PRINTLN("[ESP32_CANCore] Failed to create driver task.");
+        _driverTaskRunning = false;
+        _driverTask = nullptr;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Stop the driver task and wait until it has left the TWAI driver.
+ * @details The task finishes its current iteration, which blocks for at most DRIVER_WAIT_MS. It is never deleted from outside,
+ *          since it could hold the TX mutex or be inside a driver call.
+ */
+void ESP32_CANCore::stopDriverTask() {
+    if(_driverTask == nullptr) return;
+    _driverTaskRunning = false;
+    bool reported = false;
+    for(uint32_t waited = 0; _driverTask != nullptr; waited += 5) {
+        if(!reported && waited >= 20 * DRIVER_WAIT_MS) {
+            DEV_ERROR_PRINTLN("[ESP32_CANCore] Driver task did not stop in time. Still waiting.");
+            reported = true;
+        }
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+}
+
+/**
+ * @brief Driver task main loop.
+ * @details Handles pending alerts, moves queued frames into the TWAI driver and received frames into the RX ring,
+ *          then updates status, statistics and bus load. Blocks in twai_read_alerts() until a frame was received,
+ *          a transmission finished or another alert occurred.
+ *
+ * @param parameter Pointer to the owning ESP32_CANCore.
+ */
+void ESP32_CANCore::driverTask(void* parameter) {
+    ESP32_CANCore* core = static_cast<ESP32_CANCore*>(parameter);
+    while(core->_driverTaskRunning) {
+        //Frames held back by a rate limit are checked again after one tick, the task also wakes up for the next periodic frame
+        uint32_t alerts = 0;
+        TickType_t wait = core->_txScheduler.empty() ? pdMS_TO_TICKS(DRIVER_WAIT_MS) : 1;
+        CANResponder* responder = core->_responder;
+        if(responder) {
+            TickType_t periodic = pdMS_TO_TICKS(responder->getTimeToNext(millis(), DRIVER_WAIT_MS));
+            if(periodic < wait) wait = periodic;
+        }
+        if(twai_read_alerts(&alerts, wait) == ESP_OK) {
+            core->handleAlerts(alerts);
+        }
+        core->receivePending(0);
+        core->sendPeriodic();
+        core->transmitPending();
+        core->updateStatus();
+        core->updateBusLoad();
+    }
+    core->_driverTask = nullptr;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Hand a frame to the TWAI driver.
+ *
+ * @param frame Frame to transmit.
+ * @param wait Maximum time to wait for space in the TWAI TX queue.
+ * @return true if the driver accepted the frame.
+ */
+bool ESP32_CANCore::transmitFrame(const CANFrame& frame, TickType_t wait) {
+    twai_message_t twai_msg = {};
+    twai_msg.identifier = frame.getId();
+    twai_msg.data_length_code = frame.getLength();
+    memcpy(twai_msg.data, frame.data, frame.getLength());
+    if(frame.isExtended()) {
+        twai_msg.flags |= TWAI_MSG_FLAG_EXTD;
+    }
+    if(frame.isRemote()) {
+        twai_msg.flags |= TWAI_MSG_FLAG_RTR;
+    }
+    return twai_transmit(&twai_msg, wait) == ESP_OK;
+}
+
+/**
+ * @brief Hand the queued frames with the highest priority to the TWAI driver while fewer than TX_HARDWARE_DEPTH frames are pending.
+ * @details Called by sendMessage() and the driver task. The controller transmits one frame at a time, so the next frame is selected
+ *          only when the previous one is done and a high-priority frame never waits behind more than one frame of this node.
+ *          With transmit timestamps enabled, the next frame additionally waits until the driver task handled the end of the previous one.
+ */
+void ESP32_CANCore::transmitPending() {
+    lockTx();
+    twai_status_info_t info;
+    while(twai_get_status_info(&info) == ESP_OK && info.state == TWAI_STATE_RUNNING && info.msgs_to_tx < TX_HARDWARE_DEPTH) {
+        if(_txTimestampId != TX_TIMESTAMP_DISABLED && _txInFlightValid) break;
+        uint32_t now = micros();
+        const CANFrame* frame = _txScheduler.peek(now);
+        if(frame == nullptr || !transmitFrame(*frame, 0)) break;
+        _txInFlight = *frame;
+        _txInFlightValid = true;
+        _txScheduler.drop(now);
+    }
+    unlockTx();
+}
+
+void ESP32_CANCore::lockTx() {
+    if(_txMutex) xSemaphoreTake(_txMutex, portMAX_DELAY);
+}
+
+void ESP32_CANCore::unlockTx() {
+    if(_txMutex) xSemaphoreGive(_txMutex);
+}
+
+/**
+ * @brief Move received frames from the TWAI driver into the RX ring.
+ * @details Frames received while the RX ring is full are lost and counted as RX overruns.
+ *
+ * @param wait Maximum time to wait for the first frame.
+ */
+void ESP32_CANCore::receivePending(TickType_t wait) {
+    twai_message_t twai_msg;
+    while(twai_receive(&twai_msg, wait) == ESP_OK) {
+        wait = 0;
+        CANFrame frame;
+        bool remote = (twai_msg.flags & TWAI_MSG_FLAG_RTR) != 0;
+        frame.set(twai_msg.identifier, (twai_msg.flags & TWAI_MSG_FLAG_EXTD) != 0, remote, twai_msg.data, twai_msg.data_length_code, micros());
+        portENTER_CRITICAL(&_statisticsMux);
+        _statistics.rxFrames++;
+        portEXIT_CRITICAL(&_statisticsMux);
+        _rxBits += getFrameBits(remote ? 0 : frame.getLength(), frame.isExtended());
+        CANResponder* responder = _responder;
+        CANFrame response;
+        if(remote && responder && responder->handleRemote(frame, response)) {
+            queueResponse(response);
+            continue;
+        }
+        _rxRing.push(frame);
+    }
+}
+
+/**
+ * @brief Queue a frame built by the responder (driver task).
+ * @details The frame is handed to the controller with the next call of transmitPending(). Nothing is sent in listen-only mode
+ *          or while the controller is bus-off.
+ *
+ * @param frame Frame to transmit.
+ */
+void ESP32_CANCore::queueResponse(const CANFrame& frame) {
+    if(_listenOnly || _status == STATUS_BUS_OFF) return;
+    CANFrame queued = frame;
+    queued.setTimestamp(micros());
+    lockTx();
+    if(_txScheduler.push(queued)) countTx(queued);
+    unlockTx();
+}
+
+/**
+ * @brief Count a queued frame for the statistics and the bus load.
+ * @details Called by the loop task and the driver task, always with the TX mutex held.
+ */
+void ESP32_CANCore::countTx(const CANFrame& frame) {
+    portENTER_CRITICAL(&_statisticsMux);
+    _statistics.txFrames++;
+    portEXIT_CRITICAL(&_statisticsMux);
+    _txBits += getFrameBits(frame.isRemote() ? 0 : frame.getLength(), frame.isExtended());
+}
+
+/**
+ * @brief Queue the periodic frames of the responder which are due (driver task).
+ */
+void ESP32_CANCore::sendPeriodic() {
+    CANResponder* responder = _responder;
+    if(responder == nullptr) return;
+    CANFrame frame;
+    while(responder->nextPeriodic(millis(), frame)) {
+        queueResponse(frame);
+    }
+}
+
+/**
+ * @brief Handle TWAI alerts.
+ * @details On bus-off the recovery is initiated. Once the controller reports the recovery as finished, it is restarted.
+ *          The controller needs 128 occurrences of 11 recessive bits to recover, i.e. about 11 ms at 125 kbit/s.
+ *
+ * @param alerts Alert flags read from the driver.
+ */
+void ESP32_CANCore::handleAlerts(uint32_t alerts) {
+    if(alerts & (TWAI_ALERT_TX_SUCCESS | TWAI_ALERT_TX_FAILED)) {
+        completeTx((alerts & TWAI_ALERT_TX_SUCCESS) != 0, micros());
+    }
+    if(alerts & TWAI_ALERT_BUS_OFF) {
+        //The controller discards its TX queue
+        completeTx(false, 0);
+        portENTER_CRITICAL(&_statisticsMux);
+        _statistics.busOffCount++;
+        _status = STATUS_BUS_OFF;
+        portEXIT_CRITICAL(&_statisticsMux);
+        _busOffSince = millis();
+        WARNING_PRINTLN("[ESP32_CANCore] Controller is bus-off.");
+        if(_autoRecovery) {
+            _lastRecoveryAttempt = millis();
+            if(twai_initiate_recovery() != ESP_OK) {
+                ERROR_PRINTLN("[ESP32_CANCore] Failed to initiate bus-off recovery.");
+            }
+        }
+    }
+    if(alerts & TWAI_ALERT_BUS_RECOVERED) {
+        if(twai_start() == ESP_OK) {
+            uint32_t recoveryMs = millis() - _busOffSince;
+            portENTER_CRITICAL(&_statisticsMux);
+            _statistics.lastRecoveryMs = recoveryMs;
+            portEXIT_CRITICAL(&_statisticsMux);
+            _busOffSince = 0;
+            INFO_PRINTLN("[ESP32_CANCore] Recovered from bus-off after " + String(recoveryMs) + " ms.");
+        } else {
+            ERROR_PRINTLN("[ESP32_CANCore] Failed to restart TWAI driver after bus-off recovery.");
+        }
+    }
+    if(alerts & TWAI_ALERT_ERR_PASS) {
+        WARNING_PRINTLN("[ESP32_CANCore] Controller is error passive.");
+    }
+    if(alerts & TWAI_ALERT_RX_QUEUE_FULL) {
+        DEBUG_PRINTLN("[ESP32_CANCore] RX queue full, frames are dropped.");
+    }
+}
+
+/**
+ * @brief Handle the end of the transmission of the frame in the controller (driver task).
+ * @details Stores the frame with the timestamped identifier for readTxTimestamp().
+ *
+ * @param success True if the frame was transmitted successfully.
+ * @param timestamp micros() time the driver task read the alert.
+ */
+void ESP32_CANCore::completeTx(bool success, uint32_t timestamp) {
+    lockTx();
+    if(success && _txInFlightValid && !_txInFlight.isExtended() && _txInFlight.getId() == _txTimestampId) {
+        _txTimestampFrame = _txInFlight;
+        _txTimestampFrame.setTimestamp(timestamp);
+        _txTimestampReady = true;
+    }
+    _txInFlightValid = false;
+    unlockTx();
+}
+
+/**
+ * @brief Update error counters and status from the driver and supervise a running bus-off recovery.
+ * @details If the controller stays bus-off for RECOVERY_RETRY_MS, the recovery is initiated again. If it stopped after
+ *          recovery without being restarted, it is started again. This bounds the downtime after a bus-off.
+ */
+void ESP32_CANCore::updateStatus() {
+    twai_status_info_t info;
+    if(twai_get_status_info(&info) != ESP_OK) return;
+
+    uint32_t rxOverruns = info.rx_missed_count + info.rx_overrun_count + _rxRing.getDropped();
+    portENTER_CRITICAL(&_statisticsMux);
+    _statistics.txErrorCounter = info.tx_error_counter > 255 ? 255 : info.tx_error_counter;
+    _statistics.rxErrorCounter = info.rx_error_counter > 255 ? 255 : info.rx_error_counter;
+    _statistics.txFailed = info.tx_failed_count;
+    _statistics.rxOverruns = rxOverruns;
+    _statistics.busErrors = info.bus_error_count;
+    _statistics.arbitrationLost = info.arb_lost_count;
+    portEXIT_CRITICAL(&_statisticsMux);
+
+    uint32_t now = millis();
+    switch(info.state) {
+        case TWAI_STATE_BUS_OFF:
+            setStatus(STATUS_BUS_OFF);
+            if(_autoRecovery && now - _lastRecoveryAttempt >= RECOVERY_RETRY_MS) {
+                _lastRecoveryAttempt = now;
+                twai_initiate_recovery();
+            }
+            return;
+        case TWAI_STATE_RECOVERING:
+            setStatus(STATUS_BUS_OFF);
+            return;
+        case TWAI_STATE_STOPPED:
+            if(_busOffSince != 0 && now - _lastRecoveryAttempt >= RECOVERY_RETRY_MS) {
+                _lastRecoveryAttempt = now;
+                handleAlerts(TWAI_ALERT_BUS_RECOVERED);
+            }
+            return;
+        default:
+            break;
+    }
+
+    uint32_t counter = info.tx_error_counter > info.rx_error_counter ? info.tx_error_counter : info.rx_error_counter;
+    if(counter >= 128) setStatus(STATUS_ERROR_PASSIVE);
+    else if(counter >= 96) setStatus(STATUS_ERROR_ACTIVE);
+    else setStatus(STATUS_OK);
+}
+
+void ESP32_CANCore::setStatus(Status status) {
+    portENTER_CRITICAL(&_statisticsMux);
+    _status = status;
+    portEXIT_CRITICAL(&_statisticsMux);
+}
+
+/**
+ * @brief Get the bus status, see updateStatus().
+ */
+CANCore::Status ESP32_CANCore::getStatus() const {
+    portENTER_CRITICAL(&_statisticsMux);
+    Status status = _status;
+    portEXIT_CRITICAL(&_statisticsMux);
+    return status;
+}
+
+/**
+ * @brief Get a consistent copy of the statistics, which the driver task updates while the loop task reads them.
+ */
+CANCore::Statistics ESP32_CANCore::getStatistics() const {
+    portENTER_CRITICAL(&_statisticsMux);
+    Statistics statistics = _statistics;
+    portEXIT_CRITICAL(&_statisticsMux);
+    return statistics;
+}
+
+/**
+ * @brief Update the bus load estimate once per BUS_LOAD_WINDOW_MS.
+ * @details Based on the worst case bit count of the frames read and sent by this node, so frames dropped by the
+ *          acceptance filter or not read by the application are not included.
+ */
+void ESP32_CANCore::updateBusLoad() {
+    uint32_t now = millis();
+    uint32_t elapsed = now - _loadWindowStart;
+    if(elapsed < BUS_LOAD_WINDOW_MS || _baudrate == BR_NOT_SET) return;
+    uint32_t bits = _rxBits + _txBits;
+    uint64_t load = uint64_t(bits - _loadBits) * 1000000ULL / (uint64_t(_baudrate) * elapsed);
+    portENTER_CRITICAL(&_statisticsMux);
+    _statistics.busLoad = load > 1000 ? 1000 : load;
+    portEXIT_CRITICAL(&_statisticsMux);
+    _loadBits = bits;
+    _loadWindowStart = now;
+}
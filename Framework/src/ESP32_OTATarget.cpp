@@ -0,0 +1,93 @@
+#include "ESP32_OTATarget.h"
+
+/**
+ * @brief Open the inactive OTA partition for a new image.
+ *
+ * @param size Size of the image in bytes.
+ * @return false if there is no OTA partition, the image does not fit or the partition cannot be opened.
+ */
+bool ESP32_OTATarget::begin(uint32_t size) {
+    abort();
+    _partition = esp_ota_get_next_update_partition(nullptr);
+    if(_partition == nullptr) {
+        ERROR_PRINTLN("[ESP32_OTATarget] No OTA partition available.");
+        return false;
+    }
+    if(size > _partition->size) {
+        ERROR_PRINTLN("[ESP32_OTATarget] Image of " + String(size) + " bytes does not fit into partition " + String(_partition->label) + ".");
+        return false;
+    }
+    //Sectors are erased while writing, so begin() returns immediately
+    esp_err_t err = esp_ota_begin(_partition, OTA_WITH_SEQUENTIAL_WRITES, &_handle);
+    if(err != ESP_OK) {
+        ERROR_PRINTLN("[ESP32_OTATarget] esp_ota_begin failed: " + String(esp_err_to_name(err)));
+        return false;
+    }
+    _open = true;
+    _size = size;
+    _written = 0;
+    INFO_PRINTLN("[ESP32_OTATarget] Writing " + String(size) + " bytes to partition " + String(_partition->label) + ".");
+    return true;
+}
+
+bool ESP32_OTATarget::write(uint32_t offset, const uint8_t* data, size_t length) {
+    if(!_open || offset != _written || _written + length > _size) {
+        ERROR_PRINTLN("[ESP32_OTATarget] Write outside of the image or partition not open.");
+        return false;
+    }
+    esp_err_t err = esp_ota_write(_handle, data, length);
+    if(err != ESP_OK) {
+        ERROR_PRINTLN("[ESP32_OTATarget] esp_ota_write failed: " + String(esp_err_to_name(err)));
+        return false;
+    }
+    _written += length;
+    return true;
+}
+
+/**
+ * @brief Close the partition. The ESP-IDF validates the image.
+ *
+ * @return false if the image is incomplete or invalid.
+ */
+bool ESP32_OTATarget::finish() {
+    if(!_open || _written != _size) {
+        ERROR_PRINTLN("[ESP32_OTATarget] Image incomplete.");
+        return false;
+    }
+    _open = false;
+    esp_err_t err = esp_ota_end(_handle);
+    if(err != ESP_OK) {
+        ERROR_PRINTLN("[ESP32_OTATarget] Image rejected: " + String(esp_err_to_name(err)));
+        return false;
+    }
+    _finished = true;
+    return true;
+}
+
+/**
+ * @brief Select the new partition for the next boot. The running firmware continues until the application restarts.
+ *
+ * @return false if the boot partition could not be changed.
+ */
+bool ESP32_OTATarget::activate() {
+    if(!_finished) return false;
+    esp_err_t err = esp_ota_set_boot_partition(_partition);
+    if(err != ESP_OK) {
+        ERROR_PRINTLN("[ESP32_OTATarget] esp_ota_set_boot_partition failed: " + String(esp_err_to_name(err)));
+        return false;
+    }
+    _finished = false;
+    INFO_PRINTLN("[ESP32_OTATarget] Partition " + String(_partition->label) + " is booted after the next restart.");
+    return true;
+}
+
+void ESP32_OTATarget::abort() {
+    if(_open) esp_ota_abort(_handle);
+    _open = false;
+    _finished = false;
+}
+
+uint32_t ESP32_OTATarget::getCapacity() const {
+    const esp_partition_t* partition = esp_ota_get_next_update_partition(nullptr);
+    return partition ? partition->size : 0;
+}
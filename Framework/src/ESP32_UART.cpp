@@ -11,6 +11,7 @@
  */
 bool ESP32_UART::reset(){
     UARTCore::reset();
+    stopRxTask();
     if(_state == NONE) {
         DEBUG_PRINTLN("[ESP32_UART] UART already in NONE state, nothing to reset.");
         return true; // Nothing to reset
@@ -21,6 +22,23 @@ bool ESP32_UART::reset(){
         return true; // Nothing to reset
     }
     INFO_PRINTLN("[ESP32_UART] Resetting UART " + String(_uartPort) + "...");
+    _txRing.clear();
+    _txActive = false;
+    _txStarted = false;
+    _txBufferUsed = 0;
+    _txWakeup = false;
+    if(_rs485) {
+        _rs485 = false;
+        applyMode();
+    }
+    if(_patternDetection) {
+        uart_disable_pattern_det_intr(_uartPort);
+        _patternDetection = false;
+    }
+    _fifoConfig = FifoConfig();
+    _latencyMeasurement = false;
+    _awaitingResponse = false;
+    _rxRing.clear();
     ESP_ERROR_CHECK(uart_flush(_uartPort));
     ESP_ERROR_CHECK(uart_flush_input(_uartPort));
     ESP_ERROR_CHECK(uart_driver_delete(_uartPort));
@@ -28,10 +46,33 @@ bool ESP32_UART::reset(){
     _rxPin = DEFAULT_REF;
     _txPin = DEFAULT_REF;
     _uartPort = DEFAULT_REF;
+    uart_queue = nullptr;
     INFO_PRINTLN("[ESP32_UART] UART Reset complete");
     return true;
 }
 
+/**
+ * @brief Return to the state of a new instance.
+ * @details Stops the receive task and deletes the driver like reset(), then restores the default settings and removes the
+ *          callbacks. Use it instead of assigning a new instance, which would place a temporary with the RX and TX rings on
+ *          the stack of the calling task.
+ */
+void ESP32_UART::restoreDefaults(){
+    reset();
+    restoreSettings();
+    _state = NONE;
+    uart_queue = nullptr;
+    _uartPort = DEFAULT_REF;
+    _receiveCallback = nullptr;
+    _txDoneCallback = nullptr;
+    _nonBlocking = false;
+    _latencyMeasurement = false;
+    _rxStatistics = {};
+    _txStatistics = {};
+    _latency = {};
+    _collisions = 0;
+}
+
 /**
  * @brief Install the UART driver and prepare the instance.
  * @details Installs the UART driver for the given uart_num if not already installed,
@@ -48,7 +89,7 @@ bool ESP32_UART::install(int uart_num, uint8_t tx_pin, uint8_t rx_pin, uint16_t
 
     //Install UART driver
     if(!uart_is_driver_installed(uart_num)) {
-        ESP_ERROR_CHECK(uart_driver_install(uart_num, bufferSize, bufferSize, 10, &uart_queue, 0));
+        ESP_ERROR_CHECK(uart_driver_install(uart_num, bufferSize, bufferSize, EVENT_QUEUE_SIZE, &uart_queue, 0));
         if(!uart_is_driver_installed(uart_num)) {
             ERROR_PRINTLN("[ESP32_UART] Failed to install UART driver");
             return false;
@@ -58,6 +99,7 @@ bool ESP32_UART::install(int uart_num, uint8_t tx_pin, uint8_t rx_pin, uint16_t
     _rxPin = rx_pin;
     _txPin = tx_pin;
     _uartPort = uart_num;
+    _txBufferSize = bufferSize;
     _state = INSTALLED;
     return true;
 }
@@ -97,8 +139,9 @@ bool ESP32_UART::applyConfig() {
 
 /**
  * @brief Set TX and RX pins and start the UART peripheral.
- * @details Configures the UART peripheral to use the provided pins and transitions the state to STARTED.
- *          Requires the instance to be in CONFIGURED state.
+ * @details Configures the UART peripheral to use the provided pins, starts the receive task and transitions the state to STARTED.
+ *          Requires the instance to be in CONFIGURED state. Without the receive task, e.g. if the driver was installed
+ *          elsewhere and its event queue is unknown, read() and available() access the driver directly.
  * @param tx_pin GPIO pin number to use for TX.
  * @param rx_pin GPIO pin number to use for RX.
  * @return true if pins were set and UART started successfully, false otherwise.
@@ -117,6 +160,12 @@ bool ESP32_UART::applyPins(int tx_pin, int rx_pin) {
     }
     
     _state = STARTED;
+    if(_rs485 && !applyMode()) return false;
+    if(_patternDetection && !applyPatternDetection()) return false;
+    if(!applyFifoConfig()) return false;
+    if(!startRxTask()) {
+        WARNING_PRINTLN("[ESP32_UART] Receive task not started, reading from the driver directly.");
+    }
     INFO_PRINTLN("[ESP32_UART] UART started successfully on TX pin " + String(tx_pin) + " and RX pin " + String(rx_pin));
     return true;
 }
@@ -131,12 +180,38 @@ bool ESP32_UART::applyPins() {
 }
 
 
+/**
+ * @brief Set the TX and RX pins.
+ * @details Before the UART is started, the pins are only stored and applied by install() and applyPins(). While it is started,
+ *          the UART is routed to the new pins through the GPIO matrix, e.g. to switch between segments sharing the port, see
+ *          UARTMultiplexer. The former TX pin is released and held at the idle level. Call only while no transmission is in progress.
+ * @param tx_pin GPIO pin number to use for TX.
+ * @param rx_pin GPIO pin number to use for RX.
+ * @return true if the pins were set.
+ */
+bool ESP32_UART::setPins(uint8_t tx_pin, uint8_t rx_pin) {
+    if(_state != STARTED) return UARTCore::setPins(tx_pin, rx_pin);
+    if(tx_pin == _txPin && rx_pin == _rxPin) return true;
+    int8_t previousTxPin = _txPin;
+    if(uart_set_pin(_uartPort, tx_pin, rx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK) {
+        ERROR_PRINTLN("[ESP32_UART] Failed to route UART " + String(_uartPort) + " to TX pin " + String(tx_pin) + " and RX pin " + String(rx_pin));
+        return false;
+    }
+    if(previousTxPin != DEFAULT_REF && previousTxPin != tx_pin) {
+        gpio_reset_pin(static_cast<gpio_num_t>(previousTxPin));
+        gpio_set_direction(static_cast<gpio_num_t>(previousTxPin), GPIO_MODE_OUTPUT);
+        gpio_set_level(static_cast<gpio_num_t>(previousTxPin), 1);
+    }
+    return UARTCore::setPins(tx_pin, rx_pin);
+}
+
 /**
  * @brief Send a buffer of bytes over UART.
- * @details Writes the provided buffer to the UART transmit queue. Requires the UART to be STARTED.
+ * @details Writes the provided buffer to the UART transmit queue and blocks while the driver's transmit buffer is full.
+ *          In non-blocking mode the buffer is queued in the TX ring as a whole and send() never waits. Requires the UART to be STARTED.
  * @param buffer Character buffer containing bytes to send.
  * @param size Number of bytes to send from the buffer.
- * @return true if data was queued/sent successfully, false otherwise.
+ * @return true if data was queued/sent successfully, false otherwise, e.g. if the TX ring cannot take the buffer.
  */
 bool ESP32_UART::send(const char buffer[], size_t size) {
     UARTCore::send(buffer, size);
@@ -144,54 +219,685 @@ bool ESP32_UART::send(const char buffer[], size_t size) {
         ERROR_PRINTLN("[ESP32_UART] UART must be started before sending data");
         return false;
     }
-    int len = uart_write_bytes(_uartPort, buffer, size);
+    if(isQueuing()) {
+        if(_txRing.free() < size) {
+            _txStatistics.rejected += size;
+            return false;
+        }
+        queueTx(reinterpret_cast<const uint8_t*>(buffer), size);
+        return true;
+    }
+    if(_rs485) {
+        checkCollision();
+        uint32_t wait = turnaroundRemaining();
+        if(wait > 0) delayMicroseconds(wait);
+    }
+    int len = writeDriver(buffer, size);
     if(len < 0) {
         ERROR_PRINTLN("[ESP32_UART] Failed to send data over UART");
         return false;
     }
+    markRequest(len);
+    if(_rs485 && _rs485Config.collisionDetection) _txPending = true;
+    _txStarted = true;
+    wakeTask();
     return true;
 }
 
+/**
+ * @brief Queue bytes for transmission without blocking.
+ * @details Accepts as many bytes as the driver's transmit buffer has room for, so uart_write_bytes() never waits.
+ *          In RS-485 mode nothing is accepted until the turnaround time after the last received byte has passed.
+ *          In non-blocking mode the bytes are queued in the TX ring instead, which also covers the turnaround.
+ * @param data Bytes to send.
+ * @param length Number of bytes to send.
+ * @return size_t Number of bytes accepted.
+ */
+size_t ESP32_UART::write(const uint8_t* data, size_t length){
+    if(_state != STARTED) {
+        ERROR_PRINTLN("[ESP32_UART] UART must be started before sending data");
+        return 0;
+    }
+    if(isQueuing()) return queueTx(data, length);
+    if(_rs485) {
+        checkCollision();
+        if(turnaroundRemaining() > 0) return 0;
+    }
+    size_t space = txBufferSpace();
+    if(length > space) length = space;
+    if(length == 0) return 0;
+    int written = writeDriver(data, length);
+    if(written <= 0) return 0;
+    markRequest(written);
+    if(_rs485 && _rs485Config.collisionDetection) _txPending = true;
+    _txStarted = true;
+    wakeTask();
+    return written;
+}
+
 /**
  * @brief Read available bytes from UART into buffer.
- * @details Attempts to read up to the number of bytes currently available. Requires UART to be STARTED.
- * @param buffer Destination buffer to receive bytes.
+ * @details Takes all bytes the receive task has moved into the RX ring and never blocks. Requires UART to be STARTED.
+ * @param buffer Destination buffer to receive bytes, with room for available() bytes.
  * @return size_t Number of bytes read into the buffer (0 if none).
  */
 size_t ESP32_UART::read(char buffer[]){
-    UARTCore::read(buffer);
+    return read(reinterpret_cast<uint8_t*>(buffer), available());
+}
+
+/**
+ * @brief Read received bytes without blocking.
+ * @param buffer Destination buffer.
+ * @param capacity Size of the destination buffer.
+ * @return size_t Number of bytes read, at most capacity.
+ */
+size_t ESP32_UART::read(uint8_t* buffer, size_t capacity){
     if(_state != STARTED) {
         ERROR_PRINTLN("[ESP32_UART] UART must be started before reading data");
         return 0;
     }
+    if(_rxTask != nullptr) {
+        size_t length = _rxRing.read(buffer, capacity);
+        _frames.consume(length);
+        return length;
+    }
 
     size_t num = available();
+    if(num > capacity) num = capacity;
     if(num == 0) return 0;
+    int received = uart_read_bytes(_uartPort, buffer, num, 0);
+    return received > 0 ? received : 0;
+}
 
-    num = uart_read_bytes(_uartPort,buffer,num,100);
-    return num;
+/**
+ * @brief Get the oldest received bytes in the RX ring without copying them.
+ * @details Only available while the receive task is running.
+ * @param data Set to the oldest byte, valid until consume(), read() or flush() is called.
+ * @return size_t Number of contiguous bytes at data.
+ */
+size_t ESP32_UART::peek(const uint8_t*& data){
+    if(_rxTask == nullptr) {
+        data = nullptr;
+        return 0;
+    }
+    return _rxRing.peek(data);
+}
+
+/**
+ * @brief Remove bytes from the RX ring after peek().
+ */
+void ESP32_UART::consume(size_t length){
+    if(_rxTask == nullptr) return;
+    _rxRing.consume(length);
+    _frames.consume(length);
 }
 
 /**
  * @brief Get number of bytes available to read.
- * @details Queries the UART driver's buffered data length and returns the number of bytes ready for reading.
+ * @details Returns the number of bytes in the RX ring, or the driver's buffered data length without receive task.
  * @return size_t Number of bytes available.
  */
 size_t ESP32_UART::available(){
-    size_t receivedBytes;
-    ESP_ERROR_CHECK(uart_get_buffered_data_len(_uartPort,&receivedBytes));
-    DEBUG_PRINTLN("[ESP32_UART] Bytes available: " + String(receivedBytes));
+    if(_rxTask != nullptr) return _rxRing.size();
+    size_t receivedBytes = 0;
+    if(_state == NONE || uart_get_buffered_data_len(_uartPort, &receivedBytes) != ESP_OK) return 0;
     return receivedBytes;
 }
 
 /**
  * @brief Flush UART RX and TX buffers.
- * @details Ensures any queued transmit data is flushed and input buffers are cleared.
+ * @details Waits until queued transmit data, including the TX ring, is sent and discards the received bytes in the driver and
+ *          in the RX ring. The discarded bytes are counted like read bytes, so the frame ends of later frames stay valid.
  * @return void
  */
 void ESP32_UART::flush(){
+    while(_rxTask != nullptr && !_txRing.empty()) vTaskDelay(TX_WAIT_TICKS);
     ESP_ERROR_CHECK(uart_flush(_uartPort));
     ESP_ERROR_CHECK(uart_flush_input(_uartPort));
+    size_t discarded = _rxRing.size();
+    _rxRing.consume(discarded);
+    _frames.consume(discarded);
     DEBUG_PRINTLN("[ESP32_UART] UART RX & TX buffer flushed");
 }
 
+/**
+ * @brief Register a callback for received data.
+ * @details The callback is called by the receive task after new bytes were moved into the RX ring. It must be set while the
+ *          UART is not started, i.e. before the module is initialized.
+ * @param callback Callback with the number of bytes available, nullptr to remove it.
+ * @return true if the callback was set.
+ */
+bool ESP32_UART::setReceiveCallback(ReceiveCallback callback){
+    if(_rxTask != nullptr) {
+        ERROR_PRINTLN("[ESP32_UART] Receive callback must be set before the UART is started");
+        return false;
+    }
+    _receiveCallback = callback;
+    return true;
+}
+
+/**
+ * @brief Let send() and write() queue the bytes in the TX ring instead of waiting for the driver.
+ * @details The receive task moves the bytes from the ring into the driver's transmit buffer as it gets room. Needs the receive
+ *          task: without it, e.g. if the driver was installed elsewhere, send() keeps blocking. The mode can only be left while
+ *          the ring is empty, so queued bytes are not overtaken.
+ * @param enabled true for non-blocking mode.
+ * @return true if the mode was set.
+ */
+bool ESP32_UART::setNonBlockingSend(bool enabled){
+    if(!enabled && !_txRing.empty()) {
+        ERROR_PRINTLN("[ESP32_UART] Non-blocking mode cannot be left while " + String(_txRing.size()) + " bytes are queued");
+        return false;
+    }
+    _nonBlocking = enabled;
+    return true;
+}
+
+/**
+ * @brief Register a callback for the end of a transmission.
+ * @details Called by the receive task once all bytes written with send() or write() have left the transmitter, at most one tick
+ *          after the last stop bit. Consecutive writes without idle line in between are one transmission. It must be set while
+ *          the UART is not started, like the receive callback.
+ * @param callback Callback, nullptr to remove it.
+ * @return true if the callback was set.
+ */
+bool ESP32_UART::setTxDoneCallback(TxDoneCallback callback){
+    if(_rxTask != nullptr) {
+        ERROR_PRINTLN("[ESP32_UART] TX-done callback must be set before the UART is started");
+        return false;
+    }
+    _txDoneCallback = callback;
+    return true;
+}
+
+/**
+ * @brief Check whether the TX ring is empty and the driver has transmitted all bytes, i.e. the line is idle.
+ */
+bool ESP32_UART::isTxDone(){
+    if(_state != STARTED) return true;
+    return _txRing.empty() && uart_wait_tx_done(_uartPort, 0) == ESP_OK;
+}
+
+/**
+ * @brief Switch between standard UART mode and RS-485 half-duplex mode.
+ * @details Uses UART_MODE_RS485_HALF_DUPLEX of the ESP-IDF driver: the RTS output is routed to config.dePin and drives the driver
+ *          enable of the transceiver. The driver asserts it when the transmission starts and releases it after the last stop bit,
+ *          so the line is free for the response without software direction switching.
+ *          - Turnaround: write() accepts nothing and send() waits until config.turnaroundUs have passed since the receive task
+ *            last moved bytes. config.txIdleBits are inserted by the hardware between consecutive transmissions.
+ *          - Collision detection: the UART compares the bus with the transmitted bits, so the receiver of the transceiver must stay
+ *            enabled while transmitting (/RE tied to GND). Collided transmissions are counted, see getCollisionCount().
+ *          Can be called before the UART is started, the mode is then applied by applyPins(). When RS-485 mode is disabled, the
+ *          DE pin is driven low, so the transceiver releases the bus.
+ * @param enabled true for RS-485 half-duplex, false for standard UART mode.
+ * @param config DE pin, turnaround timing and collision detection.
+ * @return true if the mode was set.
+ */
+bool ESP32_UART::setRS485(bool enabled, const RS485Config& config){
+    if(enabled && config.dePin == DEFAULT_REF) {
+        ERROR_PRINTLN("[ESP32_UART] RS-485 mode needs a DE pin");
+        return false;
+    }
+    if(config.txIdleBits > MAX_TX_IDLE_BITS) {
+        ERROR_PRINTLN("[ESP32_UART] Transmitter idle time of " + String(config.txIdleBits) + " bits exceeds the maximum of " + String(MAX_TX_IDLE_BITS));
+        return false;
+    }
+    int8_t previousDePin = _rs485 ? _rs485Config.dePin : DEFAULT_REF;
+    _rs485 = enabled;
+    if(enabled) _rs485Config = config;
+    if(_state != STARTED) return true;
+    if(!applyMode()) return false;
+    if(previousDePin != DEFAULT_REF && (!enabled || previousDePin != config.dePin)) {
+        //Detach the RTS signal from the former DE pin and release the bus
+        gpio_reset_pin(static_cast<gpio_num_t>(previousDePin));
+        gpio_set_direction(static_cast<gpio_num_t>(previousDePin), GPIO_MODE_OUTPUT);
+        gpio_set_level(static_cast<gpio_num_t>(previousDePin), 0);
+    }
+    return true;
+}
+
+/**
+ * @brief Report delimiter-terminated frames with the pattern detection of the UART hardware.
+ * @details Uses uart_enable_pattern_det_baud_intr(): the hardware checks the pattern including its timing and the driver queues
+ *          the position of each pattern in its buffer. The receive task converts the positions into frame ends in the RX ring
+ *          while moving the bytes. Needs the receive task and must be set while the UART is not started, like the receive
+ *          callback; the detection is applied by applyPins().
+ * @param enabled true to detect patterns.
+ * @param config Pattern character, count and timing in bit times.
+ * @return true if the detection was set.
+ */
+bool ESP32_UART::setPatternDetection(bool enabled, const PatternConfig& config){
+    if(_rxTask != nullptr) {
+        ERROR_PRINTLN("[ESP32_UART] Pattern detection must be set before the UART is started");
+        return false;
+    }
+    if(enabled && config.count == 0) {
+        ERROR_PRINTLN("[ESP32_UART] Pattern needs at least one character");
+        return false;
+    }
+    _patternDetection = enabled;
+    if(enabled) _patternConfig = config;
+    return true;
+}
+
+/**
+ * @brief Get the length of the oldest complete frame in the RX ring.
+ * @details The task queues a frame end before it moves the bytes of the frame, so frames are only reported once all their
+ *          bytes are in the ring.
+ * @return size_t Frame length including the pattern, 0 if there is none.
+ */
+size_t ESP32_UART::nextFrameLength(){
+    if(_rxTask == nullptr || !_patternDetection) return 0;
+    size_t length = _frames.nextFrameLength();
+    return length <= _rxRing.size() ? length : 0;
+}
+
+/**
+ * @brief Enable the pattern detection of the started driver and restart the frame ends at the empty RX ring.
+ */
+bool ESP32_UART::applyPatternDetection(){
+    _frames.reset();
+    if(uart_enable_pattern_det_baud_intr(_uartPort, _patternConfig.character, _patternConfig.count, _patternConfig.gapBits,
+                                         _patternConfig.postIdleBits, _patternConfig.preIdleBits) != ESP_OK
+        || uart_pattern_queue_reset(_uartPort, PATTERN_QUEUE_SIZE) != ESP_OK) {
+        ERROR_PRINTLN("[ESP32_UART] Failed to enable pattern detection");
+        return false;
+    }
+    INFO_PRINTLN("[ESP32_UART] Pattern detection of " + String(_patternConfig.count) + " x 0x" + String(uint8_t(_patternConfig.character), HEX));
+    return true;
+}
+
+/**
+ * @brief Take the pattern positions queued by the driver and queue the frame ends.
+ * @details The positions are relative to the oldest byte in the driver buffer and the driver drops the positions of bytes
+ *          which are read, so this must run before every uart_read_bytes() of the receive task.
+ */
+void ESP32_UART::takePatternPositions(){
+    int position;
+    while((position = uart_pattern_pop_pos(_uartPort)) >= 0) {
+        _frames.push(_frames.produced() + position + _patternConfig.count);
+    }
+}
+
+/**
+ * @brief Set the thresholds of the hardware FIFOs.
+ * @details Uses uart_set_rx_full_threshold(), uart_set_rx_timeout() and uart_set_tx_empty_threshold(). The RX timeout is
+ *          counted in character times of the current format. For request/response protocols like Modbus RTU, a timeout of 1-2
+ *          characters hands the response to the receive task right after its last byte instead of 10 characters later.
+ *          Can be called before the UART is started, the thresholds are then applied by applyPins(), and while it is running.
+ * @param config RX full threshold and TX empty threshold below the FIFO size, RX timeout up to MAX_RX_TIMEOUT_SYMBOLS.
+ * @return true if the thresholds were set.
+ */
+bool ESP32_UART::setFifoConfig(const FifoConfig& config){
+    if(config.rxFullThreshold == 0 || config.rxFullThreshold >= SOC_UART_FIFO_LEN
+        || config.txEmptyThreshold == 0 || config.txEmptyThreshold >= SOC_UART_FIFO_LEN) {
+        ERROR_PRINTLN("[ESP32_UART] FIFO thresholds must be between 1 and " + String(SOC_UART_FIFO_LEN - 1));
+        return false;
+    }
+    if(config.rxTimeoutSymbols > MAX_RX_TIMEOUT_SYMBOLS) {
+        ERROR_PRINTLN("[ESP32_UART] RX timeout of " + String(config.rxTimeoutSymbols) + " symbols exceeds the maximum of " + String(MAX_RX_TIMEOUT_SYMBOLS));
+        return false;
+    }
+    FifoConfig previous = _fifoConfig;
+    _fifoConfig = config;
+    if(_state != STARTED) return true;
+    if(!applyFifoConfig()) {
+        _fifoConfig = previous;
+        applyFifoConfig();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Apply the FIFO thresholds to the started driver.
+ */
+bool ESP32_UART::applyFifoConfig(){
+    if(uart_set_rx_full_threshold(_uartPort, _fifoConfig.rxFullThreshold) != ESP_OK
+        || uart_set_rx_timeout(_uartPort, _fifoConfig.rxTimeoutSymbols) != ESP_OK
+        || uart_set_tx_empty_threshold(_uartPort, _fifoConfig.txEmptyThreshold) != ESP_OK) {
+        ERROR_PRINTLN("[ESP32_UART] Failed to set FIFO thresholds");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Measure the time from the end of each transmission to the first received byte in the RX ring.
+ * @details The receive task takes the time when it moves the bytes into the ring, i.e. when they become readable. Needs the
+ *          receive task. Consecutive writes while the line is still busy extend the transmission. With TX connected to RX or
+ *          the receiver of an RS-485 transceiver enabled, the echo bytes still in the RX FIFO at the end of the transmission
+ *          are counted, which shows the delay of the RX timeout alone.
+ * @param enabled true to measure, the statistics are reset.
+ * @return true if the measurement was set.
+ */
+bool ESP32_UART::setLatencyMeasurement(bool enabled){
+    if(enabled && _state == STARTED && _rxTask == nullptr) {
+        ERROR_PRINTLN("[ESP32_UART] Latency measurement needs the receive task");
+        return false;
+    }
+    portENTER_CRITICAL(&_latencyMux);
+    _awaitingResponse = false;
+    _latency = {};
+    portEXIT_CRITICAL(&_latencyMux);
+    _latencyMeasurement = enabled;
+    return true;
+}
+
+/**
+ * @brief Get a consistent copy of the latency statistics, which the receive task updates.
+ */
+UARTCore::LatencyStatistics ESP32_UART::getLatencyStatistics() const {
+    portENTER_CRITICAL(&_latencyMux);
+    LatencyStatistics latency = _latency;
+    portEXIT_CRITICAL(&_latencyMux);
+    return latency;
+}
+
+void ESP32_UART::resetLatencyStatistics() {
+    portENTER_CRITICAL(&_latencyMux);
+    _latency = {};
+    portEXIT_CRITICAL(&_latencyMux);
+}
+
+/**
+ * @brief Calculate the end of the transmission after bytes were handed to the driver.
+ * @details A transmission whose end passed without a readable byte is counted as unanswered.
+ * @param length Number of bytes handed to the driver.
+ */
+void ESP32_UART::markRequest(size_t length){
+    if(!_latencyMeasurement || _baudrate == 0) return;
+    uint32_t duration = uint64_t(length) * getBitsPerChar() * 1000000 / _baudrate;
+    uint32_t now = micros();
+    uint32_t start = now;
+    portENTER_CRITICAL(&_latencyMux);       // Called by the loop task and the receive task
+    if(_awaitingResponse) {
+        if(int32_t(_requestEndUs - now) > 0) start = _requestEndUs;     // Line still busy with the previous bytes
+        else _latency.unanswered++;
+    }
+    _requestEndUs = start + duration;
+    _awaitingResponse = true;
+    portEXIT_CRITICAL(&_latencyMux);
+}
+
+/**
+ * @brief Count the latency when the receive task moved bytes after the end of the transmission.
+ * @param nowUs Time the bytes became readable.
+ */
+void ESP32_UART::markResponse(uint32_t nowUs){
+    portENTER_CRITICAL(&_latencyMux);
+    int32_t latency = int32_t(nowUs - _requestEndUs);
+    if(_awaitingResponse && latency >= 0) {         // Otherwise received while transmitting
+        _awaitingResponse = false;
+        if(_latency.responses == 0 || uint32_t(latency) < _latency.minUs) _latency.minUs = latency;
+        if(uint32_t(latency) > _latency.maxUs) _latency.maxUs = latency;
+        _latency.lastUs = latency;
+        _latency.totalUs += latency;
+        _latency.responses++;
+    }
+    portEXIT_CRITICAL(&_latencyMux);
+}
+
+/**
+ * @brief Apply the UART mode, the DE pin and the transmitter idle time to the started driver.
+ */
+bool ESP32_UART::applyMode(){
+    _txPending = false;
+    if(_rs485 && uart_set_pin(_uartPort, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, _rs485Config.dePin, UART_PIN_NO_CHANGE) != ESP_OK) {
+        ERROR_PRINTLN("[ESP32_UART] Failed to set DE pin " + String(_rs485Config.dePin));
+        return false;
+    }
+    if(uart_set_mode(_uartPort, _rs485 ? UART_MODE_RS485_HALF_DUPLEX : UART_MODE_UART) != ESP_OK
+        || uart_set_tx_idle_num(_uartPort, _rs485 ? _rs485Config.txIdleBits : 0) != ESP_OK) {
+        ERROR_PRINTLN("[ESP32_UART] Failed to set UART mode");
+        return false;
+    }
+    if(_rs485) {
+        INFO_PRINTLN("[ESP32_UART] RS-485 half-duplex mode with DE pin " + String(_rs485Config.dePin) + ", turnaround "
+                     + String(_rs485Config.turnaroundUs) + " us, collision detection " + (_rs485Config.collisionDetection ? "on" : "off"));
+    }
+    return true;
+}
+
+/**
+ * @brief Get the remaining RS-485 turnaround time.
+ * @details Measured from the last bytes moved by the receive task. Without receive task the turnaround is not applied.
+ * @return uint32_t Microseconds until transmitting is allowed, 0 if it is allowed now.
+ */
+uint32_t ESP32_UART::turnaroundRemaining() const {
+    if(_rxTask == nullptr || _rs485Config.turnaroundUs == 0) return 0;
+    uint32_t elapsed = micros() - _lastRxUs;
+    return elapsed < _rs485Config.turnaroundUs ? _rs485Config.turnaroundUs - elapsed : 0;
+}
+
+/**
+ * @brief Count a collision of the last RS-485 transmission once it is complete.
+ * @details The driver resets the collision flag when a transmission starts, so the flag is read before every write and
+ *          additionally by the receive task, which also catches the last transmission of a burst.
+ */
+void ESP32_UART::checkCollision(){
+    if(!_txPending || uart_wait_tx_done(_uartPort, 0) != ESP_OK) return;
+    if(!_txPending.exchange(false)) return;     // Checked by the other task meanwhile
+    bool collision = false;
+    if(uart_get_collision_flag(_uartPort, &collision) == ESP_OK && collision) _collisions++;
+}
+
+/**
+ * @brief Start the receive task.
+ * @details The task is not pinned to a core and is stopped by reset().
+ *
+ * @return true if the task was created.
+ */
+bool ESP32_UART::startRxTask(){
+    if(_rxTask != nullptr) return true;
+    if(uart_queue == nullptr) return false;
+    _rxTaskRunning = true;
+    if(xTaskCreatePinnedToCore(rxTask, "uart_rx", RX_TASK_STACK_SIZE, this, RX_TASK_PRIORITY, &_rxTask, tskNO_AFFINITY) != pdPASS) {
+        ERROR_PRINTLN("[ESP32_UART] Failed to create receive task.");
+        _rxTaskRunning = false;
+        _rxTask = nullptr;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Stop the receive task and wait until it has left the UART driver.
+ * @details The task finishes its current iteration, which blocks for at most RX_WAIT_MS, and deletes itself. It is never
+ *          deleted from outside, because it may be inside a driver call holding a driver lock.
+ */
+void ESP32_UART::stopRxTask(){
+    if(_rxTask == nullptr) return;
+    _rxTaskRunning = false;
+    bool reported = false;
+    for(uint32_t waited = 0; _rxTask != nullptr; waited += 5) {
+        if(!reported && waited >= 20 * RX_WAIT_MS) {
+            DEV_ERROR_PRINTLN("[ESP32_UART] Receive task did not stop in time. Still waiting.");
+            reported = true;
+        }
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+}
+
+/**
+ * @brief Receive task main loop.
+ * @details Blocks on the event queue of the UART driver, handles the event and moves the buffered bytes into the RX ring.
+ *          Also wakes up every RX_WAIT_MS to continue moving bytes which did not fit into the ring before. While a transmission
+ *          is in progress it wakes up every TX_WAIT_TICKS to refill the driver's transmit buffer from the TX ring and to detect
+ *          the end of the transmission.
+ *
+ * @param parameter Pointer to the owning ESP32_UART.
+ */
+void ESP32_UART::rxTask(void* parameter){
+    ESP32_UART* uart = static_cast<ESP32_UART*>(parameter);
+    while(uart->_rxTaskRunning) {
+        uart_event_t event;
+        bool transmitting = uart->_txActive || uart->_txStarted || !uart->_txRing.empty();
+        if(xQueueReceive(uart->uart_queue, &event, transmitting ? TX_WAIT_TICKS : pdMS_TO_TICKS(RX_WAIT_MS)) == pdTRUE) {
+            uart->handleEvent(event);
+        }
+        if(uart->receivePending() > 0 && uart->_receiveCallback) {
+            uart->_receiveCallback(uart->_rxRing.size());
+        }
+        uart->transmitPending();
+        if(uart->_txPending) uart->checkCollision();
+    }
+    uart->_rxTask = nullptr;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Count error events of the UART driver.
+ * @details Received data is not read here: receivePending() takes all buffered bytes after every event.
+ *          After a full driver buffer, the buffered bytes are moved into the ring first; the driver buffer is only discarded
+ *          if the ring cannot take them, so the driver does not keep reporting a full buffer.
+ */
+void ESP32_UART::handleEvent(const uart_event_t& event){
+    switch(event.type) {
+        case UART_FIFO_OVF:
+            _rxStatistics.fifoOverflows++;
+            break;
+        case UART_BUFFER_FULL:
+            _rxStatistics.bufferFull++;
+            receivePending();
+            if(_rxRing.free() == 0) {
+                uart_flush_input(_uartPort);
+                xQueueReset(uart_queue);
+            }
+            break;
+        case UART_FRAME_ERR:
+            _rxStatistics.frameErrors++;
+            break;
+        case UART_PARITY_ERR:
+            _rxStatistics.parityErrors++;
+            break;
+        case UART_BREAK:
+            _rxStatistics.breaks++;
+            break;
+        case UART_PATTERN_DET:
+            _rxStatistics.patterns++;
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Move the bytes buffered by the UART driver into the RX ring, as far as the ring has room.
+ * @return size_t Number of bytes moved.
+ */
+size_t ESP32_UART::receivePending(){
+    size_t moved = 0;
+    uint8_t chunk[128];
+    while(true) {
+        size_t buffered = 0;
+        if(uart_get_buffered_data_len(_uartPort, &buffered) != ESP_OK || buffered == 0) break;
+        size_t length = _rxRing.free();
+        if(length > buffered) length = buffered;
+        if(length > sizeof(chunk)) length = sizeof(chunk);
+        if(length == 0) break;
+        if(_patternDetection) takePatternPositions();
+        int received = uart_read_bytes(_uartPort, chunk, length, 0);
+        if(received <= 0) break;
+        _rxRing.write(chunk, received);
+        _frames.advance(received);
+        moved += received;
+    }
+    _rxStatistics.rxBytes += moved;
+    if(moved > 0) {
+        _lastRxUs = micros();
+        if(_awaitingResponse) markResponse(_lastRxUs);
+    }
+    return moved;
+}
+
+
+/**
+ * @brief Get the free space in the driver's transmit buffer, so uart_write_bytes() does not wait.
+ * @details uart_get_tx_buffer_free_size() exists since ESP-IDF 5.1. Older versions count the bytes handed to the driver
+ *          until it reports the end of the transmission, against half of the buffer: the driver's ring buffer also stores
+ *          a header per write.
+ */
+size_t ESP32_UART::txBufferSpace(){
+#if ESP_IDF_VERSION_MAJOR > 5 || (ESP_IDF_VERSION_MAJOR == 5 && ESP_IDF_VERSION_MINOR >= 1)
+    size_t space = 0;
+    if(uart_get_tx_buffer_free_size(_uartPort, &space) != ESP_OK) return 0;
+    return space;
+#else
+    size_t used = _txBufferUsed;
+    if(used > 0 && uart_wait_tx_done(_uartPort, 0) == ESP_OK) {
+        _txBufferUsed.compare_exchange_strong(used, 0);     // Fails if bytes were handed over meanwhile, they are released next time
+        used = _txBufferUsed;
+    }
+    size_t limit = _txBufferSize / 2;
+    return used < limit ? limit - used : 0;
+#endif
+}
+
+/**
+ * @brief Hand bytes to the driver and count them for txBufferSpace().
+ * @return int Number of bytes written, negative on error.
+ */
+int ESP32_UART::writeDriver(const void* data, size_t length){
+#if ESP_IDF_VERSION_MAJOR > 5 || (ESP_IDF_VERSION_MAJOR == 5 && ESP_IDF_VERSION_MINOR >= 1)
+    return uart_write_bytes(_uartPort, data, length);
+#else
+    _txBufferUsed += length;            // Counted before the write, so a concurrent txBufferSpace() cannot release the bytes early
+    int written = uart_write_bytes(_uartPort, data, length);
+    _txBufferUsed -= length - (written > 0 ? written : 0);
+    return written;
+#endif
+}
+
+/**
+ * @brief Append bytes to the TX ring and wake up the receive task to transmit them.
+ * @return size_t Number of bytes accepted.
+ */
+size_t ESP32_UART::queueTx(const uint8_t* data, size_t length){
+    size_t accepted = _txRing.write(data, length);
+    size_t fill = _txRing.size();
+    if(fill > _txStatistics.maxRingFill) _txStatistics.maxRingFill = fill;
+    if(accepted > 0) wakeTask();
+    return accepted;
+}
+
+/**
+ * @brief Wake up the receive task with an event outside the range of the driver's events.
+ * @details At most one wakeup event is queued at a time, so the driver's events always find room in the queue.
+ */
+void ESP32_UART::wakeTask(){
+    if(_rxTask == nullptr || _txWakeup.exchange(true)) return;
+    uart_event_t event = {};
+    event.type = UART_EVENT_MAX;
+    if(xQueueSend(uart_queue, &event, 0) != pdTRUE) _txWakeup = false;
+}
+
+/**
+ * @brief Move bytes from the TX ring into the driver's transmit buffer and report the end of a transmission.
+ * @details Runs in the receive task. In RS-485 mode the bytes wait in the ring until the turnaround time has passed.
+ */
+void ESP32_UART::transmitPending(){
+    _txWakeup = false;
+    if(_txStarted.exchange(false)) _txActive = true;
+    if(!_txRing.empty() && !(_rs485 && turnaroundRemaining() > 0)) {
+        if(_rs485) checkCollision();
+        const uint8_t* data;
+        size_t length;
+        size_t space;
+        while((space = txBufferSpace()) > 0 && (length = _txRing.peek(data)) > 0) {
+            if(length > space) length = space;
+            int written = writeDriver(data, length);
+            if(written <= 0) break;
+            _txRing.consume(written);
+            _txStatistics.txBytes += written;
+            markRequest(written);
+            _txActive = true;
+            if(_rs485 && _rs485Config.collisionDetection) _txPending = true;
+        }
+    }
+    if(_txActive && _txRing.empty() && uart_wait_tx_done(_uartPort, 0) == ESP_OK) {
+        _txActive = false;
+        _txStatistics.txDone++;
+        if(_txDoneCallback) _txDoneCallback();
+    }
+}
@@ -0,0 +1,391 @@
+#include "ISOTPTransport.h"
+#include "Debug.h"
+
+/**
+ * @brief Start the transport on a CAN interface.
+ * @details Registers the transport as listener at the interface. Frames are handled when CANInterface::process() is called.
+ *
+ * @param canInterface Interface to use.
+ * @return true if the transport was registered.
+ */
+bool ISOTPTransport::begin(CANInterface* canInterface) {
+    if(canInterface == nullptr) {
+        ERROR_PRINTLN("[ISOTPTransport] No CAN interface assigned.");
+        return false;
+    }
+    if(!canInterface->addListener(this)) {
+        return false;
+    }
+    _canInterface = canInterface;
+    return true;
+}
+
+/**
+ * @brief Stop the transport and abort all running transfers.
+ * @details Sessions stay open and can be used again after begin().
+ */
+void ISOTPTransport::end() {
+    for(uint8_t i=0; i<MAX_SESSIONS; i++) {
+        if(!_sessions[i].used) continue;
+        if(_sessions[i].txState != TX_IDLE) finishTransmit(i, RESULT_ABORTED);
+        if(_sessions[i].rxActive) finishReceive(i, RESULT_ABORTED);
+    }
+    if(_canInterface) _canInterface->removeListener(this);
+    _canInterface = nullptr;
+}
+
+/**
+ * @brief Open a session.
+ *
+ * @param txId CAN ID used for frames sent by this node (data frames and flow control).
+ * @param rxId CAN ID of frames received from the peer.
+ * @param isExtended True for 29-bit identifiers.
+ * @return int8_t Session handle, -1 if no session is free or rxId is already used.
+ */
+int8_t ISOTPTransport::openSession(uint32_t txId, uint32_t rxId, bool isExtended) {
+    for(uint8_t i=0; i<MAX_SESSIONS; i++) {
+        if(_sessions[i].used && _sessions[i].rxId == rxId && _sessions[i].isExtended == isExtended) {
+            ERROR_PRINTLN("[ISOTPTransport] RX ID 0x" + String(rxId, HEX) + " is already used by session " + String(i) + ".");
+            return -1;
+        }
+    }
+    for(uint8_t i=0; i<MAX_SESSIONS; i++) {
+        if(_sessions[i].used) continue;
+        _sessions[i] = {};
+        _sessions[i].used = true;
+        _sessions[i].isExtended = isExtended;
+        _sessions[i].txId = txId;
+        _sessions[i].rxId = rxId;
+        return i;
+    }
+    ERROR_PRINTLN("[ISOTPTransport] Maximum number of " + String(MAX_SESSIONS) + " sessions reached.");
+    return -1;
+}
+
+/**
+ * @brief Close a session. Running transfers are reported as RESULT_ABORTED.
+ */
+void ISOTPTransport::closeSession(uint8_t session) {
+    if(session >= MAX_SESSIONS || !_sessions[session].used) return;
+    if(_sessions[session].txState != TX_IDLE) finishTransmit(session, RESULT_ABORTED);
+    if(_sessions[session].rxActive) finishReceive(session, RESULT_ABORTED);
+    _sessions[session].used = false;
+}
+
+/**
+ * @brief Assign the buffer received payloads are reassembled into.
+ * @details Payloads larger than the capacity are rejected with a FC.OVFLW frame. Can be called from the receive callback.
+ *
+ * @param session Session handle.
+ * @param buffer Receive buffer. Must stay valid while the session is open.
+ * @param capacity Size of the buffer.
+ * @return true if the buffer was assigned.
+ * @return false if the session is invalid or a reception is in progress.
+ */
+bool ISOTPTransport::setReceiveBuffer(uint8_t session, uint8_t* buffer, size_t capacity) {
+    if(session >= MAX_SESSIONS || !_sessions[session].used) {
+        DEV_ERROR_PRINTLN("[ISOTPTransport] Invalid session " + String(session) + ".");
+        return false;
+    }
+    if(_sessions[session].rxActive) {
+        ERROR_PRINTLN("[ISOTPTransport] Cannot change receive buffer of session " + String(session) + " during a reception.");
+        return false;
+    }
+    _sessions[session].rxBuffer = buffer;
+    _sessions[session].rxCapacity = buffer ? capacity : 0;
+    return true;
+}
+
+/**
+ * @brief Start sending a payload.
+ * @details Payloads up to 7 bytes are sent as single frame and finished immediately. Larger payloads are sent as first frame,
+ *          the consecutive frames follow from cycle() according to the flow control of the receiver.
+ *          The data is not copied and must stay valid until the transmit callback is called or isSending() returns false.
+ *
+ * @param session Session handle.
+ * @param data Payload.
+ * @param length Payload length (1..MAX_PAYLOAD_SIZE).
+ * @return true if the transfer was started.
+ */
+bool ISOTPTransport::send(uint8_t session, const uint8_t* data, size_t length) {
+    if(session >= MAX_SESSIONS || !_sessions[session].used) {
+        DEV_ERROR_PRINTLN("[ISOTPTransport] Invalid session " + String(session) + ".");
+        return false;
+    }
+    Session& s = _sessions[session];
+    if(s.txState != TX_IDLE) {
+        ERROR_PRINTLN("[ISOTPTransport] Session " + String(session) + " is busy sending.");
+        return false;
+    }
+    if(data == nullptr || length == 0 || length > MAX_PAYLOAD_SIZE) {
+        ERROR_PRINTLN("[ISOTPTransport] Invalid payload length " + String(length) + ". Valid range is 1.." + String(MAX_PAYLOAD_SIZE) + ".");
+        return false;
+    }
+    if(_canInterface == nullptr) {
+        DEV_ERROR_PRINTLN("[ISOTPTransport] Not started. Call begin() before send().");
+        return false;
+    }
+
+    uint8_t frame[8];
+    if(length <= 7) {
+        frame[0] = (SINGLE_FRAME << 4) | length;
+        memcpy(&frame[1], data, length);
+        if(!sendFrame(s, frame, length + 1)) return false;
+        if(_transmitCallback) _transmitCallback(session, RESULT_OK);
+        return true;
+    }
+
+    frame[0] = (FIRST_FRAME << 4) | (length >> 8);
+    frame[1] = length & 0xFF;
+    memcpy(&frame[2], data, 6);
+    if(!sendFrame(s, frame, 8)) return false;
+    s.txData = data;
+    s.txLength = length;
+    s.txOffset = 6;
+    s.txSequence = 1;
+    s.txWaitCount = 0;
+    s.txLastActivity = millis();
+    s.txState = TX_WAIT_FC;
+    return true;
+}
+
+bool ISOTPTransport::isSending(uint8_t session) const {
+    return session < MAX_SESSIONS && _sessions[session].txState != TX_IDLE;
+}
+
+bool ISOTPTransport::isReceiving(uint8_t session) const {
+    return session < MAX_SESSIONS && _sessions[session].rxActive;
+}
+
+/**
+ * @brief Set the flow control parameters announced to senders.
+ *
+ * @param blockSize Number of consecutive frames between two flow control frames, 0 for no further flow control.
+ * @param stMin Minimum separation time: 0x00-0x7F in ms, 0xF1-0xF9 in 100 us steps.
+ */
+void ISOTPTransport::setFlowControl(uint8_t blockSize, uint8_t stMin) {
+    if(stMin > 0x7F && (stMin < 0xF1 || stMin > 0xF9)) {
+        WARNING_PRINTLN("[ISOTPTransport] Reserved STmin 0x" + String(stMin, HEX) + ", using 127 ms.");
+        stMin = 0x7F;
+    }
+    _blockSize = blockSize;
+    _stMin = stMin;
+}
+
+/**
+ * @brief Convert an STmin value into microseconds.
+ * @details Reserved values are treated as 127 ms as required by ISO 15765-2.
+ */
+uint32_t ISOTPTransport::stMinToUs(uint8_t stMin) {
+    if(stMin <= 0x7F) return uint32_t(stMin) * 1000;
+    if(stMin >= 0xF1 && stMin <= 0xF9) return uint32_t(stMin - 0xF0) * 100;
+    return 127000;
+}
+
+/**
+ * @brief Handle a received frame.
+ * @details Consumes all frames received on the RX ID of an open session.
+ *
+ * @param message Received frame.
+ * @return true if the frame belongs to a session.
+ */
+bool ISOTPTransport::onMessage(const CANCore::CANMessage& message) {
+    if(message.isRemote) return false;
+    uint8_t index = 0;
+    while(index < MAX_SESSIONS) {
+        const Session& s = _sessions[index];
+        if(s.used && s.rxId == message.id && s.isExtended == message.isExtended) break;
+        index++;
+    }
+    if(index >= MAX_SESSIONS) return false;
+    if(message.length == 0) return true;
+
+    switch(message.data[0] >> 4) {
+        case SINGLE_FRAME:      handleSingleFrame(index, message); break;
+        case FIRST_FRAME:       handleFirstFrame(index, message); break;
+        case CONSECUTIVE_FRAME: handleConsecutiveFrame(index, message); break;
+        case FLOW_CONTROL:      handleFlowControl(index, message); break;
+        default:
+            DEBUG_PRINTLN("[ISOTPTransport] Ignoring frame with unknown PCI 0x" + String(message.data[0], HEX) + ".");
+            break;
+    }
+    return true;
+}
+
+/**
+ * @brief Send pending consecutive frames and check timeouts.
+ * @details Called from CANInterface::process(). Sending throughput is limited by how often process() is called
+ *          when the receiver requests an STmin greater than 0.
+ */
+void ISOTPTransport::cycle() {
+    uint32_t now = millis();
+    for(uint8_t i=0; i<MAX_SESSIONS; i++) {
+        Session& s = _sessions[i];
+        if(!s.used) continue;
+        if(s.txState == TX_WAIT_FC && now - s.txLastActivity > TIMEOUT_MS) {
+            WARNING_PRINTLN("[ISOTPTransport] Session " + String(i) + ": no flow control received (N_Bs timeout).");
+            finishTransmit(i, RESULT_TIMEOUT);
+        } else if(s.txState == TX_SENDING) {
+            sendConsecutiveFrames(i);
+        }
+        if(s.rxActive && now - s.rxLastActivity > TIMEOUT_MS) {
+            WARNING_PRINTLN("[ISOTPTransport] Session " + String(i) + ": no consecutive frame received (N_Cr timeout).");
+            finishReceive(i, RESULT_TIMEOUT);
+        }
+    }
+}
+
+void ISOTPTransport::handleSingleFrame(uint8_t index, const CANCore::CANMessage& message) {
+    Session& s = _sessions[index];
+    uint8_t length = message.data[0] & 0x0F;
+    if(length == 0 || length > 7 || length >= message.length) return;
+    if(s.rxActive) finishReceive(index, RESULT_UNEXPECTED_FRAME);
+    if(length > s.rxCapacity) {
+        finishReceive(index, RESULT_OVERFLOW);
+        return;
+    }
+    memcpy(s.rxBuffer, &message.data[1], length);
+    s.rxLength = length;
+    s.rxOffset = length;
+    finishReceive(index, RESULT_OK);
+}
+
+void ISOTPTransport::handleFirstFrame(uint8_t index, const CANCore::CANMessage& message) {
+    Session& s = _sessions[index];
+    if(message.length != 8) return;
+    size_t length = (size_t(message.data[0] & 0x0F) << 8) | message.data[1];
+    if(length <= 7) return;
+    if(s.rxActive) finishReceive(index, RESULT_UNEXPECTED_FRAME);
+    if(length > s.rxCapacity) {
+        sendFlowControl(s, FC_OVERFLOW);
+        finishReceive(index, RESULT_OVERFLOW);
+        return;
+    }
+    memcpy(s.rxBuffer, &message.data[2], 6);
+    s.rxLength = length;
+    s.rxOffset = 6;
+    s.rxSequence = 1;
+    s.rxBlockCount = 0;
+    s.rxActive = true;
+    s.rxLastActivity = millis();
+    sendFlowControl(s, FC_CONTINUE);
+}
+
+void ISOTPTransport::handleConsecutiveFrame(uint8_t index, const CANCore::CANMessage& message) {
+    Session& s = _sessions[index];
+    if(!s.rxActive) return;
+    if((message.data[0] & 0x0F) != s.rxSequence) {
+        finishReceive(index, RESULT_WRONG_SEQUENCE);
+        return;
+    }
+    size_t length = s.rxLength - s.rxOffset;
+    if(length > 7) length = 7;
+    if(length >= message.length) return;
+    memcpy(&s.rxBuffer[s.rxOffset], &message.data[1], length);
+    s.rxOffset += length;
+    s.rxSequence = (s.rxSequence + 1) & 0x0F;
+    s.rxLastActivity = millis();
+
+    if(s.rxOffset >= s.rxLength) {
+        finishReceive(index, RESULT_OK);
+        return;
+    }
+    if(_blockSize != 0 && ++s.rxBlockCount >= _blockSize) {
+        s.rxBlockCount = 0;
+        sendFlowControl(s, FC_CONTINUE);
+    }
+}
+
+void ISOTPTransport::handleFlowControl(uint8_t index, const CANCore::CANMessage& message) {
+    Session& s = _sessions[index];
+    if(s.txState != TX_WAIT_FC || message.length < 3) return;
+    switch(message.data[0] & 0x0F) {
+        case FC_CONTINUE:
+            s.txBlockSize = message.data[1];
+            s.txBlockCount = 0;
+            s.txWaitCount = 0;
+            s.txSeparationUs = stMinToUs(message.data[2]);
+            s.txLastFrame = micros() - s.txSeparationUs;
+            s.txState = TX_SENDING;
+            sendConsecutiveFrames(index);
+            break;
+        case FC_WAIT:
+            if(++s.txWaitCount > MAX_WAIT_FRAMES) {
+                finishTransmit(index, RESULT_WAIT_LIMIT);
+                break;
+            }
+            s.txLastActivity = millis();
+            break;
+        case FC_OVERFLOW:
+            finishTransmit(index, RESULT_OVERFLOW);
+            break;
+        default:
+            finishTransmit(index, RESULT_UNEXPECTED_FRAME);
+            break;
+    }
+}
+
+/**
+ * @brief Send consecutive frames of a session until the block is complete, STmin has to elapse or MAX_FRAMES_PER_CYCLE is reached.
+ * @details A frame the CAN core does not accept is retried in the next cycle.
+ */
+void ISOTPTransport::sendConsecutiveFrames(uint8_t index) {
+    Session& s = _sessions[index];
+    uint8_t frame[8];
+    for(uint8_t count=0; count<MAX_FRAMES_PER_CYCLE; count++) {
+        if(s.txSeparationUs != 0 && micros() - s.txLastFrame < s.txSeparationUs) return;
+
+        size_t length = s.txLength - s.txOffset;
+        if(length > 7) length = 7;
+        frame[0] = (CONSECUTIVE_FRAME << 4) | s.txSequence;
+        memcpy(&frame[1], &s.txData[s.txOffset], length);
+        if(!sendFrame(s, frame, length + 1)) return;
+        s.txOffset += length;
+        s.txSequence = (s.txSequence + 1) & 0x0F;
+        s.txLastFrame = micros();
+
+        if(s.txOffset >= s.txLength) {
+            finishTransmit(index, RESULT_OK);
+            return;
+        }
+        if(s.txBlockSize != 0 && ++s.txBlockCount >= s.txBlockSize) {
+            s.txLastActivity = millis();
+            s.txState = TX_WAIT_FC;
+            return;
+        }
+    }
+}
+
+bool ISOTPTransport::sendFrame(const Session& session, const uint8_t* data, uint8_t length) {
+    if(_canInterface == nullptr) return false;
+    CANCore::CANMessage message = {};
+    message.id = session.txId;
+    message.isExtended = session.isExtended;
+    memcpy(message.data, data, length);
+    if(_padding) {
+        memset(&message.data[length], PADDING_BYTE, 8 - length);
+        length = 8;
+    }
+    message.length = length;
+    return _canInterface->sendMessage(message);
+}
+
+bool ISOTPTransport::sendFlowControl(const Session& session, FlowStatus status) {
+    uint8_t frame[3] = {uint8_t((FLOW_CONTROL << 4) | status), _blockSize, _stMin};
+    return sendFrame(session, frame, 3);
+}
+
+void ISOTPTransport::finishTransmit(uint8_t index, Result result) {
+    Session& s = _sessions[index];
+    s.txState = TX_IDLE;
+    s.txData = nullptr;
+    if(result != RESULT_OK) DEBUG_PRINTLN("[ISOTPTransport] Session " + String(index) + ": transmission failed with result " + String(result) + ".");
+    if(_transmitCallback) _transmitCallback(index, result);
+}
+
+void ISOTPTransport::finishReceive(uint8_t index, Result result) {
+    Session& s = _sessions[index];
+    s.rxActive = false;
+    if(result != RESULT_OK) DEBUG_PRINTLN("[ISOTPTransport] Session " + String(index) + ": reception failed with result " + String(result) + ".");
+    if(_receiveCallback) _receiveCallback(index, result, s.rxBuffer, result == RESULT_OK ? s.rxLength : 0);
+}
@@ -9,6 +9,8 @@
 #include "soc/adc_channel.h"
 #include "esp_adc_cal.h"
 #include "Adafruit_MCP23X17.h"
+#include "ObjectDictionary.h"
+#include "CANAutoBaud.h"
 
 
 const String MainModuleV1_0::HW_TYPE = "MainModuleV1.0";
@@ -22,12 +24,16 @@ const String MainModuleV1_0::FW_VERSION = "1.0";
  */
 bool MainModuleV1_0::reset(){
     INFO_PRINTLN("[MainModuleV1_0] Resetting module...");
-    bool result = uart.reset();
+    bool result = true;
+    _uartMux.end();
+    for(uint8_t i=0; i<_uartMux.getSegmentCount(); i++) result &= _uartMux.getSegment(i)->reset();
+    for(ESP32_UART& core : uart) result &= core.reset();
     result &= _pwmCore.reset();
     //reset i2c
     result &= resetShiftRegister();
 
     //reset CAN core
+    canInterface.clearListeners();
     result &= canCore.reset();
 
     INFO_PRINTLN("[MainModuleV1_0] Module reset complete.");
@@ -78,14 +84,21 @@ bool MainModuleV1_0::requestGPIOs(){
 
 /**
  * @brief Provide hardware resources (UART, PWM, etc.) to CANTramCore.
- * @details Attaches hardware resource instances to the core so other modules may request/use them.
+ * @details Attaches hardware resource instances to the core so other modules may request/use them. Every UART port except the
+ *          console is a resource of its own, routed to the pins of the module using it. If shared UART segments are set, the last
+ *          port is replaced by the segments, see setSharedUARTSegments().
  * @return true if all resources were attached successfully, false otherwise.
  */
 bool MainModuleV1_0::provideHardwareResources(){
     bool result = true;
     
-    result &= CANTramCore::attachHardwareResource(&uart);
-    uart.setUARTPort(UART_NUM); 
+    for(uint8_t i=0; i<UART_COUNT; i++) {
+        uart[i].setUARTPort(UART_NUM + i);
+        if(i < getDedicatedUARTCount()) result &= CANTramCore::attachHardwareResource(&uart[i]);
+    }
+    for(uint8_t i=0; i<_uartMux.getSegmentCount(); i++) {
+        result &= CANTramCore::attachHardwareResource(_uartMux.getSegment(i));
+    }
     result &= CANTramCore::attachHardwareResource(&_pwmCore);
     result &= CANTramCore::attachHardwareResource(&canCore);
     result &= CANTramCore::attachHardwareResource(&i2cCore);
@@ -187,25 +200,23 @@ bool MainModuleV1_0::initialize(){
     
 
     //Init UART
-    auto initUART = [&]() -> bool {
-        if(!uart.isUsed()) return true;
-        INFO_PRINT("[MainModuleV1_0] Initializing UART... ");
-        if(!uart.install(UART_NUM, UART_TX, UART_RX, UART_BUFFER_SIZE)){
-            ERROR_PRINTLN("[MainModuleV1_0] UART initialization failed! Programm stopped.");
-            return false;
-        }
-        if(!uart.applyConfig()){
-            ERROR_PRINTLN("[MainModuleV1_0] UART configuration failed! Programm stopped.");
-            return false;
-        }
-        if(!uart.applyPins()){
-            ERROR_PRINTLN("[MainModuleV1_0] UART pin assignment failed! Programm stopped.");
-            return false;
+    for(uint8_t i=0; i<getDedicatedUARTCount(); i++) {
+        if(uart[i].isUsed()) result &= initUART(uart[i], UART_NUM + i);
+    }
+    auto initSharedUART = [&]() -> bool {
+        if(!_uartMux.isUsed()) return true;
+        //The shared port starts with the line settings and pins of the first used segment
+        UARTSegment* first = nullptr;
+        for(uint8_t i=0; i<_uartMux.getSegmentCount() && first == nullptr; i++) {
+            if(_uartMux.getSegment(i)->isUsed()) first = _uartMux.getSegment(i);
         }
-        INFO_PRINTLN("Done.");
-        return true;
+        ESP32_UART& shared = uart[UART_COUNT - 1];
+        shared.config(first->getBaudrate(), first->getDataBits(), first->getParity(), first->getStopBits());
+        if(first->hasPins()) shared.setPins(first->getTxPin(), first->getRxPin());
+        if(first->isRS485() && !shared.setRS485(true, first->getRS485Config())) return false;
+        return initUART(shared, UART_NUM + UART_COUNT - 1) && _uartMux.begin(&shared);
     };
-    result &= initUART();
+    result &= initSharedUART();
 
     //Init PWM
     auto initPWM = [&]() -> bool {
@@ -317,6 +328,20 @@ bool MainModuleV1_0::initialize(){
 
         //set pins for can 
         canCore.setPins(CAN_TX, CAN_RX);
+        if(canCore.getBaudrate() == CANCore::BR_NOT_SET && CANTramCore::CAN_AUTO_BAUD){
+            //Listen to the bus before sending anything. The default baudrate is only used on a silent bus.
+            CANAutoBaud autoBaud;
+            CANAutoBaud::State state = autoBaud.detect(&canCore, CANTramCore::CAN_AUTO_BAUD_TIMEOUT_MS);
+            if(state == CANAutoBaud::LOCKED){
+                INFO_PRINTLN("Done.");
+                return true;
+            }
+            if(state == CANAutoBaud::FAILED){
+                ERROR_PRINTLN("[MainModuleV1_0] CAN traffic at an unsupported baudrate. CAN not started.");
+                canInterface.invalidate();
+                return false;
+            }
+        }
         if(canCore.getBaudrate() == CANCore::BR_NOT_SET){
             //Set default baudrate if not set
             canCore.setBaudrate(CANTramCore::DEFAULT_CAN_BAUDRATE);
@@ -350,6 +375,12 @@ void MainModuleV1_0::cycle(uint8_t* response){
 
     getTemperatureCelsius(); //Just read temperature periodically
 
+    //Switch the shared UART port between its segments
+    if(_uartMux.isRunning()) _uartMux.cycle(micros());
+
+    //Dispatch received CAN frames to the registered protocol listeners
+    canInterface.process();
+
     //Not implemented correctly yet, just for testing
     #warning "DEV WARNING: LED handling in MainModuleV1_0::cycle() is just for testing purposes!. Remove or implement proper status LED handling!"
     shiftRegister.digitalWrite(LED_WARNING, 1); //Toggle warning LED
@@ -358,6 +389,57 @@ void MainModuleV1_0::cycle(uint8_t* response){
 
 
 
+/**
+ * @brief Share the last UART port among several segments in a time-multiplexed mode, see UARTMultiplexer.
+ * @details Each segment is provided as UART hardware resource of its own, e.g. for low-rate RS-485 lines of further BusModules.
+ *          Must be called before the module is attached. The segments share baudrate and character format, which are taken from
+ *          the first used segment. Set the scheduling times with getUARTMultiplexer().setTiming().
+ * @param segments Number of segments, 0 to provide the port as dedicated resource.
+ * @return true if the number of segments was set.
+ */
+bool MainModuleV1_0::setSharedUARTSegments(uint8_t segments){
+    return _uartMux.setSegmentCount(segments);
+}
+
+/**
+ * @brief Install, configure and start a UART port on the pins set by the module using it.
+ * @param core UART core of the port.
+ * @param port UART port number.
+ * @return true if the port was started.
+ */
+bool MainModuleV1_0::initUART(ESP32_UART& core, uint8_t port){
+    INFO_PRINT("[MainModuleV1_0] Initializing UART" + String(port) + "... ");
+    uint8_t txPin = core.hasPins() ? core.getTxPin() : UART_TX;
+    uint8_t rxPin = core.hasPins() ? core.getRxPin() : UART_RX;
+    if(!core.install(port, txPin, rxPin, UART_BUFFER_SIZE)){
+        ERROR_PRINTLN("[MainModuleV1_0] UART initialization failed! Programm stopped.");
+        return false;
+    }
+    if(!core.applyConfig()){
+        ERROR_PRINTLN("[MainModuleV1_0] UART configuration failed! Programm stopped.");
+        return false;
+    }
+    if(!core.applyPins()){
+        ERROR_PRINTLN("[MainModuleV1_0] UART pin assignment failed! Programm stopped.");
+        return false;
+    }
+    INFO_PRINTLN("Done.");
+    return true;
+}
+
+/**
+ * @brief Add the module configuration to an object dictionary.
+ * @details Sub-index 1: PWM frequency in Hz (UNSIGNED32, rw).
+ * @param od Object dictionary to add the entries to.
+ * @param index Object index reserved for this module.
+ * @return true if all entries were added, false otherwise.
+ */
+bool MainModuleV1_0::addObjects(ObjectDictionary& od, uint16_t index){
+    return od.addU32(index, 1, ObjectDictionary::ACCESS_RW,
+                     [this]() { return _pwmCore.getFrequency(); },
+                     [this](uint32_t freq) { return freq != 0 && _pwmCore.setFrequency(freq); });
+}
+
 /**
  * @brief Set PWM duty for an output definition.
  * @details Validates the output definition for PWM capability and delegates to the PWM core to set the duty cycle.
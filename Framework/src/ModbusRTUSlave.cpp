@@ -0,0 +1,290 @@
+#include "ModbusRTUSlave.h"
+#include "CANTramCore.h"
+#include "Debug.h"
+
+/**
+ * @brief Add an interface to the table matching its type.
+ * @details Relais interfaces count as coils. The order of the calls defines the addresses.
+ *
+ * @param interface Interface to expose.
+ * @return true if the interface was added, false for bus interfaces or if the table is full.
+ */
+bool ModbusRTUSlave::addInterface(Interface* interface) {
+    if(interface == nullptr) return false;
+    Table table;
+    switch(interface->getType()) {
+        case Interface::DIGITAL_OUTPUT:
+        case Interface::RELAIS:         table = COILS; break;
+        case Interface::DIGITAL_INPUT:  table = DISCRETE_INPUTS; break;
+        case Interface::ANALOG_INPUT:   table = INPUT_REGISTERS; break;
+        case Interface::ANALOG_OUTPUT:  table = HOLDING_REGISTERS; break;
+        default: return false;
+    }
+    if(_counts[table] >= MAX_POINTS) {
+        ERROR_PRINTLN("[ModbusRTUSlave] Maximum number of " + String(MAX_POINTS) + " points in table " + String(table) + " reached.");
+        return false;
+    }
+    _points[table][_counts[table]++] = interface;
+    return true;
+}
+
+/**
+ * @brief Expose the interfaces of all modules attached to CANTramCore, in slot and interface order.
+ *
+ * @return true if all interfaces fit into the tables.
+ */
+bool ModbusRTUSlave::populate() {
+    bool result = true;
+    for(uint8_t slot=0; slot<CANTramCore::getMaxModules(); slot++) {
+        CANTramModule* module = CANTramCore::getModule(slot);
+        if(module == nullptr) continue;
+        Interface** interfaces = module->getInterfaces();
+        for(size_t i=0; i<module->getInterfaceCount(); i++) {
+            if(interfaces[i] == nullptr || interfaces[i]->getType() == Interface::BUS) continue;
+            result &= addInterface(interfaces[i]);
+        }
+    }
+    INFO_PRINTLN("[ModbusRTUSlave] Exposing " + String(_counts[COILS]) + " coils, " + String(_counts[DISCRETE_INPUTS]) + " discrete inputs, "
+                 + String(_counts[INPUT_REGISTERS]) + " input registers, " + String(_counts[HOLDING_REGISTERS]) + " holding registers.");
+    return result;
+}
+
+void ModbusRTUSlave::clear() {
+    memset(_counts, 0, sizeof(_counts));
+}
+
+/**
+ * @brief Start serving on a UART interface.
+ * @details Registers a receive callback at the UART core, so requests are answered in its receive task. The callback can only be
+ *          registered before the UART is started, i.e. before CANTramCore::initialize(). If the core does not support it,
+ *          process() must be called cyclically.
+ *
+ * @param uart UART interface to serve, configured for the baudrate.
+ * @param baudrate Baudrate of the UART, used for the T3.5 silence.
+ * @return true if the slave was started.
+ */
+bool ModbusRTUSlave::begin(UARTInterface* uart, uint32_t baudrate) {
+    if(_slaveId == Modbus::BROADCAST || _slaveId > Modbus::MAX_SLAVE) {
+        ERROR_PRINTLN("[ModbusRTUSlave] Invalid slave ID " + String(_slaveId) + ". Valid range is 1..247.");
+        return false;
+    }
+    if(uart == nullptr || uart->getUartCore() == nullptr) {
+        ERROR_PRINTLN("[ModbusRTUSlave] No UART core assigned.");
+        return false;
+    }
+    _t35Us = Modbus::t35Us(baudrate);
+    _rxLength = 0;
+    _skip = false;
+    _silent = true;
+    _otherSlave = Modbus::BROADCAST;
+    _responseFrom = Modbus::BROADCAST;
+    _statistics = {};
+    if(uart->getUartCore() != _callbackCore && uart->getUartCore()->setReceiveCallback([this](size_t) {
+            if(_uart) receive(micros());
+        })) {
+        _callbackCore = uart->getUartCore();
+    }
+    _eventDriven = uart->getUartCore() == _callbackCore;
+    _uart = uart;
+    INFO_PRINTLN("[ModbusRTUSlave] Modbus RTU slave " + String(_slaveId) + " started" + (_eventDriven ? " in the UART receive task." : ", call process() cyclically."));
+    return true;
+}
+
+void ModbusRTUSlave::end() {
+    _uart = nullptr;
+}
+
+/**
+ * @brief Serve received requests. Only needed if the UART core has no receive callback, see isEventDriven().
+ */
+void ModbusRTUSlave::process() {
+    process(micros());
+}
+
+/**
+ * @brief Serve received requests.
+ * @param nowUs Current time in microseconds.
+ */
+void ModbusRTUSlave::process(uint32_t nowUs) {
+    if(_uart == nullptr || _eventDriven) return;
+    receive(nowUs);
+}
+
+/**
+ * @brief Read the received bytes, split them into frames and answer complete requests.
+ * @details Frames end when their length is reached. A request with an unknown function code has no known length, it ends
+ *          with the first valid CRC, so it is answered with ILLEGAL_FUNCTION without waiting for the silence, which is not
+ *          detected in the receive task. After a request to another slave, its response is skipped by its length.
+ */
+void ModbusRTUSlave::receive(uint32_t nowUs) {
+    uint32_t startUs = micros();
+    while(true) {
+        size_t length = _uart->read(&_rx[_rxLength], sizeof(_rx) - _rxLength);
+        if(length == 0) {
+            if(!_silent && nowUs - _lastRxUs > _t35Us) {
+                _silent = true;
+                if(_rxLength > 0 && !_skip) handleFrame(_rxLength, startUs);
+                _rxLength = 0;
+                _skip = false;
+            }
+            return;
+        }
+        if(_silent || nowUs - _lastRxUs > _t35Us) {
+            //Start of a new frame, an incomplete frame is discarded
+            if(_rxLength > 0) memmove(_rx, &_rx[_rxLength], length);
+            _rxLength = 0;
+            _skip = false;
+            _silent = false;
+            _responseFrom = _otherSlave;
+            _otherSlave = Modbus::BROADCAST;
+        }
+        _lastRxUs = nowUs;
+        if(_skip) continue;
+        _rxLength += length;
+        bool response = _responseFrom != Modbus::BROADCAST && _rx[0] == _responseFrom;
+        size_t expected = Modbus::frameLength(_rx, _rxLength, !response);
+        if(expected == 0 && !response && !Modbus::isSupported(_rx[1])) expected = crcEnd(_rxLength - length);
+        if(expected == 0 ? _rxLength < sizeof(_rx) : _rxLength < expected) continue;
+        if(expected > 0 && !response) handleFrame(expected, startUs);
+        _responseFrom = Modbus::BROADCAST;
+        _rxLength = 0;
+        _skip = true;
+    }
+}
+
+/**
+ * @brief Find the end of a frame of unknown length by its CRC.
+ * @details A CRC matching by chance ends the frame early with a probability of 1/65536 per byte, the rest of the frame
+ *          is then skipped until the silence.
+ * @param from Number of bytes which were already checked.
+ * @return size_t Length of the frame up to the first valid CRC in the new bytes, 0 if none.
+ */
+size_t ModbusRTUSlave::crcEnd(size_t from) const {
+    for(size_t length=from < 4 ? 4 : from + 1; length<=_rxLength; length++) {
+        if(Modbus::checkCrc(_rx, length)) return length;
+    }
+    return 0;
+}
+
+/**
+ * @brief Check a complete frame and send the response.
+ * @param length Length of the frame including the CRC.
+ * @param receivedUs micros() when the last byte was read.
+ */
+void ModbusRTUSlave::handleFrame(size_t length, uint32_t receivedUs) {
+    if(!Modbus::checkCrc(_rx, length)) {
+        _statistics.crcErrors++;
+        return;
+    }
+    uint8_t address = _rx[0];
+    if(address != _slaveId && address != Modbus::BROADCAST) {
+        _statistics.otherSlaves++;
+        _otherSlave = address;
+        return;
+    }
+    _statistics.requests++;
+    uint8_t response[Modbus::MAX_ADU_SIZE];
+    size_t responseLength = execute(_rx, response);
+    if(response[1] & Modbus::EXCEPTION_FLAG) _statistics.exceptions++;
+    if(address == Modbus::BROADCAST) {
+        _statistics.broadcasts++;
+        return;
+    }
+    response[0] = _slaveId;
+    responseLength = Modbus::appendCrc(response, responseLength);
+    if(_uart->write(response, responseLength) < responseLength) return;
+    _statistics.responses++;
+    uint32_t duration = micros() - receivedUs;
+    if(duration > _statistics.maxResponseUs) _statistics.maxResponseUs = duration;
+}
+
+/**
+ * @brief Execute a request on the process image.
+ * @return size_t Length of the response without address and CRC, starting at response[1].
+ */
+size_t ModbusRTUSlave::execute(const uint8_t* request, uint8_t* response) {
+    uint8_t function = request[1];
+    uint16_t address = Modbus::get16(&request[2]);
+    uint16_t value = Modbus::get16(&request[4]);
+    response[1] = function;
+    switch(function) {
+        case Modbus::READ_COILS:
+            return readBits(COILS, address, value, response);
+        case Modbus::READ_DISCRETE_INPUTS:
+            return readBits(DISCRETE_INPUTS, address, value, response);
+        case Modbus::READ_HOLDING_REGISTERS:
+            return readRegisters(HOLDING_REGISTERS, address, value, response);
+        case Modbus::READ_INPUT_REGISTERS:
+            return readRegisters(INPUT_REGISTERS, address, value, response);
+        case Modbus::WRITE_SINGLE_COIL:
+            if(value != 0xFF00 && value != 0x0000) return exception(response, Modbus::ILLEGAL_DATA_VALUE);
+            if(address >= _counts[COILS]) return exception(response, Modbus::ILLEGAL_DATA_ADDRESS);
+            if(_points[COILS][address]->getQ() != (value ? 1 : 0)) _points[COILS][address]->setQ(value ? 1 : 0);
+            memcpy(&response[2], &request[2], 4);
+            return 6;
+        case Modbus::WRITE_SINGLE_REGISTER:
+            if(address >= _counts[HOLDING_REGISTERS]) return exception(response, Modbus::ILLEGAL_DATA_ADDRESS);
+            if(value > maxRegister(address)) return exception(response, Modbus::ILLEGAL_DATA_VALUE);
+            if(_points[HOLDING_REGISTERS][address]->getQ() != value) _points[HOLDING_REGISTERS][address]->setQ(value);
+            memcpy(&response[2], &request[2], 4);
+            return 6;
+        case Modbus::WRITE_MULTIPLE_COILS:
+            if(value == 0 || value > Modbus::MAX_WRITE_BITS || request[6] != (value + 7) / 8) return exception(response, Modbus::ILLEGAL_DATA_VALUE);
+            if(address + value > _counts[COILS]) return exception(response, Modbus::ILLEGAL_DATA_ADDRESS);
+            for(uint16_t i=0; i<value; i++) {
+                uint16_t q = (request[7 + i / 8] >> (i % 8)) & 1;
+                if(_points[COILS][address + i]->getQ() != q) _points[COILS][address + i]->setQ(q);
+            }
+            memcpy(&response[2], &request[2], 4);
+            return 6;
+        case Modbus::WRITE_MULTIPLE_REGISTERS:
+            if(value == 0 || value > Modbus::MAX_WRITE_REGISTERS || request[6] != 2 * value) return exception(response, Modbus::ILLEGAL_DATA_VALUE);
+            if(address + value > _counts[HOLDING_REGISTERS]) return exception(response, Modbus::ILLEGAL_DATA_ADDRESS);
+            //Check all values first, so a rejected request changes no output
+            for(uint16_t i=0; i<value; i++) {
+                if(Modbus::get16(&request[7 + 2 * i]) > maxRegister(address + i)) return exception(response, Modbus::ILLEGAL_DATA_VALUE);
+            }
+            for(uint16_t i=0; i<value; i++) {
+                uint16_t q = Modbus::get16(&request[7 + 2 * i]);
+                if(_points[HOLDING_REGISTERS][address + i]->getQ() != q) _points[HOLDING_REGISTERS][address + i]->setQ(q);
+            }
+            memcpy(&response[2], &request[2], 4);
+            return 6;
+        default:
+            return exception(response, Modbus::ILLEGAL_FUNCTION);
+    }
+}
+
+size_t ModbusRTUSlave::readBits(Table table, uint16_t address, uint16_t count, uint8_t* response) {
+    if(count == 0 || count > Modbus::MAX_READ_BITS) return exception(response, Modbus::ILLEGAL_DATA_VALUE);
+    if(address + count > _counts[table]) return exception(response, Modbus::ILLEGAL_DATA_ADDRESS);
+    Interface** points = &_points[table][address];
+    response[2] = (count + 7) / 8;
+    memset(&response[3], 0, response[2]);
+    for(uint16_t i=0; i<count; i++) {
+        if(points[i]->getQ()) response[3 + i / 8] |= 1 << (i % 8);
+    }
+    return 3 + response[2];
+}
+
+size_t ModbusRTUSlave::readRegisters(Table table, uint16_t address, uint16_t count, uint8_t* response) {
+    if(count == 0 || count > Modbus::MAX_READ_REGISTERS) return exception(response, Modbus::ILLEGAL_DATA_VALUE);
+    if(address + count > _counts[table]) return exception(response, Modbus::ILLEGAL_DATA_ADDRESS);
+    Interface** points = &_points[table][address];
+    response[2] = 2 * count;
+    for(uint16_t i=0; i<count; i++) Modbus::put16(&response[3 + 2 * i], points[i]->getQ());
+    return 3 + response[2];
+}
+
+/**
+ * @brief Get the maximum value of a holding register, given by the resolution of its analog output.
+ */
+uint16_t ModbusRTUSlave::maxRegister(uint16_t address) const {
+    return static_cast<AnalogOutput*>(_points[HOLDING_REGISTERS][address])->getMaxQ();
+}
+
+size_t ModbusRTUSlave::exception(uint8_t* response, Modbus::Exception code) {
+    response[1] |= Modbus::EXCEPTION_FLAG;
+    response[2] = code;
+    return 3;
+}
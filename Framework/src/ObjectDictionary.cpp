@@ -0,0 +1,298 @@
+#include "ObjectDictionary.h"
+#include <algorithm>
+#include "CANTramCore.h"
+#include "CANTramModule.h"
+#include "Debug.h"
+
+/**
+ * @brief Get the fixed size of a data type.
+ * @param type Data type of the entry.
+ * @return size_t Size in bytes, 0 for variable length types.
+ */
+size_t ObjectDictionary::getTypeSize(DataType type) {
+    switch(type) {
+        case UNSIGNED8:  return 1;
+        case UNSIGNED16: return 2;
+        case UNSIGNED32: return 4;
+        default:         return 0;
+    }
+}
+
+/**
+ * @brief Reserve the next free entry.
+ * @details Fails if the dictionary is already sealed or the storage is exhausted.
+ *
+ * @param index Object index.
+ * @param subIndex Object sub-index.
+ * @return Entry* Pointer to the reserved entry, nullptr on failure.
+ */
+ObjectDictionary::Entry* ObjectDictionary::reserve(uint16_t index, uint8_t subIndex) {
+    if(_sealed) {
+        ERROR_PRINTLN("[ObjectDictionary] Cannot add entry 0x" + String(index, HEX) + ":" + String(subIndex) + " to a sealed dictionary.");
+        return nullptr;
+    }
+    if(_entries == nullptr || _count >= _capacity) {
+        ERROR_PRINTLN("[ObjectDictionary] Maximum number of " + String(_capacity) + " entries reached.");
+        return nullptr;
+    }
+    Entry* entry = &_entries[_count++];
+    entry->key = (uint32_t(index) << 8) | subIndex;
+    entry->interface = nullptr;
+    entry->read = nullptr;
+    entry->write = nullptr;
+    return entry;
+}
+
+/**
+ * @brief Add an entry mapped onto the Q value of an interface.
+ * @details Output interfaces are read/write, all other interfaces are read-only. The value is transferred as UNSIGNED16.
+ *
+ * @param index Object index.
+ * @param subIndex Object sub-index.
+ * @param interface Interface to map.
+ * @return true if the entry was added.
+ */
+bool ObjectDictionary::addInterface(uint16_t index, uint8_t subIndex, Interface* interface) {
+    if(interface == nullptr) {
+        ERROR_PRINTLN("[ObjectDictionary] Cannot add null interface at 0x" + String(index, HEX) + ":" + String(subIndex) + ".");
+        return false;
+    }
+    Entry* entry = reserve(index, subIndex);
+    if(entry == nullptr) return false;
+
+    Interface::Type type = interface->getType();
+    bool writable = type == Interface::DIGITAL_OUTPUT || type == Interface::ANALOG_OUTPUT || type == Interface::RELAIS;
+    entry->type = UNSIGNED16;
+    entry->access = writable ? ACCESS_RW : ACCESS_RO;
+    entry->interface = interface;
+    return true;
+}
+
+/**
+ * @brief Add an entry backed by callbacks.
+ *
+ * @param index Object index.
+ * @param subIndex Object sub-index.
+ * @param type Data type of the entry.
+ * @param access Access rights of the entry.
+ * @param read Callback filling the buffer with the current value. Returns the number of bytes written.
+ * @param write Callback applying a new value. Returns false if the value was rejected.
+ * @return true if the entry was added.
+ */
+bool ObjectDictionary::addEntry(uint16_t index, uint8_t subIndex, DataType type, Access access, ReadCallback read, WriteCallback write) {
+    Entry* entry = reserve(index, subIndex);
+    if(entry == nullptr) return false;
+    entry->type = type;
+    entry->access = access;
+    entry->read = read;
+    entry->write = write;
+    return true;
+}
+
+/**
+ * @brief Add an UNSIGNED8 entry backed by a getter and an optional setter.
+ */
+bool ObjectDictionary::addU8(uint16_t index, uint8_t subIndex, Access access, std::function<uint8_t()> get, std::function<bool(uint8_t)> set) {
+    ReadCallback read = [get](uint8_t* buffer, size_t capacity) -> size_t {
+        if(capacity < 1 || !get) return 0;
+        buffer[0] = get();
+        return 1;
+    };
+    WriteCallback write = nullptr;
+    if(set) {
+        write = [set](const uint8_t* data, size_t length) -> bool {
+            return set(data[0]);
+        };
+    }
+    return addEntry(index, subIndex, UNSIGNED8, access, read, write);
+}
+
+/**
+ * @brief Add an UNSIGNED32 entry backed by a getter and an optional setter.
+ */
+bool ObjectDictionary::addU32(uint16_t index, uint8_t subIndex, Access access, std::function<uint32_t()> get, std::function<bool(uint32_t)> set) {
+    ReadCallback read = [get](uint8_t* buffer, size_t capacity) -> size_t {
+        if(capacity < 4 || !get) return 0;
+        uint32_t value = get();
+        for(uint8_t i=0; i<4; i++) buffer[i] = (value >> (8 * i)) & 0xFF;
+        return 4;
+    };
+    WriteCallback write = nullptr;
+    if(set) {
+        write = [set](const uint8_t* data, size_t length) -> bool {
+            uint32_t value = 0;
+            for(uint8_t i=0; i<4; i++) value |= uint32_t(data[i]) << (8 * i);
+            return set(value);
+        };
+    }
+    return addEntry(index, subIndex, UNSIGNED32, access, read, write);
+}
+
+/**
+ * @brief Fill the dictionary from all modules attached to CANTramCore.
+ * @details Adds the interfaces, the identification strings and the module specific configuration items
+ *          (see CANTramModule::addObjects()) of every attached module. Call after CANTramCore::initialize() and before seal().
+ *
+ * @return true if all entries could be added.
+ */
+bool ObjectDictionary::populate() {
+    bool result = true;
+    for(uint8_t slot=0; slot<CANTramCore::getMaxModules(); slot++) {
+        CANTramModule* module = CANTramCore::getModule(slot);
+        if(module == nullptr) continue;
+
+        //Interfaces
+        uint16_t index = INDEX_MODULE_INTERFACES + slot;
+        uint8_t count = module->getInterfaceCount();
+        result &= addU8(index, 0, ACCESS_RO, [count]() { return count; });
+        Interface** interfaces = module->getInterfaces();
+        for(uint8_t i=0; i<count; i++) {
+            if(interfaces[i] == nullptr || interfaces[i]->getType() == Interface::BUS) continue;
+            result &= addInterface(index, i + 1, interfaces[i]);
+        }
+
+        //Identification
+        auto copyString = [](const String& value, uint8_t* buffer, size_t capacity) -> size_t {
+            size_t length = value.length() < capacity ? value.length() : capacity;
+            memcpy(buffer, value.c_str(), length);
+            return length;
+        };
+        index = INDEX_MODULE_IDENTITY + slot;
+        result &= addEntry(index, 1, VISIBLE_STRING, ACCESS_RO, [module, copyString](uint8_t* buffer, size_t capacity) { return copyString(module->getHWType(), buffer, capacity); });
+        result &= addEntry(index, 2, VISIBLE_STRING, ACCESS_RO, [module, copyString](uint8_t* buffer, size_t capacity) { return copyString(module->getHWVersion(), buffer, capacity); });
+        result &= addEntry(index, 3, VISIBLE_STRING, ACCESS_RO, [module, copyString](uint8_t* buffer, size_t capacity) { return copyString(module->getFWVersion(), buffer, capacity); });
+
+        //Configuration
+        result &= module->addObjects(*this, INDEX_MODULE_CONFIG + slot);
+    }
+    INFO_PRINTLN("[ObjectDictionary] Populated dictionary with " + String(_count) + " entries.");
+    return result;
+}
+
+/**
+ * @brief Sort the entries and freeze the dictionary.
+ * @details After sealing no further entries can be added and lookups use a binary search. Duplicate keys are reported as an error.
+ *
+ * @return true if the dictionary is free of duplicates.
+ */
+bool ObjectDictionary::seal() {
+    std::sort(_entries, _entries + _count, [](const Entry& a, const Entry& b) { return a.key < b.key; });
+    _sealed = true;
+    for(size_t i=1; i<_count; i++) {
+        if(_entries[i].key == _entries[i-1].key) {
+            ERROR_PRINTLN("[ObjectDictionary] Duplicate entry 0x" + String(_entries[i].getIndex(), HEX) + ":" + String(_entries[i].getSubIndex()) + ".");
+            return false;
+        }
+    }
+    INFO_PRINTLN("[ObjectDictionary] Dictionary sealed with " + String(_count) + " entries.");
+    return true;
+}
+
+/**
+ * @brief Remove all entries and unseal the dictionary.
+ */
+void ObjectDictionary::clear() {
+    for(size_t i=0; i<_count; i++) {
+        _entries[i].read = nullptr;
+        _entries[i].write = nullptr;
+        _entries[i].interface = nullptr;
+    }
+    _count = 0;
+    _sealed = false;
+}
+
+/**
+ * @brief Get the position of the first entry with a key not less than the given key.
+ */
+size_t ObjectDictionary::lowerBound(uint32_t key) const {
+    size_t low = 0;
+    size_t high = _count;
+    while(low < high) {
+        size_t mid = low + (high - low) / 2;
+        if(_entries[mid].key < key) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+/**
+ * @brief Look up an entry.
+ * @details Requires a sealed dictionary, since the lookup relies on the sorted table.
+ *
+ * @param index Object index.
+ * @param subIndex Object sub-index.
+ * @return const Entry* The entry or nullptr if it does not exist.
+ */
+const ObjectDictionary::Entry* ObjectDictionary::find(uint16_t index, uint8_t subIndex) const {
+    if(!_sealed) {
+        DEV_ERROR_PRINTLN("[ObjectDictionary] Lookup on unsealed dictionary. Call seal() first.");
+        return nullptr;
+    }
+    uint32_t key = (uint32_t(index) << 8) | subIndex;
+    size_t pos = lowerBound(key);
+    if(pos < _count && _entries[pos].key == key) return &_entries[pos];
+    return nullptr;
+}
+
+/**
+ * @brief Check whether any sub-index of an object exists.
+ */
+bool ObjectDictionary::hasIndex(uint16_t index) const {
+    if(!_sealed) return false;
+    size_t pos = lowerBound(uint32_t(index) << 8);
+    return pos < _count && _entries[pos].getIndex() == index;
+}
+
+/**
+ * @brief Read the value of an entry.
+ *
+ * @param entry Entry to read.
+ * @param buffer Destination buffer.
+ * @param capacity Size of the destination buffer.
+ * @param length Number of bytes written into the buffer.
+ * @return AbortCode ABORT_OK on success, otherwise the SDO abort code.
+ */
+ObjectDictionary::AbortCode ObjectDictionary::read(const Entry* entry, uint8_t* buffer, size_t capacity, size_t& length) const {
+    length = 0;
+    if(entry == nullptr) return ABORT_NO_OBJECT;
+    if(entry->access == ACCESS_WO) return ABORT_WRITE_ONLY;
+
+    if(entry->interface) {
+        if(capacity < 2) return ABORT_OUT_OF_MEMORY;
+        uint16_t value = entry->interface->getQ();
+        buffer[0] = value & 0xFF;
+        buffer[1] = value >> 8;
+        length = 2;
+        return ABORT_OK;
+    }
+    if(!entry->read) return ABORT_GENERAL_ERROR;
+    length = entry->read(buffer, capacity);
+    size_t typeSize = getTypeSize(entry->type);
+    if(typeSize != 0 && length != typeSize) return ABORT_GENERAL_ERROR;
+    return ABORT_OK;
+}
+
+/**
+ * @brief Write a new value to an entry.
+ *
+ * @param entry Entry to write.
+ * @param data New value, little endian for numeric types.
+ * @param length Number of bytes in data.
+ * @return AbortCode ABORT_OK on success, otherwise the SDO abort code.
+ */
+ObjectDictionary::AbortCode ObjectDictionary::write(const Entry* entry, const uint8_t* data, size_t length) const {
+    if(entry == nullptr) return ABORT_NO_OBJECT;
+    if(entry->access == ACCESS_RO) return ABORT_READ_ONLY;
+    size_t typeSize = getTypeSize(entry->type);
+    if(typeSize != 0 && length != typeSize) return ABORT_LENGTH_MISMATCH;
+
+    if(entry->interface) {
+        uint16_t value = data[0] | (uint16_t(data[1]) << 8);
+        Interface::Type type = entry->interface->getType();
+        if((type == Interface::DIGITAL_OUTPUT || type == Interface::RELAIS) && value > 1) return ABORT_VALUE_RANGE;
+        entry->interface->setQ(value);
+        return ABORT_OK;
+    }
+    if(!entry->write) return ABORT_READ_ONLY;
+    return entry->write(data, length) ? ABORT_OK : ABORT_VALUE_RANGE;
+}
@@ -71,9 +71,21 @@ bool RelaisModuleV1_0::initialize(){
 
 void RelaisModuleV1_0::cycle(uint8_t* response){
     CANTramModule::cycle(response); 
+    writeOutputs();
+}
+
+/**
+ * @brief Writes the states of the relais interfaces to their GPIOs.
+ * 
+ * @return true if all relais were updated
+ * @return false if an interface is not valid
+ */
+bool RelaisModuleV1_0::writeOutputs(){
+    bool result = true;
     for(size_t i = 0; i < INTERFACE_COUNT; i++){
         if(!_relaisInterfaces[i].isValid()){
             WARNING_PRINTLN("[RelaisModuleV1_0] Cannot update interface " + _relaisInterfaces[i].getName() + " because it is not valid.");
+            result = false;
             continue;
         }
 
@@ -81,6 +93,7 @@ void RelaisModuleV1_0::cycle(uint8_t* response){
         _relaisGPIOs[i]->provider->setOutput(_relaisGPIOs[i], desiredState);
         
     }
+    return result;
 }
 
 Interface** RelaisModuleV1_0::getInterfaces(){
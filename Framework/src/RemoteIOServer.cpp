@@ -0,0 +1,194 @@
+#include "RemoteIOServer.h"
+#include "CANTramCore.h"
+#include "Debug.h"
+
+/**
+ * @brief Add an interface to the published points.
+ * @details The interface is appended to the group matching its type. Relais interfaces count as digital outputs.
+ *          The order of the calls defines the point numbers and must match the RemoteModule of the peer.
+ *
+ * @param interface Interface to publish.
+ * @return true if the interface was added, false for bus interfaces or if the group is full.
+ */
+bool RemoteIOServer::addInterface(Interface* interface) {
+    if(interface == nullptr) return false;
+    uint8_t group;
+    switch(interface->getType()) {
+        case Interface::DIGITAL_INPUT:  group = RemoteIO::DIGITAL_INPUTS; break;
+        case Interface::ANALOG_INPUT:   group = RemoteIO::ANALOG_INPUTS; break;
+        case Interface::DIGITAL_OUTPUT:
+        case Interface::RELAIS:         group = RemoteIO::DIGITAL_OUTPUTS; break;
+        case Interface::ANALOG_OUTPUT:  group = RemoteIO::ANALOG_OUTPUTS; break;
+        default: return false;
+    }
+    if(_counts[group] >= RemoteIO::getMaxPoints(group)) {
+        ERROR_PRINTLN("[RemoteIOServer] Maximum number of " + String(RemoteIO::getMaxPoints(group)) + " points in group " + String(group) + " reached.");
+        return false;
+    }
+    _points[group][_counts[group]++] = interface;
+    return true;
+}
+
+/**
+ * @brief Publish the interfaces of all modules attached to CANTramCore, in slot and interface order.
+ *
+ * @return true if all interfaces fit into the point tables.
+ */
+bool RemoteIOServer::populate() {
+    bool result = true;
+    for(uint8_t slot=0; slot<CANTramCore::getMaxModules(); slot++) {
+        CANTramModule* module = CANTramCore::getModule(slot);
+        if(module == nullptr) continue;
+        Interface** interfaces = module->getInterfaces();
+        for(size_t i=0; i<module->getInterfaceCount(); i++) {
+            if(interfaces[i] == nullptr || interfaces[i]->getType() == Interface::BUS) continue;
+            result &= addInterface(interfaces[i]);
+        }
+    }
+    INFO_PRINTLN("[RemoteIOServer] Publishing " + String(_counts[RemoteIO::DIGITAL_INPUTS]) + " DI, " + String(_counts[RemoteIO::ANALOG_INPUTS]) + " AI, "
+                 + String(_counts[RemoteIO::DIGITAL_OUTPUTS]) + " DQ, " + String(_counts[RemoteIO::ANALOG_OUTPUTS]) + " AQ.");
+    return result;
+}
+
+void RemoteIOServer::clear() {
+    memset(_counts, 0, sizeof(_counts));
+}
+
+/**
+ * @brief Start serving on a CAN interface.
+ * @details Registers the server as listener and publishes all inputs. Frames are handled when CANInterface::process() is called.
+ *
+ * @param canInterface Interface to serve.
+ * @return true if the server was registered.
+ */
+bool RemoteIOServer::begin(CANInterface* canInterface) {
+    if(_nodeId == 0 || _nodeId > 127) {
+        ERROR_PRINTLN("[RemoteIOServer] Invalid node ID " + String(_nodeId) + ". Valid range is 1..127.");
+        return false;
+    }
+    if(canInterface == nullptr) {
+        ERROR_PRINTLN("[RemoteIOServer] No CAN interface assigned.");
+        return false;
+    }
+    if(!canInterface->addListener(this)) {
+        return false;
+    }
+    _canInterface = canInterface;
+    _outputsActive = false;
+    _statistics = {};
+    publishInputs(true);
+    INFO_PRINTLN("[RemoteIOServer] Remote I/O server started for node " + String(_nodeId) + ".");
+    return true;
+}
+
+void RemoteIOServer::end() {
+    if(_canInterface) _canInterface->removeListener(this);
+    _canInterface = nullptr;
+}
+
+/**
+ * @brief Handle a received frame.
+ * @details Consumes all frames on the output COB-ID of this node: layout requests are answered with the layout followed by all inputs,
+ *          output blocks are applied and acknowledged.
+ */
+bool RemoteIOServer::onMessage(const CANCore::CANMessage& message) {
+    if(message.isExtended || message.isRemote || message.id != uint32_t(RemoteIO::COB_ID_OUTPUTS + _nodeId)) {
+        return false;
+    }
+    _statistics.framesReceived++;
+    if(message.length >= 1 && message.data[0] == RemoteIO::CMD_LAYOUT) {
+        sendLayout();
+        publishInputs(true);
+    } else if(RemoteIO::isBlock(message.data, message.length)) {
+        applyOutputs(message.data, message.length);
+    }
+    return true;
+}
+
+/**
+ * @brief Publish changed inputs, repeat all inputs every refresh interval and supervise the output timeout.
+ */
+void RemoteIOServer::cycle() {
+    if(_canInterface == nullptr) return;
+    uint32_t now = millis();
+    if(now - _lastRefresh >= _refreshIntervalMs) {
+        publishInputs(true);
+    } else if(now - _lastPublish >= _inhibitTimeMs) {
+        publishInputs(false);
+    }
+    if(_outputsActive && _outputTimeoutMs > 0 && now - _lastOutputs >= _outputTimeoutMs) {
+        WARNING_PRINTLN("[RemoteIOServer] No outputs received for " + String(_outputTimeoutMs) + " ms. Outputs reset.");
+        _statistics.outputTimeouts++;
+        _outputsActive = false;
+        resetOutputs();
+    }
+}
+
+/**
+ * @brief Send the input blocks which contain a changed value, or all blocks.
+ */
+void RemoteIOServer::publishInputs(bool all) {
+    uint32_t now = millis();
+    if(all) _lastRefresh = now;
+    const uint8_t groups[] = {RemoteIO::DIGITAL_INPUTS, RemoteIO::ANALOG_INPUTS};
+    for(uint8_t group : groups) {
+        uint16_t* values = _sentInputs[group];
+        for(uint8_t block=0; block<RemoteIO::getBlockCount(group, _counts[group]); block++) {
+            uint8_t first = block * RemoteIO::getPointsPerBlock(group);
+            bool changed = all;
+            for(uint8_t i=first; i<_counts[group] && i<first + RemoteIO::getPointsPerBlock(group); i++) {
+                uint16_t q = _points[group][i]->getQ();
+                if(RemoteIO::isDigital(group)) q = q ? 1 : 0;
+                if(values[i] != q) changed = true;
+                values[i] = q;
+            }
+            if(!changed) continue;
+            uint8_t data[8];
+            uint8_t length = RemoteIO::encodeBlock(data, group, block, _sequence++, values, _counts[group]);
+            send(data, length);
+            _lastPublish = now;
+        }
+    }
+}
+
+/**
+ * @brief Write a received output block to the output interfaces and acknowledge it.
+ */
+void RemoteIOServer::applyOutputs(const uint8_t* data, uint8_t length) {
+    uint8_t group = data[0] >> 6;
+    if(RemoteIO::isInput(group)) return;
+    uint16_t values[RemoteIO::MAX_POINTS];
+    uint8_t first = (data[0] & 0x3F) * RemoteIO::getPointsPerBlock(group);
+    int points = RemoteIO::decodeBlock(data, length, values, _counts[group]);
+    if(points < 0) {
+        WARNING_PRINTLN("[RemoteIOServer] Output block 0x" + String(data[0], HEX) + " does not match the layout. Ignored.");
+        return;
+    }
+    for(uint8_t i=first; i<first + points; i++) {
+        if(_points[group][i]->getQ() != values[i]) _points[group][i]->setQ(values[i]);
+    }
+    _lastOutputs = millis();
+    _outputsActive = true;
+    uint8_t ack[2] = {RemoteIO::CMD_ACK, data[1]};
+    send(ack, 2);
+}
+
+void RemoteIOServer::resetOutputs() {
+    const uint8_t groups[] = {RemoteIO::DIGITAL_OUTPUTS, RemoteIO::ANALOG_OUTPUTS};
+    for(uint8_t group : groups) {
+        for(uint8_t i=0; i<_counts[group]; i++) _points[group][i]->setQ(0);
+    }
+}
+
+void RemoteIOServer::sendLayout() {
+    uint8_t data[6] = {RemoteIO::CMD_LAYOUT, 0, _counts[0], _counts[1], _counts[2], _counts[3]};
+    send(data, 6);
+}
+
+void RemoteIOServer::send(const uint8_t* data, uint8_t length) {
+    CANCore::CANMessage message = {};
+    message.id = RemoteIO::COB_ID_INPUTS + _nodeId;
+    message.length = length;
+    memcpy(message.data, data, length);
+    if(_canInterface->sendMessage(message)) _statistics.framesSent++;
+}
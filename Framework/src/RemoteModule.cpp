@@ -0,0 +1,261 @@
+#include "RemoteModule.h"
+#include "Debug.h"
+
+const String RemoteModule::HW_TYPE = "RemoteModule";
+const String RemoteModule::HW_VERSION = "1.0";
+const String RemoteModule::FW_VERSION = "1.0";
+
+/**
+ * @brief Construct a new RemoteModule object.
+ * @details Point counts exceeding the maximum of their group are clamped.
+ * @param nodeId Node ID of the RemoteIOServer (1..127).
+ * @param digitalInputs Number of digital inputs of the server.
+ * @param analogInputs Number of analog inputs of the server.
+ * @param digitalOutputs Number of digital outputs (including relais) of the server.
+ * @param analogOutputs Number of analog outputs of the server.
+ */
+RemoteModule::RemoteModule(uint8_t nodeId, uint8_t digitalInputs, uint8_t analogInputs, uint8_t digitalOutputs, uint8_t analogOutputs)
+    : _nodeId(nodeId), _counts{digitalInputs, analogInputs, digitalOutputs, analogOutputs}
+{
+    for(uint8_t group=0; group<RemoteIO::GROUP_COUNT; group++) {
+        if(_counts[group] > RemoteIO::getMaxPoints(group)) {
+            ERROR_PRINTLN("[RemoteModule] " + String(_counts[group]) + " points in group " + String(group) + " exceed the maximum of " + String(RemoteIO::getMaxPoints(group)) + ".");
+            _counts[group] = RemoteIO::getMaxPoints(group);
+        }
+    }
+}
+
+/**
+ * @brief Add the mirrored interfaces.
+ * @details Interfaces are ordered digital inputs (I1..), analog inputs (AI1..), digital outputs (Q1..) and analog outputs (AQ1..).
+ *          They stay invalid until the server is online.
+ * @return true on success.
+ */
+bool RemoteModule::addInterfaces() {
+    _interfaceCount = 0;
+    const char* prefixes[RemoteIO::GROUP_COUNT] = {"I", "AI", "Q", "AQ"};
+    for(uint8_t group=0; group<RemoteIO::GROUP_COUNT; group++) {
+        for(uint8_t i=0; i<_counts[group]; i++) {
+            Interface* interface;
+            switch(group) {
+                case RemoteIO::DIGITAL_INPUTS:  interface = &_digitalInputs[i]; break;
+                case RemoteIO::ANALOG_INPUTS:
+                    _analogInputs[i] = AnalogInput(Interface::RES_16BIT);   // Raw values of the server are passed unchanged
+                    interface = &_analogInputs[i];
+                    break;
+                case RemoteIO::DIGITAL_OUTPUTS: interface = &_digitalOutputs[i]; break;
+                default:
+                    _analogOutputs[i] = AnalogOutput(Interface::RES_16BIT);
+                    interface = &_analogOutputs[i];
+                    break;
+            }
+            interface->rename(prefixes[group] + String(i + 1));
+            interface->validate(false);
+            _points[group][i] = interface;
+            _interfaces[_interfaceCount++] = interface;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Start mirroring the server over a CAN interface.
+ * @details Registers the module as listener and requests the layout of the server. Outputs are sent after the layout was confirmed.
+ *
+ * @param canInterface Interface connected to the bus of the server.
+ * @return true if the module was registered.
+ */
+bool RemoteModule::begin(CANInterface* canInterface) {
+    if(_nodeId == 0 || _nodeId > 127) {
+        ERROR_PRINTLN("[RemoteModule] Invalid node ID " + String(_nodeId) + ". Valid range is 1..127.");
+        return false;
+    }
+    if(canInterface == nullptr) {
+        ERROR_PRINTLN("[RemoteModule] No CAN interface assigned.");
+        return false;
+    }
+    if(!canInterface->addListener(this)) {
+        return false;
+    }
+    _canInterface = canInterface;
+    _layoutValid = false;
+    _layoutError = false;
+    _sequenceValid = false;
+    _inputReceived = false;
+    setOnline(false);
+    uint8_t request = RemoteIO::CMD_LAYOUT;
+    send(&request, 1);
+    _lastLayoutRequest = millis();
+    return true;
+}
+
+void RemoteModule::end() {
+    if(_canInterface) _canInterface->removeListener(this);
+    _canInterface = nullptr;
+    _layoutValid = false;
+    setOnline(false);
+}
+
+/**
+ * @brief Send changed outputs and repeat all outputs every refresh interval.
+ * @details Until the layout of the server is confirmed, the layout request is repeated instead.
+ * @param response Unused.
+ */
+void RemoteModule::cycle(uint8_t* response) {
+    if(_canInterface == nullptr) return;
+    uint32_t now = millis();
+    if(!_layoutValid) {
+        if(now - _lastLayoutRequest >= _refreshIntervalMs) {
+            uint8_t request = RemoteIO::CMD_LAYOUT;
+            send(&request, 1);
+            _lastLayoutRequest = now;
+        }
+        return;
+    }
+    if(now - _lastRefresh >= _refreshIntervalMs) {
+        sendOutputs(true);
+    } else if(now - _lastSend >= _inhibitTimeMs) {
+        sendOutputs(false);
+    }
+}
+
+/**
+ * @brief Handle a received frame.
+ * @details Consumes all frames on the input COB-ID of the server: input blocks, layout responses and output acknowledges.
+ */
+bool RemoteModule::onMessage(const CANCore::CANMessage& message) {
+    if(message.isExtended || message.isRemote || message.id != uint32_t(RemoteIO::COB_ID_INPUTS + _nodeId)) {
+        return false;
+    }
+    _statistics.framesReceived++;
+    if(message.length == 6 && message.data[0] == RemoteIO::CMD_LAYOUT) {
+        handleLayout(message.data);
+    } else if(message.length == 2 && message.data[0] == RemoteIO::CMD_ACK) {
+        handleAck(message.data[1]);
+    } else if(RemoteIO::isBlock(message.data, message.length)) {
+        handleInputs(message.data, message.length);
+    }
+    return true;
+}
+
+void RemoteModule::cycle() {
+    if(_online && millis() - _lastInput >= _staleTimeoutMs) {
+        WARNING_PRINTLN("[RemoteModule] No inputs from node " + String(_nodeId) + " for " + String(_staleTimeoutMs) + " ms. Interfaces invalidated.");
+        _statistics.staleCount++;
+        setOnline(false);
+    }
+}
+
+void RemoteModule::resetStatistics() {
+    _statistics = {};
+}
+
+/**
+ * @brief Send the output blocks which contain a changed value, or all blocks.
+ */
+void RemoteModule::sendOutputs(bool all) {
+    uint32_t now = millis();
+    if(all) _lastRefresh = now;
+    const uint8_t groups[] = {RemoteIO::DIGITAL_OUTPUTS, RemoteIO::ANALOG_OUTPUTS};
+    for(uint8_t group : groups) {
+        uint16_t* values = _values[group];
+        for(uint8_t block=0; block<RemoteIO::getBlockCount(group, _counts[group]); block++) {
+            uint8_t first = block * RemoteIO::getPointsPerBlock(group);
+            bool changed = all;
+            for(uint8_t i=first; i<_counts[group] && i<first + RemoteIO::getPointsPerBlock(group); i++) {
+                uint16_t q = _points[group][i]->getQ();
+                if(RemoteIO::isDigital(group)) q = q ? 1 : 0;
+                if(values[i] != q) changed = true;
+                values[i] = q;
+            }
+            if(!changed) continue;
+            uint8_t data[8];
+            uint8_t sequence = _txSequence++;
+            uint8_t length = RemoteIO::encodeBlock(data, group, block, sequence, values, _counts[group]);
+            if(send(data, length)) {
+                _ackSentUs[sequence % ACK_SLOTS] = micros();
+                _ackPending[sequence % ACK_SLOTS] = true;
+            }
+            _lastSend = now;
+        }
+    }
+}
+
+/**
+ * @brief Update the input interfaces from a received block and track sequence gaps and update intervals.
+ */
+void RemoteModule::handleInputs(const uint8_t* data, uint8_t length) {
+    uint8_t group = data[0] >> 6;
+    if(!_layoutValid || !RemoteIO::isInput(group)) return;
+    if(_sequenceValid && data[1] != uint8_t(_rxSequence + 1)) {
+        _statistics.lostFrames += uint8_t(data[1] - _rxSequence - 1);
+    }
+    _rxSequence = data[1];
+    _sequenceValid = true;
+
+    uint8_t first = (data[0] & 0x3F) * RemoteIO::getPointsPerBlock(group);
+    int points = RemoteIO::decodeBlock(data, length, _values[group], _counts[group]);
+    if(points < 0) {
+        WARNING_PRINTLN("[RemoteModule] Input block 0x" + String(data[0], HEX) + " does not match the layout. Ignored.");
+        return;
+    }
+    for(uint8_t i=first; i<first + points; i++) {
+        if(_points[group][i]->getQ() != _values[group][i]) _points[group][i]->setQ(_values[group][i]);
+    }
+    uint32_t now = millis();
+    if(_inputReceived && now - _lastInput > _statistics.maxInputIntervalMs) _statistics.maxInputIntervalMs = now - _lastInput;
+    _lastInput = now;
+    _inputReceived = true;
+    if(!_online) setOnline(true);
+}
+
+/**
+ * @brief Compare the layout reported by the server with the configured point counts.
+ * @details A mismatch after the layout was confirmed, e.g. a server restarted with another configuration, takes the module offline.
+ */
+void RemoteModule::handleLayout(const uint8_t* data) {
+    if(memcmp(&data[2], _counts, RemoteIO::GROUP_COUNT) != 0) {
+        if(!_layoutError) {
+            ERROR_PRINTLN("[RemoteModule] Layout of node " + String(_nodeId) + " (" + String(data[2]) + " DI, " + String(data[3]) + " AI, " + String(data[4]) + " DQ, "
+                          + String(data[5]) + " AQ) does not match the module. Outputs are not sent.");
+        }
+        _layoutError = true;
+        _layoutValid = false;
+        if(_online) setOnline(false);
+        return;
+    }
+    if(_layoutValid) return;
+    INFO_PRINTLN("[RemoteModule] Layout of node " + String(_nodeId) + " confirmed.");
+    _layoutValid = true;
+    _layoutError = false;
+    sendOutputs(true);
+}
+
+void RemoteModule::handleAck(uint8_t sequence) {
+    uint8_t slot = sequence % ACK_SLOTS;
+    if(!_ackPending[slot]) return;
+    _ackPending[slot] = false;
+    uint32_t latency = micros() - _ackSentUs[slot];
+    if(_statistics.acknowledged == 0 || latency < _statistics.minOutputLatencyUs) _statistics.minOutputLatencyUs = latency;
+    if(latency > _statistics.maxOutputLatencyUs) _statistics.maxOutputLatencyUs = latency;
+    _statistics.totalOutputLatencyUs += latency;
+    _statistics.acknowledged++;
+}
+
+/**
+ * @brief Mark all mirrored interfaces valid or invalid.
+ */
+void RemoteModule::setOnline(bool online) {
+    _online = online;
+    for(size_t i=0; i<_interfaceCount; i++) _interfaces[i]->validate(online);
+}
+
+bool RemoteModule::send(const uint8_t* data, uint8_t length) {
+    CANCore::CANMessage message = {};
+    message.id = RemoteIO::COB_ID_OUTPUTS + _nodeId;
+    message.length = length;
+    memcpy(message.data, data, length);
+    if(!_canInterface->sendMessage(message)) return false;
+    _statistics.framesSent++;
+    return true;
+}
@@ -0,0 +1,292 @@
+#include "SDOServer.h"
+#include "Debug.h"
+
+/**
+ * @brief Start serving SDO requests on a CAN interface.
+ * @details Registers the server as listener at the interface. Frames are handled when CANInterface::process() is called.
+ *
+ * @param canInterface Interface to serve.
+ * @return true if the server was registered.
+ * @return false if the dictionary is not sealed or the interface has no free listener slot.
+ */
+bool SDOServer::begin(CANInterface* canInterface) {
+    if(_od == nullptr || !_od->isSealed()) {
+        ERROR_PRINTLN("[SDOServer] Object dictionary missing or not sealed. Call ObjectDictionary::seal() before begin().");
+        return false;
+    }
+    if(canInterface == nullptr) {
+        ERROR_PRINTLN("[SDOServer] No CAN interface assigned.");
+        return false;
+    }
+    if(!canInterface->addListener(this)) {
+        return false;
+    }
+    _canInterface = canInterface;
+    _state = IDLE;
+    INFO_PRINTLN("[SDOServer] SDO server started for node " + String(_nodeId) + " with " + String(_od->size()) + " objects.");
+    return true;
+}
+
+/**
+ * @brief Stop serving SDO requests.
+ */
+void SDOServer::end() {
+    if(_canInterface) _canInterface->removeListener(this);
+    _canInterface = nullptr;
+    _state = IDLE;
+}
+
+/**
+ * @brief Set the CANopen node ID.
+ *
+ * @param nodeId Node ID in the range 1..127.
+ * @return true if the node ID is valid.
+ */
+bool SDOServer::setNodeId(uint8_t nodeId) {
+    if(nodeId == 0 || nodeId > 127) {
+        ERROR_PRINTLN("[SDOServer] Invalid node ID " + String(nodeId) + ". Valid range is 1..127.");
+        return false;
+    }
+    _nodeId = nodeId;
+    _state = IDLE;
+    return true;
+}
+
+/**
+ * @brief Handle a received frame.
+ * @details Consumes all frames addressed to the SDO request COB-ID of this node and dispatches them by the client command specifier.
+ *
+ * @param message Received frame.
+ * @return true if the frame was an SDO request for this node.
+ */
+bool SDOServer::onMessage(const CANCore::CANMessage& message) {
+    if(message.isExtended || message.isRemote || message.id != uint32_t(COB_ID_REQUEST + _nodeId)) {
+        return false;
+    }
+    const uint8_t* data = message.data;
+    if(message.length != 8) {
+        sendAbort(0, 0, ObjectDictionary::ABORT_INVALID_COMMAND);
+        return true;
+    }
+    _lastActivity = millis();
+    uint8_t ccs = data[0] >> 5;
+    switch(ccs) {
+        case 0: downloadSegment(data); break;
+        case 1: initiateDownload(data); break;
+        case 2: initiateUpload(data); break;
+        case 3: uploadSegment(data); break;
+        case 4:
+            //Abort by client, no response
+            DEBUG_PRINTLN("[SDOServer] Transfer aborted by client.");
+            _state = IDLE;
+            break;
+        default:
+            sendAbort(data[1] | (uint16_t(data[2]) << 8), data[3], ObjectDictionary::ABORT_INVALID_COMMAND);
+            break;
+    }
+    return true;
+}
+
+/**
+ * @brief Abort segmented transfers that timed out.
+ */
+void SDOServer::cycle() {
+    if(_state == IDLE) return;
+    if(millis() - _lastActivity > TIMEOUT_MS) {
+        WARNING_PRINTLN("[SDOServer] Segmented transfer of 0x" + String(_index, HEX) + ":" + String(_subIndex) + " timed out.");
+        sendAbort(_index, _subIndex, ObjectDictionary::ABORT_TIMEOUT);
+    }
+}
+
+/**
+ * @brief Look up an entry and report the matching abort code if it does not exist.
+ */
+const ObjectDictionary::Entry* SDOServer::lookup(uint16_t index, uint8_t subIndex) {
+    const ObjectDictionary::Entry* entry = _od->find(index, subIndex);
+    if(entry == nullptr) {
+        sendAbort(index, subIndex, _od->hasIndex(index) ? ObjectDictionary::ABORT_NO_SUBINDEX : ObjectDictionary::ABORT_NO_OBJECT);
+    }
+    return entry;
+}
+
+/**
+ * @brief Handle an initiate download request (client writes an object).
+ * @details Expedited requests are written immediately. Segmented requests are collected in the transfer buffer and written after the last segment.
+ */
+void SDOServer::initiateDownload(const uint8_t* data) {
+    uint16_t index = data[1] | (uint16_t(data[2]) << 8);
+    uint8_t subIndex = data[3];
+    _state = IDLE;
+    const ObjectDictionary::Entry* entry = lookup(index, subIndex);
+    if(entry == nullptr) return;
+    if(entry->access == ObjectDictionary::ACCESS_RO) {
+        sendAbort(index, subIndex, ObjectDictionary::ABORT_READ_ONLY);
+        return;
+    }
+
+    bool expedited = data[0] & 0x02;
+    bool sizeIndicated = data[0] & 0x01;
+    uint8_t response[3] = {data[1], data[2], data[3]};
+
+    if(expedited) {
+        size_t length = 4;
+        if(sizeIndicated) {
+            length = 4 - ((data[0] >> 2) & 0x03);
+        } else if(ObjectDictionary::getTypeSize(entry->type) != 0) {
+            length = ObjectDictionary::getTypeSize(entry->type);
+        }
+        uint32_t code = _od->write(entry, &data[4], length);
+        if(code != ObjectDictionary::ABORT_OK) {
+            sendAbort(index, subIndex, code);
+            return;
+        }
+        sendResponse(0x60, response, 3);
+        return;
+    }
+
+    //Segmented download
+    _size = 0;
+    if(sizeIndicated) {
+        _size = data[4] | (uint32_t(data[5]) << 8) | (uint32_t(data[6]) << 16) | (uint32_t(data[7]) << 24);
+        if(_size > BUFFER_SIZE) {
+            sendAbort(index, subIndex, ObjectDictionary::ABORT_OUT_OF_MEMORY);
+            return;
+        }
+    }
+    _entry = entry;
+    _index = index;
+    _subIndex = subIndex;
+    _offset = 0;
+    _toggle = 0;
+    _state = DOWNLOAD_SEGMENTED;
+    sendResponse(0x60, response, 3);
+}
+
+/**
+ * @brief Handle a download segment of a segmented write.
+ */
+void SDOServer::downloadSegment(const uint8_t* data) {
+    if(_state != DOWNLOAD_SEGMENTED) {
+        sendAbort(_index, _subIndex, ObjectDictionary::ABORT_INVALID_COMMAND);
+        return;
+    }
+    uint8_t toggle = (data[0] >> 4) & 0x01;
+    if(toggle != _toggle) {
+        sendAbort(_index, _subIndex, ObjectDictionary::ABORT_TOGGLE_BIT);
+        return;
+    }
+    size_t length = 7 - ((data[0] >> 1) & 0x07);
+    bool last = data[0] & 0x01;
+    if(_offset + length > BUFFER_SIZE) {
+        sendAbort(_index, _subIndex, ObjectDictionary::ABORT_OUT_OF_MEMORY);
+        return;
+    }
+    memcpy(&_buffer[_offset], &data[1], length);
+    _offset += length;
+
+    if(last) {
+        if(_size != 0 && _offset != _size) {
+            sendAbort(_index, _subIndex, ObjectDictionary::ABORT_LENGTH_MISMATCH);
+            return;
+        }
+        uint32_t code = _od->write(_entry, _buffer, _offset);
+        if(code != ObjectDictionary::ABORT_OK) {
+            sendAbort(_index, _subIndex, code);
+            return;
+        }
+        _state = IDLE;
+    }
+    sendResponse(0x20 | (toggle << 4), nullptr, 0);
+    _toggle ^= 0x01;
+}
+
+/**
+ * @brief Handle an initiate upload request (client reads an object).
+ * @details Values of 1 to 4 bytes are answered expedited, larger and empty values start a segmented upload. An expedited
+ *          response cannot indicate 0 bytes, so an empty value is sent as a segmented upload of size 0 with one empty segment.
+ */
+void SDOServer::initiateUpload(const uint8_t* data) {
+    uint16_t index = data[1] | (uint16_t(data[2]) << 8);
+    uint8_t subIndex = data[3];
+    _state = IDLE;
+    const ObjectDictionary::Entry* entry = lookup(index, subIndex);
+    if(entry == nullptr) return;
+
+    size_t length = 0;
+    uint32_t code = _od->read(entry, _buffer, BUFFER_SIZE, length);
+    if(code != ObjectDictionary::ABORT_OK) {
+        sendAbort(index, subIndex, code);
+        return;
+    }
+
+    uint8_t response[7] = {data[1], data[2], data[3], 0, 0, 0, 0};
+    if(length > 0 && length <= 4) {
+        memcpy(&response[3], _buffer, length);
+        sendResponse(0x43 | ((4 - length) << 2), response, 7);
+        return;
+    }
+
+    //Segmented upload
+    for(uint8_t i=0; i<4; i++) response[3 + i] = (length >> (8 * i)) & 0xFF;
+    _index = index;
+    _subIndex = subIndex;
+    _size = length;
+    _offset = 0;
+    _toggle = 0;
+    _state = UPLOAD_SEGMENTED;
+    sendResponse(0x41, response, 7);
+}
+
+/**
+ * @brief Handle an upload segment request of a segmented read.
+ */
+void SDOServer::uploadSegment(const uint8_t* data) {
+    if(_state != UPLOAD_SEGMENTED) {
+        sendAbort(_index, _subIndex, ObjectDictionary::ABORT_INVALID_COMMAND);
+        return;
+    }
+    uint8_t toggle = (data[0] >> 4) & 0x01;
+    if(toggle != _toggle) {
+        sendAbort(_index, _subIndex, ObjectDictionary::ABORT_TOGGLE_BIT);
+        return;
+    }
+    size_t remaining = _size - _offset;
+    uint8_t length = remaining > 7 ? 7 : remaining;
+    bool last = remaining <= 7;
+    uint8_t command = (toggle << 4) | ((7 - length) << 1) | (last ? 0x01 : 0x00);
+    sendResponse(command, &_buffer[_offset], length);
+    _offset += length;
+    _toggle ^= 0x01;
+    if(last) _state = IDLE;
+}
+
+/**
+ * @brief Send an SDO response frame.
+ * @details The frame is always 8 bytes long; unused bytes are zero.
+ *
+ * @param command Server command specifier byte.
+ * @param payload Bytes following the command byte.
+ * @param length Number of payload bytes (max. 7).
+ */
+void SDOServer::sendResponse(uint8_t command, const uint8_t* payload, uint8_t length) {
+    if(_canInterface == nullptr) return;
+    CANCore::CANMessage message = {};
+    message.id = COB_ID_RESPONSE + _nodeId;
+    message.length = 8;
+    message.data[0] = command;
+    if(payload) memcpy(&message.data[1], payload, length);
+    _canInterface->sendMessage(message);
+}
+
+/**
+ * @brief Send an SDO abort frame and reset the transfer state.
+ */
+void SDOServer::sendAbort(uint16_t index, uint8_t subIndex, uint32_t code) {
+    DEBUG_PRINTLN("[SDOServer] Abort 0x" + String(index, HEX) + ":" + String(subIndex) + ", code 0x" + String(code, HEX));
+    _state = IDLE;
+    uint8_t payload[7] = {
+        uint8_t(index & 0xFF), uint8_t(index >> 8), subIndex,
+        uint8_t(code & 0xFF), uint8_t((code >> 8) & 0xFF), uint8_t((code >> 16) & 0xFF), uint8_t(code >> 24)
+    };
+    sendResponse(0x80, payload, 7);
+}
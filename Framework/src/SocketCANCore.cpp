@@ -0,0 +1,231 @@
+#ifdef __linux__
+
+#include "SocketCANCore.h"
+#include "Debug.h"
+
+SocketCANCore::SocketCANCore(const char* interfaceName) {
+    setInterfaceName(interfaceName);
+}
+
+/**
+ * @brief Set the network interface used by begin(), e.g. "can0" or "vcan0".
+ */
+void SocketCANCore::setInterfaceName(const char* interfaceName) {
+    strncpy(_interfaceName, interfaceName, sizeof(_interfaceName) - 1);
+    _interfaceName[sizeof(_interfaceName) - 1] = '\0';
+}
+
+/**
+ * @brief Open the SocketCAN interface.
+ * @details A filter configured with setupFilter() before begin() is applied to the new socket.
+ *
+ * @return true if the socket was opened and bound to the interface.
+ */
+bool SocketCANCore::begin() {
+    if(_isInitialized) {
+        WARNING_PRINTLN("[SocketCANCore] Interface already initialized.");
+        return true;
+    }
+    if(!_port.open(_interfaceName, true)) {
+        ERROR_PRINTLN("[SocketCANCore] Failed to open " + String(_interfaceName) + ": " + String(strerror(errno)));
+        return false;
+    }
+    if(_filterType != FILTER_ACCEPT_ALL && !_port.setFilter(_filterId, _filterMask, _filterId > CAN_SFF_MASK)) {
+        ERROR_PRINTLN("[SocketCANCore] Failed to apply the acceptance filter.");
+        _port.close();
+        return false;
+    }
+    _rxCount = 0;
+    _rxIndex = 0;
+    _txCount = 0;
+    _controllerOverruns = 0;
+    _busOffSince = 0;
+    _status = STATUS_OK;
+    _statistics = {};
+    _isInitialized = true;
+    INFO_PRINTLN("[SocketCANCore] Opened " + String(_interfaceName) + ".");
+    return true;
+}
+
+bool SocketCANCore::setBaudrate(Baudrate baudrate) {
+    _baudrate = baudrate;
+    INFO_PRINTLN("[SocketCANCore] Baudrate stored. Configure the adapter with: ip link set " + String(_interfaceName)
+                 + " type can bitrate " + String(uint32_t(baudrate)));
+    return true;
+}
+
+bool SocketCANCore::setPins(int8_t txPin, int8_t rxPin) {
+    _txPin = txPin;
+    _rxPin = rxPin;
+    return true;
+}
+
+/**
+ * @brief Send pending frames and close the socket.
+ */
+bool SocketCANCore::end() {
+    if(!_isInitialized) return true;
+    if(!flush()) {
+        WARNING_PRINTLN("[SocketCANCore] " + String(_txCount) + " frames could not be sent.");
+    }
+    _port.close();
+    _isInitialized = false;
+    return true;
+}
+
+/**
+ * @brief Queue a frame for transmission.
+ * @details The frame is handed to the kernel with the next batch, see flush().
+ *
+ * @return true if the frame was queued, false if the batch is full and the kernel does not accept frames.
+ */
+bool SocketCANCore::sendMessage(const CANMessage& message) {
+    if(!_isInitialized) {
+        ERROR_PRINTLN("[SocketCANCore] CAN interface not initialized. Cannot send message.");
+        return false;
+    }
+    if(_status == STATUS_BUS_OFF) {
+        ERROR_PRINTLN("[SocketCANCore] Controller is bus-off. Message dropped.");
+        _statistics.txFailed++;
+        return false;
+    }
+    if(_txCount >= SocketCANPort::BATCH_SIZE) flush();
+    if(_txCount >= SocketCANPort::BATCH_SIZE) {
+        ERROR_PRINTLN("[SocketCANCore] Send queue full. Message dropped.");
+        _statistics.txFailed++;
+        return false;
+    }
+    _txFrames[_txCount++] = toFrame(message, 0);
+    _statistics.txFrames++;
+    return true;
+}
+
+bool SocketCANCore::readMessage(CANMessage& message) {
+    CANFrame frame;
+    if(!readFrame(frame)) {
+        ERROR_PRINTLN("[SocketCANCore] No CAN message available to read.");
+        message.error = true;
+        return false;
+    }
+    fromFrame(frame, message);
+    return true;
+}
+
+/**
+ * @brief Read a received frame with the kernel receive timestamp.
+ *
+ * @param frame Destination of the frame, the timestamp is based on micros().
+ * @return true if a frame was read.
+ */
+bool SocketCANCore::readFrame(CANFrame& frame) {
+    if(!_isInitialized) return false;
+    if(_rxIndex >= _rxCount) fill();
+    if(_rxIndex >= _rxCount) return false;
+    frame = _rxFrames[_rxIndex++];
+    return true;
+}
+
+/**
+ * @brief Send queued frames and get the number of received frames.
+ * @return uint8_t Number of frames in the current receive batch. More frames may be pending in the kernel.
+ */
+uint8_t SocketCANCore::available() {
+    if(!_isInitialized) {
+        ERROR_PRINTLN("[SocketCANCore] CAN interface not initialized. Cannot check available messages.");
+        return 0;
+    }
+    if(_txCount > 0) flush();
+    if(_rxIndex >= _rxCount) fill();
+    return _rxCount - _rxIndex;
+}
+
+/**
+ * @brief Set the acceptance filter, applied in the kernel via CAN_RAW_FILTER.
+ * @details A frame passes if (frameId & mask) == (id & mask). Identifiers above 0x7FF select extended frames, a mask of 0 accepts all frames.
+ */
+bool SocketCANCore::setupFilter(uint32_t id, uint32_t mask) {
+    _filterId = id;
+    _filterMask = mask;
+    _filterType = mask == 0 ? FILTER_ACCEPT_ALL : (mask == CAN_EFF_MASK ? FILTER_MATCH_ID : FILTER_MASKED);
+    if(_isInitialized && !_port.setFilter(id, mask, id > CAN_SFF_MASK)) {
+        ERROR_PRINTLN("[SocketCANCore] Failed to apply the acceptance filter.");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Hand all queued frames to the kernel in one call.
+ * @return true if all queued frames were accepted. Frames not accepted stay queued.
+ */
+bool SocketCANCore::flush() {
+    if(_txCount == 0) return true;
+    size_t sent = _port.send(_txFrames, _txCount);
+    if(sent < _txCount) {
+        memmove(_txFrames, &_txFrames[sent], (_txCount - sent) * sizeof(CANFrame));
+    }
+    _txCount -= sent;
+    return _txCount == 0;
+}
+
+/**
+ * @brief Fetch the next batch of frames from the kernel.
+ * @details Kernel timestamps are moved into the micros() time base. Error frames are handled and removed from the batch.
+ */
+void SocketCANCore::fill() {
+    _rxIndex = 0;
+    _rxCount = 0;
+    size_t count = _port.receive(_rxFrames, SocketCANPort::BATCH_SIZE);
+    uint32_t offset = micros() - SocketCANPort::monotonicUs();
+    for(size_t i=0; i<count; i++) {
+        if(_rxFrames[i].isError()) {
+            handleErrorFrame(_rxFrames[i]);
+            continue;
+        }
+        CANFrame& frame = _rxFrames[_rxCount++];
+        frame = _rxFrames[i];
+        frame.setTimestamp(frame.getTimestamp() + offset);
+        _statistics.rxFrames++;
+    }
+    _statistics.rxOverruns = _controllerOverruns + _port.getDropped();
+}
+
+/**
+ * @brief Update status and statistics from an error frame of the kernel driver.
+ */
+void SocketCANCore::handleErrorFrame(const CANFrame& frame) {
+    uint32_t errorClass = frame.getId();
+    if(errorClass & CAN_ERR_LOSTARB) _statistics.arbitrationLost++;
+    if(errorClass & CAN_ERR_BUSERROR) _statistics.busErrors++;
+    if(errorClass & CAN_ERR_CRTL) {
+        uint8_t state = frame.data[1];
+        if(state & CAN_ERR_CRTL_RX_OVERFLOW) _controllerOverruns++;
+        if(state & (CAN_ERR_CRTL_RX_PASSIVE | CAN_ERR_CRTL_TX_PASSIVE)) _status = STATUS_ERROR_PASSIVE;
+        else if(state & (CAN_ERR_CRTL_RX_WARNING | CAN_ERR_CRTL_TX_WARNING)) _status = STATUS_ERROR_ACTIVE;
+#ifdef CAN_ERR_CRTL_ACTIVE
+        else if(state & CAN_ERR_CRTL_ACTIVE) _status = STATUS_OK;
+#endif
+    }
+#ifdef CAN_ERR_CNT
+    if(errorClass & CAN_ERR_CNT) {
+        _statistics.txErrorCounter = frame.data[6];
+        _statistics.rxErrorCounter = frame.data[7];
+    }
+#endif
+    if(errorClass & CAN_ERR_BUSOFF) {
+        if(_status != STATUS_BUS_OFF) {
+            _statistics.busOffCount++;
+            _busOffSince = millis();
+        }
+        _status = STATUS_BUS_OFF;
+        WARNING_PRINTLN("[SocketCANCore] Bus-off on " + String(_interfaceName) + ". Recovery is handled by the kernel (restart-ms).");
+    }
+    if(errorClass & CAN_ERR_RESTARTED) {
+        if(_busOffSince != 0) _statistics.lastRecoveryMs = millis() - _busOffSince;
+        _busOffSince = 0;
+        _status = STATUS_OK;
+        INFO_PRINTLN("[SocketCANCore] Controller restarted.");
+    }
+}
+
+#endif // __linux__
@@ -0,0 +1,215 @@
+#include "TelemetryPublisher.h"
+#include "Debug.h"
+
+/**
+ * @brief Add the value Q of an interface as 16 bit signal.
+ * @param interface Interface to sample.
+ * @param decimation Sample the interface in every decimation-th sample period.
+ * @param name Signal name, the name of the interface if nullptr. Truncated to Telemetry::MAX_NAME_LENGTH characters.
+ * @return true if the signal was added.
+ */
+bool TelemetryPublisher::addInterface(Interface* interface, uint16_t decimation, const char* name) {
+    if(interface == nullptr) {
+        ERROR_PRINTLN("[TelemetryPublisher] Interface is null.");
+        return false;
+    }
+    String interfaceName = interface->getName();
+    return addSignal(name != nullptr ? name : interfaceName.c_str(), Telemetry::U16, [interface]() -> uint32_t { return interface->getQ(); }, decimation);
+}
+
+/**
+ * @brief Add an unsigned 32 bit metric, e.g. a counter of a statistics structure.
+ * @param name Signal name, truncated to Telemetry::MAX_NAME_LENGTH characters.
+ * @param source Function returning the current value, called in cycle().
+ * @param decimation Sample the metric in every decimation-th sample period.
+ * @return true if the signal was added.
+ */
+bool TelemetryPublisher::addMetric(const char* name, std::function<uint32_t()> source, uint16_t decimation) {
+    return addSignal(name, Telemetry::U32, source, decimation);
+}
+
+bool TelemetryPublisher::addSignedMetric(const char* name, std::function<int32_t()> source, uint16_t decimation) {
+    if(!source) return addSignal(name, Telemetry::I32, nullptr, decimation);
+    return addSignal(name, Telemetry::I32, [source]() -> uint32_t { return uint32_t(source()); }, decimation);
+}
+
+bool TelemetryPublisher::addFloatMetric(const char* name, std::function<float()> source, uint16_t decimation) {
+    if(!source) return addSignal(name, Telemetry::F32, nullptr, decimation);
+    return addSignal(name, Telemetry::F32, [source]() -> uint32_t {
+        float value = source();
+        uint32_t raw;
+        memcpy(&raw, &value, sizeof(raw));
+        return raw;
+    }, decimation);
+}
+
+/**
+ * @brief Remove all signals. A new schema is sent with the next cycle().
+ */
+void TelemetryPublisher::clear() {
+    for(uint8_t i=0; i<_signalCount; i++) _sources[i] = nullptr;
+    _signalCount = 0;
+    _schemaId++;
+    _schemaDue = true;
+}
+
+/**
+ * @brief Add a signal and announce the changed schema with the next cycle().
+ */
+bool TelemetryPublisher::addSignal(const char* name, Telemetry::Type type, std::function<uint32_t()> source, uint16_t decimation) {
+    if(_signalCount >= Telemetry::MAX_SIGNALS) {
+        ERROR_PRINTLN("[TelemetryPublisher] Maximum number of " + String(Telemetry::MAX_SIGNALS) + " signals reached.");
+        return false;
+    }
+    if(!source || name == nullptr || decimation == 0) {
+        ERROR_PRINTLN("[TelemetryPublisher] Signal needs a name, a source and a decimation of at least 1.");
+        return false;
+    }
+    Telemetry::Signal& signal = _signals[_signalCount];
+    signal.type = type;
+    signal.decimation = decimation;
+    strncpy(signal.name, name, Telemetry::MAX_NAME_LENGTH);
+    signal.name[Telemetry::MAX_NAME_LENGTH] = '\0';
+    _sources[_signalCount++] = source;
+    _schemaId++;
+    _schemaDue = true;
+    return true;
+}
+
+/**
+ * @brief Start publishing on a UART.
+ * @details The UART must be configured and started by its owner, e.g. with the baudrate DEFAULT_BAUDRATE. The schema is sent first.
+ * @param uart UART interface to write to.
+ * @param periodUs Sample period of signals with decimation 1.
+ * @return true if the publisher was started.
+ */
+bool TelemetryPublisher::begin(UARTInterface* uart, uint32_t periodUs) {
+    if(uart == nullptr || uart->getUartCore() == nullptr) {
+        ERROR_PRINTLN("[TelemetryPublisher] No UART core assigned.");
+        return false;
+    }
+    if(periodUs == 0) {
+        ERROR_PRINTLN("[TelemetryPublisher] Sample period must not be 0.");
+        return false;
+    }
+    _uart = uart;
+    _periodUs = periodUs;
+    _tx.clear();
+    _sampleCounter = 0;
+    _synchronized = false;
+    _schemaDue = true;
+    resetStatistics();
+    return true;
+}
+
+/**
+ * @brief Stop publishing. Records still in the ring are discarded.
+ */
+void TelemetryPublisher::end() {
+    _uart = nullptr;
+    _tx.clear();
+}
+
+/**
+ * @brief Queue the schema and due samples and write the ring to the UART as far as the UART accepts bytes.
+ * @details Call at least once per sample period. If a call is late by more than one period, the missed periods are skipped
+ *          and counted as overruns, the decimation counts sample periods actually published.
+ * @param nowUs Current time in microseconds.
+ */
+void TelemetryPublisher::cycle(uint32_t nowUs) {
+    if(_uart == nullptr) return;
+    if(!_synchronized) {
+        //The first sample period starts with the first cycle
+        _nextSampleUs = nowUs;
+        _synchronized = true;
+    }
+    drain();
+    if(_signalCount > 0 && (_schemaDue || nowUs - _lastSchemaUs >= _schemaIntervalUs) && queueSchema()) {
+        _schemaDue = false;
+        _lastSchemaUs = nowUs;
+    }
+    if(int32_t(nowUs - _nextSampleUs) >= 0) {
+        if(_signalCount > 0 && !_schemaDue) queueSample(nowUs);
+        _sampleCounter++;
+        _nextSampleUs += _periodUs;
+        if(int32_t(nowUs - _nextSampleUs) >= 0) {
+            _statistics.overruns += (nowUs - _nextSampleUs) / _periodUs + 1;
+            _nextSampleUs = nowUs + _periodUs;
+        }
+    }
+    drain();
+}
+
+/**
+ * @brief Queue all records of the schema, or none if the ring cannot take them all. The schema is retried in the next cycle().
+ */
+bool TelemetryPublisher::queueSchema() {
+    uint8_t records = (_signalCount + Telemetry::SCHEMA_SIGNALS_PER_RECORD - 1) / Telemetry::SCHEMA_SIGNALS_PER_RECORD;
+    if(_tx.free() < records * Telemetry::MAX_PACKET_SIZE) return false;
+    uint8_t record[Telemetry::MAX_RECORD_SIZE + Telemetry::CRC_SIZE];
+    for(uint8_t first=0; first<_signalCount; first+=Telemetry::SCHEMA_SIGNALS_PER_RECORD) {
+        uint8_t count = _signalCount - first < Telemetry::SCHEMA_SIGNALS_PER_RECORD ? _signalCount - first : Telemetry::SCHEMA_SIGNALS_PER_RECORD;
+        queue(record, Telemetry::encodeSchema(_signals, _signalCount, first, count, _sequence, _schemaId, record));
+        _statistics.schemas++;
+    }
+    return true;
+}
+
+/**
+ * @brief Sample the signals due in the current sample period and queue them as one record.
+ */
+bool TelemetryPublisher::queueSample(uint32_t nowUs) {
+    uint8_t record[Telemetry::MAX_RECORD_SIZE + Telemetry::CRC_SIZE];
+    size_t position = Telemetry::encodeHeader(Telemetry::RECORD_SAMPLE, _sequence, _schemaId, record);
+    Telemetry::put32(&record[position], nowUs);
+    position += 8;
+    uint32_t mask = 0;
+    for(uint8_t i=0; i<_signalCount; i++) {
+        if(_sampleCounter % _signals[i].decimation != 0) continue;
+        mask |= 1UL << i;
+        uint32_t value = _sources[i]();
+        if(_signals[i].type == Telemetry::U16) {
+            Telemetry::put16(&record[position], value);
+            position += 2;
+        } else {
+            Telemetry::put32(&record[position], value);
+            position += 4;
+        }
+    }
+    if(mask == 0) return true;
+    Telemetry::put32(&record[Telemetry::HEADER_SIZE + 4], mask);
+    if(!queue(record, position)) return false;
+    _statistics.samples++;
+    return true;
+}
+
+/**
+ * @brief Frame a record and append it to the ring. The sequence number also advances for a dropped record, so the receiver sees the gap.
+ * @return true if the record was queued, false if it was dropped.
+ */
+bool TelemetryPublisher::queue(uint8_t* record, size_t length) {
+    uint8_t packet[Telemetry::MAX_PACKET_SIZE];
+    size_t size = Telemetry::encodePacket(record, length, packet);
+    _sequence++;
+    if(_tx.free() < size) {
+        _statistics.dropped++;
+        return false;
+    }
+    _tx.write(packet, size);
+    if(_tx.size() > _statistics.maxRingFill) _statistics.maxRingFill = _tx.size();
+    return true;
+}
+
+/**
+ * @brief Write the ring to the UART until it is empty or the UART does not accept more bytes.
+ */
+void TelemetryPublisher::drain() {
+    const uint8_t* data;
+    size_t length;
+    while((length = _tx.peek(data)) > 0) {
+        size_t written = _uart->write(data, length);
+        _tx.consume(written);
+        _statistics.txBytes += written;
+        if(written < length) break;
+    }
+}
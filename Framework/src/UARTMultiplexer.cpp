@@ -0,0 +1,258 @@
+#include "UARTMultiplexer.h"
+#include "Debug.h"
+
+/**
+ * @brief Store the pins of the segment. The segment has no driver of its own, the port is installed by its provider.
+ * @return true
+ */
+bool UARTSegment::install(int uart_num, uint8_t tx_pin, uint8_t rx_pin, uint16_t bufferSize) {
+    return UARTCore::setPins(tx_pin, rx_pin);
+}
+
+/**
+ * @brief Buffer a complete buffer for transmission in the next slot of the segment.
+ * @return true if the whole buffer fit into the transmit buffer, nothing is buffered otherwise.
+ */
+bool UARTSegment::send(const char buffer[], size_t size) {
+    if(_tx.free() < size) return false;
+    _tx.write(reinterpret_cast<const uint8_t*>(buffer), size);
+    return true;
+}
+
+/**
+ * @brief Read all received bytes.
+ * @param buffer Destination with room for available() bytes.
+ * @return size_t Number of bytes read.
+ */
+size_t UARTSegment::read(char buffer[]) {
+    return _rx.read(reinterpret_cast<uint8_t*>(buffer), _rx.size());
+}
+
+/**
+ * @brief Buffer as many bytes as the transmit buffer has room for.
+ * @return size_t Number of bytes accepted.
+ */
+size_t UARTSegment::write(const uint8_t* data, size_t length) {
+    return _tx.write(data, length);
+}
+
+size_t UARTSegment::read(uint8_t* buffer, size_t capacity) {
+    return _rx.read(buffer, capacity);
+}
+
+/**
+ * @brief Store the RS-485 settings of the segment, applied to the port whenever the segment is granted.
+ * @return true if the settings are valid.
+ */
+bool UARTSegment::setRS485(bool enabled, const RS485Config& config) {
+    if(enabled && config.dePin == DEFAULT_REF) {
+        ERROR_PRINTLN("[UARTSegment] RS-485 mode needs a DE pin");
+        return false;
+    }
+    _rs485 = enabled;
+    if(enabled) _rs485Config = config;
+    return true;
+}
+
+/**
+ * @brief Set the number of segments sharing the port.
+ * @details Must be called before the segments are handed out and before begin().
+ * @param count Number of segments, at most MAX_SEGMENTS.
+ * @return true if the number was set.
+ */
+bool UARTMultiplexer::setSegmentCount(uint8_t count) {
+    if(count > MAX_SEGMENTS) {
+        ERROR_PRINTLN("[UARTMultiplexer] Maximum number of " + String(MAX_SEGMENTS) + " segments exceeded.");
+        return false;
+    }
+    if(isRunning()) {
+        ERROR_PRINTLN("[UARTMultiplexer] Number of segments cannot be changed while running.");
+        return false;
+    }
+    _segmentCount = count;
+    return true;
+}
+
+/**
+ * @brief Check if any segment is used as hardware resource.
+ */
+bool UARTMultiplexer::isUsed() {
+    for(uint8_t i=0; i<_segmentCount; i++) {
+        if(_segments[i].isUsed()) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Set the scheduling times.
+ * @param slotUs Time a segment may keep the port while other segments are waiting. Should hold the longest request and its response.
+ * @param holdUs Time a segment keeps the port after its last transmitted or received byte, e.g. the response time of its devices.
+ */
+void UARTMultiplexer::setTiming(uint32_t slotUs, uint32_t holdUs) {
+    _slotUs = slotUs;
+    _holdUs = holdUs;
+}
+
+/**
+ * @brief Get the longest time a segment with pending bytes waits for the port, without the cycle period of the multiplexer.
+ * @details Every other segment is granted at most once before, for at most one slot.
+ */
+uint32_t UARTMultiplexer::getLatencyBoundUs() const {
+    return _segmentCount > 1 ? uint32_t(_segmentCount - 1) * _slotUs : 0;
+}
+
+/**
+ * @brief Start sharing a port.
+ * @details The port must be started with the line settings shared by the segments. It is routed to a segment when the segment
+ *          is granted for the first time.
+ * @param port Started UART core.
+ * @return true if the multiplexer was started.
+ */
+bool UARTMultiplexer::begin(UARTCore* port) {
+    if(port == nullptr || port->getBaudrate() == 0) {
+        ERROR_PRINTLN("[UARTMultiplexer] No configured UART port assigned.");
+        return false;
+    }
+    if(_segmentCount == 0) {
+        ERROR_PRINTLN("[UARTMultiplexer] No segments defined.");
+        return false;
+    }
+    _charTimeNs = uint32_t(uint64_t(port->getBitsPerChar()) * 1000000000ULL / port->getBaudrate());
+    _active = -1;
+    _routed = -1;
+    _busyUntilUs = 0;
+    _lastActivityUs = 0;
+    for(uint8_t i=0; i<_segmentCount; i++) _segments[i]._waiting = false;
+    _port = port;
+    INFO_PRINTLN("[UARTMultiplexer] Sharing UART port among " + String(_segmentCount) + " segments, slot " + String(_slotUs)
+                 + " us, latency bound " + String(getLatencyBoundUs()) + " us.");
+    return true;
+}
+
+void UARTMultiplexer::end() {
+    _port = nullptr;
+    _active = -1;
+    _routed = -1;
+}
+
+/**
+ * @brief Move received bytes, forward pending bytes and switch the port between the segments.
+ * @param nowUs Current time in microseconds.
+ */
+void UARTMultiplexer::cycle(uint32_t nowUs) {
+    if(_port == nullptr) return;
+    receive(nowUs);
+    for(uint8_t i=0; i<_segmentCount; i++) {
+        UARTSegment& segment = _segments[i];
+        if(i != _active && !segment._waiting && segment.hasPendingData()) {
+            segment._waiting = true;
+            segment._waitingSinceUs = nowUs;
+        }
+    }
+
+    if(_active >= 0) {
+        UARTSegment& segment = _segments[_active];
+        if(nextWaiting() < 0) {
+            //Nobody is waiting, the segment keeps the port
+            if(nowUs - _grantUs >= _slotUs) _grantUs = nowUs;
+            transmit(segment, nowUs, false);
+            return;
+        }
+        bool expired = nowUs - _grantUs >= _slotUs;
+        if(!expired) transmit(segment, nowUs, true);
+        if(int32_t(_busyUntilUs - nowUs) > 0) return;
+        if(!expired && (segment.hasPendingData() || nowUs - _lastActivityUs < _holdUs)) return;
+        if(segment.hasPendingData()) {
+            segment._waiting = true;
+            segment._waitingSinceUs = nowUs;
+        }
+        _active = -1;
+    }
+
+    int8_t next = nextWaiting();
+    if(next < 0) return;
+    UARTSegment& segment = _segments[next];
+    segment._waiting = false;
+    if(!route(next)) {
+        //Discard the bytes of a segment which cannot be routed, so the others are not blocked
+        segment._tx.clear();
+        return;
+    }
+    uint32_t waitUs = nowUs - segment._waitingSinceUs;
+    if(waitUs > segment._statistics.maxWaitUs) segment._statistics.maxWaitUs = waitUs;
+    segment._statistics.grants++;
+    _active = next;
+    _grantUs = nowUs;
+    _lastActivityUs = nowUs;
+    transmit(segment, nowUs, false);
+}
+
+/**
+ * @brief Move the bytes received by the port to the segment it is routed to.
+ */
+void UARTMultiplexer::receive(uint32_t nowUs) {
+    uint8_t chunk[64];
+    size_t length;
+    while((length = _port->read(chunk, sizeof(chunk))) > 0) {
+        _lastActivityUs = nowUs;
+        if(_routed < 0) continue;
+        UARTSegment& segment = _segments[_routed];
+        size_t stored = segment._rx.write(chunk, length);
+        segment._statistics.rxBytes += stored;
+        segment._statistics.rxDropped += length - stored;
+    }
+}
+
+/**
+ * @brief Forward the pending bytes of the active segment to the port.
+ * @param limited Only forward if the transmission of all pending bytes ends within the slot, so a write is not split between slots.
+ */
+void UARTMultiplexer::transmit(UARTSegment& segment, uint32_t nowUs, bool limited) {
+    uint32_t startUs = int32_t(_busyUntilUs - nowUs) > 0 ? _busyUntilUs : nowUs;
+    if(limited) {
+        uint64_t durationNs = uint64_t(segment._tx.size()) * _charTimeNs;
+        if(int32_t(_grantUs + _slotUs - startUs) < 0 || durationNs > uint64_t(_grantUs + _slotUs - startUs) * 1000) return;
+    }
+    const uint8_t* data;
+    size_t length;
+    while((length = segment._tx.peek(data)) > 0) {
+        size_t written = _port->write(data, length);
+        if(written == 0) break;
+        segment._tx.consume(written);
+        segment._statistics.txBytes += written;
+        startUs += uint32_t((uint64_t(written) * _charTimeNs + 999) / 1000);
+        _busyUntilUs = startUs;
+        _lastActivityUs = startUs;
+        if(written < length) break;
+    }
+}
+
+/**
+ * @brief Find the next waiting segment after the one last routed, round robin.
+ * @return int8_t Index of the segment, -1 if none is waiting.
+ */
+int8_t UARTMultiplexer::nextWaiting() const {
+    for(uint8_t i=1; i<=_segmentCount; i++) {
+        uint8_t index = (_routed + i) % _segmentCount;
+        if(index != _active && _segments[index]._waiting) return index;
+    }
+    return -1;
+}
+
+/**
+ * @brief Route the port to the pins and RS-485 settings of a segment.
+ */
+bool UARTMultiplexer::route(uint8_t index) {
+    if(_routed == index) return true;
+    UARTSegment& segment = _segments[index];
+    if(!_port->setPins(segment.getTxPin(), segment.getRxPin())) {
+        ERROR_PRINTLN("[UARTMultiplexer] Failed to route the port to segment " + String(index) + ".");
+        return false;
+    }
+    if((segment.isRS485() || _port->isRS485()) && !_port->setRS485(segment.isRS485(), segment.getRS485Config())) {
+        ERROR_PRINTLN("[UARTMultiplexer] Failed to apply the RS-485 settings of segment " + String(index) + ".");
+        return false;
+    }
+    _routed = index;
+    return true;
+}
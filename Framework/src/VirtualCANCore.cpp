@@ -0,0 +1,246 @@
+#include "VirtualCANCore.h"
+#include "Debug.h"
+
+/**
+ * @brief Attach the node to the virtual bus.
+ * @details The baudrate must match the bitrate of the bus, except in listen-only mode. If no baudrate is set, the bitrate of the bus is taken.
+ *
+ * @return true if the node was attached.
+ */
+bool VirtualCANCore::begin() {
+    if(_isInitialized) {
+        WARNING_PRINTLN("[VirtualCANCore] Node already attached.");
+        return true;
+    }
+    _bitrateMismatch = false;
+    _mismatchErrors = 0;
+    if(_baudrate == BR_NOT_SET) {
+        _baudrate = Baudrate(_bus.getBitrate());
+    } else if(uint32_t(_baudrate) != _bus.getBitrate() && _listenOnly) {
+        _bitrateMismatch = true;
+    } else if(uint32_t(_baudrate) != _bus.getBitrate()) {
+        ERROR_PRINTLN("[VirtualCANCore] Baudrate " + String(uint32_t(_baudrate)) + " does not match the bus bitrate " + String(_bus.getBitrate()) + ".");
+        return false;
+    }
+    _node = _bus.attach();
+    if(_node < 0) {
+        ERROR_PRINTLN("[VirtualCANCore] Maximum number of " + String(VirtualCANBus::MAX_NODES) + " nodes reached.");
+        return false;
+    }
+    _bus.setFilter(_node, _filterId, _filterMask);
+    _status = STATUS_OK;
+    _statistics = {};
+    _isInitialized = true;
+    if(_responder) _responder->restart();
+    installResponder();
+    _txTimestampReady = false;
+    installTxTimestamp();
+    return true;
+}
+
+bool VirtualCANCore::setBaudrate(Baudrate baudrate) {
+    if(_isInitialized && uint32_t(baudrate) != _bus.getBitrate()) {
+        ERROR_PRINTLN("[VirtualCANCore] Baudrate " + String(uint32_t(baudrate)) + " does not match the bus bitrate " + String(_bus.getBitrate()) + ".");
+        return false;
+    }
+    _baudrate = baudrate;
+    return true;
+}
+
+bool VirtualCANCore::setPins(int8_t txPin, int8_t rxPin) {
+    _txPin = txPin;
+    _rxPin = rxPin;
+    return true;
+}
+
+/**
+ * @brief Detach the node from the virtual bus. Queued and received frames are discarded.
+ */
+bool VirtualCANCore::end() {
+    if(_isInitialized) _bus.detach(_node);
+    _node = -1;
+    _isInitialized = false;
+    return true;
+}
+
+bool VirtualCANCore::sendMessage(const CANMessage& message) {
+    if(!_isInitialized) {
+        ERROR_PRINTLN("[VirtualCANCore] Node not attached. Cannot send message.");
+        return false;
+    }
+    if(_listenOnly) {
+        ERROR_PRINTLN("[VirtualCANCore] Node is in listen-only mode. Cannot send message.");
+        return false;
+    }
+    if(!_bus.transmit(_node, toFrame(message, 0))) {
+        ERROR_PRINTLN("[VirtualCANCore] Transmit queue full or node bus-off. Message dropped.");
+        updateStatus();
+        return false;
+    }
+    _statistics.txFrames++;
+    return true;
+}
+
+bool VirtualCANCore::readMessage(CANMessage& message) {
+    CANFrame frame;
+    if(!readFrame(frame)) {
+        ERROR_PRINTLN("[VirtualCANCore] No CAN message available to read.");
+        message.error = true;
+        return false;
+    }
+    fromFrame(frame, message);
+    return true;
+}
+
+/**
+ * @brief Read a received frame.
+ * @details The timestamp is the simulated receive time mapped to micros(), i.e. micros() minus the simulated age of the frame.
+ */
+bool VirtualCANCore::readFrame(CANFrame& frame) {
+    if(!_isInitialized) return false;
+    if(_bitrateMismatch) {
+        updateStatus();
+        return false;
+    }
+    uint64_t receivedUs = 0;
+    if(!_bus.receive(_node, frame, &receivedUs)) return false;
+    frame.setTimestamp(micros() - uint32_t(_bus.now() - receivedUs));
+    return true;
+}
+
+uint8_t VirtualCANCore::available() {
+    if(!_isInitialized) {
+        ERROR_PRINTLN("[VirtualCANCore] Node not attached. Cannot check available messages.");
+        return 0;
+    }
+    updateStatus();
+    return _bitrateMismatch ? 0 : _bus.available(_node);
+}
+
+/**
+ * @brief Set the acceptance filter of the node. A frame passes if (frameId & mask) == (id & mask).
+ */
+bool VirtualCANCore::setupFilter(uint32_t id, uint32_t mask) {
+    _filterId = id;
+    _filterMask = mask;
+    _filterType = mask == 0 ? FILTER_ACCEPT_ALL : FILTER_MASKED;
+    if(_isInitialized) _bus.setFilter(_node, id, mask);
+    return true;
+}
+
+/**
+ * @brief Attach a responder, see CANResponder. Remote frames are answered when they are received from the bus.
+ *
+ * @param responder Responder, nullptr to detach it.
+ * @return true
+ */
+bool VirtualCANCore::setResponder(CANResponder* responder) {
+    if(responder) responder->restart();
+    _responder = responder;
+    installResponder();
+    return true;
+}
+
+/**
+ * @brief Queue the periodic frames of the responder which are due. Takes the place of the driver task of a hardware core.
+ */
+void VirtualCANCore::serviceResponder() {
+    if(!_isInitialized || _responder == nullptr || _listenOnly) return;
+    CANFrame frame;
+    while(_responder->nextPeriodic(millis(), frame)) {
+        if(_bus.transmit(_node, frame)) _statistics.txFrames++;
+    }
+}
+
+/**
+ * @brief Timestamp the end of the transmission of frames with the given identifier, see readTxTimestamp().
+ *
+ * @param id Standard identifier.
+ * @return true
+ */
+bool VirtualCANCore::enableTxTimestamp(uint32_t id) {
+    _txTimestampEnabled = true;
+    _txTimestampId = id;
+    _txTimestampReady = false;
+    installTxTimestamp();
+    return true;
+}
+
+void VirtualCANCore::disableTxTimestamp() {
+    _txTimestampEnabled = false;
+    _txTimestampReady = false;
+    installTxTimestamp();
+}
+
+/**
+ * @brief Read the last frame with the timestamped identifier which was transmitted successfully.
+ * @details Like for received frames, the simulated end of the frame is mapped to micros().
+ */
+bool VirtualCANCore::readTxTimestamp(CANFrame& frame) {
+    if(!_isInitialized || !_txTimestampReady) return false;
+    frame = _txTimestampFrame;
+    frame.setTimestamp(micros() - uint32_t(_bus.now() - _txTimestampUs));
+    _txTimestampReady = false;
+    return true;
+}
+
+/**
+ * @brief Install the transmit hook storing the frames with the timestamped identifier.
+ */
+void VirtualCANCore::installTxTimestamp() {
+    if(!_isInitialized) return;
+    if(!_txTimestampEnabled) {
+        _bus.setTransmitHook(_node, nullptr);
+        return;
+    }
+    _bus.setTransmitHook(_node, [this](const CANFrame& frame, uint64_t timeUs) {
+        if(frame.isExtended() || frame.getId() != _txTimestampId) return;
+        _txTimestampFrame = frame;
+        _txTimestampUs = timeUs;
+        _txTimestampReady = true;
+    });
+}
+
+/**
+ * @brief Install the receive hook answering remote frames on the bus.
+ */
+void VirtualCANCore::installResponder() {
+    if(!_isInitialized) return;
+    if(_responder == nullptr) {
+        _bus.setReceiveHook(_node, nullptr);
+        return;
+    }
+    _bus.setReceiveHook(_node, [this](const CANFrame& frame, uint64_t timeUs) {
+        CANFrame response;
+        if(_listenOnly || _bitrateMismatch || _responder == nullptr || !_responder->handleRemote(frame, response)) return false;
+        if(_bus.transmit(_node, response)) _statistics.txFrames++;
+        return true;
+    });
+}
+
+/**
+ * @brief Map the node state of the bus onto status and statistics.
+ * @details With a baudrate different from the bus bitrate, received frames are discarded and counted as bus errors.
+ */
+void VirtualCANCore::updateStatus() {
+    CANFrame frame;
+    while(_bitrateMismatch && _bus.receive(_node, frame)) _mismatchErrors++;
+
+    const VirtualCANBus::NodeStatistics& node = _bus.getStatistics(_node);
+    uint16_t tec = _bus.getTxErrorCounter(_node);
+    uint16_t rec = _bus.getRxErrorCounter(_node);
+    if(_bus.isBusOff(_node)) _status = STATUS_BUS_OFF;
+    else if(tec >= 128 || rec >= 128) _status = STATUS_ERROR_PASSIVE;
+    else if(tec >= 96 || rec >= 96) _status = STATUS_ERROR_ACTIVE;
+    else _status = STATUS_OK;
+
+    _statistics.rxFrames = node.rxFrames - _mismatchErrors;
+    _statistics.rxOverruns = node.rxOverruns + node.lostFrames;
+    _statistics.txFailed = node.txDiscarded;
+    _statistics.busErrors = node.txErrors + _mismatchErrors;
+    _statistics.arbitrationLost = node.arbitrationLost;
+    _statistics.busOffCount = node.busOffCount;
+    _statistics.txErrorCounter = tec > 255 ? 255 : tec;
+    _statistics.rxErrorCounter = rec;
+    _statistics.busLoad = _bus.getBusLoad();
+}
@@ -0,0 +1,143 @@
+#include "VirtualUARTCore.h"
+#include "Debug.h"
+
+/**
+ * @brief Connect the core to its endpoint of the line.
+ * @details The UART number and pins are stored only. The transmit and receive buffers of the endpoint are limited to bufferSize.
+ *
+ * @param bufferSize Size of the transmit and receive buffers, at most VirtualUARTLink::BUFFER_SIZE.
+ * @return true if the endpoint exists.
+ */
+bool VirtualUARTCore::install(int uart_num, uint8_t tx_pin, uint8_t rx_pin, uint16_t bufferSize) {
+    if(_endpoint >= VirtualUARTLink::ENDPOINTS) {
+        ERROR_PRINTLN("[VirtualUARTCore] Invalid endpoint " + String(_endpoint) + ".");
+        return false;
+    }
+    if(bufferSize > VirtualUARTLink::BUFFER_SIZE) {
+        WARNING_PRINTLN("[VirtualUARTCore] Buffer size limited to " + String(VirtualUARTLink::BUFFER_SIZE) + " bytes.");
+    }
+    _link.setBufferSizes(_endpoint, bufferSize, bufferSize);
+    _txPin = tx_pin;
+    _rxPin = rx_pin;
+    _installed = true;
+    applyConfig();
+    return true;
+}
+
+bool VirtualUARTCore::config(uint32_t baudrate, DataBits dataBits, Parity parity, StopBits stopBits) {
+    UARTCore::config(baudrate, dataBits, parity, stopBits);
+    applyConfig();
+    return true;
+}
+
+bool VirtualUARTCore::setBaudrate(uint32_t baudrate) {
+    _baudrate = baudrate;
+    applyConfig();
+    return true;
+}
+
+bool VirtualUARTCore::setDataBits(DataBits dataBits) {
+    _dataBits = dataBits;
+    applyConfig();
+    return true;
+}
+
+bool VirtualUARTCore::setParity(Parity parity) {
+    _parity = parity;
+    applyConfig();
+    return true;
+}
+
+bool VirtualUARTCore::setStopBits(StopBits stopBits) {
+    _stopBits = stopBits;
+    applyConfig();
+    return true;
+}
+
+/**
+ * @brief Queue a buffer for transmission.
+ * @return true if the whole buffer fit into the transmit buffer, nothing is queued otherwise.
+ */
+bool VirtualUARTCore::send(const char buffer[], size_t size) {
+    if(!_installed) {
+        ERROR_PRINTLN("[VirtualUARTCore] UART must be installed before sending data");
+        return false;
+    }
+    if(_link.txFree(_endpoint) < size) return false;
+    _link.write(_endpoint, reinterpret_cast<const uint8_t*>(buffer), size);
+    return true;
+}
+
+/**
+ * @brief Read all received bytes.
+ * @param buffer Destination, large enough for the receive buffer of the endpoint.
+ * @return size_t Number of bytes read.
+ */
+size_t VirtualUARTCore::read(char buffer[]) {
+    if(!_installed) return 0;
+    return _link.read(_endpoint, reinterpret_cast<uint8_t*>(buffer), _link.available(_endpoint));
+}
+
+/**
+ * @brief Queue as many bytes as the transmit buffer has room for.
+ * @return size_t Number of bytes accepted.
+ */
+size_t VirtualUARTCore::write(const uint8_t* data, size_t length) {
+    if(!_installed) {
+        ERROR_PRINTLN("[VirtualUARTCore] UART must be installed before sending data");
+        return 0;
+    }
+    return _link.write(_endpoint, data, length);
+}
+
+size_t VirtualUARTCore::read(uint8_t* buffer, size_t capacity) {
+    if(!_installed) return 0;
+    return _link.read(_endpoint, buffer, capacity);
+}
+
+size_t VirtualUARTCore::peek(const uint8_t*& data) {
+    if(!_installed) {
+        data = nullptr;
+        return 0;
+    }
+    return _link.peek(_endpoint, data);
+}
+
+void VirtualUARTCore::consume(size_t length) {
+    if(_installed) _link.consume(_endpoint, length);
+}
+
+size_t VirtualUARTCore::available() {
+    return _installed ? _link.available(_endpoint) : 0;
+}
+
+/**
+ * @brief Discard received bytes, like the ESP32 driver.
+ */
+void VirtualUARTCore::flush() {
+    _link.flushInput(_endpoint);
+}
+
+/**
+ * @brief Switch the software pattern detection of the endpoint on or off.
+ * @details Can be called at any time, bytes already received are checked as well.
+ * @return true if the detection was set.
+ */
+bool VirtualUARTCore::setPatternDetection(bool enabled, const PatternConfig& config) {
+    if(enabled && config.count == 0) {
+        ERROR_PRINTLN("[VirtualUARTCore] Pattern needs at least one character");
+        return false;
+    }
+    _patternDetection = enabled;
+    if(enabled) _patternConfig = config;
+    _link.setPatternDetection(_endpoint, enabled, config.character, config.count);
+    return true;
+}
+
+/**
+ * @brief Apply baudrate and character format to the line. Both endpoints share the line settings.
+ */
+void VirtualUARTCore::applyConfig() {
+    if(!_installed || _baudrate == 0) return;
+    _link.configure(_baudrate, getBitsPerChar());
+}
@@ -0,0 +1,352 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "Debug.h"
+#include "COBS.h"
+#include "CANSerial.h"
+#include "CANInterface.h"
+#include "CANUARTGateway.h"
+#include "UARTInterface.h"
+#include "VirtualCANBus.h"
+#include "VirtualCANCore.h"
+#include "VirtualUARTLink.h"
+#include "VirtualUARTCore.h"
+#include "../test/CANTramTestSetup.h"
+
+/*
+The gateway connects a simulated 500 kbit/s bus with one end of a simulated 921600 baud line, the test plays the PC at the other end.
+A generator node on the bus and the PC send numbered frames, the receivers check that every frame arrives in order.
+The simulated time of bus and line follows micros(), the CAN interfaces are processed every CYCLE_US like in a module cycle.
+*/
+
+static const uint8_t PC = 1;
+static const uint32_t CYCLE_US = 1000;
+
+/**
+ * @brief Listener checking the numbered frames received by a CAN node.
+ */
+class SequenceListener : public CANListener {
+public:
+    bool onMessage(const CANCore::CANMessage& message) override;
+    uint32_t next = 0;
+    uint32_t errors = 0;
+};
+
+VirtualCANBus bus(500000);
+VirtualCANCore gatewayCore(bus), nodeCore(bus);
+CANInterface gatewayCAN, nodeCAN;
+VirtualUARTLink line(CANUARTGateway::DEFAULT_BAUDRATE);
+VirtualUARTCore gatewayUART(line, 0);
+UARTInterface uartInterface;
+CANUARTGateway gateway;
+SequenceListener nodeListener;
+int8_t generator = -1;
+
+CANSerial::Decoder pcDecoder;
+uint32_t pcNext = 0;            // Next expected frame number on the PC
+uint32_t pcErrors = 0;
+uint32_t pcFrames = 0;
+uint32_t pcLastTimestamp = 0;
+bool pcTimestampsOrdered = true;
+
+uint32_t lastPump = 0;
+uint32_t lastCycle = 0;
+uint32_t maxProcessUs = 0;
+
+/**
+ * @brief Get the frame with the given number: mixed identifiers, lengths, extended and remote frames.
+ */
+CANFrame makeFrame(uint32_t n){
+    uint8_t data[8];
+    for(uint8_t i=0; i<8; i++) data[i] = (n >> (i % 4 * 8)) + i;
+    bool extended = n % 5 == 0;
+    uint32_t id = extended ? (0x1000000 | (n & 0xFFFFF)) : (n & 0x7FF);
+    CANFrame frame;
+    frame.set(id, extended, n % 23 == 0, data, n % 9, 0);
+    return frame;
+}
+
+bool sameFrame(const CANFrame& a, const CANFrame& b){
+    return a.idFlags == b.idFlags && a.getLength() == b.getLength() && memcmp(a.data, b.data, 8) == 0;
+}
+
+bool SequenceListener::onMessage(const CANCore::CANMessage& message){
+    CANFrame frame = CANCore::toFrame(message, 0);
+    if(!sameFrame(frame, makeFrame(next))) errors++;
+    next++;
+    return true;
+}
+
+/**
+ * @brief Read and check the records received by the PC.
+ */
+void pcReceive(){
+    uint8_t buffer[VirtualUARTLink::BUFFER_SIZE];
+    size_t length = line.read(PC, buffer, sizeof(buffer));
+    for(size_t i=0; i<length; i++){
+        CANSerial::Record record;
+        CANSerial::Decoder::Result result = pcDecoder.push(buffer[i], record);
+        if(result == CANSerial::Decoder::INVALID) pcErrors++;
+        if(result != CANSerial::Decoder::FRAME) continue;
+        if(!sameFrame(record.frame, makeFrame(pcNext))) pcErrors++;
+        if(record.hasTimestamp){
+            if(pcFrames > 0 && int32_t(record.timestamp - pcLastTimestamp) < 0) pcTimestampsOrdered = false;
+            pcLastTimestamp = record.timestamp;
+        }
+        pcNext++;
+        pcFrames++;
+    }
+}
+
+/**
+ * @brief Send a frame from the PC.
+ * @return false if the transmit buffer of the PC is full.
+ */
+bool pcSend(const CANFrame& frame){
+    uint8_t record[CANSerial::MAX_RECORD_SIZE];
+    uint8_t packet[CANSerial::MAX_PACKET_SIZE];
+    size_t size = CANSerial::encodePacket(record, CANSerial::encodeFrame(frame, 0, false, record), packet);
+    if(line.txFree(PC) < size) return false;
+    line.write(PC, packet, size);
+    return true;
+}
+
+void pump(){
+    uint32_t now = micros();
+    bus.run(now - lastPump);
+    line.run(now - lastPump);
+    lastPump = now;
+    pcReceive();
+    if(now - lastCycle < CYCLE_US) return;
+    lastCycle = now;
+    uint32_t start = micros();
+    gatewayCAN.process();
+    uint32_t duration = micros() - start;
+    if(duration > maxProcessUs) maxProcessUs = duration;
+    nodeCAN.process();
+}
+
+void pumpFor(uint32_t durationMs){
+    uint32_t start = millis();
+    while(millis() - start < durationMs) pump();
+}
+
+/**
+ * @brief Keep the transmit queue of the generator node full.
+ * @return uint32_t Number of the next frame.
+ */
+uint32_t generate(uint32_t n, uint32_t end = UINT32_MAX){
+    while(n < end && bus.transmit(generator, makeFrame(n))) n++;
+    return n;
+}
+
+//Runs before tests
+void setUp(){
+    gateway.end();
+    gatewayCAN.clearListeners();
+    nodeCAN.clearListeners();
+    gatewayCore.end();
+    nodeCore.end();
+    if(generator >= 0) bus.detach(generator);
+    gatewayCAN.setCANCore(&gatewayCore);
+    nodeCAN.setCANCore(&nodeCore);
+    gatewayCAN.begin();
+    nodeCAN.begin();
+    generator = bus.attach();
+    nodeListener = SequenceListener();
+    nodeCAN.addListener(&nodeListener);
+
+    gatewayUART.install(1, 23, 19, 1024);
+    gatewayUART.setBaudrate(CANUARTGateway::DEFAULT_BAUDRATE);
+    line.flushInput(0);
+    line.flushInput(PC);
+    uartInterface.setUartCore(&gatewayUART);
+    gateway.clearFilters(CANUARTGateway::CAN_TO_UART);
+    gateway.clearFilters(CANUARTGateway::UART_TO_CAN);
+    gateway.setRateLimit(CANUARTGateway::CAN_TO_UART, 0);
+    gateway.setRateLimit(CANUARTGateway::UART_TO_CAN, 0);
+    gateway.setTimestamps(true);
+    gateway.begin(&gatewayCAN, &uartInterface);
+
+    pcDecoder.reset();
+    pcNext = 0;
+    pcErrors = 0;
+    pcFrames = 0;
+    pcTimestampsOrdered = true;
+    maxProcessUs = 0;
+    lastPump = micros();
+    lastCycle = lastPump;
+    bus.resetStatistics();
+    line.resetStatistics();
+}
+
+//Runs after tests
+void tearDown(){
+}
+
+void test_gateway_framing(){
+    DEBUG_PRINTLN("TEST: test_gateway_framing");
+    //COBS with zero bytes and a run of more than 254 non-zero bytes
+    uint8_t data[300], encoded[COBS::maxEncodedSize(300)], decoded[300];
+    for(uint16_t i=0; i<300; i++) data[i] = i < 10 ? 0 : (i % 255) + 1;
+    size_t size = COBS::encode(data, 300, encoded);
+    TEST_ASSERT_LESS_OR_EQUAL(COBS::maxEncodedSize(300), size);
+    TEST_ASSERT_NULL(memchr(encoded, 0, size));
+    TEST_ASSERT_EQUAL(300, COBS::decode(encoded, size, decoded));
+    TEST_ASSERT_EQUAL_MEMORY(data, decoded, 300);
+
+    //Frame records with time records, the decoder combines both
+    CANSerial::Decoder decoder;
+    CANSerial::Record record;
+    uint8_t buffer[CANSerial::MAX_RECORD_SIZE], packet[CANSerial::MAX_PACKET_SIZE];
+    auto feed = [&](const uint8_t* bytes, size_t length){
+        CANSerial::Decoder::Result result = CANSerial::Decoder::NONE;
+        for(size_t i=0; i<length; i++){
+            CANSerial::Decoder::Result r = decoder.push(bytes[i], record);
+            if(r != CANSerial::Decoder::NONE) result = r;
+        }
+        return result;
+    };
+    size = CANSerial::encodePacket(buffer, CANSerial::encodeTime(0x12345678, buffer), packet);
+    TEST_ASSERT_EQUAL(CANSerial::Decoder::TIME, feed(packet, size));
+    for(uint32_t n : {0u, 1u, 8u, 23u, 25u}){
+        CANFrame frame = makeFrame(n);
+        size = CANSerial::encodePacket(buffer, CANSerial::encodeFrame(frame, 0x1234ABCD, true, buffer), packet);
+        TEST_ASSERT_LESS_OR_EQUAL(CANSerial::MAX_PACKET_SIZE, size);
+        TEST_ASSERT_EQUAL(CANSerial::Decoder::FRAME, feed(packet, size));
+        TEST_ASSERT_TRUE(sameFrame(frame, record.frame));
+        TEST_ASSERT_TRUE(record.hasTimestamp);
+        TEST_ASSERT_EQUAL_HEX32(0x1234ABCD, record.timestamp);
+    }
+    //Standard frame with 8 data bytes: 13 byte record, COBS overhead and delimiter
+    CANFrame frame = makeFrame(17);
+    TEST_ASSERT_EQUAL(15, CANSerial::encodePacket(buffer, CANSerial::encodeFrame(frame, 0, true, buffer), packet));
+
+    //Garbage and a truncated packet are rejected, the next packet is decoded again
+    const uint8_t garbage[] = {0x05, 0x11, 0x00, 0xFF, 0xFF, 0x00};
+    TEST_ASSERT_EQUAL(CANSerial::Decoder::INVALID, feed(garbage, sizeof(garbage)));
+    size = CANSerial::encodePacket(buffer, CANSerial::encodeFrame(frame, 0, false, buffer), packet);
+    TEST_ASSERT_EQUAL(CANSerial::Decoder::INVALID, feed(&packet[2], size - 2));
+    TEST_ASSERT_EQUAL(CANSerial::Decoder::FRAME, feed(packet, size));
+    TEST_ASSERT_TRUE(sameFrame(frame, record.frame));
+    TEST_ASSERT_FALSE(record.hasTimestamp);
+}
+
+void test_gateway_can_to_uart_full_load(){
+    DEBUG_PRINTLN("TEST: test_gateway_can_to_uart_full_load");
+    const uint32_t durationMs = 1000;
+    uint32_t n = 0;
+    uint32_t start = millis();
+    while(millis() - start < durationMs){
+        n = generate(n);
+        pump();
+    }
+    uint16_t busLoad = bus.getBusLoad();
+    pumpFor(20);        // Drain the queues
+
+    const VirtualCANBus::NodeStatistics& sent = bus.getStatistics(generator);
+    const VirtualCANBus::NodeStatistics& received = bus.getStatistics(gatewayCore.getNode());
+    const CANUARTGateway::Statistics& statistics = gateway.getStatistics(CANUARTGateway::CAN_TO_UART);
+    TEST_ASSERT_GREATER_THAN(950, busLoad);
+    TEST_ASSERT_EQUAL(0, received.rxOverruns);
+    TEST_ASSERT_EQUAL(0, statistics.dropped);
+    TEST_ASSERT_EQUAL(0, line.getStatistics(PC).rxOverruns);
+    TEST_ASSERT_EQUAL(0, pcErrors);
+    TEST_ASSERT_TRUE(pcTimestampsOrdered);
+    TEST_ASSERT_EQUAL(sent.txFrames, statistics.forwarded);
+    TEST_ASSERT_EQUAL(sent.txFrames, pcFrames);
+
+    uint32_t uartLoad = uint64_t(gateway.getUartBytes()) * line.getBitsPerChar() * 1000000 / line.getBaudrate() / (durationMs + 20);     // Permille
+    MEASUREMENT_PRINTLN("CAN to UART at 500 kbit/s and " + String(line.getBaudrate()) + " baud, " + String(durationMs) + " ms:");
+    MEASUREMENT_PRINTLN("  " + String(pcFrames) + " frames forwarded, bus load " + String(busLoad / 10) + " %, UART load " + String(uartLoad / 10) + " %");
+    MEASUREMENT_PRINTLN("  " + String(gateway.getUartWrites()) + " UART writes, " + String(pcFrames / gateway.getUartWrites()) + " frames and "
+                        + String(gateway.getUartBytes() / gateway.getUartWrites()) + " bytes per write, max. process() " + String(maxProcessUs) + " us");
+    TEST_ASSERT_GREATER_THAN(1, pcFrames / gateway.getUartWrites());
+}
+
+void test_gateway_uart_to_can(){
+    DEBUG_PRINTLN("TEST: test_gateway_uart_to_can");
+    //The PC sends at 95 % of the bus capacity for the longest frames, the CAN core limits the rate
+    const uint32_t frameCount = 2000;
+    const uint32_t periodNs = uint64_t(CANFrame::getBusBits(8, true)) * 1000000000ULL / bus.getBitrate() * 100 / 95;
+    uint64_t startUs = line.now();
+    uint32_t n = 0;
+    uint32_t start = millis();
+    while(nodeListener.next < frameCount && millis() - start < 2000){
+        while(n < frameCount && (line.now() - startUs) * 1000 >= uint64_t(n) * periodNs && pcSend(makeFrame(n))) n++;
+        pump();
+    }
+    const CANUARTGateway::Statistics& statistics = gateway.getStatistics(CANUARTGateway::UART_TO_CAN);
+    TEST_ASSERT_EQUAL(frameCount, nodeListener.next);
+    TEST_ASSERT_EQUAL(0, nodeListener.errors);
+    TEST_ASSERT_EQUAL(frameCount, statistics.forwarded);
+    TEST_ASSERT_EQUAL(0, gateway.getFramingErrors());
+    TEST_ASSERT_EQUAL(0, line.getStatistics(0).rxOverruns);
+    MEASUREMENT_PRINTLN("UART to CAN: " + String(frameCount) + " frames in " + String(millis() - start) + " ms, bus load " + String(bus.getBusLoad() / 10) + " %");
+}
+
+void test_gateway_filters(){
+    DEBUG_PRINTLN("TEST: test_gateway_filters");
+    //Standard identifiers 0x100-0x1FF to the PC, extended frames to the bus
+    TEST_ASSERT_TRUE(gateway.addFilter(CANUARTGateway::CAN_TO_UART, 0x100, 0x700));
+    TEST_ASSERT_TRUE(gateway.addFilter(CANUARTGateway::UART_TO_CAN, 0, 0, true));
+    uint32_t n = 0;
+    while(n < 0x800){
+        n = generate(n, 0x800);
+        pump();
+    }
+    pumpFor(20);
+    uint32_t expected = 0;
+    for(uint32_t i=0; i<0x800; i++){
+        CANFrame frame = makeFrame(i);
+        if(!frame.isExtended() && (frame.getId() & 0x700) == 0x100) expected++;
+    }
+    const CANUARTGateway::Statistics& toUART = gateway.getStatistics(CANUARTGateway::CAN_TO_UART);
+    TEST_ASSERT_EQUAL(expected, pcFrames);
+    TEST_ASSERT_EQUAL(expected, toUART.forwarded);
+    TEST_ASSERT_EQUAL(0x800 - expected, toUART.filtered);
+
+    //Frame 0 is extended, frame 1 standard
+    pcSend(makeFrame(0));
+    pcSend(makeFrame(1));
+    pcSend(makeFrame(5));
+    pumpFor(10);
+    const CANUARTGateway::Statistics& toCAN = gateway.getStatistics(CANUARTGateway::UART_TO_CAN);
+    TEST_ASSERT_EQUAL(2, toCAN.forwarded);
+    TEST_ASSERT_EQUAL(1, toCAN.filtered);
+    TEST_ASSERT_EQUAL(0, gateway.getFramingErrors());
+}
+
+void test_gateway_rate_limit(){
+    DEBUG_PRINTLN("TEST: test_gateway_rate_limit");
+    const uint32_t rate = 1000, burst = 10, durationMs = 300;
+    gateway.setRateLimit(CANUARTGateway::CAN_TO_UART, rate, burst);
+    uint32_t n = 0;
+    uint32_t start = millis();
+    while(millis() - start < durationMs){
+        n = generate(n);
+        pump();
+    }
+    pumpFor(20);
+    const CANUARTGateway::Statistics& statistics = gateway.getStatistics(CANUARTGateway::CAN_TO_UART);
+    uint32_t expected = burst + rate * (durationMs + 20) / 1000;
+    TEST_ASSERT_UINT32_WITHIN(expected / 10, expected, statistics.forwarded);
+    TEST_ASSERT_EQUAL(bus.getStatistics(generator).txFrames, statistics.forwarded + statistics.rateLimited);
+    TEST_ASSERT_EQUAL(statistics.forwarded, pcFrames);
+}
+
+//Run tests
+void setup(){
+    Serial.begin(115200);
+    delay(2000);
+    UNITY_BEGIN();
+    RUN_TEST(test_gateway_framing);
+    RUN_TEST(test_gateway_can_to_uart_full_load);
+    RUN_TEST(test_gateway_uart_to_can);
+    RUN_TEST(test_gateway_filters);
+    RUN_TEST(test_gateway_rate_limit);
+    UNITY_END();
+}
+
+void loop(){
+
+}
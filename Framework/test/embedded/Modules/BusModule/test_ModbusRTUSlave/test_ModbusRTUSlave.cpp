@@ -0,0 +1,375 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "Debug.h"
+#include "UARTInterface.h"
+#include "ESP32_UART.h"
+#include "driver/gpio.h"
+#include "VirtualUARTLink.h"
+#include "VirtualUARTCore.h"
+#include "ModbusRTUMaster.h"
+#include "ModbusRTUSlave.h"
+#include "DigitalInput.h"
+#include "DigitalOutput.h"
+#include "AnalogInput.h"
+#include "AnalogOutput.h"
+#include "RelaisInterface.h"
+#include "../test/CANTramTestSetup.h"
+
+/*
+A ModbusRTUMaster and the ModbusRTUSlave are connected by a simulated line with 8E1 characters.
+Every step() advances the line by STEP_US and processes the slave and the master once.
+measure_modbus_slave_response_time_esp32 connects UART1 and UART2 of the ESP32 through the GPIO matrix on LINK_PINS instead,
+no wiring is needed.
+*/
+
+static const uint8_t MASTER = 0;
+static const uint8_t SLAVE = 1;
+static const uint8_t SLAVE_ID = 17;
+static const uint32_t BAUDRATE = 115200;
+static const uint32_t STEP_US = 10;
+
+VirtualUARTLink line(BAUDRATE, 11);
+VirtualUARTCore masterCore(line, MASTER);
+VirtualUARTCore slaveCore(line, SLAVE);
+UARTInterface masterUART, slaveUART;
+ModbusRTUMaster<UARTInterface> master(masterUART);
+ModbusRTUSlave slave(SLAVE_ID);
+
+DigitalOutput dq[8];
+RelaisInterface relais[4];
+DigitalInput di[12];
+AnalogInput ai[4] = {AnalogInput(Interface::RES_16BIT), AnalogInput(Interface::RES_16BIT), AnalogInput(Interface::RES_16BIT), AnalogInput(Interface::RES_16BIT)};
+AnalogOutput aq[2];
+bool masterActive = true;          // Off for tests sending and receiving raw frames
+
+static const int LINK_PINS[2] = {32, 33};     // Master TX to slave RX, slave TX to master RX
+ESP32_UART masterESP, slaveESP;               // Global, the receive rings are too large for the stack
+
+void step(uint32_t count = 1){
+    for(uint32_t i=0; i<count; i++){
+        line.run(STEP_US);
+        slave.process(line.now());
+        if(masterActive) master.cycle(line.now());
+    }
+}
+
+void stepFor(uint32_t us){
+    step(us / STEP_US);
+}
+
+/**
+ * @brief Send a raw frame from the master endpoint, followed by more than T3.5 of silence.
+ */
+void sendRaw(uint8_t* frame, size_t length){
+    length = Modbus::appendCrc(frame, length);
+    masterUART.write(frame, length);
+    stepFor(length * Modbus::charTimeUs(BAUDRATE) + Modbus::t35Us(BAUDRATE) + 2 * STEP_US);
+}
+
+//Runs before tests
+void setUp(){
+    line = VirtualUARTLink(BAUDRATE, 11);
+    masterUART.setUartCore(&masterCore);
+    slaveUART.setUartCore(&slaveCore);
+    TEST_ASSERT_TRUE(masterCore.install(1, 0, 0, 1024));
+    TEST_ASSERT_TRUE(slaveCore.install(1, 0, 0, 1024));
+    TEST_ASSERT_TRUE(masterCore.config(BAUDRATE, UARTCore::UART_DATA_8_BITS, UARTCore::UART_PARITY_EVEN, UARTCore::UART_STOP_BITS_1));
+
+    slave.end();
+    slave.clear();
+    for(DigitalOutput& q : dq) { q.setQ(0); slave.addInterface(&q); }
+    for(RelaisInterface& q : relais) { q.setQ(0); slave.addInterface(&q); }
+    for(DigitalInput& i : di) { i.setQ(0); slave.addInterface(&i); }
+    for(AnalogInput& i : ai) { i.setQ(0); slave.addInterface(&i); }
+    for(AnalogOutput& q : aq) { q.setQ(0); slave.addInterface(&q); }
+    TEST_ASSERT_TRUE(slave.begin(&slaveUART, BAUDRATE));
+    TEST_ASSERT_FALSE(slave.isEventDriven());
+
+    master.clearPolls();
+    master.begin(BAUDRATE);
+    master.resetStatistics();
+    master.setWriteCallback(nullptr);
+    masterActive = true;
+}
+
+//Runs after tests
+void tearDown(){
+
+}
+
+void test_modbus_slave_address_table(){
+    TEST_ASSERT_EQUAL(12, slave.getPointCount(ModbusRTUSlave::COILS));
+    TEST_ASSERT_EQUAL(12, slave.getPointCount(ModbusRTUSlave::DISCRETE_INPUTS));
+    TEST_ASSERT_EQUAL(4, slave.getPointCount(ModbusRTUSlave::INPUT_REGISTERS));
+    TEST_ASSERT_EQUAL(2, slave.getPointCount(ModbusRTUSlave::HOLDING_REGISTERS));
+    TEST_ASSERT_EQUAL_PTR(&dq[0], slave.getPoint(ModbusRTUSlave::COILS, 0));
+    TEST_ASSERT_EQUAL_PTR(&relais[1], slave.getPoint(ModbusRTUSlave::COILS, 9));
+    TEST_ASSERT_EQUAL_PTR(&ai[3], slave.getPoint(ModbusRTUSlave::INPUT_REGISTERS, 3));
+    TEST_ASSERT_NULL(slave.getPoint(ModbusRTUSlave::HOLDING_REGISTERS, 2));
+    TEST_ASSERT_FALSE(slave.addInterface(&slaveUART));
+}
+
+void test_modbus_slave_read(){
+    int8_t coils = master.addPoll(SLAVE_ID, Modbus::READ_COILS, 0, 12, 5000);
+    int8_t inputs = master.addPoll(SLAVE_ID, Modbus::READ_DISCRETE_INPUTS, 2, 10, 5000);
+    int8_t inputRegisters = master.addPoll(SLAVE_ID, Modbus::READ_INPUT_REGISTERS, 0, 4, 5000);
+    int8_t holdingRegisters = master.addPoll(SLAVE_ID, Modbus::READ_HOLDING_REGISTERS, 0, 2, 5000);
+    int8_t outOfRange = master.addPoll(SLAVE_ID, Modbus::READ_INPUT_REGISTERS, 2, 3, 5000);
+    dq[1].setQ(1);
+    dq[7].setQ(1);
+    relais[3].setQ(1);
+    di[2].setQ(1);
+    di[11].setQ(1);
+    ai[0].setQ(12345);
+    ai[3].setQ(65535);
+    aq[1].setQ(4000);
+    stepFor(20000);
+
+    for(uint8_t i=0; i<12; i++) TEST_ASSERT_EQUAL(i == 1 || i == 7 || i == 11, master.getBit(coils, i));
+    for(uint8_t i=0; i<10; i++) TEST_ASSERT_EQUAL(i == 0 || i == 9, master.getBit(inputs, i));
+    TEST_ASSERT_EQUAL(12345, master.getRegisters(inputRegisters)[0]);
+    TEST_ASSERT_EQUAL(65535, master.getRegisters(inputRegisters)[3]);
+    TEST_ASSERT_EQUAL(4000, master.getRegisters(holdingRegisters)[1]);
+    TEST_ASSERT_EQUAL(Modbus::ILLEGAL_DATA_ADDRESS, master.getStatus(outOfRange).lastException);
+    TEST_ASSERT_EQUAL(0, master.getStatistics().timeouts + master.getStatistics().crcErrors + master.getStatistics().frameErrors);
+
+    //Changed inputs are served from the interfaces with the next request
+    ai[0].setQ(777);
+    stepFor(40000);
+    TEST_ASSERT_EQUAL(777, master.getRegisters(inputRegisters)[0]);
+    const ModbusRTUSlave::Statistics& statistics = slave.getStatistics();
+    TEST_ASSERT_EQUAL(statistics.requests, statistics.responses);
+    TEST_ASSERT_EQUAL(master.getStatistics().requests, statistics.requests);
+    TEST_ASSERT_EQUAL(master.getStatus(outOfRange).exceptions, statistics.exceptions);
+}
+
+void test_modbus_slave_write(){
+    uint8_t results[4] = {};
+    uint8_t count = 0;
+    master.setWriteCallback([&](uint8_t, uint16_t, ModbusRTUMaster<UARTInterface>::Result result, Modbus::Exception exception){
+        if(count < 4) results[count++] = result == ModbusRTUMaster<UARTInterface>::EXCEPTION ? 0x80 | exception : result;
+    });
+    master.setTurnaround(2000);
+    uint16_t values[2] = {100, 4095};
+    TEST_ASSERT_TRUE(master.writeCoil(SLAVE_ID, 9, true));
+    TEST_ASSERT_TRUE(master.writeRegisters(SLAVE_ID, 0, values, 2));
+    TEST_ASSERT_TRUE(master.writeRegister(SLAVE_ID, 5, 1));
+    TEST_ASSERT_TRUE(master.writeCoil(Modbus::BROADCAST, 0, true));
+    stepFor(20000);
+
+    TEST_ASSERT_EQUAL(4, count);
+    TEST_ASSERT_EQUAL(ModbusRTUMaster<UARTInterface>::OK, results[0]);
+    TEST_ASSERT_EQUAL(ModbusRTUMaster<UARTInterface>::OK, results[1]);
+    TEST_ASSERT_EQUAL(0x80 | Modbus::ILLEGAL_DATA_ADDRESS, results[2]);
+    TEST_ASSERT_EQUAL(ModbusRTUMaster<UARTInterface>::OK, results[3]);
+    TEST_ASSERT_EQUAL(1, relais[1].getQ());
+    TEST_ASSERT_EQUAL(100, aq[0].getQ());
+    TEST_ASSERT_EQUAL(4095, aq[1].getQ());
+    TEST_ASSERT_EQUAL(1, dq[0].getQ());
+    TEST_ASSERT_EQUAL(1, slave.getStatistics().broadcasts);
+    TEST_ASSERT_EQUAL(3, slave.getStatistics().responses);
+
+    //Write multiple coils
+    uint8_t frame[Modbus::MAX_ADU_SIZE] = {SLAVE_ID, Modbus::WRITE_MULTIPLE_COILS, 0x00, 0x02, 0x00, 0x09, 0x02, 0x55, 0x01};
+    sendRaw(frame, 9);
+    for(uint8_t i=0; i<9; i++) TEST_ASSERT_EQUAL(i % 2 == 0, slave.getPoint(ModbusRTUSlave::COILS, 2 + i)->getQ());
+    TEST_ASSERT_EQUAL(4, slave.getStatistics().responses);
+
+    //Values above the 12 bit resolution of the analog outputs are rejected and change no output
+    masterActive = false;
+    masterCore.flush();
+    uint8_t single[Modbus::MAX_ADU_SIZE] = {SLAVE_ID, Modbus::WRITE_SINGLE_REGISTER, 0x00, 0x01, 0x13, 0x88};
+    sendRaw(single, 6);
+    uint8_t multiple[Modbus::MAX_ADU_SIZE] = {SLAVE_ID, Modbus::WRITE_MULTIPLE_REGISTERS, 0x00, 0x00, 0x00, 0x02, 0x04, 0x00, 0x07, 0x10, 0x00};
+    sendRaw(multiple, 11);
+    TEST_ASSERT_EQUAL(100, aq[0].getQ());
+    TEST_ASSERT_EQUAL(4095, aq[1].getQ());
+    uint8_t received[16];
+    TEST_ASSERT_EQUAL(10, masterUART.read(received, sizeof(received)));
+    TEST_ASSERT_EQUAL_HEX8(0x80 | Modbus::WRITE_SINGLE_REGISTER, received[1]);
+    TEST_ASSERT_EQUAL_HEX8(Modbus::ILLEGAL_DATA_VALUE, received[2]);
+    TEST_ASSERT_EQUAL_HEX8(0x80 | Modbus::WRITE_MULTIPLE_REGISTERS, received[6]);
+    TEST_ASSERT_EQUAL_HEX8(Modbus::ILLEGAL_DATA_VALUE, received[7]);
+    TEST_ASSERT_EQUAL(3, slave.getStatistics().exceptions);
+}
+
+void test_modbus_slave_bus_traffic(){
+    masterActive = false;
+    //Request to another slave and its response are skipped
+    uint8_t frame[Modbus::MAX_ADU_SIZE] = {9, Modbus::READ_HOLDING_REGISTERS, 0x00, 0x00, 0x00, 0x03};
+    sendRaw(frame, 6);
+    uint8_t response[Modbus::MAX_ADU_SIZE] = {9, Modbus::READ_HOLDING_REGISTERS, 6, 1, 2, 3, 4, 5, 6};
+    sendRaw(response, 9);
+    TEST_ASSERT_EQUAL(1, slave.getStatistics().otherSlaves);
+    TEST_ASSERT_EQUAL(0, slave.getStatistics().crcErrors);
+    TEST_ASSERT_EQUAL(0, slave.getStatistics().requests);
+
+    //An incomplete frame is discarded at the next silence
+    uint8_t noise[3] = {SLAVE_ID, Modbus::READ_COILS, 0};
+    masterUART.write(noise, sizeof(noise));
+    stepFor(5000);
+    TEST_ASSERT_EQUAL(0, slave.getStatistics().responses);
+
+    //Unknown function codes end with the first valid CRC and are answered with an exception before the silence
+    uint8_t unknown[Modbus::MAX_ADU_SIZE] = {SLAVE_ID, 0x41, 0x12};
+    size_t unknownLength = Modbus::appendCrc(unknown, 3);
+    masterUART.write(unknown, unknownLength);
+    stepFor((unknownLength + 2) * Modbus::charTimeUs(BAUDRATE));
+    TEST_ASSERT_LESS_THAN(Modbus::t35Us(BAUDRATE), 2 * Modbus::charTimeUs(BAUDRATE));
+    TEST_ASSERT_EQUAL(1, slave.getStatistics().exceptions);
+    stepFor(5000);
+    TEST_ASSERT_EQUAL(1, slave.getStatistics().crcErrors);      // The noise
+
+    //CRC error
+    uint8_t request[Modbus::MAX_ADU_SIZE] = {SLAVE_ID, Modbus::READ_COILS, 0x00, 0x00, 0x00, 0x04};
+    Modbus::appendCrc(request, 6);
+    request[7] ^= 1;
+    masterUART.write(request, 8);
+    stepFor(5000);
+    TEST_ASSERT_EQUAL(2, slave.getStatistics().crcErrors);
+    TEST_ASSERT_EQUAL(1, slave.getStatistics().responses);
+    uint8_t received[16];
+    size_t length = masterUART.read(received, sizeof(received));
+    TEST_ASSERT_EQUAL(5, length);
+    TEST_ASSERT_EQUAL_HEX8(0x80 | 0x41, received[1]);
+    TEST_ASSERT_EQUAL_HEX8(Modbus::ILLEGAL_FUNCTION, received[2]);
+}
+
+/**
+ * @brief Send a request and measure the time from its last byte on the line to the first byte of the response.
+ * @param processIntervalUs Interval of the slave's process() calls.
+ */
+uint32_t measureTurnaround(uint32_t processIntervalUs){
+    uint8_t request[8] = {SLAVE_ID, Modbus::READ_INPUT_REGISTERS, 0x00, 0x00, 0x00, 0x04};
+    Modbus::appendCrc(request, 6);
+    uint32_t txBytes = line.getStatistics(MASTER).txBytes;
+    uint32_t responseBytes = line.getStatistics(SLAVE).txBytes;
+    masterUART.write(request, sizeof(request));
+    uint64_t requestEnd = 0;
+    for(uint32_t i=1; i<100000; i++){
+        line.run(1);
+        if(line.now() % processIntervalUs == 0) slave.process(line.now());
+        if(requestEnd == 0 && line.getStatistics(MASTER).txBytes == txBytes + sizeof(request)) requestEnd = line.now();
+        if(line.txPending(SLAVE) > 0 || line.getStatistics(SLAVE).txBytes > responseBytes) break;
+    }
+    uint32_t turnaround = line.now() - requestEnd;
+    line.run(20000);
+    masterCore.flush();
+    return turnaround;
+}
+
+void measure_modbus_slave_response_time(){
+    masterActive = false;
+    const uint32_t baudrates[] = {9600, 19200, 115200};
+    MEASUREMENT_PRINTLN("Time from the last request byte to the response, read of 4 input registers, worst of 10:");
+    for(uint32_t baudrate : baudrates){
+        masterCore.setBaudrate(baudrate);
+        TEST_ASSERT_TRUE(slave.begin(&slaveUART, baudrate));
+        line.run(10000);
+        slave.process(line.now());
+        uint32_t worst[2] = {};
+        const uint32_t intervals[2] = {1, 1000};
+        for(uint8_t mode=0; mode<2; mode++){
+            for(uint8_t i=0; i<10; i++){
+                //Shift the request against the process() calls
+                line.run(i * 97);
+                uint32_t turnaround = measureTurnaround(intervals[mode]);
+                if(turnaround > worst[mode]) worst[mode] = turnaround;
+            }
+        }
+        TEST_ASSERT_LESS_OR_EQUAL(Modbus::charTimeUs(baudrate), worst[0]);
+        MEASUREMENT_PRINTLN("  " + String(baudrate) + " baud (one character " + String(Modbus::charTimeUs(baudrate)) + " us): on receive " + String(worst[0])
+                            + " us, in a 1 ms cycle " + String(worst[1]) + " us, processing " + String(slave.getStatistics().maxResponseUs) + " us");
+    }
+}
+
+/**
+ * @brief Start an ESP32 UART with 8E1 characters at BAUDRATE.
+ */
+void startESP(ESP32_UART& uart, uart_port_t port, int txPin, int rxPin){
+    TEST_ASSERT_TRUE(uart.install(port, txPin, rxPin, 1024));
+    TEST_ASSERT_TRUE(uart.config(BAUDRATE, UARTCore::UART_DATA_8_BITS, UARTCore::UART_PARITY_EVEN, UARTCore::UART_STOP_BITS_1));
+    TEST_ASSERT_TRUE(uart.applyConfig());
+    TEST_ASSERT_TRUE(uart.applyPins());
+}
+
+/**
+ * @brief Send requests from the master UART and measure the time from the end of each request to the first response byte.
+ * @details The master reads with RX full threshold 1, so the latency is the turnaround of the slave plus one character.
+ */
+UARTCore::LatencyStatistics measureHardwareLatency(){
+    const uint32_t REQUESTS = 200;
+    uint8_t request[8] = {SLAVE_ID, Modbus::READ_INPUT_REGISTERS, 0x00, 0x00, 0x00, 0x04};
+    Modbus::appendCrc(request, 6);
+    masterESP.resetLatencyStatistics();
+    for(uint32_t n=0; n<REQUESTS; n++){
+        TEST_ASSERT_EQUAL(sizeof(request), masterESP.write(request, sizeof(request)));
+        uint32_t start = millis();
+        while(masterESP.available() < 13 && millis() - start < 20) delayMicroseconds(50);
+        uint8_t response[16];
+        TEST_ASSERT_EQUAL(13, masterESP.read(response, sizeof(response)));
+        delay(2);
+    }
+    UARTCore::LatencyStatistics statistics = masterESP.getLatencyStatistics();
+    TEST_ASSERT_EQUAL(REQUESTS, statistics.responses);
+    return statistics;
+}
+
+void measure_modbus_slave_response_time_esp32(){
+    UARTInterface masterHW, slaveHW;
+    masterHW.setUartCore(&masterESP);
+    slaveHW.setUartCore(&slaveESP);
+    UARTCore::FifoConfig masterFifo;
+    masterFifo.rxFullThreshold = 1;
+    masterFifo.rxTimeoutSymbols = 1;
+    TEST_ASSERT_TRUE(masterESP.setFifoConfig(masterFifo));
+    TEST_ASSERT_TRUE(masterESP.setLatencyMeasurement(true));
+    TEST_ASSERT_TRUE(slave.begin(&slaveHW, BAUDRATE));
+    TEST_ASSERT_TRUE(slave.isEventDriven());
+    startESP(masterESP, UART_NUM_1, LINK_PINS[0], LINK_PINS[1]);
+    startESP(slaveESP, UART_NUM_2, LINK_PINS[1], LINK_PINS[0]);
+    //Each pin is driven by one UART and read by the other
+    for(int pin : LINK_PINS) TEST_ASSERT_EQUAL(ESP_OK, gpio_set_direction(static_cast<gpio_num_t>(pin), GPIO_MODE_INPUT_OUTPUT));
+    delay(10);
+
+    //Slave with the default FIFO thresholds, then with those set by BusModuleV1_0::enableModbusSlave()
+    UARTCore::LatencyStatistics defaults = measureHardwareLatency();
+    UARTCore::FifoConfig modbusFifo;
+    modbusFifo.rxFullThreshold = 8;
+    modbusFifo.rxTimeoutSymbols = 1;
+    TEST_ASSERT_TRUE(slaveESP.setFifoConfig(modbusFifo));
+    UARTCore::LatencyStatistics tuned = measureHardwareLatency();
+    TEST_ASSERT_EQUAL(0, slave.getStatistics().crcErrors);
+    slave.end();
+    masterESP.reset();
+    slaveESP.reset();
+
+    uint32_t charUs = Modbus::charTimeUs(BAUDRATE);
+    MEASUREMENT_PRINTLN("Time from the last request byte to the first response byte on the ESP32 at " + String(BAUDRATE) + " baud (one character "
+                        + String(charUs) + " us), read of 4 input registers, 200 requests:");
+    MEASUREMENT_PRINTLN("  RX timeout 10 symbols, full threshold 120: min " + String(defaults.minUs) + " us, avg " + String(defaults.averageUs())
+                        + " us, max " + String(defaults.maxUs) + " us");
+    MEASUREMENT_PRINTLN("  RX timeout 1 symbol, full threshold 8:     min " + String(tuned.minUs) + " us, avg " + String(tuned.averageUs())
+                        + " us, max " + String(tuned.maxUs) + " us");
+    //The 8 byte request triggers the full threshold with its last byte, the response needs one character to arrive
+    TEST_ASSERT_LESS_THAN(defaults.averageUs(), tuned.averageUs());
+    TEST_ASSERT_LESS_THAN(Modbus::t35Us(BAUDRATE), tuned.averageUs());
+}
+
+//Run tests
+void setup(){
+    Serial.begin(115200);
+    delay(2000);
+    UNITY_BEGIN();
+    RUN_TEST(test_modbus_slave_address_table);
+    RUN_TEST(test_modbus_slave_read);
+    RUN_TEST(test_modbus_slave_write);
+    RUN_TEST(test_modbus_slave_bus_traffic);
+    RUN_TEST(measure_modbus_slave_response_time);
+    RUN_TEST(measure_modbus_slave_response_time_esp32);
+    UNITY_END();
+}
+
+void loop(){
+
+}
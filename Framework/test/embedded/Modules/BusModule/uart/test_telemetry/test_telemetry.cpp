@@ -0,0 +1,277 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "Debug.h"
+#include "Telemetry.h"
+#include "TelemetryPublisher.h"
+#include "UARTInterface.h"
+#include "VirtualUARTLink.h"
+#include "VirtualUARTCore.h"
+#include "AnalogInput.h"
+#include "../test/CANTramTestSetup.h"
+
+/*
+The publisher streams telemetry on one end of a simulated serial line, the receiver decodes the stream on the other end with
+Telemetry::Decoder like tools/telemetry_decode.cpp. Every step() advances the line by CYCLE_US and runs the publisher and the
+receiver once, like a module cycle.
+*/
+
+static const uint8_t PUBLISHER = 0;
+static const uint8_t RECEIVER = 1;
+static const uint32_t CYCLE_US = 1000;
+
+VirtualUARTLink line(TelemetryPublisher::DEFAULT_BAUDRATE);
+VirtualUARTCore publisherCore(line, PUBLISHER);
+VirtualUARTCore receiverCore(line, RECEIVER);
+UARTInterface publisherUART, receiverUART;
+TelemetryPublisher publisher;
+AnalogInput inputs[10] = {
+    AnalogInput(Interface::RES_16BIT), AnalogInput(Interface::RES_16BIT), AnalogInput(Interface::RES_16BIT), AnalogInput(Interface::RES_16BIT),
+    AnalogInput(Interface::RES_16BIT), AnalogInput(Interface::RES_16BIT), AnalogInput(Interface::RES_16BIT), AnalogInput(Interface::RES_16BIT),
+    AnalogInput(Interface::RES_16BIT), AnalogInput(Interface::RES_16BIT)
+};
+
+/**
+ * @brief Receiver counting the decoded records and checking the samples against the signal sources.
+ */
+struct TelemetryReceiver {
+    Telemetry::Decoder decoder;
+    Telemetry::Sample last = {};
+    uint32_t samples = 0;
+    uint32_t schemas = 0;
+    uint32_t errors = 0;
+    uint32_t perSignal[Telemetry::MAX_SIGNALS] = {};
+
+    void receive(){
+        const uint8_t* data;
+        size_t length;
+        while((length = receiverUART.peek(data)) > 0){
+            for(size_t i=0; i<length; i++){
+                Telemetry::Sample sample;
+                switch(decoder.push(data[i], sample)){
+                    case Telemetry::Decoder::SCHEMA: schemas++; break;
+                    case Telemetry::Decoder::SAMPLE:
+                        samples++;
+                        last = sample;
+                        for(uint8_t s=0; s<Telemetry::MAX_SIGNALS; s++) if(sample.mask & (1UL << s)) perSignal[s]++;
+                        break;
+                    case Telemetry::Decoder::CRC_ERROR:
+                    case Telemetry::Decoder::INVALID: errors++; break;
+                    default: break;
+                }
+            }
+            receiverUART.consume(length);
+        }
+    }
+};
+
+TelemetryReceiver receiver;
+
+void step(uint32_t count = 1){
+    for(uint32_t i=0; i<count; i++){
+        line.run(CYCLE_US);
+        publisher.cycle(line.now());
+        receiver.receive();
+    }
+}
+
+void start(uint32_t baudrate, uint32_t periodUs){
+    line = VirtualUARTLink(baudrate);
+    TEST_ASSERT_TRUE(publisherCore.install(1, 0, 0, 1024));
+    TEST_ASSERT_TRUE(receiverCore.install(1, 0, 0, 1024));
+    TEST_ASSERT_TRUE(publisherCore.config(baudrate, UARTCore::UART_DATA_8_BITS, UARTCore::UART_PARITY_NONE, UARTCore::UART_STOP_BITS_1));
+    publisherUART.setUartCore(&publisherCore);
+    receiverUART.setUartCore(&receiverCore);
+    receiver = TelemetryReceiver();
+    TEST_ASSERT_TRUE(publisher.begin(&publisherUART, periodUs));
+}
+
+//Runs before tests
+void setUp(){
+    publisher.end();
+    publisher.clear();
+    publisher.setSchemaInterval(TelemetryPublisher::DEFAULT_SCHEMA_INTERVAL_US);
+}
+
+//Runs after tests
+void tearDown(){
+    publisher.end();
+}
+
+void test_telemetry_roundtrip(){
+    static uint32_t counter = 0;
+    static int32_t offset = -12345;
+    static float temperature = 21.5f;
+    inputs[0].rename("AI0");
+    inputs[0].setQ(0x1234);
+    TEST_ASSERT_TRUE(publisher.addInterface(&inputs[0]));
+    TEST_ASSERT_TRUE(publisher.addInterface(&inputs[1], 1, "a_very_long_signal_name"));
+    TEST_ASSERT_TRUE(publisher.addMetric("counter", [](){ return counter; }));
+    TEST_ASSERT_TRUE(publisher.addSignedMetric("offset", [](){ return offset; }));
+    TEST_ASSERT_TRUE(publisher.addFloatMetric("temperature", [](){ return temperature; }));
+    TEST_ASSERT_FALSE(publisher.addMetric("invalid", [](){ return counter; }, 0));
+    TEST_ASSERT_EQUAL(5, publisher.getSignalCount());
+
+    start(TelemetryPublisher::DEFAULT_BAUDRATE, CYCLE_US);
+    counter = 0xDEADBEEF;
+    step(5);
+    TEST_ASSERT_TRUE(receiver.decoder.isSchemaComplete());
+    TEST_ASSERT_EQUAL(publisher.getSchemaId(), receiver.decoder.getSchemaId());
+    TEST_ASSERT_EQUAL(5, receiver.decoder.getSignalCount());
+    TEST_ASSERT_EQUAL_STRING("AI0", receiver.decoder.getSignal(0).name);
+    TEST_ASSERT_EQUAL_STRING("a_very_long_sig", receiver.decoder.getSignal(1).name);
+    TEST_ASSERT_EQUAL(Telemetry::F32, receiver.decoder.getSignal(4).type);
+    TEST_ASSERT_GREATER_OR_EQUAL(3, receiver.samples);
+    TEST_ASSERT_EQUAL(0, receiver.errors);
+    TEST_ASSERT_EQUAL_HEX32(0x1F, receiver.last.mask);
+    TEST_ASSERT_EQUAL_HEX32(0x1234, receiver.last.raw[0]);
+    TEST_ASSERT_EQUAL_HEX32(0xDEADBEEF, receiver.last.raw[2]);
+    TEST_ASSERT_EQUAL(-12345, int32_t(receiver.last.raw[3]));
+    TEST_ASSERT_FLOAT_WITHIN(0.0001f, 21.5f, receiver.decoder.value(receiver.last, 4));
+
+    //A changed schema is sent before the next sample
+    TEST_ASSERT_TRUE(publisher.addMetric("late", [](){ return uint32_t(7); }));
+    step(5);
+    TEST_ASSERT_EQUAL(publisher.getSchemaId(), receiver.decoder.getSchemaId());
+    TEST_ASSERT_EQUAL(6, receiver.decoder.getSignalCount());
+    TEST_ASSERT_EQUAL(7, receiver.last.raw[5]);
+    TEST_ASSERT_EQUAL(0, receiver.errors);
+    TEST_ASSERT_EQUAL(0, receiver.decoder.getLostRecords());
+}
+
+void test_telemetry_decimation(){
+    for(uint8_t i=0; i<8; i++) TEST_ASSERT_TRUE(publisher.addInterface(&inputs[i], 1, "x"));
+    TEST_ASSERT_TRUE(publisher.addInterface(&inputs[8], 2, "half"));
+    TEST_ASSERT_TRUE(publisher.addInterface(&inputs[9], 10, "tenth"));
+    publisher.setSchemaInterval(250000);
+    start(TelemetryPublisher::DEFAULT_BAUDRATE, CYCLE_US);
+    step(1000);
+    TEST_ASSERT_EQUAL(0, receiver.errors);
+    TEST_ASSERT_EQUAL(0, publisher.getStatistics().dropped);
+    TEST_ASSERT_EQUAL(0, publisher.getStatistics().overruns);
+    uint32_t full = receiver.perSignal[0];
+    TEST_ASSERT_UINT32_WITHIN(2, 1000, full);
+    TEST_ASSERT_UINT32_WITHIN(1, full / 2, receiver.perSignal[8]);
+    TEST_ASSERT_UINT32_WITHIN(1, full / 10, receiver.perSignal[9]);
+    TEST_ASSERT_EQUAL(2, receiver.decoder.getSignal(8).decimation);
+    //The schema is repeated for receivers started later
+    TEST_ASSERT_GREATER_OR_EQUAL(4 * 2, receiver.schemas);
+}
+
+void test_telemetry_crc_and_resync(){
+    Telemetry::Signal signals[1] = {{Telemetry::U32, 1, "value"}};
+    uint8_t record[Telemetry::MAX_RECORD_SIZE + Telemetry::CRC_SIZE];
+    uint8_t stream[4 * Telemetry::MAX_PACKET_SIZE];
+    size_t size = 0;
+    size += Telemetry::encodePacket(record, Telemetry::encodeSchema(signals, 1, 0, 1, 0, 9, record), &stream[size]);
+    for(uint16_t n=1; n<=3; n++){
+        size_t length = Telemetry::encodeHeader(Telemetry::RECORD_SAMPLE, n, 9, record);
+        Telemetry::put32(&record[length], 1000 * n);
+        Telemetry::put32(&record[length + 4], 1);
+        Telemetry::put32(&record[length + 8], 0x01000000UL * n);
+        size_t start = size;
+        size += Telemetry::encodePacket(record, length + 12, &stream[size]);
+        if(n == 2) stream[start + 5] ^= 0x40;     // Bit error in the second sample
+    }
+
+    Telemetry::Decoder decoder;
+    Telemetry::Sample sample;
+    uint32_t results[Telemetry::Decoder::INVALID + 1] = {};
+    uint32_t value = 0;
+    for(size_t i=0; i<size; i++){
+        Telemetry::Decoder::Result result = decoder.push(stream[i], sample);
+        results[result]++;
+        if(result == Telemetry::Decoder::SAMPLE) value = sample.raw[0];
+    }
+    TEST_ASSERT_EQUAL(1, results[Telemetry::Decoder::SCHEMA]);
+    TEST_ASSERT_EQUAL(2, results[Telemetry::Decoder::SAMPLE]);
+    TEST_ASSERT_EQUAL(1, results[Telemetry::Decoder::CRC_ERROR]);
+    TEST_ASSERT_EQUAL_HEX32(0x03000000, value);
+    TEST_ASSERT_EQUAL(1, decoder.getLostRecords());
+
+    //Garbage without delimiter and samples before the schema are discarded
+    Telemetry::Decoder late;
+    uint8_t garbage[Telemetry::MAX_PACKET_SIZE + 10];
+    memset(garbage, 0x55, sizeof(garbage));
+    for(size_t i=0; i<sizeof(garbage); i++) late.push(garbage[i], sample);
+    TEST_ASSERT_EQUAL(Telemetry::Decoder::INVALID, late.push(0, sample));
+    size_t schemaEnd = 0;
+    while(stream[schemaEnd] != COBS::DELIMITER) schemaEnd++;
+    for(size_t i=schemaEnd + 1; i<size; i++) TEST_ASSERT_NOT_EQUAL(Telemetry::Decoder::SAMPLE, late.push(stream[i], sample));
+    TEST_ASSERT_FALSE(late.isSchemaComplete());
+}
+
+void test_telemetry_ring_overflow(){
+    //The line carries about 960 bytes/s, far less than the records need: whole records are dropped, never parts of them
+    for(uint8_t i=0; i<10; i++) TEST_ASSERT_TRUE(publisher.addInterface(&inputs[i], 1, "x"));
+    start(9600, CYCLE_US);
+    uint32_t start = micros();
+    step(3000);
+    uint32_t duration = micros() - start;
+    const TelemetryPublisher::Statistics& statistics = publisher.getStatistics();
+    TEST_ASSERT_GREATER_THAN(0, statistics.dropped);
+    TEST_ASSERT_LESS_OR_EQUAL(TelemetryPublisher::TX_RING_SIZE, statistics.maxRingFill);
+    TEST_ASSERT_EQUAL(0, receiver.errors);
+    TEST_ASSERT_GREATER_THAN(0, receiver.samples);
+    //cycle() never waits for the line
+    TEST_ASSERT_LESS_THAN(3000 * CYCLE_US / 10, duration);
+
+    //Stop sampling and let the line empty the ring, the receiver sees the gaps of the dropped records
+    uint32_t dropped = statistics.dropped;
+    publisher.clear();
+    step(5000);
+    TEST_ASSERT_EQUAL(0, publisher.getPendingBytes());
+    TEST_ASSERT_EQUAL(0, receiver.errors);
+    TEST_ASSERT_EQUAL(statistics.samples, receiver.samples);
+    //Records dropped after the last queued one leave no gap, the line takes about 40 ms per record
+    TEST_ASSERT_LESS_OR_EQUAL(dropped, receiver.decoder.getLostRecords());
+    TEST_ASSERT_UINT32_WITHIN(50, dropped, receiver.decoder.getLostRecords());
+}
+
+void measure_telemetry_throughput(){
+    const uint32_t DURATION_MS = 2000;
+    const uint8_t counts[] = {4, 10, 24};
+    MEASUREMENT_PRINTLN("Telemetry at " + String(TelemetryPublisher::DEFAULT_BAUDRATE) + " baud, sample period " + String(CYCLE_US) + " us, "
+                        + String(DURATION_MS) + " ms:");
+    for(uint8_t c=0; c<sizeof(counts); c++){
+        setUp();
+        for(uint8_t i=0; i<counts[c]; i++){
+            if(i < 10) TEST_ASSERT_TRUE(publisher.addInterface(&inputs[i], 1, "ai"));
+            else TEST_ASSERT_TRUE(publisher.addMetric("metric", [i](){ return uint32_t(i) << 20; }));
+        }
+        start(TelemetryPublisher::DEFAULT_BAUDRATE, CYCLE_US);
+        uint32_t cycleUs = 0;
+        uint32_t maxCycleUs = 0;
+        for(uint32_t n=0; n<DURATION_MS * 1000 / CYCLE_US; n++){
+            line.run(CYCLE_US);
+            uint32_t begin = micros();
+            publisher.cycle(line.now());
+            uint32_t duration = micros() - begin;
+            cycleUs += duration;
+            if(duration > maxCycleUs) maxCycleUs = duration;
+            receiver.receive();
+        }
+        const TelemetryPublisher::Statistics& statistics = publisher.getStatistics();
+        TEST_ASSERT_EQUAL(0, receiver.errors);
+        MEASUREMENT_PRINTLN("  " + String(counts[c]) + " signals: " + String(receiver.samples * 1000.0f / DURATION_MS, 0) + " samples/s received, "
+                            + String(statistics.txBytes * 1000.0f / DURATION_MS / 1024, 1) + " kB/s on the line, "
+                            + String(statistics.dropped) + " records dropped, cycle() " + String(float(cycleUs) / (DURATION_MS * 1000 / CYCLE_US), 2)
+                            + " us avg, " + String(maxCycleUs) + " us max");
+    }
+}
+
+//Run tests
+void setup(){
+    Serial.begin(115200);
+    delay(2000);
+    UNITY_BEGIN();
+    RUN_TEST(test_telemetry_roundtrip);
+    RUN_TEST(test_telemetry_decimation);
+    RUN_TEST(test_telemetry_crc_and_resync);
+    RUN_TEST(test_telemetry_ring_overflow);
+    RUN_TEST(measure_telemetry_throughput);
+    UNITY_END();
+}
+
+void loop(){
+
+}
@@ -3,6 +3,7 @@
 #include "ESP32_UART.h"
 #include "UARTInterface.h"
 #include "driver/uart.h"
+#include "../test/CANTramTestSetup.h"
 
 ESP32_UART uart;
 UARTInterface uartInterface;
@@ -15,10 +16,13 @@ uart_port_t uartPort;
 
 int RX_PIN = 23;
 int TX_PIN = 19;
+int DE_PIN = 18;
+
+static uint8_t burst[4096];
 
 //Runs before tests
 void setUp(){
-    uart = ESP32_UART();
+    uart.restoreDefaults();
     baudrate = 115200;
     dataBits = UARTCore::UART_DATA_8_BITS;
     parity = UARTCore::UART_PARITY_NONE;
@@ -28,7 +32,7 @@ void setUp(){
 
 //Runs after tests
 void tearDown(){
-    uart_driver_delete(uartPort);
+    uart.reset();
 }
 
 /* Write a function for each test*/
@@ -59,7 +63,171 @@ void test_uart_no_data_after_start(){
     TEST_ASSERT_EQUAL(0, result); // Assuming no data is available initially
 }
 
+void test_uart_rs485_mode(){
+    UARTCore::RS485Config config;
+    TEST_ASSERT_FALSE(uart.setRS485(true, config)); // No DE pin
+    config.dePin = DE_PIN;
+    config.turnaroundUs = 500;
+    config.txIdleBits = 2000;
+    TEST_ASSERT_FALSE(uart.setRS485(true, config)); // Idle time too long
+    config.txIdleBits = 0;
+
+    uart.install(uartPort, TX_PIN, RX_PIN, 1024);
+    uart.config(baudrate, dataBits, UARTCore::UART_PARITY_EVEN, stopBits);
+    TEST_ASSERT_TRUE(uart.setRS485(true, config)); // Applied when the UART is started
+    TEST_ASSERT_TRUE(uart.applyConfig());
+    TEST_ASSERT_TRUE(uart.applyPins());
+    TEST_ASSERT_TRUE(uart.isRS485());
+    TEST_ASSERT_EQUAL(DE_PIN, uart.getRS485Config().dePin);
+
+    const uint8_t data[] = {0x01, 0x03, 0x00, 0x00, 0x00, 0x01};
+    TEST_ASSERT_EQUAL(sizeof(data), uart.write(data, sizeof(data)));
+    TEST_ASSERT_TRUE(uart.setRS485(false, config));
+    TEST_ASSERT_FALSE(uart.isRS485());
+    uart.reset();
+}
+
+void startUART(){
+    TEST_ASSERT_TRUE(uart.install(uartPort, TX_PIN, RX_PIN, 1024));
+    TEST_ASSERT_TRUE(uart.config(baudrate, dataBits, parity, stopBits));
+    TEST_ASSERT_TRUE(uart.applyConfig());
+    TEST_ASSERT_TRUE(uart.applyPins());
+}
+
+bool waitTxDone(uint32_t timeoutMs){
+    uint32_t start = millis();
+    while(!uart.isTxDone()){
+        if(millis() - start > timeoutMs) return false;
+        delay(1);
+    }
+    return true;
+}
+
+void test_uart_nonblocking_send(){
+    static volatile uint32_t txDone = 0;
+    txDone = 0;
+    TEST_ASSERT_TRUE(uart.setNonBlockingSend(true));
+    TEST_ASSERT_TRUE(uart.setTxDoneCallback([](){ txDone++; }));
+    startUART();
+    TEST_ASSERT_FALSE(uart.setTxDoneCallback(nullptr));    // Only before the UART is started
 
+    //4 KB take 356 ms at 115200 baud, send() only queues them
+    uint32_t start = micros();
+    TEST_ASSERT_TRUE(uart.send(reinterpret_cast<const char*>(burst), sizeof(burst)));
+    TEST_ASSERT_LESS_THAN(2000, micros() - start);
+    TEST_ASSERT_FALSE(uart.isTxDone());
+    size_t accepted = uart.write(burst, sizeof(burst));
+    TEST_ASSERT_LESS_THAN(sizeof(burst), accepted);         // Partially accepted, as far as the ring has room
+    TEST_ASSERT_FALSE(uart.setNonBlockingSend(false));      // Queued bytes must not be overtaken
+
+    //Consecutive writes without idle line are one transmission
+    TEST_ASSERT_TRUE(waitTxDone(2000));
+    delay(5);
+    TEST_ASSERT_EQUAL(1, txDone);
+    ESP32_UART::TxStatistics statistics = uart.getTxStatistics();
+    TEST_ASSERT_EQUAL(sizeof(burst) + accepted, statistics.txBytes);
+    TEST_ASSERT_EQUAL(1, statistics.txDone);
+
+    TEST_ASSERT_TRUE(uart.send("x", 1));
+    TEST_ASSERT_TRUE(waitTxDone(100));
+    delay(5);
+    TEST_ASSERT_EQUAL(2, txDone);
+    TEST_ASSERT_TRUE(uart.setNonBlockingSend(false));
+    uart.reset();
+    uart.setTxDoneCallback(nullptr);
+    uart.resetTxStatistics();
+}
+
+void measure_uart_burst_scan_time(){
+    //Scan with 1 ms of work, sending a 4 KB burst every 100 scans at 921600 baud (44 ms per burst)
+    const uint32_t SCANS = 1000;
+    const uint32_t WORK_US = 1000;
+    baudrate = 921600;
+    for(uint8_t nonBlocking=0; nonBlocking<2; nonBlocking++){
+        TEST_ASSERT_TRUE(uart.setNonBlockingSend(nonBlocking));
+        startUART();
+        uint32_t totalUs = 0;
+        uint32_t maxScanUs = 0;
+        uint32_t rejected = 0;
+        for(uint32_t n=0; n<SCANS; n++){
+            uint32_t start = micros();
+            delayMicroseconds(WORK_US);
+            if(n % 100 == 0 && !uart.send(reinterpret_cast<const char*>(burst), sizeof(burst))) rejected++;
+            uint32_t duration = micros() - start;
+            totalUs += duration;
+            if(duration > maxScanUs) maxScanUs = duration;
+        }
+        TEST_ASSERT_TRUE(waitTxDone(1000));
+        TEST_ASSERT_EQUAL(0, rejected);
+        MEASUREMENT_PRINTLN(String(nonBlocking ? "Non-blocking" : "Blocking") + " send() of 4 KB bursts at " + String(baudrate) + " baud: scan time "
+                            + String(float(totalUs) / SCANS, 1) + " us avg, " + String(maxScanUs) + " us max (work " + String(WORK_US) + " us)");
+        uart.reset();
+    }
+    TEST_ASSERT_TRUE(uart.setNonBlockingSend(false));
+}
+
+void test_uart_fifo_config(){
+    UARTCore::FifoConfig config;
+    config.rxFullThreshold = 0;
+    TEST_ASSERT_FALSE(uart.setFifoConfig(config));
+    config.rxFullThreshold = SOC_UART_FIFO_LEN;
+    TEST_ASSERT_FALSE(uart.setFifoConfig(config));
+    config.rxFullThreshold = 64;
+    config.rxTimeoutSymbols = ESP32_UART::MAX_RX_TIMEOUT_SYMBOLS + 1;
+    TEST_ASSERT_FALSE(uart.setFifoConfig(config));
+
+    //Applied when the UART is started and while it is running
+    config.rxTimeoutSymbols = 2;
+    TEST_ASSERT_TRUE(uart.setFifoConfig(config));
+    startUART();
+    TEST_ASSERT_EQUAL(2, uart.getFifoConfig().rxTimeoutSymbols);
+    config.rxTimeoutSymbols = 0;
+    TEST_ASSERT_TRUE(uart.setFifoConfig(config));
+    config.txEmptyThreshold = 0;
+    TEST_ASSERT_FALSE(uart.setFifoConfig(config));
+    TEST_ASSERT_EQUAL(0, uart.getFifoConfig().rxTimeoutSymbols);
+    uart.reset();
+    TEST_ASSERT_EQUAL(UARTCore::FifoConfig().rxTimeoutSymbols, uart.getFifoConfig().rxTimeoutSymbols);
+}
+
+void measure_uart_response_latency(){
+    //8 byte requests echoed by the internal loopback: the echo stays in the RX FIFO until the RX timeout or the full threshold
+    const uint32_t REQUESTS = 100;
+    const uint8_t TIMEOUTS[] = {10, 4, 2, 1};
+    uint32_t averages[sizeof(TIMEOUTS)];
+    MEASUREMENT_PRINTLN("Request-to-first-byte latency of 8 byte requests at " + String(baudrate) + " baud with loopback:");
+    for(uint8_t i=0; i<sizeof(TIMEOUTS) + 1; i++){
+        UARTCore::FifoConfig config;
+        if(i < sizeof(TIMEOUTS)) config.rxTimeoutSymbols = TIMEOUTS[i];
+        else config.rxFullThreshold = 1;
+        TEST_ASSERT_TRUE(uart.setFifoConfig(config));
+        TEST_ASSERT_TRUE(uart.setLatencyMeasurement(true));
+        startUART();
+        TEST_ASSERT_EQUAL(ESP_OK, uart_set_loop_back(uartPort, true));
+        for(uint32_t n=0; n<REQUESTS; n++){
+            TEST_ASSERT_TRUE(uart.send(reinterpret_cast<const char*>(burst), 8));
+            uint32_t start = millis();
+            while(uart.available() < 8 && millis() - start < 20) delayMicroseconds(50);
+            uint8_t buffer[16];
+            TEST_ASSERT_EQUAL(8, uart.read(buffer, sizeof(buffer)));
+            delay(2);
+        }
+        //With full threshold 1 the echo may be readable before the calculated end, such requests count as unanswered
+        UARTCore::LatencyStatistics statistics = uart.getLatencyStatistics();
+        if(i < sizeof(TIMEOUTS)) {
+            TEST_ASSERT_EQUAL(REQUESTS, statistics.responses);
+            TEST_ASSERT_EQUAL(0, statistics.unanswered);
+            averages[i] = statistics.averageUs();
+        }
+        MEASUREMENT_PRINTLN("  RX timeout " + String(config.rxTimeoutSymbols) + " symbols, full threshold " + String(config.rxFullThreshold) + ": min "
+                            + String(statistics.minUs) + " us, avg " + String(statistics.averageUs()) + " us, max " + String(statistics.maxUs) + " us, "
+                            + String(statistics.unanswered) + " unanswered");
+        uart_set_loop_back(uartPort, false);
+        uart.reset();
+    }
+    //A timeout of 10 symbols waits 9 characters longer than 1 symbol, 87 us each at 115200 baud
+    TEST_ASSERT_LESS_THAN(averages[0], averages[sizeof(TIMEOUTS) - 1] + 500);
+}
 
 //Run tests
 void setup(){
@@ -70,6 +238,11 @@ void setup(){
     RUN_TEST(test_uart_config);
     RUN_TEST(test_uart_setPins);
     RUN_TEST(test_uart_no_data_after_start);
+    RUN_TEST(test_uart_rs485_mode);
+    RUN_TEST(test_uart_nonblocking_send);
+    RUN_TEST(measure_uart_burst_scan_time);
+    RUN_TEST(test_uart_fifo_config);
+    RUN_TEST(measure_uart_response_latency);
     UNITY_END();
 }
 
@@ -26,7 +26,7 @@ int TX_PIN = 19;
 
 //Runs before tests
 void setUp(){
-    uart = ESP32_UART();
+    uart.restoreDefaults();
     uartInterface = UARTInterface();
     baudrate = 115200;
     dataBits = UARTCore::UART_DATA_8_BITS;
@@ -44,7 +44,7 @@ void setUp(){
 //Runs after tests
 void tearDown(){
     clearBuffer(randomBuffer, sizeof(randomBuffer));
-    uart.~ESP32_UART();
+    uart.reset();
 }
 
 /* Write a function for each test*/
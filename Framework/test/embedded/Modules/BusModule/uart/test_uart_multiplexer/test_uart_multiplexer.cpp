@@ -0,0 +1,206 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "Debug.h"
+#include "UARTInterface.h"
+#include "UARTMultiplexer.h"
+#include "VirtualUARTLink.h"
+#include "VirtualUARTCore.h"
+#include "ModbusRTUMaster.h"
+#include "ModbusRTUSlave.h"
+#include "AnalogInput.h"
+#include "../test/CANTramTestSetup.h"
+
+/*
+Up to four segments share the port core on one end of a simulated 19200 baud 8E1 line. On every segment a ModbusRTUMaster polls
+slave 1 at the other end, like independent RS-485 lines with the same slave address. The slave answers with the segment the port
+is routed to (pins of the port), so every master must read the number of its own segment.
+Every step() advances the line by STEP_US and processes the slave, the multiplexer and the masters once.
+*/
+
+static const uint8_t PORT = 0;
+static const uint8_t BUS = 1;
+static const uint32_t BAUDRATE = 19200;
+static const uint32_t STEP_US = 100;
+static const uint32_t SLOT_US = 20000;
+static const uint32_t HOLD_US = 3000;
+static const uint8_t TX_PINS[UARTMultiplexer::MAX_SEGMENTS] = {19, 33, 25, 26};
+static const uint8_t RX_PINS[UARTMultiplexer::MAX_SEGMENTS] = {23, 15, 2, 0};
+
+VirtualUARTLink line(BAUDRATE, 11);
+VirtualUARTCore portCore(line, PORT);
+VirtualUARTCore busCore(line, BUS);
+UARTMultiplexer mux;
+UARTInterface segmentUART[UARTMultiplexer::MAX_SEGMENTS];
+UARTInterface busUART;
+ModbusRTUMaster<UARTInterface> masters[UARTMultiplexer::MAX_SEGMENTS] = {
+    ModbusRTUMaster<UARTInterface>(segmentUART[0]), ModbusRTUMaster<UARTInterface>(segmentUART[1]),
+    ModbusRTUMaster<UARTInterface>(segmentUART[2]), ModbusRTUMaster<UARTInterface>(segmentUART[3])
+};
+ModbusRTUSlave slave(1);
+AnalogInput marker(Interface::RES_16BIT);
+bool mastersActive = true;
+bool flood = false;                 // Segment 0 writes continuously instead of running its master
+
+int8_t routedSegment(){
+    for(uint8_t i=0; i<mux.getSegmentCount(); i++){
+        if(portCore.getTxPin() == TX_PINS[i]) return i;
+    }
+    return -1;
+}
+
+void step(uint32_t count = 1){
+    for(uint32_t i=0; i<count; i++){
+        line.run(STEP_US);
+        marker.setQ(routedSegment() + 1);
+        slave.process(line.now());
+        mux.cycle(line.now());
+        for(uint8_t s=0; s<mux.getSegmentCount(); s++){
+            if(flood && s == 0) {
+                static const uint8_t garbage[24] = {};
+                if(!mux.getSegment(0)->hasPendingData()) segmentUART[0].write(garbage, sizeof(garbage));
+                continue;
+            }
+            if(mastersActive) masters[s].cycle(line.now());
+        }
+    }
+}
+
+void stepFor(uint32_t us){
+    step(us / STEP_US);
+}
+
+void start(uint8_t segments){
+    TEST_ASSERT_TRUE(mux.setSegmentCount(segments));
+    for(uint8_t s=0; s<segments; s++){
+        TEST_ASSERT_TRUE(mux.getSegment(s)->install(0, TX_PINS[s], RX_PINS[s], 0));
+        mux.getSegment(s)->resetStatistics();
+        segmentUART[s].setUartCore(mux.getSegment(s));
+        masters[s].clearPolls();
+        masters[s].resetStatistics();
+        masters[s].begin(BAUDRATE);
+        TEST_ASSERT_EQUAL(0, masters[s].addPoll(1, Modbus::READ_INPUT_REGISTERS, 0, 1, 0));
+    }
+    TEST_ASSERT_TRUE(mux.begin(&portCore));
+}
+
+//Runs before tests
+void setUp(){
+    line = VirtualUARTLink(BAUDRATE, 11);
+    mux.end();
+    mux.setTiming(SLOT_US, HOLD_US);
+    TEST_ASSERT_TRUE(portCore.install(1, 0, 0, 1024));
+    TEST_ASSERT_TRUE(busCore.install(1, 0, 0, 1024));
+    TEST_ASSERT_TRUE(portCore.config(BAUDRATE, UARTCore::UART_DATA_8_BITS, UARTCore::UART_PARITY_EVEN, UARTCore::UART_STOP_BITS_1));
+    busUART.setUartCore(&busCore);
+    slave.end();
+    slave.clear();
+    slave.addInterface(&marker);
+    TEST_ASSERT_TRUE(slave.begin(&busUART, BAUDRATE));
+    mastersActive = true;
+    flood = false;
+}
+
+//Runs after tests
+void tearDown(){
+    mux.end();
+    slave.end();
+}
+
+void test_multiplexer_routing(){
+    mastersActive = false;
+    slave.end();
+    start(3);
+    TEST_ASSERT_EQUAL(2 * SLOT_US, mux.getLatencyBoundUs());
+
+    const uint8_t request[] = {'A', 'B', 'C'};
+    TEST_ASSERT_EQUAL(sizeof(request), segmentUART[1].write(request, sizeof(request)));
+    step();
+    TEST_ASSERT_EQUAL(1, mux.getActiveSegment());
+    TEST_ASSERT_EQUAL(TX_PINS[1], portCore.getTxPin());
+    TEST_ASSERT_EQUAL(RX_PINS[1], portCore.getRxPin());
+    stepFor(5000);
+    uint8_t buffer[8];
+    TEST_ASSERT_EQUAL(3, busUART.read(buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(request, buffer, 3);
+
+    const uint8_t response[] = {'x', 'y'};
+    busUART.write(response, sizeof(response));
+    stepFor(5000);
+    TEST_ASSERT_EQUAL(2, segmentUART[1].available());
+    TEST_ASSERT_EQUAL(0, segmentUART[0].available());
+    TEST_ASSERT_EQUAL(0, segmentUART[2].available());
+
+    //A waiting segment gets the port after the transmission and the hold time of the active segment
+    segmentUART[1].write(request, sizeof(request));
+    segmentUART[2].write(request, sizeof(request));
+    step();
+    TEST_ASSERT_EQUAL(1, mux.getActiveSegment());
+    stepFor(sizeof(request) * Modbus::charTimeUs(BAUDRATE) + HOLD_US - 2 * STEP_US);
+    TEST_ASSERT_EQUAL(1, mux.getActiveSegment());
+    step(3);
+    TEST_ASSERT_EQUAL(2, mux.getActiveSegment());
+    TEST_ASSERT_EQUAL(TX_PINS[2], portCore.getTxPin());
+    TEST_ASSERT_EQUAL(1, mux.getSegment(1)->getStatistics().grants);
+    TEST_ASSERT_EQUAL(1, mux.getSegment(2)->getStatistics().grants);
+    TEST_ASSERT_EQUAL(6, mux.getSegment(1)->getStatistics().txBytes);
+    TEST_ASSERT_EQUAL(2, mux.getSegment(1)->getStatistics().rxBytes);
+}
+
+void test_multiplexer_modbus_segments(){
+    start(3);
+    stepFor(2000000);
+    for(uint8_t s=0; s<3; s++){
+        const ModbusRTUMaster<UARTInterface>::PollStatus& status = masters[s].getStatus(0);
+        TEST_ASSERT_GREATER_THAN(30, status.responses);
+        TEST_ASSERT_EQUAL(0, status.timeouts);
+        TEST_ASSERT_EQUAL(0, status.errors);
+        TEST_ASSERT_EQUAL(s + 1, masters[s].getRegisters(0)[0]);
+        TEST_ASSERT_LESS_OR_EQUAL(mux.getLatencyBoundUs() + STEP_US, mux.getSegment(s)->getStatistics().maxWaitUs);
+    }
+}
+
+void test_multiplexer_latency_bound(){
+    //Segment 0 always has bytes pending, the others must still be granted within the bound
+    flood = true;
+    start(3);
+    stepFor(2000000);
+    TEST_ASSERT_GREATER_THAN(10, mux.getSegment(0)->getStatistics().grants);
+    for(uint8_t s=1; s<3; s++){
+        TEST_ASSERT_GREATER_THAN(10, masters[s].getStatus(0).responses);
+        TEST_ASSERT_EQUAL(s + 1, masters[s].getRegisters(0)[0]);
+        TEST_ASSERT_LESS_OR_EQUAL(mux.getLatencyBoundUs() + STEP_US, mux.getSegment(s)->getStatistics().maxWaitUs);
+    }
+}
+
+void measure_multiplexer_latency(){
+    for(uint8_t segments=1; segments<=UARTMultiplexer::MAX_SEGMENTS; segments++){
+        mux.end();
+        start(segments);
+        stepFor(5000000);
+        uint32_t responses = 0;
+        uint32_t maxWait = 0;
+        for(uint8_t s=0; s<segments; s++){
+            responses += masters[s].getStatus(0).responses;
+            if(mux.getSegment(s)->getStatistics().maxWaitUs > maxWait) maxWait = mux.getSegment(s)->getStatistics().maxWaitUs;
+        }
+        MEASUREMENT_PRINTLN("UART multiplexer with " + String(segments) + " segments at " + String(BAUDRATE) + " baud: "
+                            + String(responses / 5.0f / segments, 1) + " polls/s per segment, " + String(responses / 5.0f, 1) + " polls/s total, max wait "
+                            + String(maxWait) + " us (bound " + String(mux.getLatencyBoundUs()) + " us)");
+    }
+}
+
+//Run tests
+void setup(){
+    Serial.begin(115200);
+    delay(2000);
+    UNITY_BEGIN();
+    RUN_TEST(test_multiplexer_routing);
+    RUN_TEST(test_multiplexer_modbus_segments);
+    RUN_TEST(test_multiplexer_latency_bound);
+    RUN_TEST(measure_multiplexer_latency);
+    UNITY_END();
+}
+
+void loop(){
+
+}
@@ -0,0 +1,330 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "Debug.h"
+#include "CANSerial.h"
+#include "UARTInterface.h"
+#include "VirtualUARTLink.h"
+#include "VirtualUARTCore.h"
+#include "../test/CANTramTestSetup.h"
+
+/*
+Tests of the bounded and in-place UART access on a simulated line. The sender streams CANSerial packets at 921600 baud,
+the receiver decodes them every CYCLE_US like a module cycle, once with each way of reading the UART.
+The frame tests send newline-terminated lines and read them with the software pattern detection of the line.
+*/
+
+static const uint8_t SENDER = 0;
+static const uint8_t RECEIVER = 1;
+static const uint32_t CYCLE_US = 1000;
+static const uint32_t BAUDRATE = 921600;
+
+VirtualUARTLink line(BAUDRATE);
+VirtualUARTCore senderCore(line, SENDER);
+VirtualUARTCore receiverCore(line, RECEIVER);
+UARTInterface sender, receiver;
+
+enum ReadMode {
+    READ_ALL,           // read(char[]): copy everything into a buffer of the driver's size
+    READ_BOUNDED,       // read(buffer, capacity) with a small buffer
+    PEEK_CONSUME        // peek()/consume(): decode in the receive buffer
+};
+
+CANFrame makeFrame(uint32_t n){
+    uint8_t data[8];
+    for(uint8_t i=0; i<8; i++) data[i] = (n >> (i % 4 * 8)) + i;
+    CANFrame frame;
+    frame.set(n & 0x7FF, n % 5 == 0, false, data, n % 9, 0);
+    return frame;
+}
+
+/**
+ * @brief Receiver checking the numbered frames in the stream.
+ */
+struct StreamReceiver {
+    CANSerial::Decoder decoder;
+    uint32_t next = 0;
+    uint32_t errors = 0;
+    uint32_t bytes = 0;
+
+    void decode(const uint8_t* data, size_t length){
+        for(size_t i=0; i<length; i++){
+            CANSerial::Record record;
+            CANSerial::Decoder::Result result = decoder.push(data[i], record);
+            if(result == CANSerial::Decoder::INVALID) errors++;
+            if(result != CANSerial::Decoder::FRAME) continue;
+            CANFrame expected = makeFrame(next++);
+            if(record.frame.idFlags != expected.idFlags || memcmp(record.frame.data, expected.data, expected.getLength()) != 0) errors++;
+        }
+        bytes += length;
+    }
+
+    void receive(ReadMode mode){
+        if(mode == READ_ALL){
+            uint8_t buffer[VirtualUARTLink::BUFFER_SIZE];
+            decode(buffer, receiver.read(reinterpret_cast<char*>(buffer)));
+        } else if(mode == READ_BOUNDED){
+            uint8_t buffer[64];
+            size_t length;
+            while((length = receiver.read(buffer, sizeof(buffer))) > 0) decode(buffer, length);
+        } else {
+            const uint8_t* data;
+            size_t length;
+            while((length = receiver.peek(data)) > 0){
+                decode(data, length);
+                receiver.consume(length);
+            }
+        }
+    }
+};
+
+/**
+ * @brief Sender keeping the transmit buffer of the line filled with numbered frames.
+ */
+struct StreamSender {
+    uint8_t packet[CANSerial::MAX_PACKET_SIZE];
+    size_t size = 0;
+    size_t position = 0;
+    uint32_t n = 0;
+
+    void fill(){
+        while(true){
+            if(position >= size){
+                uint8_t record[CANSerial::MAX_RECORD_SIZE];
+                size = CANSerial::encodePacket(record, CANSerial::encodeFrame(makeFrame(n++), 0, false, record), packet);
+                position = 0;
+            }
+            size_t accepted = sender.write(&packet[position], size - position);
+            position += accepted;
+            if(position < size) return;
+        }
+    }
+};
+
+//Runs before tests
+void setUp(){
+    line = VirtualUARTLink(BAUDRATE);
+    sender.setUartCore(&senderCore);
+    receiver.setUartCore(&receiverCore);
+    TEST_ASSERT_TRUE(senderCore.install(1, 0, 0, 1024));
+    TEST_ASSERT_TRUE(receiverCore.install(1, 0, 0, 1024));
+    TEST_ASSERT_TRUE(senderCore.config(BAUDRATE, UARTCore::UART_DATA_8_BITS, UARTCore::UART_PARITY_NONE, UARTCore::UART_STOP_BITS_1));
+    TEST_ASSERT_TRUE(receiver.setPatternDetection(false));
+}
+
+//Runs after tests
+void tearDown(){
+
+}
+
+void test_uart_bounded_read(){
+    uint8_t data[300];
+    for(size_t i=0; i<sizeof(data); i++) data[i] = i * 7;
+    TEST_ASSERT_EQUAL(sizeof(data), sender.write(data, sizeof(data)));
+    line.run(10000);
+    TEST_ASSERT_EQUAL(sizeof(data), receiver.available());
+
+    //The bytes after the given capacity stay untouched
+    uint8_t buffer[64 + 4];
+    memset(buffer, 0xA5, sizeof(buffer));
+    size_t received = 0;
+    size_t length;
+    while((length = receiver.read(buffer, 64)) > 0){
+        TEST_ASSERT_LESS_OR_EQUAL(64, length);
+        TEST_ASSERT_EQUAL_MEMORY(&data[received], buffer, length);
+        received += length;
+        for(uint8_t i=64; i<sizeof(buffer); i++) TEST_ASSERT_EQUAL_HEX8(0xA5, buffer[i]);
+    }
+    TEST_ASSERT_EQUAL(sizeof(data), received);
+}
+
+void test_uart_peek_consume(){
+    uint8_t data[400];
+    for(size_t i=0; i<sizeof(data); i++) data[i] = i ^ 0x5A;
+    const uint8_t* view;
+    TEST_ASSERT_EQUAL(0, receiver.peek(view));
+
+    //Move the receive buffer close to its end so the next bytes wrap around
+    for(uint8_t round=0; round<3; round++){
+        sender.write(data, 300);
+        line.run(10000);
+        TEST_ASSERT_EQUAL(300, receiver.peek(view));
+        receiver.consume(300);
+    }
+    sender.write(data, sizeof(data));
+    line.run(10000);
+    size_t first = receiver.peek(view);
+    TEST_ASSERT_EQUAL(VirtualUARTLink::BUFFER_SIZE - 900, first);
+    TEST_ASSERT_EQUAL_MEMORY(data, view, first);
+
+    //Partial consume keeps the rest in place
+    receiver.consume(10);
+    TEST_ASSERT_EQUAL(first - 10, receiver.peek(view));
+    TEST_ASSERT_EQUAL_HEX8(data[10], view[0]);
+    receiver.consume(first - 10);
+    TEST_ASSERT_EQUAL(sizeof(data) - first, receiver.peek(view));
+    TEST_ASSERT_EQUAL_MEMORY(&data[first], view, sizeof(data) - first);
+    receiver.consume(sizeof(data) - first);
+    TEST_ASSERT_EQUAL(0, receiver.available());
+}
+
+void test_uart_partial_write(){
+    uint8_t data[1500] = {};
+    TEST_ASSERT_EQUAL(1024, sender.write(data, sizeof(data)));
+    TEST_ASSERT_EQUAL(0, sender.write(data, 1));
+    TEST_ASSERT_FALSE(sender.send("x", 1));         // send() is all or nothing
+    line.run(1000);
+    size_t space = line.txFree(SENDER);
+    TEST_ASSERT_GREATER_THAN(80, space);
+    TEST_ASSERT_TRUE(sender.send("const data", 10));
+    TEST_ASSERT_EQUAL(space - 10, sender.write(data, sizeof(data)));
+}
+
+void test_uart_pattern_frames(){
+    const char* lines = "first\nsecond line\n\nthird";
+    TEST_ASSERT_TRUE(sender.send(lines, strlen(lines)));
+    line.run(10000);
+    TEST_ASSERT_EQUAL(0, receiver.nextFrameLength());       // Pattern detection off
+
+    //Bytes received before the detection is switched on are reported as well
+    TEST_ASSERT_TRUE(receiver.setPatternDetection(true));
+    uint8_t buffer[32];
+    TEST_ASSERT_EQUAL(6, receiver.nextFrameLength());
+    TEST_ASSERT_EQUAL(6, receiver.readFrame(buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_MEMORY("first\n", buffer, 6);
+    TEST_ASSERT_EQUAL(12, receiver.readFrame(buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_MEMORY("second line\n", buffer, 12);
+    TEST_ASSERT_EQUAL(1, receiver.readFrame(buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL(0, receiver.readFrame(buffer, sizeof(buffer)));     // "third" is not complete yet
+    TEST_ASSERT_EQUAL(5, receiver.available());
+
+    //A frame longer than the buffer is truncated and its rest discarded
+    TEST_ASSERT_TRUE(sender.send(" and a long tail\nnext\n", 22));
+    line.run(10000);
+    TEST_ASSERT_EQUAL(22, receiver.nextFrameLength());
+    TEST_ASSERT_EQUAL(8, receiver.readFrame(buffer, 8));
+    TEST_ASSERT_EQUAL_MEMORY("third an", buffer, 8);
+    TEST_ASSERT_EQUAL(5, receiver.readFrame(buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_MEMORY("next\n", buffer, 5);
+
+    //Frame ends passed by plain reads are dropped
+    TEST_ASSERT_TRUE(sender.send("a\nb\nc", 5));
+    line.run(10000);
+    TEST_ASSERT_EQUAL(3, receiver.read(buffer, 3));
+    TEST_ASSERT_EQUAL(1, receiver.nextFrameLength());
+    receiver.consume(1);
+    TEST_ASSERT_EQUAL(0, receiver.nextFrameLength());
+    receiver.consume(1);
+
+    //Multi-character pattern, a run of six is two patterns
+    UARTCore::PatternConfig config;
+    config.character = '+';
+    config.count = 3;
+    TEST_ASSERT_TRUE(receiver.setPatternDetection(true, config));
+    TEST_ASSERT_TRUE(sender.send("x++y+++z++++++", 14));
+    line.run(10000);
+    TEST_ASSERT_EQUAL(7, receiver.readFrame(buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_MEMORY("x++y+++", buffer, 7);
+    TEST_ASSERT_EQUAL(4, receiver.readFrame(buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL(3, receiver.readFrame(buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL(0, receiver.available());
+    TEST_ASSERT_EQUAL(3 + 2 + 2 + 3, line.getStatistics(RECEIVER).patterns);
+    config.count = 0;
+    TEST_ASSERT_FALSE(receiver.setPatternDetection(true, config));
+}
+
+void measure_uart_line_framing(){
+    //Lines of 40 bytes at 921600 baud, the receiver takes the complete lines every cycle
+    const uint32_t DURATION_MS = 2000;
+    char text[41];
+    for(uint8_t i=0; i<39; i++) text[i] = 'a' + i % 26;
+    text[39] = '\n';
+    text[40] = 0;
+    MEASUREMENT_PRINTLN("Lines of 40 bytes at " + String(BAUDRATE) + " baud, receiver cycle " + String(CYCLE_US) + " us, " + String(DURATION_MS) + " ms:");
+    for(uint8_t patterns=0; patterns<2; patterns++){
+        setUp();
+        TEST_ASSERT_TRUE(receiver.setPatternDetection(patterns));
+        uint32_t lines = 0;
+        uint32_t receiveUs = 0;
+        for(uint32_t cycle=0; cycle<DURATION_MS * 1000 / CYCLE_US; cycle++){
+            while(line.txFree(SENDER) >= 40) sender.write(reinterpret_cast<const uint8_t*>(text), 40);
+            line.run(CYCLE_US);
+            uint32_t start = micros();
+            uint8_t buffer[64];
+            if(patterns){
+                while(receiver.readFrame(buffer, sizeof(buffer)) == 40) lines++;
+            } else {
+                //Scan the whole receive buffer for the delimiter every cycle, as without pattern detection
+                const uint8_t* data;
+                size_t length;
+                while((length = receiver.peek(data)) > 0){
+                    const uint8_t* end = static_cast<const uint8_t*>(memchr(data, '\n', length));
+                    if(end == nullptr){
+                        if(receiver.available() < 40) break;
+                        receiver.read(buffer, length);      // Line wraps around the end of the receive buffer
+                        size_t rest = 40 - length;
+                        TEST_ASSERT_EQUAL(rest, receiver.read(buffer, rest));
+                        lines++;
+                        continue;
+                    }
+                    receiver.read(buffer, end - data + 1);
+                    lines++;
+                }
+            }
+            receiveUs += micros() - start;
+        }
+        TEST_ASSERT_GREATER_THAN(DURATION_MS * (BAUDRATE / 10 / 40) / 1000 - 10, lines);
+        MEASUREMENT_PRINTLN("  " + String(patterns ? "nextFrameLength()/readFrame()" : "memchr() scan of the receive buffer") + ": " + String(lines)
+                            + " lines, " + String(receiveUs * 1000.0 / lines, 1) + " ns/line");
+    }
+}
+
+void measure_uart_throughput(){
+    const uint32_t DURATION_MS = 2000;
+    const char* names[] = {"read(char[]), 1024 byte buffer", "read(buffer, 64)", "peek()/consume()"};
+    MEASUREMENT_PRINTLN("Sustained stream of CAN records at " + String(BAUDRATE) + " baud, receiver cycle " + String(CYCLE_US) + " us, " + String(DURATION_MS) + " ms:");
+    for(uint8_t mode=READ_ALL; mode<=PEEK_CONSUME; mode++){
+        setUp();
+        StreamSender streamSender;
+        StreamReceiver streamReceiver;
+        uint32_t receiveUs = 0;
+        uint32_t maxCycleUs = 0;
+        for(uint32_t cycle=0; cycle<DURATION_MS * 1000 / CYCLE_US; cycle++){
+            streamSender.fill();
+            line.run(CYCLE_US);
+            uint32_t start = micros();
+            streamReceiver.receive(ReadMode(mode));
+            uint32_t duration = micros() - start;
+            receiveUs += duration;
+            if(duration > maxCycleUs) maxCycleUs = duration;
+        }
+        const VirtualUARTLink::EndpointStatistics& statistics = line.getStatistics(RECEIVER);
+        TEST_ASSERT_EQUAL(0, streamReceiver.errors);
+        TEST_ASSERT_EQUAL(0, statistics.rxOverruns);
+        TEST_ASSERT_GREATER_THAN(1000, streamReceiver.next);
+        //The line is busy all the time: 921600 baud with 10 bits per byte
+        uint32_t bytesPerSecond = uint64_t(streamReceiver.bytes) * 1000 / DURATION_MS;
+        TEST_ASSERT_UINT32_WITHIN(BAUDRATE / 10 / 100, BAUDRATE / 10, bytesPerSecond);
+
+        MEASUREMENT_PRINTLN("  " + String(names[mode]) + ": " + String(bytesPerSecond) + " bytes/s, " + String(streamReceiver.next * 1000 / DURATION_MS)
+                            + " frames/s, receive and decode " + String(receiveUs * 1000.0 / streamReceiver.bytes, 1) + " ns/byte, max "
+                            + String(maxCycleUs) + " us per cycle");
+    }
+}
+
+//Run tests
+void setup(){
+    Serial.begin(115200);
+    delay(2000);
+    UNITY_BEGIN();
+    RUN_TEST(test_uart_bounded_read);
+    RUN_TEST(test_uart_peek_consume);
+    RUN_TEST(test_uart_partial_write);
+    RUN_TEST(test_uart_pattern_frames);
+    RUN_TEST(measure_uart_throughput);
+    RUN_TEST(measure_uart_line_framing);
+    UNITY_END();
+}
+
+void loop(){
+
+}
@@ -0,0 +1,155 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "Debug.h"
+#include "CANAutoBaud.h"
+#include "VirtualCANBus.h"
+#include "VirtualCANCore.h"
+#include "../test/CANTramTestSetup.h"
+
+/*
+A sender node transmits a frame every 10 ms on a simulated bus. The node under test does not know the bitrate of the bus.
+The simulated bus time follows micros().
+*/
+
+static const uint32_t SEND_PERIOD_MS = 10;
+
+VirtualCANBus bus(250000);
+VirtualCANCore senderCore(bus), nodeCore(bus);
+CANAutoBaud autoBaud;
+uint32_t lastPump = 0;
+uint32_t lastSend = 0;
+bool sending = true;
+
+void pump(){
+    uint32_t now = micros();
+    if(sending && millis() - lastSend >= SEND_PERIOD_MS){
+        lastSend = millis();
+        CANCore::CANMessage message = {};
+        message.id = 0x181;
+        message.length = 8;
+        senderCore.sendMessage(message);
+    }
+    bus.run(now - lastPump);
+    lastPump = now;
+    autoBaud.poll();
+}
+
+/**
+ * @brief Pump until the detection is finished or the given time in milliseconds has passed.
+ */
+CANAutoBaud::State pumpUntilDone(uint32_t ms){
+    uint32_t start = millis();
+    while(autoBaud.getState() == CANAutoBaud::LISTENING && millis() - start < ms){
+        pump();
+    }
+    return autoBaud.getState();
+}
+
+void startBus(CANCore::Baudrate baudrate){
+    senderCore.end();
+    nodeCore.end();
+    bus.setBitrate(baudrate);
+    senderCore.setBaudrate(baudrate);
+    senderCore.begin();
+    nodeCore.setBaudrate(CANCore::BR_NOT_SET);
+    lastPump = micros();
+    lastSend = millis();
+}
+
+//Runs before tests
+void setUp(){
+    sending = true;
+    autoBaud.setDwellTime(50);
+    startBus(CANCore::BR_250K);
+}
+
+//Runs after tests
+void tearDown(){
+    autoBaud.end();
+}
+
+void test_autobaud_lock(){
+    DEBUG_PRINTLN("TEST: test_autobaud_lock");
+    TEST_ASSERT_TRUE(autoBaud.begin(&nodeCore, 1000));
+    TEST_ASSERT_EQUAL(CANAutoBaud::LISTENING, autoBaud.getState());
+    TEST_ASSERT_TRUE(nodeCore.isListenOnly());
+
+    //The node cannot send while listening
+    CANCore::CANMessage message = {};
+    message.id = 0x100;
+    TEST_ASSERT_FALSE(nodeCore.sendMessage(message));
+
+    TEST_ASSERT_EQUAL(CANAutoBaud::LOCKED, pumpUntilDone(1000));
+    TEST_ASSERT_EQUAL(CANCore::BR_250K, autoBaud.getBaudrate());
+    TEST_ASSERT_EQUAL(CANCore::BR_250K, nodeCore.getBaudrate());
+    TEST_ASSERT_TRUE(nodeCore.isInitialized());
+    TEST_ASSERT_FALSE(nodeCore.isListenOnly());
+    TEST_ASSERT_GREATER_THAN(0, autoBaud.getErrorCount());          // 125 kbit/s was tried first
+    TEST_ASSERT_LESS_OR_EQUAL(2 * 50 + SEND_PERIOD_MS, autoBaud.getDetectionTimeMs());
+
+    //Normal operation at the detected baudrate
+    TEST_ASSERT_TRUE(nodeCore.sendMessage(message));
+}
+
+void test_autobaud_no_traffic(){
+    DEBUG_PRINTLN("TEST: test_autobaud_no_traffic");
+    sending = false;
+    TEST_ASSERT_TRUE(autoBaud.begin(&nodeCore, 300));
+    TEST_ASSERT_EQUAL(CANAutoBaud::NO_TRAFFIC, pumpUntilDone(1000));
+    TEST_ASSERT_UINT32_WITHIN(20, 300, autoBaud.getDetectionTimeMs());
+    TEST_ASSERT_GREATER_OR_EQUAL(4, autoBaud.getSwitchCount());
+    TEST_ASSERT_FALSE(nodeCore.isInitialized());
+    TEST_ASSERT_EQUAL(CANCore::BR_NOT_SET, nodeCore.getBaudrate());
+}
+
+void test_autobaud_unsupported_baudrate(){
+    DEBUG_PRINTLN("TEST: test_autobaud_unsupported_baudrate");
+    const CANCore::Baudrate candidates[] = {CANCore::BR_500K, CANCore::BR_1M};
+    TEST_ASSERT_TRUE(autoBaud.setCandidates(candidates, 2));
+    TEST_ASSERT_TRUE(autoBaud.begin(&nodeCore, 300));
+    TEST_ASSERT_EQUAL(CANAutoBaud::FAILED, pumpUntilDone(1000));
+    TEST_ASSERT_GREATER_THAN(0, autoBaud.getErrorCount());
+    TEST_ASSERT_FALSE(nodeCore.isInitialized());
+    TEST_ASSERT_EQUAL(0, bus.getStatistics(senderCore.getNode()).txErrors);     // The bus was not disturbed
+
+    const CANCore::Baudrate all[] = {CANCore::BR_125K, CANCore::BR_250K, CANCore::BR_500K, CANCore::BR_1M};
+    TEST_ASSERT_TRUE(autoBaud.setCandidates(all, 4));
+}
+
+void measure_autobaud_detection_time(){
+    const uint16_t MEASUREMENTS = 10;
+    const CANCore::Baudrate baudrates[] = {CANCore::BR_125K, CANCore::BR_250K, CANCore::BR_500K, CANCore::BR_1M};
+    MEASUREMENT_PRINTLN("Baudrate detection, frame every " + String(SEND_PERIOD_MS) + " ms, 50 ms per candidate, candidates 125k/250k/500k/1M:");
+    for(uint8_t index=0; index<4; index++){
+        CANCore::Baudrate baudrate = baudrates[index];
+        MeasurementArray<MEASUREMENTS> times;
+        for(uint16_t i=0; i<MEASUREMENTS; i++){
+            startBus(baudrate);
+            delay(i);       // Vary the phase of the traffic
+            TEST_ASSERT_TRUE(autoBaud.begin(&nodeCore, 1000));
+            TEST_ASSERT_EQUAL(CANAutoBaud::LOCKED, pumpUntilDone(1000));
+            TEST_ASSERT_EQUAL(baudrate, autoBaud.getBaudrate());
+            times.addSample(autoBaud.getDetectionTimeMs());
+        }
+        MEASUREMENT_PRINTLN("  " + String(uint32_t(baudrate) / 1000) + " kbit/s: avg " + String(times.getAverage()) + " ms, max " + String(times.getMax()) + " ms");
+        //The simulation counts one bus error per frame, so every earlier candidate is left after ERROR_SWITCH_THRESHOLD frames.
+        //The matching candidate locks with the first frame.
+        TEST_ASSERT_LESS_OR_EQUAL((index * CANAutoBaud::ERROR_SWITCH_THRESHOLD + 1) * SEND_PERIOD_MS + 5, times.getMax());
+    }
+}
+
+//Run tests
+void setup(){
+    Serial.begin(115200);
+    delay(2000);
+    UNITY_BEGIN();
+    RUN_TEST(test_autobaud_lock);
+    RUN_TEST(test_autobaud_no_traffic);
+    RUN_TEST(test_autobaud_unsupported_baudrate);
+    RUN_TEST(measure_autobaud_detection_time);
+    UNITY_END();
+}
+
+void loop(){
+
+}
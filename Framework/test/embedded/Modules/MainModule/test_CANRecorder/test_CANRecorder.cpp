@@ -0,0 +1,260 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "Debug.h"
+#include "CANInterface.h"
+#include "VirtualCANBus.h"
+#include "VirtualCANCore.h"
+#include "CANLog.h"
+#include "CANRecorder.h"
+#include "CANReplayCore.h"
+#include "../test/CANTramTestSetup.h"
+
+/*
+The recorded node and a peer node sending the traffic are connected by a simulated bus at 500 kbit/s.
+Recorded logs are played back through a CANReplayCore.
+*/
+
+/**
+ * @brief Listener storing the received frames and their receive timestamps.
+ */
+class CollectListener : public CANListener {
+public:
+    bool onMessage(const CANCore::CANMessage& message) override {
+        if(count < MAX_FRAMES) {
+            frames[count] = message;
+            times[count] = micros();
+            count++;
+        }
+        return true;
+    }
+    static constexpr uint16_t MAX_FRAMES = 64;
+    CANCore::CANMessage frames[MAX_FRAMES];
+    uint32_t times[MAX_FRAMES];
+    uint16_t count = 0;
+};
+
+static constexpr uint16_t FRAME_COUNT = 20;
+static constexpr uint32_t FRAME_SPACING_US = 2000;
+
+VirtualCANBus bus(500000);
+VirtualCANCore recordCore(bus), peerCore(bus);
+CANReplayCore replayCore;
+CANInterface recordInterface, replayInterface;
+CANRecorder recorder;
+CollectListener collector;
+
+uint8_t logBuffer[4096];
+size_t logLength = 0;
+size_t sinkLimit = sizeof(logBuffer);
+
+size_t writeLog(const uint8_t* data, size_t length){
+    size_t space = sinkLimit - logLength;
+    if(length > space) length = space;
+    memcpy(&logBuffer[logLength], data, length);
+    logLength += length;
+    return length;
+}
+
+CANCore::CANMessage makeMessage(uint32_t id, uint8_t length){
+    CANCore::CANMessage message = {};
+    message.id = id;
+    message.length = length;
+    for(uint8_t i=0; i<length; i++) message.data[i] = id + i;
+    return message;
+}
+
+/**
+ * @brief Send a frame from the peer node and advance the bus in 10 us steps until the recorded node received it.
+ * @details The frame may wait for a frame sent by the recorded node. The receive timestamp is at most one step old.
+ */
+void transmit(const CANCore::CANMessage& message){
+    TEST_ASSERT_TRUE(peerCore.sendMessage(message));
+    for(uint16_t i=0; i<1000 && recordCore.available() == 0; i++) bus.run(10);
+}
+
+/**
+ * @brief Record FRAME_COUNT received frames with FRAME_SPACING_US spacing and one sent frame after every 5th frame.
+ */
+void recordTraffic(){
+    TEST_ASSERT_TRUE(recorder.begin(&recordInterface, writeLog));
+    uint32_t startTime = micros();
+    for(uint16_t i=0; i<FRAME_COUNT; i++){
+        while(micros() - startTime < i * FRAME_SPACING_US);
+        transmit(makeMessage(0x100 + i, i % 9));
+        recordInterface.process();
+        if(i % 5 == 4) TEST_ASSERT_TRUE(recordInterface.sendMessage(makeMessage(0x700, 1)));
+    }
+    recorder.end();
+}
+
+/**
+ * @brief Replay the recorded log and collect the frames.
+ */
+void replayTraffic(float speed){
+    collector.count = 0;
+    TEST_ASSERT_TRUE(replayCore.setLog(logBuffer, logLength));
+    replayCore.setSpeed(speed);
+    TEST_ASSERT_TRUE(replayCore.begin());
+    for(uint32_t i=0; i<1000000 && !replayCore.isFinished(); i++){
+        replayInterface.process();
+    }
+    replayInterface.process();
+}
+
+//Runs before tests
+void setUp(){
+    logLength = 0;
+    sinkLimit = sizeof(logBuffer);
+    recordCore.end();
+    peerCore.end();
+    recordInterface.setCANCore(&recordCore);
+    recordInterface.clearListeners();
+    recordInterface.begin();
+    peerCore.begin();
+    replayInterface.setCANCore(&replayCore);
+    replayInterface.clearListeners();
+    replayInterface.addListener(&collector);
+    replayCore.setReplayTransmitted(false);
+    replayCore.setupFilter(0, 0);
+    recorder.setRecordTransmitted(true);
+}
+
+//Runs after tests
+void tearDown(){
+    recorder.end();
+    replayCore.end();
+}
+
+void test_recorder_log_content(){
+    DEBUG_PRINTLN("TEST: test_recorder_log_content");
+    recordTraffic();
+    TEST_ASSERT_EQUAL(FRAME_COUNT + FRAME_COUNT / 5, recorder.getRecordCount());
+    TEST_ASSERT_EQUAL(0, recorder.getDroppedCount());
+    TEST_ASSERT_EQUAL(logLength, recorder.getBytesWritten());
+
+    uint32_t baudrate = 0;
+    TEST_ASSERT_TRUE(CANLog::decodeHeader(logBuffer, logLength, baudrate));
+    TEST_ASSERT_EQUAL(CANCore::BR_500K, baudrate);
+
+    size_t position = CANLog::HEADER_SIZE;
+    uint16_t rxCount = 0, txCount = 0;
+    uint32_t lastTimestamp = 0;
+    CANLog::Record record;
+    while(position < logLength){
+        size_t size = CANLog::decodeRecord(&logBuffer[position], logLength - position, record);
+        TEST_ASSERT_NOT_EQUAL(0, size);
+        position += size;
+        if(record.direction == CANLog::TX){
+            TEST_ASSERT_EQUAL_HEX32(0x700, record.getId());
+            txCount++;
+            continue;
+        }
+        TEST_ASSERT_EQUAL_HEX32(0x100 + rxCount, record.getId());
+        TEST_ASSERT_EQUAL(rxCount % 9, record.length);
+        if(rxCount > 0){
+            TEST_ASSERT_UINT32_WITHIN(FRAME_SPACING_US / 4, FRAME_SPACING_US, record.timestamp - lastTimestamp);
+        }
+        lastTimestamp = record.timestamp;
+        rxCount++;
+    }
+    TEST_ASSERT_EQUAL(FRAME_COUNT, rxCount);
+    TEST_ASSERT_EQUAL(FRAME_COUNT / 5, txCount);
+}
+
+void test_recorder_sink_backpressure(){
+    DEBUG_PRINTLN("TEST: test_recorder_sink_backpressure");
+    sinkLimit = CANLog::HEADER_SIZE + 100;
+    TEST_ASSERT_TRUE(recorder.begin(&recordInterface, writeLog));
+    for(uint16_t i=0; i<100; i++){
+        transmit(makeMessage(0x200, 8));
+        recordInterface.process();
+    }
+    TEST_ASSERT_GREATER_THAN(0, recorder.getDroppedCount());
+    TEST_ASSERT_EQUAL(100, recorder.getRecordCount() + recorder.getDroppedCount());
+    sinkLimit = sizeof(logBuffer);
+    TEST_ASSERT_TRUE(recorder.flush());
+    TEST_ASSERT_EQUAL(CANLog::HEADER_SIZE + recorder.getRecordCount() * 17, logLength);
+}
+
+void test_replay_content_and_filter(){
+    DEBUG_PRINTLN("TEST: test_replay_content_and_filter");
+    recordTraffic();
+    replayTraffic(0);
+    TEST_ASSERT_EQUAL(FRAME_COUNT, collector.count);
+    for(uint16_t i=0; i<FRAME_COUNT; i++){
+        CANCore::CANMessage expected = makeMessage(0x100 + i, i % 9);
+        TEST_ASSERT_EQUAL_HEX32(expected.id, collector.frames[i].id);
+        TEST_ASSERT_EQUAL(expected.length, collector.frames[i].length);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data, collector.frames[i].data, 8);
+    }
+
+    replayCore.setReplayTransmitted(true);
+    replayTraffic(0);
+    TEST_ASSERT_EQUAL(FRAME_COUNT + FRAME_COUNT / 5, collector.count);
+
+    replayCore.setReplayTransmitted(false);
+    replayCore.setupFilter(0x108, 0x7F8);   // 0x108 - 0x10F
+    replayTraffic(0);
+    TEST_ASSERT_EQUAL(8, collector.count);
+    TEST_ASSERT_EQUAL_HEX32(0x108, collector.frames[0].id);
+}
+
+void measure_replay_timing(){
+    const float speeds[] = {1.0f, 4.0f};
+    recordTraffic();
+    for(float speed : speeds){
+        replayTraffic(speed);
+        TEST_ASSERT_EQUAL(FRAME_COUNT, collector.count);
+        MeasurementArray<FRAME_COUNT> errors;
+        uint32_t expectedSpacing = FRAME_SPACING_US / speed;
+        for(uint16_t i=1; i<FRAME_COUNT; i++){
+            uint32_t spacing = collector.times[i] - collector.times[i - 1];
+            errors.addSample(spacing > expectedSpacing ? spacing - expectedSpacing : expectedSpacing - spacing);
+        }
+        MEASUREMENT_PRINTLN("Replay at speed " + String(speed) + ", expected spacing " + String(expectedSpacing) + " us:");
+        MEASUREMENT_PRINTLN("  Spacing error: avg " + String(errors.getAverage()) + " us, max " + String(errors.getMax()) + " us");
+        TEST_ASSERT_LESS_THAN(expectedSpacing / 4, errors.getAverage());
+    }
+}
+
+void measure_recorder_overhead(){
+    const uint16_t MEASUREMENTS = 200;
+    MeasurementArray<MEASUREMENTS> withRecorder, withoutRecorder;
+    CANCore::CANMessage message = makeMessage(0x123, 8);
+
+    for(uint16_t i=0; i<MEASUREMENTS; i++){
+        transmit(message);
+        uint32_t startTime = esp_timer_get_time();
+        recordInterface.process();
+        withoutRecorder.addSample(esp_timer_get_time() - startTime);
+    }
+    TEST_ASSERT_TRUE(recorder.begin(&recordInterface, [](const uint8_t* data, size_t length) { return length; }));
+    for(uint16_t i=0; i<MEASUREMENTS; i++){
+        transmit(message);
+        uint32_t startTime = esp_timer_get_time();
+        recordInterface.process();
+        withRecorder.addSample(esp_timer_get_time() - startTime);
+    }
+    recorder.end();
+    MEASUREMENT_PRINTLN("CANInterface::process() with one frame:");
+    MEASUREMENT_PRINTLN("  Without recorder: avg " + String(withoutRecorder.getAverage()) + " us, max " + String(withoutRecorder.getMax()) + " us");
+    MEASUREMENT_PRINTLN("  With recorder: avg " + String(withRecorder.getAverage()) + " us, max " + String(withRecorder.getMax()) + " us");
+    MEASUREMENT_PRINTLN("  Log size: " + String(CANLog::MAX_RECORD_SIZE) + " bytes per 8 byte frame");
+}
+
+//Run tests
+void setup(){
+    Serial.begin(115200);
+    delay(2000);
+    UNITY_BEGIN();
+    RUN_TEST(test_recorder_log_content);
+    RUN_TEST(test_recorder_sink_backpressure);
+    RUN_TEST(test_replay_content_and_filter);
+    RUN_TEST(measure_replay_timing);
+    RUN_TEST(measure_recorder_overhead);
+    UNITY_END();
+}
+
+void loop(){
+
+}
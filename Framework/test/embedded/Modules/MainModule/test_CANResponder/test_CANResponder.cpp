@@ -0,0 +1,289 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "Debug.h"
+#include "CANInterface.h"
+#include "CANResponder.h"
+#include "VirtualCANBus.h"
+#include "VirtualCANCore.h"
+#include "../test/CANTramTestSetup.h"
+
+/*
+A requester and a node are connected by a simulated bus at 500 kbit/s. The simulated bus time follows micros().
+The node runs its application loop (CANInterface::process()) only every APP_PERIOD_MS, like a module with a slow control loop.
+nodeCore.serviceResponder() is called on every pump and takes the place of the CAN driver task.
+*/
+
+static const uint32_t APP_PERIOD_MS = 20;
+static const uint32_t STATUS_ID = 0x181;
+static const uint32_t APP_ID = 0x182;
+static const uint32_t HEARTBEAT_ID = 0x701;
+static const uint32_t GUARD_ID = 0x702;
+
+VirtualCANBus bus(500000);
+VirtualCANCore requesterCore(bus), nodeCore(bus);
+CANInterface nodeCAN;
+CANResponder responder;
+uint32_t lastPump = 0;
+uint32_t lastApp = 0;
+
+/**
+ * @brief Application listener which answers remote frames for APP_ID when the application loop runs.
+ */
+class AppListener : public CANListener {
+public:
+    bool onMessage(const CANCore::CANMessage& message) override {
+        received++;
+        if(!message.isRemote || message.id != APP_ID) return false;
+        CANCore::CANMessage response = {};
+        response.id = APP_ID;
+        response.length = 2;
+        response.data[0] = 0xAB;
+        nodeCAN.sendMessage(response);
+        return true;
+    }
+    uint32_t received = 0;
+};
+
+AppListener appListener;
+
+void pump(){
+    uint32_t now = micros();
+    bus.run(now - lastPump);
+    lastPump = now;
+    nodeCore.serviceResponder();
+    if(millis() - lastApp >= APP_PERIOD_MS){
+        lastApp = millis();
+        nodeCAN.process();
+    }
+}
+
+void pumpFor(uint32_t ms){
+    uint32_t start = millis();
+    while(millis() - start < ms){
+        pump();
+    }
+}
+
+void sendRemote(uint32_t id, uint8_t length){
+    CANCore::CANMessage request = {};
+    request.id = id;
+    request.isRemote = true;
+    request.length = length;
+    TEST_ASSERT_TRUE(requesterCore.sendMessage(request));
+}
+
+/**
+ * @brief Pump until the requester received a frame with the given identifier or the timeout in milliseconds has passed.
+ */
+bool waitForFrame(uint32_t id, CANFrame& frame, uint32_t timeoutMs){
+    uint32_t start = millis();
+    while(millis() - start < timeoutMs){
+        pump();
+        while(requesterCore.readFrame(frame)){
+            if(frame.getId() == id) return true;
+        }
+    }
+    return false;
+}
+
+//Runs before tests
+void setUp(){
+    requesterCore.end();
+    nodeCore.end();
+    requesterCore.begin();
+    nodeCAN.clearListeners();
+    nodeCAN.setCANCore(&nodeCore);
+    nodeCAN.begin();
+    nodeCAN.addListener(&appListener);
+    appListener.received = 0;
+
+    const uint8_t status[] = {0x11, 0x22, 0x33, 0x44};
+    const uint8_t heartbeat[] = {0x05};
+    const uint8_t guard[] = {0x05};
+    responder.clear();
+    responder.resetStatistics();
+    TEST_ASSERT_TRUE(responder.addRemoteResponse(STATUS_ID, status, 4));
+    TEST_ASSERT_TRUE(responder.addRemoteResponse(GUARD_ID, guard, 1, true));
+    TEST_ASSERT_TRUE(responder.addPeriodic(HEARTBEAT_ID, heartbeat, 1, 50));
+    lastPump = micros();
+    lastApp = millis();
+}
+
+//Runs after tests
+void tearDown(){
+    nodeCAN.setResponder(nullptr);
+}
+
+void test_responder_table(){
+    DEBUG_PRINTLN("TEST: test_responder_table");
+    TEST_ASSERT_EQUAL(3, responder.getEntryCount());
+    TEST_ASSERT_FALSE(responder.addRemoteResponse(STATUS_ID, nullptr, 0));     // Identifier already in the table
+    TEST_ASSERT_FALSE(responder.setPayload(0x123, nullptr, 0));
+    TEST_ASSERT_FALSE(responder.setPayload(STATUS_ID, nullptr, 9));
+
+    CANFrame request, response;
+    request.set(STATUS_ID, false, true, nullptr, 4, 0);
+    TEST_ASSERT_TRUE(responder.handleRemote(request, response));
+    TEST_ASSERT_FALSE(response.isRemote());
+    TEST_ASSERT_EQUAL(4, response.getLength());
+    TEST_ASSERT_EQUAL_HEX8(0x44, response.data[3]);
+    request.set(STATUS_ID, true, true, nullptr, 4, 0);
+    TEST_ASSERT_FALSE(responder.handleRemote(request, response));                  // Extended identifier
+    request.set(STATUS_ID, false, false, nullptr, 0, 0);
+    TEST_ASSERT_FALSE(responder.handleRemote(request, response));                  // Data frame
+    request.set(HEARTBEAT_ID, false, true, nullptr, 1, 0);
+    TEST_ASSERT_FALSE(responder.handleRemote(request, response));                  // Periodic only
+
+    //Periodic frames: first one due immediately, then without drift
+    TEST_ASSERT_EQUAL(0, responder.getTimeToNext(1000, 100));
+    TEST_ASSERT_TRUE(responder.nextPeriodic(1000, response));
+    TEST_ASSERT_EQUAL_HEX32(HEARTBEAT_ID, response.getId());
+    TEST_ASSERT_FALSE(responder.nextPeriodic(1000, response));
+    TEST_ASSERT_EQUAL(40, responder.getTimeToNext(1010, 100));
+    TEST_ASSERT_TRUE(responder.nextPeriodic(1053, response));
+    TEST_ASSERT_EQUAL(47, responder.getTimeToNext(1053, 100));                      // Due at 1100, not 1103
+    TEST_ASSERT_TRUE(responder.nextPeriodic(1400, response));                      // Missed periods are skipped
+    TEST_ASSERT_FALSE(responder.nextPeriodic(1420, response));
+    TEST_ASSERT_EQUAL(50, responder.getTimeToNext(1400, 100));
+}
+
+void test_responder_remote_answer(){
+    DEBUG_PRINTLN("TEST: test_responder_remote_answer");
+    TEST_ASSERT_TRUE(nodeCAN.setResponder(&responder));
+
+    CANFrame frame;
+    sendRemote(STATUS_ID, 4);
+    TEST_ASSERT_TRUE(waitForFrame(STATUS_ID, frame, 5));        // Answered before the application loop runs
+    TEST_ASSERT_FALSE(frame.isRemote());
+    TEST_ASSERT_EQUAL(4, frame.getLength());
+    TEST_ASSERT_EQUAL_HEX8(0x11, frame.data[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x44, frame.data[3]);
+
+    //The application only updates the payload
+    const uint8_t update[] = {0x55, 0x66};
+    TEST_ASSERT_TRUE(responder.setPayload(STATUS_ID, update, 2));
+    sendRemote(STATUS_ID, 2);
+    TEST_ASSERT_TRUE(waitForFrame(STATUS_ID, frame, 5));
+    TEST_ASSERT_EQUAL(2, frame.getLength());
+    TEST_ASSERT_EQUAL_HEX8(0x55, frame.data[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x66, frame.data[1]);
+
+    //Answered remote frames are not passed to the application
+    pumpFor(2 * APP_PERIOD_MS);
+    TEST_ASSERT_EQUAL(2, responder.getStatistics().remoteAnswered);
+    uint32_t heartbeats = responder.getStatistics().periodicSent;
+    TEST_ASSERT_EQUAL(0, appListener.received);
+    TEST_ASSERT_GREATER_THAN(0, heartbeats);
+}
+
+void test_responder_node_guard(){
+    DEBUG_PRINTLN("TEST: test_responder_node_guard");
+    TEST_ASSERT_TRUE(nodeCAN.setResponder(&responder));
+    CANFrame frame;
+    for(uint8_t i=0; i<4; i++){
+        sendRemote(GUARD_ID, 1);
+        TEST_ASSERT_TRUE(waitForFrame(GUARD_ID, frame, 5));
+        TEST_ASSERT_EQUAL(1, frame.getLength());
+        TEST_ASSERT_EQUAL_HEX8((i % 2 ? 0x80 : 0x00) | 0x05, frame.data[0]);
+    }
+}
+
+void test_responder_unknown_remote(){
+    DEBUG_PRINTLN("TEST: test_responder_unknown_remote");
+    TEST_ASSERT_TRUE(nodeCAN.setResponder(&responder));
+    CANFrame frame;
+    sendRemote(APP_ID, 2);
+    TEST_ASSERT_TRUE(waitForFrame(APP_ID, frame, 3 * APP_PERIOD_MS));   // Answered by the application
+    TEST_ASSERT_EQUAL_HEX8(0xAB, frame.data[0]);
+    TEST_ASSERT_EQUAL(1, appListener.received);
+    TEST_ASSERT_EQUAL(0, responder.getStatistics().remoteAnswered);
+}
+
+void test_responder_heartbeat(){
+    DEBUG_PRINTLN("TEST: test_responder_heartbeat");
+    TEST_ASSERT_TRUE(nodeCAN.setResponder(&responder));
+    const uint16_t COUNT = 10;
+    uint32_t times[COUNT];
+    uint16_t count = 0;
+    CANFrame frame;
+    uint32_t start = millis();
+    while(count < COUNT && millis() - start < 1000){
+        pump();
+        while(count < COUNT && requesterCore.readFrame(frame)){
+            if(frame.getId() != HEARTBEAT_ID) continue;
+            TEST_ASSERT_EQUAL_HEX8(0x05, frame.data[0]);
+            times[count++] = frame.expandTimestamp(micros());
+        }
+    }
+    TEST_ASSERT_EQUAL(COUNT, count);
+    uint32_t minPeriod = UINT32_MAX, maxPeriod = 0;
+    for(uint16_t i=1; i<COUNT; i++){
+        uint32_t period = times[i] - times[i - 1];
+        if(period < minPeriod) minPeriod = period;
+        if(period > maxPeriod) maxPeriod = period;
+    }
+    MEASUREMENT_PRINTLN("Heartbeat period (50 ms, application loop every " + String(APP_PERIOD_MS) + " ms): avg " + String((times[COUNT - 1] - times[0]) / (COUNT - 1)) + " us, min " + String(minPeriod) + " us, max " + String(maxPeriod) + " us");
+    TEST_ASSERT_UINT32_WITHIN(2000, 50000, minPeriod);
+    TEST_ASSERT_UINT32_WITHIN(2000, 50000, maxPeriod);
+
+    //Detaching stops the heartbeat
+    nodeCAN.setResponder(nullptr);
+    pumpFor(60);
+    while(requesterCore.readFrame(frame)) {}
+    pumpFor(120);
+    bool heartbeat = false;
+    while(requesterCore.readFrame(frame)) heartbeat |= frame.getId() == HEARTBEAT_ID;
+    TEST_ASSERT_FALSE(heartbeat);
+}
+
+/**
+ * @brief Measure the time from queueing a remote frame at the requester to the end of the response, in simulated bus time.
+ */
+void measureLatency(uint32_t id, MeasurementArray<20>& latencies){
+    uint64_t requested = 0, answered = 0;
+    bus.setTransmitCallback([&](uint8_t node, const CANFrame& frame, uint64_t queuedUs, uint64_t doneUs) {
+        if(frame.getId() != id) return;
+        if(frame.isRemote()) requested = queuedUs;
+        else answered = doneUs;
+    });
+    CANFrame frame;
+    for(uint16_t i=0; i<20; i++){
+        pumpFor(3 + i % 7);         // Vary the phase to the application loop
+        sendRemote(id, 2);
+        TEST_ASSERT_TRUE(waitForFrame(id, frame, 3 * APP_PERIOD_MS));
+        latencies.addSample(answered - requested);
+    }
+    bus.setTransmitCallback(nullptr);
+}
+
+void measure_responder_latency(){
+    TEST_ASSERT_TRUE(nodeCAN.setResponder(&responder));
+    TEST_ASSERT_TRUE(responder.addRemoteResponse(0x183, nullptr, 2));
+    MeasurementArray<20> cached, application;
+    measureLatency(0x183, cached);
+    measureLatency(APP_ID, application);
+    MEASUREMENT_PRINTLN("Remote frame response latency at 500 kbit/s, application loop every " + String(APP_PERIOD_MS) + " ms:");
+    MEASUREMENT_PRINTLN("  Responder:   avg " + String(uint32_t(cached.getAverage())) + " us, max " + String(uint32_t(cached.getMax())) + " us");
+    MEASUREMENT_PRINTLN("  Application: avg " + String(uint32_t(application.getAverage())) + " us, max " + String(uint32_t(application.getMax())) + " us");
+    //Remote frame and response take about 200 us on the bus
+    TEST_ASSERT_LESS_THAN(1000, uint32_t(cached.getMax()));
+    TEST_ASSERT_GREATER_THAN(uint32_t(cached.getMax()), uint32_t(application.getAverage()));
+}
+
+//Run tests
+void setup(){
+    Serial.begin(115200);
+    delay(2000);
+    UNITY_BEGIN();
+    RUN_TEST(test_responder_table);
+    RUN_TEST(test_responder_remote_answer);
+    RUN_TEST(test_responder_node_guard);
+    RUN_TEST(test_responder_unknown_remote);
+    RUN_TEST(test_responder_heartbeat);
+    RUN_TEST(measure_responder_latency);
+    UNITY_END();
+}
+
+void loop(){
+
+}
@@ -0,0 +1,232 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "Debug.h"
+#include "CANInterface.h"
+#include "CANTimeSync.h"
+#include "CANTramModule.h"
+#include "DigitalOutput.h"
+#include "VirtualCANBus.h"
+#include "VirtualCANCore.h"
+#include "../test/CANTramTestSetup.h"
+
+/*
+A master and two slaves are connected by a simulated bus at 500 kbit/s. The simulated bus time follows micros(),
+so frame receive timestamps match the host time. The slave clocks run with an offset and a frequency error.
+A fourth node can hold back the frames of the master with bursts of higher priority frames.
+*/
+
+static const int32_t SLAVE_A_PPM = 200;
+static const int32_t SLAVE_B_PPM = -150;
+static const uint8_t BURST_FRAMES = 10;
+
+VirtualCANBus bus(500000);
+VirtualCANCore masterCore(bus), slaveACore(bus), slaveBCore(bus), burstCore(bus);
+CANInterface masterCAN, slaveACAN, slaveBCAN;
+CANTimeSync master, slaveA, slaveB;
+uint32_t lastPump = 0;
+
+/**
+ * @brief Module stub which records the master network time when its outputs are written.
+ */
+class RecordingModule : public CANTramModule {
+public:
+    String getHWType() const override { return "RecordingModule"; }
+    String getHWVersion() const override { return "1.0"; }
+    String getFWVersion() const override { return "1.0"; }
+    uint8_t getGPIODemand() const override { return 0; }
+    uint8_t getGPIOSupply() const override { return 0; }
+    bool provideGPIOs() override { return true; }
+    bool requestGPIOs() override { return true; }
+    bool provideHardwareResources() override { return true; }
+    bool requestHardwareResources() override { return true; }
+    bool addInterfaces() override { output.rename("Q1"); output.validate(); _interfaces[0] = &output; return true; }
+    bool initialize() override { return true; }
+    Interface** getInterfaces() override { return _interfaces; }
+    size_t getInterfaceCount() override { return 1; }
+    bool writeOutputs() override {
+        writtenAt = master.getNetworkTime();
+        writtenQ = output.getQ();
+        return true;
+    }
+
+    DigitalOutput output;
+    uint64_t writtenAt = 0;
+    uint16_t writtenQ = 0;
+private:
+    Interface* _interfaces[1];
+};
+
+RecordingModule moduleA, moduleB;
+
+uint32_t driftingClock(int32_t ppm, uint32_t offset){
+    int64_t now = micros();
+    return uint32_t(now + now * ppm / 1000000 + offset);
+}
+
+/**
+ * @brief Queue a burst of frames with a higher priority than SYNC and TIME as soon as the master queued a frame.
+ * @details Called before the bus is advanced, so the burst is queued at the same simulated time as the frame of the master and wins the arbitration.
+ */
+void queueBurst(){
+    if(!burstCore.isInitialized() || bus.pending(masterCore.getNode()) == 0 || bus.pending(burstCore.getNode()) > 0) return;
+    CANCore::CANMessage message = {};
+    message.id = 0x010;
+    message.length = 8;
+    for(uint8_t i=0; i<BURST_FRAMES; i++) burstCore.sendMessage(message);
+}
+
+void pump(){
+    queueBurst();
+    uint32_t now = micros();
+    bus.run(now - lastPump);
+    lastPump = now;
+    masterCAN.process();
+    slaveACAN.process();
+    slaveBCAN.process();
+}
+
+void pumpFor(uint32_t ms){
+    uint32_t start = millis();
+    while(millis() - start < ms){
+        pump();
+    }
+}
+
+//Runs before tests
+void setUp(){
+    CANInterface* interfaces[] = {&masterCAN, &slaveACAN, &slaveBCAN};
+    VirtualCANCore* cores[] = {&masterCore, &slaveACore, &slaveBCore};
+    for(uint8_t i=0; i<3; i++){
+        interfaces[i]->clearListeners();
+        cores[i]->end();
+        interfaces[i]->setCANCore(cores[i]);
+        interfaces[i]->begin();
+    }
+    slaveA.setClock([]() { return driftingClock(SLAVE_A_PPM, 123456789); });
+    slaveB.setClock([]() { return driftingClock(SLAVE_B_PPM, 4000000000UL); });   // Wraps after a few seconds
+    master.setSyncInterval(100);
+    slaveA.setSyncInterval(100);
+    slaveB.setSyncInterval(100);
+    slaveA.begin(&slaveACAN, CANTimeSync::SLAVE);
+    slaveB.begin(&slaveBCAN, CANTimeSync::SLAVE);
+    lastPump = micros();
+    master.begin(&masterCAN, CANTimeSync::MASTER);
+}
+
+//Runs after tests
+void tearDown(){
+    master.end();
+    slaveA.end();
+    slaveB.end();
+    burstCore.end();
+}
+
+void test_timesync_lock(){
+    DEBUG_PRINTLN("TEST: test_timesync_lock");
+    TEST_ASSERT_FALSE(slaveA.isSynchronized());
+    pumpFor(50);
+    TEST_ASSERT_TRUE(slaveA.isSynchronized());
+    TEST_ASSERT_TRUE(slaveB.isSynchronized());
+    TEST_ASSERT_EQUAL(1, slaveA.getStatistics().steps);
+
+    //First sample steps the clock to the master time
+    int64_t offset = int64_t(slaveA.getNetworkTime() - master.getNetworkTime());
+    TEST_ASSERT_INT32_WITHIN(1000, 0, int32_t(offset));
+
+    //Frequency error is learned from the following samples
+    pumpFor(2000);
+    TEST_ASSERT_EQUAL(1, slaveA.getStatistics().steps);
+    TEST_ASSERT_EQUAL(0, slaveA.getStatistics().lostSyncs);
+    TEST_ASSERT_INT32_WITHIN(50000, -SLAVE_A_PPM * 1000, slaveA.getStatistics().ratePpb);
+    TEST_ASSERT_INT32_WITHIN(50000, -SLAVE_B_PPM * 1000, slaveB.getStatistics().ratePpb);
+
+    //Loss of the master
+    master.end();
+    pumpFor(350);
+    TEST_ASSERT_FALSE(slaveA.isSynchronized());
+}
+
+void test_timesync_scheduled_outputs(){
+    DEBUG_PRINTLN("TEST: test_timesync_scheduled_outputs");
+    moduleA.attachModule(10, 0);
+    moduleB.attachModule(11, 0);
+    moduleA.writtenAt = 0;
+    moduleB.writtenAt = 0;
+    pumpFor(1000);
+    TEST_ASSERT_TRUE(slaveA.isSynchronized());
+
+    uint64_t switchTime = master.getNetworkTime() + 50000;
+    TEST_ASSERT_TRUE(slaveA.scheduleOutput(&moduleA.output, 1, switchTime, &moduleA));
+    TEST_ASSERT_TRUE(slaveB.scheduleOutput(&moduleB.output, 1, switchTime, &moduleB));
+    TEST_ASSERT_TRUE(slaveB.scheduleOutput(&moduleB.output, 0, switchTime + 100000, &moduleB));
+    TEST_ASSERT_EQUAL(2, slaveB.getScheduledCount());
+    pumpFor(80);
+    TEST_ASSERT_EQUAL(1, moduleA.writtenQ);
+    TEST_ASSERT_EQUAL(1, moduleB.writtenQ);
+    TEST_ASSERT_EQUAL(1, slaveB.getScheduledCount());
+    TEST_ASSERT_INT32_WITHIN(1000, 0, int32_t(moduleA.writtenAt - switchTime));
+    TEST_ASSERT_INT32_WITHIN(1000, 0, int32_t(moduleB.writtenAt - switchTime));
+
+    slaveB.cancelOutputs(&moduleB.output);
+    TEST_ASSERT_EQUAL(0, slaveB.getScheduledCount());
+}
+
+void test_timesync_delayed_sync(){
+    DEBUG_PRINTLN("TEST: test_timesync_delayed_sync");
+    TEST_ASSERT_TRUE(burstCore.begin());
+    pumpFor(2000);
+    TEST_ASSERT_TRUE(slaveA.isSynchronized());
+    TEST_ASSERT_EQUAL(0, slaveA.getStatistics().lostSyncs);
+    //Every SYNC waits for a burst, the master time is taken at the end of the SYNC so the delay is not an offset
+    TEST_ASSERT_GREATER_THAN(2000, bus.getStatistics(masterCore.getNode()).maxLatencyUs);
+    uint32_t maxOffset = 0;
+    for(uint8_t i=0; i<50; i++){
+        pumpFor(10);
+        int64_t offset = int64_t(slaveA.getNetworkTime() - master.getNetworkTime());
+        uint32_t absOffset = offset < 0 ? -offset : offset;
+        if(absOffset > maxOffset) maxOffset = absOffset;
+    }
+    TEST_ASSERT_LESS_THAN(500, maxOffset);
+}
+
+void measure_timesync_accuracy(){
+    const uint16_t MEASUREMENTS = 200;
+    pumpFor(2000);
+    slaveA.resetStatistics();
+    slaveB.resetStatistics();
+    MeasurementArray<MEASUREMENTS> offsetsA;
+    MeasurementArray<MEASUREMENTS> skews;
+    for(uint16_t i=0; i<MEASUREMENTS; i++){
+        pumpFor(10);
+        int64_t a = int64_t(slaveA.getNetworkTime());
+        int64_t m = int64_t(master.getNetworkTime());
+        int64_t b = int64_t(slaveB.getNetworkTime());
+        offsetsA.addSample(a > m ? a - m : m - a);
+        skews.addSample(a > b ? a - b : b - a);
+    }
+    const CANTimeSync::Statistics& statistics = slaveA.getStatistics();
+    MEASUREMENT_PRINTLN("Time synchronization at 500 kbit/s, 100 ms sync interval, slave clocks +200 ppm and -150 ppm:");
+    MEASUREMENT_PRINTLN("  |Slave A - master|: avg " + String(offsetsA.getAverage()) + " us, max " + String(offsetsA.getMax()) + " us");
+    MEASUREMENT_PRINTLN("  |Slave A - slave B|: avg " + String(skews.getAverage()) + " us, max " + String(skews.getMax()) + " us");
+    MEASUREMENT_PRINTLN("  Slave A servo: last offset " + String(statistics.offsetUs) + " us, max " + String(statistics.maxOffsetUs) + " us, jitter "
+                        + String(statistics.jitterUs) + " us, rate " + String(statistics.ratePpb) + " ppb");
+    MEASUREMENT_PRINTLN("  Slave B servo: rate " + String(slaveB.getStatistics().ratePpb) + " ppb, jitter " + String(slaveB.getStatistics().jitterUs) + " us");
+    TEST_ASSERT_LESS_THAN(1000, offsetsA.getMax());
+    TEST_ASSERT_LESS_THAN(1000, skews.getMax());
+}
+
+//Run tests
+void setup(){
+    Serial.begin(115200);
+    delay(2000);
+    UNITY_BEGIN();
+    RUN_TEST(test_timesync_lock);
+    RUN_TEST(test_timesync_scheduled_outputs);
+    RUN_TEST(test_timesync_delayed_sync);
+    RUN_TEST(measure_timesync_accuracy);
+    UNITY_END();
+}
+
+void loop(){
+
+}
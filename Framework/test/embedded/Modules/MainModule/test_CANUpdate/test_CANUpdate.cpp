@@ -0,0 +1,203 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "Debug.h"
+#include "CANInterface.h"
+#include "CANUpdateClient.h"
+#include "CANUpdateServer.h"
+#include "VirtualCANBus.h"
+#include "VirtualCANCore.h"
+#include "../test/CANTramTestSetup.h"
+
+/*
+A client and a server node are connected by a simulated bus. The simulated bus time follows micros().
+The transfer into a file is measured on the host in test/native/test_CANUpdate.
+*/
+
+static const uint8_t NODE_ID = 5;
+static const uint32_t IMAGE_SIZE = 20000;
+static const uint32_t CAPACITY = 65536;
+
+/**
+ * @brief Update target in RAM with an active and a staging buffer.
+ */
+class MemoryTarget : public UpdateTarget {
+public:
+    bool begin(uint32_t size) override { _size = size; _written = 0; _finished = false; return size <= CAPACITY; }
+    bool write(uint32_t offset, const uint8_t* data, size_t length) override {
+        if(offset != _written || offset + length > _size) return false;
+        memcpy(&_buffers[_active ^ 1][offset], data, length);
+        _written += length;
+        return true;
+    }
+    bool finish() override { _finished = _written == _size; return _finished; }
+    bool activate() override {
+        if(!_finished) return false;
+        _active ^= 1;
+        _activeSize = _size;
+        _finished = false;
+        return true;
+    }
+    void abort() override { _finished = false; }
+    uint32_t getCapacity() const override { return CAPACITY; }
+
+    const uint8_t* getActive() const { return _buffers[_active]; }
+    uint32_t getActiveSize() const { return _activeSize; }
+
+private:
+    uint8_t _buffers[2][CAPACITY];
+    uint8_t _active = 0;
+    uint32_t _size = 0;
+    uint32_t _written = 0;
+    uint32_t _activeSize = 0;
+    bool _finished = false;
+};
+
+VirtualCANBus bus(500000);
+VirtualCANCore clientCore(bus), serverCore(bus);
+CANInterface clientCAN, serverCAN;
+CANUpdateServer server(NODE_ID);
+CANUpdateClient client;
+MemoryTarget firmware;
+uint8_t image[CAPACITY];
+uint32_t lastPump = 0;
+int16_t activatedType = -1;
+
+void pump(){
+    uint32_t now = micros();
+    bus.run(now - lastPump);
+    lastPump = now;
+    clientCAN.process();
+    serverCAN.process();
+}
+
+/**
+ * @brief Run a transfer until it is finished.
+ */
+CANUpdateClient::Result transfer(uint8_t type, uint32_t size, bool activate = true){
+    TEST_ASSERT_TRUE(client.start(NODE_ID, type, image, size, activate));
+    uint32_t start = millis();
+    while(client.isBusy() && millis() - start < 20000){
+        pump();
+    }
+    TEST_ASSERT_FALSE(client.isBusy());
+    return client.getResult();
+}
+
+void startBus(uint32_t bitrate){
+    CANInterface* interfaces[] = {&clientCAN, &serverCAN};
+    VirtualCANCore* cores[] = {&clientCore, &serverCore};
+    bus.setBitrate(bitrate);
+    for(uint8_t i=0; i<2; i++){
+        cores[i]->end();
+        cores[i]->setBaudrate(CANCore::Baudrate(bitrate));
+        interfaces[i]->setCANCore(cores[i]);
+        interfaces[i]->begin();
+    }
+    lastPump = micros();
+}
+
+//Runs before tests
+void setUp(){
+    client.end();
+    server.end();
+    clientCAN.clearListeners();
+    serverCAN.clearListeners();
+    startBus(500000);
+    server.setTarget(CANUpdate::IMAGE_FIRMWARE, &firmware);
+    server.setTarget(CANUpdate::IMAGE_CONFIGURATION, nullptr);
+    server.setActivateCallback([](uint8_t type) { activatedType = type; });
+    server.begin(&serverCAN);
+    client.begin(&clientCAN);
+    activatedType = -1;
+    uint32_t seed = 12345;
+    for(uint32_t i=0; i<CAPACITY; i++){
+        seed = seed * 1103515245 + 12345;
+        image[i] = seed >> 16;
+    }
+}
+
+//Runs after tests
+void tearDown(){
+}
+
+void test_update_crc(){
+    DEBUG_PRINTLN("TEST: test_update_crc");
+    const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, CANUpdate::crc32(check, 9));
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, CANUpdate::crc32(&check[4], 5, CANUpdate::crc32(check, 4)));
+}
+
+void test_update_transfer(){
+    DEBUG_PRINTLN("TEST: test_update_transfer");
+    //Without activation the active image is not touched
+    TEST_ASSERT_EQUAL(CANUpdateClient::RESULT_OK, transfer(CANUpdate::IMAGE_FIRMWARE, IMAGE_SIZE, false));
+    TEST_ASSERT_EQUAL(0, firmware.getActiveSize());
+    TEST_ASSERT_EQUAL(-1, activatedType);
+    TEST_ASSERT_EQUAL(IMAGE_SIZE, server.getReceivedBytes());
+
+    TEST_ASSERT_EQUAL(CANUpdateClient::RESULT_OK, transfer(CANUpdate::IMAGE_FIRMWARE, IMAGE_SIZE));
+    TEST_ASSERT_EQUAL(CANUpdate::IMAGE_FIRMWARE, activatedType);
+    TEST_ASSERT_EQUAL(IMAGE_SIZE, firmware.getActiveSize());
+    TEST_ASSERT_EQUAL_MEMORY(image, firmware.getActive(), IMAGE_SIZE);
+    TEST_ASSERT_EQUAL(IMAGE_SIZE, client.getAcknowledgedBytes());
+    TEST_ASSERT_EQUAL(0, client.getRepeatedBlocks());
+    TEST_ASSERT_FALSE(server.isBusy());
+}
+
+void test_update_lossy_bus(){
+    DEBUG_PRINTLN("TEST: test_update_lossy_bus");
+    bus.setRxLossRate(serverCore.getNode(), 5);
+    bus.setRxLossRate(clientCore.getNode(), 20);
+    bus.setTxErrorRate(clientCore.getNode(), 20);
+    TEST_ASSERT_EQUAL(CANUpdateClient::RESULT_OK, transfer(CANUpdate::IMAGE_FIRMWARE, IMAGE_SIZE));
+    TEST_ASSERT_GREATER_THAN(0, client.getRepeatedBlocks());
+    TEST_ASSERT_EQUAL(IMAGE_SIZE, firmware.getActiveSize());
+    TEST_ASSERT_EQUAL_MEMORY(image, firmware.getActive(), IMAGE_SIZE);
+}
+
+void test_update_rejected(){
+    DEBUG_PRINTLN("TEST: test_update_rejected");
+    TEST_ASSERT_EQUAL(CANUpdateClient::RESULT_REJECTED, transfer(CANUpdate::IMAGE_FIRMWARE, CAPACITY + 1));     // Rejected before any data is read
+    TEST_ASSERT_EQUAL(CANUpdate::STATUS_TOO_LARGE, client.getServerStatus());
+    TEST_ASSERT_EQUAL(CANUpdateClient::RESULT_REJECTED, transfer(CANUpdate::IMAGE_CONFIGURATION, 100));
+    TEST_ASSERT_EQUAL(CANUpdate::STATUS_NO_TARGET, client.getServerStatus());
+
+    //Aborted transfer leaves the active image untouched
+    uint32_t activeSize = firmware.getActiveSize();
+    TEST_ASSERT_TRUE(client.start(NODE_ID, CANUpdate::IMAGE_FIRMWARE, image, IMAGE_SIZE));
+    while(client.getAcknowledgedBytes() < IMAGE_SIZE / 2) pump();
+    client.abort();
+    uint32_t start = millis();
+    while(millis() - start < 20) pump();       // ABORT is queued behind the segments already sent
+    TEST_ASSERT_EQUAL(CANUpdateClient::RESULT_ABORTED, client.getResult());
+    TEST_ASSERT_FALSE(server.isBusy());
+    TEST_ASSERT_EQUAL(activeSize, firmware.getActiveSize());
+}
+
+void test_update_server_timeout(){
+    DEBUG_PRINTLN("TEST: test_update_server_timeout");
+    TEST_ASSERT_TRUE(client.start(NODE_ID, CANUpdate::IMAGE_FIRMWARE, image, IMAGE_SIZE));
+    while(client.getAcknowledgedBytes() == 0) pump();
+    client.end();           // Client disappears without ABORT
+    uint32_t start = millis();
+    while(server.isBusy() && millis() - start < 2 * CANUpdateServer::TIMEOUT_MS) pump();
+    TEST_ASSERT_FALSE(server.isBusy());
+    TEST_ASSERT_UINT32_WITHIN(50, CANUpdateServer::TIMEOUT_MS, millis() - start);
+}
+
+//Run tests
+void setup(){
+    Serial.begin(115200);
+    delay(2000);
+    UNITY_BEGIN();
+    RUN_TEST(test_update_crc);
+    RUN_TEST(test_update_transfer);
+    RUN_TEST(test_update_lossy_bus);
+    RUN_TEST(test_update_rejected);
+    RUN_TEST(test_update_server_timeout);
+    UNITY_END();
+}
+
+void loop(){
+
+}
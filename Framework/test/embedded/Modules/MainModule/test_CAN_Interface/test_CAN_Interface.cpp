@@ -96,6 +96,38 @@ void test_CANCore_read_message(){
 
 }
 
+void test_CANCore_bus_off_recovery(){
+    DEBUG_PRINTLN("TEST: test_CANCore_bus_off_recovery");
+    bool result = canCore.setBaudrate(CANCore::BR_500K);
+    TEST_ASSERT_TRUE(result);
+    result = canCore.setPins(CAN_TX, CAN_RX);
+    TEST_ASSERT_TRUE(result);
+    result = canCore.begin();
+    TEST_ASSERT_TRUE(result);
+    TEST_ASSERT_EQUAL(CANCore::STATUS_OK, canCore.getStatus());
+
+    INSTRUCTION_PRINTLN("Your participation is needed! Short CAN_H and CAN_L for a moment, then remove the short.");
+    CANCore::CANMessage message = {};
+    message.id = 0x123;
+    message.length = 8;
+    uint32_t startTime = millis();
+    while(canCore.getStatistics().busOffCount == 0 && millis() - startTime < 30000){
+        canCore.sendMessage(message);
+        delay(10);
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL(1, canCore.getStatistics().busOffCount);
+
+    //Wait for the automatic recovery
+    startTime = millis();
+    while(canCore.getStatus() == CANCore::STATUS_BUS_OFF && millis() - startTime < 30000){
+        delay(10);
+    }
+    const CANCore::Statistics& statistics = canCore.getStatistics();
+    MEASUREMENT_PRINTLN("Bus-off recovery took " + String(statistics.lastRecoveryMs) + " ms, bus errors: " + String(statistics.busErrors) + ", TX failed: " + String(statistics.txFailed));
+    TEST_ASSERT_NOT_EQUAL(CANCore::STATUS_BUS_OFF, canCore.getStatus());
+    TEST_ASSERT_TRUE(canCore.sendMessage(message));
+}
+
 /* Write a function for each test*/
 
 
@@ -108,6 +140,7 @@ void setup(){
     RUN_TEST(test_CANCore_begin_end);
     RUN_TEST(test_CANCore_send_message);
     RUN_TEST(test_CANCore_read_message);
+    RUN_TEST(test_CANCore_bus_off_recovery);
     //RUN_TEST(test_function);
     UNITY_END();
 }
@@ -0,0 +1,198 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "Debug.h"
+#include "CANInterface.h"
+#include "VirtualCANBus.h"
+#include "VirtualCANCore.h"
+#include "ISOTPTransport.h"
+#include "../test/CANTramTestSetup.h"
+
+/*
+Two nodes are connected by a simulated bus. Every pump() advances the bus until all queued frames are sent
+and lets both nodes read all received frames. A node queues at most one full transmit queue per cycle, so no receive queue overflows.
+*/
+
+VirtualCANBus bus(500000);
+VirtualCANCore coreA(bus), coreB(bus);
+CANInterface canA, canB;
+ISOTPTransport isotpA, isotpB;
+int8_t sessionA = -1, sessionB = -1;
+
+uint8_t txData[ISOTPTransport::MAX_PAYLOAD_SIZE];
+uint8_t rxData[ISOTPTransport::MAX_PAYLOAD_SIZE];
+ISOTPTransport::Result rxResult;
+ISOTPTransport::Result txResult;
+size_t rxLength = 0;
+uint8_t rxCount = 0;
+uint32_t processUs = 0;         // Time spent in process() of both nodes
+uint32_t busTimeUs = 0;         // Bus time of all transmitted frames, worst case stuffing
+
+void pump(){
+    size_t pending = bus.pending(coreA.getNode()) + bus.pending(coreB.getNode());
+    bus.run((pending > 0 ? pending : 1) * CANCore::getFrameDurationUs(8, false, CANCore::Baudrate(bus.getBitrate())));
+    uint32_t startTime = esp_timer_get_time();
+    while(canB.process() > 0);
+    while(canA.process() > 0);
+    processUs += esp_timer_get_time() - startTime;
+}
+
+bool transfer(size_t length){
+    rxCount = 0;
+    rxLength = 0;
+    if(!isotpA.send(sessionA, txData, length)) return false;
+    for(uint32_t i=0; i<100000 && (rxCount == 0 || isotpA.isSending(sessionA)); i++){
+        pump();
+    }
+    return !isotpA.isSending(sessionA) && rxCount == 1;
+}
+
+uint32_t sentCount(VirtualCANCore& core){
+    return bus.getStatistics(core.getNode()).txFrames;
+}
+
+/**
+ * @brief Restart both nodes at the given bitrate.
+ */
+void restartBus(CANCore::Baudrate baudrate){
+    coreA.end();
+    coreB.end();
+    bus.setBitrate(baudrate);
+    coreA.setBaudrate(baudrate);
+    coreB.setBaudrate(baudrate);
+    canA.begin();
+    canB.begin();
+}
+
+//Runs before tests
+void setUp(){
+    canA.setCANCore(&coreA);
+    canB.setCANCore(&coreB);
+    restartBus(CANCore::BR_500K);
+    bus.setTransmitCallback([](uint8_t node, const CANFrame& frame, uint64_t queuedUs, uint64_t doneUs) {
+        busTimeUs += CANCore::getFrameDurationUs(frame.getLength(), frame.isExtended(), CANCore::Baudrate(bus.getBitrate()));
+    });
+    isotpA.begin(&canA);
+    isotpB.begin(&canB);
+    sessionA = isotpA.openSession(0x7E0, 0x7E8);
+    sessionB = isotpB.openSession(0x7E8, 0x7E0);
+    isotpB.setReceiveBuffer(sessionB, rxData, sizeof(rxData));
+    isotpA.setFlowControl(0, 0);
+    isotpB.setFlowControl(0, 0);
+    isotpA.setTransmitCallback([](uint8_t session, ISOTPTransport::Result result) { txResult = result; });
+    isotpB.setReceiveCallback([](uint8_t session, ISOTPTransport::Result result, const uint8_t* data, size_t length) {
+        rxResult = result;
+        rxLength = length;
+        rxCount++;
+    });
+    for(size_t i=0; i<sizeof(txData); i++) txData[i] = (i * 31 + 7) & 0xFF;
+    memset(rxData, 0, sizeof(rxData));
+    rxCount = 0;
+}
+
+//Runs after tests
+void tearDown(){
+    isotpA.closeSession(sessionA);
+    isotpB.closeSession(sessionB);
+    isotpA.end();
+    isotpB.end();
+    bus.setTransmitCallback(nullptr);
+}
+
+void test_isotp_single_frame(){
+    DEBUG_PRINTLN("TEST: test_isotp_single_frame");
+    TEST_ASSERT_TRUE(transfer(7));
+    TEST_ASSERT_EQUAL(ISOTPTransport::RESULT_OK, rxResult);
+    TEST_ASSERT_EQUAL(7, rxLength);
+    TEST_ASSERT_EQUAL(1, sentCount(coreA));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(txData, rxData, 7);
+}
+
+void test_isotp_segmented_transfer(){
+    DEBUG_PRINTLN("TEST: test_isotp_segmented_transfer");
+    isotpB.setFlowControl(4, 0);
+    TEST_ASSERT_TRUE(transfer(100));
+    TEST_ASSERT_EQUAL(ISOTPTransport::RESULT_OK, txResult);
+    TEST_ASSERT_EQUAL(ISOTPTransport::RESULT_OK, rxResult);
+    TEST_ASSERT_EQUAL(100, rxLength);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(txData, rxData, 100);
+    //FF + 14 CF sent by A, FC after FF and after every 4th CF sent by B
+    TEST_ASSERT_EQUAL(15, sentCount(coreA));
+    TEST_ASSERT_EQUAL(4, sentCount(coreB));
+}
+
+void test_isotp_receive_overflow(){
+    DEBUG_PRINTLN("TEST: test_isotp_receive_overflow");
+    isotpB.setReceiveBuffer(sessionB, rxData, 50);
+    transfer(100);
+    TEST_ASSERT_EQUAL(1, rxCount);
+    TEST_ASSERT_EQUAL(ISOTPTransport::RESULT_OVERFLOW, txResult);
+    TEST_ASSERT_EQUAL(ISOTPTransport::RESULT_OVERFLOW, rxResult);
+    TEST_ASSERT_FALSE(isotpA.isSending(sessionA));
+}
+
+void test_isotp_concurrent_sessions(){
+    DEBUG_PRINTLN("TEST: test_isotp_concurrent_sessions");
+    static uint8_t rxSecond[200];
+    int8_t secondA = isotpA.openSession(0x7E1, 0x7E9);
+    int8_t secondB = isotpB.openSession(0x7E9, 0x7E1);
+    TEST_ASSERT_NOT_EQUAL(-1, secondA);
+    TEST_ASSERT_NOT_EQUAL(-1, secondB);
+    TEST_ASSERT_TRUE(isotpB.setReceiveBuffer(secondB, rxSecond, sizeof(rxSecond)));
+
+    TEST_ASSERT_TRUE(isotpA.send(sessionA, txData, 300));
+    TEST_ASSERT_TRUE(isotpA.send(secondA, &txData[300], 200));
+    TEST_ASSERT_FALSE(isotpA.send(secondA, txData, 10)); //Busy
+    for(uint16_t i=0; i<1000 && rxCount < 2; i++){
+        pump();
+    }
+    TEST_ASSERT_EQUAL(2, rxCount);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(txData, rxData, 300);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&txData[300], rxSecond, 200);
+    isotpA.closeSession(secondA);
+    isotpB.closeSession(secondB);
+}
+
+void measure_isotp_throughput(){
+    const CANCore::Baudrate baudrates[] = {CANCore::BR_125K, CANCore::BR_250K, CANCore::BR_500K, CANCore::BR_1M};
+    const uint8_t blockSizes[] = {0, 8};
+    const uint16_t MEASUREMENTS = 10;
+    const size_t length = ISOTPTransport::MAX_PAYLOAD_SIZE;
+
+    for(CANCore::Baudrate baudrate : baudrates){
+        restartBus(baudrate);
+        for(uint8_t blockSize : blockSizes){
+            isotpB.setFlowControl(blockSize, 0);
+            MeasurementArray<MEASUREMENTS> durations;
+            busTimeUs = 0;
+            for(uint16_t i=0; i<MEASUREMENTS; i++){
+                processUs = 0;
+                TEST_ASSERT_TRUE(transfer(length));
+                durations.addSample(processUs);
+            }
+            TEST_ASSERT_EQUAL_UINT8_ARRAY(txData, rxData, length);
+            uint32_t transferBusTimeUs = busTimeUs / MEASUREMENTS;
+            MEASUREMENT_PRINTLN("ISO-TP transfer of " + String(length) + " bytes at " + String(baudrate / 1000) + " kbit/s, BS " + String(blockSize) + ":");
+            MEASUREMENT_PRINTLN("  Bus time (worst case stuffing): " + String(transferBusTimeUs) + " us");
+            MEASUREMENT_PRINTLN("  Throughput: " + String(uint32_t(uint64_t(length) * 1000000 / transferBusTimeUs)) + " bytes/s");
+            MEASUREMENT_PRINTLN("  Processing time: avg " + String(durations.getAverage()) + " us, max " + String(durations.getMax()) + " us");
+            TEST_ASSERT_LESS_THAN(transferBusTimeUs, durations.getMax()); // Processing must be faster than the bus
+        }
+    }
+}
+
+//Run tests
+void setup(){
+    Serial.begin(115200);
+    delay(2000);
+    UNITY_BEGIN();
+    RUN_TEST(test_isotp_single_frame);
+    RUN_TEST(test_isotp_segmented_transfer);
+    RUN_TEST(test_isotp_receive_overflow);
+    RUN_TEST(test_isotp_concurrent_sessions);
+    RUN_TEST(measure_isotp_throughput);
+    UNITY_END();
+}
+
+void loop(){
+
+}
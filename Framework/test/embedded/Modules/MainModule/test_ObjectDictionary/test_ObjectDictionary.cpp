@@ -0,0 +1,201 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "Debug.h"
+#include "CANInterface.h"
+#include "VirtualCANBus.h"
+#include "VirtualCANCore.h"
+#include "ObjectDictionary.h"
+#include "SDOServer.h"
+#include "DigitalOutput.h"
+#include "DigitalInput.h"
+#include "../test/CANTramTestSetup.h"
+
+/*
+The SDO server and a test client are connected by a simulated bus at 500 kbit/s.
+*/
+
+static constexpr size_t ENTRY_COUNT = 1024;
+ObjectDictionary::Entry entries[ENTRY_COUNT + 8];
+ObjectDictionary od(entries, ENTRY_COUNT + 8);
+VirtualCANBus bus(500000);
+VirtualCANCore serverCore(bus), clientCore(bus);
+CANInterface canInterface;
+CANCore::CANMessage response = {};
+SDOServer sdoServer(&od, 5);
+DigitalOutput output;
+DigitalInput input;
+
+CANCore::CANMessage sdoRequest(uint8_t command, uint16_t index, uint8_t subIndex, uint32_t value = 0){
+    CANCore::CANMessage message = {};
+    message.id = SDOServer::COB_ID_REQUEST + 5;
+    message.length = 8;
+    message.data[0] = command;
+    message.data[1] = index & 0xFF;
+    message.data[2] = index >> 8;
+    message.data[3] = subIndex;
+    for(uint8_t i=0; i<4; i++) message.data[4 + i] = (value >> (8 * i)) & 0xFF;
+    return message;
+}
+
+/**
+ * @brief Send a request from the client, let the server process it and read the last response.
+ * @return true if the server responded.
+ */
+bool transfer(const CANCore::CANMessage& request){
+    response = {};
+    if(!clientCore.sendMessage(request)) return false;
+    bus.run(1000);
+    canInterface.process();
+    bus.run(1000);
+    bool received = false;
+    while(clientCore.available() > 0) received |= clientCore.readMessage(response);
+    return received;
+}
+
+uint32_t responseValue(){
+    const uint8_t* data = response.data;
+    return data[4] | (uint32_t(data[5]) << 8) | (uint32_t(data[6]) << 16) | (uint32_t(data[7]) << 24);
+}
+
+//Runs before tests
+void setUp(){
+    od.clear();
+    canInterface.clearListeners();
+    serverCore.end();
+    clientCore.end();
+    canInterface.setCANCore(&serverCore);
+    canInterface.begin();
+    clientCore.begin();
+    output.setQ(0);
+    input.setQ(1);
+
+    //Fill dictionary in reverse order to make sure sorting is required
+    for(size_t i=ENTRY_COUNT; i>0; i--){
+        uint32_t value = i - 1;
+        od.addU32(0x3000 + (value >> 8), value & 0xFF, ObjectDictionary::ACCESS_RO, [value]() { return value; });
+    }
+    od.addInterface(0x2000, 1, &output);
+    od.addInterface(0x2000, 2, &input);
+}
+
+//Runs after tests
+void tearDown(){
+    sdoServer.end();
+}
+
+void test_od_find_entries(){
+    DEBUG_PRINTLN("TEST: test_od_find_entries");
+    TEST_ASSERT_NULL(od.find(0x3000, 0)); //Not sealed yet
+    TEST_ASSERT_TRUE(od.seal());
+    TEST_ASSERT_EQUAL(ENTRY_COUNT + 2, od.size());
+
+    for(uint32_t i=0; i<ENTRY_COUNT; i++){
+        const ObjectDictionary::Entry* entry = od.find(0x3000 + (i >> 8), i & 0xFF);
+        TEST_ASSERT_NOT_NULL(entry);
+        uint8_t buffer[4];
+        size_t length = 0;
+        TEST_ASSERT_EQUAL(ObjectDictionary::ABORT_OK, od.read(entry, buffer, sizeof(buffer), length));
+        TEST_ASSERT_EQUAL(4, length);
+        TEST_ASSERT_EQUAL_UINT32(i, buffer[0] | (uint32_t(buffer[1]) << 8) | (uint32_t(buffer[2]) << 16) | (uint32_t(buffer[3]) << 24));
+    }
+    TEST_ASSERT_NULL(od.find(0x3FFF, 0));
+    TEST_ASSERT_TRUE(od.hasIndex(0x2000));
+    TEST_ASSERT_FALSE(od.hasIndex(0x2001));
+}
+
+void test_od_sealed_rejects_entries(){
+    DEBUG_PRINTLN("TEST: test_od_sealed_rejects_entries");
+    TEST_ASSERT_TRUE(od.seal());
+    TEST_ASSERT_FALSE(od.addInterface(0x2000, 3, &output));
+}
+
+void test_od_access_rights(){
+    DEBUG_PRINTLN("TEST: test_od_access_rights");
+    od.seal();
+    uint8_t value[2] = {1, 0};
+    TEST_ASSERT_EQUAL(ObjectDictionary::ABORT_OK, od.write(od.find(0x2000, 1), value, 2));
+    TEST_ASSERT_EQUAL(1, output.getQ());
+    TEST_ASSERT_EQUAL(ObjectDictionary::ABORT_READ_ONLY, od.write(od.find(0x2000, 2), value, 2));
+    TEST_ASSERT_EQUAL(ObjectDictionary::ABORT_LENGTH_MISMATCH, od.write(od.find(0x2000, 1), value, 1));
+    value[0] = 2;
+    TEST_ASSERT_EQUAL(ObjectDictionary::ABORT_VALUE_RANGE, od.write(od.find(0x2000, 1), value, 2));
+}
+
+void test_sdo_expedited_transfer(){
+    DEBUG_PRINTLN("TEST: test_sdo_expedited_transfer");
+    od.seal();
+    TEST_ASSERT_TRUE(sdoServer.begin(&canInterface));
+
+    //Expedited download of 2 bytes
+    TEST_ASSERT_TRUE(transfer(sdoRequest(0x2B, 0x2000, 1, 1)));
+    TEST_ASSERT_EQUAL_HEX32(SDOServer::COB_ID_RESPONSE + 5, response.id);
+    TEST_ASSERT_EQUAL_HEX8(0x60, response.data[0]);
+    TEST_ASSERT_EQUAL(1, output.getQ());
+
+    //Expedited upload of 4 bytes
+    TEST_ASSERT_TRUE(transfer(sdoRequest(0x40, 0x3002, 0x10)));
+    TEST_ASSERT_EQUAL_HEX8(0x43, response.data[0]);
+    TEST_ASSERT_EQUAL_UINT32(0x210, responseValue());
+
+    //Missing object
+    TEST_ASSERT_TRUE(transfer(sdoRequest(0x40, 0x4000, 0)));
+    TEST_ASSERT_EQUAL_HEX8(0x80, response.data[0]);
+    TEST_ASSERT_EQUAL_HEX32(ObjectDictionary::ABORT_NO_OBJECT, responseValue());
+}
+
+void test_sdo_empty_upload(){
+    DEBUG_PRINTLN("TEST: test_sdo_empty_upload");
+    od.addEntry(0x2001, 0, ObjectDictionary::VISIBLE_STRING, ObjectDictionary::ACCESS_RO, [](uint8_t*, size_t) { return size_t(0); });
+    od.seal();
+    TEST_ASSERT_TRUE(sdoServer.begin(&canInterface));
+
+    //Segmented upload of size 0 with one empty last segment
+    TEST_ASSERT_TRUE(transfer(sdoRequest(0x40, 0x2001, 0)));
+    TEST_ASSERT_EQUAL_HEX8(0x41, response.data[0]);
+    TEST_ASSERT_EQUAL_UINT32(0, responseValue());
+    TEST_ASSERT_TRUE(transfer(sdoRequest(0x60, 0, 0)));
+    TEST_ASSERT_EQUAL_HEX8(0x0F, response.data[0]);
+}
+
+void measure_od_lookup_duration(){
+    od.seal();
+    const uint16_t MEASUREMENTS = 100;
+    const uint16_t LOOKUPS = 1000;
+    MeasurementArray<MEASUREMENTS> durations;
+    volatile uint32_t found = 0;
+
+    for(uint16_t i=0; i<MEASUREMENTS; i++){
+        uint32_t startTime = esp_timer_get_time();
+        for(uint16_t j=0; j<LOOKUPS; j++){
+            uint32_t key = (j * 613) % ENTRY_COUNT;
+            if(od.find(0x3000 + (key >> 8), key & 0xFF)) found++;
+        }
+        uint32_t endTime = esp_timer_get_time();
+        durations.addSample(endTime - startTime);
+    }
+
+    MEASUREMENT_PRINTLN("Measured " + String(LOOKUPS) + " lookups in a dictionary with " + String(od.size()) + " entries over " + String(MEASUREMENTS) + " runs:");
+    MEASUREMENT_PRINTLN("  Average duration: " + String(durations.getAverage()) + " us");
+    MEASUREMENT_PRINTLN("  Max duration: " + String(durations.getMax()) + " us");
+    MEASUREMENT_PRINTLN("  Min duration: " + String(durations.getMin()) + " us");
+    TEST_ASSERT_EQUAL(MEASUREMENTS * LOOKUPS, found);
+    TEST_ASSERT_LESS_OR_EQUAL(2000, durations.getMax()); // Ensure a single lookup takes less than 2us
+}
+
+//Run tests
+void setup(){
+    Serial.begin(115200);
+    delay(2000);
+    UNITY_BEGIN();
+    RUN_TEST(test_od_find_entries);
+    RUN_TEST(test_od_sealed_rejects_entries);
+    RUN_TEST(test_od_access_rights);
+    RUN_TEST(test_sdo_expedited_transfer);
+    RUN_TEST(test_sdo_empty_upload);
+    RUN_TEST(measure_od_lookup_duration);
+    UNITY_END();
+}
+
+void loop(){
+
+}
@@ -0,0 +1,252 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "Debug.h"
+#include "CANInterface.h"
+#include "VirtualCANBus.h"
+#include "VirtualCANCore.h"
+#include "RemoteIOServer.h"
+#include "RemoteModule.h"
+#include "../test/CANTramTestSetup.h"
+
+/*
+The server node and the controller node are connected by a simulated bus at 500 kbit/s.
+Every pump() advances the bus by 1 ms and processes both nodes once.
+*/
+
+static const uint8_t NODE_ID = 5;
+
+VirtualCANBus bus(500000);
+VirtualCANCore serverCore(bus), proxyCore(bus);
+CANInterface serverCAN, proxyCAN;
+RemoteIOServer server(NODE_ID);
+RemoteModule proxy(NODE_ID, 10, 4, 6, 2);
+
+DigitalInput serverDI[10];
+AnalogInput serverAI[4] = {AnalogInput(Interface::RES_16BIT), AnalogInput(Interface::RES_16BIT), AnalogInput(Interface::RES_16BIT), AnalogInput(Interface::RES_16BIT)};
+DigitalOutput serverDQ[6];
+AnalogOutput serverAQ[2];
+
+void pump(uint32_t count = 1){
+    for(uint32_t i=0; i<count; i++){
+        proxy.cycle(nullptr);
+        bus.run(500);
+        serverCAN.process();
+        bus.run(500);
+        proxyCAN.process();
+    }
+}
+
+/**
+ * @brief Pump until the given time in milliseconds has passed.
+ */
+void pumpFor(uint32_t ms){
+    uint32_t start = millis();
+    while(millis() - start < ms){
+        pump();
+        delayMicroseconds(200);
+    }
+}
+
+Interface* findProxyInterface(const String& name){
+    Interface** interfaces = proxy.getInterfaces();
+    for(size_t i=0; i<proxy.getInterfaceCount(); i++){
+        if(interfaces[i]->getName() == name) return interfaces[i];
+    }
+    return nullptr;
+}
+
+//Runs before tests
+void setUp(){
+    proxy.end();
+    server.end();
+    serverCore.end();
+    proxyCore.end();
+    serverCAN.setCANCore(&serverCore);
+    proxyCAN.setCANCore(&proxyCore);
+    serverCAN.begin();
+    proxyCAN.begin();
+
+    server.clear();
+    for(DigitalInput& di : serverDI) { di.setQ(0); server.addInterface(&di); }
+    for(AnalogInput& ai : serverAI) { ai.setQ(0); server.addInterface(&ai); }
+    for(DigitalOutput& dq : serverDQ) { dq.setQ(0); server.addInterface(&dq); }
+    for(AnalogOutput& aq : serverAQ) { aq.setQ(0); server.addInterface(&aq); }
+    server.setRefreshInterval(100);
+    server.setOutputTimeout(500);
+    server.setInhibitTime(0);
+    proxy.attachModule(5, 0);
+    proxy.setRefreshInterval(100);
+    proxy.setStaleTimeout(300);
+    proxy.setInhibitTime(0);
+    server.begin(&serverCAN);
+    proxy.begin(&proxyCAN);
+    proxy.resetStatistics();
+}
+
+//Runs after tests
+void tearDown(){
+
+}
+
+void test_remote_inputs_mirrored(){
+    DEBUG_PRINTLN("TEST: test_remote_inputs_mirrored");
+    TEST_ASSERT_EQUAL(22, proxy.getInterfaceCount());
+    TEST_ASSERT_FALSE(proxy.isOnline());
+    pump(5);
+    TEST_ASSERT_TRUE(proxy.isLayoutValid());
+    TEST_ASSERT_TRUE(proxy.isOnline());
+    TEST_ASSERT_TRUE(findProxyInterface("I1")->isValid());
+
+    serverDI[3].setQ(1);
+    serverDI[9].setQ(1);
+    serverAI[2].setQ(40000);
+    pump(3);
+    TEST_ASSERT_EQUAL(Interface::DIGITAL_INPUT, findProxyInterface("I4")->getType());
+    TEST_ASSERT_EQUAL(1, findProxyInterface("I4")->getQ());
+    TEST_ASSERT_EQUAL(1, findProxyInterface("I10")->getQ());
+    TEST_ASSERT_EQUAL(0, findProxyInterface("I5")->getQ());
+    TEST_ASSERT_EQUAL(40000, findProxyInterface("AI3")->getQ());
+    TEST_ASSERT_EQUAL(0, proxy.getStatistics().lostFrames);
+}
+
+void test_remote_outputs_batched(){
+    DEBUG_PRINTLN("TEST: test_remote_outputs_batched");
+    proxy.setRefreshInterval(10000);
+    pump(5);
+    TEST_ASSERT_TRUE(proxy.isLayoutValid());
+
+    //Unchanged outputs are not sent
+    uint32_t sent = proxy.getStatistics().framesSent;
+    pump(5);
+    TEST_ASSERT_EQUAL(sent, proxy.getStatistics().framesSent);
+
+    //Three changes in two groups are sent in one digital and one analog block
+    findProxyInterface("Q2")->setQ(1);
+    findProxyInterface("Q6")->setQ(1);
+    findProxyInterface("AQ2")->setQ(1234);
+    uint32_t acknowledged = proxy.getStatistics().acknowledged;
+    pump(3);
+    TEST_ASSERT_EQUAL(sent + 2, proxy.getStatistics().framesSent);
+    TEST_ASSERT_EQUAL(acknowledged + 2, proxy.getStatistics().acknowledged);
+    TEST_ASSERT_EQUAL(0, serverDQ[0].getQ());
+    TEST_ASSERT_EQUAL(1, serverDQ[1].getQ());
+    TEST_ASSERT_EQUAL(1, serverDQ[5].getQ());
+    TEST_ASSERT_EQUAL(1234, serverAQ[1].getQ());
+}
+
+void test_remote_layout_mismatch(){
+    DEBUG_PRINTLN("TEST: test_remote_layout_mismatch");
+    static RemoteModule wrongProxy(NODE_ID, 10, 4, 8, 2);
+    wrongProxy.attachModule(6, 0);
+    proxy.end();
+    TEST_ASSERT_TRUE(wrongProxy.begin(&proxyCAN));
+    for(uint8_t i=0; i<5; i++){
+        wrongProxy.cycle(nullptr);
+        bus.run(1000);
+        serverCAN.process();
+        bus.run(1000);
+        proxyCAN.process();
+    }
+    TEST_ASSERT_FALSE(wrongProxy.isLayoutValid());
+    TEST_ASSERT_FALSE(wrongProxy.isOnline());
+    TEST_ASSERT_EQUAL(1, wrongProxy.getStatistics().framesSent);       // Only the layout request
+    wrongProxy.end();
+
+    //A confirmed layout which changes later takes the proxy offline until the next layout request
+    proxy.setRefreshInterval(10000);
+    TEST_ASSERT_TRUE(proxy.begin(&proxyCAN));
+    pump(5);
+    TEST_ASSERT_TRUE(proxy.isOnline());
+    CANCore::CANMessage layout = {};
+    layout.id = RemoteIO::COB_ID_INPUTS + NODE_ID;
+    layout.length = 6;
+    uint8_t changed[6] = {RemoteIO::CMD_LAYOUT, 0, 10, 4, 8, 2};
+    memcpy(layout.data, changed, 6);
+    TEST_ASSERT_TRUE(serverCAN.sendMessage(layout));
+    pump(3);
+    TEST_ASSERT_FALSE(proxy.isLayoutValid());
+    TEST_ASSERT_FALSE(proxy.isOnline());
+    TEST_ASSERT_FALSE(findProxyInterface("I1")->isValid());
+}
+
+void test_remote_stale_and_failsafe(){
+    DEBUG_PRINTLN("TEST: test_remote_stale_and_failsafe");
+    server.setOutputTimeout(200);
+    pump(5);
+    findProxyInterface("Q1")->setQ(1);
+    pump(3);
+    TEST_ASSERT_EQUAL(1, serverDQ[0].getQ());
+    TEST_ASSERT_TRUE(proxy.isOnline());
+
+    //Link loss in both directions
+    bus.setRxLossRate(serverCore.getNode(), 1000);
+    bus.setRxLossRate(proxyCore.getNode(), 1000);
+    pumpFor(400);
+    TEST_ASSERT_FALSE(proxy.isOnline());
+    TEST_ASSERT_FALSE(findProxyInterface("I1")->isValid());
+    TEST_ASSERT_EQUAL(1, proxy.getStatistics().staleCount);
+    TEST_ASSERT_GREATER_OR_EQUAL(300, proxy.getInputAge());
+    TEST_ASSERT_EQUAL(0, serverDQ[0].getQ());                   // Failsafe
+    TEST_ASSERT_EQUAL(1, server.getStatistics().outputTimeouts);
+
+    //Recovery with the next refresh
+    bus.setRxLossRate(serverCore.getNode(), 0);
+    bus.setRxLossRate(proxyCore.getNode(), 0);
+    pumpFor(150);
+    TEST_ASSERT_TRUE(proxy.isOnline());
+    TEST_ASSERT_TRUE(findProxyInterface("I1")->isValid());
+    TEST_ASSERT_EQUAL(1, serverDQ[0].getQ());
+    TEST_ASSERT_GREATER_THAN(0, proxy.getStatistics().lostFrames);
+}
+
+void measure_remote_latency(){
+    const uint16_t MEASUREMENTS = 200;
+    proxy.setRefreshInterval(10000);
+    pump(5);
+    TEST_ASSERT_TRUE(proxy.isOnline());
+
+    //Output: local write until applied at the server, in bus time
+    MeasurementArray<MEASUREMENTS> outputBusTimes;
+    MeasurementArray<MEASUREMENTS> inputBusTimes;
+    Interface* q = findProxyInterface("Q3");
+    Interface* in = findProxyInterface("I7");
+    for(uint16_t i=0; i<MEASUREMENTS; i++){
+        uint16_t value = (i & 1) ? 0 : 1;
+        q->setQ(value);
+        uint64_t start = bus.now();
+        while(serverDQ[2].getQ() != value && bus.now() - start < 100000) pump();
+        outputBusTimes.addSample(bus.now() - start);
+
+        serverDI[6].setQ(value);
+        start = bus.now();
+        while(in->getQ() != value && bus.now() - start < 100000) pump();
+        inputBusTimes.addSample(bus.now() - start);
+    }
+    const RemoteModule::Statistics& statistics = proxy.getStatistics();
+    MEASUREMENT_PRINTLN("Remote I/O at 500 kbit/s, 1 ms process cycle:");
+    MEASUREMENT_PRINTLN("  Output write to server: avg " + String(outputBusTimes.getAverage()) + " us, max " + String(outputBusTimes.getMax()) + " us bus time");
+    MEASUREMENT_PRINTLN("  Server input to proxy: avg " + String(inputBusTimes.getAverage()) + " us, max " + String(inputBusTimes.getMax()) + " us bus time");
+    MEASUREMENT_PRINTLN("  Acknowledge latency (host time): min " + String(statistics.minOutputLatencyUs) + " us, avg " + String(proxy.getAverageOutputLatency())
+                        + " us, max " + String(statistics.maxOutputLatencyUs) + " us");
+    MEASUREMENT_PRINTLN("  Frames sent " + String(statistics.framesSent) + ", received " + String(statistics.framesReceived) + ", lost " + String(statistics.lostFrames));
+    TEST_ASSERT_EQUAL(0, statistics.lostFrames);
+    TEST_ASSERT_LESS_OR_EQUAL(2000, outputBusTimes.getMax());   // Within two process cycles
+    TEST_ASSERT_LESS_OR_EQUAL(2000, inputBusTimes.getMax());
+}
+
+//Run tests
+void setup(){
+    Serial.begin(115200);
+    delay(2000);
+    UNITY_BEGIN();
+    RUN_TEST(test_remote_inputs_mirrored);
+    RUN_TEST(test_remote_outputs_batched);
+    RUN_TEST(test_remote_layout_mismatch);
+    RUN_TEST(test_remote_stale_and_failsafe);
+    RUN_TEST(measure_remote_latency);
+    UNITY_END();
+}
+
+void loop(){
+
+}
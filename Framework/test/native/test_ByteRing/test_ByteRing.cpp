@@ -0,0 +1,143 @@
+#include <unity.h>
+#include <stdio.h>
+#include <thread>
+#include <chrono>
+#include "ByteRing.h"
+
+/*
+Host tests for the lock-free byte ring used by the UART receive path. Run with the PlatformIO native environment.
+*/
+
+static constexpr size_t RING_SIZE = 256;
+static constexpr uint32_t STRESS_BYTES = 20000000;
+
+uint8_t sequenceByte(uint32_t position){
+    return uint8_t(position ^ (position >> 8) ^ (position >> 16));
+}
+
+/**
+ * @brief Back off while the ring is full or empty.
+ * @details Spins briefly, then sleeps so the peer thread also makes progress on hosts with a single CPU.
+ */
+void backoff(uint32_t& spins){
+    if(++spins < 100){
+        std::this_thread::yield();
+        return;
+    }
+    spins = 0;
+    std::this_thread::sleep_for(std::chrono::microseconds(10));
+}
+
+//Runs before tests
+void setUp(){
+
+}
+
+//Runs after tests
+void tearDown(){
+
+}
+
+void test_byte_ring_fill_and_wrap(){
+    static ByteRing<RING_SIZE> ring;
+    uint8_t buffer[RING_SIZE * 2];
+    TEST_ASSERT_TRUE(ring.empty());
+    TEST_ASSERT_EQUAL(0, ring.read(buffer, sizeof(buffer)));
+
+    uint32_t written = 0;
+    uint32_t read = 0;
+    for(uint8_t round=0; round<10; round++){
+        //Fill in chunks, the last chunk is cut at the free space
+        while(ring.free() > 0){
+            uint8_t chunk[37];
+            for(uint8_t i=0; i<sizeof(chunk); i++) chunk[i] = sequenceByte(written + i);
+            written += ring.write(chunk, sizeof(chunk));
+        }
+        TEST_ASSERT_EQUAL(RING_SIZE, ring.size());
+        TEST_ASSERT_EQUAL(0, ring.write(buffer, 1));
+
+        //Remove part of the bytes so head and tail wrap at different positions
+        size_t length = ring.read(buffer, RING_SIZE / 2 + 13 * round);
+        TEST_ASSERT_EQUAL(RING_SIZE / 2 + 13 * round, length);
+        for(size_t i=0; i<length; i++) TEST_ASSERT_EQUAL_HEX8(sequenceByte(read++), buffer[i]);
+    }
+    size_t length = ring.read(buffer, sizeof(buffer));
+    for(size_t i=0; i<length; i++) TEST_ASSERT_EQUAL_HEX8(sequenceByte(read++), buffer[i]);
+    TEST_ASSERT_EQUAL(written, read);
+    TEST_ASSERT_TRUE(ring.empty());
+}
+
+void test_byte_ring_peek_consume(){
+    static ByteRing<RING_SIZE> ring;
+    uint8_t data[RING_SIZE];
+    for(size_t i=0; i<RING_SIZE; i++) data[i] = uint8_t(i);
+
+    //Move the indices close to the end of the buffer
+    TEST_ASSERT_EQUAL(200, ring.write(data, 200));
+    ring.consume(200);
+    TEST_ASSERT_EQUAL(100, ring.write(data, 100));
+
+    //The stored bytes wrap: peek() returns the part up to the end of the buffer first
+    const uint8_t* view;
+    TEST_ASSERT_EQUAL(56, ring.peek(view));
+    TEST_ASSERT_EQUAL_MEMORY(data, view, 56);
+    ring.consume(20);
+    TEST_ASSERT_EQUAL(36, ring.peek(view));
+    TEST_ASSERT_EQUAL(20, view[0]);
+    ring.consume(36);
+    TEST_ASSERT_EQUAL(44, ring.peek(view));
+    TEST_ASSERT_EQUAL_MEMORY(&data[56], view, 44);
+
+    ring.clear();
+    TEST_ASSERT_EQUAL(0, ring.peek(view));
+    TEST_ASSERT_EQUAL(RING_SIZE, ring.free());
+}
+
+void test_byte_ring_stress_two_threads(){
+    static ByteRing<RING_SIZE> ring;
+    uint32_t errors = 0;
+    uint32_t received = 0;
+
+    std::thread consumer([&](){
+        uint32_t spins = 0;
+        uint8_t buffer[97];
+        while(received < STRESS_BYTES){
+            //Alternate between copying and in-place access
+            size_t length;
+            if(received & 1){
+                length = ring.read(buffer, sizeof(buffer));
+                for(size_t i=0; i<length; i++) if(buffer[i] != sequenceByte(received + i)) errors++;
+            } else {
+                const uint8_t* view;
+                length = ring.peek(view);
+                for(size_t i=0; i<length; i++) if(view[i] != sequenceByte(received + i)) errors++;
+                ring.consume(length);
+            }
+            if(length == 0) backoff(spins);
+            received += length;
+        }
+    });
+    uint32_t spins = 0;
+    uint8_t chunk[61];
+    for(uint32_t sent=0; sent<STRESS_BYTES; ){
+        size_t length = sizeof(chunk) - sent % 23;
+        if(length > STRESS_BYTES - sent) length = STRESS_BYTES - sent;
+        for(size_t i=0; i<length; i++) chunk[i] = sequenceByte(sent + i);
+        size_t accepted = ring.write(chunk, length);
+        if(accepted == 0) backoff(spins);
+        sent += accepted;
+    }
+    consumer.join();
+
+    TEST_ASSERT_EQUAL(0, errors);
+    TEST_ASSERT_EQUAL(STRESS_BYTES, received);
+    TEST_ASSERT_TRUE(ring.empty());
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_byte_ring_fill_and_wrap);
+    RUN_TEST(test_byte_ring_peek_consume);
+    RUN_TEST(test_byte_ring_stress_two_threads);
+    return UNITY_END();
+}
@@ -0,0 +1,291 @@
+// Generated by candbc_generate from ExampleBus.dbc. Do not edit.
+#ifndef EXAMPLEBUS_H
+#define EXAMPLEBUS_H
+
+#include <stdint.h>
+#include "CANDBC.h"
+
+namespace ExampleBus {
+
+/**
+ * @brief EngineData, ID 0x100, DLC 8.
+ */
+struct EngineData {
+    static constexpr uint32_t ID = 0x100;
+    static constexpr bool EXTENDED = false;
+    static constexpr uint8_t DLC = 8;
+
+    float EngineSpeed;                 // rpm [0, 16383.75]
+    float CoolantTemp;                 // degC [-40, 215]
+    float ThrottlePosition;            // % [0, 102.3]
+    float TorqueRequest;               // Nm [-1024, 1023.5]
+    uint8_t GearSelected;              // [0, 15]
+    uint8_t EngineRunning;             // [0, 1]
+    uint8_t Counter;                   // [0, 15]
+
+    static constexpr EngineData decode(uint64_t payload) {
+        return EngineData{decodeEngineSpeed(payload), decodeCoolantTemp(payload), decodeThrottlePosition(payload), decodeTorqueRequest(payload), decodeGearSelected(payload), decodeEngineRunning(payload), decodeCounter(payload)};
+    }
+
+    constexpr uint64_t encode() const {
+        return encodeEngineSpeed(EngineSpeed) | encodeCoolantTemp(CoolantTemp) | encodeThrottlePosition(ThrottlePosition) | encodeTorqueRequest(TorqueRequest) | encodeGearSelected(GearSelected) | encodeEngineRunning(EngineRunning) | encodeCounter(Counter);
+    }
+
+    static constexpr float decodeEngineSpeed(uint64_t payload) {
+        return float(payload & 0xFFFFULL) * 0.25f;
+    }
+
+    static constexpr uint64_t encodeEngineSpeed(float value) {
+        return CANDBC::saturateUnsigned<float>(value * 4.0f, 0xFFFFULL) & 0xFFFFULL;
+    }
+
+    static constexpr float decodeCoolantTemp(uint64_t payload) {
+        return float((payload >> 16) & 0xFFULL) - 40.0f;
+    }
+
+    static constexpr uint64_t encodeCoolantTemp(float value) {
+        return (CANDBC::saturateUnsigned<float>((value + 40.0f), 0xFFULL) & 0xFFULL) << 16;
+    }
+
+    static constexpr float decodeThrottlePosition(uint64_t payload) {
+        return float((payload >> 24) & 0x3FFULL) * 0.1f;
+    }
+
+    static constexpr uint64_t encodeThrottlePosition(float value) {
+        return (CANDBC::saturateUnsigned<float>(value * 10.0f, 0x3FFULL) & 0x3FFULL) << 24;
+    }
+
+    static constexpr float decodeTorqueRequest(uint64_t payload) {
+        return float(CANDBC::signExtend((payload >> 34) & 0xFFFULL, 12)) * 0.5f;
+    }
+
+    static constexpr uint64_t encodeTorqueRequest(float value) {
+        return (uint64_t(CANDBC::saturateSigned<float>(value * 2.0f, -2048LL, 2047LL)) & 0xFFFULL) << 34;
+    }
+
+    static constexpr uint8_t decodeGearSelected(uint64_t payload) {
+        return uint8_t((payload >> 46) & 0xFULL);
+    }
+
+    static constexpr uint64_t encodeGearSelected(uint8_t value) {
+        return (CANDBC::saturateUnsigned<uint64_t>(value, 0xFULL) & 0xFULL) << 46;
+    }
+
+    static constexpr uint8_t decodeEngineRunning(uint64_t payload) {
+        return uint8_t((payload >> 50) & 0x1ULL);
+    }
+
+    static constexpr uint64_t encodeEngineRunning(uint8_t value) {
+        return (CANDBC::saturateUnsigned<uint64_t>(value, 0x1ULL) & 0x1ULL) << 50;
+    }
+
+    static constexpr uint8_t decodeCounter(uint64_t payload) {
+        return uint8_t((payload >> 60) & 0xFULL);
+    }
+
+    static constexpr uint64_t encodeCounter(uint8_t value) {
+        return (CANDBC::saturateUnsigned<uint64_t>(value, 0xFULL) & 0xFULL) << 60;
+    }
+};
+
+/**
+ * @brief EEC1, ID 0x0CF00400 (extended), DLC 8.
+ */
+struct EEC1 {
+    static constexpr uint32_t ID = 0x0CF00400;
+    static constexpr bool EXTENDED = true;
+    static constexpr uint8_t DLC = 8;
+
+    uint8_t EngineTorqueMode;          // [0, 15]
+    float DriverDemandTorque;          // % [-125, 130]
+    float ActualTorque;                // % [-125, 130]
+    float EngineSpeed;                 // rpm [0, 8031.875]
+    uint8_t SourceAddress;             // [0, 255]
+
+    static constexpr EEC1 decode(uint64_t payload) {
+        return EEC1{decodeEngineTorqueMode(payload), decodeDriverDemandTorque(payload), decodeActualTorque(payload), decodeEngineSpeed(payload), decodeSourceAddress(payload)};
+    }
+
+    constexpr uint64_t encode() const {
+        return encodeEngineTorqueMode(EngineTorqueMode) | encodeDriverDemandTorque(DriverDemandTorque) | encodeActualTorque(ActualTorque) | encodeEngineSpeed(EngineSpeed) | encodeSourceAddress(SourceAddress);
+    }
+
+    static constexpr uint8_t decodeEngineTorqueMode(uint64_t payload) {
+        return uint8_t(payload & 0xFULL);
+    }
+
+    static constexpr uint64_t encodeEngineTorqueMode(uint8_t value) {
+        return CANDBC::saturateUnsigned<uint64_t>(value, 0xFULL) & 0xFULL;
+    }
+
+    static constexpr float decodeDriverDemandTorque(uint64_t payload) {
+        return float((payload >> 8) & 0xFFULL) - 125.0f;
+    }
+
+    static constexpr uint64_t encodeDriverDemandTorque(float value) {
+        return (CANDBC::saturateUnsigned<float>((value + 125.0f), 0xFFULL) & 0xFFULL) << 8;
+    }
+
+    static constexpr float decodeActualTorque(uint64_t payload) {
+        return float((payload >> 16) & 0xFFULL) - 125.0f;
+    }
+
+    static constexpr uint64_t encodeActualTorque(float value) {
+        return (CANDBC::saturateUnsigned<float>((value + 125.0f), 0xFFULL) & 0xFFULL) << 16;
+    }
+
+    static constexpr float decodeEngineSpeed(uint64_t payload) {
+        return float((payload >> 24) & 0xFFFFULL) * 0.125f;
+    }
+
+    static constexpr uint64_t encodeEngineSpeed(float value) {
+        return (CANDBC::saturateUnsigned<float>(value * 8.0f, 0xFFFFULL) & 0xFFFFULL) << 24;
+    }
+
+    static constexpr uint8_t decodeSourceAddress(uint64_t payload) {
+        return uint8_t((payload >> 40) & 0xFFULL);
+    }
+
+    static constexpr uint64_t encodeSourceAddress(uint8_t value) {
+        return (uint64_t(value) & 0xFFULL) << 40;
+    }
+};
+
+/**
+ * @brief BatteryStatus, ID 0x200, DLC 8.
+ */
+struct BatteryStatus {
+    static constexpr uint32_t ID = 0x200;
+    static constexpr bool EXTENDED = false;
+    static constexpr uint8_t DLC = 8;
+
+    float PackVoltage;                 // V [0, 655.35]
+    float PackCurrent;                 // A [-3276.8, 3276.7]
+    float StateOfCharge;               // % [0, 127.5]
+    int8_t CellTempMax;                // degC [-128, 127]
+    uint8_t Balancing;                 // [0, 7]
+    uint8_t Fault;                     // [0, 1]
+
+    static constexpr BatteryStatus decode(uint64_t payload) {
+        return BatteryStatus{decodePackVoltage(payload), decodePackCurrent(payload), decodeStateOfCharge(payload), decodeCellTempMax(payload), decodeBalancing(payload), decodeFault(payload)};
+    }
+
+    constexpr uint64_t encode() const {
+        return encodePackVoltage(PackVoltage) | encodePackCurrent(PackCurrent) | encodeStateOfCharge(StateOfCharge) | encodeCellTempMax(CellTempMax) | encodeBalancing(Balancing) | encodeFault(Fault);
+    }
+
+    static constexpr float decodePackVoltage(uint64_t payload) {
+        return float((CANDBC::byteSwap(payload) >> 48) & 0xFFFFULL) * 0.01f;
+    }
+
+    static constexpr uint64_t encodePackVoltage(float value) {
+        return CANDBC::byteSwap((CANDBC::saturateUnsigned<float>(value * 100.0f, 0xFFFFULL) & 0xFFFFULL) << 48);
+    }
+
+    static constexpr float decodePackCurrent(uint64_t payload) {
+        return float(CANDBC::signExtend((CANDBC::byteSwap(payload) >> 32) & 0xFFFFULL, 16)) * 0.1f;
+    }
+
+    static constexpr uint64_t encodePackCurrent(float value) {
+        return CANDBC::byteSwap((uint64_t(CANDBC::saturateSigned<float>(value * 10.0f, -32768LL, 32767LL)) & 0xFFFFULL) << 32);
+    }
+
+    static constexpr float decodeStateOfCharge(uint64_t payload) {
+        return float((CANDBC::byteSwap(payload) >> 24) & 0xFFULL) * 0.5f;
+    }
+
+    static constexpr uint64_t encodeStateOfCharge(float value) {
+        return CANDBC::byteSwap((CANDBC::saturateUnsigned<float>(value * 2.0f, 0xFFULL) & 0xFFULL) << 24);
+    }
+
+    static constexpr int8_t decodeCellTempMax(uint64_t payload) {
+        return int8_t(CANDBC::signExtend((CANDBC::byteSwap(payload) >> 16) & 0xFFULL, 8));
+    }
+
+    static constexpr uint64_t encodeCellTempMax(int8_t value) {
+        return CANDBC::byteSwap((uint64_t(CANDBC::saturateSigned<int64_t>(value, -128LL, 127LL)) & 0xFFULL) << 16);
+    }
+
+    static constexpr uint8_t decodeBalancing(uint64_t payload) {
+        return uint8_t((CANDBC::byteSwap(payload) >> 10) & 0x7ULL);
+    }
+
+    static constexpr uint64_t encodeBalancing(uint8_t value) {
+        return CANDBC::byteSwap((CANDBC::saturateUnsigned<uint64_t>(value, 0x7ULL) & 0x7ULL) << 10);
+    }
+
+    static constexpr uint8_t decodeFault(uint64_t payload) {
+        return uint8_t((CANDBC::byteSwap(payload) >> 8) & 0x1ULL);
+    }
+
+    static constexpr uint64_t encodeFault(uint8_t value) {
+        return CANDBC::byteSwap((CANDBC::saturateUnsigned<uint64_t>(value, 0x1ULL) & 0x1ULL) << 8);
+    }
+};
+
+/**
+ * @brief Odometer, ID 0x300, DLC 8.
+ */
+struct Odometer {
+    static constexpr uint32_t ID = 0x300;
+    static constexpr bool EXTENDED = false;
+    static constexpr uint8_t DLC = 8;
+
+    uint64_t TotalDistance;            // m [0, 0]
+
+    static constexpr Odometer decode(uint64_t payload) {
+        return Odometer{decodeTotalDistance(payload)};
+    }
+
+    constexpr uint64_t encode() const {
+        return encodeTotalDistance(TotalDistance);
+    }
+
+    static constexpr uint64_t decodeTotalDistance(uint64_t payload) {
+        return uint64_t(payload & 0xFFFFFFFFFFFFFFFFULL);
+    }
+
+    static constexpr uint64_t encodeTotalDistance(uint64_t value) {
+        return uint64_t(value);
+    }
+};
+
+/**
+ * @brief TripData, ID 0x301, DLC 6.
+ */
+struct TripData {
+    static constexpr uint32_t ID = 0x301;
+    static constexpr bool EXTENDED = false;
+    static constexpr uint8_t DLC = 6;
+
+    double TripDistance;               // km [0, 4294967.29]
+    uint16_t TripTime;                 // s [0, 65535]
+
+    static constexpr TripData decode(uint64_t payload) {
+        return TripData{decodeTripDistance(payload), decodeTripTime(payload)};
+    }
+
+    constexpr uint64_t encode() const {
+        return encodeTripDistance(TripDistance) | encodeTripTime(TripTime);
+    }
+
+    static constexpr double decodeTripDistance(uint64_t payload) {
+        return double(payload & 0xFFFFFFFFULL) * 0.001;
+    }
+
+    static constexpr uint64_t encodeTripDistance(double value) {
+        return CANDBC::saturateUnsigned<double>(value * 1000.0, 0xFFFFFFFFULL) & 0xFFFFFFFFULL;
+    }
+
+    static constexpr uint16_t decodeTripTime(uint64_t payload) {
+        return uint16_t((payload >> 32) & 0xFFFFULL);
+    }
+
+    static constexpr uint64_t encodeTripTime(uint16_t value) {
+        return (uint64_t(value) & 0xFFFFULL) << 32;
+    }
+};
+
+}   // namespace ExampleBus
+
+#endif // EXAMPLEBUS_H
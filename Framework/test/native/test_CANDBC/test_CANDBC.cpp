@@ -0,0 +1,270 @@
+#include <unity.h>
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include <string>
+#include "CANDBC.h"
+#include "ExampleBus.h"
+
+/*
+Host tests for the DBC signal codec. ExampleBus.h is generated from ExampleBus.dbc with tools/candbc_generate.cpp,
+test_dbc_generated_up_to_date fails if the two files do not match. Run with the PlatformIO native environment.
+*/
+
+CANDBC::Database database;
+
+//Read a file next to this source file
+std::string readTestFile(const char* name){
+    std::string path = __FILE__;
+    size_t separator = path.find_last_of("/\\");
+    path = (separator == std::string::npos ? std::string() : path.substr(0, separator + 1)) + name;
+    std::string content;
+    FILE* file = fopen(path.c_str(), "rb");
+    if(file == nullptr) return content;
+    char buffer[512];
+    size_t length;
+    while((length = fread(buffer, 1, sizeof(buffer), file)) > 0) content.append(buffer, length);
+    fclose(file);
+    return content;
+}
+
+//xorshift64, reproducible random payloads
+uint64_t nextRandom(uint64_t& state){
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+//Bits of the payload word covered by the signals of a message
+uint64_t usedBits(const CANDBC::Message& message){
+    uint64_t bits = 0;
+    const CANDBC::Signal* signals = database.getSignals(message);
+    for(uint8_t s=0; s<message.signalCount; s++){
+        bits = CANDBC::setRaw(signals[s], bits, CANDBC::mask(signals[s].length));
+    }
+    return bits;
+}
+
+//Runs before tests
+void setUp(){
+    TEST_ASSERT_TRUE(database.parse(readTestFile("ExampleBus.dbc").c_str()));
+}
+
+//Runs after tests
+void tearDown(){
+
+}
+
+void test_dbc_parse(){
+    TEST_ASSERT_EQUAL(5, database.getMessageCount());
+
+    const CANDBC::Message* eec1 = database.findMessage(0x0CF00400, true);
+    TEST_ASSERT_NOT_NULL(eec1);
+    TEST_ASSERT_EQUAL_STRING("EEC1", eec1->name);
+    TEST_ASSERT_NULL(database.findMessage(0x0CF00400, false));
+    TEST_ASSERT_EQUAL(5, eec1->signalCount);
+
+    const CANDBC::Message* battery = database.findMessage("BatteryStatus");
+    TEST_ASSERT_NOT_NULL(battery);
+    TEST_ASSERT_EQUAL(0x200, battery->id);
+    TEST_ASSERT_FALSE(battery->extended);
+    const CANDBC::Signal* voltage = database.findSignal(*battery, "PackVoltage");
+    TEST_ASSERT_NOT_NULL(voltage);
+    TEST_ASSERT_FALSE(voltage->littleEndian);
+    TEST_ASSERT_EQUAL(48, voltage->shift);
+    TEST_ASSERT_EQUAL_STRING("V", voltage->unit);
+    TEST_ASSERT_EQUAL(8, database.findSignal(*battery, "Fault")->shift);
+    TEST_ASSERT_NULL(database.findSignal(*battery, "EngineSpeed"));
+
+    const CANDBC::Signal* torque = database.findSignal(*database.findMessage(0x100, false), "TorqueRequest");
+    TEST_ASSERT_TRUE(torque->littleEndian);
+    TEST_ASSERT_TRUE(torque->isSigned);
+    TEST_ASSERT_EQUAL(34, torque->shift);
+    TEST_ASSERT_EQUAL(12, torque->length);
+    TEST_ASSERT_TRUE(torque->factor == 0.5);
+
+    //Invalid descriptions report the line of the first error
+    CANDBC::Database invalid;
+    TEST_ASSERT_FALSE(invalid.parse("BO_ 16 Mux: 8 ECU\n SG_ Mode M : 0|8@1+ (1,0) [0|255] \"\" GW\n"));
+    TEST_ASSERT_EQUAL(2, invalid.getErrorLine());
+    TEST_ASSERT_FALSE(invalid.parse("VERSION \"\"\r\n\r\nBO_ 16 Short: 2 ECU\r\n SG_ Value : 8|16@1+ (1,0) [0|0] \"\" GW\r\n"));
+    TEST_ASSERT_EQUAL(4, invalid.getErrorLine());
+    TEST_ASSERT_FALSE(invalid.parse("BO_ 16 Short: 1 ECU\n SG_ Value : 3|8@0+ (1,0) [0|0] \"\" GW\n"));
+    TEST_ASSERT_EQUAL(2, invalid.getErrorLine());
+    TEST_ASSERT_FALSE(invalid.parse("BO_ 16 Twice: 8 ECU\n SG_ A : 0|8@1+ (1,0) [0|0] \"\" GW\n SG_ A : 8|8@1+ (1,0) [0|0] \"\" GW\n"));
+    TEST_ASSERT_EQUAL(3, invalid.getErrorLine());
+    TEST_ASSERT_FALSE(invalid.parse("BO_ 2048 WrongId: 8 ECU\n"));
+    TEST_ASSERT_EQUAL(1, invalid.getErrorLine());
+}
+
+void test_dbc_interpreter_roundtrip(){
+    const CANDBC::Message& engine = *database.findMessage("EngineData");
+    const CANDBC::Message& battery = *database.findMessage("BatteryStatus");
+    uint8_t data[8] = {};
+
+    uint64_t payload = CANDBC::setValue(*database.findSignal(engine, "EngineSpeed"), 0, 1500.0);
+    payload = CANDBC::setValue(*database.findSignal(engine, "CoolantTemp"), payload, 90.0);
+    payload = CANDBC::setValue(*database.findSignal(engine, "TorqueRequest"), payload, -100.5);
+    CANDBC::store(payload, data, 8);
+    TEST_ASSERT_EQUAL_HEX8(0x70, data[0]);     // 6000 = 0x1770
+    TEST_ASSERT_EQUAL_HEX8(0x17, data[1]);
+    TEST_ASSERT_EQUAL_HEX8(130, data[2]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 1500.0, CANDBC::getValue(*database.findSignal(engine, "EngineSpeed"), CANDBC::load(data, 8)));
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 90.0, CANDBC::getValue(*database.findSignal(engine, "CoolantTemp"), payload));
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, -100.5, CANDBC::getValue(*database.findSignal(engine, "TorqueRequest"), payload));
+
+    //Motorola signals start with the most significant byte
+    memset(data, 0, sizeof(data));
+    payload = CANDBC::setValue(*database.findSignal(battery, "PackVoltage"), 0, 400.0);
+    payload = CANDBC::setValue(*database.findSignal(battery, "PackCurrent"), payload, -12.5);
+    payload = CANDBC::setValue(*database.findSignal(battery, "Fault"), payload, 1);
+    payload = CANDBC::setValue(*database.findSignal(battery, "Balancing"), payload, 5);
+    CANDBC::store(payload, data, 8);
+    TEST_ASSERT_EQUAL_HEX8(0x9C, data[0]);     // 40000 = 0x9C40
+    TEST_ASSERT_EQUAL_HEX8(0x40, data[1]);
+    TEST_ASSERT_EQUAL_HEX8(0xFF, data[2]);     // -125 = 0xFF83
+    TEST_ASSERT_EQUAL_HEX8(0x83, data[3]);
+    TEST_ASSERT_EQUAL_HEX8(0x15, data[6]);     // Balancing in bits 2-4, Fault in bit 0
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, -12.5, CANDBC::getValue(*database.findSignal(battery, "PackCurrent"), payload));
+
+    //Values outside the signal range saturate
+    const CANDBC::Signal& soc = *database.findSignal(battery, "StateOfCharge");
+    TEST_ASSERT_EQUAL(255, CANDBC::toRaw(soc, 200.0));
+    TEST_ASSERT_EQUAL(0, CANDBC::toRaw(soc, -5.0));
+    TEST_ASSERT_EQUAL(0x800, CANDBC::toRaw(*database.findSignal(engine, "TorqueRequest"), -5000.0));
+    TEST_ASSERT_EQUAL(0x7FF, CANDBC::toRaw(*database.findSignal(engine, "TorqueRequest"), 5000.0));
+
+    //Signals do not touch other bits
+    const CANDBC::Signal& counter = *database.findSignal(engine, "Counter");
+    TEST_ASSERT_EQUAL_HEX64(0x5FFFFFFFFFFFFFFFULL, CANDBC::setRaw(counter, ~0ULL, 5));
+}
+
+//Compare every signal of a message decoded by the interpreter and by the generated code
+template<typename Message, typename Decode>
+void compareMessage(const char* name, uint64_t state, Decode decode){
+    const CANDBC::Message& message = *database.findMessage(name);
+    uint64_t used = usedBits(message);
+    for(uint32_t i=0; i<10000; i++){
+        uint64_t payload = nextRandom(state) & CANDBC::mask(8 * message.dlc);
+        Message generated = Message::decode(payload);
+        const CANDBC::Signal* signals = database.getSignals(message);
+        for(uint8_t s=0; s<message.signalCount; s++){
+            double expected = CANDBC::getValue(signals[s], payload);
+            double actual = decode(generated, s);
+            TEST_ASSERT_FLOAT_WITHIN(fabs(expected) * 1e-6 + 1e-6, expected, actual);
+        }
+        TEST_ASSERT_EQUAL_HEX64(payload & used, generated.encode());
+    }
+}
+
+void test_dbc_generated_matches_interpreter(){
+    compareMessage<ExampleBus::EngineData>("EngineData", 1, [](const ExampleBus::EngineData& m, uint8_t s) -> double {
+        const double values[] = {m.EngineSpeed, m.CoolantTemp, m.ThrottlePosition, m.TorqueRequest, double(m.GearSelected), double(m.EngineRunning), double(m.Counter)};
+        return values[s];
+    });
+    compareMessage<ExampleBus::EEC1>("EEC1", 2, [](const ExampleBus::EEC1& m, uint8_t s) -> double {
+        const double values[] = {double(m.EngineTorqueMode), m.DriverDemandTorque, m.ActualTorque, m.EngineSpeed, double(m.SourceAddress)};
+        return values[s];
+    });
+    compareMessage<ExampleBus::BatteryStatus>("BatteryStatus", 3, [](const ExampleBus::BatteryStatus& m, uint8_t s) -> double {
+        const double values[] = {m.PackVoltage, m.PackCurrent, m.StateOfCharge, double(m.CellTempMax), double(m.Balancing), double(m.Fault)};
+        return values[s];
+    });
+    compareMessage<ExampleBus::TripData>("TripData", 4, [](const ExampleBus::TripData& m, uint8_t s) -> double {
+        const double values[] = {m.TripDistance, double(m.TripTime)};
+        return values[s];
+    });
+
+    //64 bit signal, compared as integer
+    uint64_t state = 5;
+    for(uint32_t i=0; i<1000; i++){
+        uint64_t payload = nextRandom(state);
+        TEST_ASSERT_EQUAL_HEX64(CANDBC::getRaw(*database.findSignal(*database.findMessage("Odometer"), "TotalDistance"), payload),
+                                ExampleBus::Odometer::decode(payload).TotalDistance);
+        TEST_ASSERT_EQUAL_HEX64(payload, ExampleBus::Odometer{payload}.encode());
+    }
+
+    //Generated encoding saturates like the interpreter
+    const CANDBC::Message& battery = *database.findMessage("BatteryStatus");
+    const double currents[] = {-5000.0, -12.54, -0.04, 0.05, 12.46, 5000.0};
+    for(double current : currents){
+        TEST_ASSERT_EQUAL_HEX64(CANDBC::setValue(*database.findSignal(battery, "PackCurrent"), 0, current),
+                                ExampleBus::BatteryStatus::encodePackCurrent(float(current)));
+    }
+}
+
+void test_dbc_generated_constexpr(){
+    static_assert(ExampleBus::EEC1::ID == 0x0CF00400 && ExampleBus::EEC1::EXTENDED, "EEC1 identifier");
+    static_assert(ExampleBus::EngineData::encodeEngineSpeed(1500.0f) == 0x1770, "EngineSpeed encoding");
+    static_assert(ExampleBus::EngineData::decodeTorqueRequest(0xFFFULL << 34) == -0.5f, "TorqueRequest sign extension");
+    static_assert(ExampleBus::BatteryStatus::encodePackVoltage(400.0f) == 0x409C, "Motorola byte order");
+    static_assert(ExampleBus::BatteryStatus::decodeCellTempMax(ExampleBus::BatteryStatus::encodeCellTempMax(-40)) == -40, "CellTempMax roundtrip");
+    static_assert(ExampleBus::BatteryStatus::encodeStateOfCharge(1000.0f) == ExampleBus::BatteryStatus::encodeStateOfCharge(127.5f), "Saturation");
+    constexpr ExampleBus::EngineData engine = ExampleBus::EngineData::decode(0x1770);
+    static_assert(engine.EngineSpeed == 1500.0f && engine.CoolantTemp == -40.0f, "Message decoding");
+    TEST_ASSERT_EQUAL_HEX64(0x1770, engine.encode() & 0xFFFF);
+}
+
+void test_dbc_generated_up_to_date(){
+    std::string generated;
+    TEST_ASSERT_TRUE(CANDBC::generate(database, "ExampleBus", "ExampleBus.dbc", [&generated](const char* text){ generated += text; }));
+    TEST_ASSERT_TRUE_MESSAGE(generated == readTestFile("ExampleBus.h"), "Regenerate ExampleBus.h with tools/candbc_generate.cpp");
+
+    //Signal names must not collide with generated members
+    CANDBC::Database reserved;
+    TEST_ASSERT_TRUE(reserved.parse("BO_ 16 Reserved: 8 ECU\n SG_ DLC : 0|4@1+ (1,0) [0|8] \"\" GW\n"));
+    TEST_ASSERT_FALSE(CANDBC::generate(reserved, "Reserved", "reserved.dbc", [](const char*){}));
+}
+
+void measure_decode_throughput(){
+    const uint32_t FRAMES = 1000000;
+    static uint64_t payloads[1024];
+    uint64_t state = 42;
+    for(uint64_t& payload : payloads) payload = nextRandom(state);
+    const CANDBC::Message& engine = *database.findMessage("EngineData");
+    const CANDBC::Message& battery = *database.findMessage("BatteryStatus");
+
+    //Sum of all values so the decoding cannot be optimized away
+    volatile double sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    double sum = 0;
+    for(uint32_t i=0; i<FRAMES; i++){
+        uint64_t payload = payloads[i & 1023];
+        ExampleBus::EngineData e = ExampleBus::EngineData::decode(payload);
+        ExampleBus::BatteryStatus b = ExampleBus::BatteryStatus::decode(payload);
+        sum += e.EngineSpeed + e.CoolantTemp + e.ThrottlePosition + e.TorqueRequest + e.GearSelected + e.EngineRunning + e.Counter;
+        sum += b.PackVoltage + b.PackCurrent + b.StateOfCharge + b.CellTempMax + b.Balancing + b.Fault;
+    }
+    sink = sum;
+    double generatedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / FRAMES;
+
+    start = std::chrono::steady_clock::now();
+    sum = 0;
+    for(uint32_t i=0; i<FRAMES; i++){
+        uint64_t payload = payloads[i & 1023];
+        for(const CANDBC::Message* message : {&engine, &battery}){
+            const CANDBC::Signal* signals = database.getSignals(*message);
+            for(uint8_t s=0; s<message->signalCount; s++) sum += CANDBC::getValue(signals[s], payload);
+        }
+    }
+    sink = sum;
+    double interpretedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / FRAMES;
+    (void)sink;
+
+    printf("MEASUREMENT: Decoding EngineData and BatteryStatus (13 signals), %u frame pairs\n", unsigned(FRAMES));
+    printf("MEASUREMENT:   generated   %6.1f ns per frame pair\n", generatedNs);
+    printf("MEASUREMENT:   interpreted %6.1f ns per frame pair\n", interpretedNs);
+    printf("MEASUREMENT:   speedup     %6.1fx\n", interpretedNs / generatedNs);
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_dbc_parse);
+    RUN_TEST(test_dbc_interpreter_roundtrip);
+    RUN_TEST(test_dbc_generated_matches_interpreter);
+    RUN_TEST(test_dbc_generated_constexpr);
+    RUN_TEST(test_dbc_generated_up_to_date);
+    RUN_TEST(measure_decode_throughput);
+    return UNITY_END();
+}
@@ -0,0 +1,161 @@
+#include <unity.h>
+#include <stdio.h>
+#include <thread>
+#include <chrono>
+#include "CANFrameRing.h"
+
+/*
+Host tests for the lock-free CAN frame ring. Run with the PlatformIO native environment.
+*/
+
+static constexpr size_t RING_SIZE = 64;
+static constexpr uint32_t STRESS_FRAMES = 2000000;
+
+CANFrame makeFrame(uint32_t sequence){
+    CANFrame frame;
+    uint8_t data[8];
+    for(uint8_t i=0; i<8; i++) data[i] = uint8_t(sequence >> (8 * (i & 3))) ^ i;
+    frame.set(sequence & 0x7FF, sequence & 1, false, data, sequence % 9, sequence);
+    return frame;
+}
+
+/**
+ * @brief Back off while the ring is full or empty.
+ * @details Spins briefly, then sleeps so the peer thread also makes progress on hosts with a single CPU.
+ */
+void backoff(uint32_t& spins){
+    if(++spins < 100){
+        std::this_thread::yield();
+        return;
+    }
+    spins = 0;
+    std::this_thread::sleep_for(std::chrono::microseconds(10));
+}
+
+bool checkFrame(const CANFrame& frame, uint32_t sequence){
+    CANFrame expected = makeFrame(sequence);
+    return frame.idFlags == expected.idFlags && frame.dlcTimestamp == expected.dlcTimestamp && memcmp(frame.data, expected.data, 8) == 0;
+}
+
+//Runs before tests
+void setUp(){
+
+}
+
+//Runs after tests
+void tearDown(){
+
+}
+
+void test_frame_packing(){
+    CANFrame frame;
+    uint8_t data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    frame.set(0x1ABCDEF0, true, false, data, 12, 0xFFFFFFFF);
+    TEST_ASSERT_EQUAL(16, sizeof(CANFrame));
+    TEST_ASSERT_EQUAL_HEX32(0x1ABCDEF0, frame.getId());
+    TEST_ASSERT_TRUE(frame.isExtended());
+    TEST_ASSERT_FALSE(frame.isRemote());
+    TEST_ASSERT_FALSE(frame.isError());
+    TEST_ASSERT_EQUAL(8, frame.getLength());
+    TEST_ASSERT_EQUAL_HEX32(CANFrame::TIMESTAMP_MASK, frame.getTimestamp());
+    TEST_ASSERT_EQUAL_MEMORY(data, frame.data, 8);
+
+    frame.set(0x123, false, true, data, 4, 42);
+    TEST_ASSERT_TRUE(frame.isRemote());
+    TEST_ASSERT_EQUAL(4, frame.getLength());
+    TEST_ASSERT_EQUAL(0, frame.data[0]); //No payload for remote frames
+}
+
+void test_ring_fill_and_wrap(){
+    static CANFrameRing<RING_SIZE> ring;
+    CANFrame frame;
+    TEST_ASSERT_TRUE(ring.empty());
+    TEST_ASSERT_FALSE(ring.pop(frame));
+
+    uint32_t pushed = 0;
+    uint32_t popped = 0;
+    for(uint8_t round=0; round<10; round++){
+        while(ring.push(makeFrame(pushed))) pushed++;
+        TEST_ASSERT_EQUAL(RING_SIZE, ring.size());
+        //Remove part of the frames so head and tail wrap at different positions
+        for(uint8_t i=0; i<RING_SIZE / 2 + round; i++){
+            TEST_ASSERT_TRUE(ring.pop(frame));
+            TEST_ASSERT_TRUE(checkFrame(frame, popped++));
+        }
+    }
+    TEST_ASSERT_EQUAL(10, ring.getDropped());
+    while(ring.pop(frame)) TEST_ASSERT_TRUE(checkFrame(frame, popped++));
+    TEST_ASSERT_EQUAL(pushed, popped);
+}
+
+void test_ring_stress_two_threads(){
+    static CANFrameRing<RING_SIZE> ring;
+    uint32_t errors = 0;
+    uint32_t received = 0;
+
+    std::thread consumer([&](){
+        CANFrame frame;
+        uint32_t spins = 0;
+        while(received < STRESS_FRAMES){
+            if(!ring.pop(frame)){
+                backoff(spins);
+                continue;
+            }
+            if(!checkFrame(frame, received)) errors++;
+            received++;
+        }
+    });
+    uint32_t spins = 0;
+    for(uint32_t i=0; i<STRESS_FRAMES; i++){
+        CANFrame frame = makeFrame(i);
+        while(!ring.push(frame)) backoff(spins);
+    }
+    consumer.join();
+
+    TEST_ASSERT_EQUAL(0, errors);
+    TEST_ASSERT_EQUAL(STRESS_FRAMES, received);
+    TEST_ASSERT_TRUE(ring.empty());
+}
+
+void measure_ring_throughput(){
+    static CANFrameRing<RING_SIZE> ring;
+    const uint32_t FRAMES = 10000000;
+    volatile uint32_t checksum = 0;
+    CANFrame frame = makeFrame(1);
+
+    auto startTime = std::chrono::steady_clock::now();
+    std::thread consumer([&](){
+        CANFrame received;
+        uint32_t count = 0;
+        uint32_t sum = 0;
+        uint32_t spins = 0;
+        while(count < FRAMES){
+            if(ring.pop(received)){
+                sum += received.data[0];
+                count++;
+            } else {
+                backoff(spins);
+            }
+        }
+        checksum = sum;
+    });
+    uint32_t spins = 0;
+    for(uint32_t i=0; i<FRAMES; i++){
+        while(!ring.push(frame)) backoff(spins);
+    }
+    consumer.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    printf("MEASUREMENT: Transferred %u frames of %u bytes between two threads in %.3f s\n", FRAMES, unsigned(sizeof(CANFrame)), seconds);
+    printf("MEASUREMENT:   Throughput: %.1f Mframes/s, %.1f ns per frame\n", FRAMES / seconds / 1e6, seconds * 1e9 / FRAMES);
+    TEST_ASSERT_EQUAL(FRAMES * frame.data[0], checksum);
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_frame_packing);
+    RUN_TEST(test_ring_fill_and_wrap);
+    RUN_TEST(test_ring_stress_two_threads);
+    RUN_TEST(measure_ring_throughput);
+    return UNITY_END();
+}
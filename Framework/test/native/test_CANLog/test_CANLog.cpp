@@ -0,0 +1,124 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string>
+#include "CANLog.h"
+
+/*
+Host tests for the binary CAN log format and the text converters. Run with the PlatformIO native environment.
+*/
+
+CANLog::Record makeRecord(uint32_t timestamp, uint32_t id, bool extended, bool remote, uint8_t length, CANLog::Direction direction){
+    CANFrame frame;
+    uint8_t data[8] = {0xDE, 0xAD, 0xBE, 0xEF, 0x01, 0x02, 0x03, 0x04};
+    frame.set(id, extended, remote, data, length, 0);
+    CANLog::Record record;
+    record.timestamp = timestamp;
+    record.idFlags = frame.idFlags;
+    record.length = frame.getLength();
+    record.direction = direction;
+    memcpy(record.data, frame.data, 8);
+    return record;
+}
+
+//Runs before tests
+void setUp(){
+
+}
+
+//Runs after tests
+void tearDown(){
+
+}
+
+void test_log_header(){
+    uint8_t header[CANLog::HEADER_SIZE];
+    uint32_t baudrate = 0;
+    TEST_ASSERT_EQUAL(CANLog::HEADER_SIZE, CANLog::encodeHeader(500000, header));
+    TEST_ASSERT_EQUAL_MEMORY("CTLG", header, 4);
+    TEST_ASSERT_TRUE(CANLog::decodeHeader(header, sizeof(header), baudrate));
+    TEST_ASSERT_EQUAL(500000, baudrate);
+    TEST_ASSERT_FALSE(CANLog::decodeHeader(header, sizeof(header) - 1, baudrate));
+    header[4] = CANLog::VERSION + 1;
+    TEST_ASSERT_FALSE(CANLog::decodeHeader(header, sizeof(header), baudrate));
+}
+
+void test_log_record_roundtrip(){
+    uint8_t buffer[CANLog::MAX_RECORD_SIZE];
+    CANLog::Record decoded;
+
+    CANLog::Record data = makeRecord(0x89ABCDEF, 0x18FEF100, true, false, 8, CANLog::TX);
+    TEST_ASSERT_EQUAL(17, CANLog::encodeRecord(data, buffer));
+    TEST_ASSERT_EQUAL(17, CANLog::decodeRecord(buffer, sizeof(buffer), decoded));
+    TEST_ASSERT_EQUAL_HEX32(0x89ABCDEF, decoded.timestamp);
+    TEST_ASSERT_EQUAL_HEX32(0x18FEF100, decoded.getId());
+    TEST_ASSERT_TRUE(decoded.isExtended());
+    TEST_ASSERT_EQUAL(CANLog::TX, decoded.direction);
+    TEST_ASSERT_EQUAL_MEMORY(data.data, decoded.data, 8);
+    TEST_ASSERT_EQUAL(0, CANLog::decodeRecord(buffer, 16, decoded)); //Truncated
+
+    CANLog::Record remote = makeRecord(5, 0x123, false, true, 4, CANLog::RX);
+    TEST_ASSERT_EQUAL(CANLog::MIN_RECORD_SIZE, CANLog::encodeRecord(remote, buffer));
+    TEST_ASSERT_EQUAL(CANLog::MIN_RECORD_SIZE, CANLog::decodeRecord(buffer, sizeof(buffer), decoded));
+    TEST_ASSERT_TRUE(decoded.isRemote());
+    TEST_ASSERT_EQUAL(4, decoded.length);
+}
+
+void test_log_candump_format(){
+    char line[64];
+    CANLog::Record data = makeRecord(0, 0x123, false, false, 4, CANLog::RX);
+    TEST_ASSERT_GREATER_THAN(0, CANLog::formatCandump(data, 12345678, "can0", line, sizeof(line)));
+    TEST_ASSERT_EQUAL_STRING("(12.345678) can0 123#DEADBEEF", line);
+
+    CANLog::Record extended = makeRecord(0, 0x1ABCDE, true, false, 0, CANLog::RX);
+    CANLog::formatCandump(extended, 1, "vcan1", line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("(0.000001) vcan1 001ABCDE#", line);
+
+    CANLog::Record remote = makeRecord(0, 0x7FF, false, true, 2, CANLog::RX);
+    CANLog::formatCandump(remote, 0, "can0", line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("(0.000000) can0 7FF#R", line);
+
+    TEST_ASSERT_EQUAL(-1, CANLog::formatCandump(data, 0, "can0", line, 20)); //Buffer too small
+}
+
+void test_log_asc_format(){
+    char line[96];
+    CANLog::Record data = makeRecord(0, 0x123, false, false, 2, CANLog::RX);
+    CANLog::formatAsc(data, 1234567, 1, line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("   1.234567 1  123             Rx   d 2 DE AD", line);
+
+    CANLog::Record extended = makeRecord(0, 0x18FEF100, true, false, 1, CANLog::TX);
+    CANLog::formatAsc(extended, 0, 2, line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("   0.000000 2  18FEF100x       Tx   d 1 DE", line);
+
+    CANLog::Record remote = makeRecord(0, 0x100, false, true, 8, CANLog::RX);
+    CANLog::formatAsc(remote, 0, 1, line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("   0.000000 1  100             Rx   r 8", line);
+}
+
+void test_log_convert_with_timestamp_wrap(){
+    uint8_t log[CANLog::HEADER_SIZE + 3 * CANLog::MAX_RECORD_SIZE];
+    size_t length = CANLog::encodeHeader(250000, log);
+    length += CANLog::encodeRecord(makeRecord(0xFFFFFF00, 0x100, false, false, 1, CANLog::RX), &log[length]);
+    length += CANLog::encodeRecord(makeRecord(0x00000100, 0x101, false, false, 1, CANLog::RX), &log[length]); //Wrapped, 512 us later
+    length += CANLog::encodeRecord(makeRecord(0x000F4340, 0x102, false, false, 1, CANLog::TX), &log[length]); //1 s after the second record
+
+    std::string text;
+    TEST_ASSERT_EQUAL(3, CANLog::convert(log, length, CANLog::CANDUMP, [&](const char* line) { text += line; }));
+    TEST_ASSERT_EQUAL_STRING("(0.000000) can0 100#DE\n(0.000512) can0 101#DE\n(1.000512) can0 102#DE\n", text.c_str());
+
+    text.clear();
+    TEST_ASSERT_EQUAL(2, CANLog::convert(log, length - 1, CANLog::ASC, [&](const char* line) { text += line; })); //Last record truncated
+    TEST_ASSERT_EQUAL(0, text.find(CANLog::ASC_HEADER));
+    TEST_ASSERT_NOT_EQUAL(std::string::npos, text.find("   0.000512 1  101             Rx   d 1 DE\n"));
+    TEST_ASSERT_EQUAL(text.size() - strlen("End TriggerBlock\n"), text.rfind("End TriggerBlock\n"));
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_log_header);
+    RUN_TEST(test_log_record_roundtrip);
+    RUN_TEST(test_log_candump_format);
+    RUN_TEST(test_log_asc_format);
+    RUN_TEST(test_log_convert_with_timestamp_wrap);
+    return UNITY_END();
+}
@@ -0,0 +1,181 @@
+#include <unity.h>
+#include <stdio.h>
+#include <vector>
+#include "CANLog.h"
+#include "CANReplayCore.h"
+#include "CANInterface.h"
+
+/*
+Host tests for the CANReplayCore playing back log files through CANInterface.
+Run with the PlatformIO native environment with include/host on the include path (build_flags = -I include/host).
+The logs are written with CANLog into temporary files, larger than the read window of the core.
+*/
+
+static const uint32_t FRAME_COUNT = 2000;
+static const uint32_t FRAME_SPACING_US = 100;
+
+CANReplayCore replayCore;
+CANInterface replayInterface;
+FILE* logFile = nullptr;
+std::vector<uint8_t> logData;
+
+/**
+ * @brief Listener storing the received frames and their receive timestamps.
+ */
+class CollectListener : public CANListener {
+public:
+    std::vector<CANCore::CANMessage> frames;
+    std::vector<uint32_t> times;
+    std::vector<uint32_t> delays;       // From the playback time to the dispatch
+
+    bool onMessage(const CANCore::CANMessage& message) override {
+        frames.push_back(message);
+        times.push_back(replayInterface.getRxTimestamp());
+        delays.push_back(micros() - replayInterface.getRxTimestamp());
+        return true;
+    }
+};
+
+CollectListener collector;
+
+CANLog::Record makeRecord(uint32_t i){
+    CANLog::Record record = {};
+    record.timestamp = 0xFFFF0000 + i * FRAME_SPACING_US;      // Wraps during the log
+    record.idFlags = 0x100 + (i & 0x3FF);
+    record.length = i % 9;
+    record.direction = CANLog::RX;
+    for(uint8_t b=0; b<8; b++) record.data[b] = i + b;
+    return record;
+}
+
+/**
+ * @brief Write FRAME_COUNT received frames and a transmitted frame after every 5th frame to logData and logFile.
+ */
+void writeLog(){
+    logData.resize(CANLog::HEADER_SIZE);
+    CANLog::encodeHeader(CANCore::BR_500K, logData.data());
+    uint8_t buffer[CANLog::MAX_RECORD_SIZE];
+    for(uint32_t i=0; i<FRAME_COUNT; i++){
+        CANLog::Record record = makeRecord(i);
+        size_t size = CANLog::encodeRecord(record, buffer);
+        logData.insert(logData.end(), buffer, buffer + size);
+        if(i % 5 == 4){
+            record.idFlags = 0x700;
+            record.direction = CANLog::TX;
+            size = CANLog::encodeRecord(record, buffer);
+            logData.insert(logData.end(), buffer, buffer + size);
+        }
+    }
+    logFile = tmpfile();
+    TEST_ASSERT_NOT_NULL(logFile);
+    TEST_ASSERT_EQUAL(logData.size(), fwrite(logData.data(), 1, logData.size(), logFile));
+    TEST_ASSERT_GREATER_THAN(CANReplayCore::WINDOW_SIZE * 4, logData.size());
+}
+
+/**
+ * @brief Replay the assigned log and collect the frames.
+ */
+void replay(float speed){
+    collector.frames.clear();
+    collector.times.clear();
+    collector.delays.clear();
+    replayCore.setSpeed(speed);
+    TEST_ASSERT_TRUE(replayCore.begin());
+    for(uint32_t i=0; i<10000000 && !replayCore.isFinished(); i++){
+        replayInterface.process();
+    }
+    replayInterface.process();
+}
+
+//Runs before tests
+void setUp(){
+    writeLog();
+    replayInterface.setCANCore(&replayCore);
+    replayInterface.clearListeners();
+    replayInterface.addListener(&collector);
+    replayCore.setReplayTransmitted(false);
+    replayCore.setupFilter(0, 0);
+}
+
+//Runs after tests
+void tearDown(){
+    replayCore.end();
+    if(logFile) fclose(logFile);
+    logFile = nullptr;
+}
+
+void test_replay_file_content(){
+    TEST_ASSERT_TRUE(replayCore.setLogFile(logFile));
+    replay(0);
+    TEST_ASSERT_EQUAL(FRAME_COUNT, collector.frames.size());
+    for(uint32_t i=0; i<FRAME_COUNT; i++){
+        CANLog::Record expected = makeRecord(i);
+        TEST_ASSERT_EQUAL_HEX32(expected.getId(), collector.frames[i].id);
+        TEST_ASSERT_EQUAL(expected.length, collector.frames[i].length);
+        TEST_ASSERT_EQUAL_MEMORY(expected.data, collector.frames[i].data, expected.length);
+    }
+
+    replayCore.setReplayTransmitted(true);
+    replay(0);
+    TEST_ASSERT_EQUAL(FRAME_COUNT + FRAME_COUNT / 5, collector.frames.size());
+    TEST_ASSERT_EQUAL_HEX32(0x700, collector.frames[5].id);
+}
+
+void test_replay_file_matches_memory(){
+    //Same frames from a file and from memory, with a filter skipping most records
+    replayCore.setupFilter(0x108, 0x7F8);
+    TEST_ASSERT_TRUE(replayCore.setLog(logData.data(), logData.size()));
+    replay(0);
+    std::vector<CANCore::CANMessage> fromMemory = collector.frames;
+    TEST_ASSERT_TRUE(replayCore.setLogFile(logFile));
+    replay(0);
+    TEST_ASSERT_EQUAL(fromMemory.size(), collector.frames.size());
+    TEST_ASSERT_GREATER_THAN(0, collector.frames.size());
+    for(size_t i=0; i<fromMemory.size(); i++){
+        TEST_ASSERT_EQUAL_HEX32(fromMemory[i].id, collector.frames[i].id);
+        TEST_ASSERT_EQUAL_MEMORY(fromMemory[i].data, collector.frames[i].data, 8);
+    }
+}
+
+void test_replay_file_truncated(){
+    //A record cut off at the end of the file ends the playback
+    replayCore.setReplayTransmitted(true);
+    TEST_ASSERT_TRUE(replayCore.setSource([](size_t offset, uint8_t* buffer, size_t length) -> size_t {
+        if(fseek(logFile, long(offset), SEEK_SET) != 0) return 0;
+        return fread(buffer, 1, length, logFile);
+    }, logData.size() - 3));
+    replay(0);
+    TEST_ASSERT_EQUAL(FRAME_COUNT + FRAME_COUNT / 5 - 1, collector.frames.size());
+    TEST_ASSERT_TRUE(replayCore.isFinished());
+}
+
+void measure_replay_file_timing(){
+    const float speed = 0.5f;
+    TEST_ASSERT_TRUE(replayCore.setLogFile(logFile));
+    replay(speed);
+    TEST_ASSERT_EQUAL(FRAME_COUNT, collector.frames.size());
+    uint32_t expectedSpacing = FRAME_SPACING_US / speed;
+    uint64_t totalError = 0, totalDelay = 0;
+    uint32_t maxError = 0, maxDelay = 0;
+    for(uint32_t i=1; i<FRAME_COUNT; i++){
+        uint32_t spacing = collector.times[i] - collector.times[i - 1];
+        uint32_t error = spacing > expectedSpacing ? spacing - expectedSpacing : expectedSpacing - spacing;
+        totalError += error;
+        if(error > maxError) maxError = error;
+        totalDelay += collector.delays[i];
+        if(collector.delays[i] > maxDelay) maxDelay = collector.delays[i];
+    }
+    printf("MEASUREMENT: Replay of a %u byte log file at speed %.1f, expected spacing %u us:\n", unsigned(logData.size()), speed, expectedSpacing);
+    printf("MEASUREMENT:   Spacing error of the receive timestamps: avg %.2f us, max %u us\n", double(totalError) / (FRAME_COUNT - 1), maxError);
+    printf("MEASUREMENT:   Playback time to listener, including the window reads: avg %.2f us, max %u us\n", double(totalDelay) / (FRAME_COUNT - 1), maxDelay);
+    TEST_ASSERT_LESS_THAN(expectedSpacing / 4, totalError / (FRAME_COUNT - 1));
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_replay_file_content);
+    RUN_TEST(test_replay_file_matches_memory);
+    RUN_TEST(test_replay_file_truncated);
+    RUN_TEST(measure_replay_file_timing);
+    return UNITY_END();
+}
@@ -0,0 +1,246 @@
+#include <unity.h>
+#include <stdio.h>
+#include "CANTxScheduler.h"
+#include "VirtualCANBus.h"
+
+/*
+Host tests for the priority ordered transmit queue. The benchmark feeds a simulated bus once with a FIFO queue (like the TWAI
+driver) and once through the scheduler. Run with the PlatformIO native environment.
+*/
+
+CANFrame makeFrame(uint32_t id, uint8_t length, uint32_t timestamp = 0, bool extended = false){
+    CANFrame frame;
+    uint8_t data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    frame.set(id, extended, false, data, length, timestamp);
+    return frame;
+}
+
+uint32_t popId(CANTxScheduler<8>& scheduler, uint32_t now){
+    const CANFrame* frame = scheduler.peek(now);
+    if(frame == nullptr) return 0xFFFFFFFF;
+    uint32_t id = frame->getId();
+    scheduler.drop(now);
+    return id;
+}
+
+//Runs before tests
+void setUp(){
+
+}
+
+//Runs after tests
+void tearDown(){
+
+}
+
+void test_scheduler_priority_order(){
+    CANTxScheduler<8> scheduler;
+    TEST_ASSERT_TRUE(scheduler.push(makeFrame(0x300, 1, 0)));
+    TEST_ASSERT_TRUE(scheduler.push(makeFrame(0x100 << 18, 8, 10, true)));     // Same base ID as 0x100, extended
+    TEST_ASSERT_TRUE(scheduler.push(makeFrame(0x100, 8, 20)));
+    TEST_ASSERT_TRUE(scheduler.push(makeFrame(0x050, 8, 30)));
+    TEST_ASSERT_TRUE(scheduler.push(makeFrame(0x300, 2, 40)));
+    TEST_ASSERT_EQUAL(5, scheduler.size());
+
+    const uint32_t expected[] = {0x050, 0x100, 0x100 << 18};
+    for(uint32_t id : expected) TEST_ASSERT_EQUAL_HEX32(id, popId(scheduler, 100));
+
+    //Equal identifiers keep their order
+    const CANFrame* frame = scheduler.peek(100);
+    TEST_ASSERT_NOT_NULL(frame);
+    TEST_ASSERT_EQUAL(1, frame->getLength());
+    scheduler.drop(100);
+    TEST_ASSERT_EQUAL(2, scheduler.peek(100)->getLength());
+    scheduler.drop(100);
+    TEST_ASSERT_TRUE(scheduler.empty());
+    TEST_ASSERT_NULL(scheduler.peek(100));
+
+    TEST_ASSERT_EQUAL(5, scheduler.getStatistics().sent);
+    TEST_ASSERT_EQUAL(100, scheduler.getStatistics().maxDelayUs);
+    TEST_ASSERT_EQUAL((70 + 80 + 90 + 100 + 60) / 5, scheduler.getAverageDelay());
+}
+
+void test_scheduler_full_queue_eviction(){
+    CANTxScheduler<4> scheduler;
+    for(uint32_t id = 0x400; id < 0x404; id++) TEST_ASSERT_TRUE(scheduler.push(makeFrame(id, 8)));
+    TEST_ASSERT_FALSE(scheduler.push(makeFrame(0x500, 8)));
+    TEST_ASSERT_FALSE(scheduler.push(makeFrame(0x403, 8)));
+    TEST_ASSERT_EQUAL(2, scheduler.getStatistics().dropped);
+
+    //A frame with a higher priority replaces the last frame
+    TEST_ASSERT_TRUE(scheduler.push(makeFrame(0x010, 8)));
+    TEST_ASSERT_EQUAL(1, scheduler.getStatistics().evicted);
+    TEST_ASSERT_EQUAL(4, scheduler.size());
+    TEST_ASSERT_EQUAL(4, scheduler.getStatistics().maxDepth);
+    const uint32_t expected[] = {0x010, 0x400, 0x401, 0x402};
+    for(uint32_t id : expected){
+        const CANFrame* frame = scheduler.peek(0);
+        TEST_ASSERT_EQUAL_HEX32(id, frame->getId());
+        scheduler.drop(0);
+    }
+    TEST_ASSERT_TRUE(scheduler.empty());
+}
+
+void test_scheduler_stream_rate_limit(){
+    CANTxScheduler<8> scheduler;
+    TEST_ASSERT_TRUE(scheduler.addStream(0x100, 0x7F0, 1000, 2));
+    for(uint8_t i=0; i<4; i++) TEST_ASSERT_TRUE(scheduler.push(makeFrame(0x101, 8)));
+    TEST_ASSERT_TRUE(scheduler.push(makeFrame(0x200, 8)));
+    TEST_ASSERT_TRUE(scheduler.push(makeFrame(0x201, 8)));
+
+    //Burst of two, then the frames of the stream wait and lower priority frames pass
+    const uint32_t expected[] = {0x101, 0x101, 0x200, 0x201};
+    for(uint32_t id : expected) TEST_ASSERT_EQUAL_HEX32(id, popId(scheduler, 0));
+    TEST_ASSERT_NULL(scheduler.peek(0));
+    TEST_ASSERT_NULL(scheduler.peek(999));
+    TEST_ASSERT_EQUAL_HEX32(0x101, popId(scheduler, 1000));
+    TEST_ASSERT_NULL(scheduler.peek(1500));
+    TEST_ASSERT_EQUAL_HEX32(0x101, popId(scheduler, 2000));
+    TEST_ASSERT_TRUE(scheduler.empty());
+
+    //Frames outside the stream are not limited
+    scheduler.clearStreams();
+    for(uint8_t i=0; i<3; i++) TEST_ASSERT_TRUE(scheduler.push(makeFrame(0x101, 8)));
+    for(uint8_t i=0; i<3; i++) TEST_ASSERT_EQUAL_HEX32(0x101, popId(scheduler, 2000));
+}
+
+void test_scheduler_load_limit(){
+    const uint32_t BITRATE = 500000;
+    const uint32_t DURATION_US = 100000;
+    CANTxScheduler<8> scheduler;
+    scheduler.setLoadLimit(250, BITRATE);
+    TEST_ASSERT_EQUAL(250, scheduler.getLoadLimit());
+
+    //Keep the queue full and take frames as fast as allowed
+    uint32_t bits = 0;
+    for(uint32_t t=0; t<DURATION_US; t+=10){
+        while(scheduler.push(makeFrame(0x123, 8, t)));
+        while(scheduler.peek(t) != nullptr){
+            scheduler.drop(t);
+            bits += CANFrame::getBusBits(8, false);
+        }
+    }
+    uint32_t load = uint64_t(bits) * 1000000 / (uint64_t(BITRATE) * DURATION_US / 1000);
+    TEST_ASSERT_UINT32_WITHIN(15, 250, load);   // Includes the initial burst of four frames
+
+    scheduler.setLoadLimit(1000, BITRATE);
+    TEST_ASSERT_EQUAL(1000, scheduler.getLoadLimit());
+    TEST_ASSERT_NOT_NULL(scheduler.peek(DURATION_US));
+}
+
+struct BenchmarkResult {
+    uint32_t controlMaxUs;
+    uint32_t controlAvgUs;
+    uint32_t controlCount;
+    uint32_t diagMaxUs;
+    uint32_t diagCount;
+    uint32_t backgroundMaxUs;
+    uint16_t busLoad;
+};
+
+/**
+ * @brief Simulate one node sending a 1 ms control frame and bursts of diagnostic frames, while a second node sends a low-priority
+ *        background frame.
+ * @param useScheduler Queue the frames of the node in the scheduler and hand them to the bus one at a time.
+ * @param shape Limit the diagnostic stream and the load of the node.
+ */
+BenchmarkResult runBenchmark(bool useScheduler, bool shape){
+    static const uint32_t CONTROL_ID = 0x100;
+    static const uint32_t DIAG_ID = 0x700;
+    static const uint32_t DURATION_US = 1000000;
+    static const uint32_t STEP_US = 10;                 // Reaction time of the feeding task
+    static BenchmarkResult result;
+    static VirtualCANBus bus(500000);
+    static CANTxScheduler<64> scheduler;
+
+    for(uint8_t i=0; i<VirtualCANBus::MAX_NODES; i++) bus.detach(i);
+    int8_t node = bus.attach();
+    int8_t other = bus.attach();
+    scheduler.clear();
+    scheduler.clearStreams();
+    scheduler.setLoadLimit(shape ? 600 : 1000, bus.getBitrate());
+    if(shape) scheduler.addStream(DIAG_ID, 0x700, 1000, 4);
+    result = {};
+    uint64_t controlTotal = 0;
+    bus.setTransmitCallback([&controlTotal](uint8_t sender, const CANFrame& frame, uint64_t /*queuedUs*/, uint64_t doneUs) {
+        uint32_t latency = (uint32_t(doneUs) - frame.getTimestamp()) & CANFrame::TIMESTAMP_MASK;
+        if(sender != 0){
+            if(latency > result.backgroundMaxUs) result.backgroundMaxUs = latency;
+        } else if(frame.getId() == CONTROL_ID){
+            if(latency > result.controlMaxUs) result.controlMaxUs = latency;
+            controlTotal += latency;
+            result.controlCount++;
+        } else {
+            if(latency > result.diagMaxUs) result.diagMaxUs = latency;
+            result.diagCount++;
+        }
+    });
+    bus.run(1000);
+    bus.resetStatistics();
+
+    uint64_t start = bus.now();
+    for(uint32_t t=0; t<DURATION_US; t+=STEP_US){
+        uint32_t now = bus.now();
+        if(t % 1000 == 500) bus.transmit(other, makeFrame(0x7C0, 8, now));
+        if(t % 20000 == 0){
+            for(uint8_t i=0; i<20; i++){
+                CANFrame frame = makeFrame(DIAG_ID + i, 8, now);
+                useScheduler ? scheduler.push(frame) : bus.transmit(node, frame);
+            }
+        }
+        if(t % 1000 == 0){
+            CANFrame frame = makeFrame(CONTROL_ID, 8, now);
+            useScheduler ? scheduler.push(frame) : bus.transmit(node, frame);
+        }
+        const CANFrame* frame;
+        while(useScheduler && bus.pending(node) == 0 && (frame = scheduler.peek(now)) != nullptr){
+            bus.transmit(node, *frame);
+            scheduler.drop(now);
+        }
+        bus.run(STEP_US);
+        CANFrame received;
+        while(bus.receive(node, received));
+        while(bus.receive(other, received));
+    }
+    TEST_ASSERT_EQUAL(DURATION_US, bus.now() - start);
+    result.controlAvgUs = result.controlCount ? controlTotal / result.controlCount : 0;
+    result.busLoad = bus.getBusLoad();
+    bus.setTransmitCallback(nullptr);
+    return result;
+}
+
+void measure_queuing_delay(){
+    const char* names[] = {"FIFO (TWAI driver)", "Priority scheduler", "Priority scheduler, shaped"};
+    BenchmarkResult results[3];
+    for(uint8_t i=0; i<3; i++){
+        results[i] = runBenchmark(i > 0, i == 2);
+    }
+    uint32_t frameUs = CANFrame::getBusBits(8, false) * 1000000ULL / 500000;
+
+    printf("MEASUREMENT: Control frame every 1 ms, 20 diagnostic frames every 20 ms, background frame every 1 ms, 500 kbit/s\n");
+    for(uint8_t i=0; i<3; i++){
+        printf("MEASUREMENT:   %-28s control %4u frames, delay avg %4u us, max %4u us | diagnostic %4u frames, max %5u us | background max %4u us | bus load %u permille\n",
+               names[i], unsigned(results[i].controlCount), unsigned(results[i].controlAvgUs), unsigned(results[i].controlMaxUs),
+               unsigned(results[i].diagCount), unsigned(results[i].diagMaxUs), unsigned(results[i].backgroundMaxUs), unsigned(results[i].busLoad));
+    }
+    for(const BenchmarkResult& result : results){
+        TEST_ASSERT_EQUAL(1000, result.controlCount);
+        TEST_ASSERT_EQUAL(1000, result.diagCount);
+    }
+    //FIFO: the control frame waits for the whole burst. Scheduler: at most for one frame of each node in transmission.
+    TEST_ASSERT_GREATER_THAN(10 * frameUs, results[0].controlMaxUs);
+    TEST_ASSERT_LESS_OR_EQUAL(3 * frameUs + 10, results[1].controlMaxUs);
+    TEST_ASSERT_LESS_OR_EQUAL(3 * frameUs + 10, results[2].controlMaxUs);
+    //Shaping spreads the burst over the stream interval, the diagnostic frames wait longer
+    TEST_ASSERT_GREATER_THAN(results[1].diagMaxUs, results[2].diagMaxUs);
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_scheduler_priority_order);
+    RUN_TEST(test_scheduler_full_queue_eviction);
+    RUN_TEST(test_scheduler_stream_rate_limit);
+    RUN_TEST(test_scheduler_load_limit);
+    RUN_TEST(measure_queuing_delay);
+    return UNITY_END();
+}
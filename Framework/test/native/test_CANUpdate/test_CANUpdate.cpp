@@ -0,0 +1,128 @@
+#include <unity.h>
+#include <stdio.h>
+#include "CANInterface.h"
+#include "CANUpdateClient.h"
+#include "CANUpdateServer.h"
+#include "FileUpdateTarget.h"
+#include "VirtualCANBus.h"
+#include "VirtualCANCore.h"
+
+/*
+Host tests for updates into a file. Run with the PlatformIO native environment with include/host on the include path (build_flags = -I include/host).
+A client and a server node are connected by a simulated bus, the simulated bus time follows micros().
+The transfers without a file system are tested on the target in test/embedded/Modules/MainModule/test_CANUpdate.
+*/
+
+#ifndef UPDATE_TEST_FILE
+#define UPDATE_TEST_FILE "/tmp/cantram_update.bin"
+#endif
+
+static const uint8_t NODE_ID = 5;
+static const uint32_t CAPACITY = 65536;
+
+VirtualCANBus bus(500000);
+VirtualCANCore clientCore(bus), serverCore(bus);
+CANInterface clientCAN, serverCAN;
+CANUpdateServer server(NODE_ID);
+CANUpdateClient client;
+uint8_t image[CAPACITY];
+uint32_t lastPump = 0;
+uint32_t maxServerProcessUs = 0;
+
+/**
+ * @brief Advance the bus to micros() and process both nodes.
+ * @details The client is only processed once its transmit queue is empty. On the host the loop is much faster than the bus
+ *          and every segment rejected by the full queue would be reported.
+ */
+void pump(){
+    uint32_t now = micros();
+    bus.run(now - lastPump);
+    lastPump = now;
+    if(bus.pending(clientCore.getNode()) == 0) clientCAN.process();
+    uint32_t start = micros();
+    serverCAN.process();
+    uint32_t duration = micros() - start;
+    if(duration > maxServerProcessUs) maxServerProcessUs = duration;
+}
+
+/**
+ * @brief Run a transfer until it is finished.
+ */
+CANUpdateClient::Result transfer(uint8_t type, uint32_t size){
+    TEST_ASSERT_TRUE(client.start(NODE_ID, type, image, size));
+    uint32_t start = millis();
+    while(client.isBusy() && millis() - start < 20000){
+        pump();
+    }
+    TEST_ASSERT_FALSE(client.isBusy());
+    return client.getResult();
+}
+
+void startBus(uint32_t bitrate){
+    CANInterface* interfaces[] = {&clientCAN, &serverCAN};
+    VirtualCANCore* cores[] = {&clientCore, &serverCore};
+    bus.setBitrate(bitrate);
+    for(uint8_t i=0; i<2; i++){
+        cores[i]->end();
+        cores[i]->setBaudrate(CANCore::Baudrate(bitrate));
+        interfaces[i]->setCANCore(cores[i]);
+        interfaces[i]->begin();
+    }
+    lastPump = micros();
+}
+
+//Runs before tests
+void setUp(){
+    client.end();
+    server.end();
+    clientCAN.clearListeners();
+    serverCAN.clearListeners();
+    startBus(500000);
+    server.begin(&serverCAN);
+    client.begin(&clientCAN);
+    maxServerProcessUs = 0;
+    uint32_t seed = 12345;
+    for(uint32_t i=0; i<CAPACITY; i++){
+        seed = seed * 1103515245 + 12345;
+        image[i] = seed >> 16;
+    }
+}
+
+//Runs after tests
+void tearDown(){
+}
+
+void measure_update_throughput(){
+    FileUpdateTarget file(UPDATE_TEST_FILE, CAPACITY);
+    server.setTarget(CANUpdate::IMAGE_CONFIGURATION, &file);
+    const uint32_t bitrates[] = {500000, 1000000};
+    printf("MEASUREMENT: Update of a %u KB image into a file, %u segments per block, window %u:\n",
+           unsigned(CAPACITY / 1024), unsigned(CANUpdate::MAX_BLOCK_SEGMENTS), unsigned(CANUpdate::MAX_WINDOW));
+    for(uint8_t i=0; i<2; i++){
+        startBus(bitrates[i]);
+        maxServerProcessUs = 0;
+        TEST_ASSERT_EQUAL(CANUpdateClient::RESULT_OK, transfer(CANUpdate::IMAGE_CONFIGURATION, CAPACITY));
+        uint32_t bytesPerSecond = uint64_t(CAPACITY) * 1000 / client.getDurationMs();
+        //Upper bound: 8 data bytes per frame of 111 bits without stuff bits, 7 of them are image data
+        uint32_t limit = uint64_t(bitrates[i]) * 7 / 111 * 64 / 65;
+        printf("MEASUREMENT:   %u kbit/s: %u ms, %u B/s (%u %% of the protocol limit), max. server process() %u us\n",
+               unsigned(bitrates[i] / 1000), unsigned(client.getDurationMs()), unsigned(bytesPerSecond),
+               unsigned(bytesPerSecond * 100 / limit), unsigned(maxServerProcessUs));
+        TEST_ASSERT_GREATER_THAN(limit / 2, bytesPerSecond);
+
+        FILE* f = fopen(UPDATE_TEST_FILE, "rb");
+        TEST_ASSERT_NOT_NULL(f);
+        static uint8_t readBack[CAPACITY];
+        TEST_ASSERT_EQUAL(CAPACITY, fread(readBack, 1, CAPACITY, f));
+        fclose(f);
+        TEST_ASSERT_EQUAL_MEMORY(image, readBack, CAPACITY);
+    }
+    server.setTarget(CANUpdate::IMAGE_CONFIGURATION, nullptr);
+    remove(UPDATE_TEST_FILE);
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(measure_update_throughput);
+    return UNITY_END();
+}
@@ -0,0 +1,457 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ModbusRTUMaster.h"
+
+/*
+Host tests for the Modbus RTU master. Run with the PlatformIO native environment on Linux.
+The master talks through a pseudo-terminal to a simulated slave running in a second thread. The pseudo-terminal transfers
+bytes without the delay of a real line, the master still keeps the T3.5 silence calculated for the configured baudrate.
+*/
+
+static const uint32_t BAUDRATE = 115200;
+static const uint16_t SLAVE_REGISTERS = 64;
+
+uint32_t nowUs(){
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Port of the master on the terminal side of the pseudo-terminal.
+ */
+struct PtyPort {
+    int fd = -1;
+
+    size_t write(const uint8_t* data, size_t length){
+        ssize_t written = ::write(fd, data, length);
+        return written > 0 ? written : 0;
+    }
+
+    size_t read(uint8_t* buffer, size_t capacity){
+        ssize_t length = ::read(fd, buffer, capacity);
+        return length > 0 ? length : 0;
+    }
+};
+
+/**
+ * @brief Slaves answering on the controlling side of the pseudo-terminal.
+ * @details Every slave address has its own registers and bits, initialized to recognizable values. Slave addresses can be set
+ *          to not respond, to respond with a wrong CRC or to pause in the middle of the response.
+ */
+class SimulatedSlaves {
+public:
+    enum Behaviour { NORMAL, NO_RESPONSE, BAD_CRC, GAP };
+
+    struct Slave {
+        uint16_t holding[SLAVE_REGISTERS];
+        uint16_t input[SLAVE_REGISTERS];
+        bool coils[SLAVE_REGISTERS];
+        bool discreteInputs[SLAVE_REGISTERS];
+        Behaviour behaviour;
+    };
+
+    std::mutex mutex;
+    Slave slaves[Modbus::MAX_SLAVE + 1];
+    std::atomic<uint32_t> requests{0};
+    std::atomic<uint32_t> broadcasts{0};
+
+    void start(int fd){
+        _fd = fd;
+        for(uint16_t address=0; address<=Modbus::MAX_SLAVE; address++){
+            Slave& slave = slaves[address];
+            for(uint16_t i=0; i<SLAVE_REGISTERS; i++){
+                slave.holding[i] = address * 1000 + i;
+                slave.input[i] = 0x8000 | (address * 100 + i);
+                slave.coils[i] = (i + address) % 3 == 0;
+                slave.discreteInputs[i] = (i * address) % 5 == 1;
+            }
+            slave.behaviour = NORMAL;
+        }
+        requests = 0;
+        broadcasts = 0;
+        _running = true;
+        _thread = std::thread([this](){ run(); });
+    }
+
+    void stop(){
+        _running = false;
+        if(_thread.joinable()) _thread.join();
+    }
+
+private:
+    int _fd = -1;
+    std::atomic<bool> _running{false};
+    std::thread _thread;
+
+    void run(){
+        uint8_t frame[Modbus::MAX_ADU_SIZE];
+        size_t length = 0;
+        while(_running){
+            pollfd descriptor = {_fd, POLLIN, 0};
+            if(poll(&descriptor, 1, length > 0 ? 2 : 10) <= 0){
+                length = 0;         // Incomplete frame followed by silence
+                continue;
+            }
+            ssize_t received = read(_fd, &frame[length], sizeof(frame) - length);
+            if(received <= 0) continue;
+            length += received;
+            size_t expected = Modbus::frameLength(frame, length, true);
+            if(expected > 0 && length >= expected){
+                handle(frame, expected);
+                length = 0;
+            }
+        }
+    }
+
+    void handle(const uint8_t* request, size_t length){
+        if(!Modbus::checkCrc(request, length)) return;
+        uint8_t address = request[0];
+        uint8_t response[Modbus::MAX_ADU_SIZE];
+        size_t responseLength;
+        Behaviour behaviour;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests++;
+            if(address == Modbus::BROADCAST){
+                broadcasts++;
+                for(uint16_t i=1; i<=Modbus::MAX_SLAVE; i++) process(slaves[i], request, response);
+                return;
+            }
+            behaviour = slaves[address].behaviour;
+            if(behaviour == NO_RESPONSE) return;
+            responseLength = process(slaves[address], request, response);
+        }
+        response[0] = address;
+        responseLength = Modbus::appendCrc(response, responseLength);
+        if(behaviour == BAD_CRC) response[responseLength - 1] ^= 0x5A;
+        if(behaviour == GAP){
+            (void)!::write(_fd, response, responseLength / 2);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            (void)!::write(_fd, &response[responseLength / 2], responseLength - responseLength / 2);
+        } else {
+            (void)!::write(_fd, response, responseLength);
+        }
+    }
+
+    /**
+     * @brief Execute a request.
+     * @return size_t Length of the response without CRC.
+     */
+    size_t process(Slave& slave, const uint8_t* request, uint8_t* response){
+        uint8_t function = request[1];
+        uint16_t start = Modbus::get16(&request[2]);
+        uint16_t count = Modbus::get16(&request[4]);
+        response[1] = function;
+        switch(function){
+            case Modbus::READ_COILS:
+            case Modbus::READ_DISCRETE_INPUTS: {
+                if(start + count > SLAVE_REGISTERS) return exception(response, Modbus::ILLEGAL_DATA_ADDRESS);
+                const bool* bits = function == Modbus::READ_COILS ? slave.coils : slave.discreteInputs;
+                response[2] = (count + 7) / 8;
+                memset(&response[3], 0, response[2]);
+                for(uint16_t i=0; i<count; i++) if(bits[start + i]) response[3 + i / 8] |= 1 << (i % 8);
+                return 3 + response[2];
+            }
+            case Modbus::READ_HOLDING_REGISTERS:
+            case Modbus::READ_INPUT_REGISTERS: {
+                if(start + count > SLAVE_REGISTERS) return exception(response, Modbus::ILLEGAL_DATA_ADDRESS);
+                const uint16_t* registers = function == Modbus::READ_HOLDING_REGISTERS ? slave.holding : slave.input;
+                response[2] = 2 * count;
+                for(uint16_t i=0; i<count; i++) Modbus::put16(&response[3 + 2 * i], registers[start + i]);
+                return 3 + response[2];
+            }
+            case Modbus::WRITE_SINGLE_COIL:
+                if(start >= SLAVE_REGISTERS) return exception(response, Modbus::ILLEGAL_DATA_ADDRESS);
+                if(count != 0xFF00 && count != 0) return exception(response, Modbus::ILLEGAL_DATA_VALUE);
+                slave.coils[start] = count == 0xFF00;
+                memcpy(&response[2], &request[2], 4);
+                return 6;
+            case Modbus::WRITE_SINGLE_REGISTER:
+                if(start >= SLAVE_REGISTERS) return exception(response, Modbus::ILLEGAL_DATA_ADDRESS);
+                slave.holding[start] = count;
+                memcpy(&response[2], &request[2], 4);
+                return 6;
+            case Modbus::WRITE_MULTIPLE_REGISTERS:
+                if(start + count > SLAVE_REGISTERS) return exception(response, Modbus::ILLEGAL_DATA_ADDRESS);
+                for(uint16_t i=0; i<count; i++) slave.holding[start + i] = Modbus::get16(&request[7 + 2 * i]);
+                memcpy(&response[2], &request[2], 4);
+                return 6;
+            default:
+                return exception(response, Modbus::ILLEGAL_FUNCTION);
+        }
+    }
+
+    size_t exception(uint8_t* response, Modbus::Exception code){
+        response[1] |= Modbus::EXCEPTION_FLAG;
+        response[2] = code;
+        return 3;
+    }
+};
+
+struct WriteResult {
+    uint8_t slave;
+    uint16_t address;
+    ModbusRTUMaster<PtyPort>::Result result;
+    Modbus::Exception exception;
+};
+
+PtyPort port;
+ModbusRTUMaster<PtyPort>* master = nullptr;
+SimulatedSlaves simulation;
+int controller = -1;
+
+/**
+ * @brief Cycle the master like a control loop with a period of about 50 us.
+ * @param maxCycleUs Set to the longest cycle() call, if given.
+ */
+void runFor(uint32_t durationUs, uint32_t* maxCycleUs = nullptr){
+    uint32_t start = nowUs();
+    while(nowUs() - start < durationUs){
+        uint32_t time = nowUs();
+        master->cycle(time);
+        uint32_t duration = nowUs() - time;
+        if(maxCycleUs && duration > *maxCycleUs) *maxCycleUs = duration;
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+/**
+ * @brief Bitwise CRC16 for comparison with the table.
+ */
+uint16_t crc16Bitwise(const uint8_t* data, size_t length){
+    uint16_t crc = 0xFFFF;
+    for(size_t i=0; i<length; i++){
+        crc ^= data[i];
+        for(uint8_t bit=0; bit<8; bit++) crc = crc & 1 ? (crc >> 1) ^ 0xA001 : crc >> 1;
+    }
+    return crc;
+}
+
+//Runs before tests
+void setUp(){
+    controller = posix_openpt(O_RDWR | O_NOCTTY);
+    if(controller < 0 || grantpt(controller) != 0 || unlockpt(controller) != 0) return;
+    port.fd = open(ptsname(controller), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if(port.fd < 0) return;
+    termios settings;
+    tcgetattr(port.fd, &settings);
+    cfmakeraw(&settings);
+    tcsetattr(port.fd, TCSANOW, &settings);
+    master = new ModbusRTUMaster<PtyPort>(port);
+    master->begin(BAUDRATE);
+    simulation.start(controller);
+}
+
+//Runs after tests
+void tearDown(){
+    simulation.stop();
+    delete master;
+    master = nullptr;
+    if(port.fd >= 0) close(port.fd);
+    if(controller >= 0) close(controller);
+    port.fd = -1;
+    controller = -1;
+}
+
+void test_modbus_crc_and_framing(){
+    //Read holding registers 0-9 of slave 1, CRC 0xCDC5
+    uint8_t frame[8] = {0x01, 0x03, 0x00, 0x00, 0x00, 0x0A};
+    TEST_ASSERT_EQUAL(8, Modbus::appendCrc(frame, 6));
+    TEST_ASSERT_EQUAL_HEX8(0xC5, frame[6]);
+    TEST_ASSERT_EQUAL_HEX8(0xCD, frame[7]);
+    TEST_ASSERT_TRUE(Modbus::checkCrc(frame, 8));
+    frame[3] ^= 1;
+    TEST_ASSERT_FALSE(Modbus::checkCrc(frame, 8));
+    for(uint16_t i=0; i<sizeof(frame); i++) TEST_ASSERT_EQUAL_HEX16(crc16Bitwise(frame, i), Modbus::crc16(frame, i));
+
+    uint8_t writeRequest[] = {0x11, 0x10, 0x00, 0x01, 0x00, 0x02, 0x04};
+    uint8_t readResponse[] = {0x11, 0x03, 0x06};
+    uint8_t exception[] = {0x11, 0x83};
+    TEST_ASSERT_EQUAL(0, Modbus::frameLength(writeRequest, 6, true));
+    TEST_ASSERT_EQUAL(13, Modbus::frameLength(writeRequest, 7, true));
+    TEST_ASSERT_EQUAL(8, Modbus::frameLength(writeRequest, 2, false));
+    TEST_ASSERT_EQUAL(11, Modbus::frameLength(readResponse, 3, false));
+    TEST_ASSERT_EQUAL(8, Modbus::frameLength(readResponse, 2, true));
+    TEST_ASSERT_EQUAL(5, Modbus::frameLength(exception, 2, false));
+
+    TEST_ASSERT_EQUAL(1146, Modbus::charTimeUs(9600));
+    TEST_ASSERT_EQUAL(1719, Modbus::t15Us(9600));
+    TEST_ASSERT_EQUAL(4011, Modbus::t35Us(9600));
+    TEST_ASSERT_EQUAL(750, Modbus::t15Us(115200));
+    TEST_ASSERT_EQUAL(1750, Modbus::t35Us(115200));
+}
+
+void test_modbus_master_polling(){
+    if(!master) TEST_IGNORE_MESSAGE("pseudo-terminal not available");
+    int8_t holding = master->addPoll(1, Modbus::READ_HOLDING_REGISTERS, 0, 10, 20000);
+    int8_t input = master->addPoll(2, Modbus::READ_INPUT_REGISTERS, 5, 20, 50000);
+    int8_t coils = master->addPoll(3, Modbus::READ_COILS, 0, 37, 100000);
+    int8_t discrete = master->addPoll(3, Modbus::READ_DISCRETE_INPUTS, 10, 16, 100000);
+    TEST_ASSERT_EQUAL(0, holding);
+    TEST_ASSERT_EQUAL(3, discrete);
+    TEST_ASSERT_EQUAL(-1, master->addPoll(0, Modbus::READ_COILS, 0, 1, 1000));
+    TEST_ASSERT_EQUAL(-1, master->addPoll(1, Modbus::WRITE_SINGLE_COIL, 0, 1, 1000));
+    TEST_ASSERT_EQUAL(-1, master->addPoll(1, Modbus::READ_INPUT_REGISTERS, 0, 126, 1000));
+    TEST_ASSERT_FALSE(master->getStatus(holding).valid);
+
+    runFor(1000000);
+
+    const uint16_t* registers = master->getRegisters(holding);
+    for(uint16_t i=0; i<10; i++) TEST_ASSERT_EQUAL_HEX16(1000 + i, registers[i]);
+    registers = master->getRegisters(input);
+    for(uint16_t i=0; i<20; i++) TEST_ASSERT_EQUAL_HEX16(0x8000 | (200 + 5 + i), registers[i]);
+    for(uint16_t i=0; i<37; i++) TEST_ASSERT_EQUAL(simulation.slaves[3].coils[i], master->getBit(coils, i));
+    for(uint16_t i=0; i<16; i++) TEST_ASSERT_EQUAL(simulation.slaves[3].discreteInputs[10 + i], master->getBit(discrete, i));
+    TEST_ASSERT_FALSE(master->getBit(coils, 37));
+
+    //Every poll keeps its own rate
+    TEST_ASSERT_UINT32_WITHIN(3, 50, master->getStatus(holding).responses);
+    TEST_ASSERT_UINT32_WITHIN(2, 20, master->getStatus(input).responses);
+    TEST_ASSERT_UINT32_WITHIN(1, 10, master->getStatus(coils).responses);
+    TEST_ASSERT_UINT32_WITHIN(1, 10, master->getStatus(discrete).responses);
+    const ModbusRTUMaster<PtyPort>::Statistics& statistics = master->getStatistics();
+    TEST_ASSERT_EQUAL(statistics.requests, simulation.requests.load());
+    TEST_ASSERT_UINT32_WITHIN(1, statistics.requests, statistics.responses);
+    TEST_ASSERT_EQUAL(0, statistics.timeouts + statistics.crcErrors + statistics.frameErrors + statistics.exceptions);
+    TEST_ASSERT_EQUAL(0, statistics.lateRequests);
+
+    //A changed value shows up in the image within one interval
+    {
+        std::lock_guard<std::mutex> lock(simulation.mutex);
+        simulation.slaves[1].holding[3] = 0xCAFE;
+    }
+    runFor(25000);
+    TEST_ASSERT_EQUAL_HEX16(0xCAFE, master->getRegisters(holding)[3]);
+}
+
+void test_modbus_master_write(){
+    if(!master) TEST_IGNORE_MESSAGE("pseudo-terminal not available");
+    std::vector<WriteResult> results;
+    master->setWriteCallback([&](uint8_t slave, uint16_t address, ModbusRTUMaster<PtyPort>::Result result, Modbus::Exception exception){
+        results.push_back({slave, address, result, exception});
+    });
+    master->setTurnaround(5000);
+    int8_t poll = master->addPoll(1, Modbus::READ_HOLDING_REGISTERS, 0, 10, 10000);
+    runFor(5000);
+
+    uint16_t values[5] = {11, 22, 33, 44, 55};
+    TEST_ASSERT_TRUE(master->writeRegister(1, 4, 0xBEEF));
+    TEST_ASSERT_TRUE(master->writeRegisters(2, 10, values, 5));
+    TEST_ASSERT_TRUE(master->writeCoil(3, 7, true));
+    TEST_ASSERT_TRUE(master->writeRegister(0, 0, 0x1234));
+    TEST_ASSERT_TRUE(master->writeRegister(1, 1000, 1));
+    TEST_ASSERT_FALSE(master->writeRegisters(1, 0, values, 0));
+    runFor(50000);
+
+    //Writes are sent in queue order before the next polls
+    TEST_ASSERT_EQUAL(5, results.size());
+    if(results.size() != 5) return;
+    for(uint8_t i=0; i<4; i++) TEST_ASSERT_EQUAL(ModbusRTUMaster<PtyPort>::OK, results[i].result);
+    TEST_ASSERT_EQUAL(2, results[1].slave);
+    TEST_ASSERT_EQUAL(10, results[1].address);
+    TEST_ASSERT_EQUAL(0, results[3].slave);
+    TEST_ASSERT_EQUAL(ModbusRTUMaster<PtyPort>::EXCEPTION, results[4].result);
+    TEST_ASSERT_EQUAL(Modbus::ILLEGAL_DATA_ADDRESS, results[4].exception);
+    TEST_ASSERT_EQUAL(1, simulation.broadcasts.load());
+    {
+        std::lock_guard<std::mutex> lock(simulation.mutex);
+        TEST_ASSERT_EQUAL_HEX16(0xBEEF, simulation.slaves[1].holding[4]);
+        TEST_ASSERT_EQUAL_MEMORY(values, &simulation.slaves[2].holding[10], sizeof(values));
+        TEST_ASSERT_TRUE(simulation.slaves[3].coils[7]);
+        for(uint16_t i=1; i<=Modbus::MAX_SLAVE; i++) TEST_ASSERT_EQUAL_HEX16(0x1234, simulation.slaves[i].holding[0]);
+    }
+    TEST_ASSERT_EQUAL_HEX16(0x1234, master->getRegisters(poll)[0]);
+    TEST_ASSERT_EQUAL_HEX16(0xBEEF, master->getRegisters(poll)[4]);
+    TEST_ASSERT_TRUE(master->isIdle() || master->getStatus(poll).responses > 0);
+}
+
+void test_modbus_master_errors(){
+    if(!master) TEST_IGNORE_MESSAGE("pseudo-terminal not available");
+    simulation.slaves[7].behaviour = SimulatedSlaves::BAD_CRC;
+    simulation.slaves[8].behaviour = SimulatedSlaves::NO_RESPONSE;
+    simulation.slaves[9].behaviour = SimulatedSlaves::GAP;
+    master->setTimeout(20000);
+    master->setStrictTiming(true);
+    int8_t good = master->addPoll(1, Modbus::READ_HOLDING_REGISTERS, 0, 4, 10000);
+    int8_t badCrc = master->addPoll(7, Modbus::READ_HOLDING_REGISTERS, 0, 4, 10000);
+    int8_t silent = master->addPoll(8, Modbus::READ_HOLDING_REGISTERS, 0, 4, 50000);
+    int8_t gap = master->addPoll(9, Modbus::READ_INPUT_REGISTERS, 0, 8, 20000);
+    int8_t illegal = master->addPoll(1, Modbus::READ_HOLDING_REGISTERS, 60, 8, 20000);
+    runFor(500000);
+
+    //Timeouts and errors of some slaves do not stop the others
+    TEST_ASSERT_GREATER_THAN(25, master->getStatus(good).responses);
+    TEST_ASSERT_TRUE(master->getStatus(good).valid);
+    TEST_ASSERT_EQUAL(0, master->getStatus(badCrc).responses);
+    TEST_ASSERT_GREATER_THAN(20, master->getStatus(badCrc).errors);
+    TEST_ASSERT_EQUAL(ModbusRTUMaster<PtyPort>::CRC_ERROR, master->getStatus(badCrc).lastResult);
+    TEST_ASSERT_GREATER_THAN(5, master->getStatus(silent).timeouts);
+    TEST_ASSERT_EQUAL(0, master->getStatus(silent).responses);
+    TEST_ASSERT_EQUAL(0, master->getStatus(gap).responses);
+    TEST_ASSERT_GREATER_THAN(5, master->getStatus(gap).errors);
+    TEST_ASSERT_GREATER_THAN(10, master->getStatus(illegal).exceptions);
+    TEST_ASSERT_EQUAL(Modbus::ILLEGAL_DATA_ADDRESS, master->getStatus(illegal).lastException);
+    TEST_ASSERT_FALSE(master->getStatus(illegal).valid);
+
+    //Without strict timing the pause inside the response is accepted
+    master->setStrictTiming(false);
+    uint32_t errors = master->getStatus(gap).errors;
+    runFor(200000);
+    TEST_ASSERT_GREATER_THAN(2, master->getStatus(gap).responses);
+    TEST_ASSERT_UINT32_WITHIN(1, errors, master->getStatus(gap).errors);
+    TEST_ASSERT_EQUAL_HEX16(0x8000 | 903, master->getRegisters(gap)[3]);
+}
+
+void measure_modbus_polling(){
+    if(!master) TEST_IGNORE_MESSAGE("pseudo-terminal not available");
+    const uint32_t DURATION_US = 1000000;
+    for(uint8_t i=0; i<ModbusRTUMaster<PtyPort>::MAX_POLLS; i++){
+        master->addPoll(1 + i % 16, i % 2 ? Modbus::READ_INPUT_REGISTERS : Modbus::READ_HOLDING_REGISTERS, i, 16, 0);
+    }
+    uint32_t maxCycleUs = 0;
+    uint32_t start = nowUs();
+    runFor(DURATION_US, &maxCycleUs);
+    uint32_t elapsedUs = nowUs() - start;
+    const ModbusRTUMaster<PtyPort>::Statistics& statistics = master->getStatistics();
+    TEST_ASSERT_EQUAL(0, statistics.timeouts + statistics.crcErrors + statistics.frameErrors);
+
+    //Request 8 and response 37 characters, each followed by T3.5
+    uint32_t lineUs = (8 + 37) * Modbus::charTimeUs(BAUDRATE);
+    uint32_t limit = 1000000 / (8 * Modbus::charTimeUs(BAUDRATE) + 2 * master->getT35());
+    printf("MEASUREMENT: %u polls of 16 registers at %u baud, as fast as possible: %u transactions/s (%u/s on a real line with %u us of characters per transaction), max cycle() %u us\n",
+           ModbusRTUMaster<PtyPort>::MAX_POLLS, BAUDRATE, uint32_t(uint64_t(statistics.responses) * 1000000 / elapsedUs),
+           uint32_t(1000000 / (lineUs + 2 * master->getT35())), lineUs, maxCycleUs);
+    TEST_ASSERT_GREATER_THAN(limit / 2, statistics.responses);
+
+    const uint32_t CRC_BYTES = 10000000;
+    static uint8_t data[256];
+    for(uint16_t i=0; i<sizeof(data); i++) data[i] = i * 31;
+    uint16_t crc = 0;
+    auto tableStart = std::chrono::steady_clock::now();
+    for(uint32_t i=0; i<CRC_BYTES / sizeof(data); i++) crc ^= Modbus::crc16(data, sizeof(data), i);
+    auto tableEnd = std::chrono::steady_clock::now();
+    for(uint32_t i=0; i<CRC_BYTES / sizeof(data); i++) crc ^= crc16Bitwise(data, sizeof(data)) + i;
+    auto bitwiseEnd = std::chrono::steady_clock::now();
+    double tableNs = std::chrono::duration<double, std::nano>(tableEnd - tableStart).count() / CRC_BYTES;
+    double bitwiseNs = std::chrono::duration<double, std::nano>(bitwiseEnd - tableEnd).count() / CRC_BYTES;
+    printf("MEASUREMENT: CRC16 table %.2f ns/byte, bitwise %.2f ns/byte (%04X)\n", tableNs, bitwiseNs, crc);
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_modbus_crc_and_framing);
+    RUN_TEST(test_modbus_master_polling);
+    RUN_TEST(test_modbus_master_write);
+    RUN_TEST(test_modbus_master_errors);
+    RUN_TEST(measure_modbus_polling);
+    return UNITY_END();
+}
@@ -0,0 +1,124 @@
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include "SocketCANPort.h"
+
+/*
+Host tests for the SocketCAN port. Run with the PlatformIO native environment on Linux.
+A virtual CAN interface is needed, tests are skipped if it does not exist:
+    sudo modprobe vcan
+    sudo ip link add dev vcan0 type vcan
+    sudo ip link set up vcan0
+*/
+
+static const char* INTERFACE_NAME = "vcan0";
+
+SocketCANPort sender, receiver;
+
+CANFrame makeFrame(uint32_t sequence){
+    CANFrame frame;
+    uint8_t data[8];
+    for(uint8_t i=0; i<8; i++) data[i] = uint8_t(sequence >> (8 * (i & 3))) ^ i;
+    frame.set(0x100 + (sequence & 0xFF), false, false, data, 8, 0);
+    return frame;
+}
+
+/**
+ * @brief Receive frames until count frames arrived or the timeout expired.
+ */
+size_t receiveFrames(CANFrame* frames, size_t count, uint32_t timeoutMs = 100){
+    size_t received = 0;
+    uint32_t startTime = SocketCANPort::monotonicUs();
+    while(received < count && SocketCANPort::monotonicUs() - startTime < timeoutMs * 1000){
+        received += receiver.receive(&frames[received], count - received);
+    }
+    return received;
+}
+
+//Runs before tests
+void setUp(){
+    sender.open(INTERFACE_NAME);
+    receiver.open(INTERFACE_NAME);
+}
+
+//Runs after tests
+void tearDown(){
+    sender.close();
+    receiver.close();
+}
+
+void test_socketcan_send_receive(){
+    if(!receiver.isOpen()) TEST_IGNORE_MESSAGE("vcan0 not available");
+    CANFrame frames[3];
+    frames[0] = makeFrame(1);
+    frames[1].set(0x1ABCDEF, true, false, frames[0].data, 5, 0);
+    frames[2].set(0x7FF, false, true, nullptr, 2, 0);
+
+    uint32_t sendTime = SocketCANPort::monotonicUs();
+    TEST_ASSERT_EQUAL(3, sender.send(frames, 3));
+    CANFrame received[3];
+    TEST_ASSERT_EQUAL(3, receiveFrames(received, 3));
+    for(uint8_t i=0; i<3; i++){
+        TEST_ASSERT_EQUAL_HEX32(frames[i].idFlags, received[i].idFlags);
+        TEST_ASSERT_EQUAL(frames[i].getLength(), received[i].getLength());
+        TEST_ASSERT_EQUAL_MEMORY(frames[i].data, received[i].data, frames[i].isRemote() ? 0 : frames[i].getLength());
+        //Kernel timestamp between sending and now
+        uint32_t delay = (received[i].getTimestamp() - sendTime) & CANFrame::TIMESTAMP_MASK;
+        TEST_ASSERT_LESS_OR_EQUAL(SocketCANPort::monotonicUs() - sendTime, delay);
+    }
+    TEST_ASSERT_EQUAL(0, receiver.receive(received, 3));
+}
+
+void test_socketcan_filter(){
+    if(!receiver.isOpen()) TEST_IGNORE_MESSAGE("vcan0 not available");
+    TEST_ASSERT_TRUE(receiver.setFilter(0x120, 0x7F0, false));
+    CANFrame frames[64];
+    for(uint32_t i=0; i<64; i++) frames[i] = makeFrame(i);
+    TEST_ASSERT_EQUAL(64, sender.send(frames, 64));
+
+    CANFrame received[64];
+    size_t count = receiveFrames(received, 64, 50);
+    TEST_ASSERT_EQUAL(16, count);
+    for(size_t i=0; i<count; i++) TEST_ASSERT_EQUAL_HEX32(0x120 + i, received[i].getId());
+}
+
+void measure_socketcan_throughput(){
+    if(!receiver.isOpen()) TEST_IGNORE_MESSAGE("vcan0 not available");
+    const uint32_t FRAMES = 200000;
+    const size_t batchSizes[] = {1, SocketCANPort::BATCH_SIZE};
+    static CANFrame frames[SocketCANPort::BATCH_SIZE];
+    static CANFrame received[SocketCANPort::BATCH_SIZE];
+
+    for(size_t batchSize : batchSizes){
+        uint32_t sent = 0, count = 0, errors = 0;
+        auto startTime = std::chrono::steady_clock::now();
+        while(count + receiver.getDropped() < FRAMES){
+            size_t batch = 0;
+            while(batch < batchSize && sent + batch < FRAMES){
+                frames[batch] = makeFrame(sent + batch);
+                batch++;
+            }
+            sent += sender.send(frames, batch);
+            size_t n;
+            while((n = receiver.receive(received, batchSize)) > 0){
+                for(size_t i=0; i<n; i++){
+                    if(memcmp(received[i].data, makeFrame(count + i).data, 8) != 0) errors++;
+                }
+                count += n;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        printf("MEASUREMENT: %s, batch size %u: %u frames in %.3f s\n", INTERFACE_NAME, unsigned(batchSize), FRAMES, seconds);
+        printf("MEASUREMENT:   Throughput: %.0f frames/s, %.2f us per frame\n", FRAMES / seconds, seconds * 1e6 / FRAMES);
+        printf("MEASUREMENT:   Dropped by the kernel: %u\n", receiver.getDropped());
+        TEST_ASSERT_EQUAL(0, errors);
+    }
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_socketcan_send_receive);
+    RUN_TEST(test_socketcan_filter);
+    RUN_TEST(measure_socketcan_throughput);
+    return UNITY_END();
+}
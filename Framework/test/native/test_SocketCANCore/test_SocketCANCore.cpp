@@ -0,0 +1,164 @@
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include "SocketCANCore.h"
+#include "CANInterface.h"
+
+/*
+Host tests for the SocketCANCore driven through CANInterface, like the protocol layers use it on the ESP32.
+Run with the PlatformIO native environment on Linux with include/host on the include path (build_flags = -I include/host),
+which provides the Arduino API. A virtual CAN interface is needed, tests are skipped if it does not exist:
+    sudo modprobe vcan
+    sudo ip link add dev vcan0 type vcan
+    sudo ip link set up vcan0
+*/
+
+static const char* INTERFACE_NAME = "vcan0";
+
+SocketCANCore senderCore(INTERFACE_NAME), receiverCore(INTERFACE_NAME);
+CANInterface sender, receiver;
+
+/**
+ * @brief Listener checking the sequence number in the first four data bytes of the received frames.
+ */
+class SequenceListener : public CANListener {
+public:
+    uint32_t received = 0;
+    uint32_t errors = 0;
+    uint32_t maxDispatchUs = 0;
+    uint64_t totalDispatchUs = 0;
+    CANCore::CANMessage last = {};
+
+    bool onMessage(const CANCore::CANMessage& message) override {
+        uint32_t sequence = uint32_t(message.data[0]) | uint32_t(message.data[1]) << 8 | uint32_t(message.data[2]) << 16 | uint32_t(message.data[3]) << 24;
+        if(!message.isRemote && sequence != received) errors++;
+        uint32_t dispatchUs = micros() - receiver.getRxTimestamp();
+        if(dispatchUs > maxDispatchUs) maxDispatchUs = dispatchUs;
+        totalDispatchUs += dispatchUs;
+        last = message;
+        received++;
+        return true;
+    }
+};
+
+SequenceListener listener;
+
+CANCore::CANMessage makeMessage(uint32_t sequence){
+    CANCore::CANMessage message = {};
+    message.id = 0x100 + (sequence & 0xFF);
+    message.length = 8;
+    for(uint8_t i=0; i<4; i++) message.data[i] = sequence >> (8 * i);
+    for(uint8_t i=4; i<8; i++) message.data[i] = i;
+    return message;
+}
+
+/**
+ * @brief Process both interfaces until the listener received count frames or the timeout expired.
+ */
+void processUntil(uint32_t count, uint32_t timeoutMs = 100){
+    uint32_t startTime = millis();
+    while(listener.received < count && millis() - startTime < timeoutMs){
+        sender.process();
+        receiver.process();
+    }
+}
+
+//Runs before tests
+void setUp(){
+    listener = SequenceListener();
+    sender.setCANCore(&senderCore);
+    receiver.setCANCore(&receiverCore);
+    receiver.clearListeners();
+    receiver.addListener(&listener);
+    receiverCore.setupFilter(0, 0);
+    sender.begin();
+    receiver.begin();
+}
+
+//Runs after tests
+void tearDown(){
+    sender.end();
+    receiver.end();
+}
+
+void test_socketcan_core_interface_roundtrip(){
+    if(!receiverCore.isInitialized()) TEST_IGNORE_MESSAGE("vcan0 not available");
+    CANCore::CANMessage message = makeMessage(0);
+    uint32_t sendTime = micros();
+    TEST_ASSERT_TRUE(sender.sendMessage(message));
+    processUntil(1);
+    TEST_ASSERT_EQUAL(1, listener.received);
+    TEST_ASSERT_EQUAL_HEX32(message.id, listener.last.id);
+    TEST_ASSERT_EQUAL(8, listener.last.length);
+    TEST_ASSERT_EQUAL_MEMORY(message.data, listener.last.data, 8);
+    //The kernel receive timestamp is moved into the micros() time base
+    TEST_ASSERT_LESS_OR_EQUAL(micros() - sendTime, receiver.getRxTimestamp() - sendTime);
+
+    message = makeMessage(1);
+    message.id = 0x1ABCDEF;
+    message.isExtended = true;
+    TEST_ASSERT_TRUE(sender.sendMessage(message));
+    CANCore::CANMessage remote = {};
+    remote.id = 0x7FF;
+    remote.isRemote = true;
+    remote.length = 2;
+    TEST_ASSERT_TRUE(sender.sendMessage(remote));
+    processUntil(3);
+    TEST_ASSERT_EQUAL(3, listener.received);
+    TEST_ASSERT_EQUAL(0, listener.errors);
+    TEST_ASSERT_EQUAL_HEX32(0x7FF, listener.last.id);
+    TEST_ASSERT_TRUE(listener.last.isRemote);
+    TEST_ASSERT_EQUAL(3, senderCore.getStatistics().txFrames);
+    TEST_ASSERT_EQUAL(3, receiverCore.getStatistics().rxFrames);
+}
+
+void test_socketcan_core_filter(){
+    if(!receiverCore.isInitialized()) TEST_IGNORE_MESSAGE("vcan0 not available");
+    TEST_ASSERT_TRUE(receiverCore.setupFilter(0x120, 0x7F0));
+    for(uint32_t i=0; i<32; i++){
+        CANCore::CANMessage message = makeMessage(i);
+        message.id = 0x110 + i;
+        //Only frames 0x120..0x12F pass, numbered from 0
+        uint32_t sequence = i - 16;
+        for(uint8_t b=0; b<4; b++) message.data[b] = sequence >> (8 * b);
+        TEST_ASSERT_TRUE(sender.sendMessage(message));
+    }
+    processUntil(32, 50);
+    TEST_ASSERT_EQUAL(16, listener.received);
+    TEST_ASSERT_EQUAL(0, listener.errors);
+    TEST_ASSERT_EQUAL_HEX32(0x12F, listener.last.id);
+}
+
+void measure_socketcan_core_end_to_end(){
+    if(!receiverCore.isInitialized()) TEST_IGNORE_MESSAGE("vcan0 not available");
+    const uint32_t FRAMES = 100000;
+    uint32_t sent = 0, rejected = 0;
+    auto startTime = std::chrono::steady_clock::now();
+    while(listener.received + receiverCore.getStatistics().rxOverruns < FRAMES){
+        //Queue a batch through the interface, it is handed to the kernel by the next process()
+        for(size_t i=0; i<SocketCANPort::BATCH_SIZE && sent < FRAMES; i++){
+            if(!sender.sendMessage(makeMessage(sent))){
+                rejected++;
+                break;
+            }
+            sent++;
+        }
+        sender.process();
+        while(receiver.process() > 0);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    printf("MEASUREMENT: %s through CANInterface and SocketCANCore: %u frames in %.3f s\n", INTERFACE_NAME, FRAMES, seconds);
+    printf("MEASUREMENT:   Throughput: %.0f frames/s, %.2f us per frame\n", FRAMES / seconds, seconds * 1e6 / FRAMES);
+    printf("MEASUREMENT:   Kernel receive to listener: avg %.1f us, max %u us\n", double(listener.totalDispatchUs) / listener.received, listener.maxDispatchUs);
+    printf("MEASUREMENT:   Send calls rejected while the kernel queue was full: %u, dropped by the kernel: %u\n", rejected, receiverCore.getStatistics().rxOverruns);
+    TEST_ASSERT_EQUAL(0, receiverCore.getStatistics().rxOverruns);
+    TEST_ASSERT_EQUAL(0, listener.errors);
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_socketcan_core_interface_roundtrip);
+    RUN_TEST(test_socketcan_core_filter);
+    RUN_TEST(measure_socketcan_core_end_to_end);
+    return UNITY_END();
+}
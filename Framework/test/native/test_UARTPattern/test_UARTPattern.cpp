@@ -0,0 +1,166 @@
+#include <unity.h>
+#include <stdio.h>
+#include <thread>
+#include <chrono>
+#include "ByteRing.h"
+#include "UARTPattern.h"
+
+/*
+Host tests for the pattern detection and the frame end queue of the UART receive path. Run with the PlatformIO native environment.
+*/
+
+static constexpr size_t RING_SIZE = 256;
+static constexpr size_t QUEUE_SIZE = 8;
+static constexpr uint32_t STRESS_FRAMES = 2000000;
+
+/**
+ * @brief Back off while the ring is full or empty.
+ * @details Spins briefly, then sleeps so the peer thread also makes progress on hosts with a single CPU.
+ */
+void backoff(uint32_t& spins){
+    if(++spins < 100){
+        std::this_thread::yield();
+        return;
+    }
+    spins = 0;
+    std::this_thread::sleep_for(std::chrono::microseconds(10));
+}
+
+/**
+ * @brief Length of the numbered test frame, 1 to 40 bytes including the delimiter.
+ */
+size_t frameLength(uint32_t n){
+    return 1 + (n * 7) % 40;
+}
+
+uint8_t frameByte(uint32_t n, size_t i){
+    return 'a' + (n + i) % 26;
+}
+
+//Runs before tests
+void setUp(){
+
+}
+
+//Runs after tests
+void tearDown(){
+
+}
+
+void test_pattern_detector(){
+    UARTPatternDetector detector;
+    const char* text = "ab\ncd\n\n";
+    uint16_t found = 0;
+    for(size_t i=0; text[i] != 0; i++) if(detector.detect(text[i])) found |= 1 << i;
+    TEST_ASSERT_EQUAL_HEX16(0x0064, found);
+
+    //A run starts over after each pattern and is interrupted by other characters
+    detector.configure('+', 3);
+    text = "++x+++++++y";
+    found = 0;
+    for(size_t i=0; text[i] != 0; i++) if(detector.detect(text[i])) found |= 1 << i;
+    TEST_ASSERT_EQUAL_HEX16(0x0120, found);
+
+    detector.configure('+', 0);
+    TEST_ASSERT_EQUAL(1, detector.count);
+}
+
+void test_pattern_queue_frames(){
+    static UARTPatternQueue<QUEUE_SIZE> queue;
+    queue.reset();
+    TEST_ASSERT_EQUAL(0, queue.nextFrameLength());
+
+    //Frame ends at 5, 9 and 10
+    TEST_ASSERT_TRUE(queue.push(5));
+    TEST_ASSERT_TRUE(queue.push(9));
+    TEST_ASSERT_TRUE(queue.push(10));
+    queue.advance(12);
+    TEST_ASSERT_EQUAL(5, queue.nextFrameLength());
+    queue.consume(2);
+    TEST_ASSERT_EQUAL(3, queue.nextFrameLength());
+    queue.consume(3);
+    TEST_ASSERT_EQUAL(4, queue.nextFrameLength());
+
+    //Reading past frame ends drops them
+    queue.consume(5);
+    TEST_ASSERT_EQUAL(0, queue.nextFrameLength());
+
+    //Full queue
+    for(uint8_t i=0; i<QUEUE_SIZE; i++) TEST_ASSERT_TRUE(queue.push(20 + i));
+    TEST_ASSERT_FALSE(queue.push(30));
+    TEST_ASSERT_EQUAL(1, queue.getDropped());
+    queue.consume(10);
+    TEST_ASSERT_EQUAL(1, queue.nextFrameLength());
+    queue.consume(QUEUE_SIZE);
+    TEST_ASSERT_EQUAL(0, queue.nextFrameLength());
+}
+
+void test_pattern_queue_position_wrap(){
+    static UARTPatternQueue<QUEUE_SIZE> queue;
+    queue.reset();
+    queue.advance(0xFFFFFFF0);
+    queue.consume(0xFFFFFFF0);
+    TEST_ASSERT_TRUE(queue.push(queue.produced() + 10));
+    TEST_ASSERT_TRUE(queue.push(queue.produced() + 30));       // Beyond 2^32
+    queue.advance(40);
+    TEST_ASSERT_EQUAL(10, queue.nextFrameLength());
+    queue.consume(10);
+    TEST_ASSERT_EQUAL(20, queue.nextFrameLength());
+    queue.consume(20);
+    TEST_ASSERT_EQUAL(0, queue.nextFrameLength());
+}
+
+void test_pattern_stress_two_threads(){
+    //The producer detects the delimiter like a receive task, the consumer reads the frames by length only
+    static ByteRing<RING_SIZE> ring;
+    static UARTPatternQueue<RING_SIZE> queue;      // Room for a frame end per byte in the ring
+    queue.reset();
+    uint32_t errors = 0;
+    uint32_t received = 0;
+
+    std::thread consumer([&](){
+        uint32_t spins = 0;
+        uint8_t buffer[64];
+        while(received < STRESS_FRAMES){
+            size_t length = queue.nextFrameLength();
+            if(length == 0 || length > ring.size()){
+                backoff(spins);
+                continue;
+            }
+            size_t expected = frameLength(received);
+            if(length != expected || ring.read(buffer, length) != length) errors++;
+            for(size_t i=0; i+1<expected; i++) if(buffer[i] != frameByte(received, i)) errors++;
+            if(buffer[expected - 1] != '\n') errors++;
+            queue.consume(length);
+            received++;
+        }
+    });
+    UARTPatternDetector detector;
+    uint32_t spins = 0;
+    uint8_t frame[40];
+    for(uint32_t n=0; n<STRESS_FRAMES; n++){
+        size_t length = frameLength(n);
+        for(size_t i=0; i+1<length; i++) frame[i] = frameByte(n, i);
+        frame[length - 1] = '\n';
+        //Queue the frame end before the bytes, like the ESP32 receive task
+        while(ring.free() < length) backoff(spins);
+        for(size_t i=0; i<length; i++) if(detector.detect(frame[i])) queue.push(queue.produced() + i + 1);
+        ring.write(frame, length);
+        queue.advance(length);
+    }
+    consumer.join();
+
+    TEST_ASSERT_EQUAL(0, errors);
+    TEST_ASSERT_EQUAL(STRESS_FRAMES, received);
+    TEST_ASSERT_EQUAL(0, queue.getDropped());
+    TEST_ASSERT_TRUE(ring.empty());
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_pattern_detector);
+    RUN_TEST(test_pattern_queue_frames);
+    RUN_TEST(test_pattern_queue_position_wrap);
+    RUN_TEST(test_pattern_stress_two_threads);
+    return UNITY_END();
+}
@@ -0,0 +1,189 @@
+#include <unity.h>
+#include <stdio.h>
+#include "VirtualCANBus.h"
+
+/*
+Host tests for the in-process CAN bus simulation. Run with the PlatformIO native environment.
+*/
+
+VirtualCANBus* bus = nullptr;
+
+CANFrame makeFrame(uint32_t id, uint8_t length, bool extended = false){
+    CANFrame frame;
+    uint8_t data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    frame.set(id, extended, false, data, length, 0);
+    return frame;
+}
+
+//Runs before tests
+void setUp(){
+    static VirtualCANBus instance;
+    bus = &instance;
+    for(uint8_t i=0; i<VirtualCANBus::MAX_NODES; i++) bus->detach(i);
+    bus->setBitrate(500000);
+    bus->setSeed(1);
+    bus->setTransmitCallback(nullptr);
+    bus->run(1000);     // Finish a transmission left over from the previous test
+    bus->resetStatistics();
+}
+
+//Runs after tests
+void tearDown(){
+
+}
+
+void test_bus_arbitration_order(){
+    int8_t a = bus->attach();
+    int8_t b = bus->attach();
+    int8_t c = bus->attach();
+    int8_t listener = bus->attach();
+    TEST_ASSERT_TRUE(bus->transmit(a, makeFrame(0x300, 8)));
+    TEST_ASSERT_TRUE(bus->transmit(b, makeFrame(0x100 << 18, 8, true)));    // Same base ID as 0x100, extended
+    TEST_ASSERT_TRUE(bus->transmit(c, makeFrame(0x100, 8)));
+    TEST_ASSERT_TRUE(bus->transmit(a, makeFrame(0x050, 8)));                // Behind 0x300 in the queue of node a
+
+    bus->run(10000);
+    const uint32_t expected[] = {0x100, 0x100 << 18, 0x300, 0x050};
+    CANFrame frame = {};
+    for(uint32_t id : expected){
+        TEST_ASSERT_TRUE(bus->receive(listener, frame));
+        TEST_ASSERT_EQUAL_HEX32(id, frame.getId());
+    }
+    TEST_ASSERT_FALSE(bus->receive(listener, frame));
+    TEST_ASSERT_EQUAL(2, bus->getStatistics(a).arbitrationLost);   // Against 0x100 and 0x100 extended
+    TEST_ASSERT_EQUAL(3, bus->available(c));                        // Senders do not receive their own frames
+}
+
+void test_bus_bit_timing(){
+    const uint32_t bitrates[] = {125000, 250000, 500000, 1000000};
+    for(uint32_t bitrate : bitrates){
+        bus->setBitrate(bitrate);
+        int8_t tx = bus->attach();
+        int8_t rx = bus->attach();
+        uint64_t startUs = bus->now();
+        TEST_ASSERT_TRUE(bus->transmit(tx, makeFrame(0x123, 8)));
+        bus->run(10000);
+        CANFrame frame;
+        uint64_t receivedUs = 0;
+        TEST_ASSERT_TRUE(bus->receive(rx, frame, &receivedUs));
+        TEST_ASSERT_EQUAL(CANFrame::getBusBits(8, false) * 1000000ULL / bitrate, receivedUs - startUs);
+        TEST_ASSERT_EQUAL(receivedUs - startUs, bus->getStatistics(tx).maxLatencyUs);
+        bus->detach(tx);
+        bus->detach(rx);
+    }
+}
+
+void test_bus_error_injection(){
+    int8_t faulty = bus->attach();
+    int8_t healthy = bus->attach();
+    int8_t rx = bus->attach();
+    bus->setTxErrorRate(faulty, 1000);
+    TEST_ASSERT_TRUE(bus->transmit(faulty, makeFrame(0x010, 8)));
+    TEST_ASSERT_TRUE(bus->transmit(faulty, makeFrame(0x011, 8)));
+    TEST_ASSERT_TRUE(bus->transmit(healthy, makeFrame(0x020, 8)));
+
+    // Every failed attempt adds 8 to the TEC, bus-off after 32 attempts. The healthy node loses arbitration until then.
+    bus->run(100000);
+    TEST_ASSERT_EQUAL(32, bus->getStatistics(faulty).txErrors);
+    TEST_ASSERT_EQUAL(1, bus->getStatistics(faulty).busOffCount);
+    TEST_ASSERT_EQUAL(2, bus->getStatistics(faulty).txDiscarded);
+    TEST_ASSERT_EQUAL(1, bus->getStatistics(healthy).txFrames);
+    TEST_ASSERT_EQUAL(1, bus->available(rx));
+
+    // Recovery after 128 x 11 recessive bits
+    bus->forceBusOff(healthy);
+    TEST_ASSERT_TRUE(bus->isBusOff(healthy));
+    TEST_ASSERT_FALSE(bus->transmit(healthy, makeFrame(0x020, 8)));
+    bus->run(VirtualCANBus::BUS_OFF_RECOVERY_BITS * 2 - 1);
+    TEST_ASSERT_TRUE(bus->isBusOff(healthy));
+    bus->run(1);
+    TEST_ASSERT_FALSE(bus->isBusOff(healthy));
+    TEST_ASSERT_EQUAL(0, bus->getTxErrorCounter(healthy));
+
+    // Lost frames at one receiver
+    CANFrame frame;
+    while(bus->receive(rx, frame));
+    bus->setRxLossRate(rx, 500);
+    for(uint8_t i=0; i<20; i++) TEST_ASSERT_TRUE(bus->transmit(healthy, makeFrame(0x030, 0)));
+    bus->run(100000);
+    TEST_ASSERT_EQUAL(20, bus->available(rx) + bus->getStatistics(rx).lostFrames);
+    TEST_ASSERT_GREATER_THAN(0, bus->getStatistics(rx).lostFrames);
+}
+
+void measure_bus_load_and_latency(){
+    struct Message {
+        uint32_t id;
+        uint8_t length;
+        uint32_t periodUs;
+        int8_t node;
+        uint32_t maxLatencyUs;
+        uint64_t totalLatencyUs;
+        uint32_t count;
+    };
+    // Typical message set of a tram controller: sync, fast process data, slow status, heartbeats
+    // Node and latencies are set below
+    static Message messages[] = {
+        {0x080, 0, 10000, -1, 0, 0, 0}, {0x181, 8, 1000, -1, 0, 0, 0}, {0x182, 8, 1000, -1, 0, 0, 0},
+        {0x183, 4, 2000, -1, 0, 0, 0}, {0x184, 8, 2000, -1, 0, 0, 0}, {0x281, 8, 5000, -1, 0, 0, 0},
+        {0x282, 8, 5000, -1, 0, 0, 0}, {0x381, 6, 10000, -1, 0, 0, 0}, {0x701, 1, 100000, -1, 0, 0, 0},
+        {0x702, 1, 100000, -1, 0, 0, 0},
+    };
+    const uint32_t DURATION_US = 1000000;
+    const uint32_t STEP_US = 50;
+
+    for(Message& message : messages){
+        message.node = bus->attach();
+        message.maxLatencyUs = 0;
+        message.totalLatencyUs = 0;
+        message.count = 0;
+    }
+    bus->setTransmitCallback([](uint8_t node, const CANFrame& /*frame*/, uint64_t queuedUs, uint64_t doneUs) {
+        for(Message& message : messages){
+            if(message.node != node) continue;
+            uint32_t latency = doneUs - queuedUs;
+            if(latency > message.maxLatencyUs) message.maxLatencyUs = latency;
+            message.totalLatencyUs += latency;
+            message.count++;
+        }
+    });
+    bus->resetStatistics();
+
+    double expectedLoad = 0;
+    for(const Message& message : messages){
+        expectedLoad += double(CANFrame::getBusBits(message.length, false)) / bus->getBitrate() * 1e6 / message.periodUs;
+    }
+    uint64_t startUs = bus->now();
+    for(uint32_t t=0; t<DURATION_US; t+=STEP_US){
+        for(const Message& message : messages){
+            if(t % message.periodUs == 0) bus->transmit(message.node, makeFrame(message.id, message.length));
+        }
+        bus->run(STEP_US);
+        for(const Message& message : messages){
+            CANFrame frame;
+            while(bus->receive(message.node, frame));
+        }
+    }
+    TEST_ASSERT_EQUAL(DURATION_US, bus->now() - startUs);
+
+    printf("MEASUREMENT: Simulated %u ms at %u kbit/s\n", DURATION_US / 1000, bus->getBitrate() / 1000);
+    printf("MEASUREMENT:   Bus load: %u permille (expected %.0f)\n", bus->getBusLoad(), expectedLoad * 1000);
+    for(const Message& message : messages){
+        printf("MEASUREMENT:   ID 0x%03X, period %5u us: %4u frames, latency avg %4u us, max %4u us\n", unsigned(message.id),
+               unsigned(message.periodUs), unsigned(message.count), unsigned(message.count ? message.totalLatencyUs / message.count : 0),
+               unsigned(message.maxLatencyUs));
+        TEST_ASSERT_EQUAL(DURATION_US / message.periodUs, message.count);
+    }
+    TEST_ASSERT_UINT32_WITHIN(10, uint32_t(expectedLoad * 1000), bus->getBusLoad());
+    // Highest priority frame waits at most for one frame in transmission plus its own frame time
+    uint32_t longestFrameUs = CANFrame::getBusBits(8, false) * 1000000ULL / bus->getBitrate();
+    TEST_ASSERT_LESS_OR_EQUAL(2 * longestFrameUs, messages[0].maxLatencyUs);
+}
+
+int main(int argc, char** argv){
+    UNITY_BEGIN();
+    RUN_TEST(test_bus_arbitration_order);
+    RUN_TEST(test_bus_bit_timing);
+    RUN_TEST(test_bus_error_injection);
+    RUN_TEST(measure_bus_load_and_latency);
+    return UNITY_END();
+}
@@ -0,0 +1,44 @@
+/**
+ * @file candbc_generate.cpp
+ * @brief Host tool generating constexpr signal codecs from a DBC file, see CANDBC.h.
+ * @details Build and run on the development host:
+ *
+ *              g++ -std=c++11 -I../include candbc_generate.cpp -o candbc_generate
+ *              ./candbc_generate vehicle.dbc VehicleBus > VehicleBus.h
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "CANDBC.h"
+
+int main(int argc, char** argv) {
+    if(argc != 3) {
+        fprintf(stderr, "Usage: %s <description.dbc> <namespace>\n", argv[0]);
+        return 2;
+    }
+    FILE* file = fopen(argv[1], "rb");
+    if(file == nullptr) {
+        fprintf(stderr, "Cannot open %s\n", argv[1]);
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* text = static_cast<char*>(malloc(size + 1));
+    size_t length = fread(text, 1, size, file);
+    fclose(file);
+    text[length] = '\0';
+
+    static CANDBC::Database database;
+    bool parsed = database.parse(text);
+    free(text);
+    if(!parsed) {
+        fprintf(stderr, "%s:%u: Invalid or unsupported definition\n", argv[1], unsigned(database.getErrorLine()));
+        return 1;
+    }
+    const char* source = strrchr(argv[1], '/');
+    if(!CANDBC::generate(database, argv[2], source ? source + 1 : argv[1], [](const char* part) { fputs(part, stdout); })) {
+        fprintf(stderr, "A signal name collides with a generated member (ID, EXTENDED, DLC, decode, encode)\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file telemetry_decode.cpp
+ * @brief Host tool converting a telemetry stream of TelemetryPublisher to CSV, see Telemetry.h.
+ * @details Build and run on a Linux development host:
+ *
+ *              g++ -std=c++11 -I../include telemetry_decode.cpp -o telemetry_decode
+ *              ./telemetry_decode /dev/ttyUSB0 921600 > telemetry.csv
+ *              ./telemetry_decode capture.bin > telemetry.csv
+ *
+ *          A serial device is switched to raw mode with the given baudrate, other files and "-" (standard input) are read as they
+ *          are. Every sample record becomes one line with the time in microseconds, the sequence number and one column per signal;
+ *          signals not sampled in a record (decimation) leave their column empty. A header line is written whenever a new schema
+ *          was received completely. Errors and lost records are reported on standard error.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include "Telemetry.h"
+
+static speed_t toSpeed(unsigned long baudrate) {
+    switch(baudrate) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+        case 1000000: return B1000000;
+        case 2000000: return B2000000;
+        default: return B0;
+    }
+}
+
+static int openInput(const char* path, unsigned long baudrate) {
+    if(strcmp(path, "-") == 0) return STDIN_FILENO;
+    int fd = open(path, O_RDONLY | O_NOCTTY);
+    if(fd < 0 || !isatty(fd)) return fd;
+    termios tty;
+    speed_t speed = toSpeed(baudrate);
+    if(speed == B0 || tcgetattr(fd, &tty) != 0) {
+        fprintf(stderr, "Unsupported baudrate %lu\n", baudrate);
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&tty);
+    cfsetispeed(&tty, speed);
+    cfsetospeed(&tty, speed);
+    tty.c_cflag |= CLOCAL | CREAD;
+    tty.c_cc[VMIN] = 1;
+    tty.c_cc[VTIME] = 0;
+    if(tcsetattr(fd, TCSANOW, &tty) != 0) {
+        fprintf(stderr, "Cannot configure %s\n", path);
+        close(fd);
+        return -1;
+    }
+    tcflush(fd, TCIFLUSH);
+    return fd;
+}
+
+static void printHeader(const Telemetry::Decoder& decoder) {
+    printf("time_us,sequence");
+    for(uint8_t i=0; i<decoder.getSignalCount(); i++) printf(",%s", decoder.getSignal(i).name);
+    printf("\n");
+}
+
+static void printSample(const Telemetry::Decoder& decoder, const Telemetry::Sample& sample) {
+    printf("%lu,%u", (unsigned long)sample.timeUs, unsigned(sample.sequence));
+    for(uint8_t i=0; i<decoder.getSignalCount(); i++) {
+        if(!(sample.mask & (1UL << i))) {
+            printf(",");
+            continue;
+        }
+        switch(decoder.getSignal(i).type) {
+            case Telemetry::I32: printf(",%ld", long(int32_t(sample.raw[i]))); break;
+            case Telemetry::F32: printf(",%.7g", decoder.value(sample, i)); break;
+            default: printf(",%lu", (unsigned long)sample.raw[i]); break;
+        }
+    }
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s <device|file|-> [baudrate]\n", argv[0]);
+        return 2;
+    }
+    unsigned long baudrate = argc == 3 ? strtoul(argv[2], nullptr, 10) : 921600;
+    int fd = openInput(argv[1], baudrate);
+    if(fd < 0) {
+        fprintf(stderr, "Cannot open %s\n", argv[1]);
+        return 1;
+    }
+
+    static Telemetry::Decoder decoder;
+    Telemetry::Sample sample;
+    bool headerWritten = false;
+    uint8_t headerSchema = 0;
+    unsigned long samples = 0, crcErrors = 0, invalid = 0, unknown = 0;
+    uint8_t buffer[4096];
+    ssize_t length;
+    while((length = read(fd, buffer, sizeof(buffer))) > 0) {
+        for(ssize_t i=0; i<length; i++) {
+            switch(decoder.push(buffer[i], sample)) {
+                case Telemetry::Decoder::SCHEMA:
+                    if(decoder.isSchemaComplete() && (!headerWritten || decoder.getSchemaId() != headerSchema)) {
+                        printHeader(decoder);
+                        headerWritten = true;
+                        headerSchema = decoder.getSchemaId();
+                    }
+                    break;
+                case Telemetry::Decoder::SAMPLE:
+                    printSample(decoder, sample);
+                    samples++;
+                    break;
+                case Telemetry::Decoder::UNKNOWN_SCHEMA: unknown++; break;
+                case Telemetry::Decoder::CRC_ERROR: crcErrors++; break;
+                case Telemetry::Decoder::INVALID: invalid++; break;
+                default: break;
+            }
+        }
+        fflush(stdout);
+    }
+    if(fd != STDIN_FILENO) close(fd);
+    fprintf(stderr, "%lu samples, %lu lost records, %lu CRC errors, %lu invalid, %lu before the schema\n",
+            samples, (unsigned long)decoder.getLostRecords(), crcErrors, invalid, unknown);
+    return 0;
+}